@@ -137,6 +137,51 @@ private:
     size_t timeout_;
 };
 
+/// \brief Configuration for NUMA replication of data source clients
+class NumaReplicationConfig : public AuthConfigParser {
+public:
+    NumaReplicationConfig(AuthSrv& server) : server_(server), enable_(false)
+    {}
+
+    virtual void build(ConstElementPtr config) {
+        if (config->getType() != Element::boolean) {
+            bundy_throw(AuthConfigError, "numa_replication must be boolean");
+        }
+        enable_ = config->boolValue();
+    }
+
+    virtual void commit() {
+        // This takes effect on the next data source reconfiguration.
+        server_.getDataSrcClientsMgr().setNumaReplication(enable_);
+    }
+private:
+    AuthSrv& server_;
+    bool enable_;
+};
+
+/// \brief Configuration for the number of data source builder threads
+class BuilderThreadsConfig : public AuthConfigParser {
+public:
+    BuilderThreadsConfig(AuthSrv& server) : server_(server), count_(1)
+    {}
+
+    virtual void build(ConstElementPtr config) {
+        if (config->getType() != Element::integer ||
+            config->intValue() < 1) {
+            bundy_throw(AuthConfigError, "builder_threads must be 1 or "
+                        "higher");
+        }
+        count_ = config->intValue();
+    }
+
+    virtual void commit() {
+        server_.getDataSrcClientsMgr().setBuilderThreadCount(count_);
+    }
+private:
+    AuthSrv& server_;
+    size_t count_;
+};
+
 } // end of unnamed namespace
 
 AuthConfigParser*
@@ -170,6 +215,10 @@ createAuthConfigParser(AuthSrv& server, const std::string& config_id) {
         return (new VersionConfig());
     } else if (config_id == "tcp_recv_timeout") {
         return (new TCPRecvTimeoutConfig(server));
+    } else if (config_id == "numa_replication") {
+        return (new NumaReplicationConfig(server));
+    } else if (config_id == "builder_threads") {
+        return (new BuilderThreadsConfig(server));
     } else {
         bundy_throw(AuthConfigError, "Unknown configuration identifier: " <<
                   config_id);
@@ -280,6 +280,12 @@ public:
     /// The data source client list manager
     auth::DataSrcClientsMgr datasrc_clients_mgr_;
 
+    /// Timer to have the zones queried load into the caches on demand
+    IntervalTimer on_demand_timer_;
+
+    /// Interval of on_demand_timer_, in milliseconds
+    static const long ON_DEMAND_INTERVAL = 1000;
+
     /// Socket session forwarder for dynamic update requests
     BaseSocketSessionForwarder& ddns_base_forwarder_;
 
@@ -322,12 +328,20 @@ AuthSrvImpl::AuthSrvImpl(AbstractXfroutClient& xfrout_client,
     counters_(),
     keyring_(NULL),
     datasrc_clients_mgr_(io_service_),
+    on_demand_timer_(io_service_),
     ddns_base_forwarder_(ddns_forwarder),
     ddns_forwarder_(NULL),
     readers_group_subscribed_(false),
     xfrout_connected_(false),
     xfrout_client_(xfrout_client)
-{}
+{
+    // This does nothing unless find() has recorded zones to be loaded
+    // since the last time, so it's cheap enough to run unconditionally.
+    on_demand_timer_.setup(
+        boost::bind(&auth::DataSrcClientsMgr::loadZonesOnDemand,
+                    &datasrc_clients_mgr_),
+        ON_DEMAND_INTERVAL);
+}
 
 AuthSrvImpl::~AuthSrvImpl() {
     if (xfrout_connected_) {
@@ -869,7 +883,20 @@ AuthSrv::updateConfig(ConstElementPtr new_config) {
 }
 
 ConstElementPtr AuthSrv::getStatistics() const {
-    return (impl_->counters_.get());
+    // Add the statistics of the data source builder and of loading zones
+    // on demand to the counters.
+    const ElementPtr stats = Element::createMap();
+    typedef std::map<std::string, ConstElementPtr> ItemMap;
+    const ItemMap& items = impl_->counters_.get()->mapValue();
+    for (ItemMap::const_iterator it = items.begin(); it != items.end();
+         ++it) {
+        stats->set(it->first, it->second);
+    }
+    stats->set("datasrc_builder",
+               impl_->datasrc_clients_mgr_.getBuilderStatistics());
+    stats->set("cache_on_demand",
+               impl_->datasrc_clients_mgr_.getOnDemandStatistics());
+    return (stats);
 }
 
 const AddressList&
@@ -19,12 +19,16 @@
 
 #include <cc/data.h>
 #include <datasrc/client_list.h>
+#include <datasrc/zone_table_accessor.h>
+#include <datasrc/memory/zone_data.h>
 #include <config/ccsession.h>
 #include <exceptions/exceptions.h>
 #include <dns/rrclass.h>
 
 #include <string>
+#include <vector>
 
+#include <boost/foreach.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
 
@@ -181,6 +185,95 @@ public:
     }
 };
 
+// Handle the "getzonememory" command.  It returns the memory used by the
+// cached zones as a map from RR class to data source name to zone origin.
+// The optional "class" and "datasource" arguments limit the classes and
+// data sources to be reported.
+class GetZoneMemoryCommand : public AuthCommand {
+public:
+    virtual ConstElementPtr exec(AuthSrv& server,
+                                 bundy::data::ConstElementPtr args)
+    {
+        const string class_txt = getStringArg(args, "class");
+        const string datasrc_name = getStringArg(args, "datasource");
+        // This throws if the class is bogus, resulting in an error answer.
+        scoped_ptr<const RRClass> only_class(
+            class_txt.empty() ? NULL : new RRClass(class_txt));
+
+        ElementPtr result = Element::createMap();
+        DataSrcClientsMgr::Holder holder(server.getDataSrcClientsMgr());
+        BOOST_FOREACH(const RRClass& rrclass, holder.getClasses()) {
+            if (only_class && rrclass != *only_class) {
+                continue;
+            }
+            const boost::shared_ptr<ConfigurableClientList> list =
+                holder.findClientList(rrclass);
+            ElementPtr class_result = Element::createMap();
+            BOOST_FOREACH(const DataSourceStatus& status, list->getStatus()) {
+                if (!datasrc_name.empty() &&
+                    status.getName() != datasrc_name) {
+                    continue;
+                }
+                if (status.getSegmentState() != SEGMENT_INUSE) {
+                    continue;
+                }
+                class_result->set(status.getName(),
+                                  getDataSourceUsage(*list,
+                                                     status.getName()));
+            }
+            result->set(rrclass.toText(), class_result);
+        }
+        return (createAnswer(0, result));
+    }
+
+private:
+    static string getStringArg(const ConstElementPtr& args,
+                               const string& name)
+    {
+        if (!args || !args->contains(name)) {
+            return ("");
+        }
+        if (args->get(name)->getType() != Element::string) {
+            bundy_throw(AuthCommandError, "getzonememory argument '" << name
+                        << "' value not a string");
+        }
+        return (args->get(name)->stringValue());
+    }
+
+    static void setSize(ElementPtr& map, const string& name, size_t size) {
+        map->set(name, Element::create(static_cast<long long int>(size)));
+    }
+
+    static ConstElementPtr getDataSourceUsage(
+        const ConfigurableClientList& list, const string& datasrc_name)
+    {
+        ElementPtr datasrc_result = Element::createMap();
+        const ConstZoneTableAccessorPtr accessor =
+            list.getZoneTableAccessor(datasrc_name, true);
+        if (!accessor) {
+            return (datasrc_result);
+        }
+        for (ZoneTableAccessor::IteratorPtr it = accessor->getIterator();
+             !it->isLast();
+             it->next()) {
+            const Name& origin = it->getCurrent().origin;
+            memory::ZoneMemoryUsage usage;
+            if (!list.getCachedZoneMemoryUsage(origin, datasrc_name, usage)) {
+                continue;       // not loaded (yet, or due to an error)
+            }
+            ElementPtr zone_result = Element::createMap();
+            setSize(zone_result, "tree-nodes", usage.tree_nodes);
+            setSize(zone_result, "names", usage.names);
+            setSize(zone_result, "rdatasets", usage.rdatasets);
+            setSize(zone_result, "nsec3", usage.nsec3);
+            setSize(zone_result, "overhead", usage.overhead);
+            setSize(zone_result, "total", usage.getTotal());
+            datasrc_result->set(origin.toText(), zone_result);
+        }
+        return (datasrc_result);
+    }
+};
+
 // The factory of command objects.
 AuthCommand*
 createAuthCommand(const string& command_id) {
@@ -192,6 +285,8 @@ createAuthCommand(const string& command_id) {
         return (new GetStatsCommand());
     } else if (command_id == "loadzone") {
         return (new LoadZoneCommand());
+    } else if (command_id == "getzonememory") {
+        return (new GetZoneMemoryCommand());
     } else if (command_id == "start_ddns_forwarder") {
         return (new StartDDNSForwarderCommand());
     } else if (command_id == "stop_ddns_forwarder") {
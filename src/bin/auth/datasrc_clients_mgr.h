@@ -17,6 +17,7 @@
 
 #include <util/threads/thread.h>
 #include <util/threads/sync.h>
+#include <util/threads/numa.h>
 
 #include <log/logger_support.h>
 #include <log/log_dbglevels.h>
@@ -26,6 +27,7 @@
 #include <cc/data.h>
 
 #include <datasrc/exceptions.h>
+#include <datasrc/client.h>
 #include <datasrc/client_list.h>
 #include <datasrc/memory/zone_writer.h>
 
@@ -41,14 +43,20 @@
 #include <boost/noncopyable.hpp>
 #include <boost/function.hpp>
 #include <boost/foreach.hpp>
+#include <boost/scoped_ptr.hpp>
 
 #include <exception>
 #include <cassert>
 #include <cerrno>
 #include <list>
+#include <map>
+#include <set>
+#include <string>
 #include <utility>
+#include <vector>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/time.h>
 
 namespace bundy {
 namespace auth {
@@ -89,6 +97,9 @@ enum CommandID {
                   ///  (implicitly assuming it's shared-memory based and is
                   ///  updated by another module).
     SEGMENT_INFO_UPDATE, ///< The memory manager sent an update about segments.
+    LOAD_ON_DEMAND, ///< Load the zones used since the last time into the
+                    ///  caches of the data sources with
+                    ///  "cache-load-on-demand"; no argument.
     SHUTDOWN,     ///< Shutdown the builder; no argument
     NUM_COMMANDS
 };
@@ -105,13 +116,15 @@ struct Command {
     /// \brief Constructor
     ///
     /// It just initializes the member variables of the same names
-    /// as the parameters.
+    /// as the parameters, and records the current time as \c queued.
     Command(CommandID id, const data::ConstElementPtr& params,
             const FinishedCallback& callback) :
         id(id),
         params(params),
         callback(callback)
-    {}
+    {
+        gettimeofday(&queued, NULL);
+    }
     /// \brief The command to execute
     CommandID id;
     /// \brief Argument of the command.
@@ -125,6 +138,63 @@ struct Command {
     /// This may be an empty boost::function. In such case, no callback
     /// will be called after completion.
     FinishedCallback callback;
+    /// \brief When the command was created, for the latency statistics.
+    struct timeval queued;
+};
+
+/// \brief Statistics of the commands completed by the builder.
+struct BuilderStatistics {
+    BuilderStatistics() : completed(0), total_latency(0), max_latency(0) {}
+    uint64_t completed;     ///< Number of completed commands
+    uint64_t total_latency; ///< Sum of their latency (queued to completed),
+                            ///  in microseconds
+    uint64_t max_latency;   ///< Largest latency, in microseconds
+};
+
+/// \brief State shared by the builder threads of the manager.
+///
+/// By default the manager runs a single builder thread, which handles all
+/// commands in order.  With additional worker threads (see
+/// \c DataSrcClientsMgrBase::setBuilderThreadCount()), the main builder
+/// thread passes zone loads to \c load_queue, and the workers run them
+/// concurrently (at most one for each zone at a time).  Loads from
+/// \c urgent_queue are taken before anything else, even while the main
+/// builder thread runs a RECONFIGURE.  Other commands are run by the main
+/// builder thread alone, once the loads given to the workers before them
+/// have completed.
+///
+/// All members but the segment mutexes themselves are protected by the
+/// queue mutex of the manager.
+template <typename MutexType, typename CondVarType>
+struct BuilderPool {
+    BuilderPool() :
+        worker_limit(0), worker_count(0), active_loads(0), pending(0),
+        reconfiguring(false), exclusive(false)
+    {}
+    /// \brief Urgent LOADZONE commands, taken before any others.
+    std::list<Command> urgent_queue;
+    /// \brief LOADZONE and UPDATEZONE commands passed to the workers.
+    std::list<Command> load_queue;
+    /// \brief Keys of the zones being loaded (see \c getZoneKey()).
+    std::set<std::string> busy_zones;
+    /// \brief Loads that ran during a RECONFIGURE and have to be run again
+    /// for the new client lists.
+    std::list<Command> reapply_commands;
+    /// \brief Mutexes to serialize loads into the same zone table segment,
+    /// whose memory segment can't be used by multiple threads at once.
+    /// Each data source of a client list has its own segment, so they are
+    /// keyed by the client list and the data source name.
+    std::map<std::pair<const void*, std::string>, boost::shared_ptr<MutexType> >
+    segment_mutexes;
+    /// \brief Signaled when the workers may have something to do.
+    CondVarType worker_cond;
+    size_t worker_limit;        ///< Number of workers to run
+    size_t worker_count;        ///< Number of workers running
+    size_t active_loads;        ///< Number of loads run by the workers
+    size_t pending;             ///< Number of commands not completed yet
+    bool reconfiguring;         ///< A RECONFIGURE is running
+    bool exclusive;             ///< Another command is running alone
+    BuilderStatistics stats;
 };
 
 } // namespace datasrc_clientmgr_internal
@@ -155,6 +225,8 @@ private:
     typedef std::map<dns::RRClass,
                      boost::shared_ptr<datasrc::ConfigurableClientList> >
     ClientListsMap;
+    typedef datasrc_clientmgr_internal::BuilderPool<MutexType, CondVarType>
+    BuilderPoolType;
 
     class FDGuard : boost::noncopyable {
     public:
@@ -188,10 +260,15 @@ public:
     /// It's normally expected to create the holder object on the stack
     /// of a small scope and automatically let it be destroyed at the end
     /// of the scope.
+    ///
+    /// If NUMA replication is enabled (see \c setNumaReplication()), the
+    /// holder gives access to the replica of the client lists for the NUMA
+    /// node the calling thread runs on when the holder is constructed.
     class Holder {
     public:
         Holder(DataSrcClientsMgrBase& mgr) :
-            mgr_(mgr), locker_(mgr_.map_mutex_)
+            mgr_(mgr), locker_(mgr_.map_mutex_),
+            clients_map_(mgr_.getLocalClientsMap())
         {}
 
         /// \brief Find a data source client list of a specified RR class.
@@ -213,8 +290,8 @@ public:
             const dns::RRClass& rrclass)
         {
             const ClientListsMap::const_iterator
-                it = mgr_.clients_map_->find(rrclass);
-            if (it == mgr_.clients_map_->end()) {
+                it = clients_map_->find(rrclass);
+            if (it == clients_map_->end()) {
                 return (boost::shared_ptr<datasrc::ConfigurableClientList>());
             } else {
                 return (it->second);
@@ -232,7 +309,7 @@ public:
         std::vector<dns::RRClass> getClasses() const {
             std::vector<dns::RRClass> result;
             for (ClientListsMap::const_iterator it =
-                 mgr_.clients_map_->begin(); it != mgr_.clients_map_->end();
+                 clients_map_->begin(); it != clients_map_->end();
                  ++it) {
                 result.push_back(it->first);
             }
@@ -241,6 +318,7 @@ public:
     private:
         DataSrcClientsMgrBase& mgr_;
         typename MutexType::Locker locker_;
+        const ClientListsMap* const clients_map_;
     };
 
     /// \brief Constructor.
@@ -259,8 +337,10 @@ public:
         clients_map_(new ClientListsMap),
         fd_guard_(new FDGuard(this)),
         read_fd_(-1), write_fd_(-1),
+        on_demand_misses_(0),
         builder_(&command_queue_, &callback_queue_, &cond_, &queue_mutex_,
-                 &clients_map_, &map_mutex_, createFds()),
+                 &clients_map_, &map_mutex_, createFds(), &replicas_,
+                 &pool_),
         builder_thread_(boost::bind(&BuilderType::run, &builder_)),
         wakeup_socket_(service, read_fd_)
     {
@@ -296,6 +376,11 @@ public:
             sendCommand(datasrc_clientmgr_internal::SHUTDOWN,
                         data::ConstElementPtr());
             builder_thread_.wait();
+            // The builder stops the workers before it exits.
+            BOOST_FOREACH(const boost::shared_ptr<ThreadType>& worker,
+                          worker_threads_) {
+                worker->wait();
+            }
         } catch (const util::thread::Thread::UncaughtException& ex) {
             // technically, logging this could throw, which will be propagated.
             // But such an exception would be a fatal one anyway, so we
@@ -347,11 +432,184 @@ public:
         clients_map_ = new_lists;
     }
 
+    /// \brief Enable or disable NUMA replication of the client lists.
+    ///
+    /// If enabled, the builder configures a separate set of client lists
+    /// for each NUMA node of the system, with the builder thread bound to
+    /// the node, so the in-memory caches using a "local" segment of
+    /// each set are allocated from the memory of that node.  Zone loads and
+    /// segment updates are applied to every set, and \c Holder gives each
+    /// thread the set of the node it runs on; so threads pinned to a node
+    /// never have to read zone data across the interconnect.  Replicas of
+    /// caches using a "mapped" segment map the same file, so they only save
+    /// the indirection of a shared set.
+    ///
+    /// This costs one more copy of the caches and of the load work per
+    /// node.  It has no effect on a system with a single node.  The change
+    /// takes effect on the next \c reconfigure(); until then, all threads
+    /// use the current set.
+    ///
+    /// \throw std::bad_alloc
+    void setNumaReplication(bool enable) {
+        const size_t replica_count =
+            enable ? util::thread::getNumaNodeCount() - 1 : 0;
+        typename MutexType::Locker locker(map_mutex_);
+        replicas_.resize(replica_count);
+    }
+
+    /// \brief Return the number of NUMA nodes the client lists are
+    /// configured for.
+    ///
+    /// It's 1 unless NUMA replication is enabled on a system with more than
+    /// one node.  Mainly for tests.
+    size_t getReplicaCount() {
+        typename MutexType::Locker locker(map_mutex_);
+        return (replicas_.size() + 1);
+    }
+
+    /// \brief Set the number of threads to run the builder commands.
+    ///
+    /// With more than one thread, zone loads (\c loadZone() and
+    /// \c updateZone()) run concurrently on the additional threads, except
+    /// that loads into the same memory segment (that is, of zones cached
+    /// by the same data source) are still serialized.  Other commands are
+    /// handled one by one, after all loads requested before them.  The
+    /// default is 1, where all commands are handled in order by a single
+    /// thread.
+    ///
+    /// Decreasing the number takes effect as soon as the surplus threads
+    /// complete their current load.
+    ///
+    /// \throw bundy::InvalidParameter count is 0.
+    /// \throw std::bad_alloc
+    /// \throw bundy::Unexpected a thread can't be created.
+    ///
+    /// \param count The total number of builder threads.
+    void setBuilderThreadCount(size_t count) {
+        if (count == 0) {
+            bundy_throw(InvalidParameter, "builder thread count must be "
+                        "positive");
+        }
+        size_t start_count = 0;
+        {
+            typename MutexType::Locker locker(queue_mutex_);
+            pool_.worker_limit = count - 1;
+            if (pool_.worker_count < pool_.worker_limit) {
+                start_count = pool_.worker_limit - pool_.worker_count;
+                pool_.worker_count = pool_.worker_limit;
+            } else {
+                // Let the surplus workers find they should exit.
+                pool_.worker_cond.signal();
+            }
+        }
+        for (size_t i = 0; i < start_count; ++i) {
+            try {
+                worker_threads_.push_back(boost::shared_ptr<ThreadType>(
+                    new ThreadType(boost::bind(&BuilderType::runWorker,
+                                               &builder_))));
+            } catch (...) {
+                // Don't let the builder wait for the workers we couldn't
+                // start.
+                typename MutexType::Locker locker(queue_mutex_);
+                pool_.worker_count -= start_count - i;
+                cond_.signal();
+                throw;
+            }
+        }
+    }
+
+    /// \brief Return the statistics of the builder commands.
+    ///
+    /// It's a map of the following items:
+    /// - "threads": the number of builder threads
+    /// - "pending": the number of commands not completed yet
+    /// - "completed": the number of completed commands
+    /// - "latency_total": the sum of the time from sending each completed
+    ///   command to its completion, in microseconds
+    /// - "latency_max": the largest of them, in microseconds
+    ///
+    /// \throw std::bad_alloc
+    data::ConstElementPtr getBuilderStatistics() {
+        typename MutexType::Locker locker(queue_mutex_);
+        const data::ElementPtr stats = data::Element::createMap();
+        stats->set("threads", data::Element::create(
+                       static_cast<long long int>(pool_.worker_count + 1)));
+        stats->set("pending", data::Element::create(
+                       static_cast<long long int>(pool_.pending)));
+        stats->set("completed", data::Element::create(
+                       static_cast<long long int>(pool_.stats.completed)));
+        stats->set("latency_total", data::Element::create(
+                       static_cast<long long int>(
+                           pool_.stats.total_latency)));
+        stats->set("latency_max", data::Element::create(
+                       static_cast<long long int>(pool_.stats.max_latency)));
+        return (stats);
+    }
+
+    /// \brief Have the zones used since the last call loaded on demand.
+    ///
+    /// If \c find() of any of the client lists (including the NUMA
+    /// replicas) has recorded a zone to be loaded into the cache on demand
+    /// (see \c ConfigurableClientList::loadZonesOnDemand()) since the last
+    /// call, this sends a command to the builder to load them.  It's
+    /// expected to be called periodically from a timer of the application.
+    ///
+    /// \throw std::bad_alloc
+    /// \return true if the command is sent; false otherwise.
+    bool loadZonesOnDemand() {
+        const size_t misses = getOnDemandStats().misses;
+        if (misses == on_demand_misses_) {
+            return (false);
+        }
+        on_demand_misses_ = misses;
+        sendCommand(datasrc_clientmgr_internal::LOAD_ON_DEMAND,
+                    data::ConstElementPtr());
+        return (true);
+    }
+
+    /// \brief Return the statistics of loading zones on demand.
+    ///
+    /// They are those of \c ConfigurableClientList::getOnDemandStats()
+    /// summed up over all the client lists, as a map of the following
+    /// items:
+    /// - "hits": the number of zones found in the caches
+    /// - "misses": the number of zones found in the data sources, not
+    ///   loaded into the caches yet
+    /// - "loads": the number of zones loaded into the caches on demand
+    /// - "evictions": the number of zones removed from the caches to keep
+    ///   them within the memory limit
+    /// - "load_time": the total time of the loads, in milliseconds
+    /// - "memory": the memory used by the zones currently loaded, in bytes
+    ///
+    /// \throw std::bad_alloc
+    data::ConstElementPtr getOnDemandStatistics() {
+        const datasrc::ConfigurableClientList::OnDemandStats on_demand =
+            getOnDemandStats();
+        const data::ElementPtr stats = data::Element::createMap();
+        stats->set("hits", data::Element::create(
+                       static_cast<long long int>(on_demand.hits)));
+        stats->set("misses", data::Element::create(
+                       static_cast<long long int>(on_demand.misses)));
+        stats->set("loads", data::Element::create(
+                       static_cast<long long int>(on_demand.loads)));
+        stats->set("evictions", data::Element::create(
+                       static_cast<long long int>(on_demand.evictions)));
+        stats->set("load_time", data::Element::create(
+                       static_cast<long long int>(on_demand.load_time *
+                                                  1000)));
+        stats->set("memory", data::Element::create(
+                       static_cast<long long int>(on_demand.memory)));
+        return (stats);
+    }
+
     /// \brief Instruct internal thread to (re)load a zone
     ///
     /// \param args Element argument that should be a map of the form
     /// { "class": "IN", "origin": "example.com" }
-    /// (but class is optional and will default to IN)
+    /// (but class is optional and will default to IN).  If it contains
+    /// "urgent" set to true, the load is run before any other pending
+    /// commands, and doesn't wait for a running reconfiguration unless
+    /// there's only one builder thread (see \c setBuilderThreadCount()).
     /// \param callback Called once the loadZone command completes. It
     ///     is called in the main thread, not in the work thread. It should
     ///     be exceptionless.
@@ -409,6 +667,34 @@ private:
     // state of the class.
     void cleanup() {}
 
+    // Sum up the statistics of loading on demand over the client lists.
+    datasrc::ConfigurableClientList::OnDemandStats getOnDemandStats() {
+        datasrc::ConfigurableClientList::OnDemandStats stats;
+        typename MutexType::Locker locker(map_mutex_);
+        std::vector<datasrc::ClientListMapPtr> maps(replicas_);
+        maps.push_back(clients_map_);
+        BOOST_FOREACH(const datasrc::ClientListMapPtr& lists, maps) {
+            if (!lists) {
+                continue;
+            }
+            for (ClientListsMap::const_iterator it = lists->begin();
+                 it != lists->end(); ++it) {
+                if (!it->second) {
+                    continue;
+                }
+                const datasrc::ConfigurableClientList::OnDemandStats
+                    list_stats = it->second->getOnDemandStats();
+                stats.hits += list_stats.hits;
+                stats.misses += list_stats.misses;
+                stats.loads += list_stats.loads;
+                stats.evictions += list_stats.evictions;
+                stats.load_time += list_stats.load_time;
+                stats.memory += list_stats.memory;
+            }
+        }
+        return (stats);
+    }
+
     // Common handler for LOADZONE and UPDATEZONE.
     void updateZoneInternal(datasrc_clientmgr_internal::CommandID command,
                             const data::ConstElementPtr& args,
@@ -465,6 +751,14 @@ private:
         } else if (command == datasrc_clientmgr_internal::UPDATEZONE) {
                 bundy_throw(CommandError, "missing datasource for UPDATEZONE");
         }
+        bool urgent = false;
+        if (args->contains("urgent")) {
+            if (args->get("urgent")->getType() != data::Element::boolean) {
+                bundy_throw(CommandError,
+                            "invalid type for urgent (must be boolean)");
+            }
+            urgent = args->get("urgent")->boolValue();
+        }
 
         // Note: we could do some more advanced checks here,
         // e.g. check if the zone is known at all in the configuration.
@@ -472,21 +766,48 @@ private:
         // implement it would be to factor out the code from
         // the start of doUpdateZone(), and call it here too
 
-        sendCommand(command, args, callback);
+        sendCommand(command, args, callback, urgent);
     }
 
     // same as cleanup(), for reconfigure().
     void reconfigureHook() {}
 
+    // Return the client lists for the NUMA node of the calling thread; the
+    // primary lists serve node 0, and nodes whose replica hasn't been
+    // built yet.  map_mutex_ must be held.
+    const ClientListsMap* getLocalClientsMap() const {
+        if (!replicas_.empty()) {
+            const size_t node = util::thread::getCurrentNumaNode();
+            if (node > 0 && node <= replicas_.size() && replicas_[node - 1]) {
+                return (replicas_[node - 1].get());
+            }
+        }
+        return (clients_map_.get());
+    }
+
     void sendCommand(datasrc_clientmgr_internal::CommandID command,
                      const data::ConstElementPtr& arg,
                      const datasrc_clientmgr_internal::FinishedCallback&
-                     callback = datasrc_clientmgr_internal::FinishedCallback())
+                     callback = datasrc_clientmgr_internal::FinishedCallback(),
+                     bool urgent = false)
     {
         // The lock will be held until the end of this method.  Only
         // push_back has to be protected, but we can avoid having an extra
         // block this way.
         typename MutexType::Locker locker(queue_mutex_);
+        ++pool_.pending;
+        if (urgent) {
+            // Urgent loads bypass the main builder thread, unless it's
+            // the only one.
+            pool_.urgent_queue.push_back(
+                datasrc_clientmgr_internal::Command(command, arg, callback));
+            if (pool_.worker_count > 0) {
+                pool_.worker_cond.signal();
+            } else {
+                cond_.signal();
+            }
+            return;
+        }
         command_queue_.push_back(
             datasrc_clientmgr_internal::Command(command, arg, callback));
         cond_.signal();
@@ -541,14 +862,22 @@ private:
     std::list<datasrc_clientmgr_internal::FinishedCallback> callback_queue_;
     CondVarType cond_;          // condition variable for queue operations
     MutexType queue_mutex_;     // mutex to protect the queue
+    BuilderPoolType pool_;      // state of the builder threads, protected
+                                // by queue_mutex_
     datasrc::ClientListMapPtr clients_map_;
                                 // map of actual data source client objects
+    std::vector<datasrc::ClientListMapPtr> replicas_;
+                                // replicas of clients_map_ for NUMA nodes
+                                // 1 and later, protected by map_mutex_
     boost::scoped_ptr<FDGuard> fd_guard_; // A guard to close the fds.
     int read_fd_, write_fd_;    // Descriptors for wakeup
     MutexType map_mutex_;       // mutex to protect the clients map
+    size_t on_demand_misses_;   // misses seen by the last loadZonesOnDemand()
 
     BuilderType builder_;
     ThreadType builder_thread_; // for safety this should be placed last
+    std::vector<boost::shared_ptr<ThreadType> > worker_threads_;
+                                // additional builder threads
     bundy::asiolink::LocalSocket wakeup_socket_; // For integration of read_fd_
                                                // to the asio loop
     char buffer[1];   // Buffer for the wakeup socket.
@@ -577,6 +906,7 @@ private:
     typedef std::map<dns::RRClass,
                      boost::shared_ptr<datasrc::ConfigurableClientList> >
     ClientListsMap;
+    typedef BuilderPool<MutexType, CondVarType> BuilderPoolType;
 
 public:
     /// \brief Internal errors in handling commands.
@@ -593,6 +923,10 @@ public:
     /// \brief Constructor.
     ///
     /// It simply sets up a local copy of shared data with the manager.
+    /// \c replicas, if not NULL, holds the replicas of \c clients_map for
+    /// NUMA nodes 1 and later; see \c DataSrcClientsMgr::setNumaReplication().
+    /// \c pool, if not NULL, is the state shared with the worker threads
+    /// (see \c BuilderPool); without it, \c runWorker() must not be used.
     ///
     /// \throw None
     DataSrcClientsBuilderBase(std::list<Command>* command_queue,
@@ -600,16 +934,26 @@ public:
                               CondVarType* cond, MutexType* queue_mutex,
                               datasrc::ClientListMapPtr* clients_map,
                               MutexType* map_mutex,
-                              int wake_fd
+                              int wake_fd,
+                              std::vector<datasrc::ClientListMapPtr>*
+                              replicas = NULL,
+                              BuilderPoolType* pool = NULL
         ) :
         command_queue_(command_queue), callback_queue_(callback_queue),
         cond_(cond), queue_mutex_(queue_mutex),
-        clients_map_(clients_map), map_mutex_(map_mutex), wake_fd_(wake_fd)
+        clients_map_(clients_map), map_mutex_(map_mutex), wake_fd_(wake_fd),
+        replicas_(replicas), pool_(pool)
     {}
 
     /// \brief The main loop.
     void run();
 
+    /// \brief The main loop of the additional (worker) builder threads.
+    ///
+    /// It runs the zone loads passed from \c run() and the urgent loads
+    /// until the number of workers exceeds the limit in the pool.
+    void runWorker();
+
     /// \brief Handle one command from the manager.
     ///
     /// This is a dedicated subroutine of run() and is essentially private,
@@ -621,6 +965,49 @@ public:
     bool handleCommand(const Command& command);
 
 private:
+    // Handle the command, and pass its callback to the manager.
+    bool runCommand(const Command& command);
+
+    // Pass the callback of the completed command to the manager and update
+    // the statistics.  queue_mutex_ must be held.
+    void completeCommand(const Command& command);
+
+    // Pass the command to the workers if it's a load and there are any.
+    bool dispatchLoad(const Command& command);
+
+    // Wait for the loads passed to the workers, and keep them from
+    // starting others while the given (non-load) command runs.
+    void beginExclusive(CommandID id);
+    void endExclusive(CommandID id);
+
+    // Run the loads left in the pool with no worker to run them.
+    void runOrphanLoads();
+
+    // Whether there are any loads for runOrphanLoads().  queue_mutex_ must
+    // be held.
+    bool hasOrphanLoads() const {
+        return (pool_ != NULL && pool_->worker_count == 0 &&
+                (!pool_->urgent_queue.empty() || !pool_->load_queue.empty()));
+    }
+
+    // Move a load the calling worker can run now to 'taken'.  queue_mutex_
+    // must be held.
+    bool takeLoad(std::list<Command>& taken);
+
+    // Tell the workers to exit once they run out of loads.
+    void stopWorkers();
+
+    // Return the mutex serializing loads into the segment of the data
+    // source in the client list that a load of the zone would use.  With
+    // an empty datasrc_name that's the first one that has the zone, as
+    // ConfigurableClientList::getCachedZoneWriter() picks it.
+    MutexType& getSegmentMutex(const datasrc::ConfigurableClientList&
+                               client_list, const std::string& datasrc_name,
+                               const dns::Name& origin);
+
+    // Return the key identifying the zone of a load command in the pool.
+    static std::string getZoneKey(const Command& command);
+
     // NOOP command handler.  We use this so tests can override it; the default
     // implementation really does nothing.
     void doNoop() {}
@@ -635,14 +1022,32 @@ private:
                 // the lock is guaranteed to be released before
                 // the old data is destroyed, minimizing the lock
                 // duration.
+                const size_t replica_count = getReplicaCount();
                 datasrc::ClientListMapPtr new_clients_map =
-                    configureDataSource(config);
+                    configureReplica(config, 0, replica_count);
+                std::vector<datasrc::ClientListMapPtr> new_replicas;
+                for (size_t node = 1; node <= replica_count; ++node) {
+                    new_replicas.push_back(
+                        configureReplica(config, node, replica_count));
+                }
                 {
                     typename MutexType::Locker locker(*map_mutex_);
                     new_clients_map.swap(*clients_map_);
+                    if (replicas_ != NULL) {
+                        // In case replication has been enabled or
+                        // disabled in the meantime; the next
+                        // reconfiguration will catch up.
+                        new_replicas.resize(replicas_->size());
+                        new_replicas.swap(*replicas_);
+                    }
                 } // lock is released by leaving scope
                 LOG_INFO(auth_logger,
                          AUTH_DATASRC_CLIENTS_BUILDER_RECONFIGURE_SUCCESS);
+                if (replica_count > 0) {
+                    LOG_INFO(auth_logger,
+                             AUTH_DATASRC_CLIENTS_BUILDER_REPLICATED).
+                        arg(replica_count + 1);
+                }
             } catch (const datasrc::ConfigurableClientList::ConfigurationError&
                      config_error) {
                 LOG_ERROR(auth_logger,
@@ -689,6 +1094,23 @@ private:
                     .arg(rrclass).arg(name);
                 std::terminate();
             }
+            // The replicas are configured the same way as the primary
+            // lists, so they should succeed if the above did.
+            if (replicas_ != NULL) {
+                BOOST_FOREACH(const datasrc::ClientListMapPtr& replica,
+                              *replicas_) {
+                    if (!replica) {
+                        continue;
+                    }
+                    const ClientListsMap::const_iterator found =
+                        replica->find(rrclass);
+                    if (found != replica->end() && found->second) {
+                        found->second->resetMemorySegment(name,
+                            bundy::datasrc::memory::ZoneTableSegment::READ_ONLY,
+                            segment_params);
+                    }
+                }
+            }
         } catch (const bundy::dns::InvalidRRClass& irce) {
             LOG_FATAL(auth_logger,
                       AUTH_DATASRC_CLIENTS_BUILDER_SEGMENT_BAD_CLASS)
@@ -702,8 +1124,77 @@ private:
         }
     }
 
+    // Load the zones recorded by find() into the caches, for the primary
+    // client lists and the replicas.  find() must not run meanwhile, so
+    // map_mutex_ is held throughout; this is a non-load command, so no
+    // load of the workers runs either.
+    void doLoadOnDemand() {
+        typename MutexType::Locker locker(*map_mutex_);
+        size_t loaded = loadZonesOnDemand(**clients_map_);
+        if (replicas_ != NULL) {
+            for (size_t i = 0; i < replicas_->size(); ++i) {
+                if ((*replicas_)[i]) {
+                    const util::thread::NumaNodeBinder binder(i + 1);
+                    loaded += loadZonesOnDemand(*(*replicas_)[i]);
+                }
+            }
+        }
+        if (loaded > 0) {
+            LOG_DEBUG(auth_logger, DBGLVL_TRACE_BASIC,
+                      AUTH_DATASRC_CLIENTS_BUILDER_LOAD_ON_DEMAND).
+                arg(loaded);
+        }
+    }
+
+    size_t loadZonesOnDemand(const ClientListsMap& lists) {
+        size_t loaded = 0;
+        for (ClientListsMap::const_iterator it = lists.begin();
+             it != lists.end(); ++it) {
+            if (!it->second) {
+                continue;
+            }
+            try {
+                loaded += it->second->loadZonesOnDemand();
+            } catch (const bundy::Exception& ex) {
+                bundy_throw(InternalCommandError, "failed to load zones on "
+                            "demand for class " << it->first << ": " <<
+                            ex.what());
+            }
+        }
+        return (loaded);
+    }
+
+    // Return the number of NUMA replicas to build in addition to the
+    // primary client lists.
+    size_t getReplicaCount() {
+        if (replicas_ == NULL) {
+            return (0);
+        }
+        typename MutexType::Locker locker(*map_mutex_);
+        return (replicas_->size());
+    }
+
+    // Configure the client lists for the given NUMA node.  Unless
+    // replication is enabled, they are the only lists, and are configured
+    // without restricting the thread.
+    datasrc::ClientListMapPtr configureReplica(
+        const data::ConstElementPtr& config, size_t node,
+        size_t replica_count)
+    {
+        if (replica_count == 0) {
+            return (configureDataSource(config));
+        }
+        const util::thread::NumaNodeBinder binder(node);
+        return (configureDataSource(config));
+    }
+
     void doUpdateZone(datasrc_clientmgr_internal::CommandID command,
                       const bundy::data::ConstElementPtr& arg);
+    void updateZoneInList(datasrc_clientmgr_internal::CommandID command,
+                          datasrc::ConfigurableClientList& client_list,
+                          const std::string& datasrc_name,
+                          const dns::RRClass& rrclass,
+                          const dns::Name& origin);
     boost::shared_ptr<datasrc::memory::ZoneWriter> getZoneWriter(
         datasrc_clientmgr_internal::CommandID command,
         datasrc::ConfigurableClientList& client_list,
@@ -718,6 +1209,8 @@ private:
     datasrc::ClientListMapPtr* clients_map_;
     MutexType* map_mutex_;
     int wake_fd_;
+    std::vector<datasrc::ClientListMapPtr>* replicas_;
+    BuilderPoolType* pool_;
 };
 
 // Shortcut typedef for normal use
@@ -737,48 +1230,25 @@ DataSrcClientsBuilderBase<MutexType, CondVarType>::run() {
                 // Move all new commands to local queue under the protection of
                 // queue_mutex_.
                 typename MutexType::Locker locker(*queue_mutex_);
-                while (command_queue_->empty()) {
+                while (command_queue_->empty() && !hasOrphanLoads()) {
                     cond_->wait(*queue_mutex_);
                 }
                 current_commands.swap(*command_queue_);
             } // the lock is released here.
 
+            runOrphanLoads();
             while (keep_running && !current_commands.empty()) {
-                try {
-                    keep_running = handleCommand(current_commands.front());;
-                } catch (const InternalCommandError& e) {
-                    LOG_ERROR(auth_logger,
-                              AUTH_DATASRC_CLIENTS_BUILDER_COMMAND_ERROR).
-                        arg(e.what());
-                }
-                if (current_commands.front().callback) {
-                    // Lock the queue
-                    typename MutexType::Locker locker(*queue_mutex_);
-                    callback_queue_->
-                        push_back(current_commands.front().callback);
-                    // Wake up the other end. If it would block, there are data
-                    // and it'll wake anyway.
-                    int result = send(wake_fd_, "w", 1, MSG_DONTWAIT);
-                    if (result == -1 &&
-                        (errno != EWOULDBLOCK && errno != EAGAIN)) {
-                        // Note: the strerror might not be thread safe, as
-                        // subsequent call to it might change the returned
-                        // string. But that is unlikely and strerror_r is
-                        // not portable and we are going to terminate anyway,
-                        // so that's better than nothing.
-                        //
-                        // Also, this error handler is not tested. It should
-                        // be generally impossible to happen, so it is hard
-                        // to trigger in controlled way.
-                        LOG_FATAL(auth_logger,
-                                  AUTH_DATASRC_CLIENTS_BUILDER_WAKE_ERR).
-                            arg(strerror(errno));
-                        std::terminate();
-                    }
+                const Command& command = current_commands.front();
+                if (!dispatchLoad(command)) {
+                    beginExclusive(command.id);
+                    keep_running = runCommand(command);
+                    endExclusive(command.id);
                 }
                 current_commands.pop_front();
+                runOrphanLoads();
             }
         }
+        stopWorkers();
 
         LOG_INFO(auth_logger, AUTH_DATASRC_CLIENTS_BUILDER_STOPPED);
     } catch (const std::exception& ex) {
@@ -792,6 +1262,314 @@ DataSrcClientsBuilderBase<MutexType, CondVarType>::run() {
     }
 }
 
+template <typename MutexType, typename CondVarType>
+void
+DataSrcClientsBuilderBase<MutexType, CondVarType>::runWorker() {
+    assert(pool_ != NULL);
+
+    try {
+        while (true) {
+            std::list<Command> taken;
+            std::string zone_key;
+            {
+                typename MutexType::Locker locker(*queue_mutex_);
+                while (!takeLoad(taken)) {
+                    if (pool_->worker_count > pool_->worker_limit) {
+                        --pool_->worker_count;
+                        // Pass the check on to the next worker; the main
+                        // builder thread takes over the loads left if
+                        // this was the last one.
+                        pool_->worker_cond.signal();
+                        cond_->signal();
+                        return;
+                    }
+                    pool_->worker_cond.wait(*queue_mutex_);
+                }
+                zone_key = getZoneKey(taken.front());
+                pool_->busy_zones.insert(zone_key);
+                ++pool_->active_loads;
+                if (pool_->reconfiguring) {
+                    // The zone is loaded into the client lists being
+                    // replaced; it needs to be loaded into the new ones
+                    // too.
+                    pool_->reapply_commands.push_back(
+                        Command(taken.front().id, taken.front().params,
+                                FinishedCallback()));
+                }
+                if (!pool_->urgent_queue.empty() ||
+                    !pool_->load_queue.empty()) {
+                    pool_->worker_cond.signal();
+                }
+            }
+
+            try {
+                handleCommand(taken.front());
+            } catch (const InternalCommandError& e) {
+                LOG_ERROR(auth_logger,
+                          AUTH_DATASRC_CLIENTS_BUILDER_COMMAND_ERROR).
+                    arg(e.what());
+            }
+
+            typename MutexType::Locker locker(*queue_mutex_);
+            pool_->busy_zones.erase(zone_key);
+            --pool_->active_loads;
+            completeCommand(taken.front());
+            // Another load of this zone may be runnable now, and the main
+            // builder thread may be waiting for the loads to complete.
+            pool_->worker_cond.signal();
+            if (pool_->active_loads == 0) {
+                cond_->signal();
+            }
+        }
+    } catch (const std::exception& ex) {
+        LOG_FATAL(auth_logger, AUTH_DATASRC_CLIENTS_BUILDER_FAILED).
+            arg(ex.what());
+        std::terminate();
+    } catch (...) {
+        LOG_FATAL(auth_logger, AUTH_DATASRC_CLIENTS_BUILDER_FAILED_UNEXPECTED);
+        std::terminate();
+    }
+}
+
+template <typename MutexType, typename CondVarType>
+bool
+DataSrcClientsBuilderBase<MutexType, CondVarType>::runCommand(
+    const Command& command)
+{
+    bool keep_running = true;
+    try {
+        keep_running = handleCommand(command);
+    } catch (const InternalCommandError& e) {
+        LOG_ERROR(auth_logger, AUTH_DATASRC_CLIENTS_BUILDER_COMMAND_ERROR).
+            arg(e.what());
+    }
+    if (command.callback || pool_ != NULL) {
+        // Lock the queue
+        typename MutexType::Locker locker(*queue_mutex_);
+        completeCommand(command);
+    }
+    return (keep_running);
+}
+
+template <typename MutexType, typename CondVarType>
+void
+DataSrcClientsBuilderBase<MutexType, CondVarType>::completeCommand(
+    const Command& command)
+{
+    if (pool_ != NULL) {
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        const int64_t latency =
+            (now.tv_sec - command.queued.tv_sec) * 1000000LL +
+            (now.tv_usec - command.queued.tv_usec);
+        const uint64_t latency_usec = latency > 0 ? latency : 0;
+        ++pool_->stats.completed;
+        pool_->stats.total_latency += latency_usec;
+        if (latency_usec > pool_->stats.max_latency) {
+            pool_->stats.max_latency = latency_usec;
+        }
+        if (pool_->pending > 0) {
+            --pool_->pending;
+        }
+    }
+    if (command.callback) {
+        callback_queue_->push_back(command.callback);
+        // Wake up the other end. If it would block, there are data
+        // and it'll wake anyway.
+        int result = send(wake_fd_, "w", 1, MSG_DONTWAIT);
+        if (result == -1 &&
+            (errno != EWOULDBLOCK && errno != EAGAIN)) {
+            // Note: the strerror might not be thread safe, as
+            // subsequent call to it might change the returned
+            // string. But that is unlikely and strerror_r is
+            // not portable and we are going to terminate anyway,
+            // so that's better than nothing.
+            //
+            // Also, this error handler is not tested. It should
+            // be generally impossible to happen, so it is hard
+            // to trigger in controlled way.
+            LOG_FATAL(auth_logger,
+                      AUTH_DATASRC_CLIENTS_BUILDER_WAKE_ERR).
+                arg(strerror(errno));
+            std::terminate();
+        }
+    }
+}
+
+template <typename MutexType, typename CondVarType>
+bool
+DataSrcClientsBuilderBase<MutexType, CondVarType>::dispatchLoad(
+    const Command& command)
+{
+    if (pool_ == NULL || (command.id != LOADZONE && command.id != UPDATEZONE)) {
+        return (false);
+    }
+    typename MutexType::Locker locker(*queue_mutex_);
+    if (pool_->worker_count == 0) {
+        return (false);
+    }
+    pool_->load_queue.push_back(command);
+    pool_->worker_cond.signal();
+    return (true);
+}
+
+template <typename MutexType, typename CondVarType>
+void
+DataSrcClientsBuilderBase<MutexType, CondVarType>::beginExclusive(
+    CommandID id)
+{
+    if (pool_ == NULL || id == LOADZONE || id == UPDATEZONE) {
+        return;
+    }
+    while (true) {
+        {
+            typename MutexType::Locker locker(*queue_mutex_);
+            while (pool_->active_loads > 0 ||
+                   (pool_->worker_count > 0 && !pool_->load_queue.empty())) {
+                cond_->wait(*queue_mutex_);
+            }
+            if (!hasOrphanLoads()) {
+                if (id == RECONFIGURE) {
+                    // Urgent loads can still run, into the current client
+                    // lists; and as no load runs now, it's a good time to
+                    // forget the mutexes of the segments going away.
+                    pool_->reconfiguring = true;
+                    pool_->segment_mutexes.clear();
+                } else {
+                    pool_->exclusive = true;
+                }
+                return;
+            }
+        }
+        // The last worker exited before running all loads given to it.
+        runOrphanLoads();
+    }
+}
+
+template <typename MutexType, typename CondVarType>
+void
+DataSrcClientsBuilderBase<MutexType, CondVarType>::endExclusive(
+    CommandID id)
+{
+    if (pool_ == NULL || id == LOADZONE || id == UPDATEZONE) {
+        return;
+    }
+    typename MutexType::Locker locker(*queue_mutex_);
+    if (id == RECONFIGURE) {
+        pool_->reconfiguring = false;
+        pool_->pending += pool_->reapply_commands.size();
+        pool_->urgent_queue.splice(pool_->urgent_queue.begin(),
+                                   pool_->reapply_commands);
+    } else {
+        pool_->exclusive = false;
+    }
+    pool_->worker_cond.signal();
+}
+
+template <typename MutexType, typename CondVarType>
+void
+DataSrcClientsBuilderBase<MutexType, CondVarType>::runOrphanLoads() {
+    if (pool_ == NULL) {
+        return;
+    }
+    std::list<Command> loads;
+    {
+        typename MutexType::Locker locker(*queue_mutex_);
+        if (!hasOrphanLoads()) {
+            return;
+        }
+        loads.swap(pool_->urgent_queue);
+        loads.splice(loads.end(), pool_->load_queue);
+    }
+    BOOST_FOREACH(const Command& command, loads) {
+        runCommand(command);
+    }
+}
+
+template <typename MutexType, typename CondVarType>
+bool
+DataSrcClientsBuilderBase<MutexType, CondVarType>::takeLoad(
+    std::list<Command>& taken)
+{
+    if (pool_->exclusive) {
+        return (false);
+    }
+    std::list<Command>* const queues[] = {
+        &pool_->urgent_queue, &pool_->load_queue
+    };
+    BOOST_FOREACH(std::list<Command>* queue, queues) {
+        for (std::list<Command>::iterator it = queue->begin();
+             it != queue->end(); ++it) {
+            if (pool_->busy_zones.count(getZoneKey(*it)) == 0) {
+                taken.splice(taken.end(), *queue, it);
+                return (true);
+            }
+        }
+    }
+    return (false);
+}
+
+template <typename MutexType, typename CondVarType>
+void
+DataSrcClientsBuilderBase<MutexType, CondVarType>::stopWorkers() {
+    if (pool_ == NULL) {
+        return;
+    }
+    typename MutexType::Locker locker(*queue_mutex_);
+    pool_->worker_limit = 0;
+    pool_->worker_cond.signal();
+}
+
+template <typename MutexType, typename CondVarType>
+MutexType&
+DataSrcClientsBuilderBase<MutexType, CondVarType>::getSegmentMutex(
+    const datasrc::ConfigurableClientList& client_list,
+    const std::string& datasrc_name, const dns::Name& origin)
+{
+    std::string name = datasrc_name;
+    if (name.empty()) {
+        // Looking into the data sources can race with the lookups, like
+        // in getZoneWriter().
+        typename MutexType::Locker locker(*map_mutex_);
+        BOOST_FOREACH(const datasrc::ConfigurableClientList::DataSourceInfo&
+                      info, client_list.getDataSources()) {
+            if (info.data_src_client_ == NULL ||
+                info.data_src_client_->findZone(origin).code ==
+                datasrc::result::SUCCESS) {
+                name = info.name_;
+                break;
+            }
+        }
+    }
+
+    typename MutexType::Locker locker(*queue_mutex_);
+    boost::shared_ptr<MutexType>& mutex =
+        pool_->segment_mutexes[std::make_pair(&client_list, name)];
+    if (!mutex) {
+        mutex.reset(new MutexType);
+    }
+    return (*mutex);
+}
+
+template <typename MutexType, typename CondVarType>
+std::string
+DataSrcClientsBuilderBase<MutexType, CondVarType>::getZoneKey(
+    const Command& command)
+{
+    // The manager has validated the parameters, but just in case, a broken
+    // command is given a key of its own; it will fail anyway.
+    try {
+        const data::ConstElementPtr class_elem = command.params->get("class");
+        const dns::RRClass rrclass(class_elem ?
+                                   dns::RRClass(class_elem->stringValue()) :
+                                   dns::RRClass::IN());
+        dns::Name origin(command.params->get("origin")->stringValue());
+        return (rrclass.toText() + "/" + origin.downcase().toText());
+    } catch (const bundy::Exception&) {
+        return ("");
+    }
+}
+
 template <typename MutexType, typename CondVarType>
 bool
 DataSrcClientsBuilderBase<MutexType, CondVarType>::handleCommand(
@@ -805,7 +1583,7 @@ DataSrcClientsBuilderBase<MutexType, CondVarType>::handleCommand(
 
     const boost::array<const char*, NUM_COMMANDS> command_desc = {
         {"NOOP", "RECONFIGURE", "LOADZONE", "UPDATEZONE", "SEGMENT_INFO_UPDATE",
-         "SHUTDOWN"}
+         "LOAD_ON_DEMAND", "SHUTDOWN"}
     };
     LOG_DEBUG(auth_logger, DBGLVL_TRACE_BASIC,
               AUTH_DATASRC_CLIENTS_BUILDER_COMMAND).arg(command_desc.at(cid));
@@ -820,6 +1598,9 @@ DataSrcClientsBuilderBase<MutexType, CondVarType>::handleCommand(
     case SEGMENT_INFO_UPDATE:
         doSegmentUpdate(command.params);
         break;
+    case LOAD_ON_DEMAND:
+        doLoadOnDemand();
+        break;
     case SHUTDOWN:
         return (false);
     case NOOP:
@@ -856,8 +1637,17 @@ DataSrcClientsBuilderBase<MutexType, CondVarType>::doUpdateZone(
                                 dns::RRClass(class_elem->stringValue()) :
                                 dns::RRClass::IN());
     const dns::Name origin(arg->get("origin")->stringValue());
-    ClientListsMap::iterator found = (*clients_map_)->find(rrclass);
-    if (found == (*clients_map_)->end()) {
+    // With worker threads, the main builder thread can replace the lists
+    // in the meantime (see BuilderPool), so keep the current ones.
+    datasrc::ClientListMapPtr clients_map;
+    if (pool_ != NULL) {
+        typename MutexType::Locker locker(*map_mutex_);
+        clients_map = *clients_map_;
+    } else {
+        clients_map = *clients_map_;
+    }
+    ClientListsMap::iterator found = clients_map->find(rrclass);
+    if (found == clients_map->end()) {
         bundy_throw(InternalCommandError, "failed to load a zone " << origin <<
                   "/" << rrclass << ": not configured for the class");
     }
@@ -869,10 +1659,51 @@ DataSrcClientsBuilderBase<MutexType, CondVarType>::doUpdateZone(
     boost::shared_ptr<datasrc::ConfigurableClientList> client_list =
         found->second;
     assert(client_list);
+    updateZoneInList(command, *client_list, datasrc_name, rrclass, origin);
 
+    // Apply the same update to the replicas for other NUMA nodes, with
+    // this thread bound to the node so new zone data is allocated there.
+    std::vector<datasrc::ClientListMapPtr> replicas;
+    if (replicas_ != NULL) {
+        typename MutexType::Locker locker(*map_mutex_);
+        replicas = *replicas_;
+    }
+    for (size_t i = 0; i < replicas.size(); ++i) {
+        if (!replicas[i]) {
+            continue;
+        }
+        const ClientListsMap::iterator replica_found =
+            replicas[i]->find(rrclass);
+        if (replica_found != replicas[i]->end() && replica_found->second) {
+            const util::thread::NumaNodeBinder binder(i + 1);
+            updateZoneInList(command, *replica_found->second, datasrc_name,
+                             rrclass, origin);
+        }
+    }
+}
+
+// A dedicated subroutine of doUpdateZone(), loading the zone into one set of
+// the client lists.
+template <typename MutexType, typename CondVarType>
+void
+DataSrcClientsBuilderBase<MutexType, CondVarType>::updateZoneInList(
+    datasrc_clientmgr_internal::CommandID command,
+    datasrc::ConfigurableClientList& client_list,
+    const std::string& datasrc_name, const dns::RRClass& rrclass,
+    const dns::Name& origin)
+{
     try {
+        // Creating the writer already allocates in the segment, so the
+        // lock is taken before, and it's declared first so the writer is
+        // destroyed (releasing its data in the segment) while the lock is
+        // still held.
+        boost::scoped_ptr<typename MutexType::Locker> segment_locker;
+        if (pool_ != NULL) {
+            segment_locker.reset(new typename MutexType::Locker(
+                getSegmentMutex(client_list, datasrc_name, origin)));
+        }
         boost::shared_ptr<datasrc::memory::ZoneWriter> zwriter =
-            getZoneWriter(command, *client_list, datasrc_name, rrclass, origin);
+            getZoneWriter(command, client_list, datasrc_name, rrclass, origin);
         if (!zwriter) {
             return;
         }
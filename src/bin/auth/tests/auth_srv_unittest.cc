@@ -331,6 +331,27 @@ TEST_F(AuthSrvTest, noClientList) {
     checkStatisticsCounters(stats_after, expect);
 }
 
+// The statistics include those of the data source builder.
+TEST_F(AuthSrvTest, builderStatistics) {
+    const ConstElementPtr stats =
+        server.getStatistics()->get("datasrc_builder");
+    ASSERT_TRUE(stats);
+    EXPECT_EQ(1, stats->get("threads")->intValue());
+    EXPECT_TRUE(stats->contains("pending"));
+    EXPECT_TRUE(stats->contains("latency_max"));
+}
+
+// So do those of loading zones into the caches on demand.
+TEST_F(AuthSrvTest, onDemandStatistics) {
+    const ConstElementPtr stats =
+        server.getStatistics()->get("cache_on_demand");
+    ASSERT_TRUE(stats);
+    EXPECT_EQ(0, stats->get("hits")->intValue());
+    EXPECT_EQ(0, stats->get("misses")->intValue());
+    EXPECT_EQ(0, stats->get("loads")->intValue());
+    EXPECT_TRUE(stats->contains("memory"));
+}
+
 // Unsupported requests.  Should result in NOTIMP.
 TEST_F(AuthSrvTest, unsupportedRequest) {
     unsupportedRequest();
@@ -167,6 +167,58 @@ TEST_F(AuthCommandTest, shutdownIncorrectPID) {
     EXPECT_EQ(0, rcode_);
 }
 
+TEST_F(AuthCommandTest, getZoneMemory) {
+    const ConstElementPtr config(Element::fromJSON("{"
+        "\"IN\": [{"
+        "   \"type\": \"MasterFiles\","
+        "   \"params\": {"
+        "       \"example.\": \"" TEST_DATA_DIR
+        "/rfc5155-example.zone.signed\""
+        "   },"
+        "   \"cache-enable\": true"
+        "}]}"));
+    server_.getDataSrcClientsMgr().setDataSrcClientLists(
+        configureDataSource(config));
+
+    result_ = execAuthServerCommand(server_, "getzonememory",
+                                    ConstElementPtr());
+    checkAnswer(0, "getzonememory");
+    ConstElementPtr usage = parseAnswer(rcode_, result_)->get("IN")->
+        get("MasterFiles")->get("example.");
+    ASSERT_TRUE(usage);
+    EXPECT_LT(0, usage->get("tree-nodes")->intValue());
+    EXPECT_LT(0, usage->get("names")->intValue());
+    EXPECT_LT(0, usage->get("rdatasets")->intValue());
+    EXPECT_LT(0, usage->get("nsec3")->intValue());  // it's NSEC3-signed
+    EXPECT_LT(0, usage->get("overhead")->intValue());
+    EXPECT_EQ(usage->get("tree-nodes")->intValue() +
+              usage->get("names")->intValue() +
+              usage->get("rdatasets")->intValue() +
+              usage->get("nsec3")->intValue() +
+              usage->get("overhead")->intValue(),
+              usage->get("total")->intValue());
+
+    // Limiting to other classes or data sources.
+    result_ = execAuthServerCommand(server_, "getzonememory",
+                                    Element::fromJSON("{\"class\": \"CH\"}"));
+    checkAnswer(0, "getzonememory for CH");
+    EXPECT_TRUE(parseAnswer(rcode_, result_)->mapValue().empty());
+    result_ = execAuthServerCommand(
+        server_, "getzonememory",
+        Element::fromJSON("{\"datasource\": \"sqlite3\"}"));
+    checkAnswer(0, "getzonememory for sqlite3");
+    EXPECT_TRUE(parseAnswer(rcode_, result_)->get("IN")->mapValue().empty());
+
+    // Bad arguments.
+    result_ = execAuthServerCommand(server_, "getzonememory",
+                                    Element::fromJSON("{\"class\": 1}"));
+    checkAnswer(1, "non string class");
+    result_ = execAuthServerCommand(
+        server_, "getzonememory",
+        Element::fromJSON("{\"class\": \"no_such_class\"}"));
+    checkAnswer(1, "bad class");
+}
+
 TEST_F(AuthCommandTest, getStats) {
     result_ = execAuthServerCommand(server_, "getstats", ConstElementPtr());
     parseAnswer(rcode_, result_);
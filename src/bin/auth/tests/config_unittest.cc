@@ -31,6 +31,7 @@
 
 #include "datasrc_util.h"
 
+#include <util/threads/numa.h>
 #include <util/unittests/mock_socketsession.h>
 #include <testutils/mockups.h>
 #include <testutils/portconfig.h>
@@ -155,4 +156,32 @@ TEST_F(AuthConfigTest, tcpRecvTimeoutConfig) {
                  AuthConfigError);
 }
 
+TEST_F(AuthConfigTest, numaReplicationConfig) {
+    configureAuthServer(server, Element::fromJSON(
+    "{ \"numa_replication\": true }"));
+    EXPECT_EQ(bundy::util::thread::getNumaNodeCount(),
+              server.getDataSrcClientsMgr().getReplicaCount());
+    configureAuthServer(server, Element::fromJSON(
+    "{ \"numa_replication\": false }"));
+    EXPECT_EQ(1, server.getDataSrcClientsMgr().getReplicaCount());
+    EXPECT_THROW(configureAuthServer(server, Element::fromJSON(
+                    "{ \"numa_replication\": 1 }")),
+                 AuthConfigError);
+}
+
+TEST_F(AuthConfigTest, builderThreadsConfig) {
+    configureAuthServer(server, Element::fromJSON(
+    "{ \"builder_threads\": 3 }"));
+    EXPECT_EQ(3, server.getDataSrcClientsMgr().getBuilderStatistics()->
+              get("threads")->intValue());
+    configureAuthServer(server, Element::fromJSON(
+    "{ \"builder_threads\": 1 }"));
+    EXPECT_THROW(configureAuthServer(server, Element::fromJSON(
+                    "{ \"builder_threads\": 0 }")),
+                 AuthConfigError);
+    EXPECT_THROW(configureAuthServer(server, Element::fromJSON(
+                    "{ \"builder_threads\": true }")),
+                 AuthConfigError);
+}
+
 }
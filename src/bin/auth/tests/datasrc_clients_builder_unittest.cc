@@ -42,6 +42,7 @@
 #include <cstdlib>
 #include <string>
 #include <sstream>
+#include <vector>
 #include <cerrno>
 #include <unistd.h>
 
@@ -388,6 +389,203 @@ TEST_F(DataSrcClientsBuilderTest, loadZone) {
     newZoneChecks(clients_map, rrclass);
 }
 
+// With NUMA replication, each replica is configured and updated separately.
+// The replicas are given to the builder regardless of the actual topology,
+// which is used only to bind the thread.
+TEST_F(DataSrcClientsBuilderTest, loadZoneWithReplicas) {
+    std::vector<ClientListMapPtr> replicas(1);
+    TestDataSrcClientsBuilder replicating_builder(
+        &command_queue, &callback_queue, &cond, &queue_mutex, &clients_map,
+        &map_mutex, write_end, &replicas);
+
+    ASSERT_EQ(0, std::system(INSTALL_PROG " -c " TEST_DATA_DIR "/test1.zone.in "
+                             TEST_DATA_BUILDDIR "/test1.zone.copied"));
+    ASSERT_EQ(0, std::system(INSTALL_PROG " -c " TEST_DATA_DIR "/test2.zone.in "
+                             TEST_DATA_BUILDDIR "/test2.zone.copied"));
+    const Command reconfig_cmd(RECONFIGURE, Element::fromJSON(
+        "{"
+        "\"IN\": [{"
+        "   \"type\": \"MasterFiles\","
+        "   \"params\": {"
+        "       \"test1.example\": \"" +
+        std::string(TEST_DATA_BUILDDIR "/test1.zone.copied") + "\","
+        "       \"test2.example\": \"" +
+        std::string(TEST_DATA_BUILDDIR "/test2.zone.copied") + "\""
+        "   },"
+        "   \"cache-enable\": true"
+        "}]}"), FinishedCallback());
+    EXPECT_TRUE(replicating_builder.handleCommand(reconfig_cmd));
+    ASSERT_TRUE(replicas[0]);
+    EXPECT_NE(clients_map, replicas[0]);
+    EXPECT_NE(clients_map->find(rrclass)->second,
+              replicas[0]->find(rrclass)->second);
+    zoneChecks(clients_map, rrclass);
+    zoneChecks(replicas[0], rrclass);
+
+    EXPECT_EQ(0, system(INSTALL_PROG " -c " TEST_DATA_DIR
+                        "/test1-new.zone.in "
+                        TEST_DATA_BUILDDIR "/test1.zone.copied"));
+    EXPECT_EQ(0, system(INSTALL_PROG " -c " TEST_DATA_DIR
+                        "/test2-new.zone.in "
+                        TEST_DATA_BUILDDIR "/test2.zone.copied"));
+    const Command loadzone_cmd(LOADZONE, Element::fromJSON(
+                                   "{\"class\": \"IN\","
+                                   " \"origin\": \"test1.example\"}"),
+                               FinishedCallback());
+    EXPECT_TRUE(replicating_builder.handleCommand(loadzone_cmd));
+    newZoneChecks(clients_map, rrclass);
+    newZoneChecks(replicas[0], rrclass);
+}
+
+// Another callback, to tell the order of the callbacks.
+void anotherCallback() {}
+
+TEST_F(DataSrcClientsBuilderTest, urgentLoadWithoutWorkers) {
+    BuilderPool<TestMutex, TestCondVar> pool;
+    TestDataSrcClientsBuilder pooled_builder(
+        &command_queue, &callback_queue, &cond, &queue_mutex, &clients_map,
+        &map_mutex, write_end, NULL, &pool);
+    configureZones();
+    EXPECT_EQ(0, system(INSTALL_PROG " -c " TEST_DATA_DIR
+                        "/test1-new.zone.in "
+                        TEST_DATA_BUILDDIR "/test1.zone.copied"));
+
+    // Without workers, the main loop runs urgent loads before the other
+    // commands.
+    pool.urgent_queue.push_back(Command(LOADZONE, Element::fromJSON(
+                                            "{\"origin\": \"test1.example\"}"),
+                                        anotherCallback));
+    command_queue.push_back(Command(NOOP, ConstElementPtr(),
+                                   emptyCallsback));
+    command_queue.push_back(shutdown_cmd);
+    pooled_builder.run();
+
+    EXPECT_TRUE(pool.urgent_queue.empty());
+    EXPECT_EQ(1, queue_mutex.noop_count);
+    newZoneChecks(clients_map, rrclass);
+    ASSERT_EQ(2, callback_queue.size());
+    EXPECT_TRUE(anotherCallback == callback_queue.front());
+    EXPECT_TRUE(emptyCallsback == callback_queue.back());
+    // All the commands, including the shutdown, count in the statistics.
+    EXPECT_EQ(3, pool.stats.completed);
+    EXPECT_LE(pool.stats.max_latency, pool.stats.total_latency);
+}
+
+TEST_F(DataSrcClientsBuilderTest, runWorker) {
+    BuilderPool<TestMutex, TestCondVar> pool;
+    TestDataSrcClientsBuilder pooled_builder(
+        &command_queue, &callback_queue, &cond, &queue_mutex, &clients_map,
+        &map_mutex, write_end, NULL, &pool);
+    configureZones();
+    EXPECT_EQ(0, system(INSTALL_PROG " -c " TEST_DATA_DIR
+                        "/test1-new.zone.in "
+                        TEST_DATA_BUILDDIR "/test1.zone.copied"));
+    const Command load1_cmd(LOADZONE, Element::fromJSON(
+                                "{\"origin\": \"test1.example\"}"),
+                            emptyCallsback);
+    const Command load2_cmd(LOADZONE, Element::fromJSON(
+                                "{\"origin\": \"test2.example\"}"),
+                            anotherCallback);
+
+    // One worker, which is to exit once it has nothing to do.
+    pool.worker_count = 1;
+
+    // While another command runs alone, the worker doesn't start any load.
+    pool.exclusive = true;
+    pool.load_queue.push_back(load1_cmd);
+    pooled_builder.runWorker();
+    EXPECT_EQ(1, pool.load_queue.size());
+    EXPECT_EQ(0, pool.worker_count);
+
+    // Nor for a zone being loaded by another worker.
+    pool.exclusive = false;
+    pool.worker_count = 1;
+    pool.busy_zones.insert("IN/test1.example.");
+    pooled_builder.runWorker();
+    EXPECT_EQ(1, pool.load_queue.size());
+    pool.busy_zones.clear();
+
+    // Urgent loads come first.  The loads during a reconfiguration are
+    // recorded to be run again, without the callback.
+    pool.worker_count = 1;
+    pool.urgent_queue.push_back(load2_cmd);
+    pool.reconfiguring = true;
+    pooled_builder.runWorker();
+    EXPECT_TRUE(pool.load_queue.empty());
+    EXPECT_TRUE(pool.urgent_queue.empty());
+    EXPECT_EQ(0, pool.worker_count);
+    EXPECT_EQ(0, pool.active_loads);
+    EXPECT_TRUE(pool.busy_zones.empty());
+    EXPECT_EQ(1, pool.segment_mutexes.size());
+    newZoneChecks(clients_map, rrclass);
+    ASSERT_EQ(2, callback_queue.size());
+    EXPECT_TRUE(anotherCallback == callback_queue.front());
+    EXPECT_TRUE(emptyCallsback == callback_queue.back());
+    EXPECT_EQ(2, pool.stats.completed);
+    ASSERT_EQ(2, pool.reapply_commands.size());
+    EXPECT_EQ(LOADZONE, pool.reapply_commands.front().id);
+    EXPECT_FALSE(pool.reapply_commands.front().callback);
+}
+
+// Loads of different zones of the same data source run on several worker
+// threads at once, and share its segment (creating the zone writers
+// allocates there too).
+TEST_F(DataSrcClientsBuilderTest, concurrentLoads) {
+    using bundy::util::thread::CondVar;
+    using bundy::util::thread::Mutex;
+    using bundy::util::thread::Thread;
+
+    configureZones();
+    EXPECT_EQ(0, system(INSTALL_PROG " -c " TEST_DATA_DIR
+                        "/test1-new.zone.in "
+                        TEST_DATA_BUILDDIR "/test1.zone.copied"));
+
+    std::list<Command> real_command_queue;
+    std::list<FinishedCallback> real_callback_queue;
+    CondVar real_cond;
+    Mutex real_queue_mutex;
+    Mutex real_map_mutex;
+    BuilderPool<Mutex, CondVar> pool;
+    DataSrcClientsBuilder real_builder(
+        &real_command_queue, &real_callback_queue, &real_cond,
+        &real_queue_mutex, &clients_map, &real_map_mutex, write_end, NULL,
+        &pool);
+
+    const size_t load_count = 100;
+    const size_t thread_count = 4;
+    for (size_t i = 0; i < load_count; ++i) {
+        pool.load_queue.push_back(Command(LOADZONE, Element::fromJSON(
+                                              i % 2 == 0 ?
+                                              "{\"origin\": \"test1.example\"}" :
+                                              "{\"origin\": \"test2.example\"}"),
+                                          FinishedCallback()));
+    }
+    pool.worker_limit = thread_count;
+    pool.worker_count = thread_count;
+    std::vector<boost::shared_ptr<Thread> > threads;
+    for (size_t i = 0; i < thread_count; ++i) {
+        threads.push_back(boost::shared_ptr<Thread>(
+            new Thread(boost::bind(&DataSrcClientsBuilder::runWorker,
+                                   &real_builder))));
+    }
+    {
+        Mutex::Locker locker(real_queue_mutex);
+        while (!pool.load_queue.empty() || pool.active_loads > 0) {
+            real_cond.wait(real_queue_mutex);
+        }
+        pool.worker_limit = 0;
+        pool.worker_cond.signal();
+    }
+    for (size_t i = 0; i < thread_count; ++i) {
+        threads[i]->wait();
+    }
+
+    EXPECT_EQ(0, pool.worker_count);
+    EXPECT_EQ(load_count, pool.stats.completed);
+    EXPECT_EQ(1, pool.segment_mutexes.size());
+    newZoneChecks(clients_map, rrclass);
+}
+
 // Shared test for both LOADZONE and UPDATEZONE
 void
 DataSrcClientsBuilderTest::checkLoadOrUpdateZone(CommandID cmdid) {
@@ -535,6 +733,52 @@ TEST_F(DataSrcClientsBuilderTest,
     checkLoadOrUpdateZone(UPDATEZONE);
 }
 
+// LOAD_ON_DEMAND loads the zones used since the last time into the caches
+// of the data sources with "cache-load-on-demand".
+TEST_F(DataSrcClientsBuilderTest,
+#ifdef USE_STATIC_LINK
+       DISABLED_loadOnDemand
+#else
+       loadOnDemand
+#endif
+    )
+{
+    const std::string test_db = TEST_DATA_BUILDDIR "/auth_test.sqlite3.copied";
+    std::stringstream ss("example.org. 3600 IN SOA . . 0 0 0 0 0\n"
+                         "example.org. 3600 IN NS ns1.example.org.\n");
+    createSQLite3DB(rrclass, Name("example.org"), test_db.c_str(), ss);
+    clients_map = configureDataSource(Element::fromJSON("{"
+        "\"IN\": [{"
+        "    \"type\": \"sqlite3\","
+        "    \"params\": {\"database_file\": \"" + test_db + "\"},"
+        "    \"cache-enable\": true,"
+        "    \"cache-load-on-demand\": true,"
+        "    \"cache-zones\": [\"example.org\"]"
+        "}]}"));
+    const boost::shared_ptr<ConfigurableClientList> list =
+        clients_map->find(rrclass)->second;
+    const Command cmd(LOAD_ON_DEMAND, ConstElementPtr(), FinishedCallback());
+
+    // Nothing is loaded before the zone is used.
+    EXPECT_TRUE(builder.handleCommand(cmd));
+    EXPECT_EQ(0, list->getOnDemandStats().loads);
+
+    // Once it's used, the command loads it, holding the map mutex so no
+    // lookup can run meanwhile.
+    ASSERT_TRUE(list->find(Name("www.example.org")).finder_);
+    EXPECT_EQ(1, list->getOnDemandStats().misses);
+    const size_t orig_lock_count = map_mutex.lock_count;
+    const size_t orig_unlock_count = map_mutex.unlock_count;
+    EXPECT_TRUE(builder.handleCommand(cmd));
+    EXPECT_EQ(orig_lock_count + 1, map_mutex.lock_count);
+    EXPECT_EQ(orig_unlock_count + 1, map_mutex.unlock_count);
+    EXPECT_EQ(1, list->getOnDemandStats().loads);
+
+    // From now on it's found in the cache.
+    ASSERT_TRUE(list->find(Name("www.example.org")).finder_);
+    EXPECT_EQ(1, list->getOnDemandStats().hits);
+}
+
 TEST_F(DataSrcClientsBuilderTest, loadBrokenZone) {
     configureZones();
 
@@ -14,6 +14,8 @@
 
 #include <exceptions/exceptions.h>
 
+#include <util/threads/numa.h>
+
 #include <dns/rrclass.h>
 
 #include <cc/data.h>
@@ -21,13 +23,18 @@
 #include <datasrc/client_list.h>
 
 #include <auth/datasrc_clients_mgr.h>
+#include <auth/datasrc_config.h>
 #include "test_datasrc_clients_mgr.h"
+#include "datasrc_util.h"
 
 #include <gtest/gtest.h>
 
 #include <boost/function.hpp>
 #include <boost/bind.hpp>
 
+#include <sstream>
+#include <string>
+
 using namespace bundy::dns;
 using namespace bundy::data;
 using namespace bundy::datasrc;
@@ -200,6 +207,35 @@ TEST(DataSrcClientsMgrTest, holder) {
     EXPECT_THROW(TestDataSrcClientsMgr::Holder holder2(mgr), bundy::Unexpected);
 }
 
+TEST(DataSrcClientsMgrTest, numaReplication) {
+    using bundy::util::thread::getNumaNodeCount;
+
+    TestDataSrcClientsMgr mgr;
+    ASSERT_TRUE(FakeDataSrcClientsBuilder::replicas);
+    EXPECT_EQ(1, mgr.getReplicaCount());
+
+    // One replica for each node other than the first one.
+    mgr.setNumaReplication(true);
+    EXPECT_EQ(getNumaNodeCount(), mgr.getReplicaCount());
+    EXPECT_EQ(getNumaNodeCount() - 1,
+              FakeDataSrcClientsBuilder::replicas->size());
+    mgr.setNumaReplication(false);
+    EXPECT_EQ(1, mgr.getReplicaCount());
+    EXPECT_TRUE(FakeDataSrcClientsBuilder::replicas->empty());
+
+    // Until the replicas are built, holders use the primary lists on any
+    // node.
+    FakeDataSrcClientsBuilder::replicas->resize(1);
+    mgr.reconfigure(Element::fromJSON(
+        "{\"IN\": [{\"type\": \"MasterFiles\", \"params\": {},"
+        "           \"cache-enable\": true}]}"));
+    {
+        TestDataSrcClientsMgr::Holder holder(mgr);
+        EXPECT_TRUE(holder.findClientList(RRClass::IN()));
+    }
+    FakeDataSrcClientsBuilder::command_queue->clear();
+}
+
 namespace {
 /* wrapper for hiding the optional argument for loadZone(). */
 void loadZoneWrapper(TestDataSrcClientsMgr* mgr, const ConstElementPtr& args) {
@@ -275,6 +311,64 @@ TEST(DataSrcClientsMgrTest, reload) {
     EXPECT_EQ(orig_qlen + 1, FakeDataSrcClientsBuilder::command_queue->size());
 }
 
+TEST(DataSrcClientsMgrTest, urgentLoadZone) {
+    TestDataSrcClientsMgr mgr;
+    ASSERT_TRUE(FakeDataSrcClientsBuilder::pool);
+    const size_t orig_qlen = FakeDataSrcClientsBuilder::command_queue->size();
+    const size_t orig_signals = FakeDataSrcClientsBuilder::cond->signal_count;
+
+    // An urgent load goes to its own queue.  Without workers, the main
+    // builder thread is woken up to run it.
+    mgr.loadZone(Element::fromJSON("{\"origin\": \"example.com\","
+                                   " \"urgent\": true}"));
+    EXPECT_EQ(orig_qlen, FakeDataSrcClientsBuilder::command_queue->size());
+    ASSERT_EQ(1, FakeDataSrcClientsBuilder::pool->urgent_queue.size());
+    EXPECT_EQ(LOADZONE,
+              FakeDataSrcClientsBuilder::pool->urgent_queue.front().id);
+    EXPECT_EQ(orig_signals + 1, FakeDataSrcClientsBuilder::cond->signal_count);
+
+    // A non urgent one goes to the normal queue.
+    mgr.loadZone(Element::fromJSON("{\"origin\": \"example.com\","
+                                   " \"urgent\": false}"));
+    EXPECT_EQ(orig_qlen + 1, FakeDataSrcClientsBuilder::command_queue->size());
+    EXPECT_EQ(2, mgr.getBuilderStatistics()->get("pending")->intValue());
+
+    EXPECT_THROW(mgr.loadZone(Element::fromJSON(
+                                  "{\"origin\": \"example.com\","
+                                  " \"urgent\": \"yes\"}")),
+                 CommandError);
+    FakeDataSrcClientsBuilder::pool->urgent_queue.clear();
+}
+
+TEST(DataSrcClientsMgrTest, builderThreads) {
+    TestDataSrcClientsMgr mgr;
+    ASSERT_TRUE(FakeDataSrcClientsBuilder::pool);
+    EXPECT_EQ(1, mgr.getBuilderStatistics()->get("threads")->intValue());
+
+    // The additional threads run the workers of the builder.
+    mgr.setBuilderThreadCount(3);
+    EXPECT_EQ(2, FakeDataSrcClientsBuilder::worker_runs);
+    EXPECT_EQ(2, FakeDataSrcClientsBuilder::pool->worker_limit);
+    EXPECT_EQ(3, mgr.getBuilderStatistics()->get("threads")->intValue());
+
+    // Decreasing the number is left to the workers.
+    mgr.setBuilderThreadCount(2);
+    EXPECT_EQ(2, FakeDataSrcClientsBuilder::worker_runs);
+    EXPECT_EQ(1, FakeDataSrcClientsBuilder::pool->worker_limit);
+
+    EXPECT_THROW(mgr.setBuilderThreadCount(0), bundy::InvalidParameter);
+
+    // The other items of the statistics are all 0 at this point.
+    const ConstElementPtr stats = mgr.getBuilderStatistics();
+    EXPECT_EQ(0, stats->get("pending")->intValue());
+    EXPECT_EQ(0, stats->get("completed")->intValue());
+    EXPECT_EQ(0, stats->get("latency_total")->intValue());
+    EXPECT_EQ(0, stats->get("latency_max")->intValue());
+
+    // The fake workers don't exit by themselves.
+    FakeDataSrcClientsBuilder::pool->worker_count = 0;
+}
+
 TEST(DataSrcClientsMgrTest, updateZone) {
     TestDataSrcClientsMgr mgr;
 
@@ -309,6 +403,61 @@ TEST(DataSrcClientsMgrTest, segmentUpdate) {
     EXPECT_EQ(1, FakeDataSrcClientsBuilder::command_queue->size());
 }
 
+// The manager sends LOAD_ON_DEMAND only when some zones have been recorded
+// to be loaded since the last time.
+TEST(DataSrcClientsMgrTest,
+#ifdef USE_STATIC_LINK
+     DISABLED_loadZonesOnDemand
+#else
+     loadZonesOnDemand
+#endif
+    )
+{
+    TestDataSrcClientsMgr mgr;
+
+    // Nothing to load without any data sources.
+    EXPECT_FALSE(mgr.loadZonesOnDemand());
+    EXPECT_TRUE(FakeDataSrcClientsBuilder::command_queue->empty());
+    ConstElementPtr stats = mgr.getOnDemandStatistics();
+    const char* const items[] = {
+        "hits", "misses", "loads", "evictions", "load_time", "memory", NULL
+    };
+    for (const char* const* item = items; *item; ++item) {
+        ASSERT_TRUE(stats->contains(*item)) << *item;
+        EXPECT_EQ(0, stats->get(*item)->intValue()) << *item;
+    }
+
+    const std::string test_db = TEST_DATA_BUILDDIR "/auth_test.sqlite3.copied";
+    std::stringstream ss("example.org. 3600 IN SOA . . 0 0 0 0 0\n"
+                         "example.org. 3600 IN NS ns1.example.org.\n");
+    unittest::createSQLite3DB(RRClass::IN(), Name("example.org"),
+                              test_db.c_str(), ss);
+    const ClientListMapPtr lists = configureDataSource(Element::fromJSON("{"
+        "\"IN\": [{"
+        "    \"type\": \"sqlite3\","
+        "    \"params\": {\"database_file\": \"" + test_db + "\"},"
+        "    \"cache-enable\": true,"
+        "    \"cache-load-on-demand\": true,"
+        "    \"cache-zones\": [\"example.org\"]"
+        "}]}"));
+    mgr.setDataSrcClientLists(lists);
+    EXPECT_FALSE(mgr.loadZonesOnDemand());
+    EXPECT_TRUE(FakeDataSrcClientsBuilder::command_queue->empty());
+
+    // A lookup of the zone not loaded yet has it loaded.
+    ASSERT_TRUE(lists->find(RRClass::IN())->second->
+                find(Name("www.example.org")).finder_);
+    EXPECT_TRUE(mgr.loadZonesOnDemand());
+    ASSERT_EQ(1, FakeDataSrcClientsBuilder::command_queue->size());
+    EXPECT_EQ(LOAD_ON_DEMAND,
+              FakeDataSrcClientsBuilder::command_queue->front().id);
+    EXPECT_EQ(1, mgr.getOnDemandStatistics()->get("misses")->intValue());
+
+    // Until it's used again, there's nothing more to load.
+    EXPECT_FALSE(mgr.loadZonesOnDemand());
+    EXPECT_EQ(1, FakeDataSrcClientsBuilder::command_queue->size());
+}
+
 void
 callback(bool* called, int *tag_target, int tag_value) {
     *called = true;
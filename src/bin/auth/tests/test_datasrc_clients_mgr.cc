@@ -35,8 +35,12 @@ TestMutex* FakeDataSrcClientsBuilder::queue_mutex = NULL;
 bundy::datasrc::ClientListMapPtr*
     FakeDataSrcClientsBuilder::clients_map = NULL;
 TestMutex* FakeDataSrcClientsBuilder::map_mutex = NULL;
+std::vector<bundy::datasrc::ClientListMapPtr>*
+    FakeDataSrcClientsBuilder::replicas = NULL;
+BuilderPool<TestMutex, TestCondVar>* FakeDataSrcClientsBuilder::pool = NULL;
 TestMutex FakeDataSrcClientsBuilder::queue_mutex_copy;
 bool FakeDataSrcClientsBuilder::thread_waited = false;
+size_t FakeDataSrcClientsBuilder::worker_runs = 0;
 FakeDataSrcClientsBuilder::ExceptionFromWait
 FakeDataSrcClientsBuilder::thread_throw_on_wait =
     FakeDataSrcClientsBuilder::NOTHROW;
@@ -25,6 +25,7 @@
 #include <boost/function.hpp>
 
 #include <list>
+#include <vector>
 
 // In this file we provide specialization of thread, mutex, condition variable,
 // and DataSrcClientsBuilder for convenience of tests.  They don't use
@@ -143,6 +144,8 @@ public:
     static int wakeup_fd;
     static bundy::datasrc::ClientListMapPtr* clients_map;
     static TestMutex* map_mutex;
+    static std::vector<bundy::datasrc::ClientListMapPtr>* replicas;
+    static BuilderPool<TestMutex, TestCondVar>* pool;
     static std::list<Command> command_queue_copy;
     static std::list<FinishedCallback> callback_queue_copy;
     static TestCondVar cond_copy;
@@ -151,6 +154,9 @@ public:
     // true iff the manager waited on the thread running the builder.
     static bool thread_waited;
 
+    // Number of calls to runWorker().
+    static size_t worker_runs;
+
     // If set to true by a test, TestThread::wait() throws an exception
     // exception.
     enum ExceptionFromWait { NOTHROW, THROW_UNCAUGHT_EX, THROW_OTHER };
@@ -162,7 +168,9 @@ public:
         TestCondVar* cond,
         TestMutex* queue_mutex,
         bundy::datasrc::ClientListMapPtr* clients_map,
-        TestMutex* map_mutex, int wakeup_fd)
+        TestMutex* map_mutex, int wakeup_fd,
+        std::vector<bundy::datasrc::ClientListMapPtr>* replicas = NULL,
+        BuilderPool<TestMutex, TestCondVar>* pool = NULL)
     {
         FakeDataSrcClientsBuilder::started = false;
         FakeDataSrcClientsBuilder::command_queue = command_queue;
@@ -172,12 +180,18 @@ public:
         FakeDataSrcClientsBuilder::wakeup_fd = wakeup_fd;
         FakeDataSrcClientsBuilder::clients_map = clients_map;
         FakeDataSrcClientsBuilder::map_mutex = map_mutex;
+        FakeDataSrcClientsBuilder::replicas = replicas;
+        FakeDataSrcClientsBuilder::pool = pool;
         FakeDataSrcClientsBuilder::thread_waited = false;
+        FakeDataSrcClientsBuilder::worker_runs = 0;
         FakeDataSrcClientsBuilder::thread_throw_on_wait = NOTHROW;
     }
     void run() {
         FakeDataSrcClientsBuilder::started = true;
     }
+    void runWorker() {
+        ++FakeDataSrcClientsBuilder::worker_runs;
+    }
 };
 
 // A fake thread class that doesn't really invoke thread but simply calls
@@ -0,0 +1,153 @@
+# Copyright (C) 2014  Internet Systems Consortium.
+#
+# Permission to use, copy, modify, and distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND INTERNET SYSTEMS CONSORTIUM
+# DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL
+# INTERNET SYSTEMS CONSORTIUM BE LIABLE FOR ANY SPECIAL, DIRECT,
+# INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING
+# FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+# NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION
+# WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+'''Tests for the compilezone module'''
+
+import unittest
+from compilezone import *
+from bundy.dns import *
+from bundy.datasrc import *
+import bundy.log
+import json
+import os
+import shutil
+
+TESTDATA_PATH = os.environ['TESTDATA_PATH'] + os.sep
+TESTDATA_WRITE_PATH = os.environ['TESTDATA_WRITE_PATH'] + os.sep
+ZONE_FILE = TESTDATA_PATH + "example.com.zone"
+WRITE_ZONE_FILE = TESTDATA_WRITE_PATH + "example.com.zone.copied"
+ZONE_FILE_ORG = TESTDATA_PATH + "example.org.zone"
+WRITE_ZONE_FILE_ORG = TESTDATA_WRITE_PATH + "example.org.zone.copied"
+IMAGE_FILE = TESTDATA_WRITE_PATH + "compilezone-test.mapped"
+MASTERFILES_CONFIG = '{"example.com": "' + WRITE_ZONE_FILE + '"}'
+
+class TestCompileZoneRunner(unittest.TestCase):
+    def setUp(self):
+        shutil.copyfile(ZONE_FILE, WRITE_ZONE_FILE)
+        self.__args = ['-c', MASTERFILES_CONFIG, '-o', IMAGE_FILE]
+
+    def tearDown(self):
+        for f in [WRITE_ZONE_FILE, WRITE_ZONE_FILE_ORG, IMAGE_FILE,
+                  IMAGE_FILE + '.tmp']:
+            if os.path.exists(f):
+                os.unlink(f)
+
+    def test_init(self):
+        '''Checks initial class attributes.'''
+        runner = CompileZoneRunner(self.__args)
+        self.assertIsNone(runner._zone_class)
+        self.assertEqual([], runner._zone_names)
+        self.assertIsNone(runner._image_file)
+        self.assertIsNone(runner._datasrc_config)
+        self.assertIsNone(runner._datasrc_type)
+        self.assertFalse(runner._verify)
+
+    def test_parse_args(self):
+        runner = CompileZoneRunner(self.__args)
+        runner._parse_args()
+        self.assertEqual(RRClass.IN, runner._zone_class)
+        self.assertEqual('MasterFiles', runner._datasrc_type)
+        self.assertEqual({"example.com": WRITE_ZONE_FILE},
+                         runner._datasrc_config)
+        self.assertEqual(IMAGE_FILE, runner._image_file)
+        self.assertFalse(runner._verify)
+
+        runner = CompileZoneRunner(['-t', 'sqlite3', '-c', '{}', '-o',
+                                    IMAGE_FILE, '-v', 'example.org',
+                                    'example.com'])
+        runner._parse_args()
+        self.assertEqual('sqlite3', runner._datasrc_type)
+        self.assertEqual([Name('example.org'), Name('example.com')],
+                         runner._zone_names)
+        self.assertTrue(runner._verify)
+
+    def __check_bad_args(self, args):
+        runner = CompileZoneRunner(args)
+        self.assertRaises(BadArgument, runner._parse_args)
+        self.assertEqual(1, runner.run())
+
+    def test_bad_args(self):
+        # missing configuration or image
+        self.__check_bad_args(['-o', IMAGE_FILE])
+        self.__check_bad_args(['-c', MASTERFILES_CONFIG])
+        # broken JSON
+        self.__check_bad_args(['-c', '{', '-o', IMAGE_FILE])
+        # zone names are taken from the configuration for MasterFiles...
+        self.__check_bad_args(self.__args + ['example.com'])
+        # ...but are mandatory for others
+        self.__check_bad_args(['-t', 'sqlite3', '-c', '{}', '-o',
+                               IMAGE_FILE])
+        self.__check_bad_args(['-t', 'sqlite3', '-c', '{}', '-o',
+                               IMAGE_FILE, 'bad..name'])
+        # bad class and debug level
+        self.__check_bad_args(self.__args + ['-C', 'XXX'])
+        self.__check_bad_args(self.__args + ['-d', '-1'])
+
+    def test_compile_and_verify(self):
+        self.assertEqual(0, CompileZoneRunner(self.__args).run())
+        self.assertTrue(os.path.exists(IMAGE_FILE))
+        self.assertFalse(os.path.exists(IMAGE_FILE + '.tmp'))
+
+        # The image can be used as a normal read-only segment.
+        clist = ConfigurableClientList(RRClass.IN)
+        clist.configure(json.dumps([{"type": "MasterFiles",
+                                     "params": {"example.com":
+                                                    WRITE_ZONE_FILE},
+                                     "cache-enable": True,
+                                     "cache-type": "mapped"}]), True)
+        clist.reset_memory_segment("MasterFiles",
+                                   ConfigurableClientList.READ_ONLY,
+                                   json.dumps({"mapped-file": IMAGE_FILE}))
+        _, finder, exact = clist.find(Name("example.com"), True)
+        self.assertTrue(exact)
+        result, _, _ = finder.find(Name("example.com"), RRType.SOA)
+        self.assertEqual(ZoneFinder.SUCCESS, result)
+        clist = None
+
+        # It matches the source it was built from...
+        self.assertEqual(0, CompileZoneRunner(self.__args + ['-v']).run())
+
+        # ...until the source changes.
+        with open(WRITE_ZONE_FILE, 'a') as f:
+            f.write('added.example.com. 3600 IN A 192.0.2.53\n')
+        self.assertEqual(1, CompileZoneRunner(self.__args + ['-v']).run())
+
+    def test_verify_extra_zone(self):
+        # An image with a zone that isn't in the sources doesn't match
+        # them, even if all the zones that are match.
+        other_config = json.dumps({"example.com": WRITE_ZONE_FILE,
+                                   "example.org": WRITE_ZONE_FILE_ORG})
+        shutil.copyfile(ZONE_FILE_ORG, WRITE_ZONE_FILE_ORG)
+        self.assertEqual(0, CompileZoneRunner(['-c', other_config, '-o',
+                                               IMAGE_FILE]).run())
+        self.assertEqual(0, CompileZoneRunner(['-c', other_config, '-o',
+                                               IMAGE_FILE, '-v']).run())
+        self.assertEqual(1, CompileZoneRunner(self.__args + ['-v']).run())
+
+    def test_compile_failure(self):
+        # A broken zone fails the whole compilation and leaves nothing
+        # behind.
+        with open(WRITE_ZONE_FILE, 'a') as f:
+            f.write('broken.example.com. 3600 IN A bad-address\n')
+        self.assertEqual(1, CompileZoneRunner(self.__args).run())
+        self.assertFalse(os.path.exists(IMAGE_FILE))
+        self.assertFalse(os.path.exists(IMAGE_FILE + '.tmp'))
+
+    def test_verify_missing_image(self):
+        self.assertEqual(1, CompileZoneRunner(self.__args + ['-v']).run())
+
+if __name__== "__main__":
+    bundy.log.resetUnitTestRootLogger()
+    unittest.main()
@@ -221,6 +221,14 @@ class TestMemmgr(unittest.TestCase):
                          parse_answer(self.__mgr._config_handler(user_cfg)))
         self.assertEqual('/some/path/dir',
                          self.__mgr._config_params['mapped_file_dir'])
+        self.assertFalse(self.__mgr._config_params['mapped_huge_pages'])
+
+        # Memory options are just stored.
+        user_cfg = {'mapped_huge_pages': True, 'mapped_prefault': True}
+        self.assertEqual((0, None),
+                         parse_answer(self.__mgr._config_handler(user_cfg)))
+        self.assertTrue(self.__mgr._config_params['mapped_huge_pages'])
+        self.assertTrue(self.__mgr._config_params['mapped_prefault'])
 
         # Bad update: diretory doesn't exist (we assume it really doesn't
         # exist in the tested environment).  Update won't be made.
@@ -604,6 +612,43 @@ class TestMemmgr(unittest.TestCase):
             'loadzone', {'class': 'IN', 'datasource': 'noname',
                          'origin': 'zone'}))[0])
 
+    def test_compact(self):
+        "Check the compact command"
+
+        # there's no datasrc info
+        self.assertEqual(1, parse_answer(self.__mgr._mod_command_handler(
+            'compact', {'datasource': 'name'}))[0])
+
+        commands = []
+        self.__mgr._cmd_to_builder = lambda cmd: commands.append(cmd)
+        sgmt_info = MockSegmentInfo()
+        dsrc_info = MockDataSrcInfo(sgmt_info)
+        self.__mgr._datasrc_info_list.append(dsrc_info)
+
+        # missing necesary keys, invalid values, or no segment
+        self.assertEqual(1, parse_answer(self.__mgr._mod_command_handler(
+            'compact', {}))[0])
+        self.assertEqual(1, parse_answer(self.__mgr._mod_command_handler(
+            'compact', {'class': 'badclass', 'datasource': 'name'}))[0])
+        self.assertEqual(1, parse_answer(self.__mgr._mod_command_handler(
+            'compact', {'class': 'IN', 'datasource': 'noname'}))[0])
+        self.assertEqual([], sgmt_info.events)
+
+        # Normal case; class defaults to IN.  The event is passed to the
+        # builder if start_update() returns it.
+        expected_event = ('compact', dsrc_info, bundy.dns.RRClass('IN'),
+                          'name')
+        self.assertEqual(0, parse_answer(self.__mgr._mod_command_handler(
+            'compact', {'datasource': 'name'}))[0])
+        self.assertEqual([expected_event], sgmt_info.events)
+        self.assertEqual([expected_event], commands)
+
+        # The segment hasn't been loaded yet; nothing can be compacted.
+        sgmt_info.get_reset_param = lambda type: None
+        self.assertEqual(1, parse_answer(self.__mgr._mod_command_handler(
+            'compact', {'datasource': 'name'}))[0])
+        self.assertEqual([expected_event], sgmt_info.events)
+
     def test_reader_notification(self):
         "Test module membership notification callback."
 
@@ -57,6 +57,7 @@
 
 #include <string>
 #include <iostream>
+#include <vector>
 
 #include <boost/foreach.hpp>
 
@@ -71,6 +72,11 @@ namespace {
 
 static const string PROGRAM = "Resolver";
 
+// The number of shards of the resolver cache.  It's fixed at startup, and
+// large enough that the worker threads (if configured) rarely wait for each
+// other's locks.
+const size_t CACHE_SHARD_COUNT = 64;
+
 IOService io_service;
 static boost::shared_ptr<Resolver> resolver;
 
@@ -103,6 +109,8 @@ my_command_handler(const string& command, ConstElementPtr args) {
             LOG_DEBUG(resolver_logger, RESOLVER_DBG_INIT,
                       RESOLVER_SHUTDOWN_RECEIVED);
             io_service.stop();
+        } else if (command == "getstats") {
+            answer = createAnswer(0, resolver->getStatistics());
         }
 
         return (answer);
@@ -174,7 +182,13 @@ main(int argc, char* argv[]) {
         bundy::nsas::NameserverAddressStore nsas(resolver);
         resolver->setNameserverAddressStore(nsas);
 
-        bundy::cache::ResolverCache cache;
+        std::vector<bundy::cache::CacheSizeInfo> cache_info;
+        cache_info.push_back(bundy::cache::CacheSizeInfo(
+                                 bundy::dns::RRClass::IN(),
+                                 MESSAGE_CACHE_DEFAULT_SIZE,
+                                 RRSET_CACHE_DEFAULT_SIZE,
+                                 CACHE_SHARD_COUNT));
+        bundy::cache::ResolverCache cache(cache_info);
         resolver->setCache(cache);
 
         // TODO priming query, remove root from direct
@@ -19,9 +19,11 @@
 #include <netinet/in.h>
 
 #include <algorithm>
+#include <list>
 #include <vector>
 #include <cassert>
 
+#include <boost/bind.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/foreach.hpp>
 
@@ -38,6 +40,8 @@
 #include <exceptions/exceptions.h>
 
 #include <util/buffer.h>
+#include <util/threads/sync.h>
+#include <util/threads/thread.h>
 
 #include <dns/opcode.h>
 #include <dns/rcode.h>
@@ -60,6 +64,8 @@
 using namespace std;
 using namespace bundy;
 using namespace bundy::util;
+using bundy::util::thread::Mutex;
+using bundy::util::thread::Thread;
 using namespace bundy::acl;
 using bundy::acl::dns::RequestACL;
 using namespace bundy::dns;
@@ -82,10 +88,17 @@ public:
         client_timeout_(4000),
         lookup_timeout_(30000),
         retries_(3),
+        prefetch_policy_(5, 10),
+        workers_stopping_(false),
         // we apply "reject all" (implicit default of the loader) ACL by
         // default:
         query_acl_(acl::dns::getRequestLoader().load(Element::fromJSON("[]"))),
-        rec_query_(NULL)
+        rec_query_(NULL),
+        cache_(NULL),
+        io_service_(NULL),
+        prefetch_started_(0),
+        prefetch_hits_(0),
+        prefetch_misses_(0)
     {}
 
     ~ResolverImpl() {
@@ -106,6 +119,16 @@ public:
                                         client_timeout_,
                                         lookup_timeout_,
                                         retries_);
+        Mutex::Locker locker(config_mutex_);
+        cache_ = &cache;
+        io_service_ = &dnss.getIOService();
+    }
+
+    // The cache can be used by the worker threads even before the
+    // recursive query is set up.
+    void setCache(bundy::cache::ResolverCache& cache) {
+        Mutex::Locker locker(config_mutex_);
+        cache_ = &cache;
     }
 
     void queryShutdown() {
@@ -123,7 +146,10 @@ public:
     void setForwardAddresses(const AddressList& upstream,
                              DNSServiceBase* dnss)
     {
-        upstream_ = upstream;
+        {
+            Mutex::Locker locker(config_mutex_);
+            upstream_ = upstream;
+        }
         if (dnss != NULL) {
             if (!upstream_.empty()) {
                 BOOST_FOREACH(const AddressPair& address, upstream) {
@@ -155,21 +181,103 @@ public:
     void resolve(const bundy::dns::QuestionPtr& question,
         const bundy::resolve::ResolverInterface::CallbackPtr& callback);
 
-    enum NormalQueryResult { RECURSION, DROPPED, ERROR };
+    // CACHED is returned for a query answered from the cache.  DEFERRED is
+    // only returned to a worker thread, for a query to be handed over to the
+    // thread running the I/O service.
+    enum NormalQueryResult { RECURSION, DROPPED, ERROR, CACHED, DEFERRED };
     NormalQueryResult processNormalQuery(const IOMessage& io_message,
                                          MessagePtr query_message,
                                          MessagePtr answer_message,
                                          OutputBufferPtr buffer,
-                                         DNSServer* server);
+                                         DNSServer* server,
+                                         bool in_worker);
+
+    // Start recursion (or forwarding) for the query.
+    void startRecursion(MessagePtr query_message, MessagePtr answer_message,
+                        OutputBufferPtr buffer, DNSServer* server);
+
+    // Refresh the answer to the question in the cache.  Called in the
+    // thread running the I/O service.
+    void startPrefetch(const Question& question);
+
+    // Counts the outcome of a prefetch.  It's called in the thread running
+    // the I/O service, like everything touching the counters.
+    class PrefetchCallback : public bundy::resolve::ResolverInterface::Callback {
+    public:
+        PrefetchCallback(ResolverImpl& impl, const Question& question) :
+            impl_(impl), question_(question)
+        {}
+        virtual void success(const MessagePtr response) {
+            // A failed resolution is reported as a SERVFAIL answer.
+            if (response->getRcode() == Rcode::SERVFAIL()) {
+                failure();
+            } else {
+                ++impl_.prefetch_hits_;
+            }
+        }
+        virtual void failure() {
+            LOG_DEBUG(resolver_logger, RESOLVER_DBG_IO,
+                      RESOLVER_PREFETCH_FAILED).arg(question_);
+            ++impl_.prefetch_misses_;
+        }
+    private:
+        ResolverImpl& impl_;
+        const Question question_;
+    };
 
     const RequestACL& getQueryACL() const {
         return (*query_acl_);
     }
 
     void setQueryACL(boost::shared_ptr<const RequestACL> new_acl) {
+        Mutex::Locker locker(config_mutex_);
         query_acl_ = new_acl;
     }
 
+    /// A query waiting for a worker thread.  The server is a clone of the
+    /// one passed to the lookup provider, which may be gone by the time
+    /// the query is processed.
+    struct QueryJob {
+        QueryJob() : io_message(NULL) {}
+        QueryJob(const IOMessage& io_msg, MessagePtr query,
+                 MessagePtr answer, OutputBufferPtr buf, DNSServer* srv) :
+            io_message(&io_msg), query_message(query),
+            answer_message(answer), buffer(buf), server(srv)
+        {}
+        const IOMessage* io_message;
+        MessagePtr query_message;
+        MessagePtr answer_message;
+        OutputBufferPtr buffer;
+        boost::shared_ptr<DNSServer> server;
+    };
+
+    // Called in the thread running the I/O service for a query deferred by
+    // a worker thread.
+    void startDeferredRecursion(const QueryJob& job) {
+        if (rec_query_ == NULL) {
+            // Not set up (yet); there's nobody to resolve it.
+            job.server->resume(false);
+            return;
+        }
+        startRecursion(job.query_message, job.answer_message, job.buffer,
+                       job.server.get());
+    }
+
+    // Stop the worker threads, after they process the queued queries.
+    void stopWorkers() {
+        {
+            // Each worker passes the signal on to the next one when it exits.
+            Mutex::Locker locker(worker_mutex_);
+            workers_stopping_ = true;
+            worker_cond_.signal();
+        }
+        BOOST_FOREACH(const boost::shared_ptr<Thread>& worker, workers_) {
+            worker->wait();
+        }
+        workers_.clear();
+        workers_stopping_ = false;
+    }
+
     /// Currently non-configurable, but will be.
     static const uint16_t DEFAULT_LOCAL_UDPSIZE = 4096;
 
@@ -192,12 +300,42 @@ public:
     /// Number of retries after timeout
     unsigned retries_;
 
+    /// When the cache entries are refreshed before they expire
+    bundy::cache::PrefetchPolicy prefetch_policy_;
+
+    /// Worker threads and the queue of the queries waiting for them.
+    /// The queue and the stopping flag are protected by worker_mutex_.
+    std::vector<boost::shared_ptr<Thread> > workers_;
+    std::list<QueryJob> worker_queue_;
+    bool workers_stopping_;
+    Mutex worker_mutex_;
+    bundy::util::thread::CondVar worker_cond_;
+
 private:
+    /// Protects the configuration the worker threads read: the query ACL,
+    /// the forwarders and the cache.  They are only modified by the thread
+    /// running the I/O service, so it doesn't need the lock to read them.
+    Mutex config_mutex_;
+
     /// ACL on incoming queries
     boost::shared_ptr<const RequestACL> query_acl_;
 
     /// Object to handle upstream queries
     RecursiveQuery* rec_query_;
+
+    /// The cache, used directly by the worker threads
+    bundy::cache::ResolverCache* cache_;
+
+    /// Where the worker threads post the prefetches
+    IOService* io_service_;
+
+public:
+    /// The number of prefetches started, and of those that refreshed the
+    /// answer and that failed.  Only used in the thread running the I/O
+    /// service.
+    uint64_t prefetch_started_;
+    uint64_t prefetch_hits_;
+    uint64_t prefetch_misses_;
 };
 
 /*
@@ -258,9 +396,44 @@ makeErrorMessage(MessagePtr message, MessagePtr answer_message,
     message->toWire(renderer);
 }
 
+// Build the answer to the question from the cache the same way
+// RecursiveQuery::resolve() does, so worker threads can answer it without
+// going through the RecursiveQuery.  If it can't be answered, the answer
+// message is cleared for the recursion, and false is returned.  Otherwise
+// prefetch is set to whether the answer should be refreshed.  The cache
+// sets the rcode of the messages it finds, which may be NXDOMAIN for a
+// name below one known not to exist.
+bool
+answerFromCache(bundy::cache::ResolverCache& cache, const Question& question,
+                Message& answer_message, bool& prefetch)
+{
+    answer_message.setOpcode(Opcode::QUERY());
+    answer_message.addQuestion(question);
+    if (cache.lookup(question.getName(), question.getType(),
+                     question.getClass(), answer_message, &prefetch) &&
+        (answer_message.getRRCount(Message::SECTION_ANSWER) > 0 ||
+         answer_message.getRcode() == Rcode::NXDOMAIN())) {
+        return (true);
+    }
+
+    // Perhaps we only have the one RRset?
+    const RRsetPtr cached_rrset = cache.lookup(question.getName(),
+                                               question.getType(),
+                                               question.getClass(),
+                                               &prefetch);
+    if (cached_rrset) {
+        answer_message.addRRset(Message::SECTION_ANSWER, cached_rrset);
+        answer_message.setRcode(Rcode::NOERROR());
+        return (true);
+    }
+
+    answer_message.clear(Message::RENDER);
+    return (false);
+}
+
 // This is a derived class of \c DNSLookup, to serve as a
 // callback in the asiolink module.  It calls
-// Resolver::processMessage() on a single DNS message.
+// Resolver::dispatchMessage() on a single DNS message.
 class MessageLookup : public DNSLookup {
 public:
     MessageLookup(Resolver* srv) : server_(srv) {}
@@ -272,8 +445,8 @@ public:
                             OutputBufferPtr buffer,
                             DNSServer* server) const
     {
-        server_->processMessage(io_message, query_message,
-                                answer_message, buffer, server);
+        server_->dispatchMessage(io_message, query_message,
+                                 answer_message, buffer, server);
     }
 private:
     Resolver* server_;
@@ -353,6 +526,7 @@ Resolver::Resolver() :
 }
 
 Resolver::~Resolver() {
+    impl_->stopWorkers();
     delete impl_;
     delete dns_lookup_;
     delete dns_answer_;
@@ -373,6 +547,8 @@ void
 Resolver::setCache(bundy::cache::ResolverCache& cache)
 {
     cache_ = &cache;
+    cache_->setPrefetchPolicy(impl_->prefetch_policy_);
+    impl_->setCache(cache);
 }
 
 
@@ -400,6 +576,95 @@ Resolver::processMessage(const IOMessage& io_message,
                          MessagePtr answer_message,
                          OutputBufferPtr buffer,
                          DNSServer* server)
+{
+    processMessageInternal(io_message, query_message, answer_message, buffer,
+                           server, false);
+}
+
+void
+Resolver::dispatchMessage(const IOMessage& io_message,
+                          MessagePtr query_message,
+                          MessagePtr answer_message,
+                          OutputBufferPtr buffer,
+                          DNSServer* server)
+{
+    if (impl_->workers_.empty()) {
+        processMessage(io_message, query_message, answer_message, buffer,
+                       server);
+        return;
+    }
+
+    const ResolverImpl::QueryJob job(io_message, query_message,
+                                     answer_message, buffer,
+                                     server->clone());
+    Mutex::Locker locker(impl_->worker_mutex_);
+    impl_->worker_queue_.push_back(job);
+    impl_->worker_cond_.signal();
+}
+
+void
+Resolver::setWorkerThreads(size_t count) {
+    if (count == impl_->workers_.size()) {
+        return;
+    }
+    LOG_INFO(resolver_logger, RESOLVER_SET_WORKER_THREADS).arg(count);
+
+    impl_->stopWorkers();
+    for (size_t i = 0; i < count; ++i) {
+        impl_->workers_.push_back(boost::shared_ptr<Thread>(
+            new Thread(boost::bind(&Resolver::runWorker, this))));
+    }
+}
+
+size_t
+Resolver::getWorkerThreads() const {
+    return (impl_->workers_.size());
+}
+
+void
+Resolver::runWorker() {
+    while (true) {
+        ResolverImpl::QueryJob job;
+        {
+            Mutex::Locker locker(impl_->worker_mutex_);
+            while (impl_->worker_queue_.empty()) {
+                if (impl_->workers_stopping_) {
+                    impl_->worker_cond_.signal();
+                    return;
+                }
+                impl_->worker_cond_.wait(impl_->worker_mutex_);
+            }
+            job = impl_->worker_queue_.front();
+            impl_->worker_queue_.pop_front();
+        }
+
+        try {
+            if (processMessageInternal(*job.io_message, job.query_message,
+                                       job.answer_message, job.buffer,
+                                       job.server.get(), true)) {
+                // Not in the cache; the thread running the I/O service
+                // resolves it and resumes the server.
+                dnss_->getIOService().post(
+                    boost::bind(&ResolverImpl::startDeferredRecursion, impl_,
+                                job));
+            }
+        } catch (const std::exception& ex) {
+            // In the thread running the I/O service such exceptions are
+            // handled by the caller; here we can only drop the query.
+            LOG_ERROR(resolver_logger, RESOLVER_WORKER_QUERY_FAILED).
+                arg(ex.what());
+            job.server->resume(false);
+        }
+    }
+}
+
+bool
+Resolver::processMessageInternal(const IOMessage& io_message,
+                                 MessagePtr query_message,
+                                 MessagePtr answer_message,
+                                 OutputBufferPtr buffer,
+                                 DNSServer* server,
+                                 bool in_worker)
 {
     InputBuffer request_buffer(io_message.getData(), io_message.getDataSize());
     // First, check the header part.  If we fail even for the base header,
@@ -416,13 +681,13 @@ Resolver::processMessage(const IOMessage& io_message,
             LOG_DEBUG(resolver_logger, RESOLVER_DBG_IO,
                       RESOLVER_UNEXPECTED_RESPONSE);
             server->resume(false);
-            return;
+            return (false);
         }
     } catch (const bundy::Exception& ex) {
         LOG_DEBUG(resolver_logger, RESOLVER_DBG_IO,
                   RESOLVER_HEADER_PROCESSING_FAILED).arg(ex.what());
         server->resume(false);
-        return;
+        return (false);
     }
 
     // Parse the message.  On failure, return an appropriate error.
@@ -435,7 +700,7 @@ Resolver::processMessage(const IOMessage& io_message,
         makeErrorMessage(query_message, answer_message,
                          buffer, error.getRcode());
         server->resume(true);
-        return;
+        return (false);
     } catch (const bundy::Exception& ex) {
         LOG_DEBUG(resolver_logger, RESOLVER_DBG_IO,
                   RESOLVER_MESSAGE_PROCESSING_FAILED)
@@ -443,7 +708,7 @@ Resolver::processMessage(const IOMessage& io_message,
         makeErrorMessage(query_message, answer_message,
                          buffer, Rcode::SERVFAIL());
         server->resume(true);
-        return;
+        return (false);
     } // Other exceptions will be handled at a higher layer.
 
     // Note:  there appears to be no LOG_DEBUG for a successfully-received
@@ -477,17 +742,21 @@ Resolver::processMessage(const IOMessage& io_message,
     } else {
         const ResolverImpl::NormalQueryResult result =
             impl_->processNormalQuery(io_message, query_message,
-                                      answer_message, buffer, server);
+                                      answer_message, buffer, server,
+                                      in_worker);
         if (result == ResolverImpl::RECURSION) {
             // The RecursiveQuery object will post the "resume" event to the
             // DNSServer when an answer arrives, so we don't have to do it now.
-            return;
+            return (false);
+        } else if (result == ResolverImpl::DEFERRED) {
+            return (true);
         } else if (result == ResolverImpl::DROPPED) {
             send_answer = false;
         }
     }
 
     server->resume(send_answer);
+    return (false);
 }
 
 void
@@ -502,17 +771,32 @@ ResolverImpl::processNormalQuery(const IOMessage& io_message,
                                  MessagePtr query_message,
                                  MessagePtr answer_message,
                                  OutputBufferPtr buffer,
-                                 DNSServer* server)
+                                 DNSServer* server,
+                                 bool in_worker)
 {
     const ConstQuestionPtr question = *query_message->beginQuestion();
     const RRType qtype = question->getType();
     // Make cppcheck happy with the reference.
     const RRClass& qclass = question->getClass();
 
+    // Take the configuration we need, as it may be replaced by the thread
+    // running the I/O service while we are in a worker thread.
+    boost::shared_ptr<const RequestACL> query_acl;
+    bool forwarding;
+    bundy::cache::ResolverCache* cache;
+    IOService* io_service;
+    {
+        Mutex::Locker locker(config_mutex_);
+        query_acl = query_acl_;
+        forwarding = !upstream_.empty();
+        cache = cache_;
+        io_service = io_service_;
+    }
+
     // Apply query ACL
     const Client client(io_message);
     const BasicAction query_action(
-        getQueryACL().execute(acl::dns::RequestContext(
+        query_acl->execute(acl::dns::RequestContext(
                                   client.getRequestSourceIPAddress(),
                                   query_message->getTSIGRecord())));
     if (query_action == bundy::acl::REJECT) {
@@ -559,7 +843,38 @@ ResolverImpl::processNormalQuery(const IOMessage& io_message,
         return (ERROR);
     }
 
-    // Everything is okay.  Start resolver.
+    // Everything is okay.  Try the cache first; a worker thread can only
+    // answer from it, as the upstream state is owned by the thread running
+    // the I/O service.  If the answer is popular and about to expire, it's
+    // refreshed in that thread after this answer is sent (unless the
+    // recursive query, which tells the thread, isn't set up yet).
+    if (!forwarding && cache != NULL) {
+        bool prefetch = false;
+        if (answerFromCache(*cache, *question, *answer_message, prefetch)) {
+            LOG_DEBUG(resolver_logger, RESOLVER_DBG_IO,
+                      RESOLVER_CACHED_ANSWER).arg(*question);
+            if (prefetch && io_service != NULL) {
+                io_service->post(boost::bind(&ResolverImpl::startPrefetch,
+                                             this, Question(*question)));
+            }
+            return (CACHED);
+        }
+    }
+    if (in_worker) {
+        return (DEFERRED);
+    }
+
+    startRecursion(query_message, answer_message, buffer, server);
+    return (RECURSION);
+}
+
+void
+ResolverImpl::startRecursion(MessagePtr query_message,
+                             MessagePtr answer_message,
+                             OutputBufferPtr buffer,
+                             DNSServer* server)
+{
+    const ConstQuestionPtr question = *query_message->beginQuestion();
     if (upstream_.empty()) {
         // Processing normal query
         LOG_DEBUG(resolver_logger, RESOLVER_DBG_IO, RESOLVER_NORMAL_QUERY);
@@ -569,8 +884,20 @@ ResolverImpl::processNormalQuery(const IOMessage& io_message,
         LOG_DEBUG(resolver_logger, RESOLVER_DBG_IO, RESOLVER_FORWARD_QUERY);
         rec_query_->forward(query_message, answer_message, buffer, server);
     }
+}
 
-    return (RECURSION);
+void
+ResolverImpl::startPrefetch(const Question& question) {
+    // The configuration may have changed since the prefetch was posted.
+    if (rec_query_ == NULL || !upstream_.empty()) {
+        return;
+    }
+    LOG_DEBUG(resolver_logger, RESOLVER_DBG_IO, RESOLVER_PREFETCH).
+        arg(question);
+    ++prefetch_started_;
+    rec_query_->prefetch(question,
+                         bundy::resolve::ResolverInterface::CallbackPtr(
+                             new PrefetchCallback(*this, question)));
 }
 
 ConstElementPtr
@@ -643,6 +970,34 @@ Resolver::updateConfig(ConstElementPtr config, bool startup) {
             retries = retriesE->intValue();
             set_timeouts = true;
         }
+        const ConstElementPtr worker_threadsE(config->get("worker_threads"));
+        if (worker_threadsE && worker_threadsE->intValue() < 0) {
+            LOG_ERROR(resolver_logger, RESOLVER_NEGATIVE_WORKER_THREADS)
+                      .arg(worker_threadsE->intValue());
+            bundy_throw(BadValue, "Negative number of worker threads");
+        }
+        bundy::cache::PrefetchPolicy prefetch_policy = impl_->prefetch_policy_;
+        const ConstElementPtr prefetch_hitsE(
+            config->get("prefetch_min_hits"));
+        const ConstElementPtr prefetch_thresholdE(
+            config->get("prefetch_threshold"));
+        if (prefetch_hitsE) {
+            if (prefetch_hitsE->intValue() < 0) {
+                LOG_ERROR(resolver_logger, RESOLVER_NEGATIVE_PREFETCH_HITS)
+                          .arg(prefetch_hitsE->intValue());
+                bundy_throw(BadValue, "Negative number of prefetch hits");
+            }
+            prefetch_policy.min_hits = prefetch_hitsE->intValue();
+        }
+        if (prefetch_thresholdE) {
+            if (prefetch_thresholdE->intValue() < 0 ||
+                prefetch_thresholdE->intValue() > 100) {
+                LOG_ERROR(resolver_logger, RESOLVER_BAD_PREFETCH_THRESHOLD)
+                          .arg(prefetch_thresholdE->intValue());
+                bundy_throw(BadValue, "Prefetch threshold out of range");
+            }
+            prefetch_policy.ttl_percent = prefetch_thresholdE->intValue();
+        }
         // Everything OK, so commit the changes
         // listenAddresses can fail to bind, so try them first
         bool need_query_restart = false;
@@ -666,6 +1021,12 @@ Resolver::updateConfig(ConstElementPtr config, bool startup) {
         if (query_acl) {
             setQueryACL(query_acl);
         }
+        if (worker_threadsE) {
+            setWorkerThreads(worker_threadsE->intValue());
+        }
+        if (prefetch_hitsE || prefetch_thresholdE) {
+            setPrefetchPolicy(prefetch_policy);
+        }
         if (startup && listenAddressesE) {
             setListenAddresses(listenAddresses);
             need_query_restart = true;
@@ -755,6 +1116,35 @@ Resolver::getListenAddresses() const {
     return (impl_->listen_);
 }
 
+void
+Resolver::setPrefetchPolicy(const bundy::cache::PrefetchPolicy& policy) {
+    LOG_INFO(resolver_logger, RESOLVER_SET_PREFETCH).arg(policy.min_hits).
+        arg(policy.ttl_percent);
+    impl_->prefetch_policy_ = policy;
+    if (cache_ != NULL) {
+        cache_->setPrefetchPolicy(policy);
+    }
+}
+
+const bundy::cache::PrefetchPolicy&
+Resolver::getPrefetchPolicy() const {
+    return (impl_->prefetch_policy_);
+}
+
+ConstElementPtr
+Resolver::getStatistics() const {
+    const ElementPtr prefetch = Element::createMap();
+    prefetch->set("started", Element::create(
+                      static_cast<long long int>(impl_->prefetch_started_)));
+    prefetch->set("hits", Element::create(
+                      static_cast<long long int>(impl_->prefetch_hits_)));
+    prefetch->set("misses", Element::create(
+                      static_cast<long long int>(impl_->prefetch_misses_)));
+    const ElementPtr stats = Element::createMap();
+    stats->set("prefetch", prefetch);
+    return (stats);
+}
+
 const RequestACL&
 Resolver::getQueryACL() const {
     return (impl_->getQueryACL());
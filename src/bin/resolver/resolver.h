@@ -37,6 +37,7 @@
 
 #include <nsas/nameserver_address_store.h>
 #include <cache/resolver_cache.h>
+#include <cache/prefetch_policy.h>
 
 #include <resolve/resolver_interface.h>
 
@@ -91,6 +92,42 @@ public:
                         bundy::util::OutputBufferPtr buffer,
                         bundy::asiodns::DNSServer* server);
 
+    /// \brief Process an incoming DNS message in a worker thread, if any
+    ///
+    /// This is what the DNS lookup provider of the resolver calls.  If
+    /// there are worker threads (see \c setWorkerThreads()), the message
+    /// is queued for them and this returns immediately; otherwise it's the
+    /// same as \c processMessage().
+    ///
+    /// The workers answer queries from the cache, which can be used from
+    /// multiple threads.  Anything else (recursion and forwarding) is
+    /// handed back to the thread running the I/O service, which owns all
+    /// the upstream state, so the fetches are shared by all the workers.
+    ///
+    /// The parameters are the same as for \c processMessage().  The
+    /// \c server must be clonable, and the message objects must not be
+    /// used by the caller until the server is resumed.
+    void dispatchMessage(const bundy::asiolink::IOMessage& io_message,
+                         bundy::dns::MessagePtr query_message,
+                         bundy::dns::MessagePtr answer_message,
+                         bundy::util::OutputBufferPtr buffer,
+                         bundy::asiodns::DNSServer* server);
+
+    /// \brief Set the number of worker threads processing queries
+    ///
+    /// If it's 0 (the default), every query is processed in the thread
+    /// running the I/O service.  Any running workers first finish the
+    /// queries already queued for them and are stopped, then the new
+    /// number of workers is started.
+    ///
+    /// This must be called from the thread running the I/O service.
+    ///
+    /// \param count The number of worker threads.
+    void setWorkerThreads(size_t count);
+
+    /// \brief Get the number of worker threads processing queries
+    size_t getWorkerThreads() const;
+
     /// \brief Set and get the config session
     bundy::config::ModuleCCSession* getConfigSession() const;
     void setConfigSession(bundy::config::ModuleCCSession* config_session);
@@ -253,7 +290,42 @@ public:
     void setQueryACL(boost::shared_ptr<const bundy::acl::dns::RequestACL>
                      new_acl);
 
+    /// \brief Set when the cache entries are refreshed before they expire.
+    ///
+    /// The policy is applied to the cache, if one is set, and to any cache
+    /// set later.  By default, entries hit at least 5 times are refreshed
+    /// when at most 10 percent of their TTL is left.
+    ///
+    /// \param policy The new prefetch policy.
+    void setPrefetchPolicy(const bundy::cache::PrefetchPolicy& policy);
+
+    /// \brief Get the current prefetch policy.
+    const bundy::cache::PrefetchPolicy& getPrefetchPolicy() const;
+
+    /// \brief Return the statistics of the resolver.
+    ///
+    /// Currently these are the counters of the prefetches, under
+    /// "prefetch": "started" is the number of refreshes started, "hits" the
+    /// number of them that got an answer and "misses" the number of them that
+    /// failed (those still running are counted in neither).
+    bundy::data::ConstElementPtr getStatistics() const;
+
 private:
+    /// \brief The main function of the worker threads.
+    void runWorker();
+
+    /// \brief Implementation of \c processMessage().
+    ///
+    /// If \c in_worker is true, only queries that can be answered from
+    /// the cache are answered, and true is returned for the others, which
+    /// the caller has to hand over to the thread running the I/O service.
+    bool processMessageInternal(const bundy::asiolink::IOMessage& io_message,
+                                bundy::dns::MessagePtr query_message,
+                                bundy::dns::MessagePtr answer_message,
+                                bundy::util::OutputBufferPtr buffer,
+                                bundy::asiodns::DNSServer* server,
+                                bool in_worker);
+
     ResolverImpl* impl_;
     bundy::asiodns::DNSServiceBase* dnss_;
     bundy::asiodns::DNSLookup* dns_lookup_;
@@ -62,6 +62,7 @@ using namespace bundy::asiodns;
 using namespace bundy::asiolink;
 using namespace bundy::server_common;
 using bundy::UnitTestUtil;
+using bundy::cache::PrefetchPolicy;
 
 namespace {
 const char* const TEST_ADDRESS = "127.0.0.1";
@@ -410,6 +411,86 @@ TEST_F(ResolverConfig, invalidTimeoutsConfig) {
         "}", "Negative number of retries");
 }
 
+TEST_F(ResolverConfig, workerThreads) {
+    // By default all queries are handled in the I/O thread.
+    EXPECT_EQ(0, server.getWorkerThreads());
+    server.setWorkerThreads(2);
+    EXPECT_EQ(2, server.getWorkerThreads());
+    // Reducing the number stops all the current workers and starts new ones.
+    server.setWorkerThreads(1);
+    EXPECT_EQ(1, server.getWorkerThreads());
+    server.setWorkerThreads(0);
+    EXPECT_EQ(0, server.getWorkerThreads());
+}
+
+TEST_F(ResolverConfig, workerThreadsConfig) {
+    ConstElementPtr config(Element::fromJSON("{\"worker_threads\": 2}"));
+    configAnswerCheck(server.updateConfig(config), true);
+    EXPECT_EQ(2, server.getWorkerThreads());
+
+    config = Element::fromJSON("{\"worker_threads\": 0}");
+    configAnswerCheck(server.updateConfig(config), true);
+    EXPECT_EQ(0, server.getWorkerThreads());
+}
+
+TEST_F(ResolverConfig, invalidWorkerThreadsConfig) {
+    invalidTest("{"
+        "\"worker_threads\": \"error\""
+        "}", "Wrong worker_threads element type");
+    invalidTest("{"
+        "\"worker_threads\": -1"
+        "}", "Negative number of worker threads");
+}
+
+TEST_F(ResolverConfig, prefetch) {
+    // By default, entries hit 5 times are refreshed at 10% of the TTL.
+    EXPECT_EQ(5, server.getPrefetchPolicy().min_hits);
+    EXPECT_EQ(10, server.getPrefetchPolicy().ttl_percent);
+    server.setPrefetchPolicy(PrefetchPolicy(2, 20));
+    EXPECT_EQ(2, server.getPrefetchPolicy().min_hits);
+    EXPECT_EQ(20, server.getPrefetchPolicy().ttl_percent);
+}
+
+TEST_F(ResolverConfig, prefetchConfig) {
+    ConstElementPtr config(Element::fromJSON("{\"prefetch_min_hits\": 3,"
+                                             " \"prefetch_threshold\": 50}"));
+    configAnswerCheck(server.updateConfig(config), true);
+    EXPECT_EQ(3, server.getPrefetchPolicy().min_hits);
+    EXPECT_EQ(50, server.getPrefetchPolicy().ttl_percent);
+
+    // Each of them can be set alone; 0 disables prefetching.
+    config = Element::fromJSON("{\"prefetch_threshold\": 0}");
+    configAnswerCheck(server.updateConfig(config), true);
+    EXPECT_EQ(3, server.getPrefetchPolicy().min_hits);
+    EXPECT_EQ(0, server.getPrefetchPolicy().ttl_percent);
+}
+
+TEST_F(ResolverConfig, invalidPrefetchConfig) {
+    invalidTest("{"
+        "\"prefetch_min_hits\": \"error\""
+        "}", "Wrong prefetch_min_hits element type");
+    invalidTest("{"
+        "\"prefetch_min_hits\": -1"
+        "}", "Negative number of prefetch hits");
+    invalidTest("{"
+        "\"prefetch_threshold\": -1"
+        "}", "Negative prefetch threshold");
+    invalidTest("{"
+        "\"prefetch_threshold\": 101"
+        "}", "Too large prefetch threshold");
+    // An invalid value doesn't change the policy.
+    EXPECT_EQ(5, server.getPrefetchPolicy().min_hits);
+    EXPECT_EQ(10, server.getPrefetchPolicy().ttl_percent);
+}
+
+TEST_F(ResolverConfig, statistics) {
+    // Nothing has been prefetched yet.
+    const ConstElementPtr stats(server.getStatistics());
+    EXPECT_EQ(0, stats->get("prefetch")->get("started")->intValue());
+    EXPECT_EQ(0, stats->get("prefetch")->get("hits")->intValue());
+    EXPECT_EQ(0, stats->get("prefetch")->get("misses")->intValue());
+}
+
 TEST_F(ResolverConfig, defaultQueryACL) {
     // If no configuration is loaded, the default ACL should reject everything.
     EXPECT_EQ(REJECT, server.getQueryACL().execute(createRequest("192.0.2.1")));
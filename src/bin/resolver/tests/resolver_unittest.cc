@@ -17,12 +17,20 @@
 #include <exceptions/exceptions.h>
 
 #include <dns/name.h>
+#include <dns/rrset.h>
 
+#include <asiolink/io_service.h>
+#include <cache/resolver_cache.h>
 #include <cc/data.h>
 #include <resolver/resolver.h>
 #include <dns/tests/unittest_util.h>
 #include <testutils/dnsmessage_test.h>
+#include <testutils/mockups.h>
 #include <testutils/srv_test.h>
+#include <util/threads/sync.h>
+
+#include <boost/shared_ptr.hpp>
+
 
 using namespace std;
 using namespace bundy::dns;
@@ -30,6 +38,9 @@ using namespace bundy::data;
 using bundy::acl::dns::RequestACL;
 using namespace bundy::testutils;
 using bundy::UnitTestUtil;
+using bundy::util::InputBuffer;
+using bundy::util::thread::CondVar;
+using bundy::util::thread::Mutex;
 
 namespace {
 const char* const TEST_PORT = "53535";
@@ -194,4 +205,144 @@ TEST_F(ResolverTest, queryACL) {
 }
 
 
+
+// A DNS service whose I/O service the test runs by hand, so it can check
+// what the worker threads hand over to it.
+class WorkerTestDNSService : public MockDNSService {
+public:
+    virtual bundy::asiolink::IOService& getIOService() {
+        return (io_service_);
+    }
+private:
+    bundy::asiolink::IOService io_service_;
+};
+
+// A DNSServer recording how it is resumed.  The worker threads use a clone,
+// which shares the record with the original.
+class WorkerTestServer : public bundy::asiodns::DNSServer {
+public:
+    struct State {
+        State() : resumed(0), answered(false), throw_on_answer(false) {}
+        Mutex mutex;
+        CondVar cond;
+        size_t resumed;
+        bool answered;
+        bool throw_on_answer;
+    };
+
+    WorkerTestServer() : state_(new State) {}
+    explicit WorkerTestServer(boost::shared_ptr<State> state) :
+        state_(state)
+    {}
+    virtual void operator()(asio::error_code, size_t) {}
+    virtual void resume(const bool done) {
+        Mutex::Locker locker(state_->mutex);
+        if (done && state_->throw_on_answer) {
+            state_->throw_on_answer = false;
+            bundy_throw(bundy::Unexpected, "resume failure for test");
+        }
+        ++state_->resumed;
+        state_->answered = done;
+        state_->cond.signal();
+    }
+    virtual DNSServer* clone() { return (new WorkerTestServer(state_)); }
+
+    // Wait until the server is resumed, and return whether it has an answer.
+    bool waitForResume() {
+        Mutex::Locker locker(state_->mutex);
+        while (state_->resumed == 0) {
+            state_->cond.wait(state_->mutex);
+        }
+        return (state_->answered);
+    }
+    size_t getResumed() {
+        Mutex::Locker locker(state_->mutex);
+        return (state_->resumed);
+    }
+    void setThrowOnAnswer() {
+        Mutex::Locker locker(state_->mutex);
+        state_->throw_on_answer = true;
+    }
+private:
+    boost::shared_ptr<State> state_;
+};
+
+class ResolverWorkerTest : public ResolverTest {
+protected:
+    ResolverWorkerTest() {
+        server.setDNSService(dnss_);
+        server.setCache(cache_);
+        server.setWorkerThreads(2);
+        UnitTestUtil::createRequestMessage(request_message, opcode,
+                                           default_qid, qname, qclass,
+                                           qtype);
+        createRequestPacket(request_message, IPPROTO_UDP);
+    }
+    ~ResolverWorkerTest() {
+        // The workers must be gone before the cache and the I/O service.
+        server.setWorkerThreads(0);
+    }
+    void dispatchMessage() {
+        server.dispatchMessage(*io_message, parse_message, response_message,
+                               response_obuffer, &worker_server_);
+    }
+    WorkerTestDNSService dnss_;
+    bundy::cache::ResolverCache cache_;
+    WorkerTestServer worker_server_;
+};
+
+TEST_F(ResolverWorkerTest, cachedAnswer) {
+    cache_.update(textToRRset("www.example.com. 3600 IN A 192.0.2.1"));
+    dispatchMessage();
+    EXPECT_TRUE(worker_server_.waitForResume());
+    EXPECT_EQ(1, worker_server_.getResumed());
+
+    // The answer is rendered by the thread running the I/O service.
+    (*server.getDNSAnswerProvider())(*io_message, parse_message,
+                                     response_message, response_obuffer);
+    Message reply(Message::PARSE);
+    InputBuffer buffer(response_obuffer->getData(),
+                       response_obuffer->getLength());
+    reply.fromWire(buffer);
+    headerCheck(reply, default_qid, Rcode::NOERROR(), opcode.getCode(),
+                QR_FLAG | RA_FLAG, 1, 1, 0, 0);
+    const ConstRRsetPtr answer = *reply.beginSection(Message::SECTION_ANSWER);
+    EXPECT_EQ(qname, answer->getName());
+    EXPECT_EQ(RRType::A(), answer->getType());
+    EXPECT_EQ("192.0.2.1", answer->getRdataIterator()->getCurrent().toText());
+}
+
+TEST_F(ResolverWorkerTest, deferredQuery) {
+    // Not in the cache, so the worker hands the query over to the thread
+    // running the I/O service.  It doesn't resume the server itself.
+    // Stopping the workers makes sure it's done with the query.
+    dispatchMessage();
+    server.setWorkerThreads(0);
+    EXPECT_EQ(0, worker_server_.getResumed());
+
+    // The recursive query isn't set up in this test, so the query is
+    // dropped there.
+    dnss_.getIOService().run_one();
+    EXPECT_EQ(1, worker_server_.getResumed());
+    EXPECT_FALSE(worker_server_.waitForResume());
+}
+
+TEST_F(ResolverWorkerTest, workerException) {
+    // If resuming with the answer throws, the worker drops the query
+    // instead.
+    cache_.update(textToRRset("www.example.com. 3600 IN A 192.0.2.1"));
+    worker_server_.setThrowOnAnswer();
+    dispatchMessage();
+    EXPECT_FALSE(worker_server_.waitForResume());
+    EXPECT_EQ(1, worker_server_.getResumed());
+
+    // The worker survives and handles the next query.
+    parse_message->clear(Message::PARSE);
+    response_message->clear(Message::RENDER);
+    createRequestPacket(request_message, IPPROTO_UDP);
+    dispatchMessage();
+    server.setWorkerThreads(0);
+    EXPECT_EQ(2, worker_server_.getResumed());
+}
+
 }
@@ -0,0 +1,173 @@
+// Copyright (C) 2014  Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+// Benchmark of insertions into and lookups in a large RRset cache.  With
+// the default of 10 million entries (which needs a few GB of memory) the
+// cache is much larger than the CPU caches, so it shows the cost of the
+// hash table and LRU operations when nearly every access is a cache miss.
+
+#include <bench/benchmark.h>
+
+#include <cache/rrset_cache.h>
+#include <cache/rrset_entry.h>
+
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdataclass.h>
+#include <dns/rrclass.h>
+#include <dns/rrset.h>
+#include <dns/rrttl.h>
+#include <dns/rrtype.h>
+
+#include <boost/lexical_cast.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+using std::vector;
+using std::string;
+using namespace bundy::bench;
+using namespace bundy::cache;
+using namespace bundy::dns;
+
+namespace {
+class InsertBenchMark {
+public:
+    InsertBenchMark(RRsetCache& cache, const vector<Name>& names) :
+        cache_(cache), names_(names),
+        rdata_(rdata::createRdata(RRType::A(), RRClass::IN(), "192.0.2.1"))
+    {}
+    unsigned int run() {
+        vector<Name>::const_iterator it;
+        const vector<Name>::const_iterator it_end = names_.end();
+        for (it = names_.begin(); it != it_end; ++it) {
+            RRset rrset(*it, RRClass::IN(), RRType::A(), RRTTL(3600));
+            rrset.addRdata(rdata_);
+            cache_.update(rrset, RRSET_TRUST_ANSWER_AA);
+        }
+        return (names_.size());
+    }
+private:
+    RRsetCache& cache_;
+    const vector<Name>& names_;
+    const rdata::ConstRdataPtr rdata_;
+};
+
+class LookupBenchMark {
+public:
+    LookupBenchMark(RRsetCache& cache, const vector<Name>& names) :
+        cache_(cache), names_(names)
+    {}
+    unsigned int run() {
+        vector<Name>::const_iterator it;
+        const vector<Name>::const_iterator it_end = names_.end();
+        for (it = names_.begin(); it != it_end; ++it) {
+            cache_.lookup(*it, RRType::A());
+        }
+        return (names_.size());
+    }
+private:
+    RRsetCache& cache_;
+    const vector<Name>& names_;
+};
+
+void
+usage() {
+    std::cerr << "Usage: rrset_cache_bench [-n iterations] [-e entries] "
+        "[-s shards]" << std::endl;
+    exit (1);
+}
+}
+
+int
+main(int argc, char* argv[]) {
+    int ch;
+    int iteration = 1;
+    size_t entries = 10000000;
+    size_t shards = 1;
+    while ((ch = getopt(argc, argv, "n:e:s:")) != -1) {
+        switch (ch) {
+        case 'n':
+            iteration = atoi(optarg);
+            break;
+        case 'e':
+            entries = atoi(optarg);
+            break;
+        case 's':
+            shards = atoi(optarg);
+            break;
+        case '?':
+        default:
+            usage();
+        }
+    }
+    argc -= optind;
+    if (argc != 0 || entries == 0 || shards == 0) {
+        usage();
+    }
+
+    vector<Name> names;
+    names.reserve(entries);
+    for (size_t i = 0; i < entries; ++i) {
+        names.push_back(Name("h" + boost::lexical_cast<string>(i) + ".d" +
+                             boost::lexical_cast<string>(i % 1000) +
+                             ".example."));
+    }
+
+    // Make the cache large enough for all the entries, so the lookups
+    // measure the hits; the size of the entry of the longest name is a
+    // safe upper bound.
+    const rdata::ConstRdataPtr rdata =
+        rdata::createRdata(RRType::A(), RRClass::IN(), "192.0.2.1");
+    RRset sample(names.back(), RRClass::IN(), RRType::A(), RRTTL(3600));
+    sample.addRdata(rdata);
+    const size_t entry_size = RRsetEntry(sample, RRSET_TRUST_ANSWER_AA).
+        getSize();
+    // Spare room for the shards filling up unevenly.
+    RRsetCache cache(entries * entry_size * 2, RRClass::IN().getCode(),
+                     shards);
+
+    std::cout << "Insertions of " << entries << " RRsets (" << entry_size
+              << " bytes each) into a cache of " << shards << " shard(s)"
+              << std::endl;
+    BenchMark<InsertBenchMark>(iteration, InsertBenchMark(cache, names));
+
+    std::random_shuffle(names.begin(), names.end());
+    std::cout << "Lookups of " << entries << " RRsets in random order"
+              << std::endl;
+    BenchMark<LookupBenchMark>(iteration, LookupBenchMark(cache, names));
+
+    // Insertions into a full cache, each of which evicts an entry.  The
+    // cache only has room for about half of the entries inserted to fill it.
+    for (size_t i = 0; i < entries; ++i) {
+        names[i] = Name("new" + boost::lexical_cast<string>(i) + ".example.");
+    }
+    RRsetCache full_cache(entries / 2 * entry_size, RRClass::IN().getCode(),
+                          shards);
+    InsertBenchMark(full_cache, names).run();
+    std::cout << "Insertions of " << entries << " RRsets into a full cache"
+              << std::endl;
+    for (size_t i = 0; i < entries; ++i) {
+        names[i] = Name("evict" + boost::lexical_cast<string>(i) +
+                        ".example.");
+    }
+    BenchMark<InsertBenchMark>(iteration, InsertBenchMark(full_cache, names));
+
+    return (0);
+}
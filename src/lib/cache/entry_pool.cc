@@ -0,0 +1,108 @@
+// Copyright (C) 2014  Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <config.h>
+
+#include "entry_pool.h"
+
+#include <algorithm>
+
+using bundy::util::thread::Mutex;
+
+namespace bundy {
+namespace cache {
+
+namespace {
+// Blocks are aligned to this, which is enough for anything the cache
+// entries contain.
+const size_t BLOCK_ALIGNMENT = 2 * sizeof(void*);
+}
+
+const size_t EntryPool::DEFAULT_CHUNK_SIZE;
+
+EntryPool::EntryPool(size_t chunk_size) :
+    chunk_size_(chunk_size), block_size_(0), free_blocks_(NULL)
+{}
+
+EntryPool::~EntryPool() {
+    for (std::vector<void*>::const_iterator it = chunks_.begin();
+         it != chunks_.end(); ++it) {
+        ::operator delete(*it);
+    }
+}
+
+void*
+EntryPool::allocate(size_t size) {
+    Mutex::Locker locker(mutex_);
+    if (block_size_ == 0) {
+        block_size_ = std::max(size, sizeof(void*));
+        block_size_ = (block_size_ + BLOCK_ALIGNMENT - 1) /
+            BLOCK_ALIGNMENT * BLOCK_ALIGNMENT;
+    }
+    if (size > block_size_) {
+        return (::operator new(size));
+    }
+
+    if (free_blocks_ == NULL) {
+        // Carve a new chunk into blocks and chain them on the free list.
+        const size_t block_count = std::max<size_t>(chunk_size_ / block_size_,
+                                                    1);
+        char* chunk =
+            static_cast<char*>(::operator new(block_count * block_size_));
+        chunks_.push_back(chunk);
+        for (size_t i = 0; i < block_count; ++i) {
+            void* block = chunk + i * block_size_;
+            *static_cast<void**>(block) = free_blocks_;
+            free_blocks_ = block;
+        }
+    }
+
+    void* block = free_blocks_;
+    free_blocks_ = *static_cast<void**>(block);
+    return (block);
+}
+
+void
+EntryPool::deallocate(void* block, size_t size) {
+    if (block == NULL) {
+        return;
+    }
+
+    Mutex::Locker locker(mutex_);
+    if (size > block_size_) {
+        ::operator delete(block);
+        return;
+    }
+    *static_cast<void**>(block) = free_blocks_;
+    free_blocks_ = block;
+}
+
+size_t
+EntryPool::getBlockSize() const {
+    Mutex::Locker locker(mutex_);
+    return (block_size_);
+}
+
+size_t
+EntryPool::getAllocatedSize() const {
+    Mutex::Locker locker(mutex_);
+    if (block_size_ == 0) {
+        return (0);
+    }
+    return (chunks_.size() * std::max<size_t>(chunk_size_ / block_size_, 1) *
+            block_size_);
+}
+
+} // namespace cache
+} // namespace bundy
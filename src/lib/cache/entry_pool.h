@@ -0,0 +1,166 @@
+// Copyright (C) 2014  Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifndef ENTRY_POOL_H
+#define ENTRY_POOL_H
+
+#include <util/threads/sync.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <vector>
+
+namespace bundy {
+namespace cache {
+
+/// \brief Pool of memory blocks for cache entries.
+///
+/// The blocks are carved out of larger chunks and recycled through a free
+/// list, so creating and destroying cache entries doesn't go to the
+/// general purpose allocator for each of them.  All the blocks of a pool
+/// have the same size, which is set by the first allocation; a request of
+/// a larger size is passed on to the global operator new.
+///
+/// The memory of the chunks is only returned when the pool is destroyed.
+/// As the caches keep their entries under a fixed total size, the pool
+/// doesn't grow beyond what is needed for the largest number of entries
+/// the cache held at once.
+///
+/// The pool can be used from multiple threads; the entries are released
+/// by whoever drops the last reference to them, which may not be the
+/// thread holding the lock of the cache.
+class EntryPool : boost::noncopyable {
+public:
+    /// \brief Constructor.
+    ///
+    /// \param chunk_size The size in bytes of each chunk the blocks are
+    ///     carved out of.  It's rounded up to hold at least one block.
+    explicit EntryPool(size_t chunk_size = DEFAULT_CHUNK_SIZE);
+
+    /// \brief Destructor.
+    ///
+    /// All the blocks must have been deallocated by this point.
+    ~EntryPool();
+
+    /// \brief Allocate a block of the given size.
+    ///
+    /// \throw std::bad_alloc Memory allocation fails.
+    void* allocate(size_t size);
+
+    /// \brief Return a block allocated with \c allocate() to the pool.
+    ///
+    /// \param block The block.
+    /// \param size The size passed to \c allocate() for the block.
+    void deallocate(void* block, size_t size);
+
+    /// \brief Return the size of the blocks, 0 until the first allocation.
+    size_t getBlockSize() const;
+
+    /// \brief Return the total size of the chunks allocated so far.
+    size_t getAllocatedSize() const;
+
+    /// \brief The default size of the chunks.
+    static const size_t DEFAULT_CHUNK_SIZE = 16384;
+
+private:
+    mutable bundy::util::thread::Mutex mutex_; // Protects the members below
+    const size_t chunk_size_;
+    size_t block_size_;
+    void* free_blocks_;
+    std::vector<void*> chunks_;
+};
+
+typedef boost::shared_ptr<EntryPool> EntryPoolPtr;
+
+/// \brief Allocator of objects from an \c EntryPool.
+///
+/// This is meant to be passed to \c boost::allocate_shared(), so the cache
+/// entry and the reference count of the shared pointer are placed in the
+/// same block of the pool.  Each copy of the allocator (including the one
+/// kept with the reference count) holds a reference to the pool, so the
+/// pool lives until the last entry allocated from it is gone, even if the
+/// cache itself has been destroyed.
+template <typename T>
+class PoolAllocator {
+public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template <typename U>
+    struct rebind {
+        typedef PoolAllocator<U> other;
+    };
+
+    /// \brief Constructor.
+    ///
+    /// \param pool The pool to allocate from.  Must not be NULL.
+    explicit PoolAllocator(const EntryPoolPtr& pool) : pool_(pool) {}
+
+    /// \brief Conversion from the allocator for another type.
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>& other) : pool_(other.getPool()) {}
+
+    pointer allocate(size_type n, const void* = 0) {
+        return (static_cast<pointer>(pool_->allocate(n * sizeof(T))));
+    }
+
+    void deallocate(pointer p, size_type n) {
+        pool_->deallocate(p, n * sizeof(T));
+    }
+
+    void construct(pointer p, const T& value) {
+        new(p) T(value);
+    }
+
+    void destroy(pointer p) {
+        p->~T();
+    }
+
+    size_type max_size() const {
+        return (std::numeric_limits<size_type>::max() / sizeof(T));
+    }
+
+    const EntryPoolPtr& getPool() const {
+        return (pool_);
+    }
+
+private:
+    EntryPoolPtr pool_;
+};
+
+template <typename T, typename U>
+bool
+operator==(const PoolAllocator<T>& a, const PoolAllocator<U>& b) {
+    return (a.getPool() == b.getPool());
+}
+
+template <typename T, typename U>
+bool
+operator!=(const PoolAllocator<T>& a, const PoolAllocator<U>& b) {
+    return (a.getPool() != b.getPool());
+}
+
+} // namespace cache
+} // namespace bundy
+
+#endif // ENTRY_POOL_H
@@ -12,6 +12,7 @@
 // OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
 // PERFORMANCE OF THIS SOFTWARE.
 
+#include <dns/labelsequence.h>
 #include <dns/rrset.h>
 #include "local_zone_data.h"
 #include "cache_entry_key.h"
@@ -20,6 +21,7 @@
 
 using namespace std;
 using namespace bundy::dns;
+using bundy::util::thread::Mutex;
 
 namespace bundy {
 namespace cache {
@@ -27,13 +29,32 @@ namespace cache {
 typedef pair<std::string, RRsetPtr> RRsetMapPair;
 typedef map<std::string, RRsetPtr>::iterator RRsetMapIterator;
 
+LocalZoneData::LocalZoneData(uint16_t, size_t shard_count) {
+    if (shard_count == 0) {
+        shard_count = 1;
+    }
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.push_back(boost::shared_ptr<Shard>(new Shard));
+    }
+}
+
+LocalZoneData::Shard&
+LocalZoneData::getShard(const bundy::dns::Name& name) {
+    if (shards_.size() == 1) {
+        return (*shards_[0]);
+    }
+    return (*shards_[LabelSequence(name).getHash(false) % shards_.size()]);
+}
+
 bundy::dns::RRsetPtr
 LocalZoneData::lookup(const bundy::dns::Name& name,
                       const bundy::dns::RRType& type)
 {
     string key = genCacheEntryName(name, type);
-    RRsetMapIterator iter = rrsets_map_.find(key);
-    if (iter == rrsets_map_.end()) {
+    Shard& shard = getShard(name);
+    Mutex::Locker locker(shard.mutex_);
+    RRsetMapIterator iter = shard.rrsets_map_.find(key);
+    if (iter == shard.rrsets_map_.end()) {
         LOG_DEBUG(logger, DBG_TRACE_DATA, CACHE_LOCALZONE_UNKNOWN).arg(key);
         return (RRsetPtr());
     } else {
@@ -52,7 +73,9 @@ LocalZoneData::update(const bundy::dns::AbstractRRset& rrset) {
 
     rrsetCopy(rrset, *rrset_copy);
     RRsetPtr rrset_ptr(rrset_copy);
-    rrsets_map_[key] = rrset_ptr;
+    Shard& shard = getShard(rrset.getName());
+    Mutex::Locker locker(shard.mutex_);
+    shard.rrsets_map_[key] = rrset_ptr;
 }
 
 } // namespace cache
@@ -17,8 +17,10 @@
 
 #include <map>
 #include <string>
+#include <vector>
 #include <boost/shared_ptr.hpp>
 #include <dns/rrset.h>
+#include <util/threads/sync.h>
 
 namespace bundy {
 namespace cache {
@@ -27,14 +29,20 @@ namespace cache {
 /// The object of LocalZoneData represents the data of one
 /// local zone. It provides the interface for lookup the rrsets
 /// in the zone.
+///
+/// The RRsets are split into shards by the hash of the owner name, each
+/// protected by its own lock, so the data can be used from multiple
+/// threads.
 class LocalZoneData {
 public:
     /// \brief Constructor.
     ///
-    /// The passed parameter is expected to be an RR class value, but is not
+    /// The first parameter is expected to be an RR class value, but is not
     /// currently unused.  And this library will be quite likely to
     /// deprecated anyway, so we don't touch it heavily.
-    LocalZoneData(uint16_t) {}
+    ///
+    /// \param shard_count The number of shards the data is split into.
+    LocalZoneData(uint16_t, size_t shard_count = 1);
 
     /// \brief Look up one rrset.
     ///
@@ -54,7 +62,14 @@ public:
     void update(const bundy::dns::AbstractRRset& rrset);
 
 private:
-    std::map<std::string, bundy::dns::RRsetPtr> rrsets_map_; // RRsets of the zone
+    struct Shard {
+        bundy::util::thread::Mutex mutex_; // Protects the map
+        std::map<std::string, bundy::dns::RRsetPtr> rrsets_map_; // RRsets
+    };
+
+    Shard& getShard(const bundy::dns::Name& name);
+
+    std::vector<boost::shared_ptr<Shard> > shards_;
 };
 
 typedef boost::shared_ptr<LocalZoneData> LocalZoneDataPtr;
@@ -0,0 +1,314 @@
+// Copyright (C) 2014  Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifndef LRU_HASH_TABLE_H
+#define LRU_HASH_TABLE_H
+
+#include <nsas/hash.h>
+#include <nsas/hash_key.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <stdint.h>
+#include <limits>
+#include <vector>
+
+namespace bundy {
+namespace cache {
+
+/// \brief Hash table with a built-in LRU list.
+///
+/// This is the storage of the RRset and message caches.  Each entry is kept
+/// in one node, which is at the same time an element of a bucket chain of
+/// the hash table and of the doubly linked LRU list, so looking up, adding,
+/// touching and evicting an entry are all done in constant time, without
+/// any allocation except for growing the table.  (The bucket array doubles
+/// when there are more entries than half the buckets, so the cost of that
+/// is constant when amortized over the insertions, and the chains are
+/// short.)  The nodes themselves are
+/// allocated in chunks and recycled.
+///
+/// The table is limited by the total size of the entries in bytes, as
+/// reported by their \c getSize() method, rather than by their number.
+/// When an entry is added and the total exceeds the limit, the entries at
+/// the eviction end of the LRU list are removed until it fits again (but
+/// the new entry itself is always kept).  Entries known to have expired can
+/// be moved to the eviction end with \c expire(), so they are removed
+/// before any live entry.
+///
+/// The type \c T must have the following methods:
+/// - <code>bundy::nsas::HashKey hashKey() const</code>, which returns the
+///   key of the entry.  The key must refer to data owned by the entry.
+/// - <code>size_t getSize() const</code>, which returns the (estimated)
+///   amount of memory used by the entry, and which must not change while
+///   the entry is in the table.
+///
+/// The table is not thread safe; the caches protect it with a lock.
+template <typename T>
+class LruHashTable : boost::noncopyable {
+public:
+    typedef boost::shared_ptr<T> EntryPtr;
+
+    /// \brief Constructor.
+    ///
+    /// \param max_size The limit of the total size of the entries in
+    ///     bytes.
+    explicit LruHashTable(size_t max_size) :
+        max_size_(max_size), total_size_(0), count_(0),
+        hash_(std::numeric_limits<uint32_t>::max()),
+        buckets_(INITIAL_BUCKETS, static_cast<Node*>(NULL)),
+        lru_head_(NULL), lru_tail_(NULL), free_nodes_(NULL)
+    {}
+
+    /// \brief Destructor.
+    ///
+    /// The entries are released; those still referred to elsewhere
+    /// survive the table.
+    ~LruHashTable() {
+        for (typename std::vector<Node*>::iterator it = node_chunks_.begin();
+             it != node_chunks_.end(); ++it) {
+            delete[] *it;
+        }
+    }
+
+    /// \brief Find an entry.
+    ///
+    /// \param key The key of the entry.
+    /// \param touch If true, the entry found is moved to the most recently
+    ///     used end of the LRU list.
+    /// \return The entry, or NULL if there's no entry for the key.
+    EntryPtr get(const bundy::nsas::HashKey& key, bool touch = true) {
+        Node* node = *findLink(key, hash_(key));
+        if (node == NULL) {
+            return (EntryPtr());
+        }
+        if (touch && node != lru_head_) {
+            unlinkLru(node);
+            pushLruHead(node);
+        }
+        return (node->entry);
+    }
+
+    /// \brief Add an entry.
+    ///
+    /// An entry of the same key already in the table is replaced.  The new
+    /// entry is placed at the most recently used end of the LRU list, and
+    /// then other entries are evicted as long as the total size exceeds the
+    /// limit.
+    ///
+    /// \throw std::bad_alloc Memory allocation fails.
+    void add(const EntryPtr& entry) {
+        const bundy::nsas::HashKey key = entry->hashKey();
+        const uint32_t hash = hash_(key);
+        Node** link = findLink(key, hash);
+        if (*link != NULL) {
+            removeNode(link);
+        } else if (count_ >= buckets_.size() / 2) {
+            grow();
+            link = findLink(key, hash);
+        }
+
+        Node* node = allocateNode();
+        node->entry = entry;
+        node->size = entry->getSize();
+        node->hash = hash;
+        node->chain_next = *link; // The rest of the chain after a replaced one
+        *link = node;
+        pushLruHead(node);
+        total_size_ += node->size;
+        ++count_;
+
+        while (total_size_ > max_size_ && lru_tail_ != node) {
+            removeNode(findLink(lru_tail_->entry->hashKey(),
+                                lru_tail_->hash));
+        }
+    }
+
+    /// \brief Remove an entry.
+    ///
+    /// \return true if the entry was in the table.
+    bool remove(const bundy::nsas::HashKey& key) {
+        Node** link = findLink(key, hash_(key));
+        if (*link == NULL) {
+            return (false);
+        }
+        removeNode(link);
+        return (true);
+    }
+
+    /// \brief Move an entry to the eviction end of the LRU list.
+    ///
+    /// This is for entries that have expired; they are kept (so an update
+    /// can still see them) but will be the first to go when room is needed.
+    ///
+    /// \return true if the entry was in the table.
+    bool expire(const bundy::nsas::HashKey& key) {
+        Node* node = *findLink(key, hash_(key));
+        if (node == NULL) {
+            return (false);
+        }
+        if (node != lru_tail_) {
+            unlinkLru(node);
+            pushLruTail(node);
+        }
+        return (true);
+    }
+
+    /// \brief Remove all the entries.
+    void clear() {
+        while (lru_tail_ != NULL) {
+            removeNode(findLink(lru_tail_->entry->hashKey(),
+                                lru_tail_->hash));
+        }
+    }
+
+    /// \brief Return the number of entries.
+    size_t size() const {
+        return (count_);
+    }
+
+    /// \brief Return the total size of the entries in bytes.
+    size_t getTotalSize() const {
+        return (total_size_);
+    }
+
+    /// \brief Return the limit of the total size of the entries.
+    size_t getMaxSize() const {
+        return (max_size_);
+    }
+
+    /// \brief Return the entry at the eviction end of the LRU list.
+    ///
+    /// \return The entry, or NULL if the table is empty.
+    EntryPtr getEvictionCandidate() const {
+        return (lru_tail_ != NULL ? lru_tail_->entry : EntryPtr());
+    }
+
+private:
+    struct Node {
+        EntryPtr entry;
+        size_t size;       // The size of the entry when it was added
+        uint32_t hash;     // The full hash value of the key
+        Node* chain_next;  // Next node in the same bucket
+        Node* lru_prev;    // Neighbour towards the most recently used end
+        Node* lru_next;    // Neighbour towards the eviction end
+    };
+
+    // Return the link (the bucket or the chain_next of a node) pointing to
+    // the node of the key, or the NULL link at the end of its chain.
+    Node** findLink(const bundy::nsas::HashKey& key, uint32_t hash) {
+        Node** link = &buckets_[hash & (buckets_.size() - 1)];
+        while (*link != NULL) {
+            if ((*link)->hash == hash && (*link)->entry->hashKey() == key) {
+                break;
+            }
+            link = &(*link)->chain_next;
+        }
+        return (link);
+    }
+
+    void unlinkLru(Node* node) {
+        if (node->lru_prev != NULL) {
+            node->lru_prev->lru_next = node->lru_next;
+        } else {
+            lru_head_ = node->lru_next;
+        }
+        if (node->lru_next != NULL) {
+            node->lru_next->lru_prev = node->lru_prev;
+        } else {
+            lru_tail_ = node->lru_prev;
+        }
+    }
+
+    void pushLruHead(Node* node) {
+        node->lru_prev = NULL;
+        node->lru_next = lru_head_;
+        if (lru_head_ != NULL) {
+            lru_head_->lru_prev = node;
+        } else {
+            lru_tail_ = node;
+        }
+        lru_head_ = node;
+    }
+
+    void pushLruTail(Node* node) {
+        node->lru_next = NULL;
+        node->lru_prev = lru_tail_;
+        if (lru_tail_ != NULL) {
+            lru_tail_->lru_next = node;
+        } else {
+            lru_head_ = node;
+        }
+        lru_tail_ = node;
+    }
+
+    // Unlink the node the link points to from both lists and recycle it.
+    void removeNode(Node** link) {
+        Node* node = *link;
+        *link = node->chain_next;
+        unlinkLru(node);
+        total_size_ -= node->size;
+        --count_;
+        node->entry.reset();
+        node->chain_next = free_nodes_;
+        free_nodes_ = node;
+    }
+
+    Node* allocateNode() {
+        if (free_nodes_ == NULL) {
+            Node* chunk = new Node[NODE_CHUNK_SIZE];
+            node_chunks_.push_back(chunk);
+            for (size_t i = 0; i < NODE_CHUNK_SIZE; ++i) {
+                chunk[i].chain_next = free_nodes_;
+                free_nodes_ = &chunk[i];
+            }
+        }
+        Node* node = free_nodes_;
+        free_nodes_ = node->chain_next;
+        return (node);
+    }
+
+    // Double the number of buckets.  The buckets are a power of 2, so the
+    // bucket of a node is selected by the lower bits of its hash.
+    void grow() {
+        std::vector<Node*> buckets(buckets_.size() * 2,
+                                   static_cast<Node*>(NULL));
+        const uint32_t mask = buckets.size() - 1;
+        for (Node* node = lru_head_; node != NULL; node = node->lru_next) {
+            Node*& bucket = buckets[node->hash & mask];
+            node->chain_next = bucket;
+            bucket = node;
+        }
+        buckets_.swap(buckets);
+    }
+
+    static const size_t INITIAL_BUCKETS = 16;
+    static const size_t NODE_CHUNK_SIZE = 64;
+
+    const size_t max_size_;
+    size_t total_size_;
+    size_t count_;
+    const bundy::nsas::Hash hash_;
+    std::vector<Node*> buckets_;
+    Node* lru_head_;            // The most recently used entry
+    Node* lru_tail_;            // The entry to be evicted next
+    Node* free_nodes_;          // Recycled nodes, chained by chain_next
+    std::vector<Node*> node_chunks_;
+};
+
+} // namespace cache
+} // namespace bundy
+
+#endif // LRU_HASH_TABLE_H
@@ -15,14 +15,17 @@
 
 #include <config.h>
 
-#include <nsas/nsas_entry_compare.h>
-#include <nsas/hash_table.h>
-#include <nsas/hash_deleter.h>
 #include "message_cache.h"
 #include "message_utility.h"
 #include "cache_entry_key.h"
 #include "logger.h"
 
+#include <dns/labelsequence.h>
+
+#include <boost/make_shared.hpp>
+
+#include <algorithm>
+
 namespace bundy {
 namespace cache {
 
@@ -30,56 +33,101 @@ using namespace bundy::nsas;
 using namespace bundy::dns;
 using namespace std;
 using namespace MessageUtility;
+using bundy::util::thread::Mutex;
+
+MessageCache::Shard::Shard(size_t cache_size) :
+    message_table_(cache_size), entry_pool_(new EntryPool)
+{}
 
 MessageCache::MessageCache(const RRsetCachePtr& rrset_cache,
-                           uint32_t cache_size, uint16_t message_class,
-                           const RRsetCachePtr& negative_soa_cache):
+                           size_t cache_size, uint16_t message_class,
+                           const RRsetCachePtr& negative_soa_cache,
+                           size_t shard_count):
     message_class_(message_class),
     rrset_cache_(rrset_cache),
-    negative_soa_cache_(negative_soa_cache),
-    message_table_(new NsasEntryCompare<MessageEntry>, cache_size),
-    message_lru_((3 * cache_size),
-                  new HashDeleter<MessageEntry>(message_table_))
+    negative_soa_cache_(negative_soa_cache)
 {
     LOG_DEBUG(logger, DBG_TRACE_BASIC, CACHE_MESSAGES_INIT).arg(cache_size).
         arg(RRClass(message_class));
+    if (shard_count == 0) {
+        shard_count = 1;
+    }
+    const size_t shard_size = std::max<size_t>(cache_size / shard_count, 1);
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.push_back(boost::shared_ptr<Shard>(new Shard(shard_size)));
+    }
 }
 
 MessageCache::~MessageCache() {
     // Destroy all the message entries in the cache.
-    message_lru_.clear();
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        shards_[i]->message_table_.clear();
+    }
     LOG_DEBUG(logger, DBG_TRACE_BASIC, CACHE_MESSAGES_DEINIT);
 }
 
+MessageCache::Shard&
+MessageCache::getShard(const bundy::dns::Name& name) const {
+    if (shards_.size() == 1) {
+        return (*shards_[0]);
+    }
+    return (*shards_[LabelSequence(name).getHash(false) % shards_.size()]);
+}
+
 bool
 MessageCache::lookup(const bundy::dns::Name& qname,
                      const bundy::dns::RRType& qtype,
-                     bundy::dns::Message& response)
+                     bundy::dns::Message& response,
+                     bool* prefetch)
 {
     std::string entry_name = genCacheEntryName(qname, qtype);
     HashKey entry_key = HashKey(entry_name, RRClass(message_class_));
-    MessageEntryPtr msg_entry = message_table_.get(entry_key);
-    if(msg_entry) {
+    Shard& shard = getShard(qname);
+    MessageEntryPtr msg_entry;
+    if (prefetch != NULL) {
+        *prefetch = false;
+    }
+    {
+        Mutex::Locker locker(shard.mutex_);
+        msg_entry = shard.message_table_.get(entry_key);
+        const time_t now = time(NULL);
         // Check whether the message entry has expired.
-       if (msg_entry->getExpireTime() > time(NULL)) {
-            LOG_DEBUG(logger, DBG_TRACE_DATA, CACHE_MESSAGES_FOUND).
-                arg(entry_name);
-            message_lru_.touch(msg_entry);
-            return (msg_entry->genMessage(time(NULL), response));
-        } else {
-            // message entry expires, remove it from hash table and lru list.
+        if (msg_entry && msg_entry->getExpireTime() <= now) {
+            // message entry expires, let it be the next one to be evicted.
             LOG_DEBUG(logger, DBG_TRACE_DATA, CACHE_MESSAGES_EXPIRED).
                 arg(entry_name);
-            message_table_.remove(entry_key);
-            message_lru_.remove(msg_entry);
+            shard.message_table_.expire(entry_key);
             return (false);
-       }
+        }
+        if (msg_entry) {
+            msg_entry->hit();
+            if (prefetch != NULL) {
+                *prefetch = msg_entry->claimPrefetch(now,
+                                                     shard.prefetch_policy_);
+            }
+        }
+    }
+
+    if (msg_entry) {
+        LOG_DEBUG(logger, DBG_TRACE_DATA, CACHE_MESSAGES_FOUND).
+            arg(entry_name);
+        // The message is generated without holding the lock, as the RRsets
+        // are looked up in the RRset cache, which has locks of its own.
+        return (msg_entry->genMessage(time(NULL), response));
     }
 
     LOG_DEBUG(logger, DBG_TRACE_DATA, CACHE_MESSAGES_UNKNOWN).arg(entry_name);
     return (false);
 }
 
+void
+MessageCache::setPrefetchPolicy(const PrefetchPolicy& policy) {
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        Mutex::Locker locker(shards_[i]->mutex_);
+        shards_[i]->prefetch_policy_ = policy;
+    }
+}
+
 bool
 MessageCache::update(const Message& msg) {
     if (!canMessageBeCached(msg)){
@@ -98,23 +146,23 @@ MessageCache::update(const Message& msg) {
                                                (*iter)->getType());
     HashKey entry_key = HashKey(entry_name, RRClass(message_class_));
 
-    // The simplest way to update is removing the old message entry directly.
-    // We have find the existed message entry, since we need to delete it
-    // from lru list too.
-    // TODO, but there should be a better way, since we here have to remove and
-    // add the message entry, maybe there is one way to touch it once.
-    MessageEntryPtr old_msg_entry = message_table_.get(entry_key);
-    if (old_msg_entry) {
+    Shard& shard = getShard((*iter)->getName());
+    // Creating the entry updates the RRset caches, so it's done before
+    // taking the lock of the shard.
+    const MessageEntryPtr msg_entry(boost::allocate_shared<MessageEntry>(
+        PoolAllocator<MessageEntry>(shard.entry_pool_), msg, rrset_cache_,
+        negative_soa_cache_));
+
+    Mutex::Locker locker(shard.mutex_);
+
+    // The old message entry, if any, is simply replaced by the new one.
+    if (shard.message_table_.get(entry_key, false)) {
         LOG_DEBUG(logger, DBG_TRACE_DATA, CACHE_MESSAGES_REMOVE).
             arg((*iter)->getName()).arg((*iter)->getType()).
             arg((*iter)->getClass());
-        message_lru_.remove(old_msg_entry);
     }
-
-    MessageEntryPtr msg_entry(new MessageEntry(msg, rrset_cache_,
-                                               negative_soa_cache_));
-    message_lru_.add(msg_entry);
-    return (message_table_.add(msg_entry, entry_key, true));
+    shard.message_table_.add(msg_entry);
+    return (true);
 }
 
 } // namespace cache
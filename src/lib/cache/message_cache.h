@@ -19,10 +19,13 @@
 #include <boost/shared_ptr.hpp>
 #include <dns/message.h>
 #include "message_entry.h"
-#include <nsas/hash_table.h>
-#include <util/lru_list.h>
+#include "entry_pool.h"
+#include "lru_hash_table.h"
+#include <util/threads/sync.h>
 #include "rrset_cache.h"
 
+#include <vector>
+
 namespace bundy {
 namespace cache {
 
@@ -30,6 +33,11 @@ namespace cache {
 /// The object of MessageCache represents the cache for class-specific
 /// messages.
 ///
+/// Like \c RRsetCache, the cache is split into shards by the hash of the
+/// query name, each with its own lock, so it can be used from multiple
+/// threads, and its size is the estimated memory used by the entries (see
+/// \c MessageEntry::getSize()).
+///
 /// \todo The message cache class should provide the interfaces for
 ///       loading, dumping and resizing.
 class MessageCache {
@@ -40,29 +48,45 @@ private:
 public:
     /// \param rrset_cache The cache that stores the RRsets that the
     ///        message entry will point to
-    /// \param cache_size The size of message cache.
+    /// \param cache_size The size of message cache in bytes.
     /// \param message_class The class of the message cache
     /// \param negative_soa_cache The cache that stores the SOA record
     ///        that comes from negative response message
+    /// \param shard_count The number of shards the cache is split into.
+    ///        The cache size is divided evenly among them.
     MessageCache(const RRsetCachePtr& rrset_cache,
-                 uint32_t cache_size, uint16_t message_class,
-                 const RRsetCachePtr& negative_soa_cache);
+                 size_t cache_size, uint16_t message_class,
+                 const RRsetCachePtr& negative_soa_cache,
+                 size_t shard_count = 1);
 
     /// \brief Destructor function
     virtual ~MessageCache();
 
     /// \brief Look up message in cache.
+    ///
+    /// Like \c RRsetCache::lookup(), each lookup that finds the entry
+    /// counts as a hit on it, and \c prefetch tells the one caller that
+    /// should refresh the entry.  It's only meaningful if true is returned.
+    ///
     /// \param qname Name of the domain for which the message is being sought.
     /// \param qtype Type of the RR for which the message is being sought.
     /// \param message generated response message if the message entry
     ///        can be found.
+    /// \param prefetch If non-NULL, set to whether the entry should be
+    ///        refreshed by the caller.
     ///
     /// \return return true if the message can be found in cache, or else,
     /// return false.
     //TODO Maybe some user just want to get the message_entry.
     bool lookup(const bundy::dns::Name& qname,
                 const bundy::dns::RRType& qtype,
-                bundy::dns::Message& message);
+                bundy::dns::Message& message,
+                bool* prefetch = NULL);
+
+    /// \brief Set when the entries of the cache should be prefetched.
+    ///
+    /// By default they are never prefetched.
+    void setPrefetchPolicy(const PrefetchPolicy& policy);
 
     /// \brief Update the message in the cache with the new one.
     /// If the message doesn't exist in the cache, it will be added
@@ -76,13 +100,25 @@ protected:
     bundy::nsas::HashKey getEntryHashKey(const bundy::dns::Name& name,
                                        const bundy::dns::RRType& type) const;
 
+    /// \brief A part of the cache for the query names that hash to it.
+    struct Shard {
+        Shard(size_t cache_size);
+
+        bundy::util::thread::Mutex mutex_; // Protects the table.
+        LruHashTable<MessageEntry> message_table_;
+        const EntryPoolPtr entry_pool_; // Where the entries are allocated
+        PrefetchPolicy prefetch_policy_; // Also protected by the mutex
+    };
+
+    /// \brief Return the shard for the given query name.
+    Shard& getShard(const bundy::dns::Name& name) const;
+
     // Make these variants be protected for easy unittest.
 protected:
     uint16_t message_class_; // The class of the message cache.
     RRsetCachePtr rrset_cache_;
     RRsetCachePtr negative_soa_cache_;
-    bundy::nsas::HashTable<MessageEntry> message_table_;
-    bundy::util::LruList<MessageEntry> message_lru_;
+    std::vector<boost::shared_ptr<Shard> > shards_;
 };
 
 typedef boost::shared_ptr<MessageCache> MessageCachePtr;
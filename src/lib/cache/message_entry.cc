@@ -16,7 +16,6 @@
 
 #include <limits>
 #include <dns/message.h>
-#include <nsas/nsas_entry.h>
 #include "message_entry.h"
 #include "message_utility.h"
 #include "rrset_cache.h"
@@ -81,11 +80,21 @@ MessageEntry::MessageEntry(const bundy::dns::Message& msg,
     rrset_cache_(rrset_cache),
     negative_soa_cache_(negative_soa_cache),
     headerflag_aa_(false),
-    headerflag_tc_(false)
+    headerflag_tc_(false),
+    rcode_(Rcode::NOERROR()),
+    hits_(0),
+    prefetch_claimed_(false)
 {
     initMessageEntry(msg);
     entry_name_ = genCacheEntryName(query_name_, query_type_);
-    hash_key_ptr_ = new HashKey(entry_name_, RRClass(query_class_));
+
+    size_ = sizeof(*this) + entry_name_.size() + query_name_.size() +
+        rrsets_.capacity() * sizeof(RRsetRef);
+    for (vector<RRsetRef>::const_iterator it = rrsets_.begin();
+         it != rrsets_.end(); ++it) {
+        // A Name keeps the wire data and the offsets of the labels.
+        size_ += it->name_.getLength() * 2;
+    }
 }
 
 bool
@@ -154,6 +163,7 @@ MessageEntry::genMessage(const time_t& time_now,
         // resolver cache
         msg.setHeaderFlag(Message::HEADERFLAG_AA, false);
         msg.setHeaderFlag(Message::HEADERFLAG_TC, headerflag_tc_);
+        msg.setRcode(rcode_);
 
         addRRset(msg, rrset_entry_vec, Message::SECTION_ANSWER);
         addRRset(msg, rrset_entry_vec, Message::SECTION_AUTHORITY);
@@ -307,6 +317,7 @@ MessageEntry::initMessageEntry(const bundy::dns::Message& msg) {
     //TODO better way to cache the header flags?
     headerflag_aa_ = msg.getHeaderFlag(Message::HEADERFLAG_AA);
     headerflag_tc_ = msg.getHeaderFlag(Message::HEADERFLAG_TC);
+    rcode_ = msg.getRcode();
 
     // We only cache the first question in question section.
     // TODO, do we need to support muptiple questions?
@@ -339,8 +350,18 @@ MessageEntry::initMessageEntry(const bundy::dns::Message& msg) {
         }
     }
 
+    ttl_ = min_ttl;
     expire_time_ = time(NULL) + min_ttl;
 }
 
+bool
+MessageEntry::claimPrefetch(time_t now, const PrefetchPolicy& policy) {
+    if (prefetch_claimed_ || !policy.isDue(hits_, ttl_, expire_time_, now)) {
+        return (false);
+    }
+    prefetch_claimed_ = true;
+    return (true);
+}
+
 } // namespace cache
 } // namespace bundy
@@ -15,12 +15,15 @@
 #ifndef MESSAGE_ENTRY_H
 #define MESSAGE_ENTRY_H
 
+#include <limits>
 #include <vector>
 #include <dns/message.h>
+#include <dns/rcode.h>
 #include <dns/rrset.h>
-#include <nsas/nsas_entry.h>
+#include <nsas/hash_key.h>
 #include "rrset_cache.h"
 #include "rrset_entry.h"
+#include "prefetch_policy.h"
 
 namespace bundy {
 namespace cache {
@@ -31,7 +34,7 @@ class RRsetEntry;
 ///
 /// The object of MessageEntry represents one response message
 /// answered to the resolver client.
-class MessageEntry : public bundy::nsas::NsasEntry<MessageEntry> {
+class MessageEntry {
 // Noncopyable
 private:
     MessageEntry(const MessageEntry& source);
@@ -74,7 +77,7 @@ public:
                  const RRsetCachePtr& rrset_cache,
                  const RRsetCachePtr& negative_soa_cache);
 
-    ~MessageEntry() { delete hash_key_ptr_; };
+    ~MessageEntry() {}
 
     /// \brief generate one dns message according
     ///        the rrsets information of the message.
@@ -82,7 +85,8 @@ public:
     /// \param time_now set the ttl of each rrset in the message
     ///        as "expire_time - time_now" (expire_time is the
     ///        expiration time of the rrset).
-    /// \param response generated dns message.
+    /// \param response generated dns message.  Its rcode is set to that
+    ///        of the cached message.
     /// \return return true if the response message can be generated
     ///         from the cached information, or else, return false.
     bool genMessage(const time_t& time_now, bundy::dns::Message& response);
@@ -90,8 +94,9 @@ public:
     /// \brief Get the hash key of the message entry.
     ///
     /// \return return hash key
-    virtual bundy::nsas::HashKey hashKey() const {
-        return (*hash_key_ptr_);
+    bundy::nsas::HashKey hashKey() const {
+        return (bundy::nsas::HashKey(entry_name_,
+                                     bundy::dns::RRClass(query_class_)));
     }
 
     /// \brief Get expire time of the message entry.
@@ -100,6 +105,38 @@ public:
         return (expire_time_);
     }
 
+    /// \brief Get the estimated memory footprint of the entry in bytes.
+    ///
+    /// This is what the entry is charged against the size of the cache.
+    /// The RRsets it refers to are charged to the RRset caches.
+    size_t getSize() const {
+        return (size_);
+    }
+
+    /// \brief Count a hit on the entry.
+    ///
+    /// Like \c claimPrefetch(), the calls must be serialized by the caller
+    /// (the cache holds the lock of the shard).
+    void hit() {
+        if (hits_ < std::numeric_limits<uint32_t>::max()) {
+            ++hits_;
+        }
+    }
+
+    /// \brief Get the number of hits on the entry.
+    uint32_t getHits() const {
+        return (hits_);
+    }
+
+    /// \brief Tell whether the entry should be prefetched now.
+    ///
+    /// This returns true at most once for an entry; see
+    /// \c RRsetEntry::claimPrefetch().
+    ///
+    /// \param now The current time.
+    /// \param policy When the entry is due (see \c PrefetchPolicy).
+    bool claimPrefetch(time_t now, const PrefetchPolicy& policy);
+
     /// \short Protected memebers, so they can be accessed by tests.
     //@{
 protected:
@@ -167,11 +204,12 @@ protected:
                          const time_t time_now);
 
     time_t expire_time_;  // Expiration time of the message.
+    uint32_t ttl_; // Original TTL of the message.
     //@}
 
 private:
     std::string entry_name_; // The name for this entry(name + type)
-    bundy::nsas::HashKey* hash_key_ptr_;  // the key for messag entry in hash table.
+    size_t size_; // Estimated memory footprint
 
     std::vector<RRsetRef> rrsets_;
     RRsetCachePtr rrset_cache_; //Normal rrset cache
@@ -190,6 +228,10 @@ private:
     //TODO, there should be a better way to cache these header flags
     bool headerflag_aa_; // Whether AA bit is set.
     bool headerflag_tc_; // Whether TC bit is set.
+    bundy::dns::Rcode rcode_; // The rcode of the message.
+
+    uint32_t hits_; // Number of hits
+    bool prefetch_claimed_; // Whether the entry has been prefetched
 };
 
 typedef boost::shared_ptr<MessageEntry> MessageEntryPtr;
@@ -0,0 +1,238 @@
+// Copyright (C) 2014  Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <config.h>
+
+#include "negative_name_cache.h"
+#include "entry_pool.h"
+#include "lru_hash_table.h"
+#include "rrset_copy.h"
+#include "logger.h"
+
+#include <dns/rcode.h>
+#include <dns/rdataclass.h>
+#include <dns/rrclass.h>
+#include <dns/rrttl.h>
+#include <dns/rrtype.h>
+#include <util/threads/sync.h>
+
+#include <boost/make_shared.hpp>
+
+#include <algorithm>
+#include <ctime>
+
+using namespace bundy::dns;
+using namespace bundy::nsas;
+using bundy::util::thread::Mutex;
+
+namespace bundy {
+namespace cache {
+
+namespace {
+// The same limit as for the negative answers in the message cache
+// (see MessageEntry).
+const uint32_t MAX_NEGATIVE_NAME_TTL = 10800;
+
+// Estimated overhead of the RDATA of the SOA besides the data itself, as
+// for the RRsets in RRsetEntry.
+const size_t RDATA_OVERHEAD = 64;
+
+// The key of the name in the tables; it refers to the wire data of the
+// labels, which the hash and the comparison of keys treat case
+// insensitively.
+HashKey
+getKey(const LabelSequence& labels, uint16_t rrclass) {
+    size_t len;
+    const uint8_t* data = labels.getData(&len);
+    return (HashKey(reinterpret_cast<const char*>(data), len,
+                    RRClass(rrclass)));
+}
+}
+
+/// A name known not to exist, and the SOA that says so.
+class NegativeNameCache::Entry {
+public:
+    Entry(const Name& name, uint16_t rrclass, const AbstractRRset& soa,
+          uint32_t ttl) :
+        name_(name), class_(rrclass), expire_time_(time(NULL) + ttl),
+        soa_(new RRset(soa.getName(), soa.getClass(), soa.getType(),
+                       RRTTL(ttl)))
+    {
+        rrsetCopy(soa, *soa_);
+        size_ = sizeof(*this) + sizeof(RRset) + name_.getLength() * 2 +
+            soa_->getName().getLength() * 2;
+        for (RdataIteratorPtr it = soa_->getRdataIterator(); !it->isLast();
+             it->next()) {
+            size_ += RDATA_OVERHEAD + it->getCurrent().getLength();
+        }
+    }
+
+    HashKey hashKey() const {
+        return (getKey(LabelSequence(name_), class_));
+    }
+
+    size_t getSize() const {
+        return (size_);
+    }
+
+    const Name& getName() const {
+        return (name_);
+    }
+
+    time_t getExpireTime() const {
+        return (expire_time_);
+    }
+
+    // Return the SOA with the remaining TTL.
+    RRsetPtr getSOA(time_t now) const {
+        const uint32_t ttl = now < expire_time_ ? expire_time_ - now : 0;
+        RRsetPtr soa(new RRset(soa_->getName(), soa_->getClass(),
+                               soa_->getType(), RRTTL(ttl)));
+        rrsetCopy(*soa_, *soa);
+        return (soa);
+    }
+
+private:
+    const Name name_;
+    const uint16_t class_;
+    const time_t expire_time_;
+    const RRsetPtr soa_;
+    size_t size_;
+};
+
+struct NegativeNameCache::Shard {
+    Shard(size_t cache_size) :
+        table_(cache_size), entry_pool_(new EntryPool)
+    {}
+
+    Mutex mutex_; // Protects the table.
+    LruHashTable<Entry> table_;
+    const EntryPoolPtr entry_pool_; // Where the entries are allocated
+};
+
+NegativeNameCache::NegativeNameCache(size_t cache_size, uint16_t cache_class,
+                                     size_t shard_count) :
+    class_(cache_class)
+{
+    LOG_DEBUG(logger, DBG_TRACE_BASIC, CACHE_NEGATIVE_NAME_INIT).
+        arg(cache_size).arg(RRClass(cache_class));
+    if (shard_count == 0) {
+        shard_count = 1;
+    }
+    const size_t shard_size = std::max<size_t>(cache_size / shard_count, 1);
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.push_back(boost::shared_ptr<Shard>(new Shard(shard_size)));
+    }
+}
+
+NegativeNameCache::~NegativeNameCache() {
+    // The entries have to go before the pools they are allocated from.
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        shards_[i]->table_.clear();
+    }
+}
+
+NegativeNameCache::Shard&
+NegativeNameCache::getShard(const LabelSequence& labels) const {
+    if (shards_.size() == 1) {
+        return (*shards_[0]);
+    }
+    return (*shards_[labels.getHash(false) % shards_.size()]);
+}
+
+bool
+NegativeNameCache::update(const Message& msg) {
+    if (msg.getRcode() != Rcode::NXDOMAIN() ||
+        msg.beginQuestion() == msg.endQuestion() ||
+        msg.getRRCount(Message::SECTION_ANSWER) != 0) {
+        return (false);
+    }
+    const Name& qname = (*msg.beginQuestion())->getName();
+
+    // The SOA has to be of a zone the name would be in, or anyone could
+    // deny the names of other zones.
+    ConstRRsetPtr soa;
+    for (RRsetIterator it = msg.beginSection(Message::SECTION_AUTHORITY);
+         it != msg.endSection(Message::SECTION_AUTHORITY); ++it) {
+        if ((*it)->getType() == RRType::SOA() &&
+            (*it)->getClass().getCode() == class_ &&
+            qname.compare((*it)->getName()).getRelation() ==
+            NameComparisonResult::SUBDOMAIN) {
+            soa = *it;
+            break;
+        }
+    }
+    if (!soa || soa->getRdataCount() == 0) {
+        return (false);
+    }
+
+    uint32_t ttl = std::min(soa->getTTL().getValue(), MAX_NEGATIVE_NAME_TTL);
+    const rdata::generic::SOA* soa_rdata =
+        dynamic_cast<const rdata::generic::SOA*>(
+            &soa->getRdataIterator()->getCurrent());
+    if (soa_rdata != NULL) {
+        ttl = std::min(ttl, soa_rdata->getMinimum());
+    }
+    if (ttl == 0) {
+        return (false);
+    }
+    LOG_DEBUG(logger, DBG_TRACE_DATA, CACHE_NEGATIVE_NAME_UPDATE).arg(qname).
+        arg(ttl);
+
+    Shard& shard = getShard(LabelSequence(qname));
+    Mutex::Locker locker(shard.mutex_);
+    shard.table_.add(boost::allocate_shared<Entry>(
+                         PoolAllocator<Entry>(shard.entry_pool_), qname,
+                         class_, *soa, ttl));
+    return (true);
+}
+
+RRsetPtr
+NegativeNameCache::lookup(const Name& qname) {
+    const time_t now = time(NULL);
+    LabelSequence labels(qname);
+    // The root always exists.
+    for (; labels.getLabelCount() > 1; labels.stripLeft(1)) {
+        const HashKey key = getKey(labels, class_);
+        Shard& shard = getShard(labels);
+        Mutex::Locker locker(shard.mutex_);
+        const boost::shared_ptr<Entry> entry = shard.table_.get(key);
+        if (entry) {
+            if (now < entry->getExpireTime()) {
+                LOG_DEBUG(logger, DBG_TRACE_DATA, CACHE_NEGATIVE_NAME_FOUND).
+                    arg(qname).arg(entry->getName());
+                return (entry->getSOA(now));
+            }
+            // Let it be the next one to be evicted.
+            shard.table_.expire(key);
+        }
+    }
+    return (RRsetPtr());
+}
+
+void
+NegativeNameCache::remove(const Name& name) {
+    LabelSequence labels(name);
+    for (; labels.getLabelCount() > 1; labels.stripLeft(1)) {
+        Shard& shard = getShard(labels);
+        Mutex::Locker locker(shard.mutex_);
+        if (shard.table_.remove(getKey(labels, class_))) {
+            LOG_DEBUG(logger, DBG_TRACE_DATA, CACHE_NEGATIVE_NAME_REMOVE).
+                arg(name).arg(labels);
+        }
+    }
+}
+
+} // namespace cache
+} // namespace bundy
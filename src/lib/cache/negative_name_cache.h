@@ -0,0 +1,107 @@
+// Copyright (C) 2014  Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifndef NEGATIVE_NAME_CACHE_H
+#define NEGATIVE_NAME_CACHE_H
+
+#include <dns/labelsequence.h>
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/rrset.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <stdint.h>
+#include <vector>
+
+namespace bundy {
+namespace cache {
+
+/// \brief Cache of the names known not to exist.
+///
+/// An NXDOMAIN answer means the query name has no data of any type, and
+/// that no name below it exists either (RFC 8020).  This cache keeps one
+/// entry per such name, with the SOA RRset of the answer, for the negative
+/// TTL of the answer (the smaller of the TTL and the MINIMUM field of the
+/// SOA, see RFC 2308).  So a single NXDOMAIN answers the queries of all
+/// types for the name and for all the names below it, which the message
+/// cache, keyed by the query name and type, can't do.
+///
+/// Looking up a name probes the name and each of its ancestors, without
+/// copying them, so it takes one hash lookup per label.  The caller is
+/// expected to look for positive data first, so the hits of that are not
+/// slowed down.
+///
+/// Like \c RRsetCache, the cache is split into shards by the hash of the
+/// name, each with its own \c LruHashTable and lock, and it's limited by
+/// the estimated memory used by the entries.
+class NegativeNameCache : boost::noncopyable {
+public:
+    /// \brief Constructor
+    ///
+    /// \param cache_size The size of the cache in bytes, divided evenly
+    ///        among the shards.
+    /// \param cache_class The class of the cache.
+    /// \param shard_count The number of shards the cache is split into.
+    NegativeNameCache(size_t cache_size, uint16_t cache_class,
+                      size_t shard_count = 1);
+
+    /// \brief Destructor
+    ~NegativeNameCache();
+
+    /// \brief Record the name of an NXDOMAIN answer.
+    ///
+    /// The answer is ignored unless its rcode is NXDOMAIN, its answer
+    /// section is empty (with a CNAME chain, the name that doesn't exist
+    /// is the last target, not the query name), the authority section has
+    /// the SOA of a zone above the query name and the negative TTL isn't
+    /// 0.  An entry for the same name is replaced.
+    ///
+    /// \param msg The answer.
+    /// \return true if the query name was recorded.
+    bool update(const bundy::dns::Message& msg);
+
+    /// \brief Find whether a name is known not to exist.
+    ///
+    /// \param qname The name to look up.
+    /// \return The SOA RRset of the NXDOMAIN answer for the name or the
+    ///         closest of its ancestors that's known not to exist, with the
+    ///         remaining TTL, or NULL if there is no such ancestor.
+    bundy::dns::RRsetPtr lookup(const bundy::dns::Name& qname);
+
+    /// \brief Forget that the name and its ancestors don't exist.
+    ///
+    /// This is called when the name is found to exist, so it isn't denied
+    /// by an older answer.
+    ///
+    /// \param name The name that exists.
+    void remove(const bundy::dns::Name& name);
+
+private:
+    class Entry;
+    struct Shard;
+
+    Shard& getShard(const bundy::dns::LabelSequence& labels) const;
+
+    const uint16_t class_; // The class of the cache.
+    std::vector<boost::shared_ptr<Shard> > shards_;
+};
+
+typedef boost::shared_ptr<NegativeNameCache> NegativeNameCachePtr;
+
+} // namespace cache
+} // namespace bundy
+
+#endif // NEGATIVE_NAME_CACHE_H
@@ -0,0 +1,66 @@
+// Copyright (C) 2014  Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifndef PREFETCH_POLICY_H
+#define PREFETCH_POLICY_H
+
+#include <stdint.h>
+#include <ctime>
+
+namespace bundy {
+namespace cache {
+
+/// \brief When a cache entry should be prefetched.
+///
+/// A popular entry is refreshed from upstream shortly before it expires,
+/// so the clients keep getting answers from the cache instead of waiting
+/// for the recursion at every TTL boundary.  An entry is due when it has
+/// been hit at least \c min_hits times and at most \c ttl_percent
+/// percent of its original TTL remains.
+///
+/// The default policy (\c ttl_percent of 0) never prefetches.
+struct PrefetchPolicy {
+    /// \brief Constructor
+    ///
+    /// \param hits The minimum number of hits on the entry.
+    /// \param percent The percentage of the original TTL the remaining TTL
+    ///        has to drop to.  0 disables prefetching.
+    PrefetchPolicy(uint32_t hits = 0, uint32_t percent = 0) :
+        min_hits(hits), ttl_percent(percent)
+    {}
+
+    /// \brief Whether an entry with the given state should be prefetched.
+    ///
+    /// \param hits The number of hits on the entry.
+    /// \param ttl The original TTL of the entry.
+    /// \param expire_time The expiration time of the entry.
+    /// \param now The current time.
+    bool isDue(uint32_t hits, uint32_t ttl, time_t expire_time,
+               time_t now) const
+    {
+        if (ttl_percent == 0 || hits < min_hits || now >= expire_time) {
+            return (false);
+        }
+        return (static_cast<uint64_t>(expire_time - now) * 100 <=
+                static_cast<uint64_t>(ttl) * ttl_percent);
+    }
+
+    uint32_t min_hits; // The minimum number of hits.
+    uint32_t ttl_percent; // The percentage of the TTL left.
+};
+
+} // namespace cache
+} // namespace bundy
+
+#endif // PREFETCH_POLICY_H
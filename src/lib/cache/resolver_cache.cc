@@ -16,6 +16,7 @@
 
 #include "resolver_cache.h"
 #include "dns/message.h"
+#include "dns/rcode.h"
 #include "rrset_cache.h"
 #include "logger.h"
 #include <string>
@@ -37,6 +38,9 @@ ResolverClassCache::ResolverClassCache(const RRClass& cache_class) :
     // SOA rrset cache from negative response
     negative_soa_cache_ = RRsetCachePtr(new RRsetCache(NEGATIVE_RRSET_CACHE_DEFAULT_SIZE,
                                                        cache_class_.getCode()));
+    negative_names_ = NegativeNameCachePtr(
+        new NegativeNameCache(NEGATIVE_NAME_CACHE_DEFAULT_SIZE,
+                              cache_class_.getCode()));
 
     messages_cache_ = MessageCachePtr(new MessageCache(rrsets_cache_,
                                       MESSAGE_CACHE_DEFAULT_SIZE,
@@ -51,16 +55,22 @@ ResolverClassCache::ResolverClassCache(const CacheSizeInfo& cache_info) :
         arg(cache_class_);
     uint16_t klass = cache_class_.getCode();
     // TODO We should find one way to load local zone data.
-    local_zone_data_ = LocalZoneDataPtr(new LocalZoneData(klass));
+    const size_t shards = cache_info.shard_count;
+    local_zone_data_ = LocalZoneDataPtr(new LocalZoneData(klass, shards));
     rrsets_cache_ = RRsetCachePtr(new
-                        RRsetCache(cache_info.rrset_cache_size, klass));
+                        RRsetCache(cache_info.rrset_cache_size, klass,
+                                   shards));
     // SOA rrset cache from negative response
     negative_soa_cache_ = RRsetCachePtr(new RRsetCache(cache_info.rrset_cache_size,
-                                                       klass));
+                                                       klass, shards));
+    negative_names_ = NegativeNameCachePtr(
+        new NegativeNameCache(cache_info.negative_name_cache_size, klass,
+                              shards));
 
     messages_cache_ = MessageCachePtr(new MessageCache(rrsets_cache_,
                                       cache_info.message_cache_size,
-                                      klass, negative_soa_cache_));
+                                      klass, negative_soa_cache_,
+                                      shards));
 }
 
 const RRClass&
@@ -71,7 +81,8 @@ ResolverClassCache::getClass() const {
 bool
 ResolverClassCache::lookup(const bundy::dns::Name& qname,
                       const bundy::dns::RRType& qtype,
-                      bundy::dns::Message& response) const
+                      bundy::dns::Message& response,
+                      bool* prefetch) const
 {
     LOG_DEBUG(logger, DBG_TRACE_DATA, CACHE_RESOLVER_LOOKUP_MSG).
         arg(qname).arg(qtype);
@@ -89,16 +100,35 @@ ResolverClassCache::lookup(const bundy::dns::Name& qname,
         LOG_DEBUG(logger, DBG_TRACE_DATA, CACHE_RESOLVER_LOCAL_MSG).
             arg(qname).arg(qtype);
         response.addRRset(Message::SECTION_ANSWER, rrset_ptr);
+        response.setRcode(Rcode::NOERROR());
+        if (prefetch != NULL) {
+            *prefetch = false;
+        }
         return (true);
     }
 
     // Search in class-specific message cache.
-    return (messages_cache_->lookup(qname, qtype, response));
+    if (messages_cache_->lookup(qname, qtype, response, prefetch)) {
+        return (true);
+    }
+
+    // A name that doesn't exist has no data of any type, and neither has
+    // any name below it.  This is only checked after the positive data, so
+    // it doesn't slow that down.
+    const RRsetPtr soa = negative_names_->lookup(qname);
+    if (soa) {
+        response.setHeaderFlag(Message::HEADERFLAG_AA, false);
+        response.setRcode(Rcode::NXDOMAIN());
+        response.addRRset(Message::SECTION_AUTHORITY, soa);
+        return (true);
+    }
+    return (false);
 }
 
 bundy::dns::RRsetPtr
 ResolverClassCache::lookup(const bundy::dns::Name& qname,
-               const bundy::dns::RRType& qtype) const
+               const bundy::dns::RRType& qtype,
+               bool* prefetch) const
 {
     LOG_DEBUG(logger, DBG_TRACE_DATA, CACHE_RESOLVER_LOOKUP_RRSET).
         arg(qname).arg(qtype);
@@ -109,9 +139,13 @@ ResolverClassCache::lookup(const bundy::dns::Name& qname,
     if (rrset_ptr) {
         LOG_DEBUG(logger, DBG_TRACE_DATA, CACHE_RESOLVER_LOCAL_RRSET).
             arg(qname).arg(qtype);
+        if (prefetch != NULL) {
+            *prefetch = false;
+        }
         return (rrset_ptr);
     } else {
-        RRsetEntryPtr rrset_entry = rrsets_cache_->lookup(qname, qtype);
+        RRsetEntryPtr rrset_entry = rrsets_cache_->lookup(qname, qtype,
+                                                          prefetch);
         if (rrset_entry) {
             return (rrset_entry->getRRset());
         } else {
@@ -120,12 +154,27 @@ ResolverClassCache::lookup(const bundy::dns::Name& qname,
     }
 }
 
+void
+ResolverClassCache::setPrefetchPolicy(const PrefetchPolicy& policy) {
+    messages_cache_->setPrefetchPolicy(policy);
+    rrsets_cache_->setPrefetchPolicy(policy);
+}
+
 bool
 ResolverClassCache::update(const bundy::dns::Message& msg) {
     LOG_DEBUG(logger, DBG_TRACE_DATA, CACHE_RESOLVER_UPDATE_MSG).
         arg((*msg.beginQuestion())->getName()).
         arg((*msg.beginQuestion())->getType()).
         arg((*msg.beginQuestion())->getClass());
+    if (msg.getRcode() == Rcode::NXDOMAIN()) {
+        negative_names_->update(msg);
+    } else if (msg.getRcode() == Rcode::NOERROR() &&
+               (msg.getRRCount(Message::SECTION_ANSWER) > 0 ||
+                msg.getHeaderFlag(Message::HEADERFLAG_AA))) {
+        // An answer, even an authoritative NODATA, shows the name exists
+        // (unlike a referral).
+        negative_names_->remove((*msg.beginQuestion())->getName());
+    }
     return (messages_cache_->update(msg));
 }
 
@@ -182,14 +231,18 @@ bool
 ResolverCache::lookup(const bundy::dns::Name& qname,
                       const bundy::dns::RRType& qtype,
                       const bundy::dns::RRClass& qclass,
-                      bundy::dns::Message& response) const
+                      bundy::dns::Message& response,
+                      bool* prefetch) const
 {
     ResolverClassCache* cc = getClassCache(qclass);
     if (cc) {
-        return (cc->lookup(qname, qtype, response));
+        return (cc->lookup(qname, qtype, response, prefetch));
     } else {
         LOG_DEBUG(logger, DBG_TRACE_DATA, CACHE_RESOLVER_UNKNOWN_CLASS_MSG).
             arg(qclass);
+        if (prefetch != NULL) {
+            *prefetch = false;
+        }
         return (false);
     }
 }
@@ -197,14 +250,18 @@ ResolverCache::lookup(const bundy::dns::Name& qname,
 bundy::dns::RRsetPtr
 ResolverCache::lookup(const bundy::dns::Name& qname,
                const bundy::dns::RRType& qtype,
-               const bundy::dns::RRClass& qclass) const
+               const bundy::dns::RRClass& qclass,
+               bool* prefetch) const
 {
     ResolverClassCache* cc = getClassCache(qclass);
     if (cc) {
-        return (cc->lookup(qname, qtype));
+        return (cc->lookup(qname, qtype, prefetch));
     } else {
         LOG_DEBUG(logger, DBG_TRACE_DATA, CACHE_RESOLVER_UNKNOWN_CLASS_RRSET).
             arg(qclass);
+        if (prefetch != NULL) {
+            *prefetch = false;
+        }
         return (RRsetPtr());
     }
 }
@@ -261,6 +318,16 @@ ResolverCache::update(const bundy::dns::ConstRRsetPtr& rrset_ptr) {
     }
 }
 
+void
+ResolverCache::setPrefetchPolicy(const PrefetchPolicy& policy) {
+    LOG_DEBUG(logger, DBG_TRACE_BASIC, CACHE_RESOLVER_PREFETCH_POLICY).
+        arg(policy.min_hits).arg(policy.ttl_percent);
+    for (std::vector<ResolverClassCache*>::size_type i = 0;
+         i < class_caches_.size(); ++i) {
+        class_caches_[i]->setPrefetchPolicy(policy);
+    }
+}
+
 ResolverClassCache*
 ResolverCache::getClassCache(const bundy::dns::RRClass& cache_class) const {
     for (std::vector<ResolverClassCache*>::size_type i = 0;
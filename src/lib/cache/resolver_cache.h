@@ -23,6 +23,7 @@
 #include <exceptions/exceptions.h>
 #include "message_cache.h"
 #include "rrset_cache.h"
+#include "negative_name_cache.h"
 #include "local_zone_data.h"
 
 namespace bundy {
@@ -30,32 +31,48 @@ namespace cache {
 class RRsetCache;
 
 //TODO a better proper default cache size
-#define MESSAGE_CACHE_DEFAULT_SIZE 10000
-#define RRSET_CACHE_DEFAULT_SIZE   20000
-#define NEGATIVE_RRSET_CACHE_DEFAULT_SIZE   10000
+// The sizes are in bytes.
+#define MESSAGE_CACHE_DEFAULT_SIZE (8 * 1024 * 1024)
+#define RRSET_CACHE_DEFAULT_SIZE   (16 * 1024 * 1024)
+#define NEGATIVE_RRSET_CACHE_DEFAULT_SIZE   (4 * 1024 * 1024)
+#define NEGATIVE_NAME_CACHE_DEFAULT_SIZE   (4 * 1024 * 1024)
 
 /// \brief Cache Size Information.
 ///
 /// Used to initialize the size of class-specific rrset/message cache.
+/// The cache of the SOA RRsets of negative answers has the size of the
+/// RRset cache.
 struct CacheSizeInfo
 {
 public:
     /// \brief Constructor
     ///
     /// \param cls The RRClass code
-    /// \param msg_cache_size The size for the message cache
-    /// \param rst_cache_size The size for the RRset cache
+    /// \param msg_cache_size The size for the message cache in bytes
+    /// \param rst_cache_size The size for the RRset cache in bytes
+    /// \param shards The number of shards each of the caches is split
+    ///        into (see \c RRsetCache).  More shards let more threads use
+    ///        the cache at the same time.
+    /// \param neg_name_cache_size The size for the cache of the names
+    ///        that don't exist (see \c NegativeNameCache) in bytes
     CacheSizeInfo(const bundy::dns::RRClass& cls,
-                  uint32_t msg_cache_size,
-                  uint32_t rst_cache_size):
+                  size_t msg_cache_size,
+                  size_t rst_cache_size,
+                  size_t shards = 1,
+                  size_t neg_name_cache_size =
+                  NEGATIVE_NAME_CACHE_DEFAULT_SIZE):
                     cclass(cls),
                     message_cache_size(msg_cache_size),
-                    rrset_cache_size(rst_cache_size)
+                    rrset_cache_size(rst_cache_size),
+                    shard_count(shards),
+                    negative_name_cache_size(neg_name_cache_size)
     {}
 
     bundy::dns::RRClass cclass; // class of the cache.
-    uint32_t message_cache_size; // the size for message cache.
-    uint32_t rrset_cache_size; // The size for rrset cache.
+    size_t message_cache_size; // the size for message cache in bytes.
+    size_t rrset_cache_size; // The size for rrset cache in bytes.
+    size_t shard_count; // The number of shards of each cache.
+    size_t negative_name_cache_size; // The size for the NXDOMAIN names.
 };
 
 /// \brief  Message has no question section.
@@ -74,6 +91,9 @@ public:
 /// The object of ResolverCache represents the cache of the resolver. It may hold
 /// a list of message/rrset cache which are in different class.
 ///
+/// All the lookup and update interfaces can be called from multiple threads
+/// at the same time; the underlying caches have a lock per shard.
+///
 /// \note Public interaction with the cache should be through ResolverCache,
 /// not directly with this one. (TODO: make this private/hidden/local to the .cc?)
 ///
@@ -104,17 +124,25 @@ public:
     ///        MessageNoQeustionSection will be thrown if it has
     ///        no question section). If the message can be found
     ///        in cache, rrsets for the message will be added to
-    ///        different sections(answer, authority, additional).
+    ///        different sections(answer, authority, additional),
+    ///        and its rcode is set.  If there's no message, but the name
+    ///        is known not to exist (see \c NegativeNameCache), an
+    ///        NXDOMAIN answer is made with the SOA in the authority section.
+    /// \param prefetch If non-NULL, set to whether the message should be
+    ///        refreshed by the caller (see \c MessageCache::lookup()).
     /// \return return true if the message can be found, or else,
     ///         return false.
     bool lookup(const bundy::dns::Name& qname,
                 const bundy::dns::RRType& qtype,
-                bundy::dns::Message& response) const;
+                bundy::dns::Message& response,
+                bool* prefetch = NULL) const;
 
     /// \brief Look up rrset in cache.
     ///
     /// \param qname The query name to look up
     /// \param qtype The query type to look up
+    /// \param prefetch If non-NULL, set to whether the RRset should be
+    ///        refreshed by the caller (see \c RRsetCache::lookup()).
     ///
     /// \return return the shared_ptr of rrset if it can be found,
     ///         or else, return NULL. When looking up, local zone
@@ -124,7 +152,8 @@ public:
     /// \overload
     ///
     bundy::dns::RRsetPtr lookup(const bundy::dns::Name& qname,
-                              const bundy::dns::RRType& qtype) const;
+                              const bundy::dns::RRType& qtype,
+                              bool* prefetch = NULL) const;
 
     /// \brief Update the message in the cache with the new one.
     ///
@@ -133,14 +162,13 @@ public:
     /// \return return true if the message is updated successfully,
     ///         or else, return false.
     ///
+    /// The name of an NXDOMAIN answer is also recorded as nonexistent for
+    /// all types, together with the names below it, and a name of any
+    /// other answer is forgotten as nonexistent.
+    ///
     /// \note the function doesn't do any message validation check,
     ///       the user should make sure the message is valid, and of
     ///       the right class
-    /// TODO: Share the NXDOMAIN info between different type queries
-    ///       current implementation can only cache for the type that
-    ///       user quired, for example, if user query A record of
-    ///       a.example. and the server replied with NXDOMAIN, this
-    ///       should be cached for all the types queries of a.example.
     bool update(const bundy::dns::Message& msg);
 
     /// \brief Update the rrset in the cache with the new one.
@@ -160,6 +188,12 @@ public:
     /// here.
     bool update(const bundy::dns::ConstRRsetPtr& rrset_ptr);
 
+    /// \brief Set when the messages and RRsets should be prefetched.
+    ///
+    /// The local zone data never expires, and the negative SOA cache is
+    /// only used through the messages, so neither is affected.
+    void setPrefetchPolicy(const PrefetchPolicy& policy);
+
     /// \brief Get the RRClass this cache is for
     ///
     /// \return The RRClass of this cache
@@ -197,6 +231,9 @@ private:
 
     /// \brief cache the SOA rrset parsed from the negative response message.
     RRsetCachePtr negative_soa_cache_;
+
+    /// \brief The names of the NXDOMAIN answers.
+    NegativeNameCachePtr negative_names_;
 };
 
 class ResolverCache {
@@ -228,19 +265,28 @@ public:
     ///        MessageNoQeustionSection will be thrown if it has
     ///        no question section). If the message can be found
     ///        in cache, rrsets for the message will be added to
-    ///        different sections(answer, authority, additional).
+    ///        different sections(answer, authority, additional), and
+    ///        its rcode is set.  If the name or one of its ancestors got
+    ///        an NXDOMAIN answer for any type, that's answered instead.
+    /// \param prefetch If non-NULL, set to whether the message is popular
+    ///        and about to expire, so the caller should refresh it from
+    ///        upstream (see \c setPrefetchPolicy()).  Only one of the
+    ///        lookups of an entry gets true.
     /// \return return true if the message can be found, or else,
     ///         return false.
     bool lookup(const bundy::dns::Name& qname,
                 const bundy::dns::RRType& qtype,
                 const bundy::dns::RRClass& qclass,
-                bundy::dns::Message& response) const;
+                bundy::dns::Message& response,
+                bool* prefetch = NULL) const;
 
     /// \brief Look up rrset in cache.
     ///
     /// \param qname The query name to look up
     /// \param qtype The query type to look up
     /// \param qclass The query class to look up
+    /// \param prefetch If non-NULL, set to whether the RRset should be
+    ///        refreshed by the caller, as for the message lookup.
     ///
     /// \return return the shared_ptr of rrset if it can be found,
     ///         or else, return NULL. When looking up, local zone
@@ -251,7 +297,8 @@ public:
     ///
     bundy::dns::RRsetPtr lookup(const bundy::dns::Name& qname,
                               const bundy::dns::RRType& qtype,
-                              const bundy::dns::RRClass& qclass) const;
+                              const bundy::dns::RRClass& qclass,
+                              bool* prefetch = NULL) const;
 
     /// \brief Look up closest enclosing NS rrset in cache.
     ///
@@ -303,6 +350,18 @@ public:
     ///
     bool update(const bundy::dns::ConstRRsetPtr& rrset_ptr);
 
+    /// \brief Set when the cached entries should be prefetched.
+    ///
+    /// The entries count the lookups that find them, and once an entry
+    /// has enough hits and is close enough to its expiration (see
+    /// \c PrefetchPolicy), the next lookup that finds it tells its caller
+    /// to refresh it.  By default entries are never prefetched.
+    ///
+    /// It can be called while other threads use the cache.
+    ///
+    /// \param policy When the entries of all classes are due.
+    void setPrefetchPolicy(const PrefetchPolicy& policy);
+
 private:
     /// \brief Returns the class-specific subcache
     ///
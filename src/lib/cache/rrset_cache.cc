@@ -16,51 +16,72 @@
 
 #include "rrset_cache.h"
 #include "logger.h"
+#include <dns/labelsequence.h>
+#include <algorithm>
 #include <string>
-#include <nsas/nsas_entry_compare.h>
-#include <nsas/hash_table.h>
-#include <nsas/hash_deleter.h>
+
+#include <boost/make_shared.hpp>
 
 using namespace bundy::nsas;
 using namespace bundy::dns;
 using namespace std;
+using bundy::util::thread::Mutex;
 
 namespace bundy {
 namespace cache {
 
-RRsetCache::RRsetCache(uint32_t cache_size,
-                       uint16_t rrset_class):
-    class_(rrset_class),
-    rrset_table_(new NsasEntryCompare<RRsetEntry>, cache_size),
-    rrset_lru_((3 * cache_size),
-                  new HashDeleter<RRsetEntry>(rrset_table_))
+RRsetCache::Shard::Shard(size_t cache_size) :
+    rrset_table_(cache_size), entry_pool_(new EntryPool)
+{}
+
+RRsetCache::RRsetCache(size_t cache_size,
+                       uint16_t rrset_class,
+                       size_t shard_count):
+    class_(rrset_class)
 {
     LOG_DEBUG(logger, DBG_TRACE_BASIC, CACHE_RRSET_INIT).arg(cache_size).
         arg(RRClass(rrset_class));
+    if (shard_count == 0) {
+        shard_count = 1;
+    }
+    const size_t shard_size = std::max<size_t>(cache_size / shard_count, 1);
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.push_back(boost::shared_ptr<Shard>(new Shard(shard_size)));
+    }
+}
+
+RRsetCache::~RRsetCache() {
+    // Clear the rrset entries in the tables.
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        shards_[i]->rrset_table_.clear();
+    }
+}
+
+RRsetCache::Shard&
+RRsetCache::getShard(const bundy::dns::Name& name) const {
+    if (shards_.size() == 1) {
+        return (*shards_[0]);
+    }
+    return (*shards_[LabelSequence(name).getHash(false) % shards_.size()]);
 }
 
 RRsetEntryPtr
-RRsetCache::lookup(const bundy::dns::Name& qname,
-                   const bundy::dns::RRType& qtype)
+RRsetCache::lookupInShard(Shard& shard, const HashKey& entry_key,
+                          const bundy::dns::Name& qname,
+                          const bundy::dns::RRType& qtype)
 {
-    LOG_DEBUG(logger, DBG_TRACE_DATA, CACHE_RRSET_LOOKUP).arg(qname).
-        arg(qtype).arg(RRClass(class_));
-    const string entry_name = genCacheEntryName(qname, qtype);
-
-    RRsetEntryPtr entry_ptr = rrset_table_.get(HashKey(entry_name,
-                                                       RRClass(class_)));
+    // The entry is touched when found; if it has expired it's moved to the
+    // other end below.
+    RRsetEntryPtr entry_ptr = shard.rrset_table_.get(entry_key);
     if (entry_ptr) {
         if (entry_ptr->getExpireTime() > time(NULL)) {
-            // Only touch the non-expired rrset entries
-            rrset_lru_.touch(entry_ptr);
             return (entry_ptr);
         } else {
             LOG_DEBUG(logger, DBG_TRACE_DATA, CACHE_RRSET_EXPIRED).arg(qname).
                 arg(qtype).arg(RRClass(class_));
-            // the rrset entry has expired, so just remove it from
-            // hash table and lru list.
-            rrset_table_.remove(entry_ptr->hashKey());
-            rrset_lru_.remove(entry_ptr);
+            // the rrset entry has expired, so let it be the next one to be
+            // evicted.
+            shard.rrset_table_.expire(entry_key);
         }
     }
 
@@ -69,15 +90,58 @@ RRsetCache::lookup(const bundy::dns::Name& qname,
     return (RRsetEntryPtr());
 }
 
+RRsetEntryPtr
+RRsetCache::lookup(const bundy::dns::Name& qname,
+                   const bundy::dns::RRType& qtype,
+                   bool* prefetch)
+{
+    LOG_DEBUG(logger, DBG_TRACE_DATA, CACHE_RRSET_LOOKUP).arg(qname).
+        arg(qtype).arg(RRClass(class_));
+    const string entry_name = genCacheEntryName(qname, qtype);
+    const HashKey entry_key(entry_name, RRClass(class_));
+
+    Shard& shard = getShard(qname);
+    Mutex::Locker locker(shard.mutex_);
+    const RRsetEntryPtr entry_ptr = lookupInShard(shard, entry_key, qname,
+                                                  qtype);
+    if (prefetch != NULL) {
+        *prefetch = false;
+    }
+    if (entry_ptr) {
+        entry_ptr->hit();
+        if (prefetch != NULL) {
+            *prefetch = entry_ptr->claimPrefetch(time(NULL),
+                                                 shard.prefetch_policy_);
+        }
+    }
+    return (entry_ptr);
+}
+
+void
+RRsetCache::setPrefetchPolicy(const PrefetchPolicy& policy) {
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        Mutex::Locker locker(shards_[i]->mutex_);
+        shards_[i]->prefetch_policy_ = policy;
+    }
+}
+
 RRsetEntryPtr
 RRsetCache::update(const bundy::dns::AbstractRRset& rrset,
                    const RRsetTrustLevel& level)
 {
     LOG_DEBUG(logger, DBG_TRACE_DATA, CACHE_RRSET_UPDATE).arg(rrset.getName()).
         arg(rrset.getType()).arg(rrset.getClass());
+    const string entry_name = genCacheEntryName(rrset.getName(),
+                                                rrset.getType());
+    const HashKey entry_key(entry_name, RRClass(class_));
+
+    Shard& shard = getShard(rrset.getName());
+    Mutex::Locker locker(shard.mutex_);
+
     // TODO: If the RRset is an NS, we should update the NSAS as well
     // lookup first
-    RRsetEntryPtr entry_ptr = lookup(rrset.getName(), rrset.getType());
+    RRsetEntryPtr entry_ptr = lookupInShard(shard, entry_key,
+                                            rrset.getName(), rrset.getType());
     if (entry_ptr) {
         if (entry_ptr->getTrustLevel() > level) {
             LOG_DEBUG(logger, DBG_TRACE_DATA, CACHE_RRSET_UNTRUSTED).
@@ -89,14 +153,13 @@ RRsetCache::update(const bundy::dns::AbstractRRset& rrset,
             LOG_DEBUG(logger, DBG_TRACE_DATA, CACHE_RRSET_REMOVE_OLD).
                 arg(rrset.getName()).arg(rrset.getType()).
                 arg(rrset.getClass());
-            // Remove the old rrset entry from the lru list.
-            rrset_lru_.remove(entry_ptr);
         }
     }
 
-    entry_ptr.reset(new RRsetEntry(rrset, level));
-    rrset_table_.add(entry_ptr, entry_ptr->hashKey(), true);
-    rrset_lru_.add(entry_ptr);
+    // The old entry, if any, is replaced in the table.
+    entry_ptr = boost::allocate_shared<RRsetEntry>(
+        PoolAllocator<RRsetEntry>(shard.entry_pool_), rrset, level);
+    shard.rrset_table_.add(entry_ptr);
     return (entry_ptr);
 }
 
@@ -16,9 +16,14 @@
 #define RRSET_CACHE_H
 
 #include <cache/rrset_entry.h>
-#include <nsas/hash_table.h>
+#include <cache/entry_pool.h>
+#include <cache/lru_hash_table.h>
 
-#include <util/lru_list.h>
+#include <util/threads/sync.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include <vector>
 
 namespace bundy {
 namespace cache {
@@ -29,6 +34,15 @@ class RRsetEntry;
 /// The object of RRsetCache represented the cache for class-specific
 /// RRsets.
 ///
+/// The cache is split into shards by the hash of the owner name, each with
+/// its own \c LruHashTable and lock, so it can be used from multiple
+/// threads and lookups of different names rarely wait for each other.
+///
+/// The size of the cache is the estimated memory used by the entries (see
+/// \c RRsetEntry::getSize()).  The entries are allocated from a pool of
+/// the shard, and an entry that is found to have expired is moved to the
+/// eviction end of the LRU list so it's the first to be replaced.
+///
 /// \todo The rrset cache class should provide the interfaces for
 ///       loading, dumping and resizing.
 class RRsetCache{
@@ -44,22 +58,38 @@ private:
 public:
     /// \brief Constructor and Destructor
     ///
-    /// \param cache_size the size of rrset cache.
+    /// The cache size is divided evenly among the shards.
+    ///
+    /// \param cache_size the size of rrset cache in bytes.
     /// \param rrset_class the class of rrset cache.
-    RRsetCache(uint32_t cache_size, uint16_t rrset_class);
-    virtual ~RRsetCache() {
-        rrset_lru_.clear(); // Clear the rrset entries in the list.
-    }
+    /// \param shard_count the number of shards the cache is split into.
+    RRsetCache(size_t cache_size, uint16_t rrset_class,
+               size_t shard_count = 1);
+    virtual ~RRsetCache();
     //@}
 
     /// \brief Look up rrset in cache.
     ///
+    /// Each successful lookup counts as a hit on the entry.  If
+    /// \c prefetch is non-NULL, it's set to whether the entry found is due
+    /// to be prefetched according to the policy of the cache (see
+    /// \c setPrefetchPolicy()); it's set to true for only one of the
+    /// lookups of the entry.
+    ///
     /// \param qname The query name to look up
     /// \param qtype The query type 
+    /// \param prefetch If non-NULL, set to whether the entry should be
+    ///        refreshed by the caller.
     /// \return return the shared_ptr of rrset entry if it can be
     /// found in the cache, or else, return NULL.
     RRsetEntryPtr lookup(const bundy::dns::Name& qname,
-                         const bundy::dns::RRType& qtype);
+                         const bundy::dns::RRType& qtype,
+                         bool* prefetch = NULL);
+
+    /// \brief Set when the entries of the cache should be prefetched.
+    ///
+    /// By default they are never prefetched.
+    void setPrefetchPolicy(const PrefetchPolicy& policy);
 
     /// \brief Update RRset Cache
     /// Update the rrset entry in the cache with the new one.
@@ -76,9 +106,29 @@ public:
 
     /// \short Protected memebers, so they can be accessed by tests.
 protected:
+    /// \brief A part of the cache for the names that hash to it.
+    struct Shard {
+        Shard(size_t cache_size);
+
+        bundy::util::thread::Mutex mutex_; // Protects the table.
+        LruHashTable<RRsetEntry> rrset_table_;
+        const EntryPoolPtr entry_pool_; // Where the entries are allocated
+        PrefetchPolicy prefetch_policy_; // Also protected by the mutex
+    };
+
+    /// \brief Return the shard for the given owner name.
+    Shard& getShard(const bundy::dns::Name& name) const;
+
+    /// \brief Look up an entry in the shard, expiring it if it's stale.
+    ///
+    /// The lock of the shard must be held by the caller.
+    RRsetEntryPtr lookupInShard(Shard& shard,
+                                const bundy::nsas::HashKey& entry_key,
+                                const bundy::dns::Name& qname,
+                                const bundy::dns::RRType& qtype);
+
     uint16_t class_; // The class of the rrset cache.
-    bundy::nsas::HashTable<RRsetEntry> rrset_table_;
-    bundy::util::LruList<RRsetEntry> rrset_lru_;
+    std::vector<boost::shared_ptr<Shard> > shards_;
 };
 
 typedef boost::shared_ptr<RRsetCache> RRsetCachePtr;
@@ -15,32 +15,71 @@
 #include <config.h>
 
 #include <dns/message.h>
-#include <nsas/nsas_entry.h>
-#include <nsas/fetchable.h>
+#include <dns/rdata.h>
 #include "rrset_entry.h"
 #include "rrset_copy.h"
 
+#include <boost/shared_ptr.hpp>
+
 using namespace bundy::dns;
 using namespace bundy::nsas;
 
 namespace bundy {
 namespace cache {
 
+namespace {
+// Estimated overhead of each RDATA in an RRset besides the data itself:
+// the pointer in the RRset, the Rdata object and its reference count.
+const size_t RDATA_OVERHEAD = 64;
+
+// Estimate the memory used by a copy of the RRset.
+size_t
+getRRsetSize(const AbstractRRset& rrset) {
+    // A Name keeps the wire data and the offsets of the labels.
+    size_t size = sizeof(RRset) + rrset.getName().getLength() * 2;
+    for (RdataIteratorPtr it = rrset.getRdataIterator(); !it->isLast();
+         it->next()) {
+        size += RDATA_OVERHEAD + it->getCurrent().getLength();
+    }
+    return (size);
+}
+}
+
 RRsetEntry::RRsetEntry(const bundy::dns::AbstractRRset& rrset,
                        const RRsetTrustLevel& level):
     entry_name_(genCacheEntryName(rrset.getName(), rrset.getType())),
     expire_time_(time(NULL) + rrset.getTTL().getValue()),
     trust_level_(level),
     rrset_(new RRset(rrset.getName(), rrset.getClass(), rrset.getType(), rrset.getTTL())),
-    hash_key_(HashKey(entry_name_, rrset_->getClass()))
+    hash_key_(HashKey(entry_name_, rrset_->getClass())),
+    hits_(0),
+    prefetch_claimed_(false)
 {
     rrsetCopy(rrset, *(rrset_.get()));
+    size_ = sizeof(*this) + entry_name_.size() + getRRsetSize(*rrset_);
+    if (rrset_->getRRsig()) {
+        size_ += getRRsetSize(*rrset_->getRRsig());
+    }
 }
 
 bundy::dns::RRsetPtr
 RRsetEntry::getRRset() {
-    updateTTL();
-    return (rrset_);
+    const uint32_t ttl = getTTL();
+    if (ttl == rrset_->getTTL().getValue()) {
+        return (rrset_);
+    }
+
+    // The copy is shared by the lookups within the same second (i.e., as
+    // long as the remaining TTL is the same).  Lookups in other threads may
+    // get or replace it at the same time, so it's accessed atomically.
+    boost::shared_ptr<RRset> rrset = boost::atomic_load(&ttl_rrset_);
+    if (!rrset || rrset->getTTL().getValue() != ttl) {
+        rrset.reset(new RRset(rrset_->getName(), rrset_->getClass(),
+                              rrset_->getType(), RRTTL(ttl)));
+        rrsetCopy(*rrset_, *rrset);
+        boost::atomic_store(&ttl_rrset_, rrset);
+    }
+    return (rrset);
 }
 
 time_t
@@ -48,18 +87,24 @@ RRsetEntry::getExpireTime() const {
     return (expire_time_);
 }
 
-void
-RRsetEntry::updateTTL(){
-    uint32_t oldTTL = rrset_->getTTL().getValue();
-    if(oldTTL == 0) {
-        return;
+uint32_t
+RRsetEntry::getTTL() const {
+    if (rrset_->getTTL().getValue() == 0) {
+        return (0);
     }
 
-    uint32_t now = time(NULL);
-    uint32_t newTTL = now < expire_time_ ? (expire_time_ - now) : 0;
+    const time_t now = time(NULL);
+    return (now < expire_time_ ? (expire_time_ - now) : 0);
+}
 
-    RRTTL ttl(newTTL);
-    rrset_->setTTL(ttl);
+bool
+RRsetEntry::claimPrefetch(time_t now, const PrefetchPolicy& policy) {
+    if (prefetch_claimed_ ||
+        !policy.isDue(hits_, rrset_->getTTL().getValue(), expire_time_, now)) {
+        return (false);
+    }
+    prefetch_claimed_ = true;
+    return (true);
 }
 
 } // namespace cache
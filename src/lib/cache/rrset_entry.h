@@ -15,12 +15,13 @@
 #ifndef RRSET_ENTRY_H
 #define RRSET_ENTRY_H
 
+#include <limits>
 #include <dns/rrset.h>
 #include <dns/message.h>
 #include <dns/rrttl.h>
-#include <nsas/nsas_entry.h>
-#include <nsas/fetchable.h>
+#include <nsas/hash_key.h>
 #include "cache_entry_key.h"
+#include "prefetch_policy.h"
 
 namespace bundy {
 namespace cache {
@@ -58,8 +59,7 @@ enum RRsetTrustLevel {
 /// The object of RRsetEntry represents one cached RRset.
 /// Each RRset entry may be refered using shared_ptr by several message
 /// entries.
-class RRsetEntry : public bundy::nsas::NsasEntry<RRsetEntry>
-{
+class RRsetEntry {
     ///
     /// \name Constructors and Destructor
     ///
@@ -82,6 +82,13 @@ public:
 
     /// \brief Return a pointer to a generated RRset
     ///
+    /// The RRset held in the entry is never modified once the entry is
+    /// created, since it may be shared by messages being rendered in other
+    /// threads.  If its TTL has decayed, a copy with the remaining TTL is
+    /// returned instead; the copy is made once per second and shared by
+    /// all the lookups in that second.  The returned RRset must not be
+    /// modified either.
+    ///
     /// \return Pointer to the generated RRset
     bundy::dns::RRsetPtr getRRset();
 
@@ -95,10 +102,7 @@ public:
     /// \brief Get the ttl of the RRset.
     ///
     /// \return The TTL of the RRset
-    uint32_t getTTL() {
-        updateTTL();
-        return (rrset_->getTTL().getValue());
-    }
+    uint32_t getTTL() const;
 
     /// \brief Get the hash key
     ///
@@ -113,16 +117,48 @@ public:
     RRsetTrustLevel getTrustLevel() const {
         return (trust_level_);
     }
-private:
-    /// \brief Update TTL according to expiration time
-    void updateTTL();
 
+    /// \brief Get the estimated memory footprint of the entry in bytes.
+    ///
+    /// This is what the entry is charged against the size of the cache.
+    size_t getSize() const {
+        return (size_);
+    }
+
+    /// \brief Count a hit on the entry.
+    ///
+    /// Like \c claimPrefetch(), the calls must be serialized by the caller
+    /// (the cache holds the lock of the shard).
+    void hit() {
+        if (hits_ < std::numeric_limits<uint32_t>::max()) {
+            ++hits_;
+        }
+    }
+
+    /// \brief Get the number of hits on the entry.
+    uint32_t getHits() const {
+        return (hits_);
+    }
+
+    /// \brief Tell whether the entry should be prefetched now.
+    ///
+    /// This returns true at most once for an entry, so only one refresh is
+    /// started for it however many threads see it at the same time.
+    ///
+    /// \param now The current time.
+    /// \param policy When the entry is due (see \c PrefetchPolicy).
+    bool claimPrefetch(time_t now, const PrefetchPolicy& policy);
 private:
     std::string entry_name_; // The entry name for this rrset entry.
     time_t expire_time_;     // Expiration time of rrset.
     RRsetTrustLevel trust_level_; // RRset trustworthiness.
     boost::shared_ptr<bundy::dns::RRset> rrset_;
+    // The copy of rrset_ with the remaining TTL, last returned by getRRset()
+    boost::shared_ptr<bundy::dns::RRset> ttl_rrset_;
     bundy::nsas::HashKey hash_key_; // RRsetEntry hash key
+    size_t size_; // Estimated memory footprint
+    uint32_t hits_; // Number of hits
+    bool prefetch_claimed_; // Whether the entry has been prefetched
 };
 
 typedef boost::shared_ptr<RRsetEntry> RRsetEntryPtr;
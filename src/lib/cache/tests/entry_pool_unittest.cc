@@ -0,0 +1,90 @@
+// Copyright (C) 2014  Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <config.h>
+
+#include <cache/entry_pool.h>
+
+#include <gtest/gtest.h>
+
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <set>
+#include <string>
+
+using namespace bundy::cache;
+
+namespace {
+
+struct TestEntry {
+    TestEntry(const std::string& name, int value) :
+        name_(name), value_(value)
+    {}
+    std::string name_;
+    int value_;
+};
+
+TEST(EntryPoolTest, allocate) {
+    EntryPool pool(1024);
+    EXPECT_EQ(0, pool.getBlockSize());
+    EXPECT_EQ(0, pool.getAllocatedSize());
+
+    // The block size is set by the first allocation, rounded up for
+    // alignment.
+    void* block = pool.allocate(20);
+    EXPECT_LE(20, pool.getBlockSize());
+    EXPECT_EQ(0, pool.getBlockSize() % sizeof(void*));
+    EXPECT_LT(0, pool.getAllocatedSize());
+
+    // A returned block is reused.
+    pool.deallocate(block, 20);
+    EXPECT_EQ(block, pool.allocate(20));
+
+    // Allocating more blocks than a chunk holds adds chunks; all blocks are
+    // distinct.
+    std::set<void*> blocks;
+    blocks.insert(block);
+    for (int i = 0; i < 200; ++i) {
+        EXPECT_TRUE(blocks.insert(pool.allocate(20)).second);
+    }
+    EXPECT_LE(201 * pool.getBlockSize(), pool.getAllocatedSize());
+    for (std::set<void*>::const_iterator it = blocks.begin();
+         it != blocks.end(); ++it) {
+        pool.deallocate(*it, 20);
+    }
+
+    // A larger size doesn't come from the pool, but works the same.
+    const size_t allocated = pool.getAllocatedSize();
+    void* large = pool.allocate(1000);
+    EXPECT_EQ(allocated, pool.getAllocatedSize());
+    pool.deallocate(large, 1000);
+}
+
+TEST(EntryPoolTest, allocateShared) {
+    boost::shared_ptr<TestEntry> entry;
+    {
+        const EntryPoolPtr pool(new EntryPool);
+        entry = boost::allocate_shared<TestEntry>(
+            PoolAllocator<TestEntry>(pool), "example", 42);
+        EXPECT_EQ("example", entry->name_);
+        EXPECT_EQ(42, entry->value_);
+        EXPECT_LT(sizeof(TestEntry), pool->getBlockSize());
+    }
+    // The pool lives as long as the entry.
+    EXPECT_EQ("example", entry->name_);
+    entry.reset();
+}
+
+}
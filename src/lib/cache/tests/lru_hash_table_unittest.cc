@@ -0,0 +1,200 @@
+// Copyright (C) 2014  Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <config.h>
+
+#include <cache/lru_hash_table.h>
+
+#include <dns/rrclass.h>
+
+#include <gtest/gtest.h>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <string>
+
+using namespace bundy::cache;
+using namespace bundy::nsas;
+using namespace bundy::dns;
+using std::string;
+
+namespace {
+
+// A minimal entry with a name and a size.
+class TestEntry {
+public:
+    TestEntry(const string& name, size_t size) : name_(name), size_(size) {}
+    HashKey hashKey() const {
+        return (HashKey(name_, RRClass::IN()));
+    }
+    size_t getSize() const {
+        return (size_);
+    }
+    const string& getName() const {
+        return (name_);
+    }
+private:
+    const string name_;
+    const size_t size_;
+};
+typedef boost::shared_ptr<TestEntry> TestEntryPtr;
+
+class LruHashTableTest : public ::testing::Test {
+protected:
+    LruHashTableTest() : table_(100) {}
+
+    void add(const string& name, size_t size = 10) {
+        table_.add(TestEntryPtr(new TestEntry(name, size)));
+    }
+
+    bool has(const string& name) {
+        return (static_cast<bool>(table_.get(HashKey(name, RRClass::IN()),
+                                             false)));
+    }
+
+    LruHashTable<TestEntry> table_;
+};
+
+TEST_F(LruHashTableTest, addAndGet) {
+    EXPECT_FALSE(has("a"));
+    add("a");
+    add("b", 20);
+    EXPECT_EQ(2, table_.size());
+    EXPECT_EQ(30, table_.getTotalSize());
+    EXPECT_EQ(100, table_.getMaxSize());
+
+    const TestEntryPtr entry = table_.get(HashKey("a", RRClass::IN()));
+    ASSERT_TRUE(entry);
+    EXPECT_EQ("a", entry->getName());
+    // The keys are case insensitive like the names they are made of.
+    EXPECT_TRUE(has("B"));
+    EXPECT_FALSE(has("c"));
+    EXPECT_FALSE(table_.get(HashKey("a", RRClass::CH())));
+}
+
+TEST_F(LruHashTableTest, replace) {
+    add("a");
+    const TestEntryPtr entry(new TestEntry("a", 30));
+    table_.add(entry);
+    EXPECT_EQ(1, table_.size());
+    EXPECT_EQ(30, table_.getTotalSize());
+    EXPECT_EQ(entry, table_.get(HashKey("a", RRClass::IN())));
+}
+
+TEST_F(LruHashTableTest, remove) {
+    add("a");
+    add("b");
+    EXPECT_TRUE(table_.remove(HashKey("a", RRClass::IN())));
+    EXPECT_FALSE(table_.remove(HashKey("a", RRClass::IN())));
+    EXPECT_FALSE(has("a"));
+    EXPECT_TRUE(has("b"));
+    EXPECT_EQ(1, table_.size());
+    EXPECT_EQ(10, table_.getTotalSize());
+
+    table_.clear();
+    EXPECT_EQ(0, table_.size());
+    EXPECT_EQ(0, table_.getTotalSize());
+    EXPECT_FALSE(has("b"));
+    EXPECT_FALSE(table_.getEvictionCandidate());
+}
+
+TEST_F(LruHashTableTest, evict) {
+    for (int i = 0; i < 10; ++i) {
+        add(boost::lexical_cast<string>(i));
+    }
+    EXPECT_EQ(100, table_.getTotalSize());
+    EXPECT_EQ("0", table_.getEvictionCandidate()->getName());
+
+    // Touching the oldest entry saves it.
+    table_.get(HashKey("0", RRClass::IN()));
+    EXPECT_EQ("1", table_.getEvictionCandidate()->getName());
+    add("10");
+    EXPECT_TRUE(has("0"));
+    EXPECT_FALSE(has("1"));
+
+    // Looking up without touching doesn't.
+    table_.get(HashKey("2", RRClass::IN()), false);
+    add("11");
+    EXPECT_FALSE(has("2"));
+
+    // A larger entry evicts as many as needed.
+    add("big", 35);
+    EXPECT_FALSE(has("3"));
+    EXPECT_FALSE(has("4"));
+    EXPECT_FALSE(has("5"));
+    EXPECT_FALSE(has("6"));
+    EXPECT_TRUE(has("7"));
+    EXPECT_EQ(95, table_.getTotalSize());
+
+    // An entry larger than the whole table is still kept, alone.
+    add("huge", 200);
+    EXPECT_EQ(1, table_.size());
+    EXPECT_TRUE(has("huge"));
+}
+
+TEST_F(LruHashTableTest, expire) {
+    for (int i = 0; i < 10; ++i) {
+        add(boost::lexical_cast<string>(i));
+    }
+    EXPECT_TRUE(table_.expire(HashKey("5", RRClass::IN())));
+    EXPECT_FALSE(table_.expire(HashKey("none", RRClass::IN())));
+    EXPECT_EQ("5", table_.getEvictionCandidate()->getName());
+    // The expired entry is still there until room is needed.
+    EXPECT_TRUE(has("5"));
+    add("10");
+    EXPECT_FALSE(has("5"));
+    EXPECT_TRUE(has("0"));
+}
+
+// The table grows beyond its initial number of buckets, and the nodes of
+// the removed entries are reused.
+TEST(LruHashTableGrowTest, manyEntries) {
+    LruHashTable<TestEntry> table(10000);
+    for (int i = 0; i < 2000; ++i) {
+        table.add(TestEntryPtr(new TestEntry(boost::lexical_cast<string>(i),
+                                             10)));
+    }
+    EXPECT_EQ(1000, table.size());
+    for (int i = 0; i < 2000; ++i) {
+        EXPECT_EQ(i >= 1000,
+                  static_cast<bool>(table.get(HashKey(
+                      boost::lexical_cast<string>(i), RRClass::IN()))));
+    }
+
+    // Replacing entries keeps the others in the same bucket.
+    for (int i = 1000; i < 2000; i += 2) {
+        table.add(TestEntryPtr(new TestEntry(boost::lexical_cast<string>(i),
+                                             10)));
+    }
+    EXPECT_EQ(1000, table.size());
+    for (int i = 1000; i < 2000; ++i) {
+        EXPECT_TRUE(table.get(HashKey(boost::lexical_cast<string>(i),
+                                      RRClass::IN())));
+    }
+}
+
+// Entries still referred to survive the table.
+TEST(LruHashTableGrowTest, entryLifetime) {
+    TestEntryPtr entry(new TestEntry("a", 10));
+    {
+        LruHashTable<TestEntry> table(100);
+        table.add(entry);
+        EXPECT_EQ(2, entry.use_count());
+    }
+    EXPECT_EQ(1, entry.use_count());
+    EXPECT_EQ("a", entry->getName());
+}
+
+}
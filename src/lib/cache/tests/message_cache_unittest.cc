@@ -36,13 +36,29 @@ namespace {
 class DerivedMessageCache: public MessageCache {
 public:
     DerivedMessageCache(const RRsetCachePtr& rrset_cache,
-                        uint32_t cache_size, uint16_t message_class,
+                        size_t cache_size, uint16_t message_class,
                         const RRsetCachePtr& negative_soa_cache):
         MessageCache(rrset_cache, cache_size, message_class, negative_soa_cache)
     {}
 
     uint16_t messages_count() {
-        return message_lru_.size();
+        uint16_t count = 0;
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            count += shards_[i]->message_table_.size();
+        }
+        return (count);
+    }
+
+    // Return the key of the message that would be evicted next (with a
+    // single shard).
+    string getEvictionCandidateKey() {
+        const MessageEntryPtr entry =
+            shards_[0]->message_table_.getEvictionCandidate();
+        if (!entry) {
+            return ("");
+        }
+        const bundy::nsas::HashKey key = entry->hashKey();
+        return (string(key.key, key.keylen));
     }
 };
 
@@ -50,7 +66,7 @@ public:
 /// its internals.
 class DerivedRRsetCache: public RRsetCache {
 public:
-    DerivedRRsetCache(uint32_t cache_size, uint16_t rrset_class):
+    DerivedRRsetCache(size_t cache_size, uint16_t rrset_class):
         RRsetCache(cache_size, rrset_class)
     {}
 
@@ -58,11 +74,7 @@ public:
     void removeRRsetEntry(Name& name, const RRType& type) {
         const string entry_name = genCacheEntryName(name, type);
         HashKey entry_key = HashKey(entry_name, RRClass(class_));
-        RRsetEntryPtr rrset_entry = rrset_table_.get(entry_key);
-        if (rrset_entry) {
-            rrset_lru_.remove(rrset_entry);
-            rrset_table_.remove(entry_key);
-        }
+        getShard(name).rrset_table_.remove(entry_key);
     }
 };
 
@@ -74,12 +86,21 @@ public:
         uint16_t class_ = RRClass::IN().getCode();
         rrset_cache_.reset(new DerivedRRsetCache(RRSET_CACHE_DEFAULT_SIZE, class_));
         negative_soa_cache_.reset(new RRsetCache(NEGATIVE_RRSET_CACHE_DEFAULT_SIZE, class_));
-        // Set the message cache size to 1, make it easy for unittest.
-        message_cache_.reset(new DerivedMessageCache(rrset_cache_, 1, class_,
+        message_cache_.reset(new DerivedMessageCache(rrset_cache_,
+                                                     MESSAGE_CACHE_DEFAULT_SIZE,
+                                                     class_,
                                                      negative_soa_cache_));
     }
 
 protected:
+    // Return the size of the entry of the message in the file.
+    size_t getEntrySize(const char* message_file) {
+        Message msg(Message::PARSE);
+        messageFromFile(msg, message_file);
+        return (MessageEntry(msg, rrset_cache_,
+                             negative_soa_cache_).getSize());
+    }
+
     boost::shared_ptr<DerivedMessageCache> message_cache_;
     boost::shared_ptr<DerivedRRsetCache> rrset_cache_;
     RRsetCachePtr negative_soa_cache_;
@@ -121,10 +142,13 @@ TEST_F(MessageCacheTest, testLookup) {
     updateMessageCache("message_fromWire9", message_cache_);
     EXPECT_EQ(message_cache_->messages_count(), 3);
     // The message entry has been added, but can't be looked up, since
-    // it has expired and is removed automatically when being looked up.
+    // it has expired.  It's kept in the cache, but it's the first to be
+    // evicted.
     Name qname_org("test.example.org.");
     EXPECT_FALSE(message_cache_->lookup(qname_org, RRType::A(), message_render));
-    EXPECT_EQ(message_cache_->messages_count(), 2);
+    EXPECT_EQ(message_cache_->messages_count(), 3);
+    EXPECT_EQ(genCacheEntryName(qname_org, RRType::A()),
+              message_cache_->getEvictionCandidateKey());
 }
 
 TEST_F(MessageCacheTest, testUpdate) {
@@ -143,13 +167,42 @@ TEST_F(MessageCacheTest, testUpdate) {
     EXPECT_FALSE(new_msg_render.getHeaderFlag(Message::HEADERFLAG_AA));
 }
 
+TEST_F(MessageCacheTest, prefetch) {
+    messageFromFile(message_parse, "message_fromWire1");
+    EXPECT_TRUE(message_cache_->update(message_parse));
+    const Name qname("test.example.com.");
+
+    bool prefetch = true;
+    EXPECT_TRUE(message_cache_->lookup(qname, RRType::A(), message_render,
+                                       &prefetch));
+    EXPECT_FALSE(prefetch);
+
+    message_cache_->setPrefetchPolicy(PrefetchPolicy(2, 100));
+    Message msg_render(Message::RENDER);
+    EXPECT_TRUE(message_cache_->lookup(qname, RRType::A(), msg_render,
+                                       &prefetch));
+    EXPECT_TRUE(prefetch);
+    msg_render.clear(Message::RENDER);
+    EXPECT_TRUE(message_cache_->lookup(qname, RRType::A(), msg_render,
+                                       &prefetch));
+    EXPECT_FALSE(prefetch);
+}
+
 TEST_F(MessageCacheTest, testCacheLruBehavior) {
+    // Make the cache just large enough for the first three messages.
+    const size_t cache_size = getEntrySize("message_fromWire1") +
+        getEntrySize("message_fromWire2") + getEntrySize("message_fromWire4");
+    message_cache_.reset(new DerivedMessageCache(rrset_cache_, cache_size,
+                                                 RRClass::IN().getCode(),
+                                                 negative_soa_cache_));
+
     // qname = "test.example.com.", qtype = A
     updateMessageCache("message_fromWire1", message_cache_);
     // qname = "test.example.net.", qtype = A
     updateMessageCache("message_fromWire2", message_cache_);
     // qname = "example.com.", qtype = SOA
     updateMessageCache("message_fromWire4", message_cache_);
+    EXPECT_EQ(3, message_cache_->messages_count());
 
     Name qname_net("test.example.net.");
     EXPECT_TRUE(message_cache_->lookup(qname_net, RRType::A(), message_render));
@@ -158,6 +211,7 @@ TEST_F(MessageCacheTest, testCacheLruBehavior) {
     updateMessageCache("message_fromWire5", message_cache_);
     Name qname_com("test.example.com.");
     EXPECT_FALSE(message_cache_->lookup(qname_com, RRType::A(), message_render));
+    EXPECT_TRUE(message_cache_->lookup(qname_net, RRType::A(), message_render));
 }
 
 }   // namespace
@@ -18,6 +18,7 @@
 #include <gtest/gtest.h>
 #include <dns/rrset.h>
 #include <dns/rcode.h>
+#include <dns/question.h>
 #include "resolver_cache.h"
 #include "cache_test_messagefromfile.h"
 
@@ -31,7 +32,8 @@ class NegativeCacheTest: public testing::Test{
 public:
     NegativeCacheTest() {
         vector<CacheSizeInfo> vec;
-        CacheSizeInfo class_in(RRClass::IN(), 100, 200);
+        CacheSizeInfo class_in(RRClass::IN(), MESSAGE_CACHE_DEFAULT_SIZE,
+                               RRSET_CACHE_DEFAULT_SIZE);
         vec.push_back(class_in);
         cache = new ResolverCache(vec);
     }
@@ -126,6 +128,39 @@ TEST_F(NegativeCacheTest, testNXDOMAIN){
     EXPECT_LE(soa_ttl2.getValue(), 172798);
 }
 
+TEST_F(NegativeCacheTest, testNXDOMAINOtherTypes){
+    // NXDOMAIN response for nonexist.example.com/A
+    Message msg_nxdomain(Message::PARSE);
+    messageFromFile(msg_nxdomain, "message_nxdomain_with_soa.wire");
+    cache->update(msg_nxdomain);
+
+    // It answers the other types of the name, and the names below it,
+    // for the negative TTL, limited to 3 hours.
+    const Name names[] = { Name("nonexist.example.com."),
+                           Name("a.b.nonexist.example.com.") };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+        Message msg(Message::RENDER);
+        msg.addQuestion(Question(names[i], RRClass::IN(), RRType::AAAA()));
+        EXPECT_TRUE(cache->lookup(names[i], RRType::AAAA(), RRClass::IN(),
+                                  msg));
+        EXPECT_EQ(Rcode::NXDOMAIN(), msg.getRcode());
+        EXPECT_EQ(0, msg.getRRCount(Message::SECTION_ANSWER));
+        ASSERT_EQ(1, msg.getRRCount(Message::SECTION_AUTHORITY));
+        const RRsetPtr soa = *msg.beginSection(Message::SECTION_AUTHORITY);
+        EXPECT_EQ(RRType::SOA(), soa->getType());
+        EXPECT_EQ(Name("example.com."), soa->getName());
+        EXPECT_GE(soa->getTTL().getValue(), 10799);
+        EXPECT_LE(soa->getTTL().getValue(), 10800);
+    }
+
+    // The zone itself exists.
+    Message msg_soa(Message::RENDER);
+    msg_soa.addQuestion(Question(Name("example.com."), RRClass::IN(),
+                                 RRType::MX()));
+    EXPECT_FALSE(cache->lookup(Name("example.com."), RRType::MX(),
+                               RRClass::IN(), msg_soa));
+}
+
 TEST_F(NegativeCacheTest, testNXDOMAINWithoutSOA){
     // NXDOMAIN response for nonexist.example.com
     Message msg_nxdomain(Message::PARSE);
@@ -0,0 +1,186 @@
+// Copyright (C) 2014  Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <config.h>
+#include <gtest/gtest.h>
+#include <cache/negative_name_cache.h>
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/question.h>
+#include <dns/rcode.h>
+#include <dns/rdata.h>
+#include <dns/rrclass.h>
+#include <dns/rrset.h>
+#include <dns/rrttl.h>
+#include <dns/rrtype.h>
+
+#include <boost/lexical_cast.hpp>
+
+#include <string>
+
+using namespace bundy::cache;
+using namespace bundy::dns;
+
+namespace {
+
+class NegativeNameCacheTest : public testing::Test {
+protected:
+    NegativeNameCacheTest() :
+        cache_(1024 * 1024, RRClass::IN().getCode(), 4)
+    {}
+
+    // Make an NXDOMAIN answer for the name with the SOA of the zone, with
+    // the given TTL and MINIMUM.
+    void makeNXDOMAIN(Message& msg, const Name& qname, const Name& zone,
+                      uint32_t ttl, uint32_t minimum)
+    {
+        msg.setRcode(Rcode::NXDOMAIN());
+        msg.addQuestion(Question(qname, RRClass::IN(), RRType::A()));
+        const RRsetPtr soa(new RRset(zone, RRClass::IN(), RRType::SOA(),
+                                     RRTTL(ttl)));
+        soa->addRdata(rdata::createRdata(
+                          RRType::SOA(), RRClass::IN(),
+                          "ns." + zone.toText() + " root." + zone.toText() +
+                          " 1 7200 3600 1209600 " +
+                          boost::lexical_cast<std::string>(minimum)));
+        msg.addRRset(Message::SECTION_AUTHORITY, soa);
+    }
+
+    NegativeNameCache cache_;
+};
+
+TEST_F(NegativeNameCacheTest, lookup) {
+    Message msg(Message::RENDER);
+    makeNXDOMAIN(msg, Name("nonexist.example.com"), Name("example.com"),
+                 3600, 600);
+    EXPECT_TRUE(cache_.update(msg));
+
+    // The name itself and all the names below it don't exist, and the SOA
+    // has the negative TTL (the MINIMUM here).
+    RRsetPtr soa = cache_.lookup(Name("nonexist.example.com"));
+    ASSERT_TRUE(soa);
+    EXPECT_EQ(Name("example.com"), soa->getName());
+    EXPECT_EQ(RRType::SOA(), soa->getType());
+    EXPECT_LE(soa->getTTL().getValue(), 600);
+    EXPECT_GE(soa->getTTL().getValue(), 599);
+    EXPECT_TRUE(cache_.lookup(Name("a.b.NonExist.Example.com")));
+
+    // But the ancestors and the siblings still may.
+    EXPECT_FALSE(cache_.lookup(Name("example.com")));
+    EXPECT_FALSE(cache_.lookup(Name("other.example.com")));
+    EXPECT_FALSE(cache_.lookup(Name("nonexist.example.org")));
+    EXPECT_FALSE(cache_.lookup(Name(".")));
+}
+
+TEST_F(NegativeNameCacheTest, ttl) {
+    // The smaller of the SOA TTL and MINIMUM is used.
+    Message msg(Message::RENDER);
+    makeNXDOMAIN(msg, Name("nonexist.example.com"), Name("example.com"),
+                 300, 600);
+    EXPECT_TRUE(cache_.update(msg));
+    RRsetPtr soa = cache_.lookup(Name("nonexist.example.com"));
+    ASSERT_TRUE(soa);
+    EXPECT_LE(soa->getTTL().getValue(), 300);
+
+    // And it's limited like the negative messages.
+    Message msg2(Message::RENDER);
+    makeNXDOMAIN(msg2, Name("nonexist.example.com"), Name("example.com"),
+                 86400, 86400);
+    EXPECT_TRUE(cache_.update(msg2));
+    soa = cache_.lookup(Name("nonexist.example.com"));
+    ASSERT_TRUE(soa);
+    EXPECT_LE(soa->getTTL().getValue(), 10800);
+    EXPECT_GE(soa->getTTL().getValue(), 10799);
+
+    // An answer with TTL of 0 isn't recorded.
+    Message msg3(Message::RENDER);
+    makeNXDOMAIN(msg3, Name("nonexist.example.org"), Name("example.org"),
+                 0, 600);
+    EXPECT_FALSE(cache_.update(msg3));
+    EXPECT_FALSE(cache_.lookup(Name("nonexist.example.org")));
+}
+
+TEST_F(NegativeNameCacheTest, ignored) {
+    // Not NXDOMAIN
+    Message msg(Message::RENDER);
+    makeNXDOMAIN(msg, Name("nonexist.example.com"), Name("example.com"),
+                 3600, 600);
+    msg.setRcode(Rcode::NOERROR());
+    EXPECT_FALSE(cache_.update(msg));
+
+    // The SOA isn't of a zone above the name.
+    Message msg2(Message::RENDER);
+    makeNXDOMAIN(msg2, Name("nonexist.example.com"), Name("example.org"),
+                 3600, 600);
+    EXPECT_FALSE(cache_.update(msg2));
+    Message msg3(Message::RENDER);
+    makeNXDOMAIN(msg3, Name("example.com"), Name("example.com"), 3600, 600);
+    EXPECT_FALSE(cache_.update(msg3));
+
+    // There's an answer (a CNAME chain to another name)
+    Message msg4(Message::RENDER);
+    makeNXDOMAIN(msg4, Name("nonexist.example.com"), Name("example.com"),
+                 3600, 600);
+    const RRsetPtr cname(new RRset(Name("nonexist.example.com"),
+                                   RRClass::IN(), RRType::CNAME(),
+                                   RRTTL(3600)));
+    cname->addRdata(rdata::createRdata(RRType::CNAME(), RRClass::IN(),
+                                       "other.example.com."));
+    msg4.addRRset(Message::SECTION_ANSWER, cname);
+    EXPECT_FALSE(cache_.update(msg4));
+
+    // No SOA
+    Message msg5(Message::RENDER);
+    msg5.setRcode(Rcode::NXDOMAIN());
+    msg5.addQuestion(Question(Name("nonexist.example.com"), RRClass::IN(),
+                              RRType::A()));
+    EXPECT_FALSE(cache_.update(msg5));
+
+    EXPECT_FALSE(cache_.lookup(Name("nonexist.example.com")));
+    EXPECT_FALSE(cache_.lookup(Name("example.com")));
+}
+
+TEST_F(NegativeNameCacheTest, remove) {
+    Message msg(Message::RENDER);
+    makeNXDOMAIN(msg, Name("nonexist.example.com"), Name("example.com"),
+                 3600, 600);
+    EXPECT_TRUE(cache_.update(msg));
+
+    // A name above it doesn't make a difference.
+    cache_.remove(Name("example.com"));
+    EXPECT_TRUE(cache_.lookup(Name("nonexist.example.com")));
+
+    // But one below it does.
+    cache_.remove(Name("a.nonexist.example.com"));
+    EXPECT_FALSE(cache_.lookup(Name("nonexist.example.com")));
+    EXPECT_FALSE(cache_.lookup(Name("a.nonexist.example.com")));
+}
+
+TEST_F(NegativeNameCacheTest, size) {
+    // A cache too small for two entries keeps only the latest one.
+    NegativeNameCache cache(1, RRClass::IN().getCode());
+    Message msg(Message::RENDER);
+    makeNXDOMAIN(msg, Name("nonexist.example.com"), Name("example.com"),
+                 3600, 600);
+    EXPECT_TRUE(cache.update(msg));
+    Message msg2(Message::RENDER);
+    makeNXDOMAIN(msg2, Name("nonexist.example.org"), Name("example.org"),
+                 3600, 600);
+    EXPECT_TRUE(cache.update(msg2));
+
+    EXPECT_FALSE(cache.lookup(Name("nonexist.example.com")));
+    EXPECT_TRUE(cache.lookup(Name("nonexist.example.org")));
+}
+
+}
@@ -30,8 +30,11 @@ class ResolverCacheTest: public testing::Test {
 public:
     ResolverCacheTest() {
         vector<CacheSizeInfo> vec;
-        CacheSizeInfo class_in(RRClass::IN(), 100, 200);
-        CacheSizeInfo class_ch(RRClass::CH(), 100, 200);
+        CacheSizeInfo class_in(RRClass::IN(), MESSAGE_CACHE_DEFAULT_SIZE,
+                               RRSET_CACHE_DEFAULT_SIZE);
+        CacheSizeInfo class_ch(RRClass::CH(), MESSAGE_CACHE_DEFAULT_SIZE,
+                               RRSET_CACHE_DEFAULT_SIZE, 1,
+                               NEGATIVE_NAME_CACHE_DEFAULT_SIZE / 2);
         vec.push_back(class_in);
         vec.push_back(class_ch);
         cache = new ResolverCache(vec);
@@ -44,6 +47,18 @@ public:
     ResolverCache* cache;
 };
 
+TEST(CacheSizeInfoTest, negativeNameCacheSize) {
+    // The default size is used unless another one is given.
+    EXPECT_EQ(NEGATIVE_NAME_CACHE_DEFAULT_SIZE,
+              CacheSizeInfo(RRClass::IN(), MESSAGE_CACHE_DEFAULT_SIZE,
+                            RRSET_CACHE_DEFAULT_SIZE).
+              negative_name_cache_size);
+    EXPECT_EQ(1024,
+              CacheSizeInfo(RRClass::IN(), MESSAGE_CACHE_DEFAULT_SIZE,
+                            RRSET_CACHE_DEFAULT_SIZE, 4, 1024).
+              negative_name_cache_size);
+}
+
 TEST_F(ResolverCacheTest, testUpdateMessage) {
     Message msg(Message::PARSE);
     messageFromFile(msg, "message_fromWire3");
@@ -106,6 +121,36 @@ TEST_F(ResolverCacheTest, testLookupUnsupportedClass) {
     EXPECT_FALSE(cache->lookup(qname, RRType::SOA(), RRClass::CH()));
 }
 
+TEST_F(ResolverCacheTest, prefetch) {
+    Message msg(Message::PARSE);
+    messageFromFile(msg, "message_fromWire3");
+    cache->update(msg);
+    cache->setPrefetchPolicy(PrefetchPolicy(1, 100));
+
+    const Name qname("example.com.");
+    msg.makeResponse();
+    bool prefetch = false;
+    EXPECT_TRUE(cache->lookup(qname, RRType::SOA(), RRClass::IN(), msg,
+                              &prefetch));
+    EXPECT_TRUE(prefetch);
+    EXPECT_TRUE(cache->lookup(qname, RRType::NS(), RRClass::IN(),
+                              &prefetch));
+    EXPECT_TRUE(prefetch);
+
+    // Nothing in the other class.
+    EXPECT_FALSE(cache->lookup(qname, RRType::NS(), RRClass::CH(),
+                               &prefetch));
+    EXPECT_FALSE(prefetch);
+
+    // The local zone data never expires.
+    const RRsetPtr rrset(new RRset(Name("local.example.com."), RRClass::IN(),
+                                   RRType::A(), RRTTL(100)));
+    cache->update(rrset);
+    EXPECT_TRUE(cache->lookup(rrset->getName(), RRType::A(), RRClass::IN(),
+                              &prefetch));
+    EXPECT_FALSE(prefetch);
+}
+
 TEST_F(ResolverCacheTest, testLookupClosestRRset) {
     Message msg(Message::PARSE);
     messageFromFile(msg, "message_fromWire3");
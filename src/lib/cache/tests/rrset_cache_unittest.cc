@@ -24,6 +24,13 @@
 #include <dns/rrtype.h>
 #include <dns/rrttl.h>
 #include <dns/rrset.h>
+#include <util/threads/thread.h>
+
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <vector>
 
 using namespace bundy::cache;
 using namespace bundy::dns;
@@ -31,10 +38,20 @@ using namespace std;
 
 namespace {
 
+// Return the size of the entry for an A RRset (without RDATA) of the name.
+size_t
+getEntrySize(const Name& name) {
+    return (RRsetEntry(RRset(name, RRClass::IN(), RRType::A(), RRTTL(20)),
+                       RRSET_TRUST_ADDITIONAL_AA).getSize());
+}
+
 class RRsetCacheTest : public testing::Test {
 protected:
+    // The cache can hold three RRsets of the names used in the LRU tests,
+    // which are all of the same length.
     RRsetCacheTest():
-        cache_(1, RRClass::IN().getCode()),
+        cache_(3 * getEntrySize(Name("1.example.com.")),
+               RRClass::IN().getCode()),
         name_("example.com"),
         rrset1_(name_, RRClass::IN(), RRType::A(), RRTTL(20)),
         rrset2_(name_, RRClass::IN(), RRType::A(), RRTTL(10)),
@@ -71,8 +88,7 @@ TEST_F(RRsetCacheTest, lookup) {
     EXPECT_EQ(rrset_entry_ptr->getRRset()->getType(), rrset_entry1_.getRRset()->getType());
     EXPECT_EQ(rrset_entry_ptr->getRRset()->getClass(), rrset_entry1_.getRRset()->getClass());
 
-    // Check whether the expired rrset entry will be removed automatically
-    // when looking up.
+    // Check whether the expired rrset entry is ignored when looking up.
     Name name_test("test.example.com.");
     updateRRsetCache(cache_, name_test, 0); // Add a rrset with TTL 0 to cache.
     EXPECT_FALSE(cache_.lookup(name_test, RRType::A()));
@@ -124,4 +140,125 @@ TEST_F(RRsetCacheTest, cacheLruBehavior) {
     EXPECT_FALSE(cache_.lookup(name4, RRType::A()));
 }
 
+// An entry found to have expired is evicted before the least recently
+// used ones.
+TEST_F(RRsetCacheTest, expiredEviction) {
+    Name name1("1.example.com.");
+    Name name2("2.example.com.");
+    Name name3("3.example.com.");
+    Name name4("4.example.com.");
+
+    updateRRsetCache(cache_, name1);
+    updateRRsetCache(cache_, name2);
+    updateRRsetCache(cache_, name3, 0);
+    EXPECT_FALSE(cache_.lookup(name3, RRType::A()));
+
+    // Without the expiration the entry of name1 would be evicted.
+    updateRRsetCache(cache_, name4);
+    EXPECT_TRUE(cache_.lookup(name1, RRType::A()));
+    EXPECT_TRUE(cache_.lookup(name2, RRType::A()));
+    EXPECT_TRUE(cache_.lookup(name4, RRType::A()));
+
+    // An expired entry is replaced by an update regardless of its trust
+    // level.
+    updateRRsetCache(cache_, name3, 0, RRSET_TRUST_PRIM_ZONE_NONGLUE);
+    EXPECT_FALSE(cache_.lookup(name3, RRType::A()));
+    updateRRsetCache(cache_, name3);
+    EXPECT_TRUE(cache_.lookup(name3, RRType::A()));
+}
+
+TEST_F(RRsetCacheTest, prefetch) {
+    Name name1("1.example.com.");
+    updateRRsetCache(cache_, name1);
+
+    // Never prefetched by default.
+    bool prefetch = true;
+    EXPECT_TRUE(cache_.lookup(name1, RRType::A(), &prefetch));
+    EXPECT_FALSE(prefetch);
+
+    // The entry is always close enough to the expiration with 100%, so
+    // it's due from the third hit, but only the first lookup then is
+    // told to prefetch it.
+    cache_.setPrefetchPolicy(PrefetchPolicy(3, 100));
+    EXPECT_TRUE(cache_.lookup(name1, RRType::A(), &prefetch));
+    EXPECT_FALSE(prefetch);
+    EXPECT_TRUE(cache_.lookup(name1, RRType::A(), &prefetch));
+    EXPECT_TRUE(prefetch);
+    EXPECT_TRUE(cache_.lookup(name1, RRType::A(), &prefetch));
+    EXPECT_FALSE(prefetch);
+
+    // The refreshed entry starts counting again.
+    updateRRsetCache(cache_, name1);
+    EXPECT_TRUE(cache_.lookup(name1, RRType::A(), &prefetch));
+    EXPECT_FALSE(prefetch);
+    // Lookups that don't ask still count as hits.
+    EXPECT_TRUE(cache_.lookup(name1, RRType::A()));
+    EXPECT_TRUE(cache_.lookup(name1, RRType::A(), &prefetch));
+    EXPECT_TRUE(prefetch);
+
+    // Nothing to prefetch if the entry isn't found.
+    EXPECT_FALSE(cache_.lookup(name_, RRType::A(), &prefetch));
+    EXPECT_FALSE(prefetch);
+}
+
+// The entries are spread over the shards, each of which has its own LRU
+// list.
+TEST_F(RRsetCacheTest, shards) {
+    RRsetCache cache(200 * getEntrySize(name_), RRClass::IN().getCode(), 4);
+    for (int i = 0; i < 50; ++i) {
+        Name name("n" + boost::lexical_cast<string>(i) + ".example.com.");
+        updateRRsetCache(cache, name);
+    }
+    for (int i = 0; i < 50; ++i) {
+        const Name name("n" + boost::lexical_cast<string>(i) +
+                        ".example.com.");
+        const RRsetEntryPtr entry = cache.lookup(name, RRType::A());
+        ASSERT_TRUE(entry);
+        EXPECT_EQ(name, entry->getRRset()->getName());
+    }
+
+    // Updates and expiration work the same way as in a single shard.
+    updateRRsetCache(cache, name_, 20, RRSET_TRUST_ADDITIONAL_NONAA);
+    updateRRsetCache(cache, name_, 20, RRSET_TRUST_PRIM_GLUE);
+    EXPECT_EQ(RRSET_TRUST_PRIM_GLUE,
+              cache.lookup(name_, RRType::A())->getTrustLevel());
+    Name name_test("test.example.com.");
+    updateRRsetCache(cache, name_test, 0);
+    EXPECT_FALSE(cache.lookup(name_test, RRType::A()));
+}
+
+void
+updateAndLookup(RRsetCache* cache, int id, int* found) {
+    for (int i = 0; i < 500; ++i) {
+        Name name("n" + boost::lexical_cast<string>(i) + ".t" +
+                  boost::lexical_cast<string>(id) + ".example.com.");
+        updateRRsetCache(*cache, name);
+        // The name added before the threads started is shared by all.
+        if (cache->lookup(name, RRType::A()) &&
+            cache->lookup(Name("example.com."), RRType::A())) {
+            ++*found;
+        }
+    }
+}
+
+// The cache can be updated and looked up from several threads at once.
+TEST_F(RRsetCacheTest, threads) {
+    RRsetCache cache(10000 * getEntrySize(name_), RRClass::IN().getCode(),
+                     8);
+    cache.update(rrset1_, rrset_entry1_.getTrustLevel());
+
+    const int thread_count = 4;
+    std::vector<int> found(thread_count, 0);
+    std::vector<boost::shared_ptr<bundy::util::thread::Thread> > threads;
+    for (int i = 0; i < thread_count; ++i) {
+        threads.push_back(boost::shared_ptr<bundy::util::thread::Thread>(
+            new bundy::util::thread::Thread(
+                boost::bind(updateAndLookup, &cache, i, &found[i]))));
+    }
+    for (int i = 0; i < thread_count; ++i) {
+        threads[i]->wait();
+        EXPECT_EQ(500, found[i]);
+    }
+}
+
 }
@@ -83,6 +83,24 @@ TEST_F(RRsetEntryTest, updateTTL) {
     EXPECT_TRUE(rrset_entry.getTTL() < ttl);
 }
 
+TEST_F(RRsetEntryTest, getRRsetWithDecayedTTL) {
+    sleep(1);
+    const RRsetPtr rrset1 = rrset_entry.getRRset();
+    const RRsetPtr rrset2 = rrset_entry.getRRset();
+    // The TTL has decayed, so we get a copy with the remaining TTL
+    EXPECT_GT(TEST_TTL, rrset1->getTTL().getValue());
+    EXPECT_EQ(rrset.getName(), rrset1->getName());
+    // It's shared by the lookups in the same second
+    if (rrset1->getTTL() == rrset2->getTTL()) {
+        EXPECT_EQ(rrset1, rrset2);
+    }
+    // and replaced in the next one
+    sleep(1);
+    const RRsetPtr rrset3 = rrset_entry.getRRset();
+    EXPECT_NE(rrset1, rrset3);
+    EXPECT_GT(rrset1->getTTL().getValue(), rrset3->getTTL().getValue());
+}
+
 TEST_F(RRsetEntryTest, TTLExpire) {
     RRset exp_rrset(name, RRClass::IN(), RRType::A(), RRTTL(1));
     RRsetEntry rrset_entry(exp_rrset, RRSET_TRUST_ANSWER_AA);
@@ -99,5 +117,37 @@ TEST_F(RRsetEntryTest, getExpireTime){
     EXPECT_EQ(exp_time, rrset_entry.getExpireTime());
 }
 
+TEST(PrefetchPolicyTest, isDue) {
+    const time_t now = time(NULL);
+    // Disabled by default.
+    EXPECT_FALSE(PrefetchPolicy().isDue(100, 100, now + 1, now));
+
+    const PrefetchPolicy policy(10, 10);
+    EXPECT_TRUE(policy.isDue(10, 100, now + 10, now));
+    EXPECT_TRUE(policy.isDue(10, 100, now + 1, now));
+    // Not popular enough
+    EXPECT_FALSE(policy.isDue(9, 100, now + 10, now));
+    // Too far from the expiration
+    EXPECT_FALSE(policy.isDue(10, 100, now + 11, now));
+    // Already expired
+    EXPECT_FALSE(policy.isDue(10, 100, now, now));
+    // A TTL this short never leaves a whole second to prefetch in.
+    EXPECT_FALSE(policy.isDue(10, 9, now + 1, now));
+}
+
+TEST_F(RRsetEntryTest, claimPrefetch) {
+    const time_t now = time(NULL);
+    const PrefetchPolicy policy(2, 100);
+    EXPECT_EQ(0, rrset_entry.getHits());
+    rrset_entry.hit();
+    EXPECT_FALSE(rrset_entry.claimPrefetch(now, policy));
+    rrset_entry.hit();
+    EXPECT_EQ(2, rrset_entry.getHits());
+    EXPECT_TRUE(rrset_entry.claimPrefetch(now, policy));
+    // Only the first claim succeeds.
+    rrset_entry.hit();
+    EXPECT_FALSE(rrset_entry.claimPrefetch(now, policy));
+}
+
 }   // namespace
 
@@ -0,0 +1,204 @@
+// Copyright (C) 2014  Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+// Benchmark of zone lookups in a mapped zone table segment, with and without
+// huge pages (and prefault) enabled for the segment.  To see the effect of
+// huge pages the mapped file should be placed on a filesystem supporting
+// them, e.g., a tmpfs mounted with "huge=advise".
+
+#include <bench/benchmark.h>
+
+#include <dns/name.h>
+#include <dns/rrclass.h>
+#include <dns/rrtype.h>
+
+#include <cc/data.h>
+
+#include <datasrc/zone_finder.h>
+#include <datasrc/memory/memory_client.h>
+#include <datasrc/memory/zone_table_segment.h>
+#include <datasrc/memory/zone_writer.h>
+#include <datasrc/memory/zone_data_loader.h>
+
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/time.h>
+#include <unistd.h>
+
+using std::vector;
+using std::string;
+using namespace bundy::bench;
+using namespace bundy::data;
+using namespace bundy::datasrc;
+using namespace bundy::datasrc::memory;
+using namespace bundy::dns;
+
+namespace {
+const Name origin("example.");
+
+class LookupBenchMark {
+public:
+    LookupBenchMark(ZoneFinder& finder, const vector<Name>& queries) :
+        finder_(finder), queries_(queries)
+    {}
+    unsigned int run() {
+        vector<Name>::const_iterator it;
+        const vector<Name>::const_iterator it_end = queries_.end();
+        for (it = queries_.begin(); it != it_end; ++it) {
+            finder_.find(*it, RRType::A());
+        }
+        return (queries_.size());
+    }
+private:
+    ZoneFinder& finder_;
+    const vector<Name>& queries_;
+};
+
+// Write a zone of the given number of names, each of which has an A RR,
+// and return the names in random order as the queries.
+vector<Name>
+createZone(const string& zone_file, size_t zone_size) {
+    std::ofstream ofs(zone_file.c_str());
+    ofs << "example. 3600 IN SOA . . 0 0 0 0 0\n"
+        << "example. 3600 IN NS ns.example.\n";
+    vector<Name> names;
+    for (size_t i = 0; i < zone_size; ++i) {
+        const string name = "h" + boost::lexical_cast<string>(i) +
+            ".example.";
+        ofs << name << " 3600 IN A 192.0.2." << (i % 256) << "\n";
+        names.push_back(Name(name));
+    }
+    std::random_shuffle(names.begin(), names.end());
+    return (names);
+}
+
+// loadZoneData is overloaded, so we wrap it into an unique name to use it
+// with boost::bind.
+ZoneData*
+loadZoneDataFromFile(bundy::util::MemorySegment& segment,
+                     const RRClass& rrclass, const Name& name,
+                     const string& filename)
+{
+    return (loadZoneData(segment, rrclass, name, filename));
+}
+
+void
+runBench(const string& mapped_file, bool huge_pages, bool prefault,
+         const vector<Name>& queries, int iteration)
+{
+    boost::shared_ptr<ZoneTableSegment> segment(
+        ZoneTableSegment::create(RRClass::IN(), "mapped"),
+        ZoneTableSegment::destroy);
+    ElementPtr params = Element::createMap();
+    params->set("mapped-file", Element::create(mapped_file));
+    params->set("huge-pages", Element::create(huge_pages));
+    params->set("prefault", Element::create(prefault));
+    segment->reset(ZoneTableSegment::READ_ONLY, params);
+
+    InMemoryClient client("bench", segment, RRClass::IN());
+    const ZoneFinderPtr finder = client.findZone(origin).zone_finder;
+
+    std::cout << "Lookups with huge pages " << (huge_pages ? "on" : "off")
+              << ", prefault " << (prefault ? "on" : "off") << std::endl;
+    BenchMark<LookupBenchMark>(iteration, LookupBenchMark(*finder, queries));
+}
+
+void
+usage() {
+    std::cerr << "Usage: mapped_lookup_bench [-n iterations] [-z zone_size] "
+        "[-P] [-f mapped_file]" << std::endl;
+    std::cerr << "  -P: also prefault the segment when huge pages are used"
+              << std::endl;
+    exit (1);
+}
+}
+
+int
+main(int argc, char* argv[]) {
+    int ch;
+    int iteration = 10;
+    size_t zone_size = 100000;
+    bool prefault = false;
+    string mapped_file = "mapped_lookup_bench.mapped";
+    while ((ch = getopt(argc, argv, "n:z:Pf:")) != -1) {
+        switch (ch) {
+        case 'n':
+            iteration = atoi(optarg);
+            break;
+        case 'z':
+            zone_size = atoi(optarg);
+            break;
+        case 'P':
+            prefault = true;
+            break;
+        case 'f':
+            mapped_file = optarg;
+            break;
+        case '?':
+        default:
+            usage();
+        }
+    }
+    argc -= optind;
+    if (argc != 0) {
+        usage();
+    }
+
+    // Build the zone into the mapped file once; the two runs below use
+    // the same image.  We also report how long it takes, since loading
+    // into a mapped segment can involve growing (and remapping) it.
+    const string zone_file = mapped_file + ".zone";
+    const vector<Name> queries = createZone(zone_file, zone_size);
+    {
+        struct timeval start, end;
+        gettimeofday(&start, NULL);
+        boost::shared_ptr<ZoneTableSegment> segment(
+            ZoneTableSegment::create(RRClass::IN(), "mapped"),
+            ZoneTableSegment::destroy);
+        ElementPtr params = Element::createMap();
+        params->set("mapped-file", Element::create(mapped_file));
+        segment->reset(ZoneTableSegment::CREATE, params);
+
+        ZoneWriter writer(*segment,
+                          boost::bind(loadZoneDataFromFile, _1, RRClass::IN(),
+                                      origin, zone_file),
+                          origin, RRClass::IN(), false);
+        writer.load();
+        writer.install();
+        writer.cleanup();
+
+        gettimeofday(&end, NULL);
+        const double load_time = (end.tv_sec - start.tv_sec) +
+            (end.tv_usec - start.tv_usec) / 1000000.0;
+        std::cout << "Loaded " << zone_size << " names into the mapped "
+                  << "segment in " << load_time << " sec" << std::endl;
+    }
+
+    runBench(mapped_file, false, false, queries, iteration);
+    runBench(mapped_file, true, prefault, queries, iteration);
+
+    std::remove(zone_file.c_str());
+    std::remove(mapped_file.c_str());
+    return (0);
+}
@@ -53,6 +53,44 @@ getSegmentTypeFromConf(const Element& conf) {
     }
     return (conf.get("cache-type")->stringValue());
 }
+
+size_t
+getLoadThreadsFromConf(const Element& conf) {
+    if (!conf.contains("cache-load-threads")) {
+        return (1);
+    }
+    const int64_t threads = conf.get("cache-load-threads")->intValue();
+    if (threads < 1) {
+        bundy_throw(CacheConfigError,
+                  "cache-load-threads must be positive: " << threads);
+    }
+    return (threads);
+}
+
+bool
+getLoadOnDemandFromConf(const Element& conf) {
+    return (conf.contains("cache-load-on-demand") &&
+            conf.get("cache-load-on-demand")->boolValue());
+}
+
+bool
+getHugePagesFromConf(const Element& conf) {
+    return (conf.contains("cache-huge-pages") &&
+            conf.get("cache-huge-pages")->boolValue());
+}
+
+size_t
+getMemoryLimitFromConf(const Element& conf) {
+    if (!conf.contains("cache-memory-limit")) {
+        return (0);
+    }
+    const int64_t limit = conf.get("cache-memory-limit")->intValue();
+    if (limit < 0) {
+        bundy_throw(CacheConfigError,
+                  "cache-memory-limit must not be negative: " << limit);
+    }
+    return (limit);
+}
 }
 
 CacheConfig::CacheConfig(const std::string& datasrc_type,
@@ -61,6 +99,10 @@ CacheConfig::CacheConfig(const std::string& datasrc_type,
                          bool allowed) :
     enabled_(allowed && getEnabledFromConf(datasrc_conf)),
     segment_type_(getSegmentTypeFromConf(datasrc_conf)),
+    load_threads_(getLoadThreadsFromConf(datasrc_conf)),
+    load_on_demand_(enabled_ && getLoadOnDemandFromConf(datasrc_conf)),
+    memory_limit_(getMemoryLimitFromConf(datasrc_conf)),
+    huge_pages_(getHugePagesFromConf(datasrc_conf)),
     datasrc_client_(datasrc_client)
 {
     ConstElementPtr params = datasrc_conf.get("params");
@@ -78,6 +120,11 @@ CacheConfig::CacheConfig(const std::string& datasrc_type,
                       "The cache must be enabled for the MasterFiles type: "
                       << datasrc_conf);
         }
+        if (load_on_demand_) {
+            bundy_throw(CacheConfigError,
+                      "Zones of the MasterFiles type can't be loaded on "
+                      "demand: " << datasrc_conf);
+        }
 
         typedef std::map<std::string, ConstElementPtr> ZoneToFile;
         const ZoneToFile& zone_to_file = params->mapValue();
@@ -97,6 +144,11 @@ CacheConfig::CacheConfig(const std::string& datasrc_type,
         if (!enabled_) {
             return;
         }
+        if (load_on_demand_ && segment_type_ != "local") {
+            bundy_throw(CacheConfigError,
+                      "Zones can only be loaded on demand into a local "
+                      "cache: " << datasrc_conf);
+        }
 
         if (!datasrc_conf.contains("cache-zones")) {
             bundy_throw(NotImplemented, "Auto-detection of zones "
@@ -119,6 +171,17 @@ CacheConfig::CacheConfig(const std::string& datasrc_type,
     }
 }
 
+bool
+CacheConfig::isCachedZone(const dns::Name& zone_name) const {
+    return (zone_config_.find(zone_name) != zone_config_.end());
+}
+
+std::string
+CacheConfig::getMasterFile(const dns::Name& zone_name) const {
+    const Zones::const_iterator found = zone_config_.find(zone_name);
+    return (found != zone_config_.end() ? found->second : std::string());
+}
+
 namespace {
 
 // We would like to use boost::bind for this. However, the loadZoneData takes
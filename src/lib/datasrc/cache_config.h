@@ -106,6 +106,25 @@ public:
     /// used for the cache.  It's given via the "cache-type" configuration
     /// item if defined; otherwise it defaults to "local".
     ///
+    /// Likewise, the number of threads used to load the cached zones at
+    /// configuration time is given via the "cache-load-threads" item,
+    /// defaulting to 1.  It must be a positive integer; otherwise
+    /// CacheConfigError is thrown.
+    ///
+    /// If the "cache-load-on-demand" item is true, the cached zones are
+    /// not loaded at configuration time but on their first use.  This is
+    /// only possible for data sources other than "MasterFiles" (the zones
+    /// are served from the underlying data source until they are loaded)
+    /// with a "local" segment; CacheConfigError is thrown otherwise.  The
+    /// memory used by zones loaded this way can be limited by the
+    /// "cache-memory-limit" item, in bytes; it defaults to 0, meaning no
+    /// limit, and must not be negative.
+    ///
+    /// If the "cache-huge-pages" item is true, a "local" segment is backed
+    /// by huge pages where possible (see \c util::MemorySegmentLocal).  A
+    /// "mapped" segment takes the option from the parameters it's reset
+    /// with instead (see \c memory::ZoneTableSegmentMapped::reset()).
+    ///
     /// \throw InvalidParameter Program error at the caller side rather than
     /// in the configuration (see above)
     /// \throw CacheConfigError There is a semantics error in the given
@@ -144,6 +163,48 @@ public:
     /// \throw None
     const std::string& getSegmentType() const { return (segment_type_); }
 
+    /// \brief Return the number of threads to load the cached zones with.
+    ///
+    /// This is the upper limit of zones loaded into the cache concurrently
+    /// at configuration time.  The user of this class may use a smaller
+    /// number if the zone table segment doesn't allow concurrent writers.
+    ///
+    /// \throw None
+    size_t getLoadThreads() const { return (load_threads_); }
+
+    /// \brief Return if the cached zones are loaded on demand.
+    ///
+    /// If true, the cached zones are expected to be loaded on their first
+    /// use rather than at configuration time.  This is never true if the
+    /// cache is disabled.
+    ///
+    /// \throw None
+    bool isLoadOnDemand() const { return (load_on_demand_); }
+
+    /// \brief Return the memory limit for zones loaded on demand.
+    ///
+    /// This is the maximum number of bytes the zones loaded on demand are
+    /// expected to use in total; 0 means there's no limit.
+    ///
+    /// \throw None
+    size_t getMemoryLimit() const { return (memory_limit_); }
+
+    /// \brief Return if a local segment is to use huge pages.
+    ///
+    /// \throw None
+    bool useHugePages() const { return (huge_pages_); }
+
+    /// \brief Return if the zone of the given name is to be cached.
+    ///
+    /// \throw None
+    bool isCachedZone(const dns::Name& zone_name) const;
+
+    /// \brief Return the path to the master file of the given zone.
+    ///
+    /// It's only available for the "MasterFiles" type; for other types,
+    /// or if the zone is not to be cached, an empty string is returned.
+    std::string getMasterFile(const dns::Name& zone_name) const;
+
     /// \brief Return a \c LoadAction functor to load zone data into memory.
     ///
     /// This method returns an appropriate \c LoadAction functor that can be
@@ -200,6 +261,10 @@ public:
 private:
     const bool enabled_; // if the use of in-memory zone table is enabled
     const std::string segment_type_;
+    const size_t load_threads_;
+    const bool load_on_demand_;
+    const size_t memory_limit_;
+    const bool huge_pages_; // if a local segment uses huge pages
     // client of underlying data source, will be NULL for MasterFile datasrc
     const DataSourceClient* datasrc_client_;
 
@@ -25,15 +25,30 @@
 #include <datasrc/memory/zone_data_updater.h>
 #include <datasrc/logger.h>
 #include <datasrc/zone_table_accessor_cache.h>
+#include <datasrc/zone_loader.h>
+#include <datasrc/zone_iterator.h>
+#include <dns/labelsequence.h>
 #include <dns/masterload.h>
+#include <dns/master_loader.h>
+#include <dns/rdataclass.h>
+#include <dns/serial.h>
 #include <util/memory_segment_local.h>
+#include <util/threads/thread.h>
 
+#include <list>
+#include <map>
 #include <memory>
 #include <set>
 #include <boost/foreach.hpp>
 #include <boost/bind.hpp>
+#include <boost/detail/atomic_count.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
 #include <boost/scoped_ptr.hpp>
 
+#include <sys/stat.h>
+#include <sys/time.h>
+
 using namespace bundy::data;
 using namespace bundy::dns;
 using namespace std;
@@ -44,9 +59,204 @@ using boost::dynamic_pointer_cast;
 using bundy::datasrc::memory::InMemoryClient;
 using bundy::datasrc::memory::ZoneTableSegment;
 using bundy::datasrc::memory::ZoneDataUpdater;
+using bundy::util::thread::Mutex;
+using bundy::util::thread::Thread;
 
 namespace bundy {
 namespace datasrc {
+namespace internal {
+
+// The state of the zones of a data source that are loaded into its cache
+// on demand: the zones used but not loaded yet, and the loaded ones in the
+// order of their last use, so the least recently used ones can be removed
+// once the cache goes over its memory limit.
+//
+// hit() and miss() are called from find(), possibly in multiple threads at
+// the same time, so they don't lock on each call; they only look up the
+// state of the zone, which is created for all the zones to be cached on
+// construction and never added or removed, and update atomic counters.  The
+// rest is done by the thread loading the zones, with a mutex against
+// getting the statistics (and the first miss of a zone, which records it to
+// be loaded).  As with the zone table of the cache, whether a zone is
+// loaded only changes while no find() runs (see
+// ConfigurableClientList::loadZonesOnDemand()).
+class OnDemandZones : boost::noncopyable {
+public:
+    OnDemandZones(const CacheConfig& cache_conf) :
+        nested_(hasNestedZones(cache_conf)),
+        memory_limit_(cache_conf.getMemoryLimit()),
+        hits_(0), misses_(0)
+    {
+        for (CacheConfig::ConstZoneIterator it = cache_conf.begin();
+             it != cache_conf.end();
+             ++it) {
+            zones_.insert(Zones::value_type(it->first, ZoneStatePtr(
+                                                new ZoneState(it->first))));
+        }
+    }
+
+    // Whether any of the zones to be cached is a subdomain of another.  If
+    // not, a zone found in the cache is always the best match, as a better
+    // one could only be a subdomain of it.
+    bool isNested() const { return (nested_); }
+
+    // Record a find() result served from the cache.
+    void hit(const dns::Name& zone) {
+        ++hits_;
+        const Zones::const_iterator found = zones_.find(zone);
+        if (found != zones_.end()) {
+            ++found->second->uses;
+        }
+    }
+
+    // Record a find() result for a zone to be cached from the underlying
+    // data source, and request the zone to be loaded.  Return false (and
+    // do nothing) if it is loaded already.
+    bool miss(const dns::Name& zone) {
+        const Zones::const_iterator found = zones_.find(zone);
+        if (found == zones_.end() || found->second->loaded) {
+            return (false);
+        }
+        ++misses_;
+        ZoneState& state = *found->second;
+        // Only the first miss since the last takeRequests() records it.
+        if (++state.requests == state.taken_requests + 1) {
+            Mutex::Locker locker(mutex_);
+            requested_.push_back(&state);
+        }
+        return (true);
+    }
+
+    // Take the zones requested since the last call.
+    void takeRequests(std::vector<dns::Name>& zones) {
+        std::vector<ZoneState*> requested;
+        {
+            Mutex::Locker locker(mutex_);
+            requested.swap(requested_);
+        }
+        zones.clear();
+        BOOST_FOREACH(ZoneState* state, requested) {
+            state->taken_requests = state->requests;
+            zones.push_back(state->name);
+        }
+    }
+
+    bool isLoaded(const dns::Name& zone) const {
+        const Zones::const_iterator found = zones_.find(zone);
+        return (found != zones_.end() && found->second->loaded);
+    }
+
+    // Record a zone loaded into the cache.  The zones to be removed from
+    // the cache to keep within the memory limit, if any, are forgotten and
+    // returned in evicted, the least recently used first.
+    void loaded(const dns::Name& zone, size_t memory, double load_time,
+                std::vector<dns::Name>& evicted)
+    {
+        const Zones::const_iterator found = zones_.find(zone);
+        // Only zones to be cached are requested
+        assert(found != zones_.end());
+        ZoneState* const loaded_state = found->second.get();
+        updateLRU();
+
+        Mutex::Locker locker(mutex_);
+        ++stats_.loads;
+        stats_.load_time += load_time;
+        stats_.memory += memory;
+        loaded_state->loaded = true;
+        loaded_state->memory = memory;
+        loaded_state->seen_uses = loaded_state->uses;
+        lru_.push_back(loaded_state);
+        while (memory_limit_ > 0 && stats_.memory > memory_limit_ &&
+               lru_.front() != loaded_state) {
+            ZoneState* const victim = lru_.front();
+            evicted.push_back(victim->name);
+            stats_.memory -= victim->memory;
+            ++stats_.evictions;
+            victim->loaded = false;
+            victim->memory = 0;
+            lru_.pop_front();
+        }
+    }
+
+    void addStats(ConfigurableClientList::OnDemandStats& stats) const {
+        stats.hits += hits_;
+        stats.misses += misses_;
+        Mutex::Locker locker(mutex_);
+        stats.loads += stats_.loads;
+        stats.evictions += stats_.evictions;
+        stats.load_time += stats_.load_time;
+        stats.memory += stats_.memory;
+    }
+
+private:
+    struct ZoneState : boost::noncopyable {
+        ZoneState(const dns::Name& zone_name) :
+            name(zone_name), uses(0), requests(0), seen_uses(0),
+            taken_requests(0), loaded(false), memory(0)
+        {}
+        const dns::Name name;
+        boost::detail::atomic_count uses;     // hits, for the LRU order
+        boost::detail::atomic_count requests; // misses
+        // The following are used by the loading thread only.
+        long seen_uses;         // uses when the LRU order was last updated
+        long taken_requests;    // requests on the last takeRequests()
+        bool loaded;
+        size_t memory;          // memory used if loaded
+    };
+    typedef boost::shared_ptr<ZoneState> ZoneStatePtr;
+    typedef std::map<dns::Name, ZoneStatePtr> Zones;
+    typedef std::list<ZoneState*> LRUList;
+
+    // Move the zones used since the last update to the end of the LRU
+    // list.  As hit() only counts the uses, the order among them is kept
+    // as it was; so the order is exact only up to the granularity of the
+    // loads.
+    void updateLRU() {
+        LRUList used;
+        for (LRUList::iterator it = lru_.begin(); it != lru_.end(); ) {
+            ZoneState* const state = *it;
+            const long uses = state->uses;
+            if (uses != state->seen_uses) {
+                state->seen_uses = uses;
+                used.splice(used.end(), lru_, it++);
+            } else {
+                ++it;
+            }
+        }
+        lru_.splice(lru_.end(), used);
+    }
+
+    static bool hasNestedZones(const CacheConfig& cache_conf) {
+        // All subdomains of a name sort right after it, so it's enough to
+        // check the neighbors.
+        CacheConfig::ConstZoneIterator it = cache_conf.begin();
+        if (it == cache_conf.end()) {
+            return (false);
+        }
+        for (CacheConfig::ConstZoneIterator prev = it++;
+             it != cache_conf.end();
+             prev = it++) {
+            if (it->first.compare(prev->first).getRelation() ==
+                dns::NameComparisonResult::SUBDOMAIN) {
+                return (true);
+            }
+        }
+        return (false);
+    }
+
+    const bool nested_;
+    const size_t memory_limit_;
+    Zones zones_;               // all zones to be cached, fixed
+    boost::detail::atomic_count hits_;
+    boost::detail::atomic_count misses_;
+    LRUList lru_;               // loaded zones, least recently used first
+    mutable Mutex mutex_;
+    std::vector<ZoneState*> requested_; // protected by mutex_
+    ConfigurableClientList::OnDemandStats stats_; // protected by mutex_,
+                                                  // except hits and misses
+};
+
+}
 
 ConfigurableClientList::DataSourceInfo::DataSourceInfo(
     DataSourceClient* data_src_client,
@@ -60,8 +270,12 @@ ConfigurableClientList::DataSourceInfo::DataSourceInfo(
 {
     if (cache_conf_ && cache_conf_->isEnabled()) {
         ztable_segment_.reset(ZoneTableSegment::create(
-                                  rrclass, cache_conf_->getSegmentType()));
+                                  rrclass, cache_conf_->getSegmentType(),
+                                  cache_conf_->useHugePages()));
         cache_.reset(new InMemoryClient(name_, ztable_segment_, rrclass));
+        if (cache_conf_->isLoadOnDemand()) {
+            on_demand_.reset(new internal::OnDemandZones(*cache_conf_));
+        }
     }
 }
 
@@ -72,10 +286,307 @@ ConfigurableClientList::DataSourceInfo::getCacheClient() const {
 
 ConfigurableClientList::ConfigurableClientList(const RRClass& rrclass) :
     rrclass_(rrclass),
+    find_cache_enabled_(false),
+    find_cache_generation_(1),
     configuration_(new bundy::data::ListElement),
-    allow_cache_(false)
+    allow_cache_(false),
+    zones_to_load_(0),
+    zones_loaded_(0)
 {}
 
+namespace {
+
+// Number of entries of the find() cache.  It's direct-mapped, so zones
+// hashed to the same entry replace each other.
+const size_t FIND_CACHE_SIZE = 1024;
+
+// Collect the zones to be cached by any of the data sources that have
+// other zones to be cached by any of them below them.  All subdomains of
+// a name sort right after it, so it's enough to check the neighbors.
+void
+getNestedZones(const std::vector<ConfigurableClientList::DataSourceInfo>&
+               data_sources, std::set<Name>& nested)
+{
+    std::set<Name> zones;
+    BOOST_FOREACH(const ConfigurableClientList::DataSourceInfo& info,
+                  data_sources) {
+        const internal::CacheConfig& cache_conf = *info.getCacheConfig();
+        for (internal::CacheConfig::ConstZoneIterator it = cache_conf.begin();
+             it != cache_conf.end();
+             ++it) {
+            zones.insert(it->first);
+        }
+    }
+    std::set<Name>::const_iterator it = zones.begin();
+    if (it == zones.end()) {
+        return;
+    }
+    for (std::set<Name>::const_iterator prev = it++;
+         it != zones.end();
+         prev = it++) {
+        if (it->compare(*prev).getRelation() ==
+            dns::NameComparisonResult::SUBDOMAIN) {
+            nested.insert(*prev);
+        }
+    }
+}
+
+// A memory segment that serializes all operations on another segment with
+// a mutex.  Loading zones concurrently into the same segment is done through
+// this; allocations are cheap compared to the rest of the loading (reading
+// and parsing the source data), so the lock is not a real bottleneck.
+class LockedMemorySegment : public MemorySegment {
+public:
+    LockedMemorySegment(MemorySegment& segment, Mutex& mutex) :
+        segment_(segment), mutex_(mutex)
+    {}
+    virtual void* allocate(size_t size) {
+        Mutex::Locker locker(mutex_);
+        return (segment_.allocate(size));
+    }
+    virtual void deallocate(void* ptr, size_t size) {
+        Mutex::Locker locker(mutex_);
+        segment_.deallocate(ptr, size);
+    }
+    virtual bool allMemoryDeallocated() const {
+        Mutex::Locker locker(mutex_);
+        return (segment_.allMemoryDeallocated());
+    }
+protected:
+    virtual bool setNamedAddressImpl(const char* name, void* addr) {
+        Mutex::Locker locker(mutex_);
+        return (segment_.setNamedAddress(name, addr));
+    }
+    virtual NamedAddressResult getNamedAddressImpl(const char* name) const {
+        Mutex::Locker locker(mutex_);
+        return (segment_.getNamedAddress(name));
+    }
+    virtual bool clearNamedAddressImpl(const char* name) {
+        Mutex::Locker locker(mutex_);
+        return (segment_.clearNamedAddress(name));
+    }
+private:
+    MemorySegment& segment_;
+    Mutex& mutex_;
+};
+
+// A zone table segment that gives access to the memory of another zone
+// table segment only through a LockedMemorySegment.  Everything else is
+// simply delegated.  It is only used to construct ZoneWriters, so the
+// operations on the segment itself are not supported.
+class LockedZoneTableSegment : public ZoneTableSegment {
+public:
+    LockedZoneTableSegment(ZoneTableSegment& segment, const RRClass& rrclass,
+                           Mutex& mutex) :
+        ZoneTableSegment(rrclass),
+        segment_(segment),
+        mem_sgmt_(segment.getMemorySegment(), mutex)
+    {}
+    virtual const std::string& getImplType() const {
+        return (segment_.getImplType());
+    }
+    virtual memory::ZoneTableHeader& getHeader() {
+        return (segment_.getHeader());
+    }
+    virtual const memory::ZoneTableHeader& getHeader() const {
+        return (segment_.getHeader());
+    }
+    virtual MemorySegment& getMemorySegment() {
+        return (mem_sgmt_);
+    }
+    virtual bool isWritable() const {
+        return (segment_.isWritable());
+    }
+    virtual void reset(MemorySegmentOpenMode, ConstElementPtr) {
+        bundy_throw(bundy::NotImplemented,
+                  "LockedZoneTableSegment::reset() is not supported");
+    }
+    virtual void clear() {
+        bundy_throw(bundy::NotImplemented,
+                  "LockedZoneTableSegment::clear() is not supported");
+    }
+    virtual bool isUsable() const {
+        return (segment_.isUsable());
+    }
+private:
+    ZoneTableSegment& segment_;
+    LockedMemorySegment mem_sgmt_;
+};
+
+// This loads the configured zones of a data source into its in-memory
+// cache at configuration time, using one or more threads.
+//
+// Each thread takes the next zone to load, creates its load action (this
+// is serialized, as the underlying data source client is not expected to
+// be thread safe) and loads it into the zone table segment.  The segment
+// itself is protected by a LockedZoneTableSegment, and installing the zones
+// in the table by another mutex, so the expensive part of loading runs in
+// parallel.
+//
+// Load errors in a zone are handled the same way for all the zones: the
+// writer catches them and installs an empty zone.  A missing zone is
+// logged and skipped.  Other errors are fatal for the whole configuration.
+// With a single thread they are propagated as they are; with more threads,
+// the remaining zones are skipped and the first error is rethrown as
+// DataSourceError once all the threads are finished.
+class CacheLoader : boost::noncopyable {
+public:
+    CacheLoader(ZoneTableSegment& segment, const RRClass& rrclass,
+                const std::string& datasrc_name,
+                const internal::CacheConfig& cache_conf,
+                const std::vector<Name>& zones,
+                const boost::function<void()>& on_loaded) :
+        segment_(segment, rrclass, segment_mutex_),
+        rrclass_(rrclass),
+        datasrc_name_(datasrc_name),
+        cache_conf_(cache_conf),
+        zones_(zones),
+        on_loaded_(on_loaded),
+        next_zone_(0),
+        failed_(false)
+    {}
+
+    void load(size_t n_threads) {
+        if (n_threads > zones_.size()) {
+            n_threads = zones_.size();
+        }
+        if (n_threads <= 1) {
+            run();
+            return;
+        }
+
+        std::vector<boost::shared_ptr<Thread> > threads;
+        try {
+            for (size_t i = 1; i < n_threads; ++i) {
+                threads.push_back(boost::shared_ptr<Thread>(
+                    new Thread(boost::bind(&CacheLoader::runCaught, this))));
+            }
+        } catch (...) {
+            // Make the threads already running stop at the next zone and
+            // wait for them; they refer to us.
+            fail("failed to start loader threads");
+            BOOST_FOREACH(const boost::shared_ptr<Thread>& thread, threads) {
+                thread->wait();
+            }
+            throw;
+        }
+        runCaught();
+        BOOST_FOREACH(const boost::shared_ptr<Thread>& thread, threads) {
+            thread->wait();
+        }
+
+        if (failed_) {
+            bundy_throw(DataSourceError, error_);
+        }
+    }
+
+private:
+    // The main loop of each thread.  Exceptions are propagated.
+    void run() {
+        Name zname(Name::ROOT_NAME());
+        memory::LoadAction load_action;
+        while (nextZone(zname, load_action)) {
+            loadZone(zname, load_action);
+            on_loaded_();
+        }
+    }
+
+    // Same as run(), but records the error instead of propagating it.
+    void runCaught() {
+        try {
+            run();
+        } catch (const std::exception& ex) {
+            fail(ex.what());
+        } catch (...) {
+            fail("unexpected error");
+        }
+    }
+
+    void fail(const std::string& error) {
+        Mutex::Locker locker(mutex_);
+        if (!failed_) {
+            failed_ = true;
+            error_ = "Failed to load zones of data source '" + datasrc_name_ +
+                "' into memory: " + error;
+        }
+    }
+
+    // Pick the next zone to load and its load action.  Zones missing in
+    // the underlying data source are skipped here.
+    bool nextZone(Name& zname, memory::LoadAction& load_action) {
+        Mutex::Locker locker(mutex_);
+        while (!failed_ && next_zone_ < zones_.size()) {
+            zname = zones_[next_zone_++];
+            try {
+                load_action = cache_conf_.getLoadAction(rrclass_, zname);
+                // in this loop this should be always true
+                assert(load_action);
+                return (true);
+            } catch (const NoSuchZone&) {
+                LOG_ERROR(logger, DATASRC_CACHE_ZONE_NOTFOUND).
+                    arg(zname).arg(rrclass_).arg(datasrc_name_);
+                on_loaded_();
+            }
+        }
+        return (false);
+    }
+
+    void loadZone(const Name& zname, const memory::LoadAction& load_action) {
+        // For the initial load, we'll let the writer handle
+        // loading error and install an empty zone in the table.
+        memory::ZoneWriter writer(segment_, load_action, zname, rrclass_,
+                                  true);
+
+        std::string error_msg;
+        writer.load(&error_msg);
+        if (!error_msg.empty()) {
+            LOG_ERROR(logger, DATASRC_LOAD_ZONE_ERROR).arg(zname).
+                arg(rrclass_).arg(datasrc_name_).arg(error_msg);
+        }
+        {
+            Mutex::Locker locker(install_mutex_);
+            writer.install();
+        }
+        writer.cleanup();
+    }
+
+    Mutex segment_mutex_;     // protects the memory segment
+    Mutex install_mutex_;     // protects the zone table
+    Mutex mutex_;             // protects the rest of the mutable members
+    LockedZoneTableSegment segment_;
+    const RRClass rrclass_;
+    const std::string datasrc_name_;
+    const internal::CacheConfig& cache_conf_;
+    const std::vector<Name>& zones_;
+    const boost::function<void()> on_loaded_;
+    size_t next_zone_;
+    bool failed_;
+    std::string error_;
+};
+
+}
+
+double
+ConfigurableClientList::getLoadProgress() const {
+    Mutex::Locker locker(progress_mutex_);
+    if (zones_to_load_ == 0) {
+        return (ZoneLoader::PROGRESS_UNKNOWN);
+    }
+    return (static_cast<double>(zones_loaded_) / zones_to_load_);
+}
+
+void
+ConfigurableClientList::addZonesToLoad(size_t count) {
+    Mutex::Locker locker(progress_mutex_);
+    zones_to_load_ += count;
+}
+
+void
+ConfigurableClientList::zoneLoaded() {
+    Mutex::Locker locker(progress_mutex_);
+    ++zones_loaded_;
+}
+
 void
 ConfigurableClientList::configure(const ConstElementPtr& config,
                                   bool allow_cache)
@@ -84,6 +595,12 @@ ConfigurableClientList::configure(const ConstElementPtr& config,
         bundy_throw(bundy::BadValue, "NULL configuration passed");
     }
 
+    {
+        Mutex::Locker locker(progress_mutex_);
+        zones_to_load_ = 0;
+        zones_loaded_ = 0;
+    }
+
     // TODO: Implement recycling from the old configuration.
     size_t i(0); // Outside of the try to be able to access it in the catch
     try {
@@ -148,6 +665,12 @@ ConfigurableClientList::configure(const ConstElementPtr& config,
             if (!cache_conf->isEnabled()) {
                 continue;
             }
+            if (cache_conf->isLoadOnDemand()) {
+                LOG_DEBUG(logger, DBGLVL_TRACE_BASIC,
+                          DATASRC_LIST_CACHE_ON_DEMAND).arg(datasrc_name).
+                    arg(rrclass_);
+                continue;
+            }
             memory::ZoneTableSegment& zt_segment =
                 *new_data_sources.back().ztable_segment_;
             if (!zt_segment.isWritable()) {
@@ -156,37 +679,23 @@ ConfigurableClientList::configure(const ConstElementPtr& config,
                 continue;
             }
 
-            internal::CacheConfig::ConstZoneIterator end_of_zones =
-                cache_conf->end();
+            // Zones can only be loaded concurrently into a local segment;
+            // others may be remapped while growing, invalidating the
+            // addresses the other threads work with.
+            const size_t n_threads = (zt_segment.getImplType() == "local") ?
+                cache_conf->getLoadThreads() : 1;
+            std::vector<Name> zones;
             for (internal::CacheConfig::ConstZoneIterator zone_it =
                      cache_conf->begin();
-                 zone_it != end_of_zones;
+                 zone_it != cache_conf->end();
                  ++zone_it)
             {
-                const Name& zname = zone_it->first;
-                try {
-                    const memory::LoadAction load_action =
-                        cache_conf->getLoadAction(rrclass_, zname);
-                    // in this loop this should be always true
-                    assert(load_action);
-                    // For the initial load, we'll let the writer handle
-                    // loading error and install an empty zone in the table.
-                    memory::ZoneWriter writer(zt_segment, load_action, zname,
-                                              rrclass_, true);
-
-                    std::string error_msg;
-                    writer.load(&error_msg);
-                    if (!error_msg.empty()) {
-                        LOG_ERROR(logger, DATASRC_LOAD_ZONE_ERROR).arg(zname).
-                            arg(rrclass_).arg(datasrc_name).arg(error_msg);
-                    }
-                    writer.install();
-                    writer.cleanup();
-                } catch (const NoSuchZone&) {
-                    LOG_ERROR(logger, DATASRC_CACHE_ZONE_NOTFOUND).
-                        arg(zname).arg(rrclass_).arg(datasrc_name);
-                }
+                zones.push_back(zone_it->first);
             }
+            addZonesToLoad(zones.size());
+            CacheLoader(zt_segment, rrclass_, datasrc_name, *cache_conf, zones,
+                        boost::bind(&ConfigurableClientList::zoneLoaded,
+                                    this)).load(n_threads);
         }
         // If everything is OK up until now, we have the new configuration
         // ready. So just put it there and let the old one die when we exit
@@ -194,6 +703,24 @@ ConfigurableClientList::configure(const ConstElementPtr& config,
         data_sources_.swap(new_data_sources);
         configuration_ = config;
         allow_cache_ = allow_cache;
+
+        // Caching find() results only pays with multiple data sources,
+        // and only works if their zones change by being loaded into the
+        // cache (see addFindCacheEntry()).
+        find_cache_enabled_ = allow_cache && data_sources_.size() > 1;
+        BOOST_FOREACH(const DataSourceInfo& info, data_sources_) {
+            if (!info.cache_ || !info.ztable_segment_ || info.on_demand_) {
+                find_cache_enabled_ = false;
+            }
+        }
+        find_cache_nested_.clear();
+        if (find_cache_enabled_) {
+            if (find_cache_.empty()) {
+                find_cache_.resize(FIND_CACHE_SIZE);
+            }
+            getNestedZones(data_sources_, find_cache_nested_);
+        }
+        ++find_cache_generation_;
     } catch (const TypeError& te) {
         bundy_throw(ConfigurationError, "Malformed configuration at data source "
                   "no. " << i << ": " << te.what());
@@ -224,11 +751,13 @@ private:
 };
 
 boost::shared_ptr<ClientList::FindResult::LifeKeeper>
-genKeeper(const ConfigurableClientList::DataSourceInfo* info) {
+genKeeper(const ConfigurableClientList::DataSourceInfo* info,
+          const DataSourceClient* client)
+{
     if (info == NULL) {
         return (boost::shared_ptr<ClientList::FindResult::LifeKeeper>());
     }
-    if (info->cache_) {
+    if (info->cache_ && info->cache_.get() == client) {
         return (boost::shared_ptr<ClientList::FindResult::LifeKeeper>(
             new CacheKeeper(info->cache_)));
     } else {
@@ -257,19 +786,153 @@ struct ConfigurableClientList::MutableResult {
     const DataSourceInfo* info;
     operator FindResult() const {
         // Conversion to the right result.
-        return (FindResult(datasrc_client, finder, exact, genKeeper(info)));
+        return (FindResult(datasrc_client, finder, exact,
+                           genKeeper(info, datasrc_client)));
     }
 };
 
+namespace {
+
+// Find the zone best matching the name in a data source whose zones are
+// loaded into its cache on demand.  If the best matching zone of the
+// underlying data source is to be cached but isn't loaded yet, its result
+// is returned (and client is set to the underlying data source), and the
+// zone is requested to be loaded; otherwise the cache result is returned.
+DataSourceClient::FindResult
+findOnDemand(const ConfigurableClientList::DataSourceInfo& info,
+             const Name& name, DataSourceClient*& client)
+{
+    internal::OnDemandZones& on_demand = *info.on_demand_;
+    const DataSourceClient::FindResult cached(info.cache_->findZone(name));
+    if (cached.code == result::SUCCESS ||
+        (cached.code == result::PARTIALMATCH && !on_demand.isNested())) {
+        if (cached.zone_finder) {
+            on_demand.hit(cached.zone_finder->getOrigin());
+        }
+        return (cached);
+    }
+
+    const DataSourceClient::FindResult source(
+        info.data_src_client_->findZone(name));
+    if (source.code != result::NOTFOUND && source.zone_finder) {
+        const Name origin(source.zone_finder->getOrigin());
+        if (info.getCacheConfig()->isCachedZone(origin) &&
+            on_demand.miss(origin)) {
+            client = info.data_src_client_;
+            return (source);
+        }
+    }
+    if (cached.zone_finder) {
+        on_demand.hit(cached.zone_finder->getOrigin());
+    }
+    return (cached);
+}
+
+}
+
 ClientList::FindResult
 ConfigurableClientList::find(const dns::Name& name, bool want_exact_match,
                              bool want_finder) const
 {
     MutableResult result;
+    if (find_cache_enabled_) {
+        // Look for the zone of the name, from the name itself up to the
+        // root.  The first one found is the best match, as no other zone
+        // may be below it.
+        LabelSequence suffix(name);
+        while (true) {
+            const ConstFindCacheEntryPtr entry(boost::atomic_load(
+                &find_cache_[suffix.getHash(false) % find_cache_.size()]));
+            if (entry && entry->generation == find_cache_generation_ &&
+                LabelSequence(entry->origin).equals(suffix)) {
+                if (findFromCacheEntry(result, *entry, name, suffix,
+                                       want_exact_match, want_finder)) {
+                    return (result);
+                }
+                break;
+            }
+            if (suffix.getLabelCount() == 1) {
+                break;
+            }
+            suffix.stripLeft(1);
+        }
+    }
+
     findInternal(result, name, want_exact_match, want_finder);
+    if (find_cache_enabled_) {
+        addFindCacheEntry(result);
+    }
     return (result);
 }
 
+// The data sources with the find() cache enabled all serve their zones
+// from the cache, and zones are only added to it (by a ZoneWriter, which
+// doesn't know about the list) or replaced, until the list is reconfigured
+// or a segment is reset.  And they may only add the zones they're
+// configured to cache.  So if a zone with no other zone to be cached below
+// it is the best match for a name, it stays the best match for all of the
+// names in it, unless the zone is also to be cached in a data source
+// searched before (where it may be loaded later).
+void
+ConfigurableClientList::addFindCacheEntry(const MutableResult& result) const {
+    if (!result.matched || !result.finder) {
+        return;
+    }
+    const Name origin(result.finder->getOrigin());
+    if (find_cache_nested_.count(origin) > 0 ||
+        !result.info->getCacheConfig()->isCachedZone(origin)) {
+        return;
+    }
+    for (const DataSourceInfo* info = &data_sources_[0]; info != result.info;
+         ++info) {
+        if (info->getCacheConfig()->isCachedZone(origin)) {
+            return;
+        }
+    }
+
+    const boost::shared_ptr<FindCacheEntry> entry(new FindCacheEntry);
+    entry->generation = find_cache_generation_;
+    entry->index = result.info - &data_sources_[0];
+    const LabelSequence origin_labels(origin);
+    origin_labels.serialize(entry->origin, sizeof(entry->origin));
+    boost::atomic_store(
+        &find_cache_[origin_labels.getHash(false) % find_cache_.size()],
+        ConstFindCacheEntryPtr(entry));
+}
+
+bool
+ConfigurableClientList::findFromCacheEntry(MutableResult& candidate,
+                                           const FindCacheEntry& entry,
+                                           const dns::Name& name,
+                                           const LabelSequence& suffix,
+                                           bool want_exact_match,
+                                           bool want_finder) const
+{
+    const bool exact = suffix.getLabelCount() == name.getLabelCount();
+    if (!exact && want_exact_match) {
+        // No zone may be below the one of the entry, so there's no exact
+        // match anywhere.
+        return (true);
+    }
+    if (entry.index >= data_sources_.size()) {
+        return (false);
+    }
+    const DataSourceInfo& info = data_sources_[entry.index];
+    DataSourceClient* client = info.cache_.get();
+    if (want_finder) {
+        const DataSourceClient::FindResult result(client->findZone(name));
+        if (result.code != (exact ? result::SUCCESS : result::PARTIALMATCH)) {
+            return (false);
+        }
+        candidate.finder = result.zone_finder;
+    }
+    candidate.datasrc_client = client;
+    candidate.matched = true;
+    candidate.exact = exact;
+    candidate.info = &info;
+    return (true);
+}
+
 void
 ConfigurableClientList::findInternal(MutableResult& candidate,
                                      const dns::Name& name,
@@ -278,7 +941,9 @@ ConfigurableClientList::findInternal(MutableResult& candidate,
     BOOST_FOREACH(const DataSourceInfo& info, data_sources_) {
         DataSourceClient* client(info.cache_ ? info.cache_.get() :
                                  info.data_src_client_);
-        const DataSourceClient::FindResult result(client->findZone(name));
+        const DataSourceClient::FindResult result(
+            info.on_demand_ ? findOnDemand(info, name, client) :
+            client->findZone(name));
         // TODO: Once we mark the zones that are not loaded, but are present
         // in the data source somehow, check them too.
         switch (result.code) {
@@ -340,6 +1005,7 @@ ConfigurableClientList::resetMemorySegment
     BOOST_FOREACH(DataSourceInfo& info, data_sources_) {
         if (info.name_ == datasrc_name) {
             ZoneTableSegment& segment = *info.ztable_segment_;
+            ++find_cache_generation_;
             segment.reset(mode, config_params);
             return true;
         }
@@ -401,6 +1067,362 @@ ConfigurableClientList::getCachedZoneWriter(const Name& name,
     return (ZoneWriterPair(ZONE_NOT_FOUND, ZoneWriterPtr()));
 }
 
+namespace {
+double
+getElapsed(const struct timeval& start) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return ((now.tv_sec - start.tv_sec) +
+            (now.tv_usec - start.tv_usec) / 1000000.0);
+}
+
+// Load a zone requested on demand into the cache of the data source, and
+// remove the zones to be evicted for it.  Return if the zone is loaded.
+bool
+loadZoneOnDemand(const ConfigurableClientList::DataSourceInfo& info,
+                 const RRClass& rrclass, const Name& zone)
+{
+    if (info.on_demand_->isLoaded(zone)) {
+        return (false);
+    }
+    memory::LoadAction load_action;
+    try {
+        load_action = info.getCacheConfig()->getLoadAction(rrclass, zone);
+    } catch (const NoSuchZone&) {
+        // It's been removed from the data source since it was requested.
+        LOG_ERROR(logger, DATASRC_CACHE_ZONE_NOTFOUND).
+            arg(zone).arg(rrclass).arg(info.name_);
+        return (false);
+    }
+    // Only zones to be cached are requested
+    assert(load_action);
+
+    struct timeval start;
+    gettimeofday(&start, NULL);
+    memory::ZoneWriter writer(*info.ztable_segment_, load_action, zone,
+                              rrclass, true);
+    std::string error_msg;
+    writer.load(&error_msg);
+    if (!error_msg.empty()) {
+        LOG_ERROR(logger, DATASRC_LOAD_ZONE_ERROR).arg(zone).
+            arg(rrclass).arg(info.name_).arg(error_msg);
+    }
+    writer.install();
+    writer.cleanup();
+    const double load_time = getElapsed(start);
+
+    MemorySegment& mem_sgmt = info.ztable_segment_->getMemorySegment();
+    memory::ZoneTable* table = info.ztable_segment_->getHeader().getTable();
+    const memory::ZoneTable::FindResult found = table->findZone(zone);
+    const size_t memory = (found.code == result::SUCCESS && found.zone_data) ?
+        found.zone_data->getMemoryUsage(rrclass).getTotal() : 0;
+    LOG_DEBUG(logger, DBGLVL_TRACE_BASIC,
+              DATASRC_LIST_ZONE_LOADED_ON_DEMAND).arg(zone).arg(rrclass).
+        arg(info.name_).arg(load_time);
+
+    std::vector<Name> evicted;
+    info.on_demand_->loaded(zone, memory, load_time, evicted);
+    BOOST_FOREACH(const Name& victim, evicted) {
+        const memory::ZoneTable::AddResult removed =
+            table->removeZone(mem_sgmt, victim);
+        if (removed.zone_data) {
+            memory::ZoneData::destroy(mem_sgmt, removed.zone_data, rrclass);
+        }
+        LOG_DEBUG(logger, DBGLVL_TRACE_BASIC, DATASRC_LIST_ZONE_EVICTED).
+            arg(victim).arg(rrclass).arg(info.name_);
+    }
+    return (true);
+}
+
+// Return the serial of the SOA in the given RRset.  The first element of
+// the result is false if there's no SOA RDATA to get the serial from.
+std::pair<bool, Serial>
+getSOASerial(const ConstRRsetPtr& soa) {
+    if (!soa || soa->getRdataCount() == 0) {
+        return (std::pair<bool, Serial>(false, Serial(0)));
+    }
+    return (std::pair<bool, Serial>(
+                true,
+                dynamic_cast<const rdata::generic::SOA&>(
+                    soa->getRdataIterator()->getCurrent()).getSerial()));
+}
+
+// Add RR callback for getMasterFileSerial(); it remembers the serial of the
+// SOA at the origin.
+void
+setMasterFileSerial(const Name& origin, std::pair<bool, Serial>* serial,
+                    const Name& name, const RRClass&, const RRType& type,
+                    const RRTTL&, const rdata::RdataPtr& rdata)
+{
+    if (name == origin && type == RRType::SOA()) {
+        *serial = std::pair<bool, Serial>(
+            true, dynamic_cast<const rdata::generic::SOA&>(*rdata).
+            getSerial());
+    }
+}
+
+// Return the SOA serial in the master file of a zone.  The SOA must be the
+// first RR of the file, so nothing else is read.
+std::pair<bool, Serial>
+getMasterFileSerial(const std::string& filename, const Name& origin,
+                    const RRClass& rrclass)
+{
+    std::pair<bool, Serial> serial(false, Serial(0));
+    MasterLoader loader(filename.c_str(), origin, rrclass,
+                        MasterLoaderCallbacks::getNullCallbacks(),
+                        boost::bind(setMasterFileSerial, origin, &serial,
+                                    _1, _2, _3, _4, _5));
+    loader.loadIncremental(1);
+    return (serial);
+}
+}
+
+size_t
+ConfigurableClientList::loadZonesOnDemand() {
+    size_t loaded = 0;
+    BOOST_FOREACH(const DataSourceInfo& info, data_sources_) {
+        if (!info.on_demand_) {
+            continue;
+        }
+        std::vector<Name> zones;
+        info.on_demand_->takeRequests(zones);
+        BOOST_FOREACH(const Name& zone, zones) {
+            if (loadZoneOnDemand(info, rrclass_, zone)) {
+                ++loaded;
+            }
+        }
+    }
+    return (loaded);
+}
+
+ConfigurableClientList::OnDemandStats
+ConfigurableClientList::getOnDemandStats() const {
+    OnDemandStats stats;
+    BOOST_FOREACH(const DataSourceInfo& info, data_sources_) {
+        if (info.on_demand_) {
+            info.on_demand_->addStats(stats);
+        }
+    }
+    return (stats);
+}
+
+bool
+ConfigurableClientList::isCachedZoneUpToDate(const Name& zone,
+                                             const string& datasrc_name) const
+{
+    BOOST_FOREACH(const DataSourceInfo& info, data_sources_) {
+        if (datasrc_name != info.name_) {
+            continue;
+        }
+        if (!info.cache_ || !info.ztable_segment_ ||
+            !info.ztable_segment_->isUsable()) {
+            return (false);
+        }
+
+        const DataSourceClient::FindResult cached =
+            info.cache_->findZone(zone);
+        if (cached.code != result::SUCCESS || !cached.zone_finder) {
+            return (false);
+        }
+        const ZoneFinderContextPtr context =
+            cached.zone_finder->find(zone, RRType::SOA());
+        if (context->code != ZoneFinder::SUCCESS) {
+            return (false);
+        }
+        const std::pair<bool, Serial> cached_serial =
+            getSOASerial(context->rrset);
+
+        std::pair<bool, Serial> source_serial(false, Serial(0));
+        try {
+            if (info.data_src_client_) {
+                const DataSourceClient::FindResult source =
+                    info.data_src_client_->findZone(zone);
+                if (source.code != result::SUCCESS || !source.zone_finder) {
+                    return (false);
+                }
+                const ZoneFinderContextPtr source_context =
+                    source.zone_finder->find(zone, RRType::SOA());
+                if (source_context->code != ZoneFinder::SUCCESS) {
+                    return (false);
+                }
+                source_serial = getSOASerial(source_context->rrset);
+            } else {
+                // MasterFiles: the file must not have been touched since
+                // the segment was last written, and still have the serial.
+                const std::string filename =
+                    info.getCacheConfig()->getMasterFile(zone);
+                time_t segment_mtime;
+                struct stat file_stat;
+                if (filename.empty() ||
+                    !info.ztable_segment_->getModificationTime(
+                        segment_mtime) ||
+                    stat(filename.c_str(), &file_stat) != 0 ||
+                    file_stat.st_mtime >= segment_mtime) {
+                    return (false);
+                }
+                source_serial = getMasterFileSerial(filename, zone, rrclass_);
+            }
+        } catch (const bundy::Exception&) {
+            // We can't tell, so let the caller reload the zone; any real
+            // problem will be reported then.
+            return (false);
+        }
+
+        return (cached_serial.first && source_serial.first &&
+                cached_serial.second == source_serial.second);
+    }
+
+    return (false);
+}
+
+size_t
+ConfigurableClientList::removeUnconfiguredCachedZones(
+    const string& datasrc_name)
+{
+    BOOST_FOREACH(const DataSourceInfo& info, data_sources_) {
+        if (datasrc_name != info.name_) {
+            continue;
+        }
+        if (!info.cache_ || !info.ztable_segment_ ||
+            !info.ztable_segment_->isWritable()) {
+            return (0);
+        }
+
+        MemorySegment& mem_sgmt = info.ztable_segment_->getMemorySegment();
+        memory::ZoneTable* table =
+            info.ztable_segment_->getHeader().getTable();
+        size_t count = 0;
+        BOOST_FOREACH(const Name& zone, table->getZoneNames()) {
+            if (info.getCacheConfig()->isCachedZone(zone)) {
+                continue;
+            }
+            const memory::ZoneTable::AddResult removed =
+                table->removeZone(mem_sgmt, zone);
+            if (removed.zone_data) {
+                memory::ZoneData::destroy(mem_sgmt, removed.zone_data,
+                                          rrclass_);
+            }
+            LOG_DEBUG(logger, DBGLVL_TRACE_BASIC,
+                      DATASRC_LIST_ZONE_UNCONFIGURED).arg(zone).
+                arg(rrclass_).arg(info.name_);
+            ++count;
+        }
+        if (count > 0) {
+            ++find_cache_generation_;
+        }
+        return (count);
+    }
+    return (0);
+}
+
+std::vector<Name>
+ConfigurableClientList::getCachedZoneNames(const string& datasrc_name) const {
+    BOOST_FOREACH(const DataSourceInfo& info, data_sources_) {
+        if (datasrc_name != info.name_) {
+            continue;
+        }
+        if (!info.cache_ || !info.ztable_segment_ ||
+            !info.ztable_segment_->isUsable()) {
+            break;
+        }
+        return (info.ztable_segment_->getHeader().getTable()->getZoneNames());
+    }
+    return (std::vector<Name>());
+}
+
+bool
+ConfigurableClientList::getCachedZoneMemoryUsage(
+    const Name& zone, const string& datasrc_name,
+    memory::ZoneMemoryUsage& usage) const
+{
+    BOOST_FOREACH(const DataSourceInfo& info, data_sources_) {
+        if (datasrc_name != info.name_) {
+            continue;
+        }
+        if (!info.cache_ || !info.ztable_segment_ ||
+            !info.ztable_segment_->isUsable()) {
+            return (false);
+        }
+        const memory::ZoneTable::FindResult found =
+            info.ztable_segment_->getHeader().getTable()->findZone(zone);
+        if (found.code != result::SUCCESS || found.zone_data == NULL ||
+            found.zone_data->isEmpty()) {
+            return (false);
+        }
+        usage = found.zone_data->getMemoryUsage(rrclass_);
+        return (true);
+    }
+    return (false);
+}
+
+namespace {
+// Load action copying a zone from the in-memory cache of a data source;
+// see compactMemorySegment().  An empty (broken) zone is reported as a load
+// error, so the zone writer installs an empty zone for it.
+memory::ZoneData*
+copyCachedZone(MemorySegment& segment,
+               const InMemoryClient* cache, const RRClass& rrclass,
+               const Name& zone)
+{
+    ZoneIteratorPtr iterator;
+    try {
+        iterator = cache->getIterator(zone);
+    } catch (const EmptyZone& ex) {
+        bundy_throw(ZoneLoaderException, ex.what());
+    }
+    return (memory::loadZoneData(segment, rrclass, zone, *iterator));
+}
+}
+
+bool
+ConfigurableClientList::compactMemorySegment(const string& datasrc_name,
+                                             ConstElementPtr config_params,
+                                             SegmentSize& before,
+                                             SegmentSize& after)
+{
+    BOOST_FOREACH(DataSourceInfo& info, data_sources_) {
+        if (info.name_ != datasrc_name) {
+            continue;
+        }
+        if (!info.cache_ || !info.ztable_segment_ ||
+            !info.ztable_segment_->isUsable()) {
+            return (false);
+        }
+        ZoneTableSegment& segment = *info.ztable_segment_;
+        segment.getSegmentSize(before.size, before.free_size);
+
+        const vector<Name> zones =
+            segment.getHeader().getTable()->getZoneNames();
+        {
+            // The new segment is closed at the end of this block, so it
+            // can be reopened for the data source below.
+            boost::shared_ptr<ZoneTableSegment> new_segment(
+                ZoneTableSegment::create(rrclass_, segment.getImplType()),
+                ZoneTableSegment::destroy);
+            new_segment->reset(ZoneTableSegment::CREATE, config_params);
+            BOOST_FOREACH(const Name& zone, zones) {
+                memory::ZoneWriter writer(*new_segment,
+                                          boost::bind(copyCachedZone, _1,
+                                                      info.cache_.get(),
+                                                      rrclass_, zone),
+                                          zone, rrclass_, true);
+                writer.load();
+                writer.install();
+                writer.cleanup();
+            }
+        }
+        ++find_cache_generation_;
+        segment.reset(ZoneTableSegment::READ_WRITE, config_params);
+        segment.getSegmentSize(after.size, after.free_size);
+
+        LOG_INFO(logger, DATASRC_LIST_SEGMENT_COMPACTED).arg(zones.size()).
+            arg(datasrc_name).arg(rrclass_).arg(before.size).
+            arg(before.free_size).arg(after.size).arg(after.free_size);
+        return (true);
+    }
+    return (false);
+}
+
 // NOTE: This function is not tested, it would be complicated. However, the
 // purpose of the function is to provide a very thin wrapper to be able to
 // replace the call to DataSourceClientContainer constructor in tests.
@@ -16,14 +16,17 @@
 #define DATASRC_CONTAINER_H
 
 #include <util/memory_segment.h>
+#include <util/threads/sync.h>
 
 #include <dns/name.h>
+#include <dns/labelsequence.h>
 #include <dns/rrclass.h>
 #include <cc/data.h>
 #include <exceptions/exceptions.h>
 #include <datasrc/memory/zone_table_segment.h>
 #include <datasrc/zone_table_accessor.h>
 
+#include <set>
 #include <vector>
 #include <boost/shared_ptr.hpp>
 #include <boost/scoped_ptr.hpp>
@@ -44,11 +47,13 @@ typedef boost::shared_ptr<DataSourceClientContainer>
 // and hide real definitions except for itself and tests.
 namespace memory {
 class InMemoryClient;
+struct ZoneMemoryUsage;
 class ZoneWriter;
 }
 
 namespace internal {
 class CacheConfig;
+class OnDemandZones;
 }
 
 /// \brief Segment status of the cache
@@ -375,6 +380,26 @@ public:
         return (configuration_);
     }
 
+    /// \brief Returns the progress of loading zones into the in-memory cache.
+    ///
+    /// While \c configure() is loading zones into the in-memory cache of the
+    /// data sources, this returns the ratio of the zones that have been
+    /// loaded (successfully or not) to all the zones that are to be loaded
+    /// so far.  The zones of a data source are only counted once
+    /// \c configure() reaches it, so, like \c ZoneLoader::getProgress(), the
+    /// returned values may not increase monotonically.  After \c configure()
+    /// completes it reports the result of the last configuration.
+    ///
+    /// If no zone has been scheduled for loading, it returns
+    /// \c ZoneLoader::PROGRESS_UNKNOWN.
+    ///
+    /// Unlike most of the other methods of this class, this one can be
+    /// safely called from a different thread than the one running
+    /// \c configure().
+    ///
+    /// \throw None
+    double getLoadProgress() const;
+
     /// \brief Resets the zone table segment for a datasource with a new
     /// memory segment.
     ///
@@ -448,7 +473,203 @@ public:
                                        bool catch_load_error,
                                        const std::string& datasrc_name = "");
 
+    /// \brief Check if the cached copy of a zone matches its source.
+    ///
+    /// This compares the SOA serial of the zone as currently held in the
+    /// cache of the data source of the given name with the SOA serial
+    /// provided by the underlying data source.  It's intended to be used
+    /// after a persistent (mapped) cache segment has been reopened, so
+    /// zones that have not changed since the segment was written need not
+    /// be loaded again.
+    ///
+    /// For the MasterFiles type, which has no underlying data source, the
+    /// serial is read from the SOA at the beginning of the zone's master
+    /// file, and the file must also be older than the segment (which
+    /// means the segment must be "mapped"; a "local" one has no file).
+    ///
+    /// \note Only the serial (and, for MasterFiles, the modification time)
+    /// is compared, not the zone content.  A zone changed without updating
+    /// its serial, or a master file restored to an older content with the
+    /// same serial and a modification time older than the segment, is
+    /// wrongly considered up to date.
+    ///
+    /// This method returns false whenever it cannot positively tell the
+    /// copies are identical; e.g., if the data source doesn't exist or
+    /// doesn't have a cache, either copy doesn't have the zone or its SOA,
+    /// or an error happens in getting the source SOA.  So the caller can
+    /// always safely (re)load the zone on false.
+    ///
+    /// \param zone The origin of the zone to check.
+    /// \param datasrc_name The name of the data source holding the zone.
+    /// \return true if both copies have the zone with the same SOA serial.
+    bool isCachedZoneUpToDate(const dns::Name& zone,
+                              const std::string& datasrc_name) const;
+
+    /// \brief Remove the zones no longer configured from the cache.
+    ///
+    /// A persistent (mapped) cache segment reopened by a new run can still
+    /// hold zones that have since been removed from the configuration of
+    /// the data source.  This removes every zone that isn't to be cached
+    /// (see \c CacheConfig::isCachedZone()) from the cache of the data
+    /// source of the given name.  Nothing is done unless the cache segment
+    /// is writable.
+    ///
+    /// \param datasrc_name The name of the data source.
+    /// \return The number of the zones removed.
+    size_t removeUnconfiguredCachedZones(const std::string& datasrc_name);
+
+    /// \brief Return the names of the zones held in a cache.
+    ///
+    /// Unlike \c getZoneTableAccessor(), which lists the zones configured
+    /// to be cached, this lists the zones actually in the zone table of the
+    /// cache segment, e.g., of a mapped image built by another process.
+    ///
+    /// \param datasrc_name The name of the data source.
+    /// \return The origins of the zones in the cache, in no particular
+    /// order; empty if the data source doesn't exist, doesn't have a cache
+    /// or its cache segment isn't usable.
+    std::vector<dns::Name>
+    getCachedZoneNames(const std::string& datasrc_name) const;
+
+    /// \brief Return the memory used by a zone in the cache.
+    ///
+    /// This looks for the zone of the exact given name in the cache of
+    /// the data source of the given name, and if found, sets the memory
+    /// used by its data in \c usage (see \c ZoneData::getMemoryUsage()).
+    /// This walks the whole zone data, so it's not a cheap operation for
+    /// large zones.
+    ///
+    /// \param zone The origin of the zone.
+    /// \param datasrc_name The name of the data source holding the zone.
+    /// \param usage Placeholder for the result; only set when this method
+    /// returns true.
+    /// \return true if the zone is found in the cache and has been loaded
+    /// successfully; false otherwise.
+    bool getCachedZoneMemoryUsage(const dns::Name& zone,
+                                  const std::string& datasrc_name,
+                                  memory::ZoneMemoryUsage& usage) const;
+
+    /// \brief Size of the memory segment of a cache.
+    ///
+    /// See \c compactMemorySegment().
+    struct SegmentSize {
+        SegmentSize() : size(0), free_size(0) {}
+        size_t size;      ///< Total size of the segment
+        size_t free_size; ///< The part of the segment not in use
+    };
+
+    /// \brief Rebuild the cache of a data source in a fresh memory segment.
+    ///
+    /// This copies all zones in the current zone table segment of the
+    /// data source of the given name into a new segment, created with
+    /// \c config_params in the \c ZoneTableSegment::CREATE mode, and then
+    /// resets the data source to use the new segment in the
+    /// \c ZoneTableSegment::READ_WRITE mode.  The zones are copied in the
+    /// DNSSEC order of the zone table and of the names in each zone, so
+    /// the new segment has no holes left by previous updates and data
+    /// of related names are placed close to each other.  Empty (broken)
+    /// zones are kept empty.
+    ///
+    /// The zones are copied from the cache itself, not read from the
+    /// underlying data source; so this is cheaper than reloading them, and
+    /// the new segment has the same content even if the data source has
+    /// been changed since the zones were loaded.  The current segment may
+    /// be read-only; it's typically the one readers are using, while
+    /// \c config_params must specify a different one.
+    ///
+    /// The sizes of the old and new segments are set in \c before and
+    /// \c after, for the caller to see how fragmented the old one was.
+    /// They are left 0 for segments that can't tell the sizes (see
+    /// \c memory::ZoneTableSegment::getSegmentSize()).
+    ///
+    /// \throw bundy::NotImplemented The type of the segment (e.g., "local")
+    ///     can't be created from \c config_params.
+    /// \throw Anything \c ZoneTableSegment::reset() can throw for the new
+    ///     segment.  If it's thrown for reopening the new segment at the end,
+    ///     the data source may be left without a usable segment.
+    ///
+    /// \param datasrc_name The name of the data source whose cache to
+    ///     rebuild.
+    /// \param config_params The configuration for the new memory segment.
+    /// \param before Placeholder for the size of the old segment.
+    /// \param after Placeholder for the size of the new segment.
+    /// \return false if there's no data source of the name or it doesn't
+    ///     have a usable cache segment (nothing is done then); true otherwise.
+    bool compactMemorySegment(const std::string& datasrc_name,
+                              bundy::data::ConstElementPtr config_params,
+                              SegmentSize& before, SegmentSize& after);
+
+    /// \brief Statistics of loading zones into the cache on demand.
+    ///
+    /// See \c getOnDemandStats().
+    struct OnDemandStats {
+        OnDemandStats() :
+            hits(0), misses(0), loads(0), evictions(0), load_time(0),
+            memory(0)
+        {}
+        size_t hits;      ///< Zones found in the cache
+        size_t misses;    ///< Zones found in the data source, not loaded yet
+        size_t loads;     ///< Zones loaded into the cache on demand
+        size_t evictions; ///< Zones removed to keep within the memory limit
+        double load_time; ///< Total time of loading the zones, in seconds
+        size_t memory;    ///< Memory used by the currently loaded zones
+    };
+
+    /// \brief Load the zones used since the last call into the cache.
+    ///
+    /// For data sources configured with "cache-load-on-demand", the zones
+    /// to be cached are not loaded by \c configure().  When \c find()
+    /// finds such a zone that's not loaded yet, it returns the zone of the
+    /// underlying data source and records the zone; this method loads the
+    /// recorded zones into the cache, after which \c find() returns them
+    /// from the cache.  Load errors are handled the same way as
+    /// \c configure() does: an empty zone is installed instead.
+    ///
+    /// If the data source has a memory limit ("cache-memory-limit"), the
+    /// least recently used zones are removed from the cache once the loaded
+    /// zones use more memory than that, until they fit again (but the zone
+    /// just loaded is always kept).  They will be loaded again on their
+    /// next use.
+    ///
+    /// As this installs and removes zones of the cache, the same
+    /// restriction as for \c memory::ZoneWriter::install() applies, and
+    /// more: the caller must make sure \c find() isn't called and no result
+    /// of it is in use while this runs.  \c find() itself only updates
+    /// atomic counters for the zones loaded on demand, so it doesn't add
+    /// any lock to the lookups.  The least recently used order is updated
+    /// from them by this method, so it's exact up to the interval of the
+    /// calls.
+    ///
+    /// \throw DataSourceError or anything else the underlying data source
+    ///     might throw on loading is propagated.
+    /// \return The number of zones loaded.
+    size_t loadZonesOnDemand();
+
+    /// \brief Return statistics of loading zones into the cache on demand.
+    ///
+    /// The statistics are summed up over the data sources of the list
+    /// whose zones are loaded on demand, and count from the last
+    /// \c configure().  The number of hits and misses are those of
+    /// \c find() results for such data sources, so the ratio of them gives
+    /// the hit rate of the cache.
+    ///
+    /// Like \c getLoadProgress(), this can be safely called from a different
+    /// thread than the one using the list.
+    ///
+    /// \throw None
+    OnDemandStats getOnDemandStats() const;
+
     /// \brief Implementation of the ClientList::find.
+    ///
+    /// If the list was configured with more than one data source and all
+    /// of them serve their zones from the in-memory cache (loaded by
+    /// \c configure(), not on demand), the data source with the best match
+    /// is remembered per zone, for the zones with no other zones to be
+    /// cached below them.  A search for any name in such a zone then only
+    /// asks this data source again (or nobody at all if \c want_finder is
+    /// false).  The remembered results are dropped when the list is
+    /// reconfigured or a segment is reset or compacted.  They may be used
+    /// and updated by concurrent calls to this method.
     virtual FindResult find(const dns::Name& zone,
                             bool want_exact_match = false,
                             bool want_finder = true) const;
@@ -473,6 +694,10 @@ public:
         boost::shared_ptr<memory::ZoneTableSegment> ztable_segment_;
         std::string name_;
 
+        // The state of loading zones on demand; only set if the cache
+        // is configured so.
+        boost::shared_ptr<internal::OnDemandZones> on_demand_;
+
         // cache_conf_ can be accessed only from this read-only getter,
         // to protect its integrity as much as possible.
         const internal::CacheConfig* getCacheConfig() const {
@@ -565,14 +790,72 @@ private:
     /// to reuse it.
     void findInternal(MutableResult& result, const dns::Name& name,
                       bool want_exact_match, bool want_finder) const;
+
+    /// \brief An entry of the cache of \c find() results.
+    ///
+    /// It records the data source with the best match for the names in a
+    /// zone, if no zone of any of the data sources may be below it.  Entries
+    /// are never modified once stored, and their slots are accessed
+    /// atomically, so \c find() can run in multiple threads.
+    struct FindCacheEntry {
+        size_t generation;      ///< find_cache_generation_ when recorded
+        size_t index;           ///< Index of the matched data source
+        /// The zone origin, as serialized by \c LabelSequence.
+        uint8_t origin[dns::LabelSequence::MAX_SERIALIZED_LENGTH];
+    };
+    typedef boost::shared_ptr<const FindCacheEntry> ConstFindCacheEntryPtr;
+
+    /// \brief Find the zone in the data source recorded in the entry.
+    ///
+    /// \c suffix is the part of \c name matching the entry.  It returns
+    /// false if the result doesn't agree with the entry.
+    bool findFromCacheEntry(MutableResult& result,
+                            const FindCacheEntry& entry,
+                            const dns::Name& name,
+                            const dns::LabelSequence& suffix,
+                            bool want_exact_match, bool want_finder) const;
+
+    /// \brief Record the result of \c findInternal() in the \c find()
+    /// cache, if it can be used for other names in the same zone.
+    void addFindCacheEntry(const MutableResult& result) const;
+
     const bundy::dns::RRClass rrclass_;
 
+    /// \brief Whether \c find() results are cached (see \c find()).
+    bool find_cache_enabled_;
+
+    /// \brief Bumped to invalidate the cached \c find() results.
+    size_t find_cache_generation_;
+
+    /// \brief The cache of \c find() results, indexed by zone origin hash.
+    mutable std::vector<ConstFindCacheEntryPtr> find_cache_;
+
+    /// \brief The zones to be cached that have other zones to be cached
+    /// below them, in any of the data sources.  They're not in the \c find()
+    /// cache.
+    std::set<dns::Name> find_cache_nested_;
+
     /// \brief Currently active configuration.
     bundy::data::ConstElementPtr configuration_;
 
     /// \brief The last set value of allow_cache.
     bool allow_cache_;
 
+    /// \brief Account for zones scheduled for loading into the cache.
+    void addZonesToLoad(size_t count);
+
+    /// \brief Account for a zone loaded into the cache, successfully or not.
+    void zoneLoaded();
+
+    /// \brief Protects the load progress counters below.
+    mutable util::thread::Mutex progress_mutex_;
+
+    /// \brief Number of zones scheduled for loading in the last configure().
+    size_t zones_to_load_;
+
+    /// \brief Number of zones already loaded in the last configure().
+    size_t zones_loaded_;
+
 protected:
     /// \brief The data sources held here.
     ///
@@ -30,12 +30,19 @@
 #include <dns/rdata.h>
 #include <dns/rdataclass.h>
 #include <dns/nsec3hash.h>
+#include <dns/exceptions.h>
+#include <util/buffer.h>
 
 #include <datasrc/exceptions.h>
 #include <datasrc/logger.h>
 
 #include <boost/foreach.hpp>
+#include <boost/noncopyable.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <list>
+#include <map>
 
 using namespace bundy::dns;
 using namespace std;
@@ -81,11 +88,157 @@ private:
 };
 } // end unnamed namespace
 
+// The lookup cache.  It keeps the records of single names (as returned by
+// DatabaseAccessor::getRecords()) and whether names have subdomains, keyed
+// by the zone ID and the name.  An entry is valid only if it was filled in
+// the current generation of its zone; the generation is bumped whenever
+// an updater of this client commits to the zone, and the whole cache is
+// dropped if the database was modified through some other connection.
+// The latter is checked once per findZone() (i.e., once per query), not
+// on every lookup, so a finder keeps seeing the data as of its creation
+// as far as the cache is concerned.
+// The least recently used entries are evicted when the cache is full.
+//
+// Like the accessor itself, it's not thread safe.
+class DatabaseClient::LookupCache : boost::noncopyable {
+public:
+    struct Record {
+        string columns[DatabaseAccessor::COLUMN_COUNT];
+    };
+    typedef vector<Record> Records;
+    typedef boost::shared_ptr<const Records> RecordsPtr;
+
+    LookupCache(size_t max_entries) :
+        max_entries_(max_entries), data_version_(-1)
+    {}
+
+    // Make sure the cache content is valid for the given data version,
+    // as returned by the accessor.  Returns false if nothing should be
+    // cached (if the accessor doesn't provide the version).
+    bool validate(int64_t data_version) {
+        if (data_version != data_version_) {
+            clear();
+            data_version_ = data_version;
+        }
+        return (enabled());
+    }
+
+    bool enabled() const {
+        return (data_version_ >= 0);
+    }
+
+    RecordsPtr getRecords(int zone_id, const string& name) {
+        Entry* entry = findEntry(zone_id, name);
+        return (entry != NULL ? entry->records : RecordsPtr());
+    }
+
+    void setRecords(int zone_id, const string& name, RecordsPtr records) {
+        getEntry(zone_id, name).records = records;
+    }
+
+    // Returns 1 or 0 if it's known whether the name has subdomains, -1
+    // if it's not in the cache.
+    int getSubdomains(int zone_id, const string& name) {
+        Entry* entry = findEntry(zone_id, name);
+        return (entry != NULL ? entry->subdomains : -1);
+    }
+
+    void setSubdomains(int zone_id, const string& name, bool subdomains) {
+        getEntry(zone_id, name).subdomains = subdomains ? 1 : 0;
+    }
+
+    // Forget everything cached for the zone.
+    void invalidateZone(int zone_id) {
+        ++generations_[zone_id];
+    }
+
+    void clear() {
+        entries_.clear();
+        lru_.clear();
+        generations_.clear();
+    }
+
+private:
+    typedef pair<int, string> Key;
+    struct Entry {
+        Entry() : generation(0), subdomains(-1) {}
+        unsigned int generation;
+        RecordsPtr records;
+        int subdomains;
+        list<Key>::iterator lru_pos;
+    };
+    typedef map<Key, Entry> Entries;
+
+    // Returns the valid entry for the name, or NULL.  The entry is marked
+    // as the most recently used one.
+    Entry* findEntry(int zone_id, const string& name) {
+        const Entries::iterator it = entries_.find(Key(zone_id, name));
+        if (it == entries_.end()) {
+            return (NULL);
+        }
+        if (it->second.generation != generations_[zone_id]) {
+            lru_.erase(it->second.lru_pos);
+            entries_.erase(it);
+            return (NULL);
+        }
+        lru_.splice(lru_.end(), lru_, it->second.lru_pos);
+        return (&it->second);
+    }
+
+    // Returns the valid entry for the name, creating it (and evicting the
+    // least recently used one if needed) if it doesn't exist.
+    Entry& getEntry(int zone_id, const string& name) {
+        Entry* entry = findEntry(zone_id, name);
+        if (entry != NULL) {
+            return (*entry);
+        }
+        if (entries_.size() >= max_entries_) {
+            entries_.erase(lru_.front());
+            lru_.pop_front();
+        }
+        const Key key(zone_id, name);
+        Entry& new_entry = entries_[key];
+        new_entry.generation = generations_[zone_id];
+        new_entry.lru_pos = lru_.insert(lru_.end(), key);
+        return (new_entry);
+    }
+
+    const size_t max_entries_;
+    int64_t data_version_;
+    Entries entries_;
+    list<Key> lru_;
+    map<int, unsigned int> generations_;
+};
+
+namespace {
+// Iterator context replaying records stored in the lookup cache.
+class CachedRecordsContext : public DatabaseAccessor::IteratorContext {
+public:
+    CachedRecordsContext(DatabaseClient::LookupCache::RecordsPtr records) :
+        records_(records), position_(records_->begin())
+    {}
+    virtual bool getNext(string (&columns)[DatabaseAccessor::COLUMN_COUNT]) {
+        if (position_ == records_->end()) {
+            return (false);
+        }
+        for (size_t i = 0; i < DatabaseAccessor::COLUMN_COUNT; ++i) {
+            columns[i] = position_->columns[i];
+        }
+        ++position_;
+        return (true);
+    }
+private:
+    const DatabaseClient::LookupCache::RecordsPtr records_;
+    DatabaseClient::LookupCache::Records::const_iterator position_;
+};
+}
+
 
 DatabaseClient::DatabaseClient(const std::string& datasrc_name, RRClass rrclass,
                                boost::shared_ptr<DatabaseAccessor>
-                               accessor) :
-    DataSourceClient(datasrc_name), rrclass_(rrclass), accessor_(accessor)
+                               accessor, size_t lookup_cache_size) :
+    DataSourceClient(datasrc_name), rrclass_(rrclass), accessor_(accessor),
+    cache_(lookup_cache_size > 0 ? new LookupCache(lookup_cache_size) : NULL)
 {
     if (!accessor_) {
         bundy_throw(bundy::InvalidParameter,
@@ -95,12 +248,19 @@ DatabaseClient::DatabaseClient(const std::string& datasrc_name, RRClass rrclass,
 
 DataSourceClient::FindResult
 DatabaseClient::findZone(const Name& name) const {
+    // Drop cached results if the database has been modified since they
+    // were stored.
+    if (cache_) {
+        cache_->validate(accessor_->getDataVersion());
+    }
+
     std::pair<bool, int> zone(accessor_->getZone(name.toText()));
     // Try exact first
     if (zone.first) {
         return (FindResult(result::SUCCESS,
                            ZoneFinderPtr(new Finder(accessor_,
-                                                    zone.second, name))));
+                                                    zone.second, name,
+                                                    cache_))));
     }
     // Then super domains
     // Start from 1, as 0 is covered above
@@ -111,7 +271,8 @@ DatabaseClient::findZone(const Name& name) const {
             return (FindResult(result::PARTIALMATCH,
                                ZoneFinderPtr(new Finder(accessor_,
                                                         zone.second,
-                                                        superdomain))));
+                                                        superdomain,
+                                                        cache_))));
         }
     }
     // No, really nothing
@@ -127,6 +288,9 @@ DatabaseClient::createZone(const Name& zone_name) {
     }
     accessor_->addZone(zone_name.toText());
     transaction.commit();
+    if (cache_) {
+        cache_->clear();
+    }
     return (true);
 }
 
@@ -139,17 +303,37 @@ DatabaseClient::deleteZone(const Name& zone_name) {
     }
     accessor_->deleteZone(zinfo.second);
     transaction.commit();
+    if (cache_) {
+        cache_->clear();
+    }
     return (true);
 }
 
 DatabaseClient::Finder::Finder(boost::shared_ptr<DatabaseAccessor> accessor,
-                               int zone_id, const bundy::dns::Name& origin) :
+                               int zone_id, const bundy::dns::Name& origin,
+                               boost::shared_ptr<LookupCache> cache) :
     accessor_(accessor),
     zone_id_(zone_id),
-    origin_(origin)
+    origin_(origin),
+    cache_(cache)
 { }
 
 namespace {
+// Creates the Rdata of a record returned by IteratorContext::getNext().
+// If the accessor provided the wire-format, it's used so we don't have to
+// parse the text form.
+RdataPtr
+createRdataFromColumns(const RRType& type, const RRClass& cls,
+                       const string (&columns)[DatabaseAccessor::COLUMN_COUNT])
+{
+    const string& wire = columns[DatabaseAccessor::RDATA_WIRE_COLUMN];
+    if (!wire.empty()) {
+        bundy::util::InputBuffer buffer(wire.data(), wire.size());
+        return (createRdata(type, cls, buffer, wire.size()));
+    }
+    return (createRdata(type, cls, columns[DatabaseAccessor::RDATA_COLUMN]));
+}
+
 // Adds the given Rdata to the given RRset
 // If the rrset is an empty pointer, a new one is
 // created with the given name, class, type and ttl
@@ -159,7 +343,7 @@ namespace {
 // Then adds the given rdata to the set
 //
 // Raises a DataSourceError if the type does not
-// match, or if the given rdata string does not
+// match, or if the given rdata (text or wire) does not
 // parse correctly for the given type and class
 //
 // The DatabaseAccessor is passed to print the
@@ -170,7 +354,7 @@ void addOrCreate(bundy::dns::RRsetPtr& rrset,
                     const bundy::dns::RRClass& cls,
                     const bundy::dns::RRType& type,
                     const bundy::dns::RRTTL& ttl,
-                    const std::string& rdata_str,
+                    const string (&columns)[DatabaseAccessor::COLUMN_COUNT],
                     const DatabaseAccessor& db
                 )
 {
@@ -189,7 +373,7 @@ void addOrCreate(bundy::dns::RRsetPtr& rrset,
         }
     }
     try {
-        rrset->addRdata(bundy::dns::rdata::createRdata(type, cls, rdata_str));
+        rrset->addRdata(createRdataFromColumns(type, cls, columns));
     } catch (const bundy::dns::rdata::InvalidRdataText& ivrt) {
         // at this point, rrset may have been initialised for no reason,
         // and won't be used. But the caller would drop the shared_ptr
@@ -197,6 +381,14 @@ void addOrCreate(bundy::dns::RRsetPtr& rrset,
         bundy_throw(DataSourceError,
                     "bad rdata in database for " << name << " "
                     << type << ": " << ivrt.what());
+    } catch (const bundy::dns::DNSMessageFORMERR& ex) {
+        bundy_throw(DataSourceError,
+                    "bad wire-format rdata in database for " << name << " "
+                    << type << ": " << ex.what());
+    } catch (const bundy::util::InvalidBufferPosition& ex) {
+        bundy_throw(DataSourceError,
+                    "short wire-format rdata in database for " << name << " "
+                    << type << ": " << ex.what());
     }
 }
 
@@ -254,7 +446,28 @@ DatabaseClient::Finder::getRRsets(const string& name, const WantedTypes& types,
     bool records_found = false;
     std::map<RRType, RRsetPtr> result;
 
-    // Request the context in case we didn't get one
+    // Request the context in case we didn't get one.  If we have a cache,
+    // the records of the name are taken from there (and stored there if
+    // they aren't yet).
+    if (!context && cache_ && cache_->enabled()) {
+        LookupCache::RecordsPtr records = cache_->getRecords(zone_id_, name);
+        if (!records) {
+            context = accessor_->getRecords(name, zone_id_);
+            if (!context) {
+                bundy_throw(bundy::Unexpected,
+                            "Iterator context null at " + name);
+            }
+            boost::shared_ptr<LookupCache::Records> new_records(
+                new LookupCache::Records);
+            LookupCache::Record record;
+            while (context->getNext(record.columns)) {
+                new_records->push_back(record);
+            }
+            records = new_records;
+            cache_->setRecords(zone_id_, name, records);
+        }
+        context.reset(new CachedRecordsContext(records));
+    }
     if (!context) {
         context = accessor_->getRecords(name, zone_id_);
     }
@@ -288,8 +501,8 @@ DatabaseClient::Finder::getRRsets(const string& name, const WantedTypes& types,
                 // done.
                 // A possible optimization here is to not store them for
                 // types we are certain we don't need
-                sig_store.addSig(rdata::createRdata(cur_type, getClass(),
-                     columns[DatabaseAccessor::RDATA_COLUMN]));
+                sig_store.addSig(createRdataFromColumns(cur_type, getClass(),
+                                                        columns));
             }
 
             if (types.find(cur_type) != types.end() || any) {
@@ -307,8 +520,7 @@ DatabaseClient::Finder::getRRsets(const string& name, const WantedTypes& types,
                 // of the 'type covered' field in the RRSIG Rdata).
                 //cur_sigtype(columns[SIGTYPE_COLUMN]);
                 addOrCreate(result[cur_type], construct_name_object,
-                            getClass(), cur_type, cur_ttl,
-                            columns[DatabaseAccessor::RDATA_COLUMN],
+                            getClass(), cur_type, cur_ttl, columns,
                             *accessor_);
             }
 
@@ -360,6 +572,13 @@ DatabaseClient::Finder::getRRsets(const string& name, const WantedTypes& types,
 
 bool
 DatabaseClient::Finder::hasSubdomains(const std::string& name) {
+    if (cache_ && cache_->enabled()) {
+        const int cached = cache_->getSubdomains(zone_id_, name);
+        if (cached >= 0) {
+            return (cached == 1);
+        }
+    }
+
     // Request the context
     DatabaseAccessor::IteratorContextPtr
         context(accessor_->getRecords(name, zone_id_, true));
@@ -369,7 +588,11 @@ DatabaseClient::Finder::hasSubdomains(const std::string& name) {
     }
 
     std::string columns[DatabaseAccessor::COLUMN_COUNT];
-    return (context->getNext(columns));
+    const bool found = context->getNext(columns);
+    if (cache_ && cache_->enabled()) {
+        cache_->setSubdomains(zone_id_, name, found);
+    }
+    return (found);
 }
 
 // Some manipulation with RRType sets
@@ -1349,8 +1572,7 @@ private:
             name_txt_ = data[DatabaseAccessor::NAME_COLUMN];
             rtype_txt_ = data[DatabaseAccessor::TYPE_COLUMN];
             ttl_txt_ = data[DatabaseAccessor::TTL_COLUMN];
-            rdata_ = rdata::createRdata(RRType(rtype_txt_), class_,
-                                        data[DatabaseAccessor::RDATA_COLUMN]);
+            rdata_ = createRdataFromColumns(RRType(rtype_txt_), class_, data);
         }
     }
 
@@ -1410,8 +1632,10 @@ class DatabaseUpdater : public ZoneUpdater {
 public:
     DatabaseUpdater(boost::shared_ptr<DatabaseAccessor> accessor, int zone_id,
             const Name& zone_name, const RRClass& zone_class,
-            bool journaling) :
-        committed_(false), accessor_(accessor), zone_id_(zone_id),
+            bool journaling,
+            boost::shared_ptr<DatabaseClient::LookupCache> cache) :
+        committed_(false), accessor_(accessor), cache_(cache),
+        zone_id_(zone_id),
         db_name_(accessor->getDBName()), zone_name_(zone_name.toText()),
         zone_class_(zone_class), journaling_(journaling),
         diff_phase_(NOT_STARTED), serial_(0),
@@ -1461,6 +1685,9 @@ private:
 
     bool committed_;
     boost::shared_ptr<DatabaseAccessor> accessor_;
+    // The lookup cache of the client that created us; the cached data of
+    // the zone is invalidated on commit.
+    boost::shared_ptr<DatabaseClient::LookupCache> cache_;
     const int zone_id_;
     const string db_name_;
     const string zone_name_;
@@ -1739,6 +1966,9 @@ DatabaseUpdater::commit() {
     }
     accessor_->commit();
     committed_ = true; // make sure the destructor won't trigger rollback
+    if (cache_) {
+        cache_->invalidateZone(zone_id_);
+    }
 
     // Disable the RRsetCollection if it exists.
     if (rrset_collection_) {
@@ -1770,7 +2000,8 @@ DatabaseClient::getUpdater(const bundy::dns::Name& name, bool replace,
     }
 
     return (ZoneUpdaterPtr(new DatabaseUpdater(update_accessor, zone.second,
-                                               name, rrclass_, journaling)));
+                                               name, rrclass_, journaling,
+                                               cache_)));
 }
 
 //
@@ -1813,8 +2044,8 @@ public:
                                      rrclass_,
                                      RRType(data[Accessor::TYPE_COLUMN]),
                                      RRTTL(data[Accessor::TTL_COLUMN])));
-            rrset->addRdata(rdata::createRdata(rrset->getType(), rrclass_,
-                                               data[Accessor::RDATA_COLUMN]));
+            rrset->addRdata(createRdataFromColumns(rrset->getType(), rrclass_,
+                                                   data));
             LOG_DEBUG(logger, DBG_TRACE_DETAILED,
                       DATASRC_DATABASE_JOURNALREADER_NEXT).
                 arg(rrset->getName()).arg(rrset->getType()).
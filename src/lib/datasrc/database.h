@@ -18,6 +18,7 @@
 #include <string>
 
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/tuple/tuple.hpp>
 
 #include <dns/rrclass.h>
@@ -35,6 +36,8 @@
 #include <map>
 #include <set>
 
+#include <stdint.h>
+
 namespace bundy {
 namespace datasrc {
 
@@ -76,7 +79,9 @@ public:
                             ///< this field is ignored.
         RDATA_COLUMN = 3,   ///< Full text representation of the record's RDATA
         NAME_COLUMN = 4,    ///< The domain name of this RR
-        COLUMN_COUNT = 5    ///< The total number of columns, MUST be value of
+        RDATA_WIRE_COLUMN = 5, ///< Uncompressed wire-format RDATA, if
+                               ///< available (see IteratorContext::getNext())
+        COLUMN_COUNT = 6    ///< The total number of columns, MUST be value of
                             ///< the largest other element in this enum plus 1.
     };
 
@@ -278,11 +283,16 @@ public:
         /// RRset must not be interleaved with any other RRs (eg. RRsets must be
         /// "together").
         ///
+        /// RDATA_WIRE_COLUMN is optional.  A database that stores the RDATA
+        /// in the (uncompressed) wire format can return it there as a binary
+        /// string, in which case the caller builds the RDATA from it and
+        /// RDATA_COLUMN is ignored; this saves parsing the text on every
+        /// lookup.  Otherwise the column must be set to an empty string,
+        /// also when only some of the records have the wire form.
+        ///
         /// \param columns The data will be returned through here. The order
         ///     is specified by the RecordColumns enum, and the size must be
         ///     COLUMN_COUNT
-        /// \todo Do we consider databases where it is stored in binary blob
-        ///     format?
         /// \throw DataSourceError if there's database-related error. If the
         ///     exception (or any other in case of derived class) is thrown,
         ///     the iterator can't be safely used any more.
@@ -851,6 +861,22 @@ public:
     virtual std::string findPreviousNSEC3Hash(int zone_id,
                                               const std::string& hash)
         const = 0;
+
+    /// \brief Returns a version of the database content.
+    ///
+    /// The returned value must change whenever data may have been modified
+    /// through some other connection to the database (another accessor,
+    /// possibly in another process) since the last call.  The
+    /// \c DatabaseClient uses this to decide whether results of earlier
+    /// lookups it has cached are still valid.
+    ///
+    /// A negative value means the accessor can't tell; in that case the
+    /// client doesn't cache anything.  This default implementation always
+    /// returns -1, so accessors need to override it to benefit from the
+    /// cache.
+    ///
+    /// \throw DataSourceError if there's a problem with the database.
+    virtual int64_t getDataVersion() const { return (-1); }
 };
 
 /// \brief Concrete data source client oriented at database backends.
@@ -880,9 +906,22 @@ public:
     /// \param accessor The accessor to the database to use to get data.
     ///  As the parameter suggests, the client takes ownership of the accessor
     ///  and will delete it when itself deleted.
+    /// \param lookup_cache_size The maximum number of names whose lookup
+    ///  results are cached by the finders of this client.  If 0 (the
+    ///  default), lookups are not cached.  The cache is only used if the
+    ///  accessor supports \c DatabaseAccessor::getDataVersion().  The
+    ///  version is checked in \c findZone(), so changes made through other
+    ///  connections are noticed by finders created after them.
     DatabaseClient(const std::string& datasrc_name,
                    bundy::dns::RRClass rrclass,
-                   boost::shared_ptr<DatabaseAccessor> accessor);
+                   boost::shared_ptr<DatabaseAccessor> accessor,
+                   size_t lookup_cache_size = 0);
+
+    /// \brief Cache of per-name lookup results.
+    ///
+    /// This is an internal class shared by the client, its finders and
+    /// updaters; it's defined in the implementation.
+    class LookupCache;
 
 
     /// \brief Corresponding ZoneFinder implementation
@@ -910,8 +949,13 @@ public:
         /// \param origin The name of the origin of this zone. It could query
         ///     it from database, but as the DatabaseClient just searched for
         ///     the zone using the name, it should have it.
+        /// \param cache If non-NULL, the cache of the client in which
+        ///     results of lookups are kept.  Only meant to be used by the
+        ///     \c DatabaseClient.
         Finder(boost::shared_ptr<DatabaseAccessor> database, int zone_id,
-               const bundy::dns::Name& origin);
+               const bundy::dns::Name& origin,
+               boost::shared_ptr<LookupCache> cache =
+               boost::shared_ptr<LookupCache>());
 
         // The following three methods are just implementations of inherited
         // ZoneFinder's pure virtual methods.
@@ -990,6 +1034,7 @@ public:
         boost::shared_ptr<DatabaseAccessor> accessor_;
         const int zone_id_;
         const bundy::dns::Name origin_;
+        boost::shared_ptr<LookupCache> cache_;
 
         /// \brief Shortcut name for the result of getRRsets
         typedef std::pair<bool, std::map<dns::RRType, dns::RRsetPtr> >
@@ -1491,6 +1536,9 @@ private:
 
     /// \brief The accessor to our database.
     const boost::shared_ptr<DatabaseAccessor> accessor_;
+
+    /// \brief The lookup cache shared with our finders (may be NULL).
+    const boost::shared_ptr<LookupCache> cache_;
 };
 
 }
@@ -0,0 +1,178 @@
+// Copyright (C) 2014  Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+// Benchmark of in-memory zone lookups one by one and in batches (see
+// InMemoryZoneFinder::findBatch()).  The difference is expected to show up
+// when the zone is much larger than the last-level cache of the CPU, which
+// is the case with the default zone size.
+
+#include <bench/benchmark.h>
+
+#include <util/memory_segment_local.h>
+
+#include <dns/name.h>
+#include <dns/rrclass.h>
+#include <dns/rrtype.h>
+
+#include <datasrc/memory/zone_data.h>
+#include <datasrc/memory/zone_data_loader.h>
+#include <datasrc/memory/zone_finder.h>
+
+#include <boost/lexical_cast.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+using std::vector;
+using std::string;
+using namespace bundy::bench;
+using namespace bundy::datasrc;
+using namespace bundy::datasrc::memory;
+using namespace bundy::dns;
+
+namespace {
+const Name origin("example.");
+
+class LookupBenchMark {
+public:
+    LookupBenchMark(InMemoryZoneFinder& finder, const vector<Name>& queries) :
+        finder_(finder), queries_(queries)
+    {}
+    unsigned int run() {
+        vector<Name>::const_iterator it;
+        const vector<Name>::const_iterator it_end = queries_.end();
+        for (it = queries_.begin(); it != it_end; ++it) {
+            finder_.find(*it, RRType::A());
+        }
+        return (queries_.size());
+    }
+private:
+    InMemoryZoneFinder& finder_;
+    const vector<Name>& queries_;
+};
+
+class BatchLookupBenchMark {
+public:
+    BatchLookupBenchMark(InMemoryZoneFinder& finder,
+                         const vector<Name>& queries, size_t batch_size) :
+        finder_(finder), queries_(queries), batch_size_(batch_size)
+    {}
+    unsigned int run() {
+        vector<Name> names;
+        const vector<RRType> types(batch_size_, RRType::A());
+        vector<ZoneFinderContextPtr> results;
+        size_t i = 0;
+        for (; i + batch_size_ <= queries_.size(); i += batch_size_) {
+            names.assign(queries_.begin() + i,
+                         queries_.begin() + i + batch_size_);
+            finder_.findBatch(names, types, results);
+        }
+        if (i < queries_.size()) {
+            names.assign(queries_.begin() + i, queries_.end());
+            finder_.findBatch(names, vector<RRType>(names.size(),
+                                                    RRType::A()),
+                              results);
+        }
+        return (queries_.size());
+    }
+private:
+    InMemoryZoneFinder& finder_;
+    const vector<Name>& queries_;
+    const size_t batch_size_;
+};
+
+// Write a zone of the given number of names, each of which has an A RR,
+// and return the names in random order as the queries.  Half of the names
+// are placed one level deeper so the lookups go through more than one
+// level of the tree.
+vector<Name>
+createZone(const string& zone_file, size_t zone_size) {
+    std::ofstream ofs(zone_file.c_str());
+    ofs << "example. 3600 IN SOA . . 0 0 0 0 0\n"
+        << "example. 3600 IN NS ns.example.\n";
+    vector<Name> names;
+    for (size_t i = 0; i < zone_size; ++i) {
+        const string name = "h" + boost::lexical_cast<string>(i) +
+            ((i % 2) == 0 ? "" : (".d" + boost::lexical_cast<string>(i % 97)))
+            + ".example.";
+        ofs << name << " 3600 IN A 192.0.2." << (i % 256) << "\n";
+        names.push_back(Name(name));
+    }
+    std::random_shuffle(names.begin(), names.end());
+    return (names);
+}
+
+void
+usage() {
+    std::cerr << "Usage: batch_lookup_bench [-n iterations] [-z zone_size] "
+        "[-b batch_size]" << std::endl;
+    exit (1);
+}
+}
+
+int
+main(int argc, char* argv[]) {
+    int ch;
+    int iteration = 3;
+    size_t zone_size = 1000000;
+    size_t batch_size = 16;
+    while ((ch = getopt(argc, argv, "n:z:b:")) != -1) {
+        switch (ch) {
+        case 'n':
+            iteration = atoi(optarg);
+            break;
+        case 'z':
+            zone_size = atoi(optarg);
+            break;
+        case 'b':
+            batch_size = atoi(optarg);
+            break;
+        case '?':
+        default:
+            usage();
+        }
+    }
+    argc -= optind;
+    if (argc != 0 || batch_size == 0) {
+        usage();
+    }
+
+    const string zone_file = "batch_lookup_bench.zone";
+    const vector<Name> queries = createZone(zone_file, zone_size);
+    bundy::util::MemorySegmentLocal mem_sgmt;
+    ZoneData* zone_data = loadZoneData(mem_sgmt, RRClass::IN(), origin,
+                                       zone_file);
+    std::remove(zone_file.c_str());
+    InMemoryZoneFinder finder(*zone_data, RRClass::IN());
+
+    std::cout << "Lookups one by one in a zone of " << zone_size
+              << " names" << std::endl;
+    BenchMark<LookupBenchMark>(iteration, LookupBenchMark(finder, queries));
+
+    std::cout << "Lookups in batches of " << batch_size << " in a zone of "
+              << zone_size << " names" << std::endl;
+    BenchMark<BatchLookupBenchMark>(iteration,
+                                    BatchLookupBenchMark(finder, queries,
+                                                         batch_size));
+
+    ZoneData::destroy(mem_sgmt, zone_data, RRClass::IN());
+    return (0);
+}
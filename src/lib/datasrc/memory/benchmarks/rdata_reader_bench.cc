@@ -26,6 +26,7 @@
 
 #include <boost/bind.hpp>
 
+#include <cassert>
 #include <vector>
 #include <sstream>
 
@@ -112,6 +113,46 @@ private:
     MessageRenderer& renderer_;
 };
 
+// Same as ReaderBenchMark, but using FastRdataReader where possible (it's
+// the case for all RR types of the test data).
+class FastReaderBenchMark {
+public:
+    FastReaderBenchMark(const vector<EncodeParam>& encode_params,
+                        MessageRenderer& renderer) :
+        encode_params_(encode_params), renderer_(renderer)
+    {}
+    unsigned int run() {
+        vector<EncodeParam>::const_iterator it;
+        const vector<EncodeParam>::const_iterator it_end =
+            encode_params_.end();
+        renderer_.clear();
+        for (it = encode_params_.begin(); it != it_end; ++it) {
+            FastRdataReader<FastReaderBenchMark> reader(it->rrclass,
+                                                        it->rrtype,
+                                                        &it->data[0],
+                                                        it->rdata_count,
+                                                        it->sig_count, *this);
+            assert(reader.isSupported());
+            reader.iterate();
+            reader.iterateAllSigs();
+        }
+        return (1);
+    }
+    void handleName(const LabelSequence& labels,
+                    RdataNameAttributes attributes)
+    {
+        const bool compress =
+            (attributes & NAMEATTR_COMPRESSIBLE) != 0;
+        renderer_.writeName(labels, compress);
+    }
+    void handleData(const void* data, size_t data_len) {
+        renderer_.writeData(data, data_len);
+    }
+private:
+    const vector<EncodeParam>& encode_params_;
+    MessageRenderer& renderer_;
+};
+
 // Builtin benchmark data.  This is a list of RDATA (of RRs) in a response
 // from a root server for the query for "www.example.com" (as of this
 // implementation).  We use a real world example to make the case practical.
@@ -216,5 +257,10 @@ main(int argc, char* argv[]) {
     std::cout << "Benchmark for RdataReader" << std::endl;
     BenchMark<ReaderBenchMark>(iteration,
                                 ReaderBenchMark(encode_param_list, renderer));
+
+    std::cout << "Benchmark for FastRdataReader" << std::endl;
+    BenchMark<FastReaderBenchMark>(iteration,
+                                   FastReaderBenchMark(encode_param_list,
+                                                       renderer));
     return (0);
 }
@@ -35,6 +35,7 @@
 #include <boost/static_assert.hpp>
 
 #include <ostream>
+#include <vector>
 #include <algorithm>
 #include <cassert>
 
@@ -47,6 +48,9 @@ namespace memory {
 template <typename T>
 class DomainTree;
 
+template <typename T>
+class DomainTreeBuilder;
+
 /// \brief \c DomainTreeNode is used by DomainTree to store any data
 ///     related to one domain name.
 ///
@@ -85,6 +89,7 @@ private:
     /// The DomainTreeNode is meant for use from within DomainTree, so
     /// it has access to it.
     friend class DomainTree<T>;
+    friend class DomainTreeBuilder<T>;
 
     /// \brief Just a type alias
     ///
@@ -184,6 +189,7 @@ public:
         FLAG_USER1 = 0x400000U, ///< Application specific flag
         FLAG_USER2 = 0x200000U, ///< Application specific flag
         FLAG_USER3 = 0x100000U, ///< Application specific flag
+        FLAG_USER4 = 0x080000U, ///< Application specific flag
         FLAG_MAX = 0x400000U    // for integrity check
     };
 private:
@@ -193,7 +199,8 @@ private:
     // explicitly defined in \c Flags.  This constant represents all
     // such flags.
     static const uint32_t SETTABLE_FLAGS = (FLAG_CALLBACK | FLAG_USER1 |
-                                            FLAG_USER2 | FLAG_USER3);
+                                            FLAG_USER2 | FLAG_USER3 |
+                                            FLAG_USER4);
 
 public:
 
@@ -1184,6 +1191,7 @@ private:
 template <typename T>
 class DomainTree : public boost::noncopyable {
     friend class DomainTreeNode<T>;
+    friend class DomainTreeBuilder<T>;
 public:
     /// \brief The return value for the \c find() and insert() methods
     enum Result {
@@ -1342,6 +1350,32 @@ private:
                            bool (*callback)(const DomainTreeNode<T>&, CBARG),
                            CBARG callback_arg);
 
+    /// \brief Static helper function for findImpl() and findBatch().
+    ///
+    /// It compares \c target_labels with \c node, updates \c node_path,
+    /// \c target and \c ret accordingly, and returns the node to be
+    /// examined next, or \c NULL if the search is completed.
+    template <typename TT, typename TTN, typename CBARG>
+    static TTN* findStep(TT* tree,
+                         bundy::dns::LabelSequence& target_labels,
+                         TTN** target,
+                         TTN* node,
+                         DomainTreeNodeChain<T>& node_path,
+                         Result& ret,
+                         bool (*callback)(const DomainTreeNode<T>&, CBARG),
+                         CBARG callback_arg);
+
+    /// \brief Hint the CPU to start loading the given node (and the
+    /// labels stored right after it) into the cache.
+    static void prefetchNode(const DomainTreeNode<T>* node) {
+#ifdef __GNUC__
+        __builtin_prefetch(node);
+        __builtin_prefetch(node->getLabelsData());
+#else
+        (void)node;
+#endif
+    }
+
 public:
     /// \brief Find with callback and node chain
     /// \anchor callback
@@ -1432,6 +1466,50 @@ public:
                 bool (*callback)(const DomainTreeNode<T>&, CBARG),
                 CBARG callback_arg) const;
 
+    /// \brief Find multiple names at once, with callback and node chain.
+    ///
+    /// This is equivalent to calling the const version of the \c find()
+    /// above for each of \c count label sequences, and the results are
+    /// stored in the corresponding element of \c nodes, \c node_paths
+    /// and \c results.  \c callback is called with the corresponding
+    /// element of \c callback_args.
+    ///
+    /// Each lookup is a sequence of dependent memory accesses, which
+    /// would mostly be cache misses if the tree is much larger than the
+    /// cache.  Instead of completing one lookup after another, this method
+    /// advances all of them by one node at a time, and prefetches the next
+    /// node of each lookup before moving to the other lookups; so the
+    /// memory latency of a lookup is hidden behind the comparisons for
+    /// the others.  The benefit depends on the number of lookups; a few
+    /// to a few dozens would be reasonable.
+    ///
+    /// Unlike \c find(), all label sequences must be absolute and all
+    /// node chains must be empty.
+    ///
+    /// \exception bundy::BadValue Any of the label sequences is not
+    ///     absolute, or any of the node chains is not empty.
+    /// \exception std::bad_alloc Memory allocation for internal state fails
+    ///
+    /// \param count The number of lookups.
+    /// \param target_labels Array of \c count label sequences to be found.
+    /// \param nodes Array of \c count node pointers, each of which is
+    ///     set as in \c find().
+    /// \param node_paths Array of \c count empty node chains.
+    /// \param results Array of \c count results, each of which is set to
+    ///     the return value \c find() would return.
+    /// \param callback If non- \c NULL, a call back function to be called
+    ///     at marked nodes.
+    /// \param callback_args Array of \c count arguments passed to
+    ///     \c callback; ignored if \c callback is \c NULL.
+    template <typename CBARG>
+    void findBatch(size_t count,
+                   const bundy::dns::LabelSequence* target_labels,
+                   const DomainTreeNode<T>** nodes,
+                   DomainTreeNodeChain<T>* node_paths,
+                   Result* results,
+                   bool (*callback)(const DomainTreeNode<T>&, CBARG),
+                   const CBARG* callback_args) const;
+
     /// \brief Simple find
     ///
     /// Acts as described in the \ref find section.
@@ -1572,7 +1650,87 @@ public:
     /// This function is mainly intended to be used for debugging.
     uint32_t getNodeCount() const { return (node_count_); }
 
+    /// \brief Memory allocated for a \c DomainTree.
+    ///
+    /// See \c getMemoryUsage().
+    struct MemoryUsage {
+        MemoryUsage() : node_bytes(0), label_bytes(0), data_bytes(0) {}
+        size_t node_bytes;  ///< The tree and node objects
+        size_t label_bytes; ///< The labels stored in the nodes
+        size_t data_bytes;  ///< The data stored in the nodes
+    };
+
+    /// \brief Return the memory allocated for the tree and its data.
+    ///
+    /// The size of the data of each non empty node is given by
+    /// \c data_sizer, which is called as <code>data_sizer(data)</code>
+    /// with a const pointer to the data and returns the size in bytes.
+    ///
+    /// This method walks all the nodes of the tree, so its cost is
+    /// proportional to the size of the tree.
+    ///
+    /// \throw none unless \c data_sizer throws.
+    template <typename DataSizer>
+    MemoryUsage getMemoryUsage(DataSizer data_sizer) const {
+        MemoryUsage usage;
+        usage.node_bytes = sizeof(DomainTree<T>);
+        getMemoryUsageHelper(root_.get(), data_sizer, usage);
+        return (usage);
+    }
+
+    /// \brief Call a function for each non empty node of the tree.
+    ///
+    /// The nodes are visited in DNSSEC order, and \c visitor is called as
+    /// <code>visitor(node)</code> with a const reference to each node.
+    /// Unlike iterating with \c nextNode(), this doesn't need a node chain
+    /// to start from, so it works for trees whose root node is empty.
+    ///
+    /// \throw none unless \c visitor throws.
+    template <typename Visitor>
+    void visitNodes(Visitor& visitor) const {
+        visitNodesHelper(root_.get(), visitor);
+    }
+
 private:
+    /// \brief Helper method for visitNodes()
+    template <typename Visitor>
+    void visitNodesHelper(const DomainTreeNode<T>* node,
+                          Visitor& visitor) const
+    {
+        // Smaller siblings (and their subdomains) come first, then the
+        // node itself, its subdomains, and finally the larger siblings.
+        if (node == NULL) {
+            return;
+        }
+        visitNodesHelper(node->getLeft(), visitor);
+        if (!node->isEmpty()) {
+            visitor(*node);
+        }
+        visitNodesHelper(node->getDown(), visitor);
+        visitNodesHelper(node->getRight(), visitor);
+    }
+
+    /// \brief Helper method for getMemoryUsage()
+    template <typename DataSizer>
+    void getMemoryUsageHelper(const DomainTreeNode<T>* node,
+                              DataSizer& data_sizer,
+                              MemoryUsage& usage) const
+    {
+        // Like getHeightHelper() this is recursive; the depth is bounded
+        // by the height of the red-black trees and the number of labels.
+        if (node == NULL) {
+            return;
+        }
+        usage.node_bytes += sizeof(DomainTreeNode<T>);
+        usage.label_bytes += node->labels_capacity_;
+        if (!node->isEmpty()) {
+            usage.data_bytes += data_sizer(node->getData());
+        }
+        getMemoryUsageHelper(node->getLeft(), data_sizer, usage);
+        getMemoryUsageHelper(node->getRight(), data_sizer, usage);
+        getMemoryUsageHelper(node->getDown(), data_sizer, usage);
+    }
+
     /// \brief Helper method for getHeight()
     size_t getHeightHelper(const DomainTreeNode<T>* node) const;
 
@@ -1846,46 +2004,108 @@ DomainTree<T>::findImpl(TT* tree,
     dns::LabelSequence target_labels(target_labels_orig);
 
     while (node != NULL) {
-        node_path.last_compared_ = node;
-        node_path.last_comparison_ = target_labels.compare(node->getLabels());
-        const bundy::dns::NameComparisonResult::NameRelation relation =
-            node_path.last_comparison_.getRelation();
+        node = findStep<TT, TTN, CBARG>(tree, target_labels, target, node,
+                                        node_path, ret, callback,
+                                        callback_arg);
+    }
 
-        if (relation == bundy::dns::NameComparisonResult::EQUAL) {
-            if (tree->needsReturnEmptyNode_ || !node->isEmpty()) {
-                node_path.push(node);
-                *target = node;
-                ret = EXACTMATCH;
-            }
-            break;
-        } else if (relation == bundy::dns::NameComparisonResult::NONE) {
-            // If the two labels have no hierarchical relationship in terms
-            // of matching, we should continue the binary search.
-            node = (node_path.last_comparison_.getOrder() < 0) ?
-                node->getLeft() : node->getRight();
-        } else {
-            if (relation == bundy::dns::NameComparisonResult::SUBDOMAIN) {
-                if (tree->needsReturnEmptyNode_ || !node->isEmpty()) {
-                    ret = PARTIALMATCH;
-                    *target = node;
-                    if (callback != NULL &&
-                        node->getFlag(DomainTreeNode<T>::FLAG_CALLBACK)) {
-                        if ((callback)(*node, callback_arg)) {
-                            break;
-                        }
-                    }
+    return (ret);
+}
+
+template <typename T>
+template <typename TT, typename TTN, typename CBARG>
+TTN*
+DomainTree<T>::findStep(TT* tree,
+                        bundy::dns::LabelSequence& target_labels,
+                        TTN** target,
+                        TTN* node,
+                        DomainTreeNodeChain<T>& node_path,
+                        Result& ret,
+                        bool (*callback)(const DomainTreeNode<T>&, CBARG),
+                        CBARG callback_arg)
+{
+    node_path.last_compared_ = node;
+    node_path.last_comparison_ = target_labels.compare(node->getLabels());
+    const bundy::dns::NameComparisonResult::NameRelation relation =
+        node_path.last_comparison_.getRelation();
+
+    if (relation == bundy::dns::NameComparisonResult::EQUAL) {
+        if (tree->needsReturnEmptyNode_ || !node->isEmpty()) {
+            node_path.push(node);
+            *target = node;
+            ret = EXACTMATCH;
+        }
+        return (NULL);
+    } else if (relation == bundy::dns::NameComparisonResult::NONE) {
+        // If the two labels have no hierarchical relationship in terms
+        // of matching, we should continue the binary search.
+        return ((node_path.last_comparison_.getOrder() < 0) ?
+                node->getLeft() : node->getRight());
+    } else if (relation == bundy::dns::NameComparisonResult::SUBDOMAIN) {
+        if (tree->needsReturnEmptyNode_ || !node->isEmpty()) {
+            ret = PARTIALMATCH;
+            *target = node;
+            if (callback != NULL &&
+                node->getFlag(DomainTreeNode<T>::FLAG_CALLBACK)) {
+                if ((callback)(*node, callback_arg)) {
+                    return (NULL);
                 }
-                node_path.push(node);
-                target_labels.stripRight(
-                    node_path.last_comparison_.getCommonLabels());
-                node = node->getDown();
-            } else {
-                break;
             }
         }
+        node_path.push(node);
+        target_labels.stripRight(
+            node_path.last_comparison_.getCommonLabels());
+        return (node->getDown());
     }
+    return (NULL);
+}
 
-    return (ret);
+template <typename T>
+template <typename CBARG>
+void
+DomainTree<T>::findBatch(size_t count,
+                         const bundy::dns::LabelSequence* target_labels,
+                         const DomainTreeNode<T>** nodes,
+                         DomainTreeNodeChain<T>* node_paths,
+                         Result* results,
+                         bool (*callback)(const DomainTreeNode<T>&, CBARG),
+                         const CBARG* callback_args) const
+{
+    for (size_t i = 0; i < count; ++i) {
+        if (!node_paths[i].isEmpty() || !target_labels[i].isAbsolute()) {
+            bundy_throw(bundy::BadValue,
+                        "DomainTree::findBatch() is given non-empty node "
+                        "chain or non-absolute label sequence");
+        }
+    }
+
+    // The label sequences are stripped as the lookups go down the tree,
+    // so we need our own copies.
+    std::vector<dns::LabelSequence> labels(target_labels,
+                                           target_labels + count);
+    std::vector<const DomainTreeNode<T>*> next(count, root_.get());
+    std::fill(results, results + count, NOTFOUND);
+
+    size_t active = (root_.get() != NULL) ? count : 0;
+    while (active > 0) {
+        active = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (next[i] == NULL) {
+                continue;
+            }
+            next[i] = findStep<const DomainTree<T>, const DomainTreeNode<T>,
+                               CBARG>(this, labels[i], &nodes[i], next[i],
+                                      node_paths[i], results[i], callback,
+                                      callback != NULL ?
+                                      callback_args[i] : CBARG());
+            if (next[i] != NULL) {
+                // We'll come back to this node after the other lookups
+                // proceed; by then it's hopefully in the cache.
+                prefetchNode(next[i]);
+                ++active;
+            }
+        }
+    }
 }
 
 template <typename T>
@@ -3120,6 +3340,329 @@ DomainTree<T>::dumpDotHelper(std::ostream& os,
     return (*nodecount);
 }
 
+/// \brief Helper to insert names into a \c DomainTree in DNSSEC order.
+///
+/// This is intended for building a tree from names that are (mostly)
+/// given in the DNSSEC order (RFC 4034 Section 6.1), such as when a whole
+/// zone is loaded from a sorted source.  Instead of searching the tree
+/// from the top and rebalancing it for each name, it remembers the path
+/// to the last inserted node, which is the largest node in the tree, and
+/// appends the next name at the right end of the corresponding level with
+/// no rotation.  The levels extended this way are left unbalanced until
+/// \c finish() is called, which rebuilds each level as a balanced
+/// red-black tree in a single pass.  Since the nodes are created in the
+/// order of the names, nodes close to each other in the tree are also
+/// placed close to each other in the memory segment.
+///
+/// A name that is equal to or a superdomain of the last inserted name
+/// doesn't break the order; it's always on the remembered path.  On the
+/// first name that is smaller than the last one, the builder calls
+/// \c finish() and falls back to \c DomainTree::insert() for any further
+/// names.
+///
+/// Until \c finish() is called, the tree is a valid search tree but
+/// doesn't meet the red-black tree properties, and searching it can be
+/// slow.  The tree must not be modified other than through the builder
+/// in the meantime, unless \c reset() is called after that.
+///
+/// The builder keeps pointers to nodes of the tree in local memory.  If
+/// the memory segment is remapped (see \c util::MemorySegmentGrown),
+/// \c reset() must be called before the builder is used for the tree at
+/// its new address.
+template <typename T>
+class DomainTreeBuilder : public boost::noncopyable {
+public:
+    DomainTreeBuilder() : sorted_(true), unbalanced_(false) {}
+
+    /// \brief Insert the domain name into the tree.
+    ///
+    /// This is equivalent to \c DomainTree::insert() on \c tree except
+    /// for the performance characteristics and the (temporary) shape of
+    /// the tree described in the class description.
+    ///
+    /// \throw std::bad_alloc Memory allocation fails
+    typename DomainTree<T>::Result insert(util::MemorySegment& mem_sgmt,
+                                          DomainTree<T>& tree,
+                                          const bundy::dns::Name& target_name,
+                                          DomainTreeNode<T>** new_node);
+
+    /// \brief Rebalance the levels of the tree extended by \c insert().
+    ///
+    /// This doesn't allocate any memory from the memory segment, and
+    /// doesn't change the nodes each level consists of, so pointers to
+    /// the nodes remain valid and \c insert() can still be used after
+    /// this call.
+    ///
+    /// \throw std::bad_alloc Memory allocation for a local work space
+    /// fails.
+    void finish(DomainTree<T>& tree);
+
+    /// \brief Forget the remembered path to the last inserted node.
+    ///
+    /// The next call to \c insert() will find the largest node of the tree
+    /// again.
+    void reset() {
+        path_.clear();
+        ends_.clear();
+    }
+
+    /// \brief Return if all names have been inserted in the DNSSEC order.
+    bool isSorted() const { return (sorted_); }
+
+private:
+    void initPath(DomainTree<T>& tree);
+    void splitPathNode(util::MemorySegment& mem_sgmt, DomainTree<T>& tree,
+                       size_t level,
+                       const bundy::dns::LabelSequence& target_labels,
+                       size_t common_labels);
+    DomainTreeNode<T>* buildBalanced(size_t begin, size_t end, size_t depth,
+                                     size_t red_depth,
+                                     DomainTreeNode<T>* parent);
+
+    // Nodes from the top level down to the last inserted node, each of
+    // which is the rightmost node of its level, and the number of labels
+    // of the absolute name of each of them.
+    std::vector<DomainTreeNode<T>*> path_;
+    std::vector<size_t> ends_;
+
+    // Work space for finish().
+    std::vector<DomainTreeNode<T>*> level_nodes_;
+    std::vector<DomainTreeNode<T>*> stack_;
+
+    bool sorted_;
+    bool unbalanced_;
+};
+
+template <typename T>
+typename DomainTree<T>::Result
+DomainTreeBuilder<T>::insert(util::MemorySegment& mem_sgmt,
+                             DomainTree<T>& tree,
+                             const bundy::dns::Name& target_name,
+                             DomainTreeNode<T>** new_node)
+{
+    if (!sorted_) {
+        return (tree.insert(mem_sgmt, target_name, new_node));
+    }
+    if (path_.empty()) {
+        initPath(tree);
+        if (path_.empty()) {
+            // The tree is empty, so the node simply becomes the root.
+            const typename DomainTree<T>::Result result =
+                tree.insert(mem_sgmt, target_name, new_node);
+            initPath(tree);
+            return (result);
+        }
+    }
+
+    // Build the absolute labels of the last node from the path.
+    uint8_t last_buf[dns::LabelSequence::MAX_SERIALIZED_LENGTH];
+    dns::LabelSequence last_labels(path_.back()->getLabels(), last_buf);
+    for (size_t i = path_.size() - 1; i > 0; --i) {
+        last_labels.extend(path_[i - 1]->getLabels(), last_buf);
+    }
+
+    dns::LabelSequence target_labels(target_name);
+    const bundy::dns::NameComparisonResult compare_result =
+        target_labels.compare(last_labels);
+    const bundy::dns::NameComparisonResult::NameRelation relation =
+        compare_result.getRelation();
+    const size_t common_labels = compare_result.getCommonLabels();
+    size_t level = 0;
+
+    if (relation == bundy::dns::NameComparisonResult::EQUAL) {
+        if (new_node != NULL) {
+            *new_node = path_.back();
+        }
+        return (DomainTree<T>::ALREADYEXISTS);
+    } else if (relation == bundy::dns::NameComparisonResult::SUPERDOMAIN) {
+        // The name is on the path, possibly in the middle of the labels
+        // of a node.  As in DomainTree::insert(), the node is split in
+        // the latter case, and ALREADYEXISTS is returned in either case.
+        while (ends_[level] < common_labels) {
+            ++level;
+        }
+        if (ends_[level] != common_labels) {
+            splitPathNode(mem_sgmt, tree, level, target_labels,
+                          common_labels);
+        }
+        if (new_node != NULL) {
+            *new_node = path_[level];
+        }
+        return (DomainTree<T>::ALREADYEXISTS);
+    } else if (compare_result.getOrder() < 0) {
+        // Out of order.  Make the tree balanced and give up the shortcut.
+        finish(tree);
+        sorted_ = false;
+        reset();
+        return (tree.insert(mem_sgmt, target_name, new_node));
+    } else if (relation == bundy::dns::NameComparisonResult::SUBDOMAIN) {
+        // The node will be the only one in a new level below the last
+        // node.
+        level = path_.size();
+    } else {
+        // The name is larger than any name in the tree, so the node will be
+        // the rightmost one of the level where the name branches off the
+        // path, which may need to be created by splitting a node.
+        while (ends_[level] <= common_labels) {
+            ++level;
+        }
+        if ((level > 0 ? ends_[level - 1] : 0) != common_labels) {
+            splitPathNode(mem_sgmt, tree, level, target_labels,
+                          common_labels);
+            ++level;
+        }
+    }
+
+    target_labels.stripRight(common_labels);
+    // Once a new node is created, no exception will be thrown until the end
+    // of the function.
+    DomainTreeNode<T>* node = DomainTreeNode<T>::create(mem_sgmt,
+                                                        target_labels);
+    if (level == path_.size()) {
+        DomainTreeNode<T>* up_node = path_.back();
+        assert(up_node->getDown() == NULL);
+        node->parent_ = up_node;
+        node->setColor(DomainTreeNode<T>::BLACK);
+        node->setSubTreeRoot(true);
+        up_node->down_ = node;
+    } else {
+        DomainTreeNode<T>* parent = path_[level];
+        assert(parent->getRight() == NULL);
+        node->parent_ = parent;
+        node->setSubTreeRoot(false);
+        parent->right_ = node;
+        unbalanced_ = true;
+    }
+    ++tree.node_count_;
+
+    path_.resize(level);
+    ends_.resize(level);
+    path_.push_back(node);
+    ends_.push_back(target_name.getLabelCount());
+
+    if (new_node != NULL) {
+        *new_node = node;
+    }
+    return (DomainTree<T>::SUCCESS);
+}
+
+template <typename T>
+void
+DomainTreeBuilder<T>::initPath(DomainTree<T>& tree) {
+    reset();
+    // Same as DomainTree::largestNode(), remembering the nodes on the way
+    DomainTreeNode<T>* node = tree.root_.get();
+    size_t labels = 0;
+    while (node != NULL) {
+        if (node->getRight() != NULL) {
+            node = node->getRight();
+        } else {
+            labels += node->getLabels().getLabelCount();
+            path_.push_back(node);
+            ends_.push_back(labels);
+            node = node->getDown();
+        }
+    }
+}
+
+template <typename T>
+void
+DomainTreeBuilder<T>::splitPathNode(util::MemorySegment& mem_sgmt,
+                                    DomainTree<T>& tree, size_t level,
+                                    const bundy::dns::LabelSequence&
+                                    target_labels,
+                                    size_t common_labels)
+{
+    // Make sure the path can be updated without an exception once the
+    // node is split.
+    path_.reserve(path_.size() + 1);
+    ends_.reserve(ends_.size() + 1);
+
+    const size_t start = (level > 0) ? ends_[level - 1] : 0;
+    DomainTreeNode<T>* node = path_[level];
+    uint8_t labels_buf[dns::LabelSequence::MAX_SERIALIZED_LENGTH];
+    const dns::LabelSequence node_labels(node->getLabels(), labels_buf);
+    dns::LabelSequence common_ancestor = target_labels;
+    common_ancestor.stripLeft(target_labels.getLabelCount() - common_labels);
+    common_ancestor.stripRight(start);
+    dns::LabelSequence new_prefix = node_labels;
+    new_prefix.stripRight(common_labels - start);
+    tree.nodeFission(mem_sgmt, *node, new_prefix, common_ancestor);
+
+    path_.insert(path_.begin() + level, node->getParent());
+    ends_.insert(ends_.begin() + level, common_labels);
+}
+
+template <typename T>
+void
+DomainTreeBuilder<T>::finish(DomainTree<T>& tree) {
+    if (!unbalanced_) {
+        return;
+    }
+
+    // Rebuild each level from its nodes in order.  Levels are identified
+    // by the node above it, NULL for the top level.
+    std::vector<DomainTreeNode<T>*> up_nodes(1, NULL);
+    while (!up_nodes.empty()) {
+        DomainTreeNode<T>* up_node = up_nodes.back();
+        up_nodes.pop_back();
+        typename DomainTreeNode<T>::DomainTreeNodePtr* root_ptr =
+            (up_node != NULL) ? &(up_node->down_) : &tree.root_;
+
+        level_nodes_.clear();
+        DomainTreeNode<T>* node = root_ptr->get();
+        while (node != NULL || !stack_.empty()) {
+            if (node != NULL) {
+                stack_.push_back(node);
+                node = node->getLeft();
+            } else {
+                node = stack_.back();
+                stack_.pop_back();
+                level_nodes_.push_back(node);
+                if (node->getDown() != NULL) {
+                    up_nodes.push_back(node);
+                }
+                node = node->getRight();
+            }
+        }
+
+        // With the middle node of each range as the root, all the leaves
+        // are at the deepest two depths.  Making the nodes at the deepest
+        // one red (if it's not full) and all others black satisfies the
+        // red-black tree properties.
+        const size_t count = level_nodes_.size();
+        size_t red_depth = 0;
+        while ((static_cast<size_t>(2) << red_depth) <= count + 1) {
+            ++red_depth;
+        }
+        DomainTreeNode<T>* root = buildBalanced(0, count, 0, red_depth,
+                                                up_node);
+        root->setSubTreeRoot(true);
+        *root_ptr = root;
+    }
+    unbalanced_ = false;
+}
+
+template <typename T>
+DomainTreeNode<T>*
+DomainTreeBuilder<T>::buildBalanced(size_t begin, size_t end, size_t depth,
+                                    size_t red_depth,
+                                    DomainTreeNode<T>* parent)
+{
+    if (begin == end) {
+        return (NULL);
+    }
+    const size_t middle = begin + (end - begin) / 2;
+    DomainTreeNode<T>* node = level_nodes_[middle];
+    node->parent_ = parent;
+    node->setColor(depth == red_depth ? DomainTreeNode<T>::RED :
+                   DomainTreeNode<T>::BLACK);
+    node->setSubTreeRoot(false);
+    node->left_ = buildBalanced(begin, middle, depth + 1, red_depth, node);
+    node->right_ = buildBalanced(middle + 1, end, depth + 1, red_depth, node);
+    return (node);
+}
+
 } // namespace memory
 } // namespace datasrc
 } // namespace bundy
@@ -20,8 +20,12 @@
 
 #include <dns/name.h>
 #include <dns/labelsequence.h>
+#include <dns/master_lexer.h>
 #include <dns/messagerenderer.h>
 #include <dns/rdata.h>
+#include <dns/rdataclass.h>
+#include <dns/rdata/generic/detail/char_string.h>
+#include <dns/rdata/generic/detail/lexer_util.h>
 #include <dns/rrclass.h>
 #include <dns/rrtype.h>
 
@@ -30,11 +34,17 @@
 #include <boost/bind.hpp>
 #include <boost/optional.hpp>
 
+#include <algorithm>
 #include <cassert>
+#include <cctype>
 #include <cstring>
 #include <set>
+#include <utility>
 #include <vector>
 
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
 using namespace bundy::dns;
 using namespace bundy::dns::rdata;
 using std::vector;
@@ -228,6 +238,33 @@ getRdataEncodeSpec(const RRClass& rrclass, const RRType& rrtype) {
     return (generic_data_spec);
 }
 
+RdataLayout
+getRdataLayout(const RRClass& rrclass, const RRType& rrtype,
+               RdataNameAttributes* name_attributes)
+{
+    const RdataEncodeSpec& spec = getRdataEncodeSpec(rrclass, rrtype);
+    if (spec.fields == generic_data_fields) {
+        return (RDATA_LAYOUT_OPAQUE);
+    }
+    switch (rrtype.getCode()) {
+    case 1:                     // A (class IN; otherwise generic above)
+        return (RDATA_LAYOUT_IPV4);
+    case 28:                    // AAAA (likewise)
+        return (RDATA_LAYOUT_IPV6);
+    case 2:                     // NS
+    case 5:                     // CNAME
+        *name_attributes = spec.fields[0].name_attributes;
+        return (RDATA_LAYOUT_NAME);
+    case 15:                    // MX
+        *name_attributes = spec.fields[1].name_attributes;
+        return (RDATA_LAYOUT_MX);
+    case 6:                     // SOA
+        return (RDATA_LAYOUT_SOA);
+    default:
+        return (RDATA_LAYOUT_GENERIC);
+    }
+}
+
 namespace {
 // This class is a helper for RdataEncoder to divide the content of RDATA
 // fields for encoding by "abusing" the  message rendering logic.
@@ -380,6 +417,138 @@ bool
 RdataLess(const ConstRdataPtr& rdata1, const ConstRdataPtr& rdata2) {
     return (rdata1->compare(*rdata2) < 0);
 }
+
+// Check the given Rdata is of type T without making a copy of it; throws
+// std::bad_cast otherwise, just like createRdata() from the Rdata would.
+template <typename T>
+void
+checkRdataType(const Rdata& rdata) {
+    static_cast<void>(dynamic_cast<const T&>(rdata));
+}
+
+// For common RR types, duplicate RDATA are detected by comparing their
+// wire-format data, rather than keeping a copy of each Rdata object to
+// compare them with Rdata::compare().  For these types the two are
+// equivalent, provided that the domain name field (if any, there's at most
+// one of them) is converted to lower case the way rdata::compareNames()
+// does.
+struct WireDedupSpec {
+    void (*check_type)(const Rdata& rdata);
+    int name_offset;            // offset of the name field, or -1
+};
+
+const WireDedupSpec A_DEDUP_SPEC = { checkRdataType<in::A>, -1 };
+const WireDedupSpec AAAA_DEDUP_SPEC = { checkRdataType<in::AAAA>, -1 };
+const WireDedupSpec NS_DEDUP_SPEC = { checkRdataType<generic::NS>, 0 };
+const WireDedupSpec CNAME_DEDUP_SPEC = { checkRdataType<generic::CNAME>, 0 };
+const WireDedupSpec MX_DEDUP_SPEC = { checkRdataType<generic::MX>, 2 };
+const WireDedupSpec TXT_DEDUP_SPEC = { checkRdataType<generic::TXT>, -1 };
+const WireDedupSpec DS_DEDUP_SPEC = { checkRdataType<generic::DS>, -1 };
+const WireDedupSpec NSEC_DEDUP_SPEC = { checkRdataType<generic::NSEC>, 0 };
+const WireDedupSpec NSEC3_DEDUP_SPEC = { checkRdataType<generic::NSEC3>, -1 };
+// The signer's name follows 18 bytes of fixed-length fields.
+const WireDedupSpec RRSIG_DEDUP_SPEC = { checkRdataType<generic::RRSIG>, 18 };
+
+const WireDedupSpec*
+getWireDedupSpec(const RRClass& rrclass, const RRType& rrtype) {
+    if (rrclass == RRClass::IN()) {
+        if (rrtype == RRType::A()) {
+            return (&A_DEDUP_SPEC);
+        } else if (rrtype == RRType::AAAA()) {
+            return (&AAAA_DEDUP_SPEC);
+        }
+    }
+    if (rrtype == RRType::NS()) {
+        return (&NS_DEDUP_SPEC);
+    } else if (rrtype == RRType::CNAME()) {
+        return (&CNAME_DEDUP_SPEC);
+    } else if (rrtype == RRType::MX()) {
+        return (&MX_DEDUP_SPEC);
+    } else if (rrtype == RRType::TXT()) {
+        return (&TXT_DEDUP_SPEC);
+    } else if (rrtype == RRType::DS()) {
+        return (&DS_DEDUP_SPEC);
+    } else if (rrtype == RRType::NSEC()) {
+        return (&NSEC_DEDUP_SPEC);
+    } else if (rrtype == RRType::NSEC3()) {
+        return (&NSEC3_DEDUP_SPEC);
+    }
+    return (NULL);
+}
+
+// Keys for the duplicate detection above.  Each key is a range of
+// (offset, length) in a separate buffer, which can grow (and be
+// reallocated) while keys are added.
+typedef std::pair<size_t, size_t> WireKey;
+
+class WireKeyLess {
+public:
+    WireKeyLess(const vector<uint8_t>* key_data) : key_data_(key_data) {}
+    bool operator()(const WireKey& key1, const WireKey& key2) const {
+        const int cmp = std::memcmp(&(*key_data_)[key1.first],
+                                    &(*key_data_)[key2.first],
+                                    std::min(key1.second, key2.second));
+        return (cmp < 0 || (cmp == 0 && key1.second < key2.second));
+    }
+private:
+    const vector<uint8_t>* key_data_;
+};
+
+// Read an RDATA of the given type, for which RdataEncoder::isTextSupported()
+// is true, from the lexer, and render it in the wire format to 'wire'.  The
+// domain name field of the RDATA (if any) is also set in 'name'.  The
+// checks are the same as those of the Rdata constructors from the lexer.
+void
+parseRdataText(const RRType& rrtype, MasterLexer& lexer, const Name* origin,
+               util::OutputBuffer& wire, boost::optional<Name>& name,
+               generic::detail::CharString& char_string)
+{
+    if (rrtype == RRType::A() || rrtype == RRType::AAAA()) {
+        const MasterToken::StringRegion& region =
+            lexer.getNextToken(MasterToken::STRING).getStringRegion();
+        const bool is_a = (rrtype == RRType::A());
+        uint8_t addr[16];
+        // See in::A for the check of the length.
+        if (region.len != std::strlen(region.beg) ||
+            inet_pton(is_a ? AF_INET : AF_INET6, region.beg, addr) != 1) {
+            bundy_throw(InvalidRdataText, "Bad IN/" << rrtype <<
+                        " RDATA text: '" <<
+                        std::string(region.beg, region.len) << "'");
+        }
+        wire.writeData(addr, is_a ? 4 : 16);
+    } else if (rrtype == RRType::TXT()) {
+        while (true) {
+            const MasterToken& token =
+                lexer.getNextToken(MasterToken::QSTRING, true);
+            if (token.getType() != MasterToken::STRING &&
+                token.getType() != MasterToken::QSTRING) {
+                break;
+            }
+            char_string.clear();
+            generic::detail::stringToCharString(token.getStringRegion(),
+                                                char_string);
+            wire.writeData(&char_string[0], char_string.size());
+        }
+        // Leave the end of line (or file) for the caller.
+        lexer.ungetToken();
+        if (wire.getLength() == 0) {
+            bundy_throw(InvalidRdataText,
+                        "Failed to construct TXT RDATA: empty input");
+        }
+    } else {
+        if (rrtype == RRType::MX()) {
+            const uint32_t num =
+                lexer.getNextToken(MasterToken::NUMBER).getNumber();
+            if (num > 65535) {
+                bundy_throw(InvalidRdataText, "Invalid MX preference: "
+                            << num);
+            }
+            wire.writeUint16(num);
+        }
+        name = generic::detail::createNameFromLexer(lexer, origin);
+        name->toWire(wire);
+    }
+}
 }
 
 struct RdataEncoder::RdataEncoderImpl {
@@ -388,7 +557,9 @@ struct RdataEncoder::RdataEncoderImpl {
                          old_data_len_(0), old_sig_len_(0),
                          old_length_fields_(NULL), old_data_(NULL),
                          old_sig_data_(NULL), olddata_buffer_(0),
-                         rdatas_(RdataLess), rrsigs_(RdataLess)
+                         rdatas_(RdataLess), dedup_spec_(NULL),
+                         wire_buffer_(0), rdata_keys_(WireKeyLess(&key_data_)),
+                         rrsig_keys_(WireKeyLess(&key_data_))
     {}
 
     // Common initialization for RdataEncoder::start().
@@ -413,7 +584,45 @@ struct RdataEncoder::RdataEncoderImpl {
         olddata_buffer_.clear();
 
         rdatas_.clear();
-        rrsigs_.clear();
+
+        dedup_spec_ = getWireDedupSpec(rrclass, rrtype);
+        key_data_.clear();
+        rdata_keys_.clear();
+        rrsig_keys_.clear();
+    }
+
+    // Check if the wire-format data (of RDATA or RRSIG) in the buffer is
+    // a duplicate of one added to the given set of keys, and add it to the
+    // set if not.  Returns true iff it's new.
+    bool addWireKey(set<WireKey, WireKeyLess>& keys,
+                    const util::OutputBuffer& buffer, int name_offset)
+    {
+        const size_t offset = key_data_.size();
+        const size_t len = buffer.getLength();
+        const uint8_t* const data =
+            static_cast<const uint8_t*>(buffer.getData());
+        key_data_.insert(key_data_.end(), data, data + len);
+        if (name_offset >= 0) {
+            // Convert every byte of the name to lower case, including the
+            // length octets, as compareNames() does.
+            uint8_t* const key = &key_data_[offset];
+            size_t pos = name_offset;
+            while (pos < len) {
+                const uint8_t label_len = key[pos];
+                const size_t label_end = std::min(pos + 1 + label_len, len);
+                for (; pos < label_end; ++pos) {
+                    key[pos] = std::tolower(key[pos]);
+                }
+                if (label_len == 0) {
+                    break;
+                }
+            }
+        }
+        if (!keys.insert(WireKey(offset, len)).second) {
+            key_data_.resize(offset);
+            return (false);
+        }
+        return (true);
     }
 
     const RdataEncodeSpec* encode_spec_; // encode spec of current RDATA set
@@ -437,14 +646,23 @@ struct RdataEncoder::RdataEncoderImpl {
     const void* old_sig_data_;
     util::OutputBuffer olddata_buffer_;
 
-    // Temporary storage of Rdata and RRSIGs to be encoded.  They are used
-    // to detect and ignore duplicate data.
+    // Temporary storage of Rdata to be encoded.  They are used to detect
+    // and ignore duplicate data.
     typedef boost::function<bool(const ConstRdataPtr&, const ConstRdataPtr&)>
     RdataCmp;
     // added unique Rdatas
     set<ConstRdataPtr, RdataCmp> rdatas_;
-    // added unique RRSIG Rdatas
-    set<ConstRdataPtr, RdataCmp> rrsigs_;
+
+    // Used instead of rdatas_ if non NULL (see WireDedupSpec).  This is
+    // the case for some common types.  Duplicate RRSIGs are always detected
+    // this way, with RRSIG_DEDUP_SPEC.
+    const WireDedupSpec* dedup_spec_;
+    util::OutputBuffer wire_buffer_;
+    // Placeholder for a character-string of TXT RDATA added from text.
+    generic::detail::CharString char_string_;
+    vector<uint8_t> key_data_;
+    set<WireKey, WireKeyLess> rdata_keys_;
+    set<WireKey, WireKeyLess> rrsig_keys_;
 };
 
 RdataEncoder::RdataEncoder() :
@@ -501,13 +719,14 @@ RdataEncoder::start(RRClass rrclass, RRType rrtype, const void* old_data,
     impl_->old_data_ = cp;
     impl_->old_sig_count_ = old_sig_count;
 
-    // Re-construct RDATAs and RRSIGs in the form of Rdata objects, and
-    // keep them in rdatas_ and rrsigs_ so we can detect and ignore duplicate
-    // data with the existing one later.  We'll also figure out the lengths
-    // of the RDATA and RRSIG part of the data by iterating over the data
-    // fields.  Note that the given old_data shouldn't contain duplicate
-    // Rdata or RRSIG as they should have been generated by this own class,
-    // which ensures that condition; if this assumption doesn't hold, we throw.
+    // Re-construct RDATAs and RRSIGs in the wire format, and keep their
+    // keys (or the Rdata objects in rdatas_ for types without a
+    // WireDedupSpec) so we can detect and ignore duplicate data with the
+    // existing one later.  We'll also figure out the lengths of the RDATA
+    // and RRSIG part of the data by iterating over the data fields.  Note
+    // that the given old_data shouldn't contain duplicate Rdata or RRSIG
+    // as they should have been generated by this own class, which ensures
+    // that condition; if this assumption doesn't hold, we throw.
     size_t total_len = 0;
     RdataReader reader(rrclass, rrtype, old_data, old_rdata_count,
                        old_sig_count,
@@ -515,12 +734,21 @@ RdataEncoder::start(RRClass rrclass, RRType rrtype, const void* old_data,
                                    &total_len),
                        boost::bind(decodeData, _1, _2, &impl_->olddata_buffer_,
                                    &total_len));
+    const WireDedupSpec* const dedup_spec = impl_->dedup_spec_;
     while (reader.iterateRdata()) {
-        util::InputBuffer ibuffer(impl_->olddata_buffer_.getData(),
-                                  impl_->olddata_buffer_.getLength());
-        if (!impl_->rdatas_.insert(
+        bool inserted;
+        if (dedup_spec != NULL) {
+            inserted = impl_->addWireKey(impl_->rdata_keys_,
+                                         impl_->olddata_buffer_,
+                                         dedup_spec->name_offset);
+        } else {
+            util::InputBuffer ibuffer(impl_->olddata_buffer_.getData(),
+                                      impl_->olddata_buffer_.getLength());
+            inserted = impl_->rdatas_.insert(
                 createRdata(rrtype, rrclass, ibuffer,
-                            impl_->olddata_buffer_.getLength())).second) {
+                            impl_->olddata_buffer_.getLength())).second;
+        }
+        if (!inserted) {
             bundy_throw(Unexpected, "duplicate RDATA found in merging RdataSet");
         }
         impl_->olddata_buffer_.clear();
@@ -529,11 +757,8 @@ RdataEncoder::start(RRClass rrclass, RRType rrtype, const void* old_data,
 
     total_len = 0;
     while (reader.iterateSingleSig()) {
-        util::InputBuffer ibuffer(impl_->olddata_buffer_.getData(),
-                                  impl_->olddata_buffer_.getLength());
-        if (!impl_->rrsigs_.insert(
-                createRdata(RRType::RRSIG(), rrclass, ibuffer,
-                            impl_->olddata_buffer_.getLength())).second) {
+        if (!impl_->addWireKey(impl_->rrsig_keys_, impl_->olddata_buffer_,
+                               RRSIG_DEDUP_SPEC.name_offset)) {
             bundy_throw(Unexpected, "duplicate RRSIG found in merging RdataSet");
         }
         impl_->olddata_buffer_.clear();
@@ -548,44 +773,120 @@ RdataEncoder::addRdata(const Rdata& rdata) {
                   "RdataEncoder::addRdata performed before start");
     }
 
-    // Simply ignore duplicate RDATA.  Creating RdataPtr also checks the
-    // given Rdata is of the correct RR type.
-    ConstRdataPtr rdatap = createRdata(*impl_->current_type_,
-                                       *impl_->current_class_, rdata);
-    if (impl_->rdatas_.find(rdatap) != impl_->rdatas_.end()) {
-        return (false);
+    // Simply ignore duplicate RDATA.  Creating RdataPtr (or the type check
+    // for the wire-format comparison) also checks the given Rdata is of the
+    // correct RR type.
+    ConstRdataPtr rdatap;
+    const WireDedupSpec* const dedup_spec = impl_->dedup_spec_;
+    if (dedup_spec != NULL) {
+        dedup_spec->check_type(rdata);
+        impl_->wire_buffer_.clear();
+        rdata.toWire(impl_->wire_buffer_);
+        if (!impl_->addWireKey(impl_->rdata_keys_, impl_->wire_buffer_,
+                               dedup_spec->name_offset)) {
+            return (false);
+        }
+    } else {
+        rdatap = createRdata(*impl_->current_type_, *impl_->current_class_,
+                             rdata);
+        if (impl_->rdatas_.find(rdatap) != impl_->rdatas_.end()) {
+            return (false);
+        }
     }
 
     impl_->field_composer_.startRdata();
     rdata.toWire(impl_->field_composer_);
     impl_->field_composer_.endRdata();
-    impl_->rdatas_.insert(rdatap);
+    if (rdatap) {
+        impl_->rdatas_.insert(rdatap);
+    }
 
     return (true);
 }
 
 bool
-RdataEncoder::addSIGRdata(const Rdata& sig_rdata) {
+RdataEncoder::addRdata(MasterLexer& lexer, const Name* origin) {
     if (impl_->encode_spec_ == NULL) {
         bundy_throw(InvalidOperation,
-                  "RdataEncoder::addSIGRdata performed before start");
+                  "RdataEncoder::addRdata performed before start");
+    }
+    const RRType& rrtype = *impl_->current_type_;
+    if (!isTextSupported(*impl_->current_class_, rrtype)) {
+        bundy_throw(BadValue, "RdataEncoder::addRdata from text is not "
+                  "supported for " << *impl_->current_class_ << "/" <<
+                  rrtype);
     }
 
-    // Ignore duplicate RRSIGs
-    ConstRdataPtr rdatap = createRdata(RRType::RRSIG(), *impl_->current_class_,
-                                       sig_rdata);
-    if (impl_->rrsigs_.find(rdatap) != impl_->rrsigs_.end()) {
+    impl_->wire_buffer_.clear();
+    boost::optional<Name> name;
+    parseRdataText(rrtype, lexer, origin, impl_->wire_buffer_, name,
+                   impl_->char_string_);
+    // Reject the RDATA if anything else follows it, before adding it.
+    const MasterToken::Type next_type = lexer.getNextToken().getType();
+    lexer.ungetToken();
+    if (next_type != MasterToken::END_OF_LINE &&
+        next_type != MasterToken::END_OF_FILE) {
+        bundy_throw(InvalidRdataText, "extra input text for " << rrtype <<
+                  " RDATA");
+    }
+
+    // All supported types have a WireDedupSpec, with the offset of the
+    // name field (if any) in the wire-format data.
+    const WireDedupSpec* const dedup_spec = impl_->dedup_spec_;
+    assert(dedup_spec != NULL);
+    if (!impl_->addWireKey(impl_->rdata_keys_, impl_->wire_buffer_,
+                           dedup_spec->name_offset)) {
         return (false);
     }
 
-    const size_t cur_pos = impl_->rrsig_buffer_.getLength();
-    sig_rdata.toWire(impl_->rrsig_buffer_);
-    const size_t rrsig_datalen = impl_->rrsig_buffer_.getLength() - cur_pos;
+    RdataFieldComposer& composer = impl_->field_composer_;
+    composer.startRdata();
+    if (name) {
+        if (dedup_spec->name_offset > 0) {
+            composer.writeData(impl_->wire_buffer_.getData(),
+                               dedup_spec->name_offset);
+        }
+        composer.writeName(*name, true);
+    } else {
+        composer.writeData(impl_->wire_buffer_.getData(),
+                           impl_->wire_buffer_.getLength());
+    }
+    composer.endRdata();
+
+    return (true);
+}
+
+bool
+RdataEncoder::isTextSupported(const RRClass& rrclass, const RRType& rrtype) {
+    if (rrtype == RRType::A() || rrtype == RRType::AAAA()) {
+        return (rrclass == RRClass::IN());
+    }
+    return (rrtype == RRType::NS() || rrtype == RRType::CNAME() ||
+            rrtype == RRType::MX() || rrtype == RRType::TXT());
+}
+
+bool
+RdataEncoder::addSIGRdata(const Rdata& sig_rdata) {
+    if (impl_->encode_spec_ == NULL) {
+        bundy_throw(InvalidOperation,
+                  "RdataEncoder::addSIGRdata performed before start");
+    }
+
+    RRSIG_DEDUP_SPEC.check_type(sig_rdata);
+    impl_->wire_buffer_.clear();
+    sig_rdata.toWire(impl_->wire_buffer_);
+    const size_t rrsig_datalen = impl_->wire_buffer_.getLength();
     if (rrsig_datalen > 0xffff) {
         bundy_throw(RdataEncodingError, "RRSIG is too large: "
                   << rrsig_datalen << " bytes");
     }
-    impl_->rrsigs_.insert(rdatap);
+    // Ignore duplicate RRSIGs
+    if (!impl_->addWireKey(impl_->rrsig_keys_, impl_->wire_buffer_,
+                           RRSIG_DEDUP_SPEC.name_offset)) {
+        return (false);
+    }
+    impl_->rrsig_buffer_.writeData(impl_->wire_buffer_.getData(),
+                                   rrsig_datalen);
     impl_->rrsig_lengths_.push_back(rrsig_datalen);
 
     return (true);
@@ -25,6 +25,8 @@
 #include <boost/function.hpp>
 #include <boost/noncopyable.hpp>
 
+#include <cassert>
+
 /// \file rdata_serialization.h
 ///
 /// This file defines a set of interfaces (classes, types, constants) to
@@ -122,7 +124,9 @@ public:
 /// for the purpose of encoding (but it's not completely type safe; for
 /// example, it wouldn't distinguish TXT RDATA and HINFO RDATA.
 /// Likewise, an \c bundy::dns::rdata::Rdata given to \c addSIGRdata() is
-/// expected to be of RRSIG, but the method does not check the assumption).
+/// expected to be of RRSIG, but the method does not check its covered type).
+/// For some common types \c addRdata() can also read the RDATA directly
+/// from the text of a master file.
 ///
 /// After passing the complete set of RDATA and their RRSIG, the application
 /// is expected to call \c getStorageLength() to know the size of storage
@@ -239,6 +243,46 @@ public:
     /// it's a duplicate and ignored.
     bool addRdata(const dns::rdata::Rdata& rdata);
 
+    /// \brief Add an RDATA for encoding from its textual representation.
+    ///
+    /// This is similar to the other version of \c addRdata(), but reads
+    /// the RDATA from a \c MasterLexer positioned at the beginning of the
+    /// RDATA of an RR in a master file, and encodes it directly without
+    /// constructing an \c Rdata object.  It's supported only for some
+    /// common types of RDATA, see \c isTextSupported().
+    ///
+    /// The RDATA must be followed by the end of line (or file), which
+    /// is left in the lexer for the caller.  If the text is not a valid
+    /// RDATA of the type, or something else follows it, an exception is
+    /// thrown and nothing is added to the session; the lexer may be left
+    /// in the middle of the line.  In this case the caller can still
+    /// continue the session.
+    ///
+    /// \throw InvalidOperation called before start().
+    /// \throw BadValue The RR class and type of the session are not
+    /// supported (see \c isTextSupported()).
+    /// \throw dns::DNSTextError The text is not a valid RDATA of the type.
+    /// \throw dns::MasterLexer::LexerError Unexpected token in the RDATA.
+    /// \throw RdataEncodingError A very unusual case, such as over 64KB RDATA.
+    /// \throw std::bad_alloc Internal memory allocation failure.
+    ///
+    /// \param lexer A \c MasterLexer from which the RDATA is read.
+    /// \param origin If non NULL, the origin for relative domain names
+    /// in the RDATA.
+    /// \return true if the given RDATA was added to encode; false if
+    /// it's a duplicate and ignored.
+    bool addRdata(dns::MasterLexer& lexer, const dns::Name* origin);
+
+    /// \brief Return whether RDATA of the given class and type can be
+    /// added from text.
+    ///
+    /// Currently these are A and AAAA of class IN, and NS, CNAME, MX and
+    /// TXT.
+    ///
+    /// \throw none
+    static bool isTextSupported(const dns::RRClass& rrclass,
+                                const dns::RRType& rrtype);
+
     /// \brief Add an RRSIG RDATA for encoding.
     ///
     /// This method updates internal state of the \c RdataEncoder() with the
@@ -249,9 +293,8 @@ public:
     ///
     /// The passed \c sig_rdata is expected to be of type RRSIG and cover
     /// the RR type specified at the call to \c start() to this encoding
-    /// session.  But this method does not check if it is the case at all;
-    /// it could even accept any type of RDATA as opaque data.  It's caller's
-    /// responsibility to ensure the assumption.
+    /// session.  This method checks that it's of type RRSIG, but not the
+    /// covered type; it's caller's responsibility to ensure the assumption.
     ///
     /// This method checks if the given RRSIG RDATA is a duplicate of already
     /// added one (including ones encoded in the old data if the session
@@ -269,6 +312,7 @@ public:
     /// The same note about exception safety as \c addRdata() applies.
     ///
     /// \throw InvalidOperation called before start().
+    /// \throw std::bad_cast The given Rdata is not of type RRSIG.
     /// \throw RdataEncodingError A very unusual case, such as over 64KB RDATA.
     /// \throw std::bad_alloc Internal memory allocation failure.
     ///
@@ -573,6 +617,183 @@ private:
                           const DataAction& data_action);
 };
 
+/// \brief Encoding layouts of RDATA known to \c FastRdataReader.
+///
+/// This is mostly an implementation detail of \c FastRdataReader;
+/// applications shouldn't have to use it directly.
+enum RdataLayout {
+    RDATA_LAYOUT_GENERIC = 0,   ///< Any other layout (not supported)
+    RDATA_LAYOUT_OPAQUE,        ///< Single variable-length data field
+    RDATA_LAYOUT_IPV4,          ///< IPv4 address (class IN A)
+    RDATA_LAYOUT_IPV6,          ///< IPv6 address (class IN AAAA)
+    RDATA_LAYOUT_NAME,          ///< Single domain name (NS, CNAME)
+    RDATA_LAYOUT_MX,            ///< 16-bit data + domain name (MX)
+    RDATA_LAYOUT_SOA            ///< 2 domain names + 20 bytes of data (SOA)
+};
+
+/// \brief Return the encoding layout of RDATA of the given class and type.
+///
+/// If the layout is \c RDATA_LAYOUT_NAME or \c RDATA_LAYOUT_MX, the
+/// attributes of the domain name are stored in \c name_attributes.
+RdataLayout getRdataLayout(const dns::RRClass& rrclass,
+                           const dns::RRType& rrtype,
+                           RdataNameAttributes* name_attributes);
+
+/// \brief Compile-time specialized variant of \c RdataReader.
+///
+/// This class reads the same encoded data as \c RdataReader does, but
+/// the actions for names and opaque data are given as a \c Handler object
+/// that must have the following methods:
+/// \code
+/// void handleName(const dns::LabelSequence& labels,
+///                 RdataNameAttributes attributes);
+/// void handleData(const void* data, size_t size);
+/// \endcode
+/// They are called directly (and can be inlined), instead of through
+/// \c boost::function objects for each field.  Also, the fields of the
+/// most common RR types are read by code specialized for their layout
+/// (see \c RdataLayout) rather than by interpreting the encoding spec.
+///
+/// RRSIGs and all types encoded as a single opaque field (such as TXT and
+/// DS) are supported, too.  For other types (e.g., SRV or NSEC),
+/// \c isSupported() returns false, and the caller needs to use
+/// \c RdataReader instead.  No other method can be called in that case.
+///
+/// This class only provides the per-RDATA iteration interface of
+/// \c RdataReader; there's no rewind().
+template <typename Handler>
+class FastRdataReader {
+public:
+    /// \brief Constructor
+    ///
+    /// The parameters are the same as those of \c RdataReader, except
+    /// for \c handler.  It's stored as a reference, so it must be valid
+    /// for the life of this object.
+    FastRdataReader(const dns::RRClass& rrclass, const dns::RRType& rrtype,
+                    const void* data, size_t rdata_count, size_t sig_count,
+                    Handler& handler) :
+        handler_(handler),
+        name_attributes_(NAMEATTR_NONE),
+        layout_(getRdataLayout(rrclass, rrtype, &name_attributes_)),
+        rdata_count_(rdata_count), sig_count_(sig_count),
+        var_count_total_(layout_ == RDATA_LAYOUT_OPAQUE ? rdata_count : 0),
+        lengths_(static_cast<const uint16_t*>(data)),
+        data_(static_cast<const uint8_t*>(data) +
+              (var_count_total_ + sig_count) * sizeof(uint16_t)),
+        sigs_(NULL), rdata_pos_(0), data_pos_(0), sig_pos_(0),
+        sig_data_pos_(0)
+    {}
+
+    /// \brief Return if the RR type is supported by this class.
+    bool isSupported() const {
+        return (layout_ != RDATA_LAYOUT_GENERIC);
+    }
+
+    /// \brief Same as \c RdataReader::iterateRdata().
+    bool iterateRdata() {
+        return (readRdata(handler_));
+    }
+
+    /// \brief Same as \c RdataReader::iterate().
+    void iterate() {
+        while (iterateRdata()) {}
+    }
+
+    /// \brief Same as \c RdataReader::iterateSingleSig().
+    bool iterateSingleSig() {
+        if (sig_pos_ == sig_count_) {
+            return (false);
+        }
+        if (sigs_ == NULL) {
+            // Skip over the rest of the RDATA to find where the signatures
+            // start, and then restore the state.
+            const size_t rdata_pos = rdata_pos_;
+            const size_t data_pos = data_pos_;
+            NullHandler null_handler;
+            while (readRdata(null_handler)) {}
+            assert(sigs_ != NULL);
+            rdata_pos_ = rdata_pos;
+            data_pos_ = data_pos;
+        }
+        const size_t length = lengths_[var_count_total_ + sig_pos_];
+        const uint8_t* const pos = sigs_ + sig_data_pos_;
+        sig_data_pos_ += length;
+        ++sig_pos_;
+        handler_.handleData(pos, length);
+        return (true);
+    }
+
+    /// \brief Same as \c RdataReader::iterateAllSigs().
+    void iterateAllSigs() {
+        while (iterateSingleSig()) {}
+    }
+
+private:
+    struct NullHandler {
+        void handleName(const dns::LabelSequence&, RdataNameAttributes) {}
+        void handleData(const void*, size_t) {}
+    };
+
+    template <typename H>
+    void readName(H& handler, RdataNameAttributes attributes) {
+        const dns::LabelSequence labels(data_ + data_pos_);
+        data_pos_ += labels.getSerializedLength();
+        handler.handleName(labels, attributes);
+    }
+
+    template <typename H>
+    void readData(H& handler, size_t length) {
+        const uint8_t* const pos = data_ + data_pos_;
+        data_pos_ += length;
+        handler.handleData(pos, length);
+    }
+
+    template <typename H>
+    bool readRdata(H& handler) {
+        if (rdata_pos_ == rdata_count_) {
+            sigs_ = data_ + data_pos_;
+            return (false);
+        }
+        switch (layout_) {
+        case RDATA_LAYOUT_OPAQUE:
+            readData(handler, lengths_[rdata_pos_]);
+            break;
+        case RDATA_LAYOUT_IPV4:
+            readData(handler, 4);
+            break;
+        case RDATA_LAYOUT_IPV6:
+            readData(handler, 16);
+            break;
+        case RDATA_LAYOUT_NAME:
+            readName(handler, name_attributes_);
+            break;
+        case RDATA_LAYOUT_MX:
+            readData(handler, sizeof(uint16_t));
+            readName(handler, name_attributes_);
+            break;
+        case RDATA_LAYOUT_SOA:
+            readName(handler, NAMEATTR_COMPRESSIBLE);
+            readName(handler, NAMEATTR_COMPRESSIBLE);
+            readData(handler, sizeof(uint32_t) * 5);
+            break;
+        case RDATA_LAYOUT_GENERIC:
+            assert(false);
+        }
+        ++rdata_pos_;
+        return (true);
+    }
+
+    Handler& handler_;
+    RdataNameAttributes name_attributes_;
+    const RdataLayout layout_;
+    const size_t rdata_count_, sig_count_, var_count_total_;
+    const uint16_t* const lengths_;
+    const uint8_t* const data_;
+    const uint8_t* sigs_;
+    size_t rdata_pos_, data_pos_;
+    size_t sig_pos_, sig_data_pos_;
+};
+
 } // namespace memory
 } // namespace datasrc
 } // namespace bundy
@@ -118,17 +118,28 @@ sanityChecks(const ConstRRsetPtr& rrset, const ConstRRsetPtr &sig_rrset,
 } // Anonymous namespace
 
 RdataSet*
-RdataSet::packSet(util::MemorySegment& mem_sgmt, RdataEncoder& encoder,
+RdataSet::packSet(util::MemorySegment& mem_sgmt, const RdataEncoder& encoder,
                   size_t rdata_count, size_t rrsig_count, const RRType& rrtype,
                   const RRTTL& rrttl)
 {
+    const size_t links_len = needsAdditionalLinks(rrtype) ?
+        sizeof(AdditionalLinkPtr) * rdata_count : 0;
+    const size_t refcount_len =
+        (rrtype == RRType::NS() && rrsig_count == 0) ? sizeof(uint32_t) : 0;
     const size_t ext_rrsig_count_len =
         rrsig_count >= MANY_RRSIG_COUNT ? sizeof(uint16_t) : 0;
     const size_t data_len = encoder.getStorageLength();
-    void* p = mem_sgmt.allocate(sizeof(RdataSet) + ext_rrsig_count_len +
-                                data_len);
+    void* p = mem_sgmt.allocate(sizeof(RdataSet) + links_len + refcount_len +
+                                ext_rrsig_count_len + data_len);
     RdataSet* rdataset = new(p) RdataSet(rrtype, rdata_count, rrsig_count,
                                          rrttl);
+    AdditionalLinkPtr* links = rdataset->getAdditionalLinkBuf();
+    for (size_t i = 0; i < rdataset->getAdditionalLinkCount(); ++i) {
+        new(&links[i]) AdditionalLinkPtr(NULL);
+    }
+    if (rdataset->isShareable()) {
+        *rdataset->getRefCountBuf() = 1;
+    }
     if (rrsig_count >= RdataSet::MANY_RRSIG_COUNT) {
         *rdataset->getExtSIGCountBuf() = rrsig_count;
     }
@@ -197,6 +208,24 @@ RdataSet::create(util::MemorySegment& mem_sgmt, RdataEncoder& encoder,
                     rrttl));
 }
 
+RdataSet*
+RdataSet::createFromEncoder(util::MemorySegment& mem_sgmt,
+                            const RdataEncoder& encoder, const RRType& rrtype,
+                            const RRTTL& rrttl, size_t rdata_count)
+{
+    if (rdata_count == 0) {
+        bundy_throw(BadValue, "Empty RDATA for RdataSet");
+    }
+    if (rrtype == RRType::RRSIG()) {
+        bundy_throw(BadValue, "RRSIG cannot be the type of RdataSet");
+    }
+    if (rdata_count > MAX_RDATA_COUNT) {
+        bundy_throw(RdataSetError, "Too many RDATAs for RdataSet: "
+                  << rdata_count << ", must be <= " << MAX_RDATA_COUNT);
+    }
+    return (packSet(mem_sgmt, encoder, rdata_count, 0, rrtype, rrttl));
+}
+
 namespace {
 
 void writeName(util::OutputBuffer* buffer, const LabelSequence& name,
@@ -292,17 +321,29 @@ void
 RdataSet::destroy(util::MemorySegment& mem_sgmt, RdataSet* rdataset,
                   RRClass rrclass)
 {
+    if (rdataset->isShareable() && --*rdataset->getRefCountBuf() > 0) {
+        return;
+    }
+    const size_t size = rdataset->getAllocatedSize(rrclass);
+    rdataset->~RdataSet();
+    mem_sgmt.deallocate(rdataset, size);
+}
+
+size_t
+RdataSet::getAllocatedSize(RRClass rrclass) const {
     const size_t data_len =
-        RdataReader(rrclass, rdataset->type,
-                    reinterpret_cast<const uint8_t*>(rdataset->getDataBuf()),
-                    rdataset->getRdataCount(), rdataset->getSigRdataCount(),
+        RdataReader(rrclass, type,
+                    reinterpret_cast<const uint8_t*>(getDataBuf()),
+                    getRdataCount(), getSigRdataCount(),
                     &RdataReader::emptyNameAction,
                     &RdataReader::emptyDataAction).getSize();
+    const size_t links_len =
+        sizeof(AdditionalLinkPtr) * getAdditionalLinkCount();
+    const size_t refcount_len = isShareable() ? sizeof(uint32_t) : 0;
     const size_t ext_rrsig_count_len =
-        rdataset->sig_rdata_count_ == MANY_RRSIG_COUNT ? sizeof(uint16_t) : 0;
-    rdataset->~RdataSet();
-    mem_sgmt.deallocate(rdataset,
-                        sizeof(RdataSet) + ext_rrsig_count_len + data_len);
+        sig_rdata_count_ == MANY_RRSIG_COUNT ? sizeof(uint16_t) : 0;
+    return (sizeof(RdataSet) + links_len + refcount_len +
+            ext_rrsig_count_len + data_len);
 }
 
 namespace {
@@ -336,8 +377,10 @@ RdataSet::RdataSet(RRType type_param, size_t rdata_count,
     BOOST_STATIC_ASSERT(sizeof(type) == sizeof(uint16_t));
 
     // Confirm we meet the alignment requirement for RdataEncoder
-    // ("this + 1" should be safely passed to the encoder).
+    // ("this + 1" should be safely passed to the encoder), and for the
+    // additional links placed there.
     BOOST_STATIC_ASSERT(sizeof(RdataSet) % sizeof(uint16_t) == 0);
+    BOOST_STATIC_ASSERT(sizeof(RdataSet) % sizeof(AdditionalLinkPtr) == 0);
 }
 
 } // namespace memory
@@ -25,12 +25,17 @@
 #include <boost/interprocess/offset_ptr.hpp>
 #include <boost/noncopyable.hpp>
 
+#include <cassert>
 #include <stdint.h>
 
 namespace bundy {
 namespace datasrc {
 namespace memory {
 class RdataEncoder;
+class RdataSet;
+template <typename T>
+class DomainTreeNode;
+typedef DomainTreeNode<RdataSet> ZoneNode;
 
 /// \brief General error on creating RdataSet.
 ///
@@ -104,6 +109,8 @@ public:
 /// \c RdataSet object.  The memory layout would be as follows:
 /// \verbatim
 /// RdataSet object
+/// (optional) offset pointers to ZoneNode: additional links (see below)
+/// (optional) uint32_t: reference count, if shareable (see below)
 /// (optional) uint16_t: number of RRSIGs, if it's larger than 6 (see above)
 /// encoded RDATA (generated by RdataEncoder) \endverbatim
 ///
@@ -111,6 +118,20 @@ public:
 /// assume any particular format of data in this region directly; it must
 /// get access to it via public interfaces provided in the main \c RdataSet
 /// class.
+///
+/// For RR types whose RDATA contain a name subject to additional section
+/// processing (NS, MX and SRV; see \c needsAdditionalLinks()), there's a
+/// slot for each RDATA, which can store a pointer to the \c ZoneNode for
+/// that name ("additional link").  The \c RdataSet class itself only keeps
+/// the slots; their content is maintained by \c ZoneDataUpdater.  They are
+/// initially NULL.
+///
+/// An \c RdataSet for NS without RRSIG, which is the common form of
+/// delegations, is "shareable" (see \c isShareable()): the same object
+/// can be in the lists of multiple nodes, e.g., for all delegations
+/// served by the same set of name servers.  It has a reference count,
+/// which \c destroy() takes into account.  Since \c next is shared, too,
+/// it must be the last one in each list (\c ZoneDataUpdater ensures that).
 class RdataSet : boost::noncopyable {
 public:
     /// \brief Allocate and construct \c RdataSet
@@ -207,6 +228,38 @@ public:
                             dns::ConstRRsetPtr sig_rrset,
                             const RdataSet* old_rdataset = NULL);
 
+    /// \brief Allocate and construct \c RdataSet from encoded RDATA
+    ///
+    /// This is similar to \c create(), but the RDATA
+    /// are given as the current encoding session of \c encoder, to which
+    /// the caller has added \c rdata_count (unique) RDATA of \c rrtype.
+    /// This is intended for RDATA that didn't come from an \c RRset, such as
+    /// those added to the encoder directly from the text of a master file.
+    /// The session must not contain RRSIGs, and must not have been started
+    /// in the merge mode; it's the caller's responsibility to ensure these
+    /// conditions.  The session is not changed, so the call can be retried
+    /// with the same encoder if \c util::MemorySegmentGrown is thrown.
+    ///
+    /// \throw util::MemorySegmentGrown The memory segment has grown, possibly
+    ///     relocating data.
+    /// \throw bundy::BadValue \c rdata_count is 0 or \c rrtype is RRSIG
+    /// \throw RdataSetError Number of RDATAs exceed the limits
+    /// \throw std::bad_alloc Memory allocation fails.
+    ///
+    /// \param mem_sgmt A \c MemorySegment from which memory for the new
+    /// \c RdataSet is allocated.
+    /// \param encoder The RDATA encoder holding the RDATA of the \c RdataSet.
+    /// \param rrtype The RR type of the RDATA.
+    /// \param rrttl The TTL of the \c RdataSet.
+    /// \param rdata_count The number of RDATA in the session of \c encoder.
+    ///
+    /// \return A pointer to the created \c RdataSet.
+    static RdataSet* createFromEncoder(util::MemorySegment& mem_sgmt,
+                                       const RdataEncoder& encoder,
+                                       const dns::RRType& rrtype,
+                                       const dns::RRTTL& rrttl,
+                                       size_t rdata_count);
+
     /// \brief Subtract some RDATAs and RRSIGs from an RdataSet
     ///
     /// Allocate and construct a new RdataSet that contains all the
@@ -256,6 +309,10 @@ public:
 
     /// \brief Destruct and deallocate \c RdataSet
     ///
+    /// If the \c RdataSet is shared (see \c addRef()), this only releases
+    /// one reference to it; it's actually destructed and deallocated when
+    /// the last reference is released.
+    ///
     /// Note that this method needs to know the expected RR class of the
     /// \c RdataSet.  This is because the destruction may depend on the
     /// internal data encoding that only \c RdataEncoder and \c RdataReader
@@ -277,6 +334,17 @@ public:
     static void destroy(util::MemorySegment& mem_sgmt, RdataSet* rdataset,
                         dns::RRClass rrclass);
 
+    /// \brief Return the number of bytes allocated for the \c RdataSet.
+    ///
+    /// This is the size of the object including the encoded data that
+    /// follows it.  Like \c destroy(), it needs the RR class of the
+    /// \c RdataSet to identify the internal data representation.
+    ///
+    /// \throw none
+    ///
+    /// \param rrclass The RR class of the \c RdataSet.
+    size_t getAllocatedSize(dns::RRClass rrclass) const;
+
     /// \brief Find \c RdataSet of given RR type from a list (const version).
     ///
     /// This function is a convenient shortcut for commonly used operation of
@@ -328,6 +396,9 @@ public:
     typedef boost::interprocess::offset_ptr<RdataSet> RdataSetPtr;
     typedef boost::interprocess::offset_ptr<const RdataSet> ConstRdataSetPtr;
 
+    /// \brief Type of the additional link slots.
+    typedef boost::interprocess::offset_ptr<const ZoneNode> AdditionalLinkPtr;
+
     // Note: the size and order of the members are carefully chosen to
     // maximize efficiency.  Don't change them unless there's strong reason
     // for that and the consequences are considered.
@@ -360,7 +431,8 @@ private:
 
     // Common code for packing the result in create and subtract.
     static RdataSet* packSet(util::MemorySegment& mem_sgmt,
-                             RdataEncoder& encoder, size_t rdata_count,
+                             const RdataEncoder& encoder,
+                             size_t rdata_count,
                              size_t rrsig_count, const dns::RRType& rrtype,
                              const dns::RRTTL& rrttl);
 
@@ -391,6 +463,78 @@ public:
         }
     }
 
+    /// \brief Return whether the \c RdataSet can be shared by multiple
+    /// nodes.
+    ///
+    /// This is the case for an \c RdataSet of NS that has no RRSIG.
+    ///
+    /// \throw none
+    bool isShareable() const {
+        return (type.getCode() == 2 && sig_rdata_count_ == 0); // NS
+    }
+
+    /// \brief Return the number of references to the \c RdataSet.
+    ///
+    /// It's 1 unless \c addRef() is called for a shareable \c RdataSet.
+    ///
+    /// \throw none
+    size_t getRefCount() const {
+        return (isShareable() ? *getRefCountBuf() : 1);
+    }
+
+    /// \brief Add a reference to a shareable \c RdataSet.
+    ///
+    /// The caller is expected to call this when it puts the \c RdataSet in
+    /// one more list.  Each reference has to be released by \c destroy().
+    /// It must not be called for an \c RdataSet that is not shareable.
+    ///
+    /// \throw none
+    void addRef() {
+        assert(isShareable());
+        ++*getRefCountBuf();
+    }
+
+    /// \brief Return whether \c RdataSet of the given type has additional
+    /// links.
+    ///
+    /// This is the case for NS, MX and SRV, regardless of the RR class
+    /// (for classes other than IN the links for SRV are simply unused).
+    ///
+    /// \throw none
+    static bool needsAdditionalLinks(const dns::RRType& type) {
+        const uint16_t code = type.getCode();
+        return (code == 2 || code == 15 || code == 33); // NS, MX, SRV
+    }
+
+    /// \brief Return the number of additional link slots.
+    ///
+    /// It's either 0 or the same as \c getRdataCount(); the i-th slot
+    /// corresponds to the name in the i-th RDATA.
+    ///
+    /// \throw none
+    size_t getAdditionalLinkCount() const {
+        return (needsAdditionalLinks(type) ? rdata_count_ : 0);
+    }
+
+    /// \brief Return the additional link for the i-th RDATA.
+    ///
+    /// The caller must ensure \c index < \c getAdditionalLinkCount().
+    ///
+    /// \throw none
+    const ZoneNode* getAdditionalLink(size_t index) const {
+        return (getAdditionalLinkBuf()[index].get());
+    }
+
+    /// \brief Set the additional link for the i-th RDATA.
+    ///
+    /// The caller must ensure \c index < \c getAdditionalLinkCount().
+    /// \c node can be NULL.
+    ///
+    /// \throw none
+    void setAdditionalLink(size_t index, const ZoneNode* node) {
+        getAdditionalLinkBuf()[index] = node;
+    }
+
     /// \brief Return a pointer to the TTL data of the \c RdataSet.
     ///
     /// The returned pointer points to a memory region that is valid at least
@@ -427,21 +571,46 @@ private:
     template <typename RetType, typename ThisType>
     static RetType* getDataBuf(ThisType* rdataset) {
         if (rdataset->sig_rdata_count_ < MANY_RRSIG_COUNT) {
-            return (rdataset + 1);
+            return (rdataset->getExtSIGCountBuf());
         } else {
             return (rdataset->getExtSIGCountBuf() + 1);
         }
     }
 
+    /// \brief Accessor to the memory region for the additional links.
+    ///
+    /// These are used only internally and defined as private.
+    const AdditionalLinkPtr* getAdditionalLinkBuf() const {
+        return (reinterpret_cast<const AdditionalLinkPtr*>(this + 1));
+    }
+    AdditionalLinkPtr* getAdditionalLinkBuf() {
+        return (reinterpret_cast<AdditionalLinkPtr*>(this + 1));
+    }
+
+    /// \brief Accessor to the memory region for the reference count of
+    /// a shareable \c RdataSet.
+    ///
+    /// These are used only internally and defined as private.
+    const uint32_t* getRefCountBuf() const {
+        return (reinterpret_cast<const uint32_t*>(
+                    getAdditionalLinkBuf() + getAdditionalLinkCount()));
+    }
+    uint32_t* getRefCountBuf() {
+        return (reinterpret_cast<uint32_t*>(
+                    getAdditionalLinkBuf() + getAdditionalLinkCount()));
+    }
+
     /// \brief Accessor to the memory region for the RRSIG count field for
     /// a large number of RRSIGs.
     ///
     /// These are used only internally and defined as private.
     const uint16_t* getExtSIGCountBuf() const {
-        return (reinterpret_cast<const uint16_t*>(this + 1));
+        return (reinterpret_cast<const uint16_t*>(
+                    getRefCountBuf() + (isShareable() ? 1 : 0)));
     }
     uint16_t* getExtSIGCountBuf() {
-        return (reinterpret_cast<uint16_t*>(this + 1));
+        return (reinterpret_cast<uint16_t*>(
+                    getRefCountBuf() + (isShareable() ? 1 : 0)));
     }
 
     // Shared by both mutable and immutable versions of find()
@@ -14,10 +14,7 @@
 
 #include "segment_object_holder.h"
 
-#include <boost/lexical_cast.hpp>
-
-#include <cassert>
-#include <stdint.h>
+#include <sstream>
 
 namespace bundy {
 namespace datasrc {
@@ -25,14 +22,10 @@ namespace memory {
 namespace detail {
 
 std::string
-getNextHolderName() {
-    static uint64_t index = 0;
-    ++index;
-    // in practice we should be able to assume this, uint64 is large
-    // and should not overflow
-    assert(index != 0);
-    return ("Segment object holder auto name " +
-            boost::lexical_cast<std::string>(index));
+getNextHolderName(const void* holder) {
+    std::ostringstream oss;
+    oss << "Segment object holder auto name " << holder;
+    return (oss.str());
 }
 
 }
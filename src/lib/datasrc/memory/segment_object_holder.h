@@ -26,13 +26,13 @@ namespace detail {
 
 // Internal function to get next yet unused name of segment holder.
 // We need the names of holders to be unique per segment at any given
-// momemnt. This just keeps incrementing number after a prefix with
-// each call, it should be enough (we assert it does not wrap around,
-// but 64bits should be enough).
-//
-// Also, it is not thread safe.
+// momemnt. The name is derived from the address of the holder object,
+// which is unique among the holders that currently exist in the process,
+// so this is safe even if multiple threads create holders for the same
+// segment concurrently (which happens when zones are loaded in parallel;
+// the segment itself must still be protected by the caller).
 std::string
-getNextHolderName();
+getNextHolderName(const void* holder);
 
 // A simple holder to create and use some objects in this implementation
 // in an exception safe manner.   It works like std::auto_ptr but much
@@ -58,7 +58,7 @@ class SegmentObjectHolder {
 public:
     SegmentObjectHolder(util::MemorySegment& mem_sgmt, ARG_T arg) :
         mem_sgmt_(mem_sgmt), arg_(arg),
-        holder_name_(getNextHolderName()), holding_(true)
+        holder_name_(getNextHolderName(this)), holding_(true)
     {
         if (mem_sgmt_.setNamedAddress(holder_name_.c_str(), NULL)) {
             // OK. We've grown. The caller might need to be informed, so
@@ -127,11 +127,42 @@ renderData(const void* data, size_t data_len,
     renderer->writeData(data, data_len);
 }
 
+// Handlers for FastRdataReader, equivalent to the above functions.
+class SizeupHandler {
+public:
+    SizeupHandler(size_t* length) : length_(length) {}
+    void handleName(const LabelSequence& name_labels, RdataNameAttributes) {
+        *length_ += name_labels.getDataLength();
+    }
+    void handleData(const void*, size_t data_len) {
+        *length_ += data_len;
+    }
+private:
+    size_t* const length_;
+};
+
+class RenderHandler {
+public:
+    RenderHandler(AbstractMessageRenderer& renderer) : renderer_(renderer) {}
+    void handleName(const LabelSequence& name_labels,
+                    RdataNameAttributes attr)
+    {
+        renderer_.writeName(name_labels,
+                            (attr & NAMEATTR_COMPRESSIBLE) != 0);
+    }
+    void handleData(const void* data, size_t data_len) {
+        renderer_.writeData(data, data_len);
+    }
+private:
+    AbstractMessageRenderer& renderer_;
+};
+
 // Helper for calculating wire data length of a single (etiher main or
 // RRSIG) RRset.
+template <typename Reader>
 uint16_t
 getLengthHelper(size_t* rlength, size_t rr_count, uint16_t name_labels_size,
-                RdataReader& reader, bool (RdataReader::* rdata_iterate_fn)())
+                Reader& reader, bool (Reader::* rdata_iterate_fn)())
 {
     uint16_t length = 0;
 
@@ -157,11 +188,12 @@ getLengthHelper(size_t* rlength, size_t rr_count, uint16_t name_labels_size,
 }
 
 // Common code logic for rendering a single (either main or RRSIG) RRset.
+template <typename Reader>
 size_t
 writeRRs(AbstractMessageRenderer& renderer, size_t rr_count,
          const LabelSequence& name_labels, const RRType& rrtype,
          const RRClass& rrclass, const void* ttl_data,
-         RdataReader& reader, bool (RdataReader::* rdata_iterate_fn)())
+         Reader& reader, bool (Reader::* rdata_iterate_fn)())
 {
     for (size_t i = 0; i < rr_count; ++i) {
         const size_t pos0 = renderer.getLength();
@@ -191,14 +223,9 @@ writeRRs(AbstractMessageRenderer& renderer, size_t rr_count,
 }
 }
 
+template <typename Reader>
 uint16_t
-TreeNodeRRset::getLength() const {
-    size_t rlength = 0;
-    RdataReader reader(rrclass_, rdataset_->type, rdataset_->getDataBuf(),
-                       rdataset_->getRdataCount(), rrsig_count_,
-                       boost::bind(sizeupName, _1, _2, &rlength),
-                       boost::bind(sizeupData, _1, _2, &rlength));
-
+TreeNodeRRset::getLengthInternal(size_t* rlength, Reader& reader) const {
     // Get the owner name of the RRset in the form of LabelSequence.
     uint8_t labels_buf[LabelSequence::MAX_SERIALIZED_LENGTH];
     const LabelSequence name_labels = getOwnerLabels(labels_buf);
@@ -206,17 +233,17 @@ TreeNodeRRset::getLength() const {
 
     // Find the length of the main (non RRSIG) RRs
     const uint16_t rrset_length =
-        getLengthHelper(&rlength, rdataset_->getRdataCount(), name_labels_size,
-                        reader, &RdataReader::iterateRdata);
+        getLengthHelper(rlength, rdataset_->getRdataCount(), name_labels_size,
+                        reader, &Reader::iterateRdata);
 
-    rlength = 0;
+    *rlength = 0;
     const bool rendered = reader.iterateRdata();
     assert(rendered == false); // we should've reached the end
 
     // Find the length of any RRSIGs, if we supposed to do so
     const uint16_t rrsig_length = dnssec_ok_ ?
-        getLengthHelper(&rlength, rrsig_count_, name_labels_size,
-                        reader, &RdataReader::iterateSingleSig) : 0;
+        getLengthHelper(rlength, rrsig_count_, name_labels_size,
+                        reader, &Reader::iterateSingleSig) : 0;
 
     // the uint16_ts are promoted to ints during addition below, so it
     // won't overflow a 16-bit register.
@@ -224,13 +251,31 @@ TreeNodeRRset::getLength() const {
     return (rrset_length + rrsig_length);
 }
 
-unsigned int
-TreeNodeRRset::toWire(AbstractMessageRenderer& renderer) const {
-    RdataReader reader(rrclass_, rdataset_->type, rdataset_->getDataBuf(),
-                       rdataset_->getRdataCount(), rrsig_count_,
-                       boost::bind(renderName, _1, _2, &renderer),
-                       boost::bind(renderData, _1, _2, &renderer));
+uint16_t
+TreeNodeRRset::getLength() const {
+    size_t rlength = 0;
+    SizeupHandler handler(&rlength);
+    FastRdataReader<SizeupHandler> reader(rrclass_, rdataset_->type,
+                                          rdataset_->getDataBuf(),
+                                          rdataset_->getRdataCount(),
+                                          rrsig_count_, handler);
+    if (reader.isSupported()) {
+        return (getLengthInternal(&rlength, reader));
+    }
+
+    RdataReader generic_reader(rrclass_, rdataset_->type,
+                               rdataset_->getDataBuf(),
+                               rdataset_->getRdataCount(), rrsig_count_,
+                               boost::bind(sizeupName, _1, _2, &rlength),
+                               boost::bind(sizeupData, _1, _2, &rlength));
+    return (getLengthInternal(&rlength, generic_reader));
+}
 
+template <typename Reader>
+unsigned int
+TreeNodeRRset::toWireInternal(AbstractMessageRenderer& renderer,
+                              Reader& reader) const
+{
     // Get the owner name of the RRset in the form of LabelSequence.
     uint8_t labels_buf[LabelSequence::MAX_SERIALIZED_LENGTH];
     const LabelSequence name_labels = getOwnerLabels(labels_buf);
@@ -239,7 +284,7 @@ TreeNodeRRset::toWire(AbstractMessageRenderer& renderer) const {
     const size_t rendered_rdata_count =
         writeRRs(renderer, rdataset_->getRdataCount(), name_labels,
                  rdataset_->type, rrclass_, ttl_data_, reader,
-                 &RdataReader::iterateRdata);
+                 &Reader::iterateRdata);
     if (renderer.isTruncated()) {
         return (rendered_rdata_count);
     }
@@ -250,11 +295,32 @@ TreeNodeRRset::toWire(AbstractMessageRenderer& renderer) const {
     const size_t rendered_rrsig_count = dnssec_ok_ ?
         writeRRs(renderer, rrsig_count_, name_labels, RRType::RRSIG(),
                  rrclass_, ttl_data_, reader,
-                 &RdataReader::iterateSingleSig) : 0;
+                 &Reader::iterateSingleSig) : 0;
 
     return (rendered_rdata_count + rendered_rrsig_count);
 }
 
+unsigned int
+TreeNodeRRset::toWire(AbstractMessageRenderer& renderer) const {
+    // Use the specialized reader for common types, avoiding the overhead
+    // of calling boost::function objects for each field.
+    RenderHandler handler(renderer);
+    FastRdataReader<RenderHandler> reader(rrclass_, rdataset_->type,
+                                          rdataset_->getDataBuf(),
+                                          rdataset_->getRdataCount(),
+                                          rrsig_count_, handler);
+    if (reader.isSupported()) {
+        return (toWireInternal(renderer, reader));
+    }
+
+    RdataReader generic_reader(rrclass_, rdataset_->type,
+                               rdataset_->getDataBuf(),
+                               rdataset_->getRdataCount(), rrsig_count_,
+                               boost::bind(renderName, _1, _2, &renderer),
+                               boost::bind(renderData, _1, _2, &renderer));
+    return (toWireInternal(renderer, generic_reader));
+}
+
 unsigned int
 TreeNodeRRset::toWire(bundy::util::OutputBuffer&) const {
     bundy_throw(Unexpected, "unexpected method called on TreeNodeRRset");
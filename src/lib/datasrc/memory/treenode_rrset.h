@@ -261,6 +261,15 @@ private:
     dns::RdataIteratorPtr getRdataIteratorInternal(bool is_rrsig,
                                                    size_t count) const;
 
+    // Common backend of getLength() and toWire(), for RdataReader and
+    // FastRdataReader.  The latter is used for the supported (common)
+    // RR types.  These are only used (and instantiated) in the .cc file.
+    template <typename Reader>
+    uint16_t getLengthInternal(size_t* rlength, Reader& reader) const;
+    template <typename Reader>
+    unsigned int toWireInternal(dns::AbstractMessageRenderer& renderer,
+                                Reader& reader) const;
+
     // Return \c LabelSequence for the owner name regardless of how this
     /// class is constructed (with or without 'realname')
     dns::LabelSequence getOwnerLabels(
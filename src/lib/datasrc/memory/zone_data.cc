@@ -61,6 +61,20 @@ void
 nullDeleter(RdataSet* rdataset_head) {
     assert(rdataset_head == NULL);
 }
+
+// A helper used as the data sizer of ZoneTree::getMemoryUsage().
+size_t
+rdataSetSizer(RRClass rrclass, const RdataSet* rdataset_head) {
+    size_t size = 0;
+    for (const RdataSet* rdataset = rdataset_head;
+         rdataset != NULL;
+         rdataset = rdataset->getNext()) {
+        // A shared RdataSet is in the lists of all nodes sharing it; each
+        // of them counts its share so the total is the real size.
+        size += rdataset->getAllocatedSize(rrclass) / rdataset->getRefCount();
+    }
+    return (size);
+}
 }
 
 NSEC3Data*
@@ -129,15 +143,22 @@ NSEC3Data::destroy(util::MemorySegment& mem_sgmt, NSEC3Data* data,
 
 void
 NSEC3Data::insertName(util::MemorySegment& mem_sgmt, const Name& name,
-                      ZoneNode** node)
+                      ZoneNode** node, ZoneTreeBuilder* builder)
 {
-    const ZoneTree::Result result = nsec3_tree_->insert(mem_sgmt, name, node);
+    const ZoneTree::Result result = (builder != NULL) ?
+        builder->insert(mem_sgmt, *nsec3_tree_, name, node) :
+        nsec3_tree_->insert(mem_sgmt, name, node);
 
     // This should be ensured by the API:
     assert((result == ZoneTree::SUCCESS ||
             result == ZoneTree::ALREADYEXISTS) && node != NULL);
 }
 
+void
+NSEC3Data::finishBuild(ZoneTreeBuilder& builder) {
+    builder.finish(*nsec3_tree_);
+}
+
 namespace {
 // A helper to convert a TTL value in network byte order and set it in
 // ZoneData::min_ttl_.  We can use util::OutputBuffer, but copy the logic
@@ -203,17 +224,50 @@ ZoneData::destroy(util::MemorySegment& mem_sgmt, ZoneData* zone_data,
     mem_sgmt.deallocate(zone_data, sizeof(ZoneData));
 }
 
+ZoneMemoryUsage
+ZoneData::getMemoryUsage(RRClass zone_class) const {
+    ZoneMemoryUsage usage;
+
+    const ZoneTree::MemoryUsage tree_usage =
+        zone_tree_->getMemoryUsage(boost::bind(rdataSetSizer, zone_class,
+                                               _1));
+    // The tree object itself is counted in node_bytes; separate it as
+    // overhead.
+    usage.tree_nodes = tree_usage.node_bytes - sizeof(ZoneTree);
+    usage.names = tree_usage.label_bytes;
+    usage.rdatasets = tree_usage.data_bytes;
+    usage.overhead = sizeof(ZoneData) + sizeof(ZoneTree);
+
+    if (nsec3_data_) {
+        const ZoneTree::MemoryUsage nsec3_usage =
+            nsec3_data_->getNSEC3Tree().getMemoryUsage(
+                boost::bind(rdataSetSizer, zone_class, _1));
+        usage.nsec3 = sizeof(NSEC3Data) + 1 + nsec3_data_->getSaltLen() +
+            nsec3_usage.node_bytes + nsec3_usage.label_bytes +
+            nsec3_usage.data_bytes;
+    }
+
+    return (usage);
+}
+
 void
 ZoneData::insertName(util::MemorySegment& mem_sgmt, const Name& name,
-                     ZoneNode** node)
+                     ZoneNode** node, ZoneTreeBuilder* builder)
 {
-    const ZoneTree::Result result = zone_tree_->insert(mem_sgmt, name, node);
+    const ZoneTree::Result result = (builder != NULL) ?
+        builder->insert(mem_sgmt, *zone_tree_, name, node) :
+        zone_tree_->insert(mem_sgmt, name, node);
 
     // This should be ensured by the API:
     assert((result == ZoneTree::SUCCESS ||
             result == ZoneTree::ALREADYEXISTS) && node != NULL);
 }
 
+void
+ZoneData::finishBuild(ZoneTreeBuilder& builder) {
+    builder.finish(*zone_tree_);
+}
+
 void
 ZoneData::setMinTTL(uint32_t min_ttl_val) {
     setTTLInNetOrder(min_ttl_val, &min_ttl_);
@@ -44,6 +44,30 @@ namespace memory {
 typedef DomainTree<RdataSet> ZoneTree;
 typedef DomainTreeNode<RdataSet> ZoneNode;
 typedef DomainTreeNodeChain<RdataSet> ZoneChain;
+typedef DomainTreeBuilder<RdataSet> ZoneTreeBuilder;
+
+/// \brief Memory used by the data of a zone.
+///
+/// This is a breakdown of the bytes allocated from the memory segment
+/// for a \c ZoneData, as returned by \c ZoneData::getMemoryUsage().
+/// Allocator specific overhead (e.g., rounding in the memory segment)
+/// is not included.
+struct ZoneMemoryUsage {
+    ZoneMemoryUsage() :
+        tree_nodes(0), names(0), rdatasets(0), nsec3(0), overhead(0)
+    {}
+
+    /// \brief Return the sum of all the parts.
+    size_t getTotal() const {
+        return (tree_nodes + names + rdatasets + nsec3 + overhead);
+    }
+
+    size_t tree_nodes;  ///< Nodes of the zone's name space
+    size_t names;       ///< Labels of the names stored in the nodes
+    size_t rdatasets;   ///< RdataSets (with the encoded RDATA)
+    size_t nsec3;       ///< All of the NSEC3 data (tree, names, RdataSets)
+    size_t overhead;    ///< Other objects like ZoneData and the tree itself
+};
 
 /// \brief NSEC3 data for a DNS zone.
 ///
@@ -210,8 +234,16 @@ public:
     /// \param node A pointer to \c ZoneNode pointer in which the created or
     /// found node for the name is stored.  Must not be NULL (the method does
     /// not check that condition).
+    /// \param builder If non NULL, the name is inserted through it (see
+    /// \c DomainTreeBuilder); \c finishBuild() must then be called after
+    /// the last name is inserted.
     void insertName(util::MemorySegment& mem_sgmt, const dns::Name& name,
-                    ZoneNode** node);
+                    ZoneNode** node, ZoneTreeBuilder* builder = NULL);
+
+    /// \brief Complete the names inserted through a \c ZoneTreeBuilder.
+    ///
+    /// \throw std::bad_alloc Local memory allocation fails
+    void finishBuild(ZoneTreeBuilder& builder);
 
 private:
     // Common subroutine for the public versions of create().
@@ -400,6 +432,10 @@ private:
     // used for some kind of sentinel data.
     static const ZoneNode::Flags EMPTY_ZONE = ZoneNode::FLAG_USER3;
 
+    // Also set in the origin node, indicating the additional links of all
+    // RdataSets in the zone have been resolved and are up to date.
+    static const ZoneNode::Flags ADDITIONAL_LINKED = ZoneNode::FLAG_USER4;
+
 public:
     /// \brief Allocate and construct \c ZoneData.
     ///
@@ -516,6 +552,31 @@ public:
     /// \throw None
     bool isEmpty() const { return (origin_node_->getFlag(EMPTY_ZONE)); }
 
+    /// \brief Return whether the additional links of the zone can be used.
+    ///
+    /// If this returns \c true, every additional link of the \c RdataSet
+    /// objects in the zone (see \c RdataSet::getAdditionalLink()) is either
+    /// NULL or points to the node that a search for the corresponding name
+    /// would find for additional section processing.  A NULL link means
+    /// the name has to be looked up in the usual way.
+    ///
+    /// \throw none
+    bool isAdditionalLinked() const {
+        return (origin_node_->getFlag(ADDITIONAL_LINKED));
+    }
+
+    /// \brief Return the memory used by the zone data.
+    ///
+    /// This walks all the nodes of the zone (including its NSEC3 name
+    /// space), so the cost is proportional to the size of the zone; it's
+    /// intended for occasional introspection, not for the query path.
+    ///
+    /// \throw none
+    ///
+    /// \param zone_class The RR class of the \c RdataSet stored in the
+    /// zone (see \c destroy()).
+    ZoneMemoryUsage getMemoryUsage(dns::RRClass zone_class) const;
+
     /// \brief Return NSEC3Data of the zone.
     ///
     /// This method returns non-NULL valid pointer to \c NSEC3Data object
@@ -586,8 +647,23 @@ public:
     /// \param node A pointer to \c ZoneNode pointer in which the created or
     /// found node for the name is stored.  Must not be NULL (the method does
     /// not check that condition).
+    /// \param builder If non NULL, the name is inserted through it.  This
+    /// is faster when names are inserted in the DNSSEC order, e.g., when
+    /// loading a whole zone from a sorted source, but \c finishBuild()
+    /// must then be called after the last name is inserted; until then
+    /// lookups in the zone can be slow.  See \c DomainTreeBuilder.
     void insertName(util::MemorySegment& mem_sgmt, const dns::Name& name,
-                    ZoneNode** node);
+                    ZoneNode** node, ZoneTreeBuilder* builder = NULL);
+
+    /// \brief Complete the names inserted through a \c ZoneTreeBuilder.
+    ///
+    /// This rebalances the zone tree after names are inserted by
+    /// \c insertName() with the \c builder.  It doesn't allocate memory
+    /// from the memory segment, and it doesn't invalidate any \c ZoneNode
+    /// pointers.
+    ///
+    /// \throw std::bad_alloc Local memory allocation fails
+    void finishBuild(ZoneTreeBuilder& builder);
 
     /// \brief Specify whether or not the zone is signed in terms of DNSSEC.
     ///
@@ -605,6 +681,17 @@ public:
         origin_node_->setFlag(DNSSEC_SIGNED, on);
     }
 
+    /// \brief Specify whether the additional links of the zone can be used.
+    ///
+    /// This is expected to be called by \c ZoneDataUpdater, which is
+    /// responsible for keeping the links consistent; see
+    /// \c isAdditionalLinked().
+    ///
+    /// \throw none
+    void setAdditionalLinked(bool on) {
+        origin_node_->setFlag(ADDITIONAL_LINKED, on);
+    }
+
     /// \brief Return NSEC3Data of the zone, non-const version.
     ///
     /// This is similar to the const version, but return a non-const pointer
@@ -15,11 +15,13 @@
 #include <datasrc/master_loader_callbacks.h>
 #include <datasrc/memory/zone_data_loader.h>
 #include <datasrc/memory/zone_data_updater.h>
+#include <datasrc/memory/rdata_serialization.h>
 #include <datasrc/memory/logger.h>
 #include <datasrc/memory/segment_object_holder.h>
 #include <datasrc/memory/util_internal.h>
 #include <datasrc/memory/rrset_collection.h>
 
+#include <dns/master_lexer.h>
 #include <dns/master_loader.h>
 #include <dns/rrcollator.h>
 #include <dns/rdataclass.h>
@@ -29,6 +31,7 @@
 #include <boost/foreach.hpp>
 #include <boost/bind.hpp>
 #include <boost/noncopyable.hpp>
+#include <boost/optional.hpp>
 
 #include <map>
 
@@ -60,6 +63,11 @@ typedef boost::function<void(bundy::dns::ConstRRsetPtr)> LoadCallback;
 // when we see a new owner name. We do this to limit the size of
 // NodeRRsets below. However, RRsets can occur in any order.
 //
+// RDATA of some common types can also be given in the text form of a
+// master file (see addTextFromLoad()).  They are encoded directly, without
+// making Rdata and RRset objects, and consecutive RRs of the same owner
+// name and type are added to the zone at once.
+//
 // The caller is responsible for adding the RRsets of the last group
 // in the input sequence by explicitly calling flushNodeRRsets() at the
 // end.  It's cleaner and more robust if we let the destructor of this class
@@ -71,12 +79,23 @@ public:
     ZoneDataLoader(util::MemorySegment& mem_sgmt,
                    const bundy::dns::RRClass& rrclass,
                    const bundy::dns::Name& zone_name, ZoneData& zone_data) :
-        updater_(mem_sgmt, rrclass, zone_name, zone_data)
+        updater_(mem_sgmt, rrclass, zone_name, zone_data, true),
+        text_ttl_(0), text_rdata_count_(0)
     {}
 
     void addFromLoad(const bundy::dns::ConstRRsetPtr& rrset);
+    void addTextFromLoad(const bundy::dns::Name& name,
+                         const bundy::dns::RRClass& rrclass,
+                         const bundy::dns::RRType& rrtype,
+                         const bundy::dns::RRTTL& ttl,
+                         bundy::dns::MasterLexer& lexer,
+                         const bundy::dns::Name* origin);
     void flushNodeRRsets();
 
+    // Complete the zone trees; to be called after flushNodeRRsets() for
+    // the last group.
+    void finish() { updater_.finish(); }
+
 private:
     typedef std::map<bundy::dns::RRType, bundy::dns::ConstRRsetPtr> NodeRRsets;
     typedef NodeRRsets::value_type NodeRRsetsVal;
@@ -84,15 +103,30 @@ private:
     // A helper to identify the covered type of an RRSIG.
     const bundy::dns::Name& getCurrentName() const;
 
+    // Add the RDATA given by addTextFromLoad() so far to the zone.
+    void flushTextRRs();
+
 private:
     NodeRRsets node_rrsets_;
     NodeRRsets node_rrsigsets_;
     std::vector<bundy::dns::ConstRRsetPtr> non_consecutive_rrsets_;
     ZoneDataUpdater updater_;
+
+    // The RDATA given by addTextFromLoad() that are not added yet, in the
+    // encoding session of text_encoder_.  text_name_ is unset if there's
+    // none.
+    RdataEncoder text_encoder_;
+    boost::optional<bundy::dns::Name> text_name_;
+    boost::optional<bundy::dns::RRType> text_type_;
+    bundy::dns::RRTTL text_ttl_;
+    size_t text_rdata_count_;
 };
 
 void
 ZoneDataLoader::addFromLoad(const ConstRRsetPtr& rrset) {
+    // Keep the order of the input.
+    flushTextRRs();
+
     // If we see a new name, flush the temporary holders, adding the
     // pairs of RRsets and RRSIGs of the previous name to the zone.
     if ((!node_rrsets_.empty() || !node_rrsigsets_.empty() ||
@@ -116,8 +150,55 @@ ZoneDataLoader::addFromLoad(const ConstRRsetPtr& rrset) {
     }
 }
 
+void
+ZoneDataLoader::addTextFromLoad(const Name& name, const RRClass& rrclass,
+                                const RRType& rrtype, const RRTTL& ttl,
+                                MasterLexer& lexer, const Name* origin)
+{
+    if (text_name_ && (*text_type_ != rrtype || *text_name_ != name)) {
+        flushTextRRs();
+    }
+    if (!text_name_) {
+        // As in addFromLoad(), add the RRsets of the previous name first.
+        if ((!node_rrsets_.empty() || !node_rrsigsets_.empty() ||
+             !non_consecutive_rrsets_.empty()) &&
+            (getCurrentName() != name)) {
+            flushNodeRRsets();
+        }
+        text_encoder_.start(rrclass, rrtype);
+        text_name_ = name;
+        text_type_ = rrtype;
+        text_rdata_count_ = 0;
+    }
+
+    // This throws if the RDATA is broken, but the RDATA added so far
+    // are intact.
+    const bool is_first = (text_rdata_count_ == 0);
+    if (text_encoder_.addRdata(lexer, origin)) {
+        ++text_rdata_count_;
+    }
+    // Like dns::RRCollator, use the smallest TTL of the RRs.
+    if (is_first || ttl < text_ttl_) {
+        text_ttl_ = ttl;
+    }
+}
+
+void
+ZoneDataLoader::flushTextRRs() {
+    if (!text_name_) {
+        return;
+    }
+    if (text_rdata_count_ > 0) {
+        updater_.add(*text_name_, *text_type_, text_ttl_, text_encoder_,
+                     text_rdata_count_);
+    }
+    text_name_.reset();
+}
+
 void
 ZoneDataLoader::flushNodeRRsets() {
+    flushTextRRs();
+
     BOOST_FOREACH(NodeRRsetsVal val, node_rrsets_) {
         // Identify the corresponding RRSIG for the RRset, if any.  If
         // found add both the RRset and its RRSIG at once.
@@ -180,7 +261,7 @@ ZoneData*
 loadZoneDataInternal(util::MemorySegment& mem_sgmt,
                      const bundy::dns::RRClass& rrclass,
                      const Name& zone_name,
-                     boost::function<void(LoadCallback)> rrset_installer)
+                     boost::function<void(ZoneDataLoader&)> rrset_installer)
 {
     while (true) { // Try as long as it takes to load and grow the segment
         bool created = false;
@@ -193,10 +274,10 @@ loadZoneDataInternal(util::MemorySegment& mem_sgmt,
             created = true;
 
             ZoneDataLoader loader(mem_sgmt, rrclass, zone_name, *holder.get());
-            rrset_installer(boost::bind(&ZoneDataLoader::addFromLoad, &loader,
-                                        _1));
+            rrset_installer(loader);
             // Add any last RRsets that were left
             loader.flushNodeRRsets();
+            loader.finish();
 
             const ZoneNode* origin_node = holder.get()->getOriginNode();
             const RdataSet* rdataset = origin_node->getData();
@@ -225,23 +306,43 @@ loadZoneDataInternal(util::MemorySegment& mem_sgmt,
     }
 }
 
+// The callback for MasterLoader to add RRs from text.  The collator may
+// hold RRs given before this one, which are added first to keep the order
+// of the input.
+void
+addTextRR(dns::RRCollator* collator, ZoneDataLoader* loader,
+          const Name& name, const RRClass& rrclass, const RRType& rrtype,
+          const RRTTL& ttl, MasterLexer& lexer, const Name* origin)
+{
+    collator->flush();
+    loader->addTextFromLoad(name, rrclass, rrtype, ttl, lexer, origin);
+}
+
 // A wrapper for dns::MasterLoader used by loadZoneData() below.  Essentially
 // it converts the two callback types.  Note the mostly redundant wrapper of
 // boost::bind.  It converts function<void(ConstRRsetPtr)> to
 // function<void(RRsetPtr)> (MasterLoader expects the latter).  SunStudio
 // doesn't seem to do this conversion if we just pass 'callback'.
+// RRs of the types RdataEncoder can encode from text bypass the collator.
 void
 masterLoaderWrapper(const char* const filename, const Name& origin,
-                    const RRClass& zone_class, LoadCallback callback)
+                    const RRClass& zone_class, ZoneDataLoader& loader)
 {
     bool load_ok = false;       // (we don't use it)
+    const LoadCallback callback =
+        boost::bind(&ZoneDataLoader::addFromLoad, &loader, _1);
     dns::RRCollator collator(boost::bind(callback, _1));
 
     try {
-        dns::MasterLoader(filename, origin, zone_class,
-                          createMasterLoaderCallbacks(origin, zone_class,
-                                                      &load_ok),
-                          collator.getCallback()).load();
+        dns::MasterLoader master_loader(filename, origin, zone_class,
+                                        createMasterLoaderCallbacks(
+                                            origin, zone_class, &load_ok),
+                                        collator.getCallback());
+        master_loader.setAddRRTextCallback(
+            boost::bind(addTextRR, &collator, &loader, _1, _2, _3, _4, _5,
+                        _6),
+            boost::bind(&RdataEncoder::isTextSupported, zone_class, _1));
+        master_loader.load();
         collator.flush();
     } catch (const dns::MasterLoaderError& e) {
         bundy_throw(ZoneLoaderException, e.what());
@@ -250,10 +351,10 @@ masterLoaderWrapper(const char* const filename, const Name& origin,
 
 // The installer called from the iterator version of loadZoneData().
 void
-generateRRsetFromIterator(ZoneIterator* iterator, LoadCallback callback) {
+generateRRsetFromIterator(ZoneIterator* iterator, ZoneDataLoader& loader) {
     ConstRRsetPtr rrset;
     while ((rrset = iterator->getNextRRset()) != NULL) {
-        callback(rrset);
+        loader.addFromLoad(rrset);
     }
 }
 
@@ -21,8 +21,14 @@
 
 #include <dns/rdataclass.h>
 
+#include <util/buffer.h>
+
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+
 #include <cassert>
 #include <string>
+#include <vector>
 
 using namespace bundy::dns;
 using namespace bundy::dns::rdata;
@@ -33,6 +39,145 @@ namespace memory {
 
 using detail::getCoveredType;
 
+namespace {
+// A callback for ZoneTree::find() in resolving additional links.  It
+// stops the search at the same nodes as the zone finder does in additional
+// section processing: at a DNAME, and at a zone cut unless glue is allowed
+// (i.e., the links are for NS).
+bool
+additionalCutCallback(const ZoneNode& node, bool glue_ok) {
+    if (RdataSet::find(node.getData(), RRType::DNAME()) != NULL) {
+        return (true);
+    }
+    if (RdataSet::find(node.getData(), RRType::NS()) != NULL) {
+        return (!glue_ok);
+    }
+    return (false);
+}
+
+// RdataReader name action to set additional links of an RdataSet
+// one by one.
+class AdditionalLinkResolver {
+public:
+    AdditionalLinkResolver(const ZoneTree& tree, RdataSet& rdataset) :
+        tree_(tree), rdataset_(rdataset),
+        glue_ok_(rdataset.type == RRType::NS()), index_(0)
+    {}
+    void operator()(const LabelSequence& name_labels,
+                    RdataNameAttributes attr)
+    {
+        if ((attr & NAMEATTR_ADDITIONAL) == 0) {
+            return;
+        }
+        assert(index_ < rdataset_.getAdditionalLinkCount());
+        const ZoneNode* node = NULL;
+        ZoneChain node_path;
+        const ZoneTree::Result result =
+            tree_.find(name_labels, &node, node_path, additionalCutCallback,
+                       glue_ok_);
+        rdataset_.setAdditionalLink(index_++, result == ZoneTree::EXACTMATCH ?
+                                    node : NULL);
+    }
+private:
+    const ZoneTree& tree_;
+    RdataSet& rdataset_;
+    const bool glue_ok_;
+    size_t index_;
+};
+}
+
+namespace {
+// RdataReader actions to render each RDATA in the wire format.
+void
+renderNameField(util::OutputBuffer* buffer, const LabelSequence& labels,
+                RdataNameAttributes)
+{
+    size_t data_len;
+    const uint8_t* data = labels.getData(&data_len);
+    buffer->writeData(data, data_len);
+}
+
+void
+renderDataField(util::OutputBuffer* buffer, const void* data, size_t data_len) {
+    buffer->writeData(data, data_len);
+}
+
+// Make an RRset from the RDATA in the encoding session of the given encoder
+// (which doesn't contain RRSIGs).
+ConstRRsetPtr
+decodeRRset(const RdataEncoder& encoder, const Name& name,
+            const RRClass& rrclass, const RRType& rrtype, const RRTTL& ttl,
+            size_t rdata_count)
+{
+    std::vector<uint8_t> data(encoder.getStorageLength());
+    encoder.encode(&data[0], data.size());
+
+    util::OutputBuffer buffer(0);
+    RdataReader reader(rrclass, rrtype, &data[0], rdata_count, 0,
+                       boost::bind(renderNameField, &buffer, _1, _2),
+                       boost::bind(renderDataField, &buffer, _1, _2));
+    RRsetPtr rrset(new RRset(name, rrclass, rrtype, ttl));
+    while (reader.iterateRdata()) {
+        util::InputBuffer ibuffer(buffer.getData(), buffer.getLength());
+        rrset->addRdata(createRdata(rrtype, rrclass, ibuffer,
+                                    buffer.getLength()));
+        buffer.clear();
+    }
+    return (rrset);
+}
+
+std::string
+getShareKey(const RRClass& rrclass, const RdataSet& rdataset) {
+    const size_t data_len =
+        RdataReader(rrclass, rdataset.type, rdataset.getDataBuf(),
+                    rdataset.getRdataCount(), rdataset.getSigRdataCount(),
+                    &RdataReader::emptyNameAction,
+                    &RdataReader::emptyDataAction).getSize();
+    std::string key(static_cast<const char*>(rdataset.getTTLData()),
+                    sizeof(uint32_t));
+    key.append(static_cast<const char*>(rdataset.getDataBuf()), data_len);
+    return (key);
+}
+}
+
+RdataSet*
+ZoneDataUpdater::shareRdataSet(RdataSet* rdataset) {
+    assert(rdataset->isShareable());
+    const std::pair<std::map<std::string, RdataSet*>::iterator, bool> result =
+        shared_rdatasets_.insert(
+            std::make_pair(getShareKey(rrclass_, *rdataset), rdataset));
+    if (result.second) {
+        return (rdataset);
+    }
+    RdataSet::destroy(mem_sgmt_, rdataset, rrclass_);
+    RdataSet* shared = result.first->second;
+    shared->addRef();
+    return (shared);
+}
+
+void
+ZoneDataUpdater::unshareRdataSet(const RdataSet* rdataset) {
+    if (rdataset->isShareable() && rdataset->getRefCount() == 1) {
+        const std::map<std::string, RdataSet*>::iterator it =
+            shared_rdatasets_.find(getShareKey(rrclass_, *rdataset));
+        if (it != shared_rdatasets_.end() && it->second == rdataset) {
+            shared_rdatasets_.erase(it);
+        }
+    }
+}
+
+void
+ZoneDataUpdater::resolveAdditionalLinks(RdataSet& rdataset) const {
+    if (rdataset.getAdditionalLinkCount() == 0) {
+        return;
+    }
+    AdditionalLinkResolver resolver(zone_data_->getZoneTree(), rdataset);
+    const RdataSet& const_rdataset = rdataset;
+    RdataReader(rrclass_, rdataset.type, const_rdataset.getDataBuf(),
+                rdataset.getRdataCount(), 0, boost::ref(resolver),
+                &RdataReader::emptyDataAction).iterate();
+}
+
 void
 ZoneDataUpdater::addWildcards(const Name& name) {
     Name wname(name);
@@ -49,59 +194,61 @@ ZoneDataUpdater::addWildcards(const Name& name) {
             // Ensure a separate level exists for the "wildcarding"
             // name, and mark the node as "wild".
             ZoneNode* node;
-            zone_data_->insertName(mem_sgmt_, wname.split(1), &node);
+            zone_data_->insertName(mem_sgmt_, wname.split(1), &node,
+                                   getZoneTreeBuilder());
             node->setFlag(ZoneData::WILDCARD_NODE);
 
             // Ensure a separate level exists for the wildcard name.
             // Note: for 'name' itself we do this later anyway, but the
             // overhead should be marginal because wildcard names should
             // be rare.
-            zone_data_->insertName(mem_sgmt_, wname, &node);
+            zone_data_->insertName(mem_sgmt_, wname, &node,
+                                   getZoneTreeBuilder());
         }
     }
 }
 
 void
-ZoneDataUpdater::contextCheck(const AbstractRRset& rrset,
+ZoneDataUpdater::contextCheck(const Name& name, const RRType& rrtype,
                               const RdataSet* rdataset) const
 {
     // Ensure CNAME and other type of RR don't coexist for the same
     // owner name except with NSEC, which is the only RR that can
     // coexist with CNAME (and also RRSIG, which is handled separately)
-    if (rrset.getType() == RRType::CNAME()) {
+    if (rrtype == RRType::CNAME()) {
         for (const RdataSet* sp = rdataset; sp != NULL; sp = sp->getNext()) {
             if (sp->type != RRType::NSEC()) {
                 LOG_ERROR(logger, DATASRC_MEMORY_MEM_CNAME_TO_NONEMPTY).
-                    arg(rrset.getName());
+                    arg(name);
                 bundy_throw(AddError,
                           "CNAME can't be added with " << sp->type
-                          << " RRType for " << rrset.getName());
+                          << " RRType for " << name);
             }
         }
-    } else if ((rrset.getType() != RRType::NSEC()) &&
+    } else if ((rrtype != RRType::NSEC()) &&
                (RdataSet::find(rdataset, RRType::CNAME()) != NULL))
     {
         LOG_ERROR(logger,
-                  DATASRC_MEMORY_MEM_CNAME_COEXIST).arg(rrset.getName());
+                  DATASRC_MEMORY_MEM_CNAME_COEXIST).arg(name);
         bundy_throw(AddError,
-                  "CNAME and " << rrset.getType() <<
-                  " can't coexist for " << rrset.getName());
+                  "CNAME and " << rrtype <<
+                  " can't coexist for " << name);
     }
 
     // Similar with DNAME, but it must not coexist only with NS and only
     // in non-apex domains.  RFC 2672 section 3 mentions that it is
     // implied from it and RFC 2181.
-    if (rrset.getName() != zone_name_ &&
+    if (name != zone_name_ &&
         // Adding DNAME, NS already there
-        ((rrset.getType() == RRType::DNAME() &&
+        ((rrtype == RRType::DNAME() &&
           RdataSet::find(rdataset, RRType::NS()) != NULL) ||
          // Adding NS, DNAME already there
-         (rrset.getType() == RRType::NS() &&
+         (rrtype == RRType::NS() &&
           RdataSet::find(rdataset, RRType::DNAME()) != NULL)))
     {
-        LOG_ERROR(logger, DATASRC_MEMORY_MEM_DNAME_NS).arg(rrset.getName());
+        LOG_ERROR(logger, DATASRC_MEMORY_MEM_DNAME_NS).arg(name);
         bundy_throw(AddError, "DNAME can't coexist with NS in non-apex domain: "
-                  << rrset.getName());
+                  << name);
     }
 }
 
@@ -109,63 +256,64 @@ void
 ZoneDataUpdater::validate(const bundy::dns::ConstRRsetPtr rrset) const {
     assert(rrset);
 
-    if (rrset->getRdataCount() == 0) {
+    validate(rrset->getName(), rrset->getType(), rrset->getRdataCount());
+
+    // For RRSIGs, check consistency of the type covered.  We know the
+    // RRset isn't empty, so the following check is safe.
+    if (rrset->getType() == RRType::RRSIG()) {
+        RdataIteratorPtr rit = rrset->getRdataIterator();
+        const RRType covered = dynamic_cast<const generic::RRSIG&>(
+            rit->getCurrent()).typeCovered();
+        for (rit->next(); !rit->isLast(); rit->next()) {
+            if (dynamic_cast<const generic::RRSIG&>(
+                     rit->getCurrent()).typeCovered() != covered)
+            {
+                bundy_throw(AddError, "RRSIG contains mixed covered types: "
+                          << rrset->toText());
+            }
+        }
+    }
+}
+
+void
+ZoneDataUpdater::validate(const Name& name, const RRType& rrtype,
+                          size_t rdata_count) const
+{
+    if (rdata_count == 0) {
         bundy_throw(AddError,
-                  "The rrset provided is empty: "
-                  << rrset->getName() << "/" << rrset->getType());
+                  "The rrset provided is empty: " << name << "/" << rrtype);
     }
 
     // Check for singleton RRs. It should probably handled at a different
     // layer in future.
-    if ((rrset->getType() == RRType::CNAME() ||
-         rrset->getType() == RRType::DNAME()) &&
-        rrset->getRdataCount() > 1)
+    if ((rrtype == RRType::CNAME() || rrtype == RRType::DNAME()) &&
+        rdata_count > 1)
     {
         // XXX: this is not only for CNAME or DNAME. We should
         // generalize this code for all other "singleton RR types" (such
         // as SOA) in a separate task.
         LOG_ERROR(logger,
-                  DATASRC_MEMORY_MEM_SINGLETON).arg(rrset->getName()).
-            arg(rrset->getType());
-        bundy_throw(AddError, "multiple RRs of singleton type for "
-                  << rrset->getName());
+                  DATASRC_MEMORY_MEM_SINGLETON).arg(name).arg(rrtype);
+        bundy_throw(AddError, "multiple RRs of singleton type for " << name);
     }
 
     // NSEC3/NSEC3PARAM is not a "singleton" per protocol, but this
     // implementation requests it be so at the moment.
-    if ((rrset->getType() == RRType::NSEC3() ||
-         rrset->getType() == RRType::NSEC3PARAM()) &&
-        (rrset->getRdataCount() > 1))
+    if ((rrtype == RRType::NSEC3() || rrtype == RRType::NSEC3PARAM()) &&
+        rdata_count > 1)
     {
         bundy_throw(AddError, "Multiple NSEC3/NSEC3PARAM RDATA is given for "
-                  << rrset->getName() << " which isn't supported");
+                  << name << " which isn't supported");
     }
 
-    // For RRSIGs, check consistency of the type covered.  We know the
-    // RRset isn't empty, so the following check is safe.
-    if (rrset->getType() == RRType::RRSIG()) {
-        RdataIteratorPtr rit = rrset->getRdataIterator();
-        const RRType covered = dynamic_cast<const generic::RRSIG&>(
-            rit->getCurrent()).typeCovered();
-        for (rit->next(); !rit->isLast(); rit->next()) {
-            if (dynamic_cast<const generic::RRSIG&>(
-                     rit->getCurrent()).typeCovered() != covered)
-            {
-                bundy_throw(AddError, "RRSIG contains mixed covered types: "
-                          << rrset->toText());
-            }
-        }
-    }
-
-    const NameComparisonResult compare = zone_name_.compare(rrset->getName());
+    const NameComparisonResult compare = zone_name_.compare(name);
     if (compare.getRelation() != NameComparisonResult::SUPERDOMAIN &&
         compare.getRelation() != NameComparisonResult::EQUAL)
     {
         LOG_ERROR(logger,
-                  DATASRC_MEMORY_MEM_OUT_OF_ZONE).arg(rrset->getName()).
-            arg(zone_name_);
+                  DATASRC_MEMORY_MEM_OUT_OF_ZONE).arg(name).arg(zone_name_);
         bundy_throw(AddError,
-                  "The name " << rrset->getName() <<
+                  "The name " << name <<
                   " is not contained in zone " << zone_name_);
     }
 
@@ -176,19 +324,17 @@ ZoneDataUpdater::validate(const bundy::dns::ConstRRsetPtr rrset) const {
     // and (for DNAME) RFC6672 for more technical background.  Note also
     // that BIND 9 refuses NS at a wildcard, so in that sense we simply
     // provide compatible behavior.
-    if (rrset->getName().isWildcard()) {
-        if (rrset->getType() == RRType::NS()) {
-            LOG_ERROR(logger, DATASRC_MEMORY_MEM_WILDCARD_NS).
-                arg(rrset->getName());
+    if (name.isWildcard()) {
+        if (rrtype == RRType::NS()) {
+            LOG_ERROR(logger, DATASRC_MEMORY_MEM_WILDCARD_NS).arg(name);
             bundy_throw(AddError, "Invalid NS owner name (wildcard): "
-                      << rrset->getName());
+                      << name);
         }
 
-        if (rrset->getType() == RRType::DNAME()) {
-            LOG_ERROR(logger, DATASRC_MEMORY_MEM_WILDCARD_DNAME).
-                arg(rrset->getName());
+        if (rrtype == RRType::DNAME()) {
+            LOG_ERROR(logger, DATASRC_MEMORY_MEM_WILDCARD_DNAME).arg(name);
             bundy_throw(AddError, "Invalid DNAME owner name (wildcard): "
-                      << rrset->getName());
+                      << name);
         }
     }
 
@@ -197,13 +343,13 @@ ZoneDataUpdater::validate(const bundy::dns::ConstRRsetPtr rrset) const {
     // the zone origin.  While the RFC doesn't prohibit other forms of
     // names, no sane zone would have such names for NSEC3.  BIND 9 also
     // refuses NSEC3 at wildcard.
-    if (rrset->getType() == RRType::NSEC3() &&
-        (rrset->getName().isWildcard() ||
-         rrset->getName().getLabelCount() != zone_name_.getLabelCount() + 1))
+    if (rrtype == RRType::NSEC3() &&
+        (name.isWildcard() ||
+         name.getLabelCount() != zone_name_.getLabelCount() + 1))
     {
-        LOG_ERROR(logger, DATASRC_MEMORY_BAD_NSEC3_NAME).arg(rrset->getName());
+        LOG_ERROR(logger, DATASRC_MEMORY_BAD_NSEC3_NAME).arg(name);
         bundy_throw(AddError, "Invalid NSEC3 owner name: " <<
-                  rrset->getName() << "; zone: " << zone_name_);
+                  name << "; zone: " << zone_name_);
     }
 }
 
@@ -268,7 +414,7 @@ ZoneDataUpdater::addNSEC3(const Name& name, const ConstRRsetPtr& rrset,
     }
 
     ZoneNode* node;
-    nsec3_data->insertName(mem_sgmt_, name, &node);
+    nsec3_data->insertName(mem_sgmt_, name, &node, getNSEC3TreeBuilder());
 
     // Create a new RdataSet, merging any existing NSEC3 data for this
     // name.
@@ -281,6 +427,76 @@ ZoneDataUpdater::addNSEC3(const Name& name, const ConstRRsetPtr& rrset,
     }
 }
 
+void
+ZoneDataUpdater::installRdataSet(ZoneNode& node, RdataSet* rdataset_head,
+                                 RdataSet* old_rdataset,
+                                 RdataSet* rdataset_new, bool has_rdata)
+{
+    // A shareable RdataSet (mostly NS of a delegation) is always placed
+    // at the end of the list, so it can be shared with other nodes
+    // having the same data.
+    if (rdataset_new->isShareable() &&
+        (old_rdataset == NULL || old_rdataset->getNext() == NULL)) {
+        rdataset_new = shareRdataSet(rdataset_new);
+    }
+    if (old_rdataset == NULL && rdataset_new->isShareable()) {
+        if (rdataset_head == NULL) {
+            node.setData(rdataset_new);
+        } else {
+            RdataSet* last = rdataset_head;
+            while (last->getNext() != NULL) {
+                last = last->getNext();
+            }
+            last->next = rdataset_new;
+        }
+    } else if (old_rdataset == NULL) {
+        // There is no existing RdataSet. Prepend the new RdataSet
+        // to the list.
+        rdataset_new->next = rdataset_head;
+        node.setData(rdataset_new);
+    } else {
+        // Replace the old RdataSet in the list with the newly
+        // created one, and destroy the old one.
+        for (RdataSet* cur = rdataset_head, *prev = NULL;
+             cur != NULL;
+             prev = cur, cur = cur->getNext()) {
+            if (cur == old_rdataset) {
+                rdataset_new->next = cur->getNext();
+                if (prev == NULL) {
+                    node.setData(rdataset_new);
+                } else {
+                    prev->next = rdataset_new;
+                }
+                break;
+            }
+        }
+        unshareRdataSet(old_rdataset);
+        RdataSet::destroy(mem_sgmt_, old_rdataset, rrclass_);
+    }
+
+    // Ok, we just put it in.  If the additional links of the zone are
+    // in use, keep the new ones up to date, too.
+    if (zone_data_->isAdditionalLinked()) {
+        resolveAdditionalLinks(*rdataset_new);
+    }
+
+    // Convenient (and more efficient) shortcut to check RRsets at origin
+    const bool is_origin = (&node == zone_data_->getOriginNode());
+
+    // If this RRset creates a zone cut at this node, mark the node
+    // indicating the need for callback in find().  Note that we do this
+    // only when non RRSIG RRset of that type is added.  A new zone cut
+    // or DNAME can hide names below it, so existing additional links
+    // can't be trusted any more.
+    if (has_rdata && (rdataset_new->type == RRType::DNAME() ||
+                      (rdataset_new->type == RRType::NS() && !is_origin))) {
+        if (!node.getFlag(ZoneNode::FLAG_CALLBACK)) {
+            node.setFlag(ZoneNode::FLAG_CALLBACK);
+            zone_data_->setAdditionalLinked(false);
+        }
+    }
+}
+
 void
 ZoneDataUpdater::addRdataSet(const Name& name, const RRType& rrtype,
                              const ConstRRsetPtr& rrset,
@@ -290,7 +506,7 @@ ZoneDataUpdater::addRdataSet(const Name& name, const RRType& rrtype,
         addNSEC3(name, rrset, rrsig);
     } else {
         ZoneNode* node;
-        zone_data_->insertName(mem_sgmt_, name, &node);
+        zone_data_->insertName(mem_sgmt_, name, &node, getZoneTreeBuilder());
 
         RdataSet* rdataset_head = node->getData();
 
@@ -299,7 +515,7 @@ ZoneDataUpdater::addRdataSet(const Name& name, const RRType& rrtype,
         // exception guarantee.  At the moment we prefer code simplicity
         // and don't bother to introduce complicated recovery code.
         if (rrset) { // this check is only for covered RRset, not RRSIG
-            contextCheck(*rrset, rdataset_head);
+            contextCheck(name, rrtype, rdataset_head);
         }
 
         // Create a new RdataSet, merging any existing data for this
@@ -307,45 +523,13 @@ ZoneDataUpdater::addRdataSet(const Name& name, const RRType& rrtype,
         RdataSet* old_rdataset = RdataSet::find(rdataset_head, rrtype, true);
         RdataSet* rdataset_new = RdataSet::create(mem_sgmt_, encoder_,
                                                   rrset, rrsig, old_rdataset);
-        if (old_rdataset == NULL) {
-            // There is no existing RdataSet. Prepend the new RdataSet
-            // to the list.
-            rdataset_new->next = rdataset_head;
-            node->setData(rdataset_new);
-        } else {
-            // Replace the old RdataSet in the list with the newly
-            // created one, and destroy the old one.
-            for (RdataSet* cur = rdataset_head, *prev = NULL;
-                 cur != NULL;
-                 prev = cur, cur = cur->getNext()) {
-                if (cur == old_rdataset) {
-                    rdataset_new->next = cur->getNext();
-                    if (prev == NULL) {
-                        node->setData(rdataset_new);
-                    } else {
-                        prev->next = rdataset_new;
-                    }
-                    break;
-                }
-            }
-            RdataSet::destroy(mem_sgmt_, old_rdataset, rrclass_);
-        }
 
-        // Ok, we just put it in.
+        installRdataSet(*node, rdataset_head, old_rdataset, rdataset_new,
+                        rrset != NULL);
 
         // Convenient (and more efficient) shortcut to check RRsets at origin
         const bool is_origin = (node == zone_data_->getOriginNode());
 
-        // If this RRset creates a zone cut at this node, mark the node
-        // indicating the need for callback in find().  Note that we do this
-        // only when non RRSIG RRset of that type is added.
-        if (rrset && rrtype == RRType::NS() && !is_origin) {
-            node->setFlag(ZoneNode::FLAG_CALLBACK);
-            // If it is DNAME, we have a callback as well here
-        } else if (rrset && rrtype == RRType::DNAME()) {
-            node->setFlag(ZoneNode::FLAG_CALLBACK);
-        }
-
         // If we've added NSEC3PARAM at zone origin, set up NSEC3
         // specific data or check consistency with already set up
         // parameters.
@@ -423,16 +607,109 @@ ZoneDataUpdater::add(const ConstRRsetPtr& rrset,
             addInternal(name, rrtype, rrset, sig_rrset);
             added = true;
         } catch (const bundy::util::MemorySegmentGrown&) {
-            // The segment has grown. So, we update the base pointer (because
-            // the data may have been remapped somewhere else in the process).
-            zone_data_ =
-                static_cast<ZoneData*>(
-                    mem_sgmt_.getNamedAddress("updater_zone_data").second);
+            handleSegmentGrown();
         }
         // Retry if it didn't add due to the growth
     } while (!added);
 }
 
+void
+ZoneDataUpdater::addInternal(const Name& name, const RRType& rrtype,
+                             const RRTTL& ttl, const RdataEncoder& encoder,
+                             size_t rdata_count)
+{
+    // See the other version for the wildcards.  The supported types are
+    // never NSEC3.
+    addWildcards(name);
+
+    ZoneNode* node;
+    zone_data_->insertName(mem_sgmt_, name, &node, getZoneTreeBuilder());
+    RdataSet* rdataset_head = node->getData();
+    contextCheck(name, rrtype, rdataset_head);
+
+    // If there are already data of the type (or their RRSIGs), the new
+    // RDATA are merged with them in the form of RRset.  This should be
+    // rare in practice.
+    if (RdataSet::find(rdataset_head, rrtype, true) != NULL) {
+        addRdataSet(name, rrtype,
+                    decodeRRset(encoder, name, rrclass_, rrtype, ttl,
+                                rdata_count),
+                    ConstRRsetPtr());
+        return;
+    }
+    installRdataSet(*node, rdataset_head, NULL,
+                    RdataSet::createFromEncoder(mem_sgmt_, encoder, rrtype,
+                                                ttl, rdata_count),
+                    true);
+}
+
+void
+ZoneDataUpdater::add(const Name& name, const RRType& rrtype, const RRTTL& ttl,
+                     const RdataEncoder& encoder, size_t rdata_count)
+{
+    if (!RdataEncoder::isTextSupported(rrclass_, rrtype)) {
+        bundy_throw(BadValue, "ZoneDataUpdater::add is given encoded data "
+                  "of unsupported type: " << rrtype);
+    }
+    validate(name, rrtype, rdata_count);
+
+    LOG_DEBUG(logger, DBG_TRACE_DATA, DATASRC_MEMORY_MEM_ADD_RRSET).arg(name).
+        arg(rrtype).arg(zone_name_);
+
+    // The encoder is intact on MemorySegmentGrown, so we can simply retry.
+    bool added = false;
+    do {
+        try {
+            addInternal(name, rrtype, ttl, encoder, rdata_count);
+            added = true;
+        } catch (const bundy::util::MemorySegmentGrown&) {
+            handleSegmentGrown();
+        }
+    } while (!added);
+}
+
+void
+ZoneDataUpdater::handleSegmentGrown() {
+    // The segment has grown. So, we update the base pointer (because
+    // the data may have been remapped somewhere else in the process).
+    zone_data_ =
+        static_cast<ZoneData*>(
+            mem_sgmt_.getNamedAddress("updater_zone_data").second);
+    // The builders remember nodes at the old address, and so do
+    // we for shared RdataSets.
+    zone_tree_builder_.reset();
+    nsec3_tree_builder_.reset();
+    shared_rdatasets_.clear();
+}
+
+void
+ZoneDataUpdater::finish() {
+    if (bulk_load_) {
+        zone_data_->finishBuild(zone_tree_builder_);
+        NSEC3Data* nsec3_data = zone_data_->getNSEC3Data();
+        if (nsec3_data != NULL) {
+            nsec3_data->finishBuild(nsec3_tree_builder_);
+        }
+    }
+
+    if (zone_data_->isAdditionalLinked()) {
+        return;
+    }
+    const ZoneTree& tree = zone_data_->getZoneTree();
+    ZoneChain node_path;
+    const ZoneNode* node = NULL;
+    tree.find(zone_name_, &node, node_path);
+    for (; node != NULL; node = tree.nextNode(node_path)) {
+        for (const RdataSet* rdataset = node->getData();
+             rdataset != NULL;
+             rdataset = rdataset->getNext()) {
+            // The tree only gives const access, but the data are ours.
+            resolveAdditionalLinks(const_cast<RdataSet&>(*rdataset));
+        }
+    }
+    zone_data_->setAdditionalLinked(true);
+}
+
 } // namespace memory
 } // namespace datasrc
 } // namespace bundy
@@ -21,11 +21,16 @@
 #include <dns/name.h>
 #include <dns/rrclass.h>
 #include <dns/rrset.h>
+#include <dns/rrttl.h>
+#include <dns/rrtype.h>
 #include <dns/nsec3hash.h>
 #include <util/memory_segment.h>
 
 #include <boost/noncopyable.hpp>
 
+#include <map>
+#include <string>
+
 namespace bundy {
 namespace datasrc {
 namespace memory {
@@ -63,18 +68,24 @@ public:
     ///                  added.
     /// \param zone_data The ZoneData object which is populated with
     ///                  record data.
+    /// \param bulk_load If true, names are inserted into the zone data
+    ///    expecting they are added in the DNSSEC order, as in a full load
+    ///    of a zone from a sorted source (see \c DomainTreeBuilder).  It
+    ///    works for unsorted input, too, but \c finish() must be called
+    ///    after the last RRset is added.
     /// \throw InvalidOperation if there's already a zone data updater
     ///    on the given memory segment. Currently, at most one zone data
     ///    updater may exist on the same memory segment.
     ZoneDataUpdater(util::MemorySegment& mem_sgmt,
                     const bundy::dns::RRClass& rrclass,
                     const bundy::dns::Name& zone_name,
-                    ZoneData& zone_data) :
+                    ZoneData& zone_data, bool bulk_load = false) :
        mem_sgmt_(mem_sgmt),
        rrclass_(rrclass),
        zone_name_(zone_name),
        hash_(NULL),
-       zone_data_(&zone_data)
+       zone_data_(&zone_data),
+       bulk_load_(bulk_load)
     {
         if (mem_sgmt_.getNamedAddress("updater_zone_data").first) {
             bundy_throw(bundy::InvalidOperation, "A ZoneDataUpdater already exists"
@@ -157,6 +168,56 @@ public:
     void add(const bundy::dns::ConstRRsetPtr& rrset,
              const bundy::dns::ConstRRsetPtr& sig_rrset);
 
+    /// \brief Add encoded RDATA to the zone.
+    ///
+    /// This is a variant of the other version of \c add() for RDATA that
+    /// the caller has already added to an encoding session of \c encoder
+    /// without RRSIGs, typically with \c RdataEncoder::addRdata() from the
+    /// text of a master file.  It adds the RDATA as an unsigned RRset of the
+    /// given owner name, type and TTL, with the same validation, and
+    /// creates the \c RdataSet directly from the encoder.  RRSIGs for the
+    /// RRset can be added separately; if the name already has data of the
+    /// type, the RDATA are merged with them.
+    ///
+    /// \c rrtype must be one for which \c RdataEncoder::isTextSupported()
+    /// is true for the RR class of the zone, and the session of \c encoder
+    /// must be for that RR class and type (the latter isn't checked).
+    ///
+    /// \throw bundy::BadValue \c rrtype is not supported.
+    /// \throw AddError any of a variety of validation checks fail for the
+    /// RDATA.
+    ///
+    /// \param name The owner name of the RDATA.
+    /// \param rrtype The RR type of the RDATA.
+    /// \param ttl The TTL of the RDATA.
+    /// \param encoder The RDATA encoder holding the RDATA to be added.
+    /// \param rdata_count The number of RDATA in the session of \c encoder.
+    void add(const bundy::dns::Name& name, const bundy::dns::RRType& rrtype,
+             const bundy::dns::RRTTL& ttl, const RdataEncoder& encoder,
+             size_t rdata_count);
+
+    /// \brief Complete a bulk load.
+    ///
+    /// If the updater was constructed with \c bulk_load being true, this
+    /// rebalances the trees of the zone data, which are left unbalanced
+    /// while names are added in the DNSSEC order.  It must be called after
+    /// the last call to \c add() and before the zone data is used for
+    /// lookups.
+    ///
+    /// Then, unless they are already known to be up to date, this resolves
+    /// the additional links of all \c RdataSet objects in the zone (see
+    /// \c RdataSet::getAdditionalLink()) and marks the zone data so
+    /// the links are used (see \c ZoneData::isAdditionalLinked()).
+    /// Once marked, RdataSets added later get their links resolved in
+    /// \c add(); if a new zone cut or DNAME could make existing links
+    /// stale the mark is cleared until \c finish() is called again, and
+    /// the links are simply ignored until then.
+    ///
+    /// This method doesn't allocate memory from the memory segment.
+    ///
+    /// \throw std::bad_alloc Local memory allocation fails
+    void finish();
+
 private:
     // Add the necessary magic for any wildcard contained in 'name'
     // (including itself) to be found in the zone.
@@ -177,12 +238,20 @@ private:
                      const bundy::dns::RRType& rrtype,
                      const bundy::dns::ConstRRsetPtr& rrset,
                      const bundy::dns::ConstRRsetPtr& rrsig);
+    void addInternal(const bundy::dns::Name& name,
+                     const bundy::dns::RRType& rrtype,
+                     const bundy::dns::RRTTL& ttl,
+                     const RdataEncoder& encoder, size_t rdata_count);
+
+    // Update the state after the memory segment has grown in adding data.
+    void handleSegmentGrown();
 
     // Does some checks in context of the data that are already in the
     // zone.  Currently checks for forbidden combinations of RRsets in
     // the same domain (CNAME+anything, DNAME+NS).  If such condition is
     // found, it throws AddError.
-    void contextCheck(const bundy::dns::AbstractRRset& rrset,
+    void contextCheck(const bundy::dns::Name& name,
+                      const bundy::dns::RRType& rrtype,
                       const RdataSet* set) const;
 
     // Validate rrset before adding it to the zone.  If something is wrong
@@ -190,7 +259,22 @@ private:
     // the strong exception guarantee.
     void validate(const bundy::dns::ConstRRsetPtr rrset) const;
 
+    // The checks of validate() that only depend on the owner name, type
+    // and the number of RDATA.
+    void validate(const bundy::dns::Name& name,
+                  const bundy::dns::RRType& rrtype, size_t rdata_count) const;
+
     const bundy::dns::NSEC3Hash* getNSEC3Hash();
+
+    // The builders to insert names into the trees with; NULL unless this
+    // is a bulk load.
+    ZoneTreeBuilder* getZoneTreeBuilder() {
+        return (bulk_load_ ? &zone_tree_builder_ : NULL);
+    }
+    ZoneTreeBuilder* getNSEC3TreeBuilder() {
+        return (bulk_load_ ? &nsec3_tree_builder_ : NULL);
+    }
+
     template <typename T>
     void setupNSEC3(const bundy::dns::ConstRRsetPtr rrset);
     void addNSEC3(const bundy::dns::Name& name,
@@ -201,12 +285,42 @@ private:
                      const bundy::dns::ConstRRsetPtr& rrset,
                      const bundy::dns::ConstRRsetPtr& rrsig);
 
+    // Put a newly created RdataSet in the list of the node, replacing
+    // old_rdataset if it's non NULL, and update the node and zone data
+    // for it.  has_rdata is false iff the RdataSet was created only from
+    // RRSIGs.
+    void installRdataSet(ZoneNode& node, RdataSet* rdataset_head,
+                         RdataSet* old_rdataset, RdataSet* rdataset_new,
+                         bool has_rdata);
+
+    // If the zone already has an RdataSet with the same data as the given
+    // shareable one, destroy the given one and return the existing one with
+    // a new reference; otherwise remember and return the given one.
+    RdataSet* shareRdataSet(RdataSet* rdataset);
+
+    // Forget the given shareable RdataSet if the caller is going to release
+    // the last reference to it.
+    void unshareRdataSet(const RdataSet* rdataset);
+
+    // Set the additional links of the given RdataSet to the nodes that
+    // additional section processing would find for the names in its RDATA,
+    // or to NULL if the names need to be looked up at that time (e.g.,
+    // because they don't exist yet or match a wildcard).
+    void resolveAdditionalLinks(RdataSet& rdataset) const;
+
     util::MemorySegment& mem_sgmt_;
     const bundy::dns::RRClass rrclass_;
     const bundy::dns::Name& zone_name_;
     RdataEncoder encoder_;
     const bundy::dns::NSEC3Hash* hash_;
     ZoneData* zone_data_;
+    const bool bulk_load_;
+    ZoneTreeBuilder zone_tree_builder_;
+    ZoneTreeBuilder nsec3_tree_builder_;
+
+    // Shareable RdataSets created by this updater, keyed by their TTL and
+    // encoded data.
+    std::map<std::string, RdataSet*> shared_rdatasets_;
 };
 
 } // namespace memory
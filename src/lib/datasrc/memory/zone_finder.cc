@@ -31,6 +31,7 @@
 #include <util/buffer.h>
 
 #include <boost/scoped_ptr.hpp>
+#include <boost/scoped_array.hpp>
 #include <boost/bind.hpp>
 
 #include <algorithm>
@@ -463,6 +464,15 @@ public:
 // out_of_zone_ok is true, it returns an NXDOMAIN result with NULL data so
 // the caller can take an action to it (technically it's not "NXDOMAIN",
 // but the caller is assumed not to rely on the difference.)
+FindNodeResult findNodeFromResult(const ZoneData& zone_data,
+                                  const LabelSequence& name_labels,
+                                  ZoneChain& node_path,
+                                  ZoneFinder::FindOptions options,
+                                  ZoneTree::Result result,
+                                  const ZoneNode* node,
+                                  FindState& state,
+                                  bool out_of_zone_ok);
+
 FindNodeResult findNode(const ZoneData& zone_data,
                         const LabelSequence& name_labels,
                         ZoneChain& node_path,
@@ -472,9 +482,27 @@ FindNodeResult findNode(const ZoneData& zone_data,
     const ZoneNode* node = NULL;
     FindState state((options & ZoneFinder::FIND_GLUE_OK) != 0);
 
+    const ZoneTree::Result result =
+        zone_data.getZoneTree().find(name_labels, &node, node_path,
+                                     cutCallback, &state);
+    return (findNodeFromResult(zone_data, name_labels, node_path, options,
+                               result, node, state, out_of_zone_ok));
+}
+
+// The second half of findNode(): interpret the result of the ZoneTree
+// search, given in result, node, node_path and state.  This is separated
+// so the search can also be done for multiple names at once by
+// ZoneTree::findBatch().
+FindNodeResult findNodeFromResult(const ZoneData& zone_data,
+                                  const LabelSequence& name_labels,
+                                  ZoneChain& node_path,
+                                  ZoneFinder::FindOptions options,
+                                  ZoneTree::Result result,
+                                  const ZoneNode* node,
+                                  FindState& state,
+                                  bool out_of_zone_ok)
+{
     const ZoneTree& tree(zone_data.getZoneTree());
-    const ZoneTree::Result result = tree.find(name_labels, &node, node_path,
-                                              cutCallback, &state);
     const unsigned int zonecut_flag =
         (state.zonecut_node_ != NULL) ? FindNodeResult::FIND_ZONECUT : 0;
     if (result == ZoneTree::EXACTMATCH) {
@@ -625,18 +653,30 @@ private:
             options = options | ZoneFinder::FIND_GLUE_OK;
         }
 
+        // If the additional links are available, use them to skip the
+        // search for the names.  A NULL link still needs the search.
+        size_t link_index = 0;
+        const bool use_links = zone_data_->isAdditionalLinked() &&
+            rdset->getAdditionalLinkCount() > 0;
+
         RdataReader(rrclass_, rdset->type, rdset->getDataBuf(),
-                    rdset->getRdataCount(), rdset->getSigRdataCount(),
+                    rdset->getRdataCount(), 0,
                     boost::bind(&Context::findAdditional, this,
-                                &requested_types, &result, options, _1, _2),
+                                &requested_types, &result, options,
+                                use_links ? rdset : NULL, &link_index,
+                                _1, _2),
                     &RdataReader::emptyDataAction).iterate();
     }
 
     // RdataReader callback for additional section processing.
+    // If linked_rdset is non-NULL, its additional links are used for the
+    // names, where link_index is the index of the next link.
     void
     findAdditional(const std::vector<RRType>* requested_types,
                    std::vector<ConstRRsetPtr>* result,
                    ZoneFinder::FindOptions options,
+                   const RdataSet* linked_rdset,
+                   size_t* link_index,
                    const LabelSequence& name_labels,
                    RdataNameAttributes attr) const;
 
@@ -684,6 +724,8 @@ InMemoryZoneFinder::Context::findAdditional(
     const std::vector<RRType>* requested_types,
     std::vector<ConstRRsetPtr>* result,
     ZoneFinder::FindOptions options,
+    const RdataSet* linked_rdset,
+    size_t* link_index,
     const LabelSequence& name_labels,
     RdataNameAttributes attr) const
 {
@@ -692,10 +734,18 @@ InMemoryZoneFinder::Context::findAdditional(
         return;
     }
 
-    // Find the zone node for the additional name.  By passing true as the
-    // last parameter of findNode() we ignore out-of-zone names.
+    // Use the precomputed node for the name if we have it; it's the one
+    // findNode() below would return for an exact match.
+    const ZoneNode* linked_node = NULL;
+    if (linked_rdset != NULL) {
+        linked_node = linked_rdset->getAdditionalLink((*link_index)++);
+    }
+
+    // Otherwise, find the zone node for the additional name.  By passing
+    // true as the last parameter of findNode() we ignore out-of-zone names.
     ZoneChain node_path;
-    const FindNodeResult node_result =
+    const FindNodeResult node_result = (linked_node != NULL) ?
+        FindNodeResult(SUCCESS, linked_node, NULL) :
         findNode(*zone_data_, name_labels, node_path, options, true);
     // we only need non-empty exact match
     if (node_result.code != SUCCESS) {
@@ -796,19 +846,18 @@ InMemoryZoneFinder::findAtOrigin(const bundy::dns::RRType& type,
                                                  use_minttl))));
 }
 
+namespace {
+// The rest of InMemoryZoneFinder::findInternal() after findNode(); see
+// InMemoryZoneFinder::findBatch() for why it's separated.
 ZoneFinderResultContext
-InMemoryZoneFinder::findInternal(const bundy::dns::Name& name,
-                                 const bundy::dns::RRType& type,
-                                 std::vector<ConstRRsetPtr>* target,
-                                 const FindOptions options)
+findFromNode(const RRClass& rrclass, const ZoneData& zone_data,
+             const Name& name, const RRType& type,
+             std::vector<ConstRRsetPtr>* target,
+             const ZoneFinder::FindOptions options,
+             const FindNodeResult& node_result, ZoneChain& node_path)
 {
-    // Get the node.  All other cases than an exact match are handled
-    // in findNode().  We simply construct a result structure and return.
-    ZoneChain node_path;
-    const FindNodeResult node_result =
-        findNode(zone_data_, LabelSequence(name), node_path, options);
-    if (node_result.code != SUCCESS) {
-        return (createFindResult(rrclass_, zone_data_, node_result.code,
+    if (node_result.code != ZoneFinder::SUCCESS) {
+        return (createFindResult(rrclass, zone_data, node_result.code,
                                  node_result.node, node_result.rdataset,
                                  options));
     }
@@ -825,9 +874,9 @@ InMemoryZoneFinder::findInternal(const bundy::dns::Name& name,
     if (node->isEmpty()) {
         LOG_DEBUG(logger, DBG_TRACE_DATA, DATASRC_MEMORY_DOMAIN_EMPTY).
             arg(name);
-        ConstNodeRRset nsec_rrset = getClosestNSEC(zone_data_, node_path,
+        ConstNodeRRset nsec_rrset = getClosestNSEC(zone_data, node_path,
                                                    options);
-        return (createFindResult(rrclass_, zone_data_, NXRRSET,
+        return (createFindResult(rrclass, zone_data, ZoneFinder::NXRRSET,
                                  nsec_rrset.first, nsec_rrset.second,
                                  options, wild));
     }
@@ -841,14 +890,15 @@ InMemoryZoneFinder::findInternal(const bundy::dns::Name& name,
     //   lookup.
     // - when we are looking for glue records (FIND_GLUE_OK)
     if (node->getFlag(ZoneNode::FLAG_CALLBACK) &&
-        (options & FIND_GLUE_OK) == 0 &&
-        node != zone_data_.getOriginNode() && type != RRType::DS()) {
+        (options & ZoneFinder::FIND_GLUE_OK) == 0 &&
+        node != zone_data.getOriginNode() && type != RRType::DS()) {
         found = RdataSet::find(node->getData(), RRType::NS());
         if (found != NULL) {
             LOG_DEBUG(logger, DBG_TRACE_DATA,
                       DATASRC_MEMORY_EXACT_DELEGATION).arg(name);
-            return (createFindResult(rrclass_, zone_data_, DELEGATION,
-                                     node, found, options, wild, &name));
+            return (createFindResult(rrclass, zone_data,
+                                     ZoneFinder::DELEGATION, node, found,
+                                     options, wild, &name));
         }
     }
 
@@ -857,15 +907,15 @@ InMemoryZoneFinder::findInternal(const bundy::dns::Name& name,
         // Empty domain will be handled as NXRRSET by normal processing
         const RdataSet* cur_rds = node->getData();
         while (cur_rds != NULL) {
-            target->push_back(createTreeNodeRRset(node, cur_rds, rrclass_,
+            target->push_back(createTreeNodeRRset(node, cur_rds, rrclass,
                                                   options,
                                                   wild ? &name : NULL));
             cur_rds = cur_rds->getNext();
         }
         LOG_DEBUG(logger, DBG_TRACE_DATA, DATASRC_MEMORY_ANY_SUCCESS).
             arg(name);
-        return (createFindResult(rrclass_, zone_data_, SUCCESS, node, NULL,
-                                 options, wild, &name));
+        return (createFindResult(rrclass, zone_data, ZoneFinder::SUCCESS,
+                                 node, NULL, options, wild, &name));
     }
 
     found = RdataSet::find(node->getData(), type);
@@ -873,16 +923,16 @@ InMemoryZoneFinder::findInternal(const bundy::dns::Name& name,
         // Good, it is here
         LOG_DEBUG(logger, DBG_TRACE_DATA, DATASRC_MEMORY_SUCCESS).arg(name).
             arg(type);
-        return (createFindResult(rrclass_, zone_data_, SUCCESS, node, found,
-                                 options, wild, &name));
+        return (createFindResult(rrclass, zone_data, ZoneFinder::SUCCESS,
+                                 node, found, options, wild, &name));
     } else {
         // Next, try CNAME.
         found = RdataSet::find(node->getData(), RRType::CNAME());
         if (found != NULL) {
 
             LOG_DEBUG(logger, DBG_TRACE_DATA, DATASRC_MEMORY_CNAME).arg(name);
-            return (createFindResult(rrclass_, zone_data_, CNAME, node, found,
-                                     options, wild, &name));
+            return (createFindResult(rrclass, zone_data, ZoneFinder::CNAME,
+                                     node, found, options, wild, &name));
         }
     }
     // No exact match or CNAME.  Get NSEC if necessary and return NXRRSET.
@@ -890,10 +940,79 @@ InMemoryZoneFinder::findInternal(const bundy::dns::Name& name,
     // a wildcard; if NSEC is needed its owner name shouldn't be subject to
     // wildcard substitution; if NSEC isn't needed the "real name" doesn't
     // matter anyway.
-    return (createFindResult(rrclass_, zone_data_, NXRRSET, node,
-                             getNSECForNXRRSET(zone_data_, options, node),
+    return (createFindResult(rrclass, zone_data, ZoneFinder::NXRRSET, node,
+                             getNSECForNXRRSET(zone_data, options, node),
                              options, wild));
 }
+}
+
+void
+InMemoryZoneFinder::findBatch(const std::vector<bundy::dns::Name>& names,
+                              const std::vector<bundy::dns::RRType>& types,
+                              std::vector<ZoneFinderContextPtr>& results,
+                              const FindOptions options)
+{
+    if (names.size() != types.size()) {
+        bundy_throw(bundy::BadValue, "InMemoryZoneFinder::findBatch() is "
+                    "given " << names.size() << " names and " <<
+                    types.size() << " types");
+    }
+    results.clear();
+    const size_t count = names.size();
+    if (count == 0) {
+        return;
+    }
+
+    // Descend the tree for all names in lockstep, then complete each
+    // lookup the same way as find().
+    std::vector<LabelSequence> labels;
+    labels.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        labels.push_back(LabelSequence(names[i]));
+    }
+    std::vector<FindState> states(count,
+                                  FindState((options & FIND_GLUE_OK) != 0));
+    std::vector<FindState*> state_args(count);
+    for (size_t i = 0; i < count; ++i) {
+        state_args[i] = &states[i];
+    }
+    boost::scoped_array<ZoneChain> node_paths(new ZoneChain[count]);
+    std::vector<const ZoneNode*> nodes(count, static_cast<ZoneNode*>(NULL));
+    std::vector<ZoneTree::Result> tree_results(count);
+    zone_data_.getZoneTree().findBatch(count, &labels[0], &nodes[0],
+                                       node_paths.get(), &tree_results[0],
+                                       cutCallback, &state_args[0]);
+
+    results.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        const FindNodeResult node_result =
+            findNodeFromResult(zone_data_, LabelSequence(names[i]),
+                               node_paths[i], options, tree_results[i],
+                               nodes[i], states[i], false);
+        results.push_back(ZoneFinderContextPtr(
+                              new Context(*this, options, rrclass_,
+                                          findFromNode(rrclass_, zone_data_,
+                                                       names[i], types[i],
+                                                       NULL, options,
+                                                       node_result,
+                                                       node_paths[i]))));
+    }
+}
+
+ZoneFinderResultContext
+InMemoryZoneFinder::findInternal(const bundy::dns::Name& name,
+                                 const bundy::dns::RRType& type,
+                                 std::vector<ConstRRsetPtr>* target,
+                                 const FindOptions options)
+{
+    // Get the node.  All other cases than an exact match are handled
+    // in findNode().  We simply construct a result structure and return.
+    ZoneChain node_path;
+    const FindNodeResult node_result =
+        findNode(zone_data_, LabelSequence(name), node_path, options);
+    return (findFromNode(rrclass_, zone_data_, name, type, target, options,
+                         node_result, node_path));
+}
 
 bundy::datasrc::ZoneFinder::FindNSEC3Result
 InMemoryZoneFinder::findNSEC3(const bundy::dns::Name& name, bool recursive) {
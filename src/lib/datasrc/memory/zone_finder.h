@@ -80,6 +80,33 @@ public:
         std::vector<bundy::dns::ConstRRsetPtr>& target,
         const FindOptions options = FIND_DEFAULT);
 
+    /// \brief Find RRsets for multiple names at once.
+    ///
+    /// This is equivalent to calling \c find() for each pair of
+    /// \c names[i] and \c types[i] with the same \c options, and the
+    /// resulting contexts are stored in \c results in the same order.
+    /// It's more efficient than separate calls when the zone is large,
+    /// because the zone tree is searched for all names in lockstep, so
+    /// the cache misses on the tree nodes overlap (see
+    /// \c DomainTree::findBatch()).
+    ///
+    /// If any of the names is out of the zone, \c OutOfZone is thrown as
+    /// in \c find(), and the content of \c results is unspecified.
+    ///
+    /// \throw bundy::BadValue The sizes of \c names and \c types differ.
+    /// \throw OutOfZone Any of the names is not a subdomain of the origin.
+    /// \throw std::bad_alloc Memory allocation fails.
+    ///
+    /// \param names The names to be looked up.
+    /// \param types The RR types to be looked up, one for each name.
+    /// \param results Cleared, and then the contexts of the results are
+    ///     stored.
+    /// \param options As for \c find().
+    void findBatch(const std::vector<bundy::dns::Name>& names,
+                   const std::vector<bundy::dns::RRType>& types,
+                   std::vector<ZoneFinderContextPtr>& results,
+                   const FindOptions options = FIND_DEFAULT);
+
     /// Look for NSEC3 for proving (non)existence of given name.
     ///
     /// See documentation in \c Zone.
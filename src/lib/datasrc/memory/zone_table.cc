@@ -23,6 +23,7 @@
 #include <util/memory_segment.h>
 
 #include <dns/name.h>
+#include <dns/labelsequence.h>
 
 #include <boost/function.hpp>
 #include <boost/bind.hpp>
@@ -50,6 +51,18 @@ deleteZoneData(util::MemorySegment* mem_sgmt, ZoneData* zone_data,
     }
 }
 typedef boost::function<void(ZoneData*)> ZoneDataDeleterType;
+
+// Collect the absolute names of the nodes of the table; see getZoneNames().
+class ZoneNameCollector {
+public:
+    ZoneNameCollector(vector<Name>& names) : names_(names) {}
+    void operator()(const DomainTreeNode<ZoneData>& node) {
+        uint8_t labels_buf[LabelSequence::MAX_SERIALIZED_LENGTH];
+        names_.push_back(Name(node.getAbsoluteLabels(labels_buf).toText()));
+    }
+private:
+    vector<Name>& names_;
+};
 }
 
 ZoneTable*
@@ -134,6 +147,27 @@ ZoneTable::addZoneInternal(util::MemorySegment& mem_sgmt,
     }
 }
 
+ZoneTable::AddResult
+ZoneTable::removeZone(util::MemorySegment& mem_sgmt, const Name& zone_name) {
+    LOG_DEBUG(logger, DBG_TRACE_BASIC, DATASRC_MEMORY_MEM_REMOVE_ZONE).
+        arg(zone_name).arg(rrclass_);
+
+    ZoneTableNode* node(NULL);
+    if (zones_->find(zone_name, &node) != ZoneTableTree::EXACTMATCH) {
+        return (AddResult(result::NOTFOUND, NULL));
+    }
+    // Can Not Happen; empty nodes are invisible for find().
+    assert(node != NULL);
+
+    // Take the data out of the node first, so the tree doesn't destroy it.
+    ZoneData* old = node->setData(NULL);
+    zones_->remove(mem_sgmt, node,
+                   boost::bind(deleteZoneData, &mem_sgmt, _1, rrclass_));
+    --zone_count_;
+    return (AddResult(result::SUCCESS,
+                      (old == NULL || old->isEmpty()) ? NULL : old));
+}
+
 ZoneTable::FindResult
 ZoneTable::findZone(const Name& name) const {
     const ZoneTableNode* node(NULL);
@@ -170,6 +204,15 @@ ZoneTable::findZone(const Name& name) const {
                        flags));
 }
 
+vector<Name>
+ZoneTable::getZoneNames() const {
+    vector<Name> names;
+    names.reserve(zone_count_);
+    ZoneNameCollector collector(names);
+    zones_->visitNodes(collector);
+    return (names);
+}
+
 } // end of namespace memory
 } // end of namespace datasrc
 } // end of namespace bundy
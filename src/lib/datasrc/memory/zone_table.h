@@ -25,6 +25,8 @@
 #include <boost/noncopyable.hpp>
 #include <boost/interprocess/offset_ptr.hpp>
 
+#include <vector>
+
 namespace bundy {
 namespace dns {
 class Name;
@@ -224,6 +226,32 @@ public:
     AddResult addEmptyZone(util::MemorySegment& mem_sgmt,
                            const dns::Name& zone_name);
 
+    /// \brief Remove a zone from the \c ZoneTable.
+    ///
+    /// This method removes the zone of the exact given name from the
+    /// table, and returns its data.  The ownership of the returned data is
+    /// passed to the caller, who is responsible for destroying it (like the
+    /// old data returned by \c addZone()).  If the zone was added by
+    /// \c addEmptyZone(), it's removed and NULL is returned.
+    ///
+    /// \throw none
+    ///
+    /// \param mem_sgmt Same as addZone().
+    /// \param zone_name The name of the zone to be removed.
+    /// \return \c result::SUCCESS If the zone is successfully removed.
+    /// \return \c result::NOTFOUND There is no zone of the given name in
+    ///     the table; the returned data is NULL.
+    AddResult removeZone(util::MemorySegment& mem_sgmt,
+                         const dns::Name& zone_name);
+
+    /// \brief Return the origins of all zones in the \c ZoneTable.
+    ///
+    /// The names are returned in DNSSEC order, including those of empty
+    /// zones (see \c addEmptyZone()).
+    ///
+    /// \throw std::bad_alloc Internal resource allocation fails.
+    std::vector<dns::Name> getZoneNames() const;
+
     /// \brief Find a zone that best matches the given name in the
     /// \c ZoneTable.
     ///
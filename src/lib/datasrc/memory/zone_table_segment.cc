@@ -30,12 +30,14 @@ namespace datasrc {
 namespace memory {
 
 ZoneTableSegment*
-ZoneTableSegment::create(const RRClass& rrclass, const std::string& type) {
+ZoneTableSegment::create(const RRClass& rrclass, const std::string& type,
+                         bool huge_pages)
+{
     // This will be a few sequences of if-else and hardcoded.  Not really
     // sophisticated, but we don't expect to have too many types at the moment.
     // Until that it becomes a real issue we won't be too smart.
     if (type == "local") {
-        return (new ZoneTableSegmentLocal(rrclass));
+        return (new ZoneTableSegmentLocal(rrclass, huge_pages));
 #ifdef USE_SHARED_MEMORY
     } else if (type == "mapped") {
         return (new ZoneTableSegmentMapped(rrclass));
@@ -28,6 +28,7 @@
 #include <boost/interprocess/offset_ptr.hpp>
 
 #include <cstdlib>
+#include <ctime>
 #include <string>
 
 namespace bundy {
@@ -175,6 +176,35 @@ public:
     /// exception-free.
     virtual bool isWritable() const = 0;
 
+    /// \brief Return the size of the memory segment and of its free part.
+    ///
+    /// This is mainly for diagnosis, e.g., to see how fragmented the
+    /// segment is.  Implementations that can't tell these (such as the
+    /// "local" one, which is just a part of the process heap) return
+    /// false, which is the default; so should they if the segment isn't
+    /// usable.  Otherwise they set the total size of the segment in
+    /// \c size and the part of it not in use in \c free_size, and return
+    /// true.
+    ///
+    /// \throw None This method's implementations must be exception-free.
+    virtual bool getSegmentSize(size_t& /*size*/,
+                                size_t& /*free_size*/) const
+    {
+        return (false);
+    }
+
+    /// \brief Return the time the segment's backing storage was modified.
+    ///
+    /// Segments that don't have persistent storage (such as the "local"
+    /// one) return false, which is the default; so should others if the
+    /// segment isn't usable.  Otherwise they set the last modification
+    /// time of the storage in \c mtime and return true.
+    ///
+    /// \throw None This method's implementations must be exception-free.
+    virtual bool getModificationTime(time_t& /*mtime*/) const {
+        return (false);
+    }
+
     /// \brief Create an instance depending on the requested memory
     /// segment implementation type.
     ///
@@ -188,9 +218,13 @@ public:
     ///
     /// \param rrclass The RR class of the zones to be maintained in the table.
     /// \param type The memory segment type to be used.
+    /// \param huge_pages Whether a "local" segment uses huge pages (see
+    /// \c ZoneTableSegmentLocal); other types take it from the parameters
+    /// of \c reset(), if they support it.
     /// \return Returns a \c ZoneTableSegment object of the specified type.
     static ZoneTableSegment* create(const bundy::dns::RRClass& rrclass,
-                                    const std::string& type);
+                                    const std::string& type,
+                                    bool huge_pages = false);
 
     /// \brief Destroy a \c ZoneTableSegment
     ///
@@ -21,9 +21,11 @@ namespace bundy {
 namespace datasrc {
 namespace memory {
 
-ZoneTableSegmentLocal::ZoneTableSegmentLocal(const RRClass& rrclass) :
+ZoneTableSegmentLocal::ZoneTableSegmentLocal(const RRClass& rrclass,
+                                             bool huge_pages) :
     ZoneTableSegment(rrclass),
     impl_type_("local"),
+    mem_sgmt_(huge_pages),
     header_(ZoneTable::create(mem_sgmt_, rrclass))
 {
 }
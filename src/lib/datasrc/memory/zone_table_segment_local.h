@@ -40,7 +40,12 @@ protected:
     /// Instances are expected to be created by the factory method
     /// (\c ZoneTableSegment::create()), so this constructor is
     /// protected.
-    ZoneTableSegmentLocal(const bundy::dns::RRClass& rrclass);
+    ///
+    /// \param rrclass The RR class of the zones in the table.
+    /// \param huge_pages Whether the memory segment uses huge pages (see
+    /// \c bundy::util::MemorySegmentLocal).
+    ZoneTableSegmentLocal(const bundy::dns::RRClass& rrclass,
+                          bool huge_pages = false);
 
 public:
     /// \brief Destructor
@@ -16,8 +16,14 @@
 #include <datasrc/memory/zone_table.h>
 #include <datasrc/memory/segment_object_holder.h>
 
+#include <boost/lexical_cast.hpp>
+
+#include <cassert>
 #include <memory>
 
+#include <stdint.h>
+#include <sys/stat.h>
+
 using namespace bundy::data;
 using namespace bundy::dns;
 using namespace bundy::util;
@@ -35,6 +41,30 @@ const char* const ZONE_TABLE_CHECKSUM_NAME = "zone_table_checksum";
 // The name with which the zone table header is associated in the segment.
 const char* const ZONE_TABLE_HEADER_NAME = "zone_table_header";
 
+// The name with which the format version of the zone table is associated
+// in the segment.
+const char* const ZONE_TABLE_VERSION_NAME = "zone_table_version";
+
+// The version of the layout of the data stored in the segment.  This must
+// be incremented on any incompatible change to the in-memory data
+// structures, so a segment saved by a different version of the
+// implementation is rejected on reset instead of being misinterpreted.
+const uint32_t ZONE_TABLE_FORMAT_VERSION = 3;
+
+// Return the value of an optional boolean parameter for reset().
+bool
+getBoolParam(ConstElementPtr params, const char* name) {
+    if (!params->contains(name)) {
+        return (false);
+    }
+    const ConstElementPtr value = params->get(name);
+    if (value->getType() != Element::boolean) {
+        bundy_throw(bundy::InvalidParameter,
+                  "Value of \"" << name << "\" is not a boolean");
+    }
+    return (value->boolValue());
+}
+
 } // end of unnamed namespace
 
 ZoneTableSegmentMapped::ZoneTableSegmentMapped(const RRClass& rrclass) :
@@ -53,6 +83,30 @@ ZoneTableSegmentMapped::getImplType() const {
     return (impl_type_);
 }
 
+bool
+ZoneTableSegmentMapped::verifyChecksum(MemorySegmentMapped& segment,
+                                       std::string& error_msg)
+{
+    const MemorySegment::NamedAddressResult result =
+        segment.getNamedAddress(ZONE_TABLE_CHECKSUM_NAME);
+    if (result.first) {
+        // The segment was already shrunk when it was last
+        // closed. Check that its checksum is consistent.
+        assert(result.second);
+        size_t* checksum = static_cast<size_t*>(result.second);
+        const size_t saved_checksum = *checksum;
+        // First, clear the checksum so that getCheckSum() returns a
+        // consistent value.
+        *checksum = 0;
+        const size_t new_checksum = segment.getCheckSum();
+        if (saved_checksum != new_checksum) {
+            error_msg = "Saved checksum doesn't match segment data";
+            return (false);
+        }
+    }
+    return (true);
+}
+
 bool
 ZoneTableSegmentMapped::processChecksum(MemorySegmentMapped& segment,
                                         bool create, bool has_allocations,
@@ -66,21 +120,8 @@ ZoneTableSegmentMapped::processChecksum(MemorySegmentMapped& segment,
             error_msg = "There is already a saved checksum in the segment "
                  "opened in create mode";
             return (false);
-        } else {
-            // The segment was already shrunk when it was last
-            // closed. Check that its checksum is consistent.
-            assert(result.second);
-            size_t* checksum = static_cast<size_t*>(result.second);
-            const size_t saved_checksum = *checksum;
-            // First, clear the checksum so that getCheckSum() returns a
-            // consistent value.
-            *checksum = 0;
-            const size_t new_checksum = segment.getCheckSum();
-            if (saved_checksum != new_checksum) {
-                error_msg = "Saved checksum doesn't match segment data";
-                return (false);
-            }
         }
+        // Otherwise it's been verified by verifyChecksum().
     } else {
         if ((!create) && has_allocations) {
             // If we are resetting in READ_WRITE mode, and some memory
@@ -106,6 +147,64 @@ ZoneTableSegmentMapped::processChecksum(MemorySegmentMapped& segment,
     return (true);
 }
 
+bool
+ZoneTableSegmentMapped::processVersion(MemorySegmentMapped& segment,
+                                       bool create, bool has_allocations,
+                                       std::string& error_msg)
+{
+    const MemorySegment::NamedAddressResult result =
+        segment.getNamedAddress(ZONE_TABLE_VERSION_NAME);
+    if (result.first) {
+        if (create) {
+            // There must be no previously saved version.
+            error_msg = "There is already a saved format version in the "
+                 "segment opened in create mode";
+            return (false);
+        }
+        return (checkVersion(result, error_msg));
+    } else {
+        if ((!create) && has_allocations) {
+            // The segment was created by an implementation which didn't
+            // record the format version, so we cannot trust its content.
+            error_msg = "Existing segment is missing a format version";
+            return (false);
+        }
+
+        void* version = NULL;
+        while (!version) {
+            try {
+                version = segment.allocate(sizeof(uint32_t));
+            } catch (const MemorySegmentGrown&) {
+                // Do nothing and try again.
+            }
+        }
+        *static_cast<uint32_t*>(version) = ZONE_TABLE_FORMAT_VERSION;
+        segment.setNamedAddress(ZONE_TABLE_VERSION_NAME, version);
+    }
+
+    return (true);
+}
+
+bool
+ZoneTableSegmentMapped::checkVersion(
+    const MemorySegment::NamedAddressResult& result, std::string& error_msg)
+{
+    if (!result.first) {
+        error_msg = "There is no format version in the segment";
+        return (false);
+    }
+    assert(result.second);
+    const uint32_t version = *static_cast<const uint32_t*>(result.second);
+    if (version != ZONE_TABLE_FORMAT_VERSION) {
+        error_msg = "Incompatible format version of the segment: " +
+            boost::lexical_cast<std::string>(version) + " (expected " +
+            boost::lexical_cast<std::string>(ZONE_TABLE_FORMAT_VERSION) +
+            ")";
+        return (false);
+    }
+    return (true);
+}
+
 bool
 ZoneTableSegmentMapped::processHeader(MemorySegmentMapped& segment,
                                       bool create, bool has_allocations,
@@ -149,22 +248,37 @@ ZoneTableSegmentMapped::processHeader(MemorySegmentMapped& segment,
 
 MemorySegmentMapped*
 ZoneTableSegmentMapped::openReadWrite(const std::string& filename,
-                                      bool create)
+                                      bool create, bool huge_pages,
+                                      bool prefault)
 {
     const MemorySegmentMapped::OpenMode mode = create ?
          MemorySegmentMapped::CREATE_ONLY :
          MemorySegmentMapped::OPEN_OR_CREATE;
     // In case there is a problem, we throw. We want the segment to be
-    // automatically destroyed then.
+    // automatically destroyed then.  We reserve address space for the
+    // segment so loading zones into it won't (normally) relocate it and
+    // need to be retried.
     std::auto_ptr<MemorySegmentMapped> segment
-        (new MemorySegmentMapped(filename, mode));
+        (new MemorySegmentMapped(filename, mode,
+                                 MemorySegmentMapped::INITIAL_SIZE,
+                                 MemorySegmentMapped::DEFAULT_RESERVED_SIZE));
+    // Apply the memory options before the segment is first used, whether
+    // it's a new file or one that was open before this reset().
+    segment->setMemoryOptions(huge_pages, prefault);
+
+    // The checksum must be verified before anything else touches the
+    // segment: even allMemoryDeallocated() frees and reallocates an
+    // internal block, which can rewrite the bytes the checksum covers.
+    std::string error_msg;
+    const bool checksum_ok = create || verifyChecksum(*segment, error_msg);
 
     // This flag is used inside processCheckSum() and processHeader(),
     // and must be initialized before we make any further allocations.
     const bool has_allocations = !segment->allMemoryDeallocated();
 
-    std::string error_msg;
-    if ((!processChecksum(*segment, create, has_allocations, error_msg)) ||
+    if ((!checksum_ok) ||
+        (!processChecksum(*segment, create, has_allocations, error_msg)) ||
+        (!processVersion(*segment, create, has_allocations, error_msg)) ||
         (!processHeader(*segment, create, has_allocations, error_msg))) {
          if (mem_sgmt_) {
               bundy_throw(ResetFailed,
@@ -181,11 +295,14 @@ ZoneTableSegmentMapped::openReadWrite(const std::string& filename,
 }
 
 MemorySegmentMapped*
-ZoneTableSegmentMapped::openReadOnly(const std::string& filename) {
+ZoneTableSegmentMapped::openReadOnly(const std::string& filename,
+                                     bool huge_pages, bool prefault)
+{
     // In case the checksum or table header is missing, we throw. We
     // want the segment to be automatically destroyed then.
     std::auto_ptr<MemorySegmentMapped> segment
         (new MemorySegmentMapped(filename));
+    segment->setMemoryOptions(huge_pages, prefault);
     // There must be a previously saved checksum.
     MemorySegment::NamedAddressResult result =
         segment->getNamedAddress(ZONE_TABLE_CHECKSUM_NAME);
@@ -208,6 +325,21 @@ ZoneTableSegmentMapped::openReadOnly(const std::string& filename) {
     // 0 for checksum calculation in a read-only segment. So we continue
     // without verifying the checksum.
 
+    // But we can (and must) make sure we understand the data layout.
+    std::string version_error;
+    if (!checkVersion(segment->getNamedAddress(ZONE_TABLE_VERSION_NAME),
+                      version_error)) {
+         if (mem_sgmt_) {
+              bundy_throw(ResetFailed,
+                        "Error in resetting zone table segment to use "
+                        << filename << ": " << version_error);
+         } else {
+              bundy_throw(ResetFailedAndSegmentCleared,
+                        "Error in resetting zone table segment to use "
+                        << filename << ": " << version_error);
+         }
+    }
+
     // There must be a previously saved ZoneTableHeader.
     result = segment->getNamedAddress(ZONE_TABLE_HEADER_NAME);
     if (result.first) {
@@ -251,6 +383,8 @@ ZoneTableSegmentMapped::reset(MemorySegmentOpenMode mode,
     }
 
     const std::string filename = mapped_file->stringValue();
+    const bool huge_pages = getBoolParam(params, "huge-pages");
+    const bool prefault = getBoolParam(params, "prefault");
 
     if (mem_sgmt_ && (filename == current_filename_)) {
         // This reset() is an attempt to re-open the currently open
@@ -267,15 +401,15 @@ ZoneTableSegmentMapped::reset(MemorySegmentOpenMode mode,
 
     switch (mode) {
     case CREATE:
-        segment.reset(openReadWrite(filename, true));
+        segment.reset(openReadWrite(filename, true, huge_pages, prefault));
         break;
 
     case READ_WRITE:
-        segment.reset(openReadWrite(filename, false));
+        segment.reset(openReadWrite(filename, false, huge_pages, prefault));
         break;
 
     case READ_ONLY:
-        segment.reset(openReadOnly(filename));
+        segment.reset(openReadOnly(filename, huge_pages, prefault));
         break;
 
     default:
@@ -387,6 +521,28 @@ ZoneTableSegmentMapped::isWritable() const {
     return ((current_mode_ == CREATE) || (current_mode_ == READ_WRITE));
 }
 
+bool
+ZoneTableSegmentMapped::getSegmentSize(size_t& size, size_t& free_size) const {
+    if (!isUsable()) {
+        return (false);
+    }
+
+    size = mem_sgmt_->getSize();
+    free_size = mem_sgmt_->getFreeSize();
+    return (true);
+}
+
+bool
+ZoneTableSegmentMapped::getModificationTime(time_t& mtime) const {
+    struct stat file_stat;
+    if (!isUsable() || stat(current_filename_.c_str(), &file_stat) != 0) {
+        return (false);
+    }
+
+    mtime = file_stat.st_mtime;
+    return (true);
+}
+
 } // namespace memory
 } // namespace datasrc
 } // namespace bundy
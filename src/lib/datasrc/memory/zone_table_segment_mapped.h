@@ -76,6 +76,16 @@ public:
     /// not writable until it is reset successfully.
     virtual bool isWritable() const;
 
+    /// \brief Return the size of the mapped segment and of its free part.
+    ///
+    /// See the base class for the description.
+    virtual bool getSegmentSize(size_t& size, size_t& free_size) const;
+
+    /// \brief Return the modification time of the mapped file.
+    ///
+    /// See the base class for the description.
+    virtual bool getModificationTime(time_t& mtime) const;
+
     /// \brief Close the current \c MemorySegment (if open) and open the
     /// requested one.
     ///
@@ -88,9 +98,16 @@ public:
     ///
     ///  {"mapped-file": "/var/bundy/mapped-files/zone-sqlite3.mapped.0"}
     ///
+    /// It may also contain the optional boolean "huge-pages" and
+    /// "prefault" keys, which are passed to
+    /// \c MemorySegmentMapped::setMemoryOptions() for the opened segment
+    /// (both default to false).
+    ///
     /// Please see the \c ZoneTableSegment API documentation for the
     /// behavior in case of exceptions.
     ///
+    /// \throws bundy::InvalidParameter if \c params is not a map containing
+    /// the mapped file name or an optional key has a wrong type.
     /// \throws bundy::Unexpected when it's unable to lookup a named
     /// address that it expected to be present. This is extremely
     /// unlikely, and it points to corruption.
@@ -115,14 +132,26 @@ public:
 private:
     void sync();
 
+    static bool verifyChecksum(bundy::util::MemorySegmentMapped& segment,
+                               std::string& error_msg);
     bool processChecksum(bundy::util::MemorySegmentMapped& segment, bool create,
                          bool has_allocations, std::string& error_msg);
+    bool processVersion(bundy::util::MemorySegmentMapped& segment,
+                        bool create, bool has_allocations,
+                        std::string& error_msg);
+    static bool checkVersion(
+        const bundy::util::MemorySegment::NamedAddressResult& result,
+        std::string& error_msg);
     bool processHeader(bundy::util::MemorySegmentMapped& segment, bool create,
                        bool has_allocations, std::string& error_msg);
 
     bundy::util::MemorySegmentMapped* openReadWrite(const std::string& filename,
-                                                  bool create);
-    bundy::util::MemorySegmentMapped* openReadOnly(const std::string& filename);
+                                                  bool create,
+                                                  bool huge_pages,
+                                                  bool prefault);
+    bundy::util::MemorySegmentMapped* openReadOnly(const std::string& filename,
+                                                 bool huge_pages,
+                                                 bool prefault);
 
     template<typename T> T* getHeaderHelper(bool initial) const;
 
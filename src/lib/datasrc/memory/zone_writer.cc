@@ -170,6 +170,11 @@ ZoneWriter::cleanup() {
     }
 }
 
+ZoneTableSegment&
+ZoneWriter::getZoneTableSegment() const {
+    return (impl_->segment_);
+}
+
 }
 }
 }
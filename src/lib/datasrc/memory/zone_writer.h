@@ -127,6 +127,15 @@ public:
     /// \throw none
     void cleanup();
 
+    /// \brief Return the zone table segment the zone is stored into.
+    ///
+    /// Loading zones into the same segment from different threads must be
+    /// serialized by the caller; this allows it to tell which writers
+    /// share a segment.
+    ///
+    /// \throw none
+    ZoneTableSegment& getZoneTableSegment() const;
+
 private:
     // We hide details as this class will be used by various applications
     // and we use some internal data structures in the implementation.
@@ -14,6 +14,7 @@
 
 #include <sqlite3.h>
 
+#include <algorithm>
 #include <string>
 #include <utility>
 #include <vector>
@@ -21,6 +22,10 @@
 #include <exceptions/exceptions.h>
 
 #include <dns/name.h>
+#include <dns/rrclass.h>
+#include <dns/rrtype.h>
+#include <dns/rdata.h>
+#include <util/buffer.h>
 
 #include <datasrc/sqlite3_accessor.h>
 #include <datasrc/sqlite3_datasrc_messages.h>
@@ -45,7 +50,7 @@ namespace {
 // program may not be taking advantage of features (possibly performance
 // improvements) added to the database.
 const int SQLITE_SCHEMA_MAJOR_VERSION = 2;
-const int SQLITE_SCHEMA_MINOR_VERSION = 2;
+const int SQLITE_SCHEMA_MINOR_VERSION = 3;
 }
 
 namespace bundy {
@@ -81,20 +86,22 @@ enum StatementID {
     DEL_NSEC3_RECORD = 21,
     ADD_ZONE = 22,
     DELETE_ZONE = 23,
-    NUM_STATEMENTS = 24
+    DATA_VERSION = 24,
+    NUM_STATEMENTS = 25
 };
 
 const char* const text_statements[NUM_STATEMENTS] = {
     // note for ANY and ITERATE: the order of the SELECT values is
     // specifically chosen to match the enum values in RecordColumns
+    // (the NULL is for the name column, which is not needed for ANY).
     "SELECT id FROM zones WHERE name=?1 AND rdclass = ?2", // ZONE
-    "SELECT rdtype, ttl, sigtype, rdata FROM records "     // ANY
-        "WHERE zone_id=?1 AND name=?2",
+    "SELECT rdtype, ttl, sigtype, rdata, NULL, rdata_wire " // ANY
+        "FROM records WHERE zone_id=?1 AND name=?2",
 
     // ANY_SUB:
     // This query returns records in the specified zone for the domain
     // matching the passed name, and its sub-domains.
-    "SELECT rdtype, ttl, sigtype, rdata "
+    "SELECT rdtype, ttl, sigtype, rdata, NULL, rdata_wire "
         "FROM records WHERE zone_id=?1 AND rname LIKE ?2",
 
     "BEGIN",                    // BEGIN
@@ -102,8 +109,8 @@ const char* const text_statements[NUM_STATEMENTS] = {
     "ROLLBACK",                 // ROLLBACK
     "DELETE FROM records WHERE zone_id=?1", // DEL_ZONE_RECORDS
     "INSERT INTO records "      // ADD_RECORD
-        "(zone_id, name, rname, ttl, rdtype, sigtype, rdata) "
-        "VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7)",
+        "(zone_id, name, rname, ttl, rdtype, sigtype, rdata, rdata_wire) "
+        "VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8)",
     // DEL_RECORD:
     // Delete based on the reverse name, as that one has an index.
     "DELETE FROM records WHERE zone_id=?1 AND rname=?2 " // DEL_RECORD
@@ -111,13 +118,13 @@ const char* const text_statements[NUM_STATEMENTS] = {
 
     // ITERATE_RECORDS:
     // The following iterates the whole zone in the records table.
-    "SELECT rdtype, ttl, sigtype, rdata, name FROM records "
+    "SELECT rdtype, ttl, sigtype, rdata, name, rdata_wire FROM records "
         "WHERE zone_id = ?1 ORDER BY rname, rdtype",
 
     // ITERATE_NSEC3:
     // The following iterates the whole zone in the nsec3 table. As the
     // RRSIGs are for NSEC3s, we can hardcode the sigtype.
-    "SELECT rdtype, ttl, \"NSEC3\", rdata, owner FROM nsec3 "
+    "SELECT rdtype, ttl, \"NSEC3\", rdata, owner, rdata_wire FROM nsec3 "
         "WHERE zone_id = ?1 ORDER BY hash, rdtype",
     /*
      * This one looks for previous name with NSEC record. It is done by
@@ -151,8 +158,8 @@ const char* const text_statements[NUM_STATEMENTS] = {
     // The "1" in SELECT is for positioning the rdata column to the
     // expected position, so we can reuse the same code as for other
     // lookups.
-    "SELECT rdtype, ttl, 1, rdata FROM nsec3 WHERE zone_id=?1 AND "
-        "hash=?2",
+    "SELECT rdtype, ttl, 1, rdata, NULL, rdata_wire FROM nsec3 "
+        "WHERE zone_id=?1 AND hash=?2",
     // NSEC3_PREVIOUS: For getting the previous NSEC3 hash
     "SELECT DISTINCT hash FROM nsec3 WHERE zone_id=?1 AND hash < ?2 "
         "ORDER BY hash DESC LIMIT 1",
@@ -160,8 +167,8 @@ const char* const text_statements[NUM_STATEMENTS] = {
     "SELECT DISTINCT hash FROM nsec3 WHERE zone_id=?1 "
         "ORDER BY hash DESC LIMIT 1",
     // ADD_NSEC3_RECORD: Add NSEC3-related (NSEC3 or NSEC3-covering RRSIG) RR
-    "INSERT INTO nsec3 (zone_id, hash, owner, ttl, rdtype, rdata) "
-    "VALUES (?1, ?2, ?3, ?4, ?5, ?6)",
+    "INSERT INTO nsec3 (zone_id, hash, owner, ttl, rdtype, rdata, rdata_wire) "
+    "VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7)",
     // DEL_ZONE_NSEC3_RECORDS: delete all NSEC3-related records from the zone
     "DELETE FROM nsec3 WHERE zone_id=?1",
     // DEL_NSEC3_RECORD: delete specified NSEC3-related records
@@ -171,19 +178,256 @@ const char* const text_statements[NUM_STATEMENTS] = {
     // ADD_ZONE: add a zone to the zones table
     "INSERT INTO zones (name, rdclass) VALUES (?1, ?2)", // ADD_ZONE
     // DELETE_ZONE: delete a zone from the zones table
-    "DELETE FROM zones WHERE id=?1" // DELETE_ZONE
+    "DELETE FROM zones WHERE id=?1", // DELETE_ZONE
+    // DATA_VERSION: counter changed by commits of other connections
+    "PRAGMA data_version"
+};
+
+// Databases older than schema 2.3 don't have the rdata_wire columns.  For
+// them the statements that refer to the column are replaced with the
+// following ones, which return the rdata in text form only.
+const struct {
+    StatementID id;
+    const char* const text;
+} text_only_statements[] = {
+    { ANY, "SELECT rdtype, ttl, sigtype, rdata FROM records "
+           "WHERE zone_id=?1 AND name=?2" },
+    { ANY_SUB, "SELECT rdtype, ttl, sigtype, rdata "
+               "FROM records WHERE zone_id=?1 AND rname LIKE ?2" },
+    { ADD_RECORD, "INSERT INTO records "
+                  "(zone_id, name, rname, ttl, rdtype, sigtype, rdata) "
+                  "VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7)" },
+    { ITERATE_RECORDS, "SELECT rdtype, ttl, sigtype, rdata, name FROM records "
+                       "WHERE zone_id = ?1 ORDER BY rname, rdtype" },
+    { ITERATE_NSEC3, "SELECT rdtype, ttl, \"NSEC3\", rdata, owner FROM nsec3 "
+                     "WHERE zone_id = ?1 ORDER BY hash, rdtype" },
+    { NSEC3, "SELECT rdtype, ttl, 1, rdata FROM nsec3 WHERE zone_id=?1 AND "
+             "hash=?2" },
+    { ADD_NSEC3_RECORD, "INSERT INTO nsec3 "
+                        "(zone_id, hash, owner, ttl, rdtype, rdata) "
+                        "VALUES (?1, ?2, ?3, ?4, ?5, ?6)" }
+};
+
+// Rows to be inserted with one of the INSERT statements above during a zone
+// update.  They are kept here until there are enough of them to be written
+// with a single multi-row INSERT (or until they have to be written because
+// something else needs to see them), which is much faster than inserting
+// them one by one when loading a large zone.
+//
+// The multi-row statement is derived from the single-row one by repeating
+// its "VALUES" part, so the two always insert the same columns.
+class BulkInserter {
+public:
+    BulkInserter(StatementID stmt_id) :
+        stmt_id_(stmt_id), param_count_(0), bulk_stmt_(NULL), bulk_rows_(0)
+    {}
+
+    StatementID getStatementID() const { return (stmt_id_); }
+
+    // The following append values to the row being added.  Empty text
+    // is stored as NULL if empty_as_null is true; an empty blob is always
+    // stored as NULL.
+    void addInt(sqlite3_int64 val) {
+        values_.push_back(Value(Value::INTEGER));
+        values_.back().integer = val;
+    }
+    void addText(const string& val, bool empty_as_null) {
+        values_.push_back(Value(empty_as_null && val.empty() ?
+                                Value::NUL : Value::TEXT));
+        values_.back().data = val;
+    }
+    void addBlob(const string& val) {
+        values_.push_back(Value(val.empty() ? Value::NUL : Value::BLOB));
+        values_.back().data = val;
+    }
+    // Called once all values of the row have been added.
+    void endRow() {
+        if (param_count_ == 0) {
+            param_count_ = values_.size();
+        }
+        assert(values_.size() % param_count_ == 0);
+    }
+
+    size_t getRowCount() const {
+        return (param_count_ == 0 ? 0 : values_.size() / param_count_);
+    }
+
+    // Write the pending rows, max_rows at a time.  Unless all is true, only
+    // full batches are written and the rest is kept.  Otherwise the
+    // remaining rows are written with the given single-row statement.
+    // On failure the rows that haven't been written are kept (a failed
+    // statement doesn't write anything), so they are not lost if the caller
+    // retries.
+    void flush(sqlite3* db, const char* single_text, sqlite3_stmt* single_stmt,
+               size_t max_rows, bool all)
+    {
+        size_t done = 0;
+        try {
+            const size_t rows = getBulkRows(db, max_rows);
+            if (rows > 1) {
+                for (; getRowCount() - done >= rows; done += rows) {
+                    prepareBulk(db, single_text, rows);
+                    execute(db, bulk_stmt_, done, rows);
+                }
+            }
+            if (all) {
+                for (; done < getRowCount(); ++done) {
+                    execute(db, single_stmt, done, 1);
+                }
+            }
+        } catch (...) {
+            removeRows(done);
+            throw;
+        }
+        removeRows(done);
+    }
+
+    void clear() {
+        values_.clear();
+    }
+
+    void finalize() {
+        sqlite3_finalize(bulk_stmt_);
+        bulk_stmt_ = NULL;
+        bulk_rows_ = 0;
+    }
+
+private:
+    struct Value {
+        enum Type { NUL, INTEGER, TEXT, BLOB };
+        Value(Type t) : type(t), integer(0) {}
+        Type type;
+        sqlite3_int64 integer;
+        string data;
+    };
+
+    void removeRows(size_t rows) {
+        values_.erase(values_.begin(), values_.begin() + rows * param_count_);
+    }
+
+    // The number of rows per multi-row statement, limited by the number of
+    // parameters a statement can have.
+    size_t getBulkRows(sqlite3* db, size_t max_rows) const {
+        if (param_count_ == 0) {
+            return (0);
+        }
+        const size_t max_params =
+            sqlite3_limit(db, SQLITE_LIMIT_VARIABLE_NUMBER, -1);
+        return (std::min(max_rows, max_params / param_count_));
+    }
+
+    void prepareBulk(sqlite3* db, const char* single_text, size_t rows) {
+        if (bulk_stmt_ != NULL && bulk_rows_ == rows) {
+            return;
+        }
+        finalize();
+        const string single(single_text);
+        const size_t values_pos = single.find("VALUES");
+        assert(values_pos != string::npos);
+        string tuple = "(";
+        for (size_t i = 0; i < param_count_; ++i) {
+            tuple += (i == 0) ? "?" : ", ?";
+        }
+        tuple += ")";
+        string text = single.substr(0, values_pos) + "VALUES " + tuple;
+        for (size_t i = 1; i < rows; ++i) {
+            text += ", " + tuple;
+        }
+        if (sqlite3_prepare_v2(db, text.c_str(), -1, &bulk_stmt_, NULL) !=
+            SQLITE_OK) {
+            bulk_stmt_ = NULL;
+            bundy_throw(SQLite3Error, "Could not prepare SQLite statement: "
+                        << single_text << " (" << rows << " rows): "
+                        << sqlite3_errmsg(db));
+        }
+        bulk_rows_ = rows;
+    }
+
+    // Bind rows starting at the given row to the statement and run it.
+    void execute(sqlite3* db, sqlite3_stmt* stmt, size_t first, size_t rows) {
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+        const size_t begin = first * param_count_;
+        for (size_t i = 0; i < rows * param_count_; ++i) {
+            const Value& val = values_[begin + i];
+            int rc = SQLITE_OK;
+            switch (val.type) {
+            case Value::NUL:
+                rc = sqlite3_bind_null(stmt, i + 1);
+                break;
+            case Value::INTEGER:
+                rc = sqlite3_bind_int64(stmt, i + 1, val.integer);
+                break;
+            case Value::TEXT:
+                rc = sqlite3_bind_text(stmt, i + 1, val.data.c_str(), -1,
+                                       SQLITE_STATIC);
+                break;
+            case Value::BLOB:
+                rc = sqlite3_bind_blob(stmt, i + 1, val.data.data(),
+                                       val.data.size(), SQLITE_STATIC);
+                break;
+            }
+            if (rc != SQLITE_OK) {
+                sqlite3_reset(stmt);
+                bundy_throw(DataSourceError,
+                            "failed to bind SQLite3 parameter: " <<
+                            sqlite3_errmsg(db));
+            }
+        }
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            sqlite3_reset(stmt);
+            bundy_throw(DataSourceError, "failed to add records: " <<
+                        sqlite3_errmsg(db));
+        }
+        // Reset (and unbind, as the values are about to be released)
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+    }
+
+    StatementID stmt_id_;
+    size_t param_count_;
+    vector<Value> values_;
+    sqlite3_stmt* bulk_stmt_;
+    size_t bulk_rows_;
 };
 
+// The number of rows written by a single INSERT statement in zone updates
+// unless SQLite3Accessor::setUpdateBatchSize() is called.
+const size_t DEFAULT_UPDATE_BATCH_SIZE = 100;
+
 struct SQLite3Parameters {
     SQLite3Parameters() :
-        db_(NULL), major_version_(-1), minor_version_(-1),
-        in_transaction(false), updating_zone(false), updated_zone_id(-1)
+        db_(NULL), major_version_(-1), minor_version_(-1), has_wire_(false),
+        in_transaction(false), updating_zone(false), updated_zone_id(-1),
+        update_batch_size_(DEFAULT_UPDATE_BATCH_SIZE),
+        defer_indexes_(false),
+        record_inserter_(ADD_RECORD), nsec3_inserter_(ADD_NSEC3_RECORD),
+        diff_inserter_(ADD_RECORD_DIFF)
     {
         for (int i = 0; i < NUM_STATEMENTS; ++i) {
             statements_[i] = NULL;
+            idle_statements_[i] = NULL;
         }
     }
 
+    // Returns the SQL text of the specified statement, taking into account
+    // whether the database has the wire-format rdata columns.
+    const char*
+    getStatementText(int id) const {
+        assert(id < NUM_STATEMENTS);
+        if (!has_wire_) {
+            for (size_t i = 0;
+                 i < sizeof(text_only_statements) /
+                     sizeof(text_only_statements[0]);
+                 ++i) {
+                if (text_only_statements[i].id == id) {
+                    return (text_only_statements[i].text);
+                }
+            }
+        }
+        return (text_statements[id]);
+    }
+
     // This method returns the specified ID of SQLITE3 statement.  If it's
     // not yet prepared it internally creates a new one.  This way we can
     // avoid preparing unnecessary statements and minimize the overhead.
@@ -191,40 +435,127 @@ struct SQLite3Parameters {
     getStatement(int id) {
         assert(id < NUM_STATEMENTS);
         if (statements_[id] == NULL) {
-            assert(db_ != NULL);
-            sqlite3_stmt* prepared = NULL;
-            if (sqlite3_prepare_v2(db_, text_statements[id], -1, &prepared,
-                                   NULL) != SQLITE_OK) {
-                bundy_throw(SQLite3Error, "Could not prepare SQLite statement: "
-                          << text_statements[id] <<
-                          ": " << sqlite3_errmsg(db_));
-            }
-            statements_[id] = prepared;
+            statements_[id] = prepareStatement(id);
         }
         return (statements_[id]);
     }
 
+    // Statements for iterator contexts.  As more than one context can be
+    // active on the connection at the same time, these are separate from
+    // the ones returned by getStatement().  A context borrows the statement
+    // kept for the ID if it's not in use by another context, and a new one
+    // is prepared otherwise; either way the statement must be given back
+    // with releaseStatement().  This way a lookup doesn't normally have to
+    // compile its SQL every time.
+    sqlite3_stmt*
+    acquireStatement(int id) {
+        assert(id < NUM_STATEMENTS);
+        sqlite3_stmt* stmt = idle_statements_[id];
+        if (stmt == NULL) {
+            return (prepareStatement(id));
+        }
+        idle_statements_[id] = NULL;
+        return (stmt);
+    }
+
+    void
+    releaseStatement(int id, sqlite3_stmt* stmt) {
+        assert(id < NUM_STATEMENTS);
+        if (idle_statements_[id] != NULL || db_ == NULL) {
+            sqlite3_finalize(stmt);
+            return;
+        }
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+        idle_statements_[id] = stmt;
+    }
+
+    // Called when a row has been added to one of the inserters below.
+    // The rows are written once there are enough of them for a batch.
+    void
+    queueRow(BulkInserter& inserter) {
+        inserter.endRow();
+        if (inserter.getRowCount() >= update_batch_size_) {
+            flushInserter(inserter, update_batch_size_ <= 1);
+        }
+    }
+
+    // Write all pending rows.  This must be called before anything that
+    // may depend on them: reading the zone data or diffs, deleting
+    // records, and committing.
+    void
+    flushInserts() {
+        flushInserter(record_inserter_, true);
+        flushInserter(nsec3_inserter_, true);
+        flushInserter(diff_inserter_, true);
+    }
+
+    void
+    clearInserts() {
+        record_inserter_.clear();
+        nsec3_inserter_.clear();
+        diff_inserter_.clear();
+    }
+
     void
     finalizeStatements() {
+        record_inserter_.finalize();
+        nsec3_inserter_.finalize();
+        diff_inserter_.finalize();
         for (int i = 0; i < NUM_STATEMENTS; ++i) {
             if (statements_[i] != NULL) {
                 sqlite3_finalize(statements_[i]);
                 statements_[i] = NULL;
             }
+            if (idle_statements_[i] != NULL) {
+                sqlite3_finalize(idle_statements_[i]);
+                idle_statements_[i] = NULL;
+            }
         }
     }
 
     sqlite3* db_;
     int major_version_;
     int minor_version_;
+    bool has_wire_;     // whether the DB has the wire-format rdata columns
     bool in_transaction; // whether or not a transaction has been started
     bool updating_zone;          // whether or not updating the zone
     int updated_zone_id;        // valid only when in_transaction is true
     string updated_zone_origin_; // ditto, and only needed to handle NSEC3s
+    size_t update_batch_size_;  // rows per INSERT statement in updates
+    bool defer_indexes_;        // drop indexes while replacing a zone
+    vector<string> deferred_indexes_; // indexes to be recreated on commit
+    BulkInserter record_inserter_;
+    BulkInserter nsec3_inserter_;
+    BulkInserter diff_inserter_;
 private:
+    void
+    flushInserter(BulkInserter& inserter, bool all) {
+        if (inserter.getRowCount() > 0) {
+            const StatementID id = inserter.getStatementID();
+            inserter.flush(db_, getStatementText(id), getStatement(id),
+                           update_batch_size_, all);
+        }
+    }
+
+    sqlite3_stmt*
+    prepareStatement(int id) {
+        assert(db_ != NULL);
+        sqlite3_stmt* prepared = NULL;
+        if (sqlite3_prepare_v2(db_, getStatementText(id), -1, &prepared,
+                               NULL) != SQLITE_OK) {
+            bundy_throw(SQLite3Error, "Could not prepare SQLite statement: "
+                      << getStatementText(id) <<
+                      ": " << sqlite3_errmsg(db_));
+        }
+        return (prepared);
+    }
+
     // statements_ are private and must be accessed via getStatement() outside
     // of this structure.
     sqlite3_stmt* statements_[NUM_STATEMENTS];
+    // Ditto for acquireStatement() and releaseStatement().
+    sqlite3_stmt* idle_statements_[NUM_STATEMENTS];
 };
 
 // This is a helper class to encapsulate the code logic of executing
@@ -311,8 +642,21 @@ SQLite3Accessor::SQLite3Accessor(const std::string& filename,
 
 boost::shared_ptr<DatabaseAccessor>
 SQLite3Accessor::clone() {
-    return (boost::shared_ptr<DatabaseAccessor>(new SQLite3Accessor(filename_,
-                                                                    class_)));
+    boost::shared_ptr<SQLite3Accessor> cloned(new SQLite3Accessor(filename_,
+                                                                  class_));
+    cloned->setUpdateBatchSize(dbparameters_->update_batch_size_);
+    cloned->setDeferIndexesOnReplace(dbparameters_->defer_indexes_);
+    return (cloned);
+}
+
+void
+SQLite3Accessor::setUpdateBatchSize(size_t rows) {
+    dbparameters_->update_batch_size_ = rows;
+}
+
+void
+SQLite3Accessor::setDeferIndexesOnReplace(bool defer) {
+    dbparameters_->defer_indexes_ = defer;
 }
 
 namespace {
@@ -341,7 +685,7 @@ public:
 const char* const SCHEMA_LIST[] = {
     "CREATE TABLE schema_version (version INTEGER NOT NULL, "
         "minor INTEGER NOT NULL DEFAULT 0)",
-    "INSERT INTO schema_version VALUES (2, 2)",
+    "INSERT INTO schema_version VALUES (2, 3)",
     "CREATE TABLE zones (id INTEGER PRIMARY KEY, "
     "name TEXT NOT NULL COLLATE NOCASE, "
     "rdclass TEXT NOT NULL COLLATE NOCASE DEFAULT 'IN', "
@@ -351,7 +695,7 @@ const char* const SCHEMA_LIST[] = {
         "zone_id INTEGER NOT NULL, name TEXT NOT NULL COLLATE NOCASE, "
         "rname TEXT NOT NULL COLLATE NOCASE, ttl INTEGER NOT NULL, "
         "rdtype TEXT NOT NULL COLLATE NOCASE, sigtype TEXT COLLATE NOCASE, "
-        "rdata TEXT NOT NULL)",
+        "rdata TEXT NOT NULL, rdata_wire BLOB)",
     "CREATE INDEX records_byname ON records (name)",
     "CREATE INDEX records_byrname ON records (rname)",
     // The next index is a tricky one.  It's necessary for
@@ -366,7 +710,7 @@ const char* const SCHEMA_LIST[] = {
         "hash TEXT NOT NULL COLLATE NOCASE, "
         "owner TEXT NOT NULL COLLATE NOCASE, "
         "ttl INTEGER NOT NULL, rdtype TEXT NOT NULL COLLATE NOCASE, "
-        "rdata TEXT NOT NULL)",
+        "rdata TEXT NOT NULL, rdata_wire BLOB)",
     "CREATE INDEX nsec3_byhash ON nsec3 (hash)",
     "CREATE INDEX nsec3_byhash_and_rdtype ON nsec3 (hash, rdtype)",
     "CREATE TABLE diffs (id INTEGER PRIMARY KEY, "
@@ -380,16 +724,6 @@ const char* const SCHEMA_LIST[] = {
     NULL
 };
 
-sqlite3_stmt*
-prepare(sqlite3* const db, const char* const statement) {
-    sqlite3_stmt* prepared = NULL;
-    if (sqlite3_prepare_v2(db, statement, -1, &prepared, NULL) != SQLITE_OK) {
-        bundy_throw(SQLite3Error, "Could not prepare SQLite statement: " <<
-                  statement << ": " << sqlite3_errmsg(db));
-    }
-    return (prepared);
-}
-
 // small function to sleep for 0.1 seconds, needed when waiting for
 // exclusive database locks (which should only occur on startup, and only
 // when the database has not been created yet)
@@ -512,6 +846,17 @@ createDatabase(sqlite3* db, const std::string& name) {
         }
         trasaction.commit();
 
+        // Use write-ahead logging for new databases, so readers and the
+        // writer don't block each other.  The mode is persistent, so this
+        // only needs to be done once.  It's merely an optimization, and
+        // may fail (e.g. if the file system doesn't support it), in which
+        // case we just continue with the default journal mode.
+        if (sqlite3_exec(db, "PRAGMA journal_mode=WAL", NULL, NULL, NULL) !=
+            SQLITE_OK) {
+            logger.info(DATASRC_SQLITE_NO_WAL).arg(name).
+                arg(sqlite3_errmsg(db));
+        }
+
         // Return the version.  We query again to ensure that the only point
         // in which the current schema version is defined is in the create
         // statements.
@@ -521,6 +866,18 @@ createDatabase(sqlite3* db, const std::string& name) {
     return (schema_version);
 }
 
+// Returns whether the given table has the given column.  The database
+// schema has been checked before this is called, so any failure to
+// prepare the query can only mean the column doesn't exist.
+bool
+hasColumn(sqlite3* db, const string& table, const string& column) {
+    const string query = "SELECT " + column + " FROM " + table + " LIMIT 0";
+    sqlite3_stmt* prepared = NULL;
+    const int rc = sqlite3_prepare_v2(db, query.c_str(), -1, &prepared, NULL);
+    sqlite3_finalize(prepared);
+    return (rc == SQLITE_OK);
+}
+
 void
 checkAndSetupSchema(Initializer* initializer, const std::string& name) {
     sqlite3* const db = initializer->params_.db_;
@@ -543,6 +900,11 @@ checkAndSetupSchema(Initializer* initializer, const std::string& name) {
 
     initializer->params_.major_version_ = schema_version.first;
     initializer->params_.minor_version_ = schema_version.second;
+    // The rdata_wire columns were introduced in schema 2.3.  Older
+    // databases keep working with the text form only (until they are
+    // upgraded with bundy-dbutil).
+    initializer->params_.has_wire_ = hasColumn(db, "records", "rdata_wire") &&
+        hasColumn(db, "nsec3", "rdata_wire");
 }
 
 }
@@ -697,20 +1059,21 @@ public:
         accessor_(accessor),
         statement_(NULL),
         statement2_(NULL),
+        statement_id_(ITERATE_RECORDS),
+        statement2_id_(ITERATE_NSEC3),
         rc_(SQLITE_OK),
         rc2_(SQLITE_OK),
         name_("")
     {
-        // We create the statements now and then just keep getting data
+        // We get the statements now and then just keep getting data
         // from them.
-        statement_ = prepare(accessor->dbparameters_->db_,
-                             text_statements[ITERATE_NSEC3]);
+        acquireStatement(ITERATE_NSEC3);
         bindZoneId(id);
 
         std::swap(statement_, statement2_);
+        std::swap(statement_id_, statement2_id_);
 
-        statement_ = prepare(accessor->dbparameters_->db_,
-                             text_statements[ITERATE_RECORDS]);
+        acquireStatement(ITERATE_RECORDS);
         bindZoneId(id);
     }
 
@@ -730,29 +1093,28 @@ public:
         accessor_(accessor),
         statement_(NULL),
         statement2_(NULL),
+        statement_id_(ANY),
+        statement2_id_(ANY),
         rc_(SQLITE_OK),
         rc2_(SQLITE_OK),
         name_(name)
     {
-        // Choose the statement text depending on the query type, and
-        // prepare a statement to get data from it.
+        // Choose the statement depending on the query type, and get data
+        // from it.
         switch (qtype) {
             case QT_ANY:
-                statement_ = prepare(accessor->dbparameters_->db_,
-                                     text_statements[ANY]);
+                acquireStatement(ANY);
                 bindZoneId(id);
                 bindName(name_);
                 break;
             case QT_SUBDOMAINS:
-                statement_ = prepare(accessor->dbparameters_->db_,
-                                     text_statements[ANY_SUB]);
+                acquireStatement(ANY_SUB);
                 bindZoneId(id);
                 // Done once, this should not be very inefficient.
                 bindName(bundy::dns::Name(name_).reverse().toText() + "%");
                 break;
             case QT_NSEC3:
-                statement_ = prepare(accessor->dbparameters_->db_,
-                                     text_statements[NSEC3]);
+                acquireStatement(NSEC3);
                 bindZoneId(id);
                 bindName(name_);
                 break;
@@ -786,6 +1148,7 @@ public:
                 if (iterator_type_ == ITT_ALL) {
                     copyColumn(data, NAME_COLUMN);
                 }
+                copyWireColumn(data);
                 return (true);
             } else if (rc_ != SQLITE_DONE) {
                 bundy_throw(DataSourceError,
@@ -798,6 +1161,7 @@ public:
                 break;
             }
             std::swap(statement_, statement2_);
+            std::swap(statement_id_, statement2_id_);
             std::swap(rc_, rc2_);
         }
         finalize();
@@ -824,6 +1188,36 @@ private:
                                           accessor_->dbparameters_->db_);
     }
 
+    // The wire-format rdata is binary, so it can't be handled as a C string
+    // like the other columns.  It's NULL for records stored without it, and
+    // doesn't exist at all in older databases; either way we return an
+    // empty string for it.
+    void copyWireColumn(std::string (&data)[COLUMN_COUNT]) {
+        if (!accessor_->dbparameters_->has_wire_) {
+            data[RDATA_WIRE_COLUMN].clear();
+            return;
+        }
+        const void* wire = sqlite3_column_blob(statement_, RDATA_WIRE_COLUMN);
+        if (wire == NULL) {
+            if (sqlite3_errcode(accessor_->dbparameters_->db_) ==
+                SQLITE_NOMEM) {
+                bundy_throw(DataSourceError,
+                            "Sqlite3 backend encountered a memory allocation "
+                            "error in sqlite3_column_blob()");
+            }
+            data[RDATA_WIRE_COLUMN].clear();
+            return;
+        }
+        data[RDATA_WIRE_COLUMN].assign(
+            static_cast<const char*>(wire),
+            sqlite3_column_bytes(statement_, RDATA_WIRE_COLUMN));
+    }
+
+    void acquireStatement(StatementID id) {
+        statement_ = accessor_->dbparameters_->acquireStatement(id);
+        statement_id_ = id;
+    }
+
     void bindZoneId(const int zone_id) {
         if (sqlite3_bind_int(statement_, 1, zone_id) != SQLITE_OK) {
             finalize();
@@ -843,13 +1237,17 @@ private:
         }
     }
 
+    // Give the statements back to the accessor.  It resets them, so
+    // this also ends the read transaction if the iteration wasn't complete.
     void finalize() {
         if (statement_ != NULL) {
-             sqlite3_finalize(statement_);
+             accessor_->dbparameters_->releaseStatement(statement_id_,
+                                                        statement_);
              statement_ = NULL;
         }
         if (statement2_ != NULL) {
-             sqlite3_finalize(statement2_);
+             accessor_->dbparameters_->releaseStatement(statement2_id_,
+                                                        statement2_);
              statement2_ = NULL;
         }
     }
@@ -858,6 +1256,8 @@ private:
     boost::shared_ptr<const SQLite3Accessor> accessor_;
     sqlite3_stmt* statement_;
     sqlite3_stmt* statement2_;
+    StatementID statement_id_;
+    StatementID statement2_id_;
     int rc_;
     int rc2_;
     const std::string name_;
@@ -870,6 +1270,7 @@ DatabaseAccessor::IteratorContextPtr
 SQLite3Accessor::getRecords(const std::string& name, int id,
                             bool subdomains) const
 {
+    dbparameters_->flushInserts();
     return (IteratorContextPtr(new Context(shared_from_this(), id, name,
                                            subdomains ?
                                            Context::QT_SUBDOMAINS :
@@ -878,12 +1279,14 @@ SQLite3Accessor::getRecords(const std::string& name, int id,
 
 DatabaseAccessor::IteratorContextPtr
 SQLite3Accessor::getNSEC3Records(const std::string& hash, int id) const {
+    dbparameters_->flushInserts();
     return (IteratorContextPtr(new Context(shared_from_this(), id, hash,
                                            Context::QT_NSEC3)));
 }
 
 DatabaseAccessor::IteratorContextPtr
 SQLite3Accessor::getAllRecords(int id) const {
+    dbparameters_->flushInserts();
     return (IteratorContextPtr(new Context(shared_from_this(), id)));
 }
 
@@ -965,6 +1368,8 @@ public:
                 copyColumn(DIFF_RECS, data, TTL_COLUMN);
                 copyColumn(DIFF_RECS, data, NAME_COLUMN);
                 copyColumn(DIFF_RECS, data, RDATA_COLUMN);
+                // Diffs are kept in text only.
+                data[RDATA_WIRE_COLUMN].clear();
 
             } else if (rc != SQLITE_DONE) {
                 bundy_throw(DataSourceError,
@@ -1134,12 +1539,69 @@ private:
 
 DatabaseAccessor::IteratorContextPtr
 SQLite3Accessor::getDiffs(int id, uint32_t start, uint32_t end) const {
+    dbparameters_->flushInserts();
     return (IteratorContextPtr(new DiffContext(shared_from_this(), id, start,
                                end)));
 }
 
 
 
+namespace {
+// Drop the indexes of the records and nsec3 tables within the current
+// transaction, remembering how to recreate them.  When a large zone is
+// replaced, building the indexes once at the end is much faster than
+// updating them for every added record.
+void
+dropIndexes(SQLite3Parameters& dbparams) {
+    sqlite3_stmt* stmt = NULL;
+    if (sqlite3_prepare_v2(dbparams.db_, "SELECT name, sql FROM sqlite_master "
+                           "WHERE type = 'index' AND sql IS NOT NULL AND "
+                           "tbl_name IN ('records', 'nsec3')", -1, &stmt,
+                           NULL) != SQLITE_OK) {
+        bundy_throw(DataSourceError, "failed to get SQLite3 indexes: " <<
+                    sqlite3_errmsg(dbparams.db_));
+    }
+    vector<string> names;
+    vector<string> sqls;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        names.push_back(convertToPlainChar(sqlite3_column_text(stmt, 0),
+                                           dbparams.db_));
+        sqls.push_back(convertToPlainChar(sqlite3_column_text(stmt, 1),
+                                          dbparams.db_));
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        bundy_throw(DataSourceError, "failed to get SQLite3 indexes: " <<
+                    sqlite3_errmsg(dbparams.db_));
+    }
+
+    for (size_t i = 0; i < names.size(); ++i) {
+        const string drop = "DROP INDEX \"" + names[i] + "\"";
+        if (sqlite3_exec(dbparams.db_, drop.c_str(), NULL, NULL, NULL) !=
+            SQLITE_OK) {
+            bundy_throw(DataSourceError, "failed to drop SQLite3 index " <<
+                        names[i] << ": " << sqlite3_errmsg(dbparams.db_));
+        }
+        dbparams.deferred_indexes_.push_back(sqls[i]);
+    }
+}
+
+// Recreate the indexes dropped by dropIndexes(), if any.
+void
+recreateIndexes(SQLite3Parameters& dbparams) {
+    while (!dbparams.deferred_indexes_.empty()) {
+        const string& create = dbparams.deferred_indexes_.back();
+        if (sqlite3_exec(dbparams.db_, create.c_str(), NULL, NULL, NULL) !=
+            SQLITE_OK) {
+            bundy_throw(DataSourceError, "failed to recreate SQLite3 index (" <<
+                        create << "): " << sqlite3_errmsg(dbparams.db_));
+        }
+        dbparams.deferred_indexes_.pop_back();
+    }
+}
+}
+
 pair<bool, int>
 SQLite3Accessor::startUpdateZone(const string& zone_name, const bool replace) {
     if (dbparameters_->updating_zone) {
@@ -1176,10 +1638,14 @@ SQLite3Accessor::startUpdateZone(const string& zone_name, const bool replace) {
                 delzone_proc.bindInt(1, zone_info.second);
                 delzone_proc.exec();
             }
+            if (dbparameters_->defer_indexes_) {
+                dropIndexes(*dbparameters_);
+            }
         } catch (const DataSourceError&) {
             // Once we start a transaction, if something unexpected happens
             // we need to rollback the transaction so that a subsequent update
             // is still possible with this accessor.
+            dbparameters_->deferred_indexes_.clear();
             StatementProcessor(*dbparameters_, ROLLBACK,
                                "rollback an SQLite3 transaction").exec();
             throw;
@@ -1213,6 +1679,8 @@ SQLite3Accessor::commit() {
                   "data source without transaction");
     }
 
+    dbparameters_->flushInserts();
+    recreateIndexes(*dbparameters_);
     StatementProcessor(*dbparameters_, COMMIT,
                        "commit an SQLite3 transaction").exec();
     dbparameters_->in_transaction = false;
@@ -1230,6 +1698,9 @@ SQLite3Accessor::rollback() {
 
     StatementProcessor(*dbparameters_, ROLLBACK,
                        "rollback an SQLite3 transaction").exec();
+    // Pending rows and dropped indexes are gone with the transaction.
+    dbparameters_->clearInserts();
+    dbparameters_->deferred_indexes_.clear();
     dbparameters_->in_transaction = false;
     dbparameters_->updating_zone = false;
     dbparameters_->updated_zone_id = -1;
@@ -1237,12 +1708,15 @@ SQLite3Accessor::rollback() {
 }
 
 namespace {
-// Commonly used code sequence for adding/deleting record
+// Commonly used code sequence for deleting record.
 template <typename COLUMNS_TYPE>
 void
 doUpdate(SQLite3Parameters& dbparams, StatementID stmt_id,
          COLUMNS_TYPE update_params, const char* exec_desc)
 {
+    // Deletion may concern records added in this update.
+    dbparams.flushInserts();
+
     StatementProcessor proc(dbparams, stmt_id, exec_desc);
 
     int param_id = 0;
@@ -1257,6 +1731,47 @@ doUpdate(SQLite3Parameters& dbparams, StatementID stmt_id,
     }
     proc.exec();
 }
+
+// Queue a row to be added to the zone with the given inserter.  If rdata_wire
+// is non NULL, it's added as a blob after the other columns.
+template <typename COLUMNS_TYPE>
+void
+queueInsert(SQLite3Parameters& dbparams, BulkInserter& inserter,
+            COLUMNS_TYPE columns, const string* rdata_wire)
+{
+    inserter.addInt(dbparams.updated_zone_id);
+    const size_t column_count = sizeof(columns) / sizeof(columns[0]);
+    for (int i = 0; i < column_count; ++i) {
+        // Empty columns are stored as NULL, see doUpdate().
+        inserter.addText(columns[i], true);
+    }
+    if (rdata_wire != NULL) {
+        inserter.addBlob(*rdata_wire);
+    }
+    dbparams.queueRow(inserter);
+}
+
+// Convert the text form of rdata to the (uncompressed) wire format to be
+// stored in the database along with the text.  If the text doesn't parse
+// as the given type, an empty string is returned; the record is then
+// stored in text only, and will be rejected when looked up (as it would
+// without the wire format).
+string
+rdataToWire(const string& rrclass, const string& rrtype, const string& rdata)
+{
+    try {
+        const bundy::dns::rdata::ConstRdataPtr rdata_obj =
+            bundy::dns::rdata::createRdata(bundy::dns::RRType(rrtype),
+                                           bundy::dns::RRClass(rrclass),
+                                           rdata);
+        bundy::util::OutputBuffer buffer(0);
+        rdata_obj->toWire(buffer);
+        return (string(static_cast<const char*>(buffer.getData()),
+                       buffer.getLength()));
+    } catch (const bundy::Exception&) {
+        return (string());
+    }
+}
 }
 
 void
@@ -1265,8 +1780,12 @@ SQLite3Accessor::addRecordToZone(const string (&columns)[ADD_COLUMN_COUNT]) {
         bundy_throw(DataSourceError, "adding record to SQLite3 "
                   "data source without transaction");
     }
-    doUpdate<const string (&)[ADD_COLUMN_COUNT]>(
-        *dbparameters_, ADD_RECORD, columns, "add record to zone");
+    const bool has_wire = dbparameters_->has_wire_;
+    const string rdata_wire = has_wire ?
+        rdataToWire(class_, columns[ADD_TYPE], columns[ADD_RDATA]) : "";
+    queueInsert<const string (&)[ADD_COLUMN_COUNT]>(
+        *dbparameters_, dbparameters_->record_inserter_, columns,
+        has_wire ? &rdata_wire : NULL);
 }
 
 void
@@ -1288,9 +1807,13 @@ SQLite3Accessor::addNSEC3RecordToZone(
           columns[ADD_NSEC3_HASH] + "." + dbparameters_->updated_zone_origin_,
           columns[ADD_NSEC3_TTL],
           columns[ADD_NSEC3_TYPE], columns[ADD_NSEC3_RDATA] };
-    doUpdate<const string (&)[ADD_NSEC3_COLUMN_COUNT + 1]>(
-        *dbparameters_, ADD_NSEC3_RECORD, sqlite3_columns,
-        "add NSEC3 record to zone");
+    const bool has_wire = dbparameters_->has_wire_;
+    const string rdata_wire = has_wire ?
+        rdataToWire(class_, columns[ADD_NSEC3_TYPE],
+                    columns[ADD_NSEC3_RDATA]) : "";
+    queueInsert<const string (&)[ADD_NSEC3_COLUMN_COUNT + 1]>(
+        *dbparameters_, dbparameters_->nsec3_inserter_, sqlite3_columns,
+        has_wire ? &rdata_wire : NULL);
 }
 
 void
@@ -1339,22 +1862,22 @@ SQLite3Accessor::addRecordDiff(int zone_id, uint32_t serial,
                   << dbparameters_->updated_zone_id);
     }
 
-    StatementProcessor proc(*dbparameters_, ADD_RECORD_DIFF,
-                            "add record diff");
-    int param_id = 0;
-    proc.bindInt(++param_id, zone_id);
-    proc.bindInt64(++param_id, serial);
-    proc.bindInt(++param_id, operation);
+    // The diffs are written in the same batches as the records.
+    BulkInserter& inserter = dbparameters_->diff_inserter_;
+    inserter.addInt(zone_id);
+    inserter.addInt(serial);
+    inserter.addInt(operation);
     for (int i = 0; i < DIFF_PARAM_COUNT; ++i) {
-        proc.bindText(++param_id, params[i].c_str(), SQLITE_TRANSIENT);
+        inserter.addText(params[i], false);
     }
-    proc.exec();
+    dbparameters_->queueRow(inserter);
 }
 
 std::string
 SQLite3Accessor::findPreviousName(int zone_id, const std::string& rname)
     const
 {
+    dbparameters_->flushInserts();
     sqlite3_stmt* const stmt = dbparameters_->getStatement(FIND_PREVIOUS);
     sqlite3_reset(stmt);
     sqlite3_clear_bindings(stmt);
@@ -1399,6 +1922,7 @@ std::string
 SQLite3Accessor::findPreviousNSEC3Hash(int zone_id, const std::string& hash)
     const
 {
+    dbparameters_->flushInserts();
     sqlite3_stmt* const stmt = dbparameters_->getStatement(NSEC3_PREVIOUS);
     sqlite3_reset(stmt);
     sqlite3_clear_bindings(stmt);
@@ -1465,5 +1989,25 @@ SQLite3Accessor::findPreviousNSEC3Hash(int zone_id, const std::string& hash)
     return (result);
 }
 
+int64_t
+SQLite3Accessor::getDataVersion() const {
+    sqlite3_stmt* const stmt = dbparameters_->getStatement(DATA_VERSION);
+    sqlite3_reset(stmt);
+
+    const int rc = sqlite3_step(stmt);
+    int64_t version = -1;
+    if (rc == SQLITE_ROW) {
+        version = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_reset(stmt);
+
+    if (rc != SQLITE_ROW && rc != SQLITE_DONE) {
+        bundy_throw(SQLite3Error, "Could not get data version: " <<
+                    sqlite3_errmsg(dbparameters_->db_));
+    }
+    // SQLITE_DONE means the library doesn't know the pragma.
+    return (version);
+}
+
 } // end of namespace datasrc
 } // end of namespace bundy
@@ -104,6 +104,33 @@ public:
     /// same file name specified in the constructor of the original accessor.
     virtual boost::shared_ptr<DatabaseAccessor> clone();
 
+    /// \brief Set the number of rows written at once in zone updates.
+    ///
+    /// Records (and diffs) added in an update are not inserted one by one,
+    /// but kept until there are this many of them and then written by a
+    /// single INSERT statement.  Pending rows are also written before they
+    /// could be needed, i.e., before reading from the database, deleting
+    /// records, and on commit.  As a result, an error in adding a record
+    /// may only be reported by a later call.
+    ///
+    /// The size is capped by the number of parameters an SQLite3 statement
+    /// can have.  A value of 0 or 1 makes each record written immediately.
+    /// The default is 100.  The setting is inherited by clones.
+    void setUpdateBatchSize(size_t rows);
+
+    /// \brief Build the indexes only at the end of replacing a zone.
+    ///
+    /// If enabled, \c startUpdateZone() with \c replace being true drops
+    /// the indexes of the record tables in its transaction, and
+    /// \c commit() recreates them.  This makes loading a large zone
+    /// significantly faster, but lookups through the updating accessor
+    /// (such as those of the updater's finder) are slow until the commit,
+    /// and recreating the indexes takes time proportional to the data of
+    /// all zones in the database.  So it's only useful for databases that
+    /// consist of a few large zones.  It's disabled by default; the setting
+    /// is inherited by clones.
+    void setDeferIndexesOnReplace(bool defer);
+
     /// \brief Look up a zone
     ///
     /// This implements the getZone from DatabaseAccessor and looks up a zone
@@ -255,6 +282,14 @@ public:
     virtual std::string findPreviousNSEC3Hash(int zone_id,
                                               const std::string& hash) const;
 
+    /// The SQLite3 implementation returns the value of the "data_version"
+    /// pragma, which changes whenever another connection commits changes
+    /// to the database file.  It returns -1 if the SQLite3 library is too
+    /// old to support the pragma.
+    ///
+    /// \throw SQLite3Error if the pragma fails.
+    virtual int64_t getDataVersion() const;
+
 private:
     /// \brief Private database data
     boost::scoped_ptr<SQLite3Parameters> dbparameters_;
@@ -281,7 +316,12 @@ private:
 /// \brief Creates an instance of the SQlite3 datasource client
 ///
 /// Currently the configuration passed here must be a MapElement, containing
-/// one item called "database_file", whose value is a string
+/// one item called "database_file", whose value is a string.  It can
+/// optionally contain "lookup_cache_size", the number of names whose lookup
+/// results are cached in the client (0, the default, disables the cache),
+/// "update_batch_size" and "defer_indexes", see
+/// \c SQLite3Accessor::setUpdateBatchSize() and
+/// \c SQLite3Accessor::setDeferIndexesOnReplace().
 ///
 /// This configuration setup is currently under discussion and will change in
 /// the near future.
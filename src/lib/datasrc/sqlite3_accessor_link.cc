@@ -33,6 +33,13 @@ namespace datasrc {
 namespace {
 
 const char* const CONFIG_ITEM_DATABASE_FILE = "database_file";
+const char* const CONFIG_ITEM_LOOKUP_CACHE_SIZE = "lookup_cache_size";
+const char* const CONFIG_ITEM_UPDATE_BATCH_SIZE = "update_batch_size";
+const char* const CONFIG_ITEM_DEFER_INDEXES = "defer_indexes";
+
+// The number of names whose lookup results are cached unless configured
+// otherwise.  The cache is opt-in.
+const size_t DEFAULT_LOOKUP_CACHE_SIZE = 0;
 
 void
 addError(ElementPtr errors, const std::string& error) {
@@ -41,6 +48,29 @@ addError(ElementPtr errors, const std::string& error) {
     }
 }
 
+// Check an optional item of the given type.  Integers must not be negative.
+bool
+checkOptionalItem(ConstElementPtr config, const char* item,
+                  Element::types type, ElementPtr errors)
+{
+    if (!config->contains(item)) {
+        return (true);
+    }
+    ConstElementPtr value = config->get(item);
+    if (!value || value->getType() != type) {
+        addError(errors, "value of " + string(item) +
+                 " in SQLite3 backend is not a" +
+                 (type == Element::integer ? "n integer" : " boolean"));
+        return (false);
+    }
+    if (type == Element::integer && value->intValue() < 0) {
+        addError(errors, "value of " + string(item) +
+                 " in SQLite3 backend is negative");
+        return (false);
+    }
+    return (true);
+}
+
 bool
 checkConfig(ConstElementPtr config, ElementPtr errors) {
     /* Specific configuration is under discussion, right now this accepts
@@ -70,6 +100,18 @@ checkConfig(ConstElementPtr config, ElementPtr errors) {
                      " in SQLite3 backend is empty");
             result = false;
         }
+        if (!checkOptionalItem(config, CONFIG_ITEM_LOOKUP_CACHE_SIZE,
+                               Element::integer, errors)) {
+            result = false;
+        }
+        if (!checkOptionalItem(config, CONFIG_ITEM_UPDATE_BATCH_SIZE,
+                               Element::integer, errors)) {
+            result = false;
+        }
+        if (!checkOptionalItem(config, CONFIG_ITEM_DEFER_INDEXES,
+                               Element::boolean, errors)) {
+            result = false;
+        }
     }
 
     return (result);
@@ -91,11 +133,23 @@ createInstance(const std::string& datasrc_name,
     }
     const std::string dbfile =
         config->get(CONFIG_ITEM_DATABASE_FILE)->stringValue();
+    const size_t lookup_cache_size =
+        config->contains(CONFIG_ITEM_LOOKUP_CACHE_SIZE) ?
+        config->get(CONFIG_ITEM_LOOKUP_CACHE_SIZE)->intValue() :
+        DEFAULT_LOOKUP_CACHE_SIZE;
     try {
-        boost::shared_ptr<DatabaseAccessor> sqlite3_accessor(
+        boost::shared_ptr<SQLite3Accessor> sqlite3_accessor(
             new SQLite3Accessor(dbfile, "IN")); // XXX: avoid hardcode RR class
+        if (config->contains(CONFIG_ITEM_UPDATE_BATCH_SIZE)) {
+            sqlite3_accessor->setUpdateBatchSize(
+                config->get(CONFIG_ITEM_UPDATE_BATCH_SIZE)->intValue());
+        }
+        if (config->contains(CONFIG_ITEM_DEFER_INDEXES)) {
+            sqlite3_accessor->setDeferIndexesOnReplace(
+                config->get(CONFIG_ITEM_DEFER_INDEXES)->boolValue());
+        }
         return (new DatabaseClient(datasrc_name, bundy::dns::RRClass::IN(),
-                                   sqlite3_accessor));
+                                   sqlite3_accessor, lookup_cache_size));
     } catch (const std::exception& exc) {
         error = std::string("Error creating SQLite3 datasource: ") +
             exc.what();
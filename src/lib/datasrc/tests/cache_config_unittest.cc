@@ -309,4 +309,111 @@ TEST_F(CacheConfigTest, getSegmentType) {
                  bundy::data::TypeError);
 }
 
+TEST_F(CacheConfigTest, getLoadThreads) {
+    // Default value
+    EXPECT_EQ(1, CacheConfig("MasterFiles", 0,
+                             *master_config_, true).getLoadThreads());
+
+    // If we explicitly configure it, that value should be used.
+    ConstElementPtr config(Element::fromJSON("{\"cache-enable\": true,"
+                                             " \"cache-load-threads\": 4,"
+                                             " \"params\": {}}" ));
+    EXPECT_EQ(4, CacheConfig("MasterFiles", 0, *config,
+                             true).getLoadThreads());
+
+    // Non positive values are rejected
+    ConstElementPtr zeroconfig(Element::fromJSON(
+                                   "{\"cache-enable\": true,"
+                                   " \"cache-load-threads\": 0,"
+                                   " \"params\": {}}"));
+    EXPECT_THROW(CacheConfig("MasterFiles", 0, *zeroconfig, true),
+                 CacheConfigError);
+
+    // Wrong types: should be rejected at construction time
+    ConstElementPtr badconfig(Element::fromJSON(
+                                  "{\"cache-enable\": true,"
+                                  " \"cache-load-threads\": \"2\","
+                                  " \"params\": {}}"));
+    EXPECT_THROW(CacheConfig("MasterFiles", 0, *badconfig, true),
+                 bundy::data::TypeError);
+}
+
+TEST_F(CacheConfigTest, useHugePages) {
+    // Default value
+    EXPECT_FALSE(CacheConfig("MasterFiles", 0,
+                             *master_config_, true).useHugePages());
+
+    // If we explicitly configure it, that value should be used.
+    ConstElementPtr config(Element::fromJSON("{\"cache-enable\": true,"
+                                             " \"cache-huge-pages\": true,"
+                                             " \"params\": {}}" ));
+    EXPECT_TRUE(CacheConfig("MasterFiles", 0, *config,
+                            true).useHugePages());
+
+    // Wrong types: should be rejected at construction time
+    ConstElementPtr badconfig(Element::fromJSON(
+                                  "{\"cache-enable\": true,"
+                                  " \"cache-huge-pages\": 1,"
+                                  " \"params\": {}}"));
+    EXPECT_THROW(CacheConfig("MasterFiles", 0, *badconfig, true),
+                 bundy::data::TypeError);
+}
+
+TEST_F(CacheConfigTest, loadOnDemand) {
+    // Default values
+    const CacheConfig cache_conf("mock", &mock_client_, *mock_config_, true);
+    EXPECT_FALSE(cache_conf.isLoadOnDemand());
+    EXPECT_EQ(0, cache_conf.getMemoryLimit());
+    EXPECT_TRUE(cache_conf.isCachedZone(Name(".")));
+    EXPECT_FALSE(cache_conf.isCachedZone(Name("example.org")));
+
+    // If we explicitly configure them, these values should be used.
+    ConstElementPtr config(Element::fromJSON(
+                               "{\"cache-enable\": true,"
+                               " \"cache-load-on-demand\": true,"
+                               " \"cache-memory-limit\": 65536,"
+                               " \"cache-zones\": [\"example.org\"]}"));
+    const CacheConfig cache_conf2("mock", &mock_client_, *config, true);
+    EXPECT_TRUE(cache_conf2.isLoadOnDemand());
+    EXPECT_EQ(65536, cache_conf2.getMemoryLimit());
+    EXPECT_TRUE(cache_conf2.isCachedZone(Name("example.org")));
+    EXPECT_FALSE(cache_conf2.isCachedZone(Name("www.example.org")));
+
+    // Nothing is loaded on demand if the cache is disabled
+    EXPECT_FALSE(CacheConfig("mock", &mock_client_, *config,
+                             false).isLoadOnDemand());
+
+    // MasterFiles zones can't be loaded on demand, as there's nothing to
+    // serve them from until then.
+    EXPECT_THROW(CacheConfig("MasterFiles", 0,
+                             *Element::fromJSON(
+                                 "{\"cache-enable\": true,"
+                                 " \"cache-load-on-demand\": true,"
+                                 " \"params\": {}}"), true),
+                 CacheConfigError);
+
+    // Nor can zones be loaded into a mapped segment
+    EXPECT_THROW(CacheConfig("mock", &mock_client_,
+                             *Element::fromJSON(
+                                 "{\"cache-enable\": true,"
+                                 " \"cache-load-on-demand\": true,"
+                                 " \"cache-type\": \"mapped\","
+                                 " \"cache-zones\": []}"), true),
+                 CacheConfigError);
+
+    // Bad limits and wrong types are rejected
+    EXPECT_THROW(CacheConfig("mock", &mock_client_,
+                             *Element::fromJSON(
+                                 "{\"cache-enable\": true,"
+                                 " \"cache-memory-limit\": -1,"
+                                 " \"cache-zones\": []}"), true),
+                 CacheConfigError);
+    EXPECT_THROW(CacheConfig("mock", &mock_client_,
+                             *Element::fromJSON(
+                                 "{\"cache-enable\": true,"
+                                 " \"cache-load-on-demand\": \"yes\","
+                                 " \"cache-zones\": []}"), true),
+                 bundy::data::TypeError);
+}
+
 }
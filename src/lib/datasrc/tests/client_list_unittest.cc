@@ -19,6 +19,7 @@
 #include <datasrc/factory.h>
 #include <datasrc/cache_config.h>
 #include <datasrc/zone_iterator.h>
+#include <datasrc/zone_loader.h>
 #include <datasrc/exceptions.h>
 #include <datasrc/memory/memory_client.h>
 #include <datasrc/memory/zone_table_segment.h>
@@ -34,11 +35,16 @@
 #include <gtest/gtest.h>
 
 #include <boost/format.hpp>
+#include <boost/lexical_cast.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/interprocess/file_mapping.hpp>
 
 #include <set>
 #include <fstream>
+#include <cstdio>
+#include <ctime>
+
+#include <utime.h>
 
 using namespace bundy::datasrc;
 using bundy::datasrc::unittest::MockDataSourceClient;
@@ -825,6 +831,140 @@ TEST_P(ListTest, cacheZones) {
     EXPECT_TRUE(negative_result_ == list_->find(Name("example.cz.")));
 }
 
+// Zones are loaded into the cache only once they are used, and the least
+// recently used ones are removed from the cache when it's over the memory
+// limit.
+TEST_P(ListTest, cacheZonesOnDemand) {
+    const ConstElementPtr elem(Element::fromJSON("["
+        "{"
+        "   \"type\": \"type1\","
+        "   \"cache-enable\": true,"
+        "   \"cache-load-on-demand\": true,"
+        "   \"cache-zones\": [\"example.org\", \"example.com\"],"
+        "   \"params\": [\"example.org\", \"example.com\", \"example.cz\"]"
+        "}]"));
+    list_->configure(elem, true);
+    const ConfigurableClientList::DataSourceInfo& info =
+        list_->getDataSources()[0];
+    EXPECT_EQ(0, info.cache_->getZoneCount());
+
+    // Before loading, the zone is served from the data source itself.
+    const ClientList::FindResult result1(list_->find(Name("www.example.org")));
+    ASSERT_TRUE(result1.finder_);
+    EXPECT_EQ(Name("example.org"), result1.finder_->getOrigin());
+    EXPECT_FALSE(result1.exact_match_);
+    EXPECT_EQ(info.data_src_client_, result1.dsrc_client_);
+    EXPECT_TRUE(result1.life_keeper_);
+    // The ones not to be cached are ignored, as with the normal cache.
+    EXPECT_TRUE(negative_result_ == list_->find(Name("example.cz.")));
+
+    ConfigurableClientList::OnDemandStats stats = list_->getOnDemandStats();
+    EXPECT_EQ(0, stats.hits);
+    EXPECT_EQ(1, stats.misses);
+    EXPECT_EQ(0, stats.loads);
+
+    // Load the used zone.  From now on it's answered from the cache.
+    EXPECT_EQ(1, list_->loadZonesOnDemand());
+    EXPECT_EQ(1, info.cache_->getZoneCount());
+    positiveResult(list_->find(Name("www.example.org.")), ds_[0],
+                   Name("example.org."), false, "org", true);
+    stats = list_->getOnDemandStats();
+    EXPECT_EQ(1, stats.hits);
+    EXPECT_EQ(1, stats.misses);
+    EXPECT_EQ(1, stats.loads);
+    EXPECT_EQ(0, stats.evictions);
+    EXPECT_LE(0, stats.load_time);
+    EXPECT_LT(0, stats.memory);
+    // Nothing more to load
+    EXPECT_EQ(0, list_->loadZonesOnDemand());
+
+    // The other zone is still served from the data source, until loaded
+    EXPECT_EQ(info.data_src_client_,
+              list_->find(Name("example.com")).dsrc_client_);
+    EXPECT_EQ(1, list_->loadZonesOnDemand());
+    positiveResult(list_->find(Name("example.com.")), ds_[0],
+                   Name("example.com."), true, "com", true);
+    EXPECT_EQ(2, info.cache_->getZoneCount());
+
+    // Reconfigure with a memory limit for about two zones of the same size,
+    // and use three zones.  The least recently used one is removed on
+    // loading the third one.
+    const size_t zone_size = stats.memory;
+    const ConstElementPtr elem_limited(Element::fromJSON("["
+        "{"
+        "   \"type\": \"type1\","
+        "   \"cache-enable\": true,"
+        "   \"cache-load-on-demand\": true,"
+        "   \"cache-memory-limit\": " +
+        boost::lexical_cast<string>(zone_size * 5 / 2) + ","
+        "   \"cache-zones\": [\"example.org\", \"example.com\","
+        "                     \"example.net\"],"
+        "   \"params\": [\"example.org\", \"example.com\", \"example.net\"]"
+        "}]"));
+    list_->configure(elem_limited, true);
+    const ConfigurableClientList::DataSourceInfo& info2 =
+        list_->getDataSources()[0];
+    EXPECT_EQ(0, list_->getOnDemandStats().loads);
+    list_->find(Name("example.org"));
+    list_->find(Name("example.com"));
+    EXPECT_EQ(2, list_->loadZonesOnDemand());
+    // Use example.org, so example.com is the least recently used one.
+    positiveResult(list_->find(Name("example.org.")), ds_[0],
+                   Name("example.org."), true, "org", true);
+    list_->find(Name("example.net"));
+    EXPECT_EQ(1, list_->loadZonesOnDemand());
+    stats = list_->getOnDemandStats();
+    EXPECT_EQ(3, stats.loads);
+    EXPECT_EQ(1, stats.evictions);
+    EXPECT_GE(zone_size * 5 / 2, stats.memory);
+    EXPECT_EQ(2, info2.cache_->getZoneCount());
+    EXPECT_EQ(result::NOTFOUND,
+              info2.cache_->findZone(Name("example.com")).code);
+    positiveResult(list_->find(Name("example.org.")), ds_[0],
+                   Name("example.org."), true, "org", true);
+    positiveResult(list_->find(Name("example.net.")), ds_[0],
+                   Name("example.net."), true, "net", true);
+    // The removed one is served from the data source and loaded again.
+    EXPECT_EQ(info2.data_src_client_,
+              list_->find(Name("example.com")).dsrc_client_);
+    EXPECT_EQ(1, list_->loadZonesOnDemand());
+    positiveResult(list_->find(Name("example.com.")), ds_[0],
+                   Name("example.com."), true, "com", true);
+    EXPECT_EQ(2, list_->getOnDemandStats().evictions);
+}
+
+// A zone to be cached that's a subdomain of a loaded one is still found
+// (and loaded) on demand.
+TEST_P(ListTest, cacheNestedZonesOnDemand) {
+    const ConstElementPtr elem(Element::fromJSON("["
+        "{"
+        "   \"type\": \"type1\","
+        "   \"cache-enable\": true,"
+        "   \"cache-load-on-demand\": true,"
+        "   \"cache-zones\": [\"example.org\", \"sub.example.org\"],"
+        "   \"params\": [\"example.org\", \"sub.example.org\"]"
+        "}]"));
+    list_->configure(elem, true);
+    const ConfigurableClientList::DataSourceInfo& info =
+        list_->getDataSources()[0];
+
+    // (The mock data source only finds the zone for names sorting between
+    // it and the next zone)
+    list_->find(Name("a.example.org"));
+    EXPECT_EQ(1, list_->loadZonesOnDemand());
+    positiveResult(list_->find(Name("a.example.org.")), ds_[0],
+                   Name("example.org."), false, "org", true);
+
+    const ClientList::FindResult result(
+        list_->find(Name("www.sub.example.org")));
+    ASSERT_TRUE(result.finder_);
+    EXPECT_EQ(Name("sub.example.org"), result.finder_->getOrigin());
+    EXPECT_EQ(info.data_src_client_, result.dsrc_client_);
+    EXPECT_EQ(1, list_->loadZonesOnDemand());
+    positiveResult(list_->find(Name("www.sub.example.org.")), ds_[0],
+                   Name("sub.example.org."), false, "sub", true);
+}
+
 // Check the caching handles misbehaviour from the data source and
 // misconfiguration gracefully
 TEST_P(ListTest, badCache) {
@@ -1031,6 +1171,39 @@ TEST_P(ListTest, BadMasterFile) {
     EXPECT_TRUE(list_->find(Name("example.org."), true) == negative_result_);
 }
 
+// Same as above, but the zones are loaded by multiple threads.
+TEST_P(ListTest, parallelLoad) {
+    EXPECT_EQ(ZoneLoader::PROGRESS_UNKNOWN, list_->getLoadProgress());
+
+    const ConstElementPtr elem(Element::fromJSON("["
+        "{"
+        "   \"type\": \"MasterFiles\","
+        "   \"cache-enable\": true,"
+        "   \"cache-load-threads\": 3,"
+        "   \"params\": {"
+        "       \"example.com.\": \"" TEST_DATA_DIR "/example.com.flattened\","
+        "       \"example.net.\": \"" TEST_DATA_DIR "/example.net-empty\","
+        "       \"example.edu.\": \"" TEST_DATA_DIR "/example.edu-broken\","
+        "       \"example.org.\": \"" TEST_DATA_DIR "/example.org\","
+        "       \".\": \"" TEST_DATA_DIR "/root.zone\""
+        "   }"
+        "}]"));
+    EXPECT_NO_THROW(list_->configure(elem, true));
+
+    positiveResult(list_->find(Name("example.com."), true), ds_[0],
+                   Name("example.com."), true, "example.com", true);
+    positiveResult(list_->find(Name("example.org."), true), ds_[0],
+                   Name("example.org."), true, "example.org", true);
+    positiveResult(list_->find(Name(".")), ds_[0], Name("."), true, "root",
+                   true);
+    emptyResult(list_->find(Name("example.net."), true), true, "example.net");
+    emptyResult(list_->find(Name("example.edu."), true), true, "example.edu");
+
+    if (list_->getDataSources()[0].ztable_segment_->isWritable()) {
+        EXPECT_EQ(1.0, list_->getLoadProgress());
+    }
+}
+
 ConfigurableClientList::CacheStatus
 ListTest::doReload(const Name& origin, const string& datasrc_name) {
     ConfigurableClientList::ZoneWriterPair
@@ -1138,6 +1311,247 @@ TEST_P(ListTest, reloadSuccess) {
     EXPECT_EQ(GetParam()->getType(), statii_after[0].getSegmentType());
 }
 
+// Check we can tell whether the cached copy of a zone is the same as the
+// one in the underlying data source.
+TEST_P(ListTest, isCachedZoneUpToDate) {
+    list_->configure(config_elem_zones_, true);
+    const Name name("example.org");
+
+    // Nothing is cached yet.
+    EXPECT_FALSE(list_->isCachedZoneUpToDate(name, "test_type"));
+
+    // The mock data source and the cached copy have the same SOA serial.
+    prepareCache(0, name);
+    EXPECT_TRUE(list_->isCachedZoneUpToDate(name, "test_type"));
+
+    // Zones which are not cached, unknown data sources and zones that are
+    // not in the data source are never considered up to date.
+    EXPECT_FALSE(list_->isCachedZoneUpToDate(Name("example.com"),
+                                             "test_type"));
+    EXPECT_FALSE(list_->isCachedZoneUpToDate(name, "no_such_datasrc"));
+    EXPECT_FALSE(list_->isCachedZoneUpToDate(Name("example.net"),
+                                             "test_type"));
+
+    // MasterFiles with a local segment has no segment file to compare the
+    // master file with.
+    const ConstElementPtr elem(Element::fromJSON("["
+        "{"
+        "   \"type\": \"MasterFiles\","
+        "   \"cache-enable\": true,"
+        "   \"params\": {"
+        "       \".\": \"" TEST_DATA_DIR "/root.zone\""
+        "   }"
+        "}]"));
+    list_->configure(elem, true);
+    EXPECT_FALSE(list_->isCachedZoneUpToDate(Name("."), "MasterFiles"));
+}
+
+// Set the modification time of a file.
+void
+setModificationTime(const std::string& filename, time_t mtime) {
+    struct utimbuf times;
+    times.actime = mtime;
+    times.modtime = mtime;
+    ASSERT_EQ(0, utime(filename.c_str(), &times));
+}
+
+// For MasterFiles, the master file must be older than the mapped segment
+// and have the same serial as the cached zone.
+TEST_P(ListTest,
+#ifdef USE_SHARED_MEMORY
+       isCachedMasterFileUpToDate
+#else
+       DISABLED_isCachedMasterFileUpToDate
+#endif
+    )
+{
+    const std::string zone_file(TEST_DATA_BUILDDIR "/root.zone.uptodate");
+    {
+        std::ifstream in(TEST_DATA_DIR "/root.zone");
+        std::ofstream out(zone_file.c_str());
+        out << in.rdbuf();
+    }
+    setModificationTime(zone_file, time(NULL) - 3600);
+
+    list_->configure(Element::fromJSON("["
+        "{"
+        "   \"type\": \"MasterFiles\","
+        "   \"cache-enable\": true,"
+        "   \"cache-type\": \"mapped\","
+        "   \"params\": {"
+        "       \".\": \"" + zone_file + "\""
+        "   }"
+        "}]"), true);
+    EXPECT_TRUE(list_->resetMemorySegment(
+                    "MasterFiles", ZoneTableSegment::CREATE,
+                    Element::fromJSON("{\"mapped-file\": \"" +
+                                      getMappedFilename(0) + "\"}")));
+    EXPECT_FALSE(list_->isCachedZoneUpToDate(Name("."), "MasterFiles"));
+    EXPECT_EQ(ConfigurableClientList::ZONE_SUCCESS,
+              doReload(Name("."), "MasterFiles"));
+    EXPECT_TRUE(list_->isCachedZoneUpToDate(Name("."), "MasterFiles"));
+
+    // The file has been modified since the segment was written.
+    setModificationTime(zone_file, time(NULL) + 3600);
+    EXPECT_FALSE(list_->isCachedZoneUpToDate(Name("."), "MasterFiles"));
+
+    // An old file with another serial doesn't match either.
+    {
+        std::ofstream out(zone_file.c_str());
+        out << ". 86400 IN SOA a.root-servers.net. "
+            "nstld.verisign-grs.com. 2010030803 1800 900 604800 86400\n";
+    }
+    setModificationTime(zone_file, time(NULL) - 3600);
+    EXPECT_FALSE(list_->isCachedZoneUpToDate(Name("."), "MasterFiles"));
+
+    // Nor does a missing file.
+    std::remove(zone_file.c_str());
+    EXPECT_FALSE(list_->isCachedZoneUpToDate(Name("."), "MasterFiles"));
+
+    // Close the segment (which shrinks the mapped file) before the fixture
+    // removes the file.
+    list_.reset();
+}
+
+// A zone removed from the configuration between two runs is removed from
+// the mapped segment left by the first one.
+TEST_P(ListTest,
+#ifdef USE_SHARED_MEMORY
+       removeUnconfiguredCachedZones
+#else
+       DISABLED_removeUnconfiguredCachedZones
+#endif
+    )
+{
+    const ConstElementPtr params(
+        Element::fromJSON("{\"mapped-file\": \"" + getMappedFilename(0) +
+                          "\"}"));
+
+    // The first run caches two zones.
+    list_->configure(Element::fromJSON("["
+        "{"
+        "   \"type\": \"test_type\","
+        "   \"cache-enable\": true,"
+        "   \"cache-type\": \"mapped\","
+        "   \"cache-zones\": [\"example.org\", \"example.com\"],"
+        "   \"params\": [\"example.org\", \"example.com\"]"
+        "}]"), true);
+    EXPECT_TRUE(list_->resetMemorySegment("test_type",
+                                          ZoneTableSegment::CREATE, params));
+    EXPECT_EQ(ConfigurableClientList::ZONE_SUCCESS,
+              doReload(Name("example.org")));
+    EXPECT_EQ(ConfigurableClientList::ZONE_SUCCESS,
+              doReload(Name("example.com")));
+    EXPECT_EQ(0, list_->removeUnconfiguredCachedZones("test_type"));
+
+    // The next run only caches one of them, but finds both in the segment.
+    list_.reset(new TestedList(rrclass_));
+    list_->configure(Element::fromJSON("["
+        "{"
+        "   \"type\": \"test_type\","
+        "   \"cache-enable\": true,"
+        "   \"cache-type\": \"mapped\","
+        "   \"cache-zones\": [\"example.org\"],"
+        "   \"params\": [\"example.org\", \"example.com\"]"
+        "}]"), true);
+    // Nothing can be done before the segment is writable.
+    EXPECT_EQ(0, list_->removeUnconfiguredCachedZones("test_type"));
+    EXPECT_TRUE(list_->getCachedZoneNames("test_type").empty());
+    EXPECT_TRUE(list_->resetMemorySegment("test_type",
+                                          ZoneTableSegment::READ_WRITE,
+                                          params));
+    const boost::shared_ptr<InMemoryClient> cache(
+        list_->getDataSources()[0].cache_);
+    EXPECT_EQ(2, cache->getZoneCount());
+    EXPECT_EQ(2, list_->getCachedZoneNames("test_type").size());
+
+    EXPECT_EQ(1, list_->removeUnconfiguredCachedZones("test_type"));
+    EXPECT_EQ(1, cache->getZoneCount());
+    const std::vector<Name> names = list_->getCachedZoneNames("test_type");
+    ASSERT_EQ(1, names.size());
+    EXPECT_EQ(Name("example.org"), names[0]);
+    EXPECT_TRUE(list_->getCachedZoneNames("no_such_datasrc").empty());
+    EXPECT_EQ(result::SUCCESS, cache->findZone(Name("example.org")).code);
+    EXPECT_EQ(result::NOTFOUND, cache->findZone(Name("example.com")).code);
+    EXPECT_EQ(0, list_->removeUnconfiguredCachedZones("test_type"));
+    EXPECT_EQ(0, list_->removeUnconfiguredCachedZones("no_such_datasrc"));
+}
+
+TEST_P(ListTest, getCachedZoneMemoryUsage) {
+    const ConstElementPtr elem(Element::fromJSON("["
+        "{"
+        "   \"type\": \"MasterFiles\","
+        "   \"cache-enable\": true,"
+        "   \"params\": {"
+        "       \".\": \"" TEST_DATA_DIR "/root.zone\""
+        "   }"
+        "}]"));
+    list_->configure(elem, true);
+
+    memory::ZoneMemoryUsage usage;
+    EXPECT_TRUE(list_->getCachedZoneMemoryUsage(Name("."), "MasterFiles",
+                                                usage));
+    EXPECT_LT(0, usage.tree_nodes);
+    EXPECT_LT(0, usage.names);
+    EXPECT_LT(0, usage.rdatasets);
+    EXPECT_LT(0, usage.overhead);
+    EXPECT_EQ(usage.tree_nodes + usage.names + usage.rdatasets +
+              usage.nsec3 + usage.overhead, usage.getTotal());
+
+    // Unknown zones and data sources.
+    EXPECT_FALSE(list_->getCachedZoneMemoryUsage(Name("example.org"),
+                                                 "MasterFiles", usage));
+    EXPECT_FALSE(list_->getCachedZoneMemoryUsage(Name("."),
+                                                 "no_such_datasrc", usage));
+
+    // Data source without cache.
+    list_->configure(config_elem_zones_, false);
+    EXPECT_FALSE(list_->getCachedZoneMemoryUsage(Name("example.org"),
+                                                 "test_type", usage));
+}
+
+TEST_P(ListTest, compactMemorySegment) {
+    list_->configure(config_elem_zones_, true);
+    const Name name("example.org");
+    ConfigurableClientList::SegmentSize before, after;
+    const ConstElementPtr params(
+        Element::fromJSON("{\"mapped-file\": \"" + getMappedFilename(1) +
+                          "\"}"));
+
+    // Nothing can be done for unknown data sources
+    EXPECT_FALSE(list_->compactMemorySegment("no_such_datasrc", params,
+                                             before, after));
+
+    prepareCache(0, name);
+    if (GetParam()->getType() == "local") {
+        // A new local segment can't be created this way.
+        EXPECT_THROW(list_->compactMemorySegment("test_type", params,
+                                                 before, after),
+                     bundy::NotImplemented);
+        return;
+    }
+
+    EXPECT_TRUE(list_->compactMemorySegment("test_type", params, before,
+                                            after));
+    EXPECT_LT(0, before.size);
+    EXPECT_GE(before.size, before.free_size);
+    EXPECT_LT(0, after.size);
+    EXPECT_GE(after.size, after.free_size);
+
+    // The zone has been copied from the cache, so it's still the tweaked
+    // version (see the reloadSuccess test) rather than that of the data
+    // source.
+    EXPECT_EQ(ZoneFinder::SUCCESS,
+              list_->find(name).finder_->find(name, RRType::SOA())->code);
+    EXPECT_EQ(ZoneFinder::NXDOMAIN,
+              list_->find(name).finder_->
+                  find(Name("tstzonedata").concatenate(name),
+                       RRType::A())->code);
+
+    // The new segment is writable.
+    EXPECT_EQ(ConfigurableClientList::ZONE_SUCCESS, doReload(name));
+}
+
 // The cache is not enabled. The load should be rejected.
 //
 // FIXME: This test is broken by #2853 and needs to be fixed or
@@ -1251,6 +1665,72 @@ TEST_P(ListTest, reloadNewZone) {
               doReload(Name("example.com")));
 }
 
+// With multiple cached data sources, the results of find() are cached.  They
+// must stay the same as without the cache, also after zones are added.
+TEST_P(ListTest, findCache) {
+    const ConstElementPtr elem(Element::fromJSON("["
+        "{"
+        "   \"type\": \"test_type\","
+        "   \"name\": \"org\","
+        "   \"cache-enable\": true,"
+        "   \"cache-zones\": [\"example.org\"],"
+        "   \"params\": [\"example.org\"]"
+        "},"
+        "{"
+        "   \"type\": \"test_type\","
+        "   \"name\": \"com\","
+        "   \"cache-enable\": true,"
+        "   \"cache-zones\": [\"example.com\", \"sub.example.org\"],"
+        "   \"params\": [\"example.com\"]"
+        "}]"));
+    list_->configure(elem, true);
+    const DataSourceClient* const cache1 =
+        list_->getDataSources()[1].getCacheClient();
+
+    // The second round is answered from the cached results.
+    for (int i = 0; i < 2; ++i) {
+        positiveResult(list_->find(Name("www.sub.example.org")), ds_[0],
+                       Name("example.org"), false, "org", true);
+        positiveResult(list_->find(Name("example.com")), ds_[0],
+                       Name("example.com"), true, "com", true);
+        EXPECT_EQ(cache1, list_->find(Name("example.com")).dsrc_client_);
+        EXPECT_TRUE(negative_result_ == list_->find(Name("example.net")));
+        EXPECT_TRUE(negative_result_ ==
+                    list_->find(Name("www.example.org"), true));
+    }
+
+    // The result is remembered for the whole zone, so other names in it
+    // don't need to be searched for at all if the finder isn't needed.
+    ClientList::FindResult result(list_->find(Name("www.example.com"),
+                                              false, false));
+    EXPECT_EQ(cache1, result.dsrc_client_);
+    EXPECT_FALSE(result.finder_);
+    EXPECT_FALSE(result.exact_match_);
+    positiveResult(list_->find(Name("www.example.com")), ds_[0],
+                   Name("example.com"), false, "com", true);
+    EXPECT_TRUE(negative_result_ ==
+                list_->find(Name("www.example.com"), true, false));
+    // But not for example.org, which may have sub.example.org in the other
+    // data source below it.
+    EXPECT_TRUE(list_->find(Name("www.example.org"), false, false).finder_);
+
+    // A better match is added to the other data source.
+    EXPECT_TRUE(static_cast<MockDataSourceClient*>(
+                    list_->getDataSources()[1].data_src_client_)->
+                insertZone(Name("sub.example.org")));
+    EXPECT_EQ(ConfigurableClientList::ZONE_SUCCESS,
+              doReload(Name("sub.example.org")));
+    positiveResult(list_->find(Name("www.sub.example.org")), ds_[0],
+                   Name("sub.example.org"), false, "sub", true);
+    EXPECT_EQ(cache1,
+              list_->find(Name("www.sub.example.org")).dsrc_client_);
+
+    // Reconfiguration forgets the results for the old data sources.
+    list_->configure(elem, true);
+    EXPECT_EQ(Name("example.org"),
+              list_->find(Name("www.sub.example.org")).finder_->getOrigin());
+}
+
 // The underlying data source throws. Check we don't modify the state.
 TEST_P(ListTest, reloadZoneThrow) {
     list_->configure(config_elem_zones_, true);
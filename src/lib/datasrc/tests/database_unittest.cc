@@ -293,8 +293,10 @@ private:
             if (position_ == domain_.end()) {
                 return (false);
             } else {
+                // The mock data don't have the (optional) wire-format
+                // column; it's left empty.
                 for (size_t i = 0; i < COLUMN_COUNT; ++i) {
-                    columns[i] = (*position_)[i];
+                    columns[i] = i < position_->size() ? (*position_)[i] : "";
                 }
                 ++ position_;
                 return (true);
@@ -357,8 +359,10 @@ private:
             }
 
             if (cur_record_ < cur_name.size()) {
+                const std::vector<std::string>& record =
+                    cur_name[cur_record_];
                 for (size_t i = 0; i < COLUMN_COUNT; ++i) {
-                    columns[i] = cur_name[cur_record_][i];
+                    columns[i] = i < record.size() ? record[i] : "";
                 }
                 cur_record_++;
                 return (true);
@@ -939,6 +943,21 @@ public:
             (*readonly_records_)[param.back()].push_back(param);
         }
     }
+
+    // Add an A RR of the given name with both the text and the wire-format
+    // rdata, so tests can check which one is used.
+    void addWireFormatRecord(const string& name, const string& rdata,
+                             const string& rdata_wire)
+    {
+        vector<string> record;
+        record.push_back("A");        // RRtype
+        record.push_back("3600");     // TTL
+        record.push_back("");         // sigtype, unused
+        record.push_back(rdata);      // RDATA
+        record.push_back(name);       // owner name
+        record.push_back(rdata_wire); // wire-format RDATA
+        (*readonly_records_)[name].push_back(record);
+    }
 };
 }
 
@@ -4136,6 +4155,129 @@ TEST_F(MockDatabaseClientTest, journalWithBadData) {
                  second->getNextDiff(), DataSourceError);
 }
 
+// If the accessor provides the wire-format rdata, it's used instead of the
+// text.  Works for the mock accessor only.
+TEST_F(MockDatabaseClientTest, findWireFormatRdata) {
+    MockAccessor& mock_accessor =
+        dynamic_cast<MockAccessor&>(*current_accessor_);
+
+    // The text can't be parsed, so the lookup only succeeds if the wire
+    // form is used.
+    const char wire[] = { '\xc0', '\x00', '\x02', '\x64' }; // 192.0.2.100
+    mock_accessor.addWireFormatRecord("wire.example.org.", "bad rdata",
+                                      string(wire, sizeof(wire)));
+    const ConstRRsetPtr rrset =
+        getFinder()->find(Name("wire.example.org"), RRType::A())->rrset;
+    ASSERT_TRUE(rrset);
+    ASSERT_EQ(1, rrset->getRdataCount());
+    EXPECT_EQ("192.0.2.100", rrset->getRdataIterator()->getCurrent().toText());
+
+    // Broken wire-format data is reported as a data source error, the same
+    // way as broken text.
+    mock_accessor.addWireFormatRecord("badwire.example.org.", "192.0.2.1",
+                                      string(wire, 3));
+    EXPECT_THROW(getFinder()->find(Name("badwire.example.org"), RRType::A()),
+                 DataSourceError);
+}
+
+// A mock accessor that counts lookups by name and reports a data version
+// controlled by the test, so the lookup cache can be used with it.
+class LookupCountingAccessor : public MockAccessor {
+public:
+    LookupCountingAccessor() :
+        lookup_count_(0), version_count_(0), data_version_(0)
+    {}
+    virtual IteratorContextPtr getRecords(const std::string& name, int id,
+                                          bool subdomains) const
+    {
+        ++lookup_count_;
+        return (MockAccessor::getRecords(name, id, subdomains));
+    }
+    virtual int64_t getDataVersion() const {
+        ++version_count_;
+        return (data_version_);
+    }
+
+    mutable size_t lookup_count_;
+    mutable size_t version_count_;
+    int64_t data_version_;
+};
+
+// Repeated lookups are served from the lookup cache as long as the data
+// version doesn't change.  Works for the mock accessor only.
+TEST_F(MockDatabaseClientTest, lookupCache) {
+    boost::shared_ptr<LookupCountingAccessor> accessor(
+        new LookupCountingAccessor);
+    DatabaseClient client("dbtest", qclass_, accessor, 100);
+    const ZoneFinderPtr finder = client.findZone(zname_).zone_finder;
+    const Name nxname("nosuchname.example.org");
+
+    EXPECT_EQ(ZoneFinder::SUCCESS, finder->find(qname_, qtype_)->code);
+    EXPECT_EQ(ZoneFinder::NXDOMAIN, finder->find(nxname, qtype_)->code);
+    size_t count = accessor->lookup_count_;
+    EXPECT_LT(0, count);
+    EXPECT_EQ(ZoneFinder::SUCCESS, finder->find(qname_, qtype_)->code);
+    EXPECT_EQ(ZoneFinder::NXDOMAIN, finder->find(nxname, qtype_)->code);
+    EXPECT_EQ(count, accessor->lookup_count_);
+
+    // The data version is checked once per findZone(), not on every find.
+    EXPECT_EQ(1, accessor->version_count_);
+
+    // Another finder of the same client shares the cache.
+    EXPECT_EQ(ZoneFinder::SUCCESS, client.findZone(zname_).zone_finder->
+              find(qname_, qtype_)->code);
+    EXPECT_EQ(count, accessor->lookup_count_);
+
+    // A new data version invalidates everything, once it's noticed by
+    // the next findZone().
+    accessor->data_version_ = 1;
+    EXPECT_EQ(ZoneFinder::SUCCESS, finder->find(qname_, qtype_)->code);
+    EXPECT_EQ(count, accessor->lookup_count_);
+    EXPECT_EQ(ZoneFinder::SUCCESS, client.findZone(zname_).zone_finder->
+              find(qname_, qtype_)->code);
+    EXPECT_LT(count, accessor->lookup_count_);
+
+    // If the accessor can't tell the version, nothing is cached.
+    accessor->data_version_ = -1;
+    const ZoneFinderPtr uncached_finder = client.findZone(zname_).zone_finder;
+    EXPECT_EQ(ZoneFinder::SUCCESS, uncached_finder->find(qname_, qtype_)->code);
+    count = accessor->lookup_count_;
+    EXPECT_EQ(ZoneFinder::SUCCESS, uncached_finder->find(qname_, qtype_)->code);
+    EXPECT_LT(count, accessor->lookup_count_);
+
+    // A tiny cache constantly evicts entries, but the results are the same.
+    DatabaseClient small_client("dbtest", qclass_, accessor, 1);
+    accessor->data_version_ = 0;
+    const ZoneFinderPtr small_finder =
+        small_client.findZone(zname_).zone_finder;
+    for (int i = 0; i < 2; ++i) {
+        EXPECT_EQ(ZoneFinder::SUCCESS,
+                  small_finder->find(qname_, qtype_)->code);
+        EXPECT_EQ(ZoneFinder::NXDOMAIN,
+                  small_finder->find(nxname, qtype_)->code);
+        EXPECT_EQ(ZoneFinder::CNAME,
+                  small_finder->find(Name("cname.example.org"),
+                                     qtype_)->code);
+    }
+}
+
+// Updates committed through the client are visible to the finders using
+// the lookup cache.
+TEST_P(DatabaseClientTest, lookupCacheAfterUpdate) {
+    DatabaseClient cached_client("dbtest", qclass_, current_accessor_, 100);
+    const ZoneFinderPtr finder = cached_client.findZone(zname_).zone_finder;
+    EXPECT_EQ(ZoneFinder::SUCCESS, finder->find(qname_, qtype_)->code);
+
+    rrset_.reset(new RRset(qname_, qclass_, qtype_, rrttl_));
+    rrset_->addRdata(rdata::createRdata(rrset_->getType(), rrset_->getClass(),
+                                        "192.0.2.1"));
+    updater_ = cached_client.getUpdater(zname_, false);
+    updater_->deleteRRset(*rrset_);
+    updater_->commit();
+
+    EXPECT_EQ(ZoneFinder::NXRRSET, finder->find(qname_, qtype_)->code);
+}
+
 /// Let us test a little bit of NSEC3.
 TEST_P(DatabaseClientTest, findNSEC3) {
     // Set up the faked hash calculator.
@@ -161,6 +161,47 @@ TEST(FactoryTest, sqlite3ClientBadConfig) {
         bundy::dns::Name("example.org."), false));
 }
 
+TEST(FactoryTest, sqlite3ClientLookupCacheSize) {
+    ElementPtr config = Element::createMap();
+    config->set("database_file", Element::create(SQLITE_DBFILE_EXAMPLE_ORG));
+
+    config->set("lookup_cache_size", Element::create("100"));
+    EXPECT_THROW(DataSourceClientContainer("sqlite3", "sqlite3", config),
+                 DataSourceError);
+
+    config->set("lookup_cache_size", Element::create(-1));
+    EXPECT_THROW(DataSourceClientContainer("sqlite3", "sqlite3", config),
+                 DataSourceError);
+
+    // 0 disables the cache, which is valid.
+    config->set("lookup_cache_size", Element::create(0));
+    EXPECT_NO_THROW(DataSourceClientContainer("sqlite3", "sqlite3", config));
+
+    config->set("lookup_cache_size", Element::create(100));
+    DataSourceClientContainer dsc("sqlite3", "sqlite3", config);
+    EXPECT_EQ(result::SUCCESS, dsc.getInstance().findZone(
+                  bundy::dns::Name("example.org.")).code);
+}
+
+TEST(FactoryTest, sqlite3ClientUpdateOptions) {
+    ElementPtr config = Element::createMap();
+    config->set("database_file", Element::create(SQLITE_DBFILE_EXAMPLE_ORG));
+
+    config->set("update_batch_size", Element::create(true));
+    EXPECT_THROW(DataSourceClientContainer("sqlite3", "sqlite3", config),
+                 DataSourceError);
+    config->set("update_batch_size", Element::create(-1));
+    EXPECT_THROW(DataSourceClientContainer("sqlite3", "sqlite3", config),
+                 DataSourceError);
+    config->set("update_batch_size", Element::create(50));
+
+    config->set("defer_indexes", Element::create(1));
+    EXPECT_THROW(DataSourceClientContainer("sqlite3", "sqlite3", config),
+                 DataSourceError);
+    config->set("defer_indexes", Element::create(true));
+    EXPECT_NO_THROW(DataSourceClientContainer("sqlite3", "sqlite3", config));
+}
+
 TEST(FactoryTest, badType) {
     ASSERT_THROW(DataSourceClientContainer("foo", "foo", ElementPtr()),
                                            DataSourceError);
@@ -280,6 +280,76 @@ TEST_F(DomainTreeTest, checkDistanceSorted) {
     EXPECT_TRUE(mytree.checkProperties());
 }
 
+TEST_F(DomainTreeTest, builderSorted) {
+    // Build a tree of the same names as dtree, in the DNSSEC order, with
+    // DomainTreeBuilder.
+    TreeHolder mytree_holder(mem_sgmt_, TestDomainTree::create(mem_sgmt_));
+    TestDomainTree& mytree = *mytree_holder.get();
+    DomainTreeBuilder<int> builder;
+
+    EXPECT_EQ(TestDomainTree::SUCCESS,
+              builder.insert(mem_sgmt_, mytree, Name("."), &dtnode));
+    for (size_t i = 0; i < ordered_names_count; ++i) {
+        EXPECT_EQ(TestDomainTree::SUCCESS,
+                  builder.insert(mem_sgmt_, mytree, Name(ordered_names[i]),
+                                 &dtnode));
+        EXPECT_EQ(LabelSequence(Name(ordered_names[i])),
+                  dtnode->getAbsoluteLabels(buf));
+        dtnode->setData(new int(i + 1));
+
+        // The last name and its superdomains are already there, including
+        // one in the middle of the labels of a node, which is split.
+        EXPECT_EQ(TestDomainTree::ALREADYEXISTS,
+                  builder.insert(mem_sgmt_, mytree, Name(ordered_names[i]),
+                                 &dtnode));
+        EXPECT_EQ(TestDomainTree::ALREADYEXISTS,
+                  builder.insert(mem_sgmt_, mytree,
+                                 Name(ordered_names[i]).split(1), &dtnode));
+        EXPECT_EQ(LabelSequence(Name(ordered_names[i]).split(1)),
+                  dtnode->getAbsoluteLabels(buf));
+    }
+    builder.finish(mytree);
+
+    EXPECT_TRUE(builder.isSorted());
+    EXPECT_TRUE(mytree.checkProperties());
+    for (size_t i = 0; i < ordered_names_count; ++i) {
+        EXPECT_EQ(TestDomainTree::EXACTMATCH,
+                  mytree.find(Name(ordered_names[i]), &dtnode));
+        EXPECT_EQ(static_cast<int>(i + 1), *dtnode->getData());
+    }
+    // Same as dtree, plus the nodes split by "e.f", "y.d.e.f" and "h".
+    EXPECT_EQ(18, mytree.getNodeCount());
+
+    // Names out of order can still be inserted (in the normal way).
+    EXPECT_EQ(TestDomainTree::SUCCESS,
+              builder.insert(mem_sgmt_, mytree, Name("0"), &dtnode));
+    EXPECT_FALSE(builder.isSorted());
+    EXPECT_EQ(TestDomainTree::SUCCESS,
+              builder.insert(mem_sgmt_, mytree, Name("zz"), &dtnode));
+    EXPECT_TRUE(mytree.checkProperties());
+}
+
+TEST_F(DomainTreeTest, builderBalanced) {
+    // The levels built from sorted names are balanced without rotations:
+    // the height is the minimum possible one.
+    TreeHolder mytree_holder(mem_sgmt_, TestDomainTree::create(mem_sgmt_));
+    TestDomainTree& mytree = *mytree_holder.get();
+    DomainTreeBuilder<int> builder;
+    const int log_num_nodes = 16;
+
+    for (int i = 0; i < (1 << log_num_nodes); i++) {
+        const string namestr(boost::str(boost::format("name%08x.") % i));
+        builder.insert(mem_sgmt_, mytree, Name(namestr), &dtnode);
+        EXPECT_EQ(static_cast<int*>(NULL), dtnode->setData(new int(i + 1)));
+    }
+    builder.finish(mytree);
+
+    // (the names are stored below ".")
+    EXPECT_EQ((1 << log_num_nodes) + 1, mytree.getNodeCount());
+    EXPECT_EQ(log_num_nodes + 1, mytree.getHeight());
+    EXPECT_TRUE(mytree.checkProperties());
+}
+
 TEST_F(DomainTreeTest, setGetData) {
     // set new data to an existing node.  It should have some data.
     int* newdata = new int(11);
@@ -821,6 +891,89 @@ TEST_F(DomainTreeTest, findError) {
                  BadValue);
 }
 
+bool
+countCallback(const TestDomainTreeNode&, int* counter) {
+    ++*counter;
+    return (false);
+}
+
+TEST_F(DomainTreeTest, findBatch) {
+    // Set callback at a node in the middle of the tree.
+    EXPECT_EQ(TestDomainTree::EXACTMATCH, dtree.find(Name("z.d.e.f"),
+                                                     &dtnode));
+    dtnode->setFlag(TestDomainTreeNode::FLAG_CALLBACK);
+
+    // Existent names, empty nodes, names below existent or empty nodes,
+    // and names that share nothing with the tree but the root.
+    std::vector<Name> names;
+    for (int i = 0; i < name_count; ++i) {
+        names.push_back(Name(domain_names[i]));
+    }
+    names.push_back(Name("d.e.f"));
+    names.push_back(Name("m.z.d.e.f"));
+    names.push_back(Name("r.q.w.y.d.e.f"));
+    names.push_back(Name("nosuch.g.h"));
+    names.push_back(Name("nosuch"));
+    names.push_back(Name("."));
+    const size_t count = names.size();
+
+    std::vector<LabelSequence> labels;
+    for (size_t i = 0; i < count; ++i) {
+        labels.push_back(LabelSequence(names[i]));
+    }
+    std::vector<const TestDomainTreeNode*> nodes(count,
+        static_cast<TestDomainTreeNode*>(NULL));
+    std::vector<TestDomainTreeNodeChain> chains(count);
+    std::vector<TestDomainTree::Result> results(count);
+    std::vector<int> counters(count, 0);
+    std::vector<int*> counter_args(count);
+    for (size_t i = 0; i < count; ++i) {
+        counter_args[i] = &counters[i];
+    }
+    dtree.findBatch(count, &labels[0], &nodes[0], &chains[0], &results[0],
+                    countCallback, &counter_args[0]);
+
+    // Each should be the same as that of a separate find().
+    for (size_t i = 0; i < count; ++i) {
+        SCOPED_TRACE(names[i].toText());
+        const TestDomainTreeNode* node = NULL;
+        TestDomainTreeNodeChain chain;
+        int counter = 0;
+        EXPECT_EQ(dtree.find(labels[i], &node, chain, countCallback,
+                             &counter), results[i]);
+        EXPECT_EQ(node, nodes[i]);
+        EXPECT_EQ(counter, counters[i]);
+        EXPECT_EQ(chain.getLevelCount(), chains[i].getLevelCount());
+        EXPECT_EQ(chain.getLastComparedNode(),
+                  chains[i].getLastComparedNode());
+        EXPECT_EQ(chain.getLastComparisonResult().getRelation(),
+                  chains[i].getLastComparisonResult().getRelation());
+    }
+    // Make sure the callback case is really covered.
+    EXPECT_EQ(1, counters[count - 5]);
+
+    // No callback.
+    nodes.assign(count, static_cast<TestDomainTreeNode*>(NULL));
+    std::vector<TestDomainTreeNodeChain> chains2(count);
+    dtree.findBatch<void*>(count, &labels[0], &nodes[0], &chains2[0],
+                           &results[0], NULL, NULL);
+    EXPECT_EQ(TestDomainTree::EXACTMATCH, results[0]);
+    EXPECT_EQ(Name(domain_names[0]), nodes[0]->getName());
+
+    // The chains must be empty, as in find().
+    EXPECT_THROW(dtree.findBatch<void*>(count, &labels[0], &nodes[0],
+                                        &chains2[0], &results[0], NULL,
+                                        NULL),
+                 BadValue);
+    // Label sequences must be absolute.
+    LabelSequence relative(labels[0]);
+    relative.stripRight(1);
+    TestDomainTreeNodeChain chain;
+    EXPECT_THROW(dtree.findBatch<void*>(1, &relative, &nodes[0], &chain,
+                                        &results[0], NULL, NULL),
+                 BadValue);
+}
+
 TEST_F(DomainTreeTest, flags) {
     EXPECT_EQ(TestDomainTree::SUCCESS, dtree.insert(mem_sgmt_,
                                                   Name("flags.example"),
@@ -18,6 +18,7 @@
 
 #include <dns/name.h>
 #include <dns/labelsequence.h>
+#include <dns/master_lexer.h>
 #include <dns/messagerenderer.h>
 #include <dns/rdata.h>
 #include <dns/rdataclass.h>
@@ -36,6 +37,7 @@
 #include <cstring>
 #include <algorithm>
 #include <set>
+#include <sstream>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -463,6 +465,58 @@ public:
     }
 };
 
+// Decode using FastRdataReader, if it supports the type; otherwise
+// fall back to RdataReader (as the real users of FastRdataReader do).
+class FastDecoder {
+public:
+    class Handler {
+    public:
+        Handler(MessageRenderer& renderer, bool additional_required) :
+            renderer_(renderer), additional_required_(additional_required)
+        {}
+        void handleName(const LabelSequence& labels,
+                        RdataNameAttributes attributes)
+        {
+            renderNameField(&renderer_, additional_required_, labels,
+                            attributes);
+        }
+        void handleData(const void* data, size_t data_len) {
+            renderDataField(&renderer_, data, data_len);
+        }
+    private:
+        MessageRenderer& renderer_;
+        const bool additional_required_;
+    };
+
+    static void decode(const bundy::dns::RRClass& rrclass,
+                       const bundy::dns::RRType& rrtype,
+                       size_t rdata_count, size_t sig_count, size_t,
+                       const vector<uint8_t>& encoded_data, size_t,
+                       MessageRenderer& renderer)
+    {
+        Handler handler(renderer, additionalRequired(rrtype));
+        FastRdataReader<Handler> reader(rrclass, rrtype, &encoded_data[0],
+                                        rdata_count, sig_count, handler);
+        if (!reader.isSupported()) {
+            SingleIterateDecoder::decode(rrclass, rrtype, rdata_count,
+                                         sig_count, 0, encoded_data, 0,
+                                         renderer);
+            return;
+        }
+        size_t actual_count = 0;
+        while (reader.iterateRdata()) {
+            ++actual_count;
+        }
+        EXPECT_EQ(rdata_count, actual_count);
+        actual_count = 0;
+        renderer.writeName(dummyName2());
+        while (reader.iterateSingleSig()) {
+            ++actual_count;
+        }
+        EXPECT_EQ(sig_count, actual_count);
+    }
+};
+
 // This one does not adhere to the usual way the reader is used, trying
 // to confuse it. It iterates part of the data manually and then reads
 // the rest through iterate. It also reads the signatures in the middle
@@ -520,6 +574,7 @@ public:
 
 typedef ::testing::Types<ManualDecoderStyle,
                          CallbackDecoder, IterateDecoder, SingleIterateDecoder,
+                         FastDecoder,
                          HybridDecoder<true, true>, HybridDecoder<true, false>,
                          HybridDecoder<false, true>,
                          HybridDecoder<false, false> >
@@ -792,6 +847,251 @@ TYPED_TEST(RdataEncodeDecodeTest, addRdataMulti) {
     this->addRdataMultiCommon(rrsigs, true);
 }
 
+TEST_F(RdataSerializationTest, addDuplicateRdata) {
+    // Duplicate detection ignores case of the domain name in RDATA, whether
+    // the name is at the beginning (NS) or in the middle of the RDATA (MX).
+    encoder_.start(RRClass::IN(), RRType::NS());
+    EXPECT_TRUE(encoder_.addRdata(*createRdata(RRType::NS(), RRClass::IN(),
+                                               "ns.example.")));
+    EXPECT_TRUE(encoder_.addRdata(*createRdata(RRType::NS(), RRClass::IN(),
+                                               "ns.example.org.")));
+    EXPECT_FALSE(encoder_.addRdata(*createRdata(RRType::NS(), RRClass::IN(),
+                                                "NS.EXAMPLE.")));
+
+    encoder_.start(RRClass::IN(), RRType::MX());
+    EXPECT_TRUE(encoder_.addRdata(*createRdata(RRType::MX(), RRClass::IN(),
+                                               "5 mx1.example.com.")));
+    EXPECT_TRUE(encoder_.addRdata(*createRdata(RRType::MX(), RRClass::IN(),
+                                               "10 mx1.example.com.")));
+    EXPECT_FALSE(encoder_.addRdata(*createRdata(RRType::MX(), RRClass::IN(),
+                                                "5 MX1.example.COM.")));
+
+    // But not case of other fields.
+    encoder_.start(RRClass::IN(), RRType::TXT());
+    EXPECT_TRUE(encoder_.addRdata(*createRdata(RRType::TXT(), RRClass::IN(),
+                                               "foo")));
+    EXPECT_TRUE(encoder_.addRdata(*createRdata(RRType::TXT(), RRClass::IN(),
+                                               "FOO")));
+    EXPECT_FALSE(encoder_.addRdata(*createRdata(RRType::TXT(), RRClass::IN(),
+                                                "foo")));
+
+    // Same for the signer's name of RRSIGs.
+    encoder_.start(RRClass::IN(), RRType::A());
+    EXPECT_TRUE(encoder_.addSIGRdata(*rrsig_rdata_));
+    EXPECT_FALSE(encoder_.addSIGRdata(
+                     *createRdata(RRType::RRSIG(), RRClass::IN(),
+                                  "A 5 2 3600 20120814220826 "
+                                  "20120715220826 12345 COM. FAKE")));
+    EXPECT_TRUE(encoder_.addSIGRdata(
+                    *createRdata(RRType::RRSIG(), RRClass::IN(),
+                                 "A 5 2 3600 20120814220826 "
+                                 "20120715220826 12345 com. fake")));
+
+    // Duplicates are only checked within a single session.
+    encoder_.start(RRClass::IN(), RRType::NS());
+    EXPECT_TRUE(encoder_.addRdata(*createRdata(RRType::NS(), RRClass::IN(),
+                                               "ns.example.")));
+}
+
+// Test data for addRdata from text: each RDATA is given in the text for
+// the master lexer and in the form that createRdata() accepts.  The latter
+// is used to build the expected encoded data.
+struct TextTestRdata {
+    const char* const rrclass;
+    const char* const rrtype;
+    const char* const text;     // may contain relative names
+    const char* const rdata;    // the same RDATA, with absolute names
+};
+
+const TextTestRdata text_rdata_list[] = {
+    {"IN", "A", "192.0.2.1", "192.0.2.1"},
+    {"IN", "AAAA", "2001:db8::1", "2001:db8::1"},
+    {"IN", "NS", "ns.example.com.", "ns.example.com."},
+    {"IN", "NS", "ns", "ns.example.org."},
+    {"CH", "NS", "ns.example.com.", "ns.example.com."},
+    {"IN", "CNAME", "cname.example.com.", "cname.example.com."},
+    {"IN", "MX", "10 mx.example.com.", "10 mx.example.com."},
+    {"IN", "MX", "0 @", "0 example.org."},
+    {"IN", "TXT", "foo", "foo"},
+    {"IN", "TXT", "\"foo bar\" baz", "\"foo bar\" baz"},
+    {"IN", "TXT", "\"\"", "\"\""},
+    {NULL, NULL, NULL, NULL}
+};
+
+TEST_F(RdataSerializationTest, addRdataFromText) {
+    const Name origin("example.org");
+    vector<uint8_t> expected_data;
+    for (size_t i = 0; text_rdata_list[i].rrclass != NULL; ++i) {
+        SCOPED_TRACE(string(text_rdata_list[i].rrtype) + " " +
+                     text_rdata_list[i].text);
+        const RRClass rrclass(text_rdata_list[i].rrclass);
+        const RRType rrtype(text_rdata_list[i].rrtype);
+        EXPECT_TRUE(RdataEncoder::isTextSupported(rrclass, rrtype));
+
+        encoder_.start(rrclass, rrtype);
+        encoder_.addRdata(*createRdata(rrtype, rrclass,
+                                       text_rdata_list[i].rdata));
+        encodeWrapper(encoder_.getStorageLength());
+        expected_data = encoded_data_;
+
+        // The RDATA must be followed by an end of line, which is left in
+        // the lexer.
+        std::stringstream ss(string(text_rdata_list[i].text) + "\n");
+        MasterLexer lexer;
+        lexer.pushSource(ss);
+        encoder_.start(rrclass, rrtype);
+        EXPECT_TRUE(encoder_.addRdata(lexer, &origin));
+        EXPECT_EQ(MasterToken::END_OF_LINE, lexer.getNextToken().getType());
+        encodeWrapper(encoder_.getStorageLength());
+        matchWireData(&expected_data[0], expected_data.size(),
+                      &encoded_data_[0], encoded_data_.size());
+    }
+
+    // Multiple RDATAs, with a duplicate (which is ignored) and the end of
+    // file instead of a line.  Names are kept as given, while duplicates
+    // are detected case-insensitively.
+    encoder_.start(RRClass::IN(), RRType::MX());
+    encoder_.addRdata(*createRdata(RRType::MX(), RRClass::IN(),
+                                   "10 mx1.example.org."));
+    encoder_.addRdata(*createRdata(RRType::MX(), RRClass::IN(),
+                                   "20 MX2.example.org."));
+    encodeWrapper(encoder_.getStorageLength());
+    expected_data = encoded_data_;
+
+    std::stringstream ss("10 mx1\n20 MX2.example.org.\n10 MX1.example.org.");
+    MasterLexer lexer;
+    lexer.pushSource(ss);
+    encoder_.start(RRClass::IN(), RRType::MX());
+    EXPECT_TRUE(encoder_.addRdata(lexer, &origin));
+    EXPECT_EQ(MasterToken::END_OF_LINE, lexer.getNextToken().getType());
+    EXPECT_TRUE(encoder_.addRdata(lexer, &origin));
+    EXPECT_EQ(MasterToken::END_OF_LINE, lexer.getNextToken().getType());
+    EXPECT_FALSE(encoder_.addRdata(lexer, &origin));
+    EXPECT_EQ(MasterToken::END_OF_FILE, lexer.getNextToken().getType());
+    encodeWrapper(encoder_.getStorageLength());
+    matchWireData(&expected_data[0], expected_data.size(),
+                  &encoded_data_[0], encoded_data_.size());
+
+    // Text and Rdata can be mixed in a session, and duplicates are detected
+    // across them.
+    std::stringstream ss2("192.0.2.1\n192.0.2.53\n");
+    MasterLexer lexer2;
+    lexer2.pushSource(ss2);
+    encoder_.start(RRClass::IN(), RRType::A());
+    EXPECT_TRUE(encoder_.addRdata(*a_rdata_));
+    EXPECT_TRUE(encoder_.addRdata(lexer2, NULL));
+    lexer2.getNextToken();
+    EXPECT_FALSE(encoder_.addRdata(lexer2, NULL));
+    EXPECT_FALSE(encoder_.addRdata(*createRdata(RRType::A(), RRClass::IN(),
+                                                "192.0.2.1")));
+    EXPECT_EQ(8, encoder_.getStorageLength());
+}
+
+TEST_F(RdataSerializationTest, badAddRdataFromText) {
+    const Name origin("example.org");
+    std::stringstream ss("192.0.2.1\n");
+    MasterLexer lexer;
+    lexer.pushSource(ss);
+
+    // It must follow start().
+    EXPECT_THROW(encoder_.addRdata(lexer, &origin), bundy::InvalidOperation);
+
+    // Unsupported types.
+    EXPECT_FALSE(RdataEncoder::isTextSupported(RRClass::CH(), RRType::A()));
+    EXPECT_FALSE(RdataEncoder::isTextSupported(RRClass::IN(), RRType::SOA()));
+    EXPECT_FALSE(RdataEncoder::isTextSupported(RRClass::IN(), RRType::DS()));
+    EXPECT_FALSE(RdataEncoder::isTextSupported(RRClass::IN(),
+                                               RRType::RRSIG()));
+    encoder_.start(RRClass::CH(), RRType::A());
+    EXPECT_THROW(encoder_.addRdata(lexer, &origin), bundy::BadValue);
+    encoder_.start(RRClass::IN(), RRType::SRV());
+    EXPECT_THROW(encoder_.addRdata(lexer, &origin), bundy::BadValue);
+
+    // Bad text.  The session can continue after the failure, and the bad
+    // RDATA is not added.
+    const char* const bad_texts[][2] = {
+        {"A", "192.0.2"},
+        {"A", "2001:db8::1"},
+        {"A", "192.0.2.1 192.0.2.2"}, // extra input
+        {"AAAA", "192.0.2.1"},
+        {"NS", "ns.example.org. extra"},
+        {"NS", "bad..name"},
+        {"MX", "65536 mx.example.org."},
+        {"MX", "mx.example.org."},
+        {"MX", "10"},
+        {"TXT", ""},
+        {"TXT", "\"unterminated"},
+        {NULL, NULL}
+    };
+    for (size_t i = 0; bad_texts[i][0] != NULL; ++i) {
+        SCOPED_TRACE(string(bad_texts[i][0]) + " " + bad_texts[i][1]);
+        const RRType rrtype(bad_texts[i][0]);
+        std::stringstream bad_ss(string(bad_texts[i][1]) + "\n");
+        MasterLexer bad_lexer;
+        bad_lexer.pushSource(bad_ss);
+        encoder_.start(RRClass::IN(), rrtype);
+        EXPECT_THROW(encoder_.addRdata(bad_lexer, &origin), bundy::Exception);
+        EXPECT_EQ(0, encoder_.getStorageLength());
+    }
+    std::stringstream extra_ss("192.0.2.1 192.0.2.2\n192.0.2.1\n");
+    MasterLexer extra_lexer;
+    extra_lexer.pushSource(extra_ss);
+    encoder_.start(RRClass::IN(), RRType::A());
+    EXPECT_THROW(encoder_.addRdata(extra_lexer, &origin),
+                 InvalidRdataText);
+    extra_lexer.getNextToken();  // skip the extra token
+    EXPECT_EQ(MasterToken::END_OF_LINE,
+              extra_lexer.getNextToken().getType());
+    EXPECT_TRUE(encoder_.addRdata(extra_lexer, &origin));
+    EXPECT_EQ(4, encoder_.getStorageLength());
+
+    // Relative names need the origin.
+    std::stringstream rel_ss("ns\n");
+    MasterLexer rel_lexer;
+    rel_lexer.pushSource(rel_ss);
+    encoder_.start(RRClass::IN(), RRType::NS());
+    EXPECT_THROW(encoder_.addRdata(rel_lexer, NULL), bundy::Exception);
+}
+
+TEST_F(RdataSerializationTest, fastReaderSupportedTypes) {
+    RdataNameAttributes attributes;
+    EXPECT_EQ(RDATA_LAYOUT_IPV4,
+              getRdataLayout(RRClass::IN(), RRType::A(), &attributes));
+    EXPECT_EQ(RDATA_LAYOUT_IPV6,
+              getRdataLayout(RRClass::IN(), RRType::AAAA(), &attributes));
+    EXPECT_EQ(RDATA_LAYOUT_SOA,
+              getRdataLayout(RRClass::IN(), RRType::SOA(), &attributes));
+    EXPECT_EQ(RDATA_LAYOUT_NAME,
+              getRdataLayout(RRClass::IN(), RRType::NS(), &attributes));
+    EXPECT_NE(0, attributes & NAMEATTR_ADDITIONAL);
+    EXPECT_EQ(RDATA_LAYOUT_NAME,
+              getRdataLayout(RRClass::IN(), RRType::CNAME(), &attributes));
+    EXPECT_EQ(NAMEATTR_COMPRESSIBLE, attributes);
+    EXPECT_EQ(RDATA_LAYOUT_MX,
+              getRdataLayout(RRClass::IN(), RRType::MX(), &attributes));
+    EXPECT_NE(0, attributes & NAMEATTR_ADDITIONAL);
+
+    // Types encoded as opaque data, including class-IN specific ones in
+    // other classes.
+    EXPECT_EQ(RDATA_LAYOUT_OPAQUE,
+              getRdataLayout(RRClass::IN(), RRType::RRSIG(), &attributes));
+    EXPECT_EQ(RDATA_LAYOUT_OPAQUE,
+              getRdataLayout(RRClass::IN(), RRType::TXT(), &attributes));
+    EXPECT_EQ(RDATA_LAYOUT_OPAQUE,
+              getRdataLayout(RRClass::CH(), RRType::A(), &attributes));
+    EXPECT_EQ(RDATA_LAYOUT_OPAQUE,
+              getRdataLayout(RRClass::IN(), RRType("TYPE65000"),
+                             &attributes));
+
+    // Others are not supported.
+    EXPECT_EQ(RDATA_LAYOUT_GENERIC,
+              getRdataLayout(RRClass::IN(), RRType::SRV(), &attributes));
+    EXPECT_EQ(RDATA_LAYOUT_GENERIC,
+              getRdataLayout(RRClass::IN(), RRType::NSEC(), &attributes));
+    EXPECT_EQ(RDATA_LAYOUT_GENERIC,
+              getRdataLayout(RRClass::IN(), RRType::PTR(), &attributes));
+}
+
 TEST_F(RdataSerializationTest, badAddRdata) {
     // Some operations must follow start().
     EXPECT_THROW(encoder_.addRdata(*a_rdata_), bundy::InvalidOperation);
@@ -27,6 +27,7 @@
 #include <datasrc/memory/segment_object_holder.h>
 #include <datasrc/memory/rdata_serialization.h>
 #include <datasrc/memory/rdataset.h>
+#include <datasrc/memory/zone_data.h>
 
 #include <testutils/dnsmessage_test.h>
 
@@ -162,6 +163,30 @@ TEST_F(RdataSetTest, create) {
     RdataSet::destroy(mem_sgmt_, rdataset, RRClass::IN());
 }
 
+TEST_F(RdataSetTest, createFromEncoder) {
+    // Create an RdataSet from an encoder session directly.  The result
+    // should be the same as the one created from the RRset.
+    encoder_.start(RRClass::IN(), RRType::A());
+    encoder_.addRdata(*createRdata(RRType::A(), RRClass::IN(), "192.0.2.1"));
+    RdataSet* rdataset = RdataSet::createFromEncoder(mem_sgmt_, encoder_,
+                                                     RRType::A(),
+                                                     a_rrset_->getTTL(), 1);
+    checkRdataSet(*rdataset, def_rdata_txt_, vector<string>());
+    RdataSet::destroy(mem_sgmt_, rdataset, RRClass::IN());
+
+    // Bad parameters
+    EXPECT_THROW(RdataSet::createFromEncoder(mem_sgmt_, encoder_, RRType::A(),
+                                             a_rrset_->getTTL(), 0),
+                 bundy::BadValue);
+    EXPECT_THROW(RdataSet::createFromEncoder(mem_sgmt_, encoder_,
+                                             RRType::RRSIG(),
+                                             a_rrset_->getTTL(), 1),
+                 bundy::BadValue);
+    EXPECT_THROW(RdataSet::createFromEncoder(mem_sgmt_, encoder_, RRType::A(),
+                                             a_rrset_->getTTL(), 65536),
+                 RdataSetError);
+}
+
 // This is similar to the simple create test, but we check all combinations
 // of old and new data.
 TEST_F(RdataSetTest, mergeCreate) {
@@ -557,6 +582,121 @@ TEST_F(RdataSetTest, mergeCreateManyRRSIGs) {
                                       holder.get()), rrsig->getRdataCount());
 }
 
+// A helper callback for the additionalLinks test, collecting names in
+// RDATA.
+void
+collectName(vector<Name>* names, const bundy::dns::LabelSequence& labels,
+            RdataNameAttributes) {
+    names->push_back(Name(labels.toText()));
+}
+
+TEST_F(RdataSetTest, additionalLinks) {
+    EXPECT_TRUE(RdataSet::needsAdditionalLinks(RRType::NS()));
+    EXPECT_TRUE(RdataSet::needsAdditionalLinks(RRType::MX()));
+    EXPECT_TRUE(RdataSet::needsAdditionalLinks(RRType::SRV()));
+    EXPECT_FALSE(RdataSet::needsAdditionalLinks(RRType::A()));
+    EXPECT_FALSE(RdataSet::needsAdditionalLinks(RRType::CNAME()));
+
+    // Other types don't have any link.
+    RdataSet* rdataset = RdataSet::create(mem_sgmt_, encoder_, a_rrset_,
+                                          ConstRRsetPtr());
+    EXPECT_EQ(0, rdataset->getAdditionalLinkCount());
+    RdataSet::destroy(mem_sgmt_, rdataset, RRClass::IN());
+
+    // NS has a link for each RDATA, initially NULL.  We use many RRSIGs
+    // so the links and the extended RRSIG count field coexist.
+    ConstRRsetPtr ns_rrset = textToRRset(
+        "example.com. 3600 IN NS ns1.example.com.\n"
+        "example.com. 3600 IN NS ns2.example.com.");
+    RRsetPtr ns_rrsig(new RRset(Name("example.com"), RRClass::IN(),
+                                RRType::RRSIG(), RRTTL(3600)));
+    for (size_t i = 0; i < 8; ++i) {
+        ns_rrsig->addRdata(createRdata(
+                               RRType::RRSIG(), rrclass,
+                               "NS 5 2 " + lexical_cast<string>(i) +
+                               " 20120814220826 20120715220826 1234 "
+                               "example.com. FAKE"));
+    }
+    rdataset = RdataSet::create(mem_sgmt_, encoder_, ns_rrset, ns_rrsig);
+    EXPECT_EQ(8, rdataset->getSigRdataCount());
+    ASSERT_EQ(2, rdataset->getAdditionalLinkCount());
+    EXPECT_EQ(static_cast<const ZoneNode*>(NULL),
+              rdataset->getAdditionalLink(0));
+    EXPECT_EQ(static_cast<const ZoneNode*>(NULL),
+              rdataset->getAdditionalLink(1));
+
+    // Set the links to real nodes, and check they don't break the data.
+    ZoneData* zone_data = ZoneData::create(mem_sgmt_, Name("example.com"));
+    ZoneNode* node1 = NULL;
+    ZoneNode* node2 = NULL;
+    zone_data->insertName(mem_sgmt_, Name("ns1.example.com"), &node1);
+    zone_data->insertName(mem_sgmt_, Name("ns2.example.com"), &node2);
+    rdataset->setAdditionalLink(0, node1);
+    rdataset->setAdditionalLink(1, node2);
+    EXPECT_EQ(node1, rdataset->getAdditionalLink(0));
+    EXPECT_EQ(node2, rdataset->getAdditionalLink(1));
+
+    vector<Name> names;
+    const RdataSet& const_rdataset = *rdataset;
+    RdataReader(RRClass::IN(), RRType::NS(), const_rdataset.getDataBuf(),
+                rdataset->getRdataCount(), rdataset->getSigRdataCount(),
+                boost::bind(collectName, &names, _1, _2),
+                &RdataReader::emptyDataAction).iterate();
+    ASSERT_EQ(2, names.size());
+    EXPECT_EQ(Name("ns1.example.com"), names[0]);
+    EXPECT_EQ(Name("ns2.example.com"), names[1]);
+
+    RdataSet::destroy(mem_sgmt_, rdataset, RRClass::IN());
+    ZoneData::destroy(mem_sgmt_, zone_data, RRClass::IN());
+}
+
+TEST_F(RdataSetTest, share) {
+    // Only NS without RRSIG is shareable.
+    RdataSet* rdataset = RdataSet::create(mem_sgmt_, encoder_, a_rrset_,
+                                          ConstRRsetPtr());
+    EXPECT_FALSE(rdataset->isShareable());
+    EXPECT_EQ(1, rdataset->getRefCount());
+    RdataSet::destroy(mem_sgmt_, rdataset, RRClass::IN());
+
+    ConstRRsetPtr ns_rrset = textToRRset(
+        "example.com. 3600 IN NS ns1.example.com.\n"
+        "example.com. 3600 IN NS ns2.example.com.");
+    ConstRRsetPtr ns_rrsig = textToRRset(
+        "example.com. 3600 IN RRSIG NS 5 2 3600 20120814220826 "
+        "20120715220826 1234 example.com. FAKE");
+    rdataset = RdataSet::create(mem_sgmt_, encoder_, ns_rrset, ns_rrsig);
+    EXPECT_FALSE(rdataset->isShareable());
+    RdataSet::destroy(mem_sgmt_, rdataset, RRClass::IN());
+
+    rdataset = RdataSet::create(mem_sgmt_, encoder_, ns_rrset,
+                                ConstRRsetPtr());
+    EXPECT_TRUE(rdataset->isShareable());
+    EXPECT_EQ(1, rdataset->getRefCount());
+    EXPECT_EQ(2, rdataset->getRdataCount());
+    EXPECT_EQ(2, rdataset->getAdditionalLinkCount());
+    EXPECT_EQ(RRTTL(3600), restoreTTL(rdataset->getTTLData()));
+
+    // The data follow the reference count.
+    vector<Name> names;
+    const RdataSet& const_rdataset = *rdataset;
+    RdataReader(RRClass::IN(), RRType::NS(), const_rdataset.getDataBuf(),
+                rdataset->getRdataCount(), rdataset->getSigRdataCount(),
+                boost::bind(collectName, &names, _1, _2),
+                &RdataReader::emptyDataAction).iterate();
+    ASSERT_EQ(2, names.size());
+    EXPECT_EQ(Name("ns1.example.com"), names[0]);
+    EXPECT_EQ(Name("ns2.example.com"), names[1]);
+
+    // Each reference has to be released by destroy(); the last one
+    // releases the memory (which TearDown() checks).
+    rdataset->addRef();
+    EXPECT_EQ(2, rdataset->getRefCount());
+    RdataSet::destroy(mem_sgmt_, rdataset, RRClass::IN());
+    EXPECT_EQ(1, rdataset->getRefCount());
+    EXPECT_FALSE(mem_sgmt_.allMemoryDeallocated());
+    RdataSet::destroy(mem_sgmt_, rdataset, RRClass::IN());
+}
+
 TEST_F(RdataSetTest, createWithRRSIGOnly) {
     // A rare, but allowed, case: RdataSet without the main RRset but with
     // RRSIG.
@@ -19,6 +19,7 @@
 #include <datasrc/memory/zone_data.h>
 #include <datasrc/memory/zone_data_updater.h>
 #include <datasrc/memory/segment_object_holder.h>
+#include <datasrc/memory/treenode_rrset.h>
 #include <datasrc/zone_iterator.h>
 
 #include <util/buffer.h>
@@ -26,6 +27,7 @@
 #include <dns/name.h>
 #include <dns/rrclass.h>
 #include <dns/rdataclass.h>
+#include <dns/rrttl.h>
 #ifdef USE_SHARED_MEMORY
 #include <util/memory_segment_mapped.h>
 #endif
@@ -56,6 +58,21 @@ protected:
     const RRClass zclass_;
     test::MemorySegmentMock mem_sgmt_;
     ZoneData* zone_data_;
+
+    // Return the text form of the RRset of the given name and type loaded
+    // in zone_data_, including the RRSIGs.  Empty if there isn't one.
+    std::string getRRsetText(const char* name, const RRType& type) {
+        const ZoneNode* node = NULL;
+        if (zone_data_->getZoneTree().find(Name(name), &node) !=
+            ZoneTree::EXACTMATCH) {
+            return ("");
+        }
+        const RdataSet* rdset = RdataSet::find(node->getData(), type);
+        if (rdset == NULL) {
+            return ("");
+        }
+        return (TreeNodeRRset(zclass_, node, rdset, true).toText());
+    }
 };
 
 TEST_F(ZoneDataLoaderTest, loadRRSIGFollowsNothing) {
@@ -77,6 +94,49 @@ TEST_F(ZoneDataLoaderTest, loadRRSIGFollowsNothing) {
     // Teardown checks for memory segment leaks
 }
 
+TEST_F(ZoneDataLoaderTest, loadTextRdata) {
+    // The RDATA of some common types is encoded directly from the master
+    // file, the others through Rdata objects.  The result should be the
+    // same in any case, regardless of how they are mixed.
+    zone_data_ = loadZoneData(mem_sgmt_, zclass_, Name("example.org"),
+                              TEST_DATA_DIR "/example.org-text-rdata.zone");
+
+    EXPECT_EQ("example.org. 3600 IN NS ns1.example.org.\n",
+              getRRsetText("example.org", RRType::NS()));
+    // The duplicate MX is ignored, but otherwise the names are kept as
+    // they are in the zone file.
+    EXPECT_EQ("example.org. 3600 IN MX 10 mail.example.org.\n"
+              "example.org. 3600 IN MX 20 MAIL.example.org.\n",
+              getRRsetText("example.org", RRType::MX()));
+    // The smaller TTL wins, and the RRSIG that follows is merged.
+    EXPECT_EQ("ns1.example.org. 1800 IN A 192.0.2.1\n"
+              "ns1.example.org. 1800 IN A 192.0.2.2\n"
+              "ns1.example.org. 1800 IN RRSIG A 7 3 3600 20150420235959 "
+              "20051021000000 40430 example.org. FAKEFAKE\n",
+              getRRsetText("ns1.example.org", RRType::A()));
+    EXPECT_EQ("ns1.example.org. 3600 IN AAAA 2001:db8::1\n",
+              getRRsetText("ns1.example.org", RRType::AAAA()));
+    // RRs of the same type separated by another type are merged.
+    EXPECT_EQ("www.example.org. 3600 IN A 192.0.2.10\n"
+              "www.example.org. 3600 IN A 192.0.2.11\n",
+              getRRsetText("www.example.org", RRType::A()));
+    EXPECT_EQ("www.example.org. 3600 IN SRV 0 0 80 ns1.example.org.\n",
+              getRRsetText("www.example.org", RRType::SRV()));
+    EXPECT_EQ("www.example.org. 3600 IN TXT \"foo bar\" \"baz\"\n",
+              getRRsetText("www.example.org", RRType::TXT()));
+    EXPECT_EQ("ns.child.example.org. 3600 IN A 192.0.2.20\n",
+              getRRsetText("ns.child.example.org", RRType::A()));
+
+    // The delegation is recognized as a zone cut.
+    const ZoneNode* node = NULL;
+    ASSERT_EQ(ZoneTree::EXACTMATCH,
+              zone_data_->getZoneTree().find(Name("child.example.org"),
+                                             &node));
+    EXPECT_TRUE(node->getFlag(ZoneNode::FLAG_CALLBACK));
+    EXPECT_EQ("child.example.org. 3600 IN NS ns.child.example.org.\n",
+              getRRsetText("child.example.org", RRType::NS()));
+}
+
 TEST_F(ZoneDataLoaderTest, zoneMinTTL) {
     // This should hold outside of the loader class, but we do double check.
     zone_data_ = loadZoneData(mem_sgmt_, zclass_, Name("example.org"),
@@ -214,6 +214,47 @@ TEST_F(ZoneDataTest, addRdataSets) {
     // TearDown() will confirm there's no leak on destroy
 }
 
+TEST_F(ZoneDataTest, getMemoryUsage) {
+    // The zone data is the only user of the segment, so the total usage
+    // should always match what's allocated from the segment.
+    ZoneMemoryUsage usage = zone_data_->getMemoryUsage(RRClass::IN());
+    EXPECT_LT(0, usage.tree_nodes);  // the origin node
+    EXPECT_EQ(LabelSequence(zname_).getSerializedLength(), usage.names);
+    EXPECT_EQ(0, usage.rdatasets);
+    EXPECT_EQ(0, usage.nsec3);
+    EXPECT_LT(0, usage.overhead);
+    EXPECT_EQ(mem_sgmt_.getStatistics().allocated_bytes, usage.getTotal());
+
+    ZoneNode* node = NULL;
+    zone_data_->insertName(mem_sgmt_, a_rrset_->getName(), &node);
+    RdataSet* rdataset_a =
+        RdataSet::create(mem_sgmt_, encoder_, a_rrset_, ConstRRsetPtr());
+    node->setData(rdataset_a);
+    RdataSet* rdataset_aaaa =
+        RdataSet::create(mem_sgmt_, encoder_, aaaa_rrset_, ConstRRsetPtr());
+    rdataset_aaaa->next = rdataset_a;
+    node->setData(rdataset_aaaa);
+
+    const ZoneMemoryUsage usage2 = zone_data_->getMemoryUsage(RRClass::IN());
+    EXPECT_LT(usage.tree_nodes, usage2.tree_nodes);
+    EXPECT_LT(usage.names, usage2.names);
+    EXPECT_EQ(rdataset_a->getAllocatedSize(RRClass::IN()) +
+              rdataset_aaaa->getAllocatedSize(RRClass::IN()),
+              usage2.rdatasets);
+    EXPECT_EQ(0, usage2.nsec3);
+    EXPECT_EQ(usage.overhead, usage2.overhead);
+    EXPECT_EQ(mem_sgmt_.getStatistics().allocated_bytes, usage2.getTotal());
+
+    // NSEC3 data is counted separately.
+    zone_data_->setNSEC3Data(NSEC3Data::create(mem_sgmt_, zname_,
+                                               param_rdata_));
+    const ZoneMemoryUsage usage3 = zone_data_->getMemoryUsage(RRClass::IN());
+    EXPECT_EQ(usage2.tree_nodes, usage3.tree_nodes);
+    EXPECT_EQ(usage2.rdatasets, usage3.rdatasets);
+    EXPECT_LT(0, usage3.nsec3);
+    EXPECT_EQ(mem_sgmt_.getStatistics().allocated_bytes, usage3.getTotal());
+}
+
 TEST_F(ZoneDataTest, getSetNSEC3Data) {
     // Initially there's no NSEC3 data
     EXPECT_EQ(static_cast<NSEC3Data*>(NULL), zone_data_->getNSEC3Data());
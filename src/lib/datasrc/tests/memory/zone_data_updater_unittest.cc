@@ -332,6 +332,190 @@ TEST_P(ZoneDataUpdaterTest, manySmallRRsets) {
     }
 }
 
+// Full loads use the updater in the bulk mode, expecting names in the
+// DNSSEC order.  The segment may also grow during the load.
+TEST_P(ZoneDataUpdaterTest, bulkLoad) {
+    ZoneData* data = getZoneData();
+    updater_.reset();
+    updater_.reset(new ZoneDataUpdater(*mem_sgmt_, zclass_, zname_, *data,
+                                       true));
+
+    const size_t count = 8192;
+    for (size_t i = 0; i < count; ++i) {
+        const std::string name("n" + boost::lexical_cast<std::string>(
+                                   10000 + i) + ".example.org.");
+        updater_->add(textToRRset(name + " 3600 IN A 192.0.2.1"),
+                      ConstRRsetPtr());
+        // A wildcard also inserts its parent, which already exists.
+        if (i == count / 2) {
+            updater_->add(textToRRset("*." + name + " 3600 IN A 192.0.2.2"),
+                          ConstRRsetPtr());
+        }
+    }
+    // An out-of-order name.  This and further names are inserted in the
+    // normal way.
+    updater_->add(textToRRset("a.example.org. 3600 IN A 192.0.2.3"),
+                  ConstRRsetPtr());
+    updater_->finish();
+
+    const ZoneTree& tree = getZoneData()->getZoneTree();
+    EXPECT_TRUE(tree.checkProperties());
+    const ZoneNode* node = NULL;
+    for (size_t i = 0; i < count; ++i) {
+        EXPECT_EQ(ZoneTree::EXACTMATCH,
+                  tree.find(Name("n" + boost::lexical_cast<std::string>(
+                                     10000 + i) + ".example.org."), &node));
+    }
+    EXPECT_EQ(ZoneTree::EXACTMATCH,
+              tree.find(Name("*.n14096.example.org."), &node));
+    EXPECT_EQ(ZoneTree::EXACTMATCH,
+              tree.find(Name("n14096.example.org."), &node));
+    EXPECT_TRUE(node->getFlag(ZoneData::WILDCARD_NODE));
+    EXPECT_EQ(ZoneTree::EXACTMATCH, tree.find(Name("a.example.org."), &node));
+}
+
+// Return the i-th additional link of the RdataSet of the given name
+// and type.
+const ZoneNode*
+getAdditionalLink(const ZoneData& zone_data, const Name& name,
+                  const RRType& type, size_t index)
+{
+    const ZoneNode* node = NULL;
+    EXPECT_EQ(ZoneTree::EXACTMATCH,
+              zone_data.getZoneTree().find(name, &node));
+    const RdataSet* rdataset = RdataSet::find(node->getData(), type);
+    EXPECT_NE(static_cast<const RdataSet*>(NULL), rdataset);
+    EXPECT_LT(index, rdataset->getAdditionalLinkCount());
+    return (rdataset->getAdditionalLink(index));
+}
+
+const ZoneNode*
+findNode(const ZoneData& zone_data, const Name& name) {
+    const ZoneNode* node = NULL;
+    EXPECT_EQ(ZoneTree::EXACTMATCH,
+              zone_data.getZoneTree().find(name, &node));
+    return (node);
+}
+
+TEST_P(ZoneDataUpdaterTest, additionalLinks) {
+    const ZoneNode* const null_node = NULL;
+
+    updater_->add(textToRRset("example.org. 3600 IN NS ns.example.org."),
+                  ConstRRsetPtr());
+    updater_->add(textToRRset("example.org. 3600 IN MX 10 mx.example.org."),
+                  ConstRRsetPtr());
+    updater_->add(textToRRset("ns.example.org. 3600 IN A 192.0.2.1"),
+                  ConstRRsetPtr());
+    EXPECT_FALSE(getZoneData()->isAdditionalLinked());
+
+    // finish() resolves the links; names that don't exist are left NULL.
+    updater_->finish();
+    EXPECT_TRUE(getZoneData()->isAdditionalLinked());
+    EXPECT_EQ(findNode(*getZoneData(), Name("ns.example.org")),
+              getAdditionalLink(*getZoneData(), zname_, RRType::NS(), 0));
+    EXPECT_EQ(null_node,
+              getAdditionalLink(*getZoneData(), zname_, RRType::MX(), 0));
+
+    // Once resolved, new RdataSets get their links at the time of add().
+    // The existing NULL link is kept, which just means the name needs to
+    // be looked up.
+    updater_->add(textToRRset("mx.example.org. 3600 IN A 192.0.2.2"),
+                  ConstRRsetPtr());
+    updater_->add(textToRRset("www.example.org. 3600 IN MX 10 "
+                              "ns.example.org."), ConstRRsetPtr());
+    EXPECT_TRUE(getZoneData()->isAdditionalLinked());
+    EXPECT_EQ(null_node,
+              getAdditionalLink(*getZoneData(), zname_, RRType::MX(), 0));
+    EXPECT_EQ(findNode(*getZoneData(), Name("ns.example.org")),
+              getAdditionalLink(*getZoneData(), Name("www.example.org"),
+                                RRType::MX(), 0));
+
+    // A new zone cut invalidates the links of the zone until the next
+    // finish().
+    updater_->add(textToRRset("www.example.org. 3600 IN MX 20 "
+                              "ns.child.example.org."), ConstRRsetPtr());
+    updater_->add(textToRRset("child.example.org. 3600 IN NS "
+                              "ns.child.example.org."), ConstRRsetPtr());
+    updater_->add(textToRRset("ns.child.example.org. 3600 IN A 192.0.2.3"),
+                  ConstRRsetPtr());
+    EXPECT_FALSE(getZoneData()->isAdditionalLinked());
+
+    updater_->finish();
+    EXPECT_TRUE(getZoneData()->isAdditionalLinked());
+    EXPECT_EQ(findNode(*getZoneData(), Name("mx.example.org")),
+              getAdditionalLink(*getZoneData(), zname_, RRType::MX(), 0));
+    // Glue is linked for NS, but not for other types.
+    EXPECT_EQ(findNode(*getZoneData(), Name("ns.child.example.org")),
+              getAdditionalLink(*getZoneData(), Name("child.example.org"),
+                                RRType::NS(), 0));
+    EXPECT_EQ(findNode(*getZoneData(), Name("ns.example.org")),
+              getAdditionalLink(*getZoneData(), Name("www.example.org"),
+                                RRType::MX(), 0));
+    EXPECT_EQ(null_node,
+              getAdditionalLink(*getZoneData(), Name("www.example.org"),
+                                RRType::MX(), 1));
+}
+
+TEST_P(ZoneDataUpdaterTest, sharedDelegations) {
+    // Delegations with the same NS (and TTL) share a single RdataSet,
+    // placed at the end of each list.
+    updater_->add(textToRRset("a.example.org. 3600 IN NS ns1.example.net.\n"
+                              "a.example.org. 3600 IN NS ns2.example.net."),
+                  ConstRRsetPtr());
+    updater_->add(textToRRset("b.example.org. 3600 IN DS 12345 5 1 "
+                              "DEADBEEF"), ConstRRsetPtr());
+    updater_->add(textToRRset("b.example.org. 3600 IN NS ns1.example.net.\n"
+                              "b.example.org. 3600 IN NS ns2.example.net."),
+                  ConstRRsetPtr());
+    updater_->add(textToRRset("c.example.org. 7200 IN NS ns1.example.net.\n"
+                              "c.example.org. 7200 IN NS ns2.example.net."),
+                  ConstRRsetPtr());
+
+    const RdataSet* ns_a = RdataSet::find(
+        findNode(*getZoneData(), Name("a.example.org"))->getData(),
+        RRType::NS());
+    const ZoneNode* node_b = findNode(*getZoneData(), Name("b.example.org"));
+    const RdataSet* ns_b = RdataSet::find(node_b->getData(), RRType::NS());
+    const RdataSet* ns_c = RdataSet::find(
+        findNode(*getZoneData(), Name("c.example.org"))->getData(),
+        RRType::NS());
+    ASSERT_NE(static_cast<const RdataSet*>(NULL), ns_a);
+    EXPECT_EQ(ns_a, ns_b);
+    EXPECT_EQ(2, ns_a->getRefCount());
+    EXPECT_NE(ns_a, ns_c);      // TTL differs
+    EXPECT_EQ(1, ns_c->getRefCount());
+    EXPECT_EQ(RRType::DS(), node_b->getData()->type);
+    EXPECT_EQ(ns_b, node_b->getData()->getNext());
+    EXPECT_EQ(static_cast<const RdataSet*>(NULL), ns_b->getNext());
+
+    // Adding to one of the sharing delegations makes it separate, and
+    // the same data are shared again.
+    updater_->add(textToRRset("a.example.org. 3600 IN NS ns3.example.net."),
+                  ConstRRsetPtr());
+    ns_a = RdataSet::find(
+        findNode(*getZoneData(), Name("a.example.org"))->getData(),
+        RRType::NS());
+    EXPECT_NE(ns_a, ns_b);
+    EXPECT_EQ(3, ns_a->getRdataCount());
+    EXPECT_EQ(1, ns_b->getRefCount());
+    updater_->add(textToRRset("c.example.org. 3600 IN NS ns1.example.net."),
+                  ConstRRsetPtr());
+    EXPECT_EQ(ns_b, RdataSet::find(
+                  findNode(*getZoneData(), Name("c.example.org"))->getData(),
+                  RRType::NS()));
+    EXPECT_EQ(2, ns_b->getRefCount());
+
+    // Memory usage counts the shared RdataSet once (each of the two
+    // references counts half of it, possibly rounded down).
+    const size_t ns_size = ns_b->getAllocatedSize(zclass_);
+    const ZoneMemoryUsage usage = getZoneData()->getMemoryUsage(zclass_);
+    EXPECT_EQ(ns_size / 2 * 2 + ns_a->getAllocatedSize(zclass_) +
+              RdataSet::find(node_b->getData(), RRType::DS())->
+              getAllocatedSize(zclass_), usage.rdatasets);
+
+    // The destructor releases all references; it would detect a leak.
+}
+
 TEST_P(ZoneDataUpdaterTest, updaterCollision) {
     ZoneData* zone_data = ZoneData::create(*mem_sgmt_,
                                            Name("another.example.com."));
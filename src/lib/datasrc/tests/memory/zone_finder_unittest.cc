@@ -680,6 +680,73 @@ TEST_F(InMemoryZoneFinderTest, glue) {
              NULL, ZoneFinder::FIND_GLUE_OK);
 }
 
+TEST_F(InMemoryZoneFinderTest, findBatch) {
+    addToZoneData(rr_a_);
+    addToZoneData(rr_ns_);
+    addToZoneData(rr_cname_);
+    addToZoneData(rr_dname_);
+    addToZoneData(rr_child_ns_);
+    addToZoneData(rr_child_glue_);
+    addToZoneData(rr_wild_);
+
+    // A mixture of success, CNAME, DNAME, delegation, wildcard, NXRRSET
+    // and NXDOMAIN cases.
+    vector<Name> names;
+    vector<RRType> types;
+    names.push_back(origin_);
+    types.push_back(RRType::A());
+    names.push_back(origin_);
+    types.push_back(RRType::AAAA());
+    names.push_back(rr_cname_->getName());
+    types.push_back(RRType::A());
+    names.push_back(Name("www.dname.example.org"));
+    types.push_back(RRType::A());
+    names.push_back(rr_child_glue_->getName());
+    types.push_back(RRType::A());
+    names.push_back(Name("foo.wild.example.org"));
+    types.push_back(RRType::A());
+    names.push_back(Name("nosuch.example.org"));
+    types.push_back(RRType::A());
+
+    vector<ZoneFinderContextPtr> results;
+    zone_finder_.findBatch(names, types, results);
+    ASSERT_EQ(names.size(), results.size());
+    for (size_t i = 0; i < names.size(); ++i) {
+        SCOPED_TRACE(names[i].toText());
+        const ZoneFinderContextPtr expected =
+            zone_finder_.find(names[i], types[i]);
+        EXPECT_EQ(expected->code, results[i]->code);
+        EXPECT_EQ(expected->isWildcard(), results[i]->isWildcard());
+        if (expected->rrset) {
+            ASSERT_TRUE(results[i]->rrset);
+            rrsetCheck(expected->rrset, results[i]->rrset);
+        } else {
+            EXPECT_FALSE(results[i]->rrset);
+        }
+    }
+    EXPECT_EQ(ZoneFinder::DELEGATION, results[4]->code);
+    EXPECT_TRUE(results[5]->isWildcard());
+
+    // The glue is found with FIND_GLUE_OK.
+    zone_finder_.findBatch(names, types, results, ZoneFinder::FIND_GLUE_OK);
+    ASSERT_EQ(names.size(), results.size());
+    EXPECT_EQ(ZoneFinder::SUCCESS, results[4]->code);
+
+    // Empty batch.
+    zone_finder_.findBatch(vector<Name>(), vector<RRType>(), results);
+    EXPECT_TRUE(results.empty());
+
+    // Mismatched names and types.
+    types.pop_back();
+    EXPECT_THROW(zone_finder_.findBatch(names, types, results),
+                 bundy::BadValue);
+
+    // Out of zone name, as in find().
+    types.push_back(RRType::A());
+    names.back() = Name("example.com");
+    EXPECT_THROW(zone_finder_.findBatch(names, types, results), OutOfZone);
+}
+
 TEST_F(InMemoryZoneFinderTest, findAtOrigin) {
     // Add origin NS.
     rr_ns_->addRRsig(createRdata(RRType::RRSIG(), RRClass::IN(),
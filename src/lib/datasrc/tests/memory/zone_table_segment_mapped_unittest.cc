@@ -117,6 +117,15 @@ corruptChecksum(MemorySegment& segment) {
     *static_cast<size_t*>(result.second) = checksum;
 }
 
+void
+corruptVersion(MemorySegment& segment) {
+    const MemorySegment::NamedAddressResult result =
+        segment.getNamedAddress("zone_table_version");
+    ASSERT_TRUE(result.first);
+
+    ++*static_cast<uint32_t*>(result.second);
+}
+
 void
 deleteHeader(MemorySegment& segment) {
     segment.clearNamedAddress("zone_table_header");
@@ -249,6 +258,52 @@ TEST_F(ZoneTableSegmentMappedTest, resetBadConfig) {
     }, bundy::InvalidParameter);
 
     EXPECT_TRUE(verifyData(ztable_segment_->getMemorySegment()));
+
+    // Memory options are not booleans
+    ElementPtr bad_params = Element::fromJSON(
+        "{\"mapped-file\": \"" + std::string(mapped_file) + "\"}");
+    bad_params->set("huge-pages", Element::create("yes"));
+    EXPECT_THROW({
+        ztable_segment_->reset(ZoneTableSegment::READ_WRITE, bad_params);
+    }, bundy::InvalidParameter);
+    bad_params->remove("huge-pages");
+    bad_params->set("prefault", Element::create(1));
+    EXPECT_THROW({
+        ztable_segment_->reset(ZoneTableSegment::READ_WRITE, bad_params);
+    }, bundy::InvalidParameter);
+
+    EXPECT_TRUE(verifyData(ztable_segment_->getMemorySegment()));
+}
+
+TEST_F(ZoneTableSegmentMappedTest, resetWithMemoryOptions) {
+    ElementPtr params = Element::fromJSON(
+        "{\"mapped-file\": \"" + std::string(mapped_file) + "\", "
+        "\"huge-pages\": true, \"prefault\": true}");
+
+    ztable_segment_->reset(ZoneTableSegment::CREATE, params);
+    addData(ztable_segment_->getMemorySegment());
+    EXPECT_TRUE(verifyData(ztable_segment_->getMemorySegment()));
+
+    // Reopening the same file applies the options to the new mapping,
+    // and they follow the parameters of each reset().
+    ztable_segment_->reset(ZoneTableSegment::READ_ONLY, params);
+    EXPECT_TRUE(ztable_segment_->isUsable());
+    EXPECT_TRUE(verifyData(ztable_segment_->getMemorySegment()));
+    const MemorySegmentMapped* mem_sgmt =
+        dynamic_cast<MemorySegmentMapped*>(
+            &ztable_segment_->getMemorySegment());
+    ASSERT_TRUE(mem_sgmt);
+    EXPECT_TRUE(mem_sgmt->getHugePages());
+    EXPECT_TRUE(mem_sgmt->getPrefault());
+
+    params->remove("prefault");
+    ztable_segment_->reset(ZoneTableSegment::READ_WRITE, params);
+    EXPECT_TRUE(verifyData(ztable_segment_->getMemorySegment()));
+    mem_sgmt = dynamic_cast<MemorySegmentMapped*>(
+        &ztable_segment_->getMemorySegment());
+    ASSERT_TRUE(mem_sgmt);
+    EXPECT_TRUE(mem_sgmt->getHugePages());
+    EXPECT_FALSE(mem_sgmt->getPrefault());
 }
 
 TEST_F(ZoneTableSegmentMappedTest, reset) {
@@ -519,6 +574,34 @@ TEST_F(ZoneTableSegmentMappedTest, resetFailedMissingHeader) {
     EXPECT_TRUE(verifyData(ztable_segment_->getMemorySegment()));
 }
 
+TEST_F(ZoneTableSegmentMappedTest, resetFailedIncompatibleVersion) {
+    setupMappedFiles();
+
+    // Open mapped file 1 in read-write mode
+    ztable_segment_->reset(ZoneTableSegment::READ_WRITE, config_params_);
+
+    // Make mapped file 2 look like it was saved by an incompatible
+    // implementation.
+    scoped_ptr<MemorySegmentMapped> segment
+        (new MemorySegmentMapped(mapped_file2,
+                                 MemorySegmentMapped::OPEN_OR_CREATE));
+    EXPECT_TRUE(verifyData(*segment));
+    corruptVersion(*segment);
+    segment.reset();
+
+    // Resetting to mapped file 2 in read-only mode should fail even
+    // though the checksum is not verified in that mode.
+    EXPECT_THROW({
+        ztable_segment_->reset(ZoneTableSegment::READ_ONLY, config_params2_);
+    }, ResetFailed);
+
+    EXPECT_TRUE(ztable_segment_->isUsable());
+    EXPECT_TRUE(ztable_segment_->isWritable());
+    // Check for the old data in the segment to make sure it is still
+    // available and correct.
+    EXPECT_TRUE(verifyData(ztable_segment_->getMemorySegment()));
+}
+
 TEST_F(ZoneTableSegmentMappedTest, resetCreateOverCorruptedFile) {
     setupMappedFiles();
 
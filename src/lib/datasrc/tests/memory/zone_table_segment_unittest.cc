@@ -54,6 +54,20 @@ TEST_F(ZoneTableSegmentTest, create) {
                  UnknownSegmentType);
 }
 
+TEST_F(ZoneTableSegmentTest, createWithHugePages) {
+    // A local segment can use huge pages; it works just like the default.
+    ZoneTableSegment* ztable_segment =
+        ZoneTableSegment::create(RRClass::IN(), "local", true);
+    EXPECT_EQ("local", ztable_segment->getImplType());
+    EXPECT_NE(static_cast<void*>(NULL),
+              ztable_segment->getHeader().getTable());
+    MemorySegment& mem_sgmt = ztable_segment->getMemorySegment();
+    void* ptr = mem_sgmt.allocate(64);
+    EXPECT_NE(static_cast<void*>(NULL), ptr);
+    mem_sgmt.deallocate(ptr, 64);
+    ZoneTableSegment::destroy(ztable_segment);
+}
+
 TEST_F(ZoneTableSegmentTest, reset) {
     // reset() should throw that it's not implemented so that any
     // accidental calls are found out.
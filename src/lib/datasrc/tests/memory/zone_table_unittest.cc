@@ -185,6 +185,81 @@ TEST_F(ZoneTableTest, addEmptyZone) {
     EXPECT_EQ(1, zone_table->getZoneCount());
 }
 
+TEST_F(ZoneTableTest, removeZone) {
+    // Nothing to remove in an empty table
+    const ZoneTable::AddResult result0 =
+        zone_table->removeZone(mem_sgmt_, zname1);
+    EXPECT_EQ(result::NOTFOUND, result0.code);
+    EXPECT_EQ(static_cast<const ZoneData*>(NULL), result0.zone_data);
+
+    SegmentObjectHolder<ZoneData, RRClass> holder1(mem_sgmt_, zclass_);
+    holder1.set(ZoneData::create(mem_sgmt_, zname1));
+    ZoneData* zone_data = holder1.get();
+    EXPECT_EQ(result::SUCCESS, zone_table->addZone(mem_sgmt_, zname1,
+                                                   holder1.release()).code);
+    EXPECT_EQ(result::SUCCESS,
+              zone_table->addEmptyZone(mem_sgmt_, zname3).code);
+    EXPECT_EQ(2, zone_table->getZoneCount());
+
+    // Only an exact match is removed
+    EXPECT_EQ(result::NOTFOUND,
+              zone_table->removeZone(mem_sgmt_, Name("www.example.com")).code);
+    EXPECT_EQ(2, zone_table->getZoneCount());
+
+    // The data of the removed zone are passed to the caller, and the zone
+    // can't be found any more.  The other zone is not affected.
+    const ZoneTable::AddResult result1 =
+        zone_table->removeZone(mem_sgmt_, zname1);
+    EXPECT_EQ(result::SUCCESS, result1.code);
+    EXPECT_EQ(zone_data, result1.zone_data);
+    ZoneData::destroy(mem_sgmt_, result1.zone_data, zclass_);
+    EXPECT_EQ(1, zone_table->getZoneCount());
+    EXPECT_EQ(result::NOTFOUND, zone_table->findZone(zname1).code);
+    const ZoneTable::FindResult fresult3 = zone_table->findZone(zname3);
+    EXPECT_EQ(result::SUCCESS, fresult3.code);
+    EXPECT_EQ(result::ZONE_EMPTY, fresult3.flags);
+
+    // An empty zone can be removed too, but there are no data to return.
+    const ZoneTable::AddResult result2 =
+        zone_table->removeZone(mem_sgmt_, zname3);
+    EXPECT_EQ(result::SUCCESS, result2.code);
+    EXPECT_EQ(static_cast<const ZoneData*>(NULL), result2.zone_data);
+    EXPECT_EQ(0, zone_table->getZoneCount());
+    EXPECT_EQ(result::NOTFOUND, zone_table->findZone(zname3).code);
+
+    // The zone can be added again
+    SegmentObjectHolder<ZoneData, RRClass> holder2(mem_sgmt_, zclass_);
+    holder2.set(ZoneData::create(mem_sgmt_, zname1));
+    EXPECT_EQ(result::SUCCESS, zone_table->addZone(mem_sgmt_, zname1,
+                                                   holder2.release()).code);
+    EXPECT_EQ(result::SUCCESS, zone_table->findZone(zname1).code);
+}
+
+TEST_F(ZoneTableTest, getZoneNames) {
+    EXPECT_TRUE(zone_table->getZoneNames().empty());
+
+    // Add zones in non sorted order, including an empty one and a
+    // subdomain of another zone.
+    const Name names[] = { zname2, Name("www.example.com"), zname1, zname3 };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+        if (names[i] == zname3) {
+            zone_table->addEmptyZone(mem_sgmt_, names[i]);
+            continue;
+        }
+        SegmentObjectHolder<ZoneData, RRClass> holder(mem_sgmt_, zclass_);
+        holder.set(ZoneData::create(mem_sgmt_, names[i]));
+        zone_table->addZone(mem_sgmt_, names[i], holder.release());
+    }
+
+    // They are returned in DNSSEC order ("com" sorts before "example").
+    const std::vector<Name> zone_names = zone_table->getZoneNames();
+    ASSERT_EQ(4, zone_names.size());
+    EXPECT_EQ(zname1, zone_names[0]);
+    EXPECT_EQ(Name("www.example.com"), zone_names[1]);
+    EXPECT_EQ(zname3, zone_names[2]);
+    EXPECT_EQ(zname2, zone_names[3]);
+}
+
 TEST_F(ZoneTableTest, findZone) {
     SegmentObjectHolder<ZoneData, RRClass> holder1(
         mem_sgmt_, zclass_);
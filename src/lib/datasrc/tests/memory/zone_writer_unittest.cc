@@ -142,6 +142,10 @@ TEST_F(ZoneWriterTest, constructForReadOnlySegment) {
 
 // We call it the way we are supposed to, check every callback is called in the
 // right moment.
+TEST_F(ZoneWriterTest, getZoneTableSegment) {
+    EXPECT_EQ(segment_.get(), &writer_->getZoneTableSegment());
+}
+
 TEST_F(ZoneWriterTest, correctCall) {
     // Nothing called before we call it
     EXPECT_FALSE(load_called_);
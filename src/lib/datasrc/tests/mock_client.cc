@@ -46,19 +46,37 @@ namespace datasrc {
 namespace unittest {
 
 namespace {
+// The SOA of every zone.  The RData here is bogus, but it is not used to
+// anything. There just needs to be some.
+RRsetPtr
+createSOA(const Name& origin) {
+    RRsetPtr soa(new RRset(origin, RRClass::IN(), RRType::SOA(),
+                           RRTTL(3600)));
+    soa->addRdata(rdata::generic::SOA(Name::ROOT_NAME(), Name::ROOT_NAME(),
+                                      0, 0, 0, 0, 0));
+    return (soa);
+}
+
 class Finder : public ZoneFinder {
 public:
     Finder(const Name& origin) :
         origin_(origin)
     {}
     Name getOrigin() const { return (origin_); }
-    // The rest is not to be called, so just have them
+    // Only the SOA at the origin can be found, the rest is not to be
+    // called, so just have them
     RRClass getClass() const {
         bundy_throw(bundy::NotImplemented, "Not implemented");
     }
-    shared_ptr<Context> find(const Name&, const RRType&,
-                             const FindOptions)
+    shared_ptr<Context> find(const Name& name, const RRType& type,
+                             const FindOptions options)
     {
+        if (name == origin_ && type == RRType::SOA()) {
+            return (shared_ptr<Context>(
+                        new GenericContext(*this, options,
+                                           ResultContext(SUCCESS,
+                                                         createSOA(origin_)))));
+        }
         bundy_throw(bundy::NotImplemented, "Not implemented");
     }
     shared_ptr<Context> findAll(const Name&,
@@ -78,14 +96,8 @@ class Iterator : public ZoneIterator {
 public:
     Iterator(const Name& origin, bool include_a) :
         origin_(origin),
-        soa_(new RRset(origin_, RRClass::IN(), RRType::SOA(),
-                       RRTTL(3600)))
+        soa_(createSOA(origin_))
     {
-        // The RData here is bogus, but it is not used to anything. There
-        // just needs to be some.
-        soa_->addRdata(rdata::generic::SOA(Name::ROOT_NAME(),
-                                           Name::ROOT_NAME(),
-                                           0, 0, 0, 0, 0));
         rrsets_.push_back(soa_);
 
         RRsetPtr rrset(new RRset(origin_, RRClass::IN(), RRType::NS(),
@@ -19,6 +19,9 @@
 #include <datasrc/exceptions.h>
 
 #include <dns/rrclass.h>
+#include <dns/rrtype.h>
+#include <dns/rdata.h>
+#include <util/buffer.h>
 
 #include <exceptions/exceptions.h>
 
@@ -606,6 +609,59 @@ TEST_F(SQLite3AccessorTest, getRecords) {
     EXPECT_FALSE(context->getNext(columns));
 }
 
+// The test database predates the wire-format rdata columns, so the
+// corresponding column is always returned empty.
+TEST_F(SQLite3AccessorTest, getRecordsWithoutWireFormat) {
+    std::string columns[DatabaseAccessor::COLUMN_COUNT];
+    columns[DatabaseAccessor::RDATA_WIRE_COLUMN] = "garbage";
+
+    DatabaseAccessor::IteratorContextPtr context =
+        accessor->getRecords("foo.example.com.", 1);
+    ASSERT_TRUE(context->getNext(columns));
+    checkRecordRow(columns, "CNAME", "3600", "",
+                   "cnametest.example.org.", "");
+    EXPECT_TRUE(columns[DatabaseAccessor::RDATA_WIRE_COLUMN].empty());
+}
+
+// Multiple contexts of the same kind can be used on a single accessor at
+// the same time, and the accessor keeps working after they are gone.
+TEST_F(SQLite3AccessorTest, concurrentContexts) {
+    std::string columns1[DatabaseAccessor::COLUMN_COUNT];
+    std::string columns2[DatabaseAccessor::COLUMN_COUNT];
+
+    DatabaseAccessor::IteratorContextPtr context1 =
+        accessor->getRecords("foo.example.com.", 1);
+    DatabaseAccessor::IteratorContextPtr context2 =
+        accessor->getRecords("bar.example.com.", 1, true);
+    DatabaseAccessor::IteratorContextPtr context3 =
+        accessor->getRecords("foo.example.com.", 1);
+
+    ASSERT_TRUE(context1->getNext(columns1));
+    checkRecordRow(columns1, "CNAME", "3600", "",
+                   "cnametest.example.org.", "");
+    ASSERT_TRUE(context3->getNext(columns2));
+    checkRecordRow(columns2, "CNAME", "3600", "",
+                   "cnametest.example.org.", "");
+    ASSERT_TRUE(context2->getNext(columns2));
+    checkRecordRow(columns2, "A", "3600", "", "192.0.2.1", "");
+    ASSERT_TRUE(context1->getNext(columns1));
+    checkRecordRow(columns1, "RRSIG", "3600", "CNAME",
+                   "CNAME 5 3 3600 20100322084538 20100220084538 33495 "
+                   "example.com. FAKEFAKEFAKEFAKE", "");
+
+    // Release the contexts in the middle of iteration; new ones must start
+    // from the beginning.
+    context1.reset();
+    context2.reset();
+    context3.reset();
+    for (int i = 0; i < 2; ++i) {
+        context1 = accessor->getRecords("foo.example.com.", 1);
+        ASSERT_TRUE(context1->getNext(columns1));
+        checkRecordRow(columns1, "CNAME", "3600", "",
+                       "cnametest.example.org.", "");
+    }
+}
+
 TEST_F(SQLite3AccessorTest, findPrevious) {
     EXPECT_EQ("dns01.example.com.",
               accessor->findPreviousName(1, "com.example.dns02."));
@@ -763,6 +819,101 @@ TEST_F(SQLite3Create, lockedtest) {
     ASSERT_EQ(SQLITE_OK, sqlite3_close(db));
 }
 
+// Run a query returning a single text value directly on the database
+string
+getSingleText(sqlite3* db, const char* query) {
+    sqlite3_stmt* stmt = NULL;
+    EXPECT_EQ(SQLITE_OK, sqlite3_prepare_v2(db, query, -1, &stmt, NULL));
+    EXPECT_EQ(SQLITE_ROW, sqlite3_step(stmt));
+    const string result(reinterpret_cast<const char*>(
+                            sqlite3_column_text(stmt, 0)));
+    sqlite3_finalize(stmt);
+    return (result);
+}
+
+// A new database gets the latest schema, and uses write-ahead logging.
+TEST_F(SQLite3Create, newSchema) {
+    {
+        SQLite3Accessor accessor(SQLITE_NEW_DBFILE, "IN");
+    }
+    sqlite3* db;
+    ASSERT_EQ(SQLITE_OK, sqlite3_open(SQLITE_NEW_DBFILE, &db));
+    EXPECT_EQ("2.3", getSingleText(db, "SELECT version || '.' || minor "
+                                   "FROM schema_version"));
+    EXPECT_EQ("wal", getSingleText(db, "PRAGMA journal_mode"));
+    ASSERT_EQ(SQLITE_OK, sqlite3_close(db));
+}
+
+// Return the wire format of the given rdata
+string
+rdataToWire(const string& rrtype, const string& rdata) {
+    bundy::util::OutputBuffer buffer(0);
+    bundy::dns::rdata::createRdata(bundy::dns::RRType(rrtype),
+                                   RRClass::IN(), rdata)->toWire(buffer);
+    return (string(static_cast<const char*>(buffer.getData()),
+                   buffer.getLength()));
+}
+
+// Records added to a new database are stored with the wire-format rdata,
+// which is returned along with the text.
+TEST_F(SQLite3Create, wireFormatRdata) {
+    boost::shared_ptr<SQLite3Accessor> accessor(
+        new SQLite3Accessor(SQLITE_NEW_DBFILE, "IN"));
+    accessor->startTransaction();
+    const int zone_id = accessor->addZone("example.com.");
+    accessor->commit();
+
+    const string a_columns[DatabaseAccessor::ADD_COLUMN_COUNT] = {
+        "www.example.com.", "com.example.www.", "3600", "A", "", "192.0.2.1"
+    };
+    // Rdata that can't be converted is stored in text only.
+    const string bad_columns[DatabaseAccessor::ADD_COLUMN_COUNT] = {
+        "bad.example.com.", "com.example.bad.", "3600", "A", "", "bad rdata"
+    };
+    const string nsec3_columns[DatabaseAccessor::ADD_NSEC3_COLUMN_COUNT] = {
+        apex_hash, "3600", "NSEC3",
+        "1 1 12 AABBCCDD 2T7B4G4VSA5SMI47K61MV5BV1A22BOJR NS SOA"
+    };
+    accessor->startUpdateZone("example.com.", false);
+    accessor->addRecordToZone(a_columns);
+    accessor->addRecordToZone(bad_columns);
+    accessor->addNSEC3RecordToZone(nsec3_columns);
+    accessor->commit();
+
+    string columns[DatabaseAccessor::COLUMN_COUNT];
+    DatabaseAccessor::IteratorContextPtr context =
+        accessor->getRecords("www.example.com.", zone_id);
+    ASSERT_TRUE(context->getNext(columns));
+    checkRecordRow(columns, "A", "3600", "", "192.0.2.1", "");
+    EXPECT_EQ(string("\xc0\x00\x02\x01", 4),
+              columns[DatabaseAccessor::RDATA_WIRE_COLUMN]);
+    EXPECT_FALSE(context->getNext(columns));
+
+    context = accessor->getRecords("bad.example.com.", zone_id);
+    ASSERT_TRUE(context->getNext(columns));
+    checkRecordRow(columns, "A", "3600", "", "bad rdata", "");
+    EXPECT_TRUE(columns[DatabaseAccessor::RDATA_WIRE_COLUMN].empty());
+
+    context = accessor->getNSEC3Records(apex_hash, zone_id);
+    ASSERT_TRUE(context->getNext(columns));
+    EXPECT_EQ(rdataToWire("NSEC3",
+                          nsec3_columns[DatabaseAccessor::ADD_NSEC3_RDATA]),
+              columns[DatabaseAccessor::RDATA_WIRE_COLUMN]);
+
+    // The whole zone iterator returns it for both tables.
+    size_t wire_count = 0;
+    context = accessor->getAllRecords(zone_id);
+    while (context->getNext(columns)) {
+        if (!columns[DatabaseAccessor::RDATA_WIRE_COLUMN].empty()) {
+            EXPECT_EQ(rdataToWire(columns[DatabaseAccessor::TYPE_COLUMN],
+                                  columns[DatabaseAccessor::RDATA_COLUMN]),
+                      columns[DatabaseAccessor::RDATA_WIRE_COLUMN]);
+            ++wire_count;
+        }
+    }
+    EXPECT_EQ(2, wire_count);
+}
+
 TEST_F(SQLite3AccessorTest, clone) {
     boost::shared_ptr<DatabaseAccessor> cloned = accessor->clone();
     EXPECT_EQ(accessor->getDBName(), cloned->getDBName());
@@ -959,6 +1110,21 @@ TEST_F(SQLite3Update, readWhileUpdate) {
                  empty_stored);
 }
 
+TEST_F(SQLite3Update, dataVersion) {
+    const int64_t version = another_accessor->getDataVersion();
+    EXPECT_LE(0, version);
+    EXPECT_EQ(version, another_accessor->getDataVersion());
+
+    // A commit through another connection changes the version; a rollback
+    // doesn't.
+    zone_id = accessor->startUpdateZone("example.com.", true).second;
+    accessor->rollback();
+    EXPECT_EQ(version, another_accessor->getDataVersion());
+    zone_id = accessor->startUpdateZone("example.com.", true).second;
+    accessor->commit();
+    EXPECT_NE(version, another_accessor->getDataVersion());
+}
+
 TEST_F(SQLite3Update, rollback) {
     zone_id = accessor->startUpdateZone("example.com.", true).second;
     checkRecords(*accessor, zone_id, "foo.bar.example.com.", empty_stored);
@@ -1427,6 +1593,109 @@ TEST_F(SQLite3Update, addRecordDiff) {
                                                            1300));
 }
 
+// Records and diffs are written in batches; the pending ones are written
+// before reading and on commit.
+TEST_F(SQLite3Update, batchedAdd) {
+    accessor->setUpdateBatchSize(3);
+
+    // 7 records: two full batches and one pending record.
+    const size_t count = 7;
+    vector<string> names;
+    vector<string> rnames;
+    for (size_t i = 0; i < count; ++i) {
+        names.push_back("bulk" + lexical_cast<string>(i) +
+                        ".example.com.");
+        rnames.push_back("com.example.bulk" + lexical_cast<string>(i) +
+                         ".");
+    }
+    const char* rows[count][DatabaseAccessor::ADD_COLUMN_COUNT];
+    zone_id = accessor->startUpdateZone("example.com.", false).second;
+    for (size_t i = 0; i < count; ++i) {
+        rows[i][DatabaseAccessor::ADD_NAME] = names[i].c_str();
+        rows[i][DatabaseAccessor::ADD_REV_NAME] = rnames[i].c_str();
+        rows[i][DatabaseAccessor::ADD_TTL] = "3600";
+        rows[i][DatabaseAccessor::ADD_TYPE] = "A";
+        rows[i][DatabaseAccessor::ADD_SIGTYPE] = "";
+        rows[i][DatabaseAccessor::ADD_RDATA] = "192.0.2.1";
+        copy(rows[i], rows[i] + DatabaseAccessor::ADD_COLUMN_COUNT,
+             add_columns);
+        accessor->addRecordToZone(add_columns);
+    }
+    copy(diff_begin_data, diff_begin_data + DatabaseAccessor::DIFF_PARAM_COUNT,
+         diff_params);
+    accessor->addRecordDiff(zone_id, getVersion(diff_begin_data),
+                            getOperation(diff_begin_data), diff_params);
+    copy(diff_end_data, diff_end_data + DatabaseAccessor::DIFF_PARAM_COUNT,
+         diff_params);
+    accessor->addRecordDiff(zone_id, getVersion(diff_end_data),
+                            getOperation(diff_end_data), diff_params);
+
+    // The last (pending) record is visible in the update.
+    expected_stored.clear();
+    expected_stored.push_back(rows[count - 1]);
+    checkRecords(*accessor, zone_id, names[count - 1], expected_stored);
+
+    accessor->commit();
+    for (size_t i = 0; i < count; ++i) {
+        expected_stored.clear();
+        expected_stored.push_back(rows[i]);
+        checkRecords(*another_accessor, zone_id, names[i], expected_stored);
+    }
+    expected_stored.clear();
+    expected_stored.push_back(diff_begin_data);
+    expected_stored.push_back(diff_end_data);
+    checkDiffs(expected_stored, another_accessor->getDiffs(zone_id, 1234,
+                                                           1300));
+}
+
+// Pending records are discarded on rollback.
+TEST_F(SQLite3Update, batchedAddThenRollback) {
+    accessor->setUpdateBatchSize(10);
+    zone_id = accessor->startUpdateZone("example.com.", false).second;
+    copy(new_data, new_data + DatabaseAccessor::ADD_COLUMN_COUNT,
+         add_columns);
+    accessor->addRecordToZone(add_columns);
+    accessor->rollback();
+
+    zone_id = accessor->startUpdateZone("example.com.", false).second;
+    accessor->commit();
+    checkRecords(*accessor, zone_id, "newdata.example.com.", empty_stored);
+}
+
+// With deferred indexes, replacing the zone drops and recreates the indexes
+// of the record tables.
+TEST_F(SQLite3Update, deferIndexes) {
+    const char* const index_query =
+        "SELECT COUNT(*) FROM sqlite_master WHERE type = 'index'";
+    sqlite3* db;
+    ASSERT_EQ(SQLITE_OK, sqlite3_open(TEST_DATA_BUILDDIR
+                                      "/test.sqlite3.copied", &db));
+    const string index_count = getSingleText(db, index_query);
+
+    accessor->setDeferIndexesOnReplace(true);
+
+    // Rollback restores the indexes.
+    zone_id = accessor->startUpdateZone("example.com.", true).second;
+    accessor->rollback();
+    EXPECT_EQ(index_count, getSingleText(db, index_query));
+
+    // And commit recreates them.
+    zone_id = accessor->startUpdateZone("example.com.", true).second;
+    copy(new_data, new_data + DatabaseAccessor::ADD_COLUMN_COUNT,
+         add_columns);
+    accessor->addRecordToZone(add_columns);
+    accessor->commit();
+    EXPECT_EQ(index_count, getSingleText(db, index_query));
+
+    expected_stored.clear();
+    expected_stored.push_back(new_data);
+    checkRecords(*another_accessor, zone_id, "newdata.example.com.",
+                 expected_stored);
+    checkRecords(*another_accessor, zone_id, "foo.bar.example.com.",
+                 empty_stored);
+    ASSERT_EQ(SQLITE_OK, sqlite3_close(db));
+}
+
 TEST_F(SQLite3Update, addRecordOfLargeSerial) {
     // This is essentially the same as the previous test, but using a
     // very large "version" (SOA serial), which is actually the possible
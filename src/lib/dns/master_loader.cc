@@ -411,13 +411,17 @@ private:
     /// \c rrtype is the type of the current RR, and \c rdata is its RDATA.  They
     /// only matter if the type is SOA and no available TTL is known.  In this
     /// case the minimum TTL of the SOA will be used as the TTL of that SOA
-    /// and the default TTL for subsequent RRs.
+    /// and the default TTL for subsequent RRs.  \c rdata can be NULL if
+    /// the type is not SOA.  \c post_parsing is false if it's called before
+    /// parsing the RDATA (see \c limitTTL()).
     const RRTTL& getCurrentTTL(bool explicit_ttl, const RRType& rrtype,
-                               const rdata::ConstRdataPtr& rdata) {
-        // We've completed parsing the full of RR, and the lexer is already
+                               const rdata::ConstRdataPtr& rdata,
+                               bool post_parsing = true) {
+        // If we've completed parsing the full of RR, the lexer is already
         // positioned at the next line.  If we need to call callback,
         // we need to adjust the line number.
-        const size_t current_line = lexer_.getSourceLine() - 1;
+        const size_t current_line = lexer_.getSourceLine() -
+            (post_parsing ? 1 : 0);
 
         if (!current_ttl_ && !default_ttl_) {
             if (rrtype == RRType::SOA()) {
@@ -431,8 +435,10 @@ private:
                 assignTTL(current_ttl_, *default_ttl_);
             } else {
                 // On catching the exception we'll try to reach EOL again,
-                // so we need to unget it now.
-                lexer_.ungetToken();
+                // so we need to unget it now (if we've read it).
+                if (post_parsing) {
+                    lexer_.ungetToken();
+                }
                 throw InternalException(__FILE__, __LINE__,
                                         "no TTL specified; load rejected");
             }
@@ -551,6 +557,8 @@ public:
     bool warn_rfc1035_ttl_;     // should warn if implicit TTL determination
                                 // from the previous RR is used.
     size_t rr_count_;    // number of RRs successfully loaded
+    AddRRTextCallback add_text_callback_; // See setAddRRTextCallback()
+    boost::function<bool(const RRType&)> use_text_;
 };
 
 namespace { // begin unnamed namespace
@@ -972,6 +980,22 @@ MasterLoader::MasterLoaderImpl::loadIncremental(size_t count_limit) {
             const RRType rrtype = parseRRParams(explicit_ttl, next_token);
             // TODO: Check if it is SOA, it should be at the origin.
 
+            if (!add_text_callback_.empty() && rrtype != RRType::SOA() &&
+                use_text_(rrtype)) {
+                // The RDATA is left to the callback, so the TTL has to be
+                // determined before parsing it.  Errors in the RDATA are
+                // caught below.
+                add_text_callback_(*last_name_, zone_class_, rrtype,
+                                   getCurrentTTL(explicit_ttl, rrtype,
+                                                 rdata::ConstRdataPtr(),
+                                                 false),
+                                   lexer_, &active_origin_);
+                eatUntilEOL(true);
+                ++count;
+                ++rr_count_;
+                continue;
+            }
+
             const rdata::RdataPtr rdata =
                 rdata::createRdata(rrtype, zone_class_, lexer_,
                                    &active_origin_, options_, callbacks_);
@@ -1055,6 +1079,18 @@ MasterLoader::~MasterLoader() {
     delete impl_;
 }
 
+void
+MasterLoader::setAddRRTextCallback(
+    const AddRRTextCallback& callback,
+    const boost::function<bool(const RRType&)>& use_text)
+{
+    if (callback.empty() || use_text.empty()) {
+        bundy_throw(bundy::InvalidParameter, "Empty add RR text callback");
+    }
+    impl_->add_text_callback_ = callback;
+    impl_->use_text_ = use_text;
+}
+
 bool
 MasterLoader::loadIncremental(size_t count_limit) {
     const bool result = impl_->loadIncremental(count_limit);
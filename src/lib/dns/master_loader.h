@@ -102,6 +102,37 @@ public:
     /// \brief Destructor
     ~MasterLoader();
 
+    /// \brief Let the RDATA of some types be added from the text
+    ///
+    /// By default every RR is reported to the add callback given on
+    /// construction, with its RDATA converted into an \c Rdata object.
+    /// Once this is called, RRs of the types for which \c use_text returns
+    /// true are instead reported to \c callback with the lexer positioned
+    /// at the beginning of the RDATA, so the callback can convert the text
+    /// into the form it needs without creating the intermediate object.
+    /// SOA RRs are never reported this way, as the TTL of an SOA RR may
+    /// depend on its RDATA.
+    ///
+    /// The callback must read the entire RDATA, and should add the RR only
+    /// if the RDATA is followed by the end of line (or file), which it must
+    /// leave in the lexer.  If the RDATA is invalid it should throw
+    /// \c DNSTextError or \c MasterLexer::LexerError; this is handled the
+    /// same way as an invalid RDATA for the add callback (see the
+    /// constructor for the \c MANY_ERRORS option).  Any other exception is
+    /// propagated to the caller of \c load() or \c loadIncremental().
+    ///
+    /// This must be called before starting the load.
+    ///
+    /// \throw bundy::InvalidParameter if callback or use_text is empty.
+    ///
+    /// \param callback The callback which would be called with the RRs of
+    ///     the types.
+    /// \param use_text Return true for the RR types to be reported to
+    ///     \c callback.
+    void setAddRRTextCallback(
+        const AddRRTextCallback& callback,
+        const boost::function<bool(const RRType&)>& use_text);
+
     /// \brief Load some RRs
     ///
     /// This method loads at most count_limit RRs and reports them. In case
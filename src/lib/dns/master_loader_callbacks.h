@@ -23,6 +23,7 @@
 
 namespace bundy {
 namespace dns {
+class MasterLexer;
 class Name;
 class RRClass;
 class RRType;
@@ -48,6 +49,26 @@ typedef boost::function<void(const Name& name, const RRClass& rrclass,
                              const rdata::RdataPtr& rdata)>
     AddRRCallback;
 
+/// \brief Type of callback to add a RR from the text of its RDATA.
+///
+/// This type of callback is used by the loader to report another loaded
+/// RR without converting its RDATA into an \c Rdata object; the callback
+/// reads the RDATA from the lexer itself.  See
+/// \c MasterLoader::setAddRRTextCallback() for details.
+///
+/// \param name The domain name where the RR belongs.
+/// \param rrclass The class of the RR.
+/// \param rrtype Type of the RR.
+/// \param rrttl Time to live of the RR.
+/// \param lexer The lexer of the loader, positioned at the beginning of
+///     the RDATA.
+/// \param origin The current origin, for relative domain names in the
+///     RDATA.
+typedef boost::function<void(const Name& name, const RRClass& rrclass,
+                             const RRType& rrtype, const RRTTL& rrttl,
+                             MasterLexer& lexer, const Name* origin)>
+    AddRRTextCallback;
+
 /// \brief Set of issue callbacks for a loader.
 ///
 /// This holds a set of callbacks by which a loader (such as MasterLoader)
@@ -14,6 +14,7 @@
 
 #include <dns/master_loader_callbacks.h>
 #include <dns/master_loader.h>
+#include <dns/master_lexer.h>
 #include <dns/rrtype.h>
 #include <dns/rrset.h>
 #include <dns/rrclass.h>
@@ -27,6 +28,7 @@
 #include <boost/lexical_cast.hpp>
 #include <boost/scoped_ptr.hpp>
 
+#include <functional>
 #include <string>
 #include <vector>
 #include <list>
@@ -73,6 +75,24 @@ public:
         rrsets_.push_back(rrset);
     }
 
+    // A text callback that accepts a single token of RDATA, and adds it
+    // in the same way as addRRset after converting it to an Rdata, with the
+    // origin it was given.
+    void addRRText(const Name& name, const RRClass& rrclass,
+                   const RRType& rrtype, const RRTTL& rrttl,
+                   MasterLexer& lexer, const Name* origin)
+    {
+        const string text =
+            lexer.getNextToken(MasterToken::STRING).getString();
+        const rdata::RdataPtr data(rdata::createRdata(rrtype, rrclass, text));
+        if (lexer.getNextToken().getType() != MasterToken::END_OF_LINE) {
+            bundy_throw(rdata::InvalidRdataText, "extra text");
+        }
+        lexer.ungetToken();
+        addRRset(name, rrclass, rrtype, rrttl, data);
+        text_origins_.push_back(*origin);
+    }
+
     void setLoader(const char* file, const Name& origin,
                    const RRClass& rrclass, const MasterLoader::Options options)
     {
@@ -146,6 +166,7 @@ public:
     vector<string> errors_;
     vector<string> warnings_;
     list<RRsetPtr> rrsets_;
+    vector<Name> text_origins_;
 };
 
 // Test simple loading. The zone file contains no tricky things, and nothing is
@@ -1226,6 +1247,60 @@ TEST_F(MasterLoaderTest, ttlFromPrevious) {
     checkCallbackMessage(warnings_.at(0), "using RFC1035 TTL semantics", 2);
 }
 
+// RRs of the given types are passed to the text callback, and the others
+// to the normal callback.
+TEST_F(MasterLoaderTest, addRRTextCallback) {
+    stringstream zone_stream(
+        prepareZone("www.example.org. 1800 IN A 192.0.2.1\n"
+                    "www.example.org. IN AAAA 2001:db8::1\n"
+                    "$ORIGIN sub.example.org.\n"
+                    "mail IN A 192.0.2.2\n"
+                    "bad IN A 192.0.2\n"
+                    "extra IN A 192.0.2.3 192.0.2.4\n"
+                    "@ IN A 192.0.2.5", true));
+    setLoader(zone_stream, Name("example.org."), RRClass::IN(),
+              MasterLoader::MANY_ERRORS);
+    loader_->setAddRRTextCallback(
+        boost::bind(&MasterLoaderTest::addRRText, this, _1, _2, _3, _4, _5,
+                    _6),
+        boost::bind(std::equal_to<RRType>(), RRType::A(), _1));
+    loader_->load();
+    EXPECT_FALSE(loader_->loadedSucessfully());
+
+    // SOA is always passed to the normal callback.
+    checkRR("example.org", RRType::SOA(), "ns1.example.org. "
+            "admin.example.org. 1234 3600 1800 2419200 7200");
+    checkRR("www.example.org", RRType::A(), "192.0.2.1", RRTTL(1800));
+    checkRR("www.example.org", RRType::AAAA(), "2001:db8::1", RRTTL(1800));
+    checkRR("mail.sub.example.org", RRType::A(), "192.0.2.2", RRTTL(1800));
+    checkRR("sub.example.org", RRType::A(), "192.0.2.5", RRTTL(1800));
+    checkRR("correct.sub.example.org", RRType::A(), "192.0.2.2");
+
+    // The text callback was given the current origin.
+    ASSERT_EQ(4, text_origins_.size());
+    EXPECT_EQ(Name("example.org"), text_origins_[0]);
+    EXPECT_EQ(Name("sub.example.org"), text_origins_[1]);
+
+    // Errors from the callback are reported with the correct line.
+    ASSERT_EQ(2, errors_.size());
+    checkCallbackMessage(errors_.at(0), "Bad IN/A RDATA text", 6);
+    checkCallbackMessage(errors_.at(1), "extra text", 7);
+    // The TTL is determined before the RDATA, for the correct line, too.
+    ASSERT_EQ(1, warnings_.size());
+    checkCallbackMessage(warnings_.at(0), "using RFC1035 TTL semantics", 3);
+
+    // Empty callbacks are rejected.
+    EXPECT_THROW(loader_->setAddRRTextCallback(
+                     AddRRTextCallback(),
+                     boost::bind(std::equal_to<RRType>(), RRType::A(), _1)),
+                 bundy::InvalidParameter);
+    EXPECT_THROW(loader_->setAddRRTextCallback(
+                     boost::bind(&MasterLoaderTest::addRRText, this, _1, _2,
+                                 _3, _4, _5, _6),
+                     boost::function<bool(const RRType&)>()),
+                 bundy::InvalidParameter);
+}
+
 TEST_F(MasterLoaderTest, RRParamsOrdering) {
     // We test the order and existence of TTL, class and type. See
     // MasterLoader::MasterLoaderImpl::parseRRParams() for ordering.
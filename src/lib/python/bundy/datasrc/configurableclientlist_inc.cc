@@ -53,6 +53,29 @@ Parameters:\n\
   config_params     The configuration for the new memory segment, as a JSON encoded string.\n\
 ";
 
+const char* const ConfigurableClientList_compact_memory_segment_doc = "\
+compact_memory_segment(datasrc_name, config_params) -> \
+((size, free_size), (size, free_size)) or None\n\
+\n\
+This method rebuilds the in-memory cache of a data source in a fresh\n\
+memory segment.\n\
+\n\
+All zones in the current segment of the data source are copied, in\n\
+DNSSEC order, into a new segment created with config_params, and the\n\
+data source is then reset to use the new segment in the READ_WRITE\n\
+mode.  The zones are copied from the cache, not from the underlying\n\
+data source.  config_params must specify a different segment than\n\
+the current one.\n\
+\n\
+It returns the total and free sizes of the old and new segments (0 if\n\
+the type of segment can't tell them), or None if the data source\n\
+doesn't exist or doesn't have a usable cache.\n\
+\n\
+Parameters:\n\
+  datasrc_name      The name of the data source whose cache to rebuild.\n\
+  config_params     The configuration for the new memory segment, as a JSON encoded string.\n\
+";
+
 const char* const ConfigurableClientList_get_zone_table_accessor_doc = "\
 get_zone_table_accessor(datasrc_name, use_cache) -> \
 bundy.datasrc.ZoneTableAccessor\n\
@@ -93,6 +116,57 @@ Parameters:\n\
   datasrc_name      The name of the data source where the zone is to be loaded (optional).\n\
 ";
 
+const char* const ConfigurableClientList_is_cached_zone_up_to_date_doc = "\
+is_cached_zone_up_to_date(zone, datasrc_name) -> bool\n\
+\n\
+Check if the cached copy of a zone matches its source.\n\
+\n\
+This compares the SOA serial of the zone as currently held in the cache\n\
+of the data source of the given name with the SOA serial provided by the\n\
+underlying data source. For MasterFiles data sources the serial is read\n\
+from the master file, which must also be older than the mapped segment.\n\
+Only the serial (and the file modification time) is compared, not the\n\
+zone content. It returns False whenever it cannot positively tell the\n\
+copies are identical, so the caller can always safely (re)load the zone\n\
+on False.\n\
+\n\
+Parameters:\n\
+  zone              The origin of the zone to check.\n\
+  datasrc_name      The name of the data source holding the zone.\n\
+";
+
+const char* const ConfigurableClientList_remove_unconfigured_cached_zones_doc = "\
+remove_unconfigured_cached_zones(datasrc_name) -> int\n\
+\n\
+Remove the zones no longer configured from the cache.\n\
+\n\
+A persistent (mapped) cache segment reopened by a new run can still hold\n\
+zones that have since been removed from the configuration of the data\n\
+source. This removes every zone that isn't to be cached from the cache of\n\
+the data source of the given name. Nothing is done unless the cache\n\
+segment is writable.\n\
+\n\
+Parameters:\n\
+  datasrc_name      The name of the data source.\n\
+\n\
+Return Value(s): The number of the zones removed.\n\
+";
+
+const char* const ConfigurableClientList_get_cached_zone_names_doc = "\
+get_cached_zone_names(datasrc_name) -> list of bundy.dns.Name\n\
+\n\
+Return the names of the zones held in a cache.\n\
+\n\
+Unlike get_zone_table_accessor(), which lists the zones configured to be\n\
+cached, this lists the zones actually in the zone table of the cache\n\
+segment, e.g., of a mapped image built by another process. The list is in\n\
+no particular order, and is empty if the data source doesn't exist,\n\
+doesn't have a cache or its cache segment isn't usable.\n\
+\n\
+Parameters:\n\
+  datasrc_name      The name of the data source.\n\
+";
+
 const char* const ConfigurableClientList_get_status_doc = "\
 get_status() -> list of tuples\n\
 \n\
@@ -157,6 +157,41 @@ ConfigurableClientList_resetMemorySegment(PyObject* po_self, PyObject* args) {
     return (NULL);
 }
 
+PyObject*
+ConfigurableClientList_compactMemorySegment(PyObject* po_self, PyObject* args) {
+    s_ConfigurableClientList* self =
+        static_cast<s_ConfigurableClientList*>(po_self);
+    try {
+        const char* datasrc_name_p;
+        const char* config_p;
+        if (PyArg_ParseTuple(args, "ss", &datasrc_name_p, &config_p)) {
+            const bundy::data::ConstElementPtr
+                config(bundy::data::Element::fromJSON(std::string(config_p)));
+            ConfigurableClientList::SegmentSize before, after;
+            if (!self->cppobj->compactMemorySegment(datasrc_name_p, config,
+                                                    before, after)) {
+                Py_RETURN_NONE;
+            }
+            return (Py_BuildValue("((nn)(nn))",
+                                  static_cast<Py_ssize_t>(before.size),
+                                  static_cast<Py_ssize_t>(before.free_size),
+                                  static_cast<Py_ssize_t>(after.size),
+                                  static_cast<Py_ssize_t>(after.free_size)));
+        }
+    } catch (const bundy::data::JSONError& jse) {
+        const string ex_what(std::string("JSON parse error in memory segment"
+                               " configuration: ") + jse.what());
+        PyErr_SetString(getDataSourceException("Error"), ex_what.c_str());
+    } catch (const std::exception& exc) {
+        PyErr_SetString(getDataSourceException("Error"), exc.what());
+    } catch (...) {
+        PyErr_SetString(getDataSourceException("Error"),
+                        "Unknown C++ exception");
+    }
+
+    return (NULL);
+}
+
 PyObject*
 ConfigurableClientList_getCachedZoneWriter(PyObject* po_self, PyObject* args) {
     s_ConfigurableClientList* self =
@@ -207,6 +242,93 @@ ConfigurableClientList_getCachedZoneWriter(PyObject* po_self, PyObject* args) {
     }
 }
 
+PyObject*
+ConfigurableClientList_isCachedZoneUpToDate(PyObject* po_self,
+                                            PyObject* args)
+{
+    s_ConfigurableClientList* self =
+        static_cast<s_ConfigurableClientList*>(po_self);
+    try {
+        PyObject* name_obj;
+        const char* datasrc_name_p;
+        if (PyArg_ParseTuple(args, "O!s", &bundy::dns::python::name_type,
+                             &name_obj, &datasrc_name_p)) {
+            const bundy::dns::Name&
+                name(bundy::dns::python::PyName_ToName(name_obj));
+            if (self->cppobj->isCachedZoneUpToDate(name, datasrc_name_p)) {
+                Py_RETURN_TRUE;
+            } else {
+                Py_RETURN_FALSE;
+            }
+        } else {
+            return (NULL);
+        }
+    } catch (const std::exception& exc) {
+        PyErr_SetString(getDataSourceException("Error"), exc.what());
+        return (NULL);
+    } catch (...) {
+        PyErr_SetString(getDataSourceException("Error"),
+                        "Unknown C++ exception");
+        return (NULL);
+    }
+}
+
+PyObject*
+ConfigurableClientList_removeUnconfiguredCachedZones(PyObject* po_self,
+                                                     PyObject* args)
+{
+    s_ConfigurableClientList* self =
+        static_cast<s_ConfigurableClientList*>(po_self);
+    try {
+        const char* datasrc_name_p;
+        if (PyArg_ParseTuple(args, "s", &datasrc_name_p)) {
+            const size_t count =
+                self->cppobj->removeUnconfiguredCachedZones(datasrc_name_p);
+            return (Py_BuildValue("n", static_cast<Py_ssize_t>(count)));
+        } else {
+            return (NULL);
+        }
+    } catch (const std::exception& exc) {
+        PyErr_SetString(getDataSourceException("Error"), exc.what());
+        return (NULL);
+    } catch (...) {
+        PyErr_SetString(getDataSourceException("Error"),
+                        "Unknown C++ exception");
+        return (NULL);
+    }
+}
+
+PyObject*
+ConfigurableClientList_getCachedZoneNames(PyObject* po_self, PyObject* args) {
+    s_ConfigurableClientList* self =
+        static_cast<s_ConfigurableClientList*>(po_self);
+    try {
+        const char* datasrc_name_p;
+        if (PyArg_ParseTuple(args, "s", &datasrc_name_p)) {
+            const std::vector<bundy::dns::Name> names =
+                self->cppobj->getCachedZoneNames(datasrc_name_p);
+            PyObjectContainer nlist(PyList_New(names.size()));
+            for (size_t i = 0; i < names.size(); ++i) {
+                // The following "steals" the reference, so we must not
+                // decref.
+                PyList_SET_ITEM(nlist.get(), i,
+                                bundy::dns::python::createNameObject(
+                                    names[i]));
+            }
+            return (nlist.release());
+        } else {
+            return (NULL);
+        }
+    } catch (const std::exception& exc) {
+        PyErr_SetString(getDataSourceException("Error"), exc.what());
+        return (NULL);
+    } catch (...) {
+        PyErr_SetString(getDataSourceException("Error"),
+                        "Unknown C++ exception");
+        return (NULL);
+    }
+}
+
 PyObject*
 ConfigurableClientList_getStatus(PyObject* po_self, PyObject*) {
     s_ConfigurableClientList* self =
@@ -344,10 +466,21 @@ PyMethodDef ConfigurableClientList_methods[] = {
       METH_VARARGS, ConfigurableClientList_configure_doc },
     { "reset_memory_segment", ConfigurableClientList_resetMemorySegment,
       METH_VARARGS, ConfigurableClientList_reset_memory_segment_doc },
+    { "compact_memory_segment", ConfigurableClientList_compactMemorySegment,
+      METH_VARARGS, ConfigurableClientList_compact_memory_segment_doc },
     { "get_zone_table_accessor", ConfigurableClientList_getZoneTableAccessor,
       METH_VARARGS, ConfigurableClientList_get_zone_table_accessor_doc },
     { "get_cached_zone_writer", ConfigurableClientList_getCachedZoneWriter,
       METH_VARARGS, ConfigurableClientList_get_cached_zone_writer_doc },
+    { "is_cached_zone_up_to_date",
+      ConfigurableClientList_isCachedZoneUpToDate,
+      METH_VARARGS, ConfigurableClientList_is_cached_zone_up_to_date_doc },
+    { "remove_unconfigured_cached_zones",
+      ConfigurableClientList_removeUnconfiguredCachedZones,
+      METH_VARARGS,
+      ConfigurableClientList_remove_unconfigured_cached_zones_doc },
+    { "get_cached_zone_names", ConfigurableClientList_getCachedZoneNames,
+      METH_VARARGS, ConfigurableClientList_get_cached_zone_names_doc },
     { "get_status", ConfigurableClientList_getStatus,
       METH_NOARGS, ConfigurableClientList_get_status_doc },
     { "find", ConfigurableClientList_find,
@@ -275,6 +275,54 @@ class ClientListTest(unittest.TestCase):
         # The segment is still in READ_ONLY mode.
         self.find_helper()
 
+    def test_is_cached_zone_up_to_date(self):
+        """
+        Test the arguments of is_cached_zone_up_to_date.  The MasterFiles
+        data source here uses a local segment, which has no file to compare
+        the master file with, so its zones are never considered up to date.
+        """
+        self.clist = bundy.datasrc.ConfigurableClientList(bundy.dns.RRClass.IN)
+        self.configure_helper()
+        self.assertFalse(self.clist.is_cached_zone_up_to_date(
+                bundy.dns.Name("example.com"), "MasterFiles"))
+        self.assertFalse(self.clist.is_cached_zone_up_to_date(
+                bundy.dns.Name("example.com"), "nosuchdatasrc"))
+        self.assertRaises(TypeError, self.clist.is_cached_zone_up_to_date,
+                          "example.com", "MasterFiles")
+        self.assertRaises(TypeError, self.clist.is_cached_zone_up_to_date,
+                          bundy.dns.Name("example.com"))
+
+    def test_remove_unconfigured_cached_zones(self):
+        """
+        Test the arguments of remove_unconfigured_cached_zones.  A freshly
+        configured local cache only has the configured zones.
+        """
+        self.clist = bundy.datasrc.ConfigurableClientList(bundy.dns.RRClass.IN)
+        self.configure_helper()
+        self.assertEqual(0, self.clist.remove_unconfigured_cached_zones(
+                "MasterFiles"))
+        self.assertEqual(0, self.clist.remove_unconfigured_cached_zones(
+                "nosuchdatasrc"))
+        self.assertRaises(TypeError,
+                          self.clist.remove_unconfigured_cached_zones)
+        self.assertRaises(TypeError,
+                          self.clist.remove_unconfigured_cached_zones, 1)
+        self.find_helper()
+
+    def test_get_cached_zone_names(self):
+        """
+        Test get_cached_zone_names lists the zones in the cache.
+        """
+        self.clist = bundy.datasrc.ConfigurableClientList(bundy.dns.RRClass.IN)
+        self.assertEqual([], self.clist.get_cached_zone_names("MasterFiles"))
+        self.configure_helper()
+        self.assertEqual([bundy.dns.Name("example.com")],
+                         self.clist.get_cached_zone_names("MasterFiles"))
+        self.assertEqual([], self.clist.get_cached_zone_names(
+                "nosuchdatasrc"))
+        self.assertRaises(TypeError, self.clist.get_cached_zone_names)
+        self.assertRaises(TypeError, self.clist.get_cached_zone_names, 1)
+
     def test_zone_writer_load_twice(self):
         """
         Test that the zone writer throws when load() is called more than
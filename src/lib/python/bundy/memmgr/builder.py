@@ -100,12 +100,26 @@ class MemorySegmentBuilder:
                                    ConfigurableClientList.READ_WRITE,
                                    params)
 
-        if zone_name is not None:
+        load_all = zone_name is None
+        if not load_all:
             zones = [(None, zone_name)]
         else:
             zones = clist.get_zone_table_accessor(dsrc_name, True)
+            # On the initial load the segment file may have been left by a
+            # previous run, and have zones no longer configured; they must
+            # not be served any more.
+            clist.remove_unconfigured_cached_zones(dsrc_name)
 
         for _, zone_name in zones:
+            # The zones in such a segment that haven't changed since then
+            # don't have to be loaded again.
+            if (load_all and
+                clist.is_cached_zone_up_to_date(zone_name, dsrc_name)):
+                logger.debug(logger.DBGLVL_TRACE_BASIC,
+                             LIBMEMMGR_BUILDER_ZONE_UP_TO_DATE, zone_name,
+                             dsrc_name)
+                continue
+
             catch_load_error = (zone_name is None) # install empty zone initially
             result, writer = clist.get_cached_zone_writer(zone_name, catch_load_error,
                                                           dsrc_name)
@@ -134,6 +148,48 @@ class MemorySegmentBuilder:
         self._response_queue.append(('load-completed', dsrc_info, rrclass,
                                      dsrc_name))
 
+    def __handle_compact(self, dsrc_info, rrclass, dsrc_name):
+        # This method is called when handling the 'compact' command. The
+        # following tuple is passed:
+        #
+        # ('compact', dsrc_info, rrclass, dsrc_name)
+        #
+        # where the arguments are the same as those for the 'load'
+        # command.
+        #
+        # The zones are copied from the current reader version of the
+        # segment into a newly created writer version, so the result has
+        # the same content as the reader version without its holes.
+        clist = dsrc_info.clients_map[rrclass]
+        sgmt_info = dsrc_info.segment_info_map[(rrclass, dsrc_name)]
+        reader_params = sgmt_info.get_reset_param(SegmentInfo.READER)
+        params = json.dumps(sgmt_info.get_reset_param(SegmentInfo.WRITER))
+        result = None
+        if reader_params is not None:
+            try:
+                clist.reset_memory_segment(dsrc_name,
+                                           ConfigurableClientList.READ_ONLY,
+                                           json.dumps(reader_params))
+                result = clist.compact_memory_segment(dsrc_name, params)
+            except Exception as e:
+                logger.error(LIBMEMMGR_BUILDER_COMPACT_ERROR, dsrc_name,
+                             rrclass, str(e))
+        if result is None:
+            # The writer version must be complete whatever happens, as
+            # readers will be switched to it; fall back to a full load.
+            self.__handle_load(None, dsrc_info, rrclass, dsrc_name)
+            return
+
+        (before_size, before_free), (after_size, after_free) = result
+        logger.info(LIBMEMMGR_BUILDER_COMPACTED, dsrc_name, rrclass,
+                    before_size, before_free, after_size, after_free)
+        clist.reset_memory_segment(dsrc_name,
+                                   ConfigurableClientList.READ_ONLY,
+                                   params)
+
+        self._response_queue.append(('load-completed', dsrc_info, rrclass,
+                                     dsrc_name))
+
     def run(self):
         """ This is the method invoked when the builder thread is
             started.  In this thread, be careful when modifying
@@ -166,6 +222,10 @@ class MemorySegmentBuilder:
                         # command.
                         _, zone_name, dsrc_info, rrclass, dsrc_name = command_tuple
                         self.__handle_load(zone_name, dsrc_info, rrclass, dsrc_name)
+                    elif command == 'compact':
+                        # See the comments for __handle_compact().
+                        _, dsrc_info, rrclass, dsrc_name = command_tuple
+                        self.__handle_compact(dsrc_info, rrclass, dsrc_name)
                     elif command == 'shutdown':
                         self.__handle_shutdown()
                         # When the shutdown command is received, we do
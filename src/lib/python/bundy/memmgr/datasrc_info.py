@@ -340,6 +340,15 @@ class MappedSegmentInfo(SegmentInfo):
             'zone-' + str(rrclass) + '-' + str(genid) + '-' + datasrc_name + \
             '-mapped'
 
+        # Options on how the mapped memory is backed, passed to all users
+        # of the segment; see the description of "huge-pages" and
+        # "prefault" for ZoneTableSegmentMapped::reset().
+        self.__memory_options = {}
+        if mgr_config.get('mapped_huge_pages'):
+            self.__memory_options['huge-pages'] = True
+        if mgr_config.get('mapped_prefault'):
+            self.__memory_options['prefault'] = True
+
         # Current versions (suffix of the mapped files) for readers and the
         # writer.  In this initial implementation we assume that all possible
         # readers are waiting for a new version (not using pre-existing one),
@@ -353,7 +362,9 @@ class MappedSegmentInfo(SegmentInfo):
         if ver is None:
             return None
         mapped_file = self.__mapped_file_base + '.' + str(ver)
-        return {'mapped-file': mapped_file}
+        param = {'mapped-file': mapped_file}
+        param.update(self.__memory_options)
+        return param
 
     def _switch_versions(self):
         # Swith the versions as noted in the constructor.
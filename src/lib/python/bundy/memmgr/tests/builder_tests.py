@@ -234,6 +234,146 @@ class TestMemorySegmentBuilder(unittest.TestCase):
         self.assertEqual(len(self._builder_command_queue), 0)
         self.assertEqual(len(self._builder_response_queue), 0)
 
+    def __run_builder_command(self, command):
+        # Send a command to the running builder thread and wait for its
+        # response, which is returned.
+        with self._builder_cv:
+            self._builder_command_queue.append(command)
+            self._builder_cv.notify_all()
+
+        (reads, _, _) = select.select([self._master_sock], [], [], 60)
+        self.assertTrue(self._master_sock in reads)
+        self.assertEqual(b'x', self._master_sock.recv(1))
+
+        with self._builder_lock:
+            self.assertEqual(len(self._builder_command_queue), 0)
+            self.assertEqual(len(self._builder_response_queue), 1)
+            response = self._builder_response_queue[0]
+            del self._builder_response_queue[:]
+        return response
+
+    def test_compact(self):
+        """
+        Test "compact" command.
+        """
+
+        mapped_file_dir = os.environ['TESTDATA_WRITE_PATH']
+        mgr_config = {'mapped_file_dir': mapped_file_dir}
+
+        cfg_data = MockConfigData(
+            {"classes":
+                 {"IN": [{"type": "MasterFiles",
+                          "params": { "example.com": TESTDATA_PATH + "example.com.zone" },
+                          "cache-enable": True,
+                          "cache-type": "mapped"}]
+                  }
+             })
+        cmgr = DataSrcClientsMgr(use_cache=True)
+        cmgr.reconfigure({}, cfg_data)
+
+        genid, clients_map = cmgr.get_clients_map()
+        datasrc_info = DataSrcInfo(genid, clients_map, mgr_config)
+        sgmt_info = datasrc_info.segment_info_map[(RRClass.IN, 'MasterFiles')]
+        self.__mapped_file_path = \
+            sgmt_info.get_reset_param(SegmentInfo.WRITER)['mapped-file']
+
+        self._builder_thread.start()
+
+        # Load the zone into the first version of the segment, and switch
+        # the versions as memmgr would do, so it becomes the reader version.
+        load_event = ('load', None, datasrc_info, RRClass.IN, 'MasterFiles')
+        sgmt_info.add_event(load_event)
+        self.assertEqual(load_event, sgmt_info.start_update())
+        self.assertTupleEqual(('load-completed', datasrc_info, RRClass.IN,
+                               'MasterFiles'),
+                              self.__run_builder_command(load_event))
+        sgmt_info.complete_update()
+        reader_file = self.__mapped_file_path
+        self.__mapped_file_path = \
+            sgmt_info.get_reset_param(SegmentInfo.WRITER)['mapped-file']
+        self.assertNotEqual(reader_file, self.__mapped_file_path)
+
+        # The zone is copied from the reader version into the writer
+        # version, and the data source is left using the latter.
+        try:
+            self.assertTupleEqual(
+                ('load-completed', datasrc_info, RRClass.IN, 'MasterFiles'),
+                self.__run_builder_command(('compact', datasrc_info,
+                                            RRClass.IN, 'MasterFiles')))
+            self.assertTrue(os.path.exists(self.__mapped_file_path))
+            clist = datasrc_info.clients_map[RRClass.IN]
+            dsrc, finder, exact = clist.find(bundy.dns.Name("example.com"))
+            self.assertIsNotNone(finder)
+            self.assertTrue(exact)
+        finally:
+            os.unlink(reader_file)
+
+        with self._builder_cv:
+            self._builder_command_queue.append(('shutdown',))
+            self._builder_cv.notify_all()
+        self._builder_thread.join(5)
+        self.assertFalse(self._builder_thread.isAlive())
+
+    @unittest.skipIf(os.environ['HAVE_SHARED_MEMORY'] != 'yes',
+                     'shared memory is not available')
+    def test_load_removed_zone(self):
+        """
+        Test "load" command for all zones into the segment file left by a
+        previous run, which has a zone that is no longer configured.
+        """
+
+        mapped_file_dir = os.environ['TESTDATA_WRITE_PATH']
+        mgr_config = {'mapped_file_dir': mapped_file_dir}
+
+        def load_zones(zones):
+            params = {}
+            for zone in zones:
+                params[zone] = TESTDATA_PATH + zone + '.zone'
+            cfg_data = MockConfigData(
+                {"classes":
+                     {"IN": [{"type": "MasterFiles",
+                              "params": params,
+                              "cache-enable": True,
+                              "cache-type": "mapped"}]
+                      }
+                 })
+            cmgr = DataSrcClientsMgr(use_cache=True)
+            cmgr.reconfigure({}, cfg_data)
+            genid, clients_map = cmgr.get_clients_map()
+            datasrc_info = DataSrcInfo(genid, clients_map, mgr_config)
+            sgmt_info = \
+                datasrc_info.segment_info_map[(RRClass.IN, 'MasterFiles')]
+            self.__mapped_file_path = \
+                sgmt_info.get_reset_param(SegmentInfo.WRITER)['mapped-file']
+            self.assertTupleEqual(
+                ('load-completed', datasrc_info, RRClass.IN, 'MasterFiles'),
+                self.__run_builder_command(('load', None, datasrc_info,
+                                            RRClass.IN, 'MasterFiles')))
+            return datasrc_info.clients_map[RRClass.IN]
+
+        self._builder_thread.start()
+
+        clist = load_zones(['example.com', 'example.org'])
+        dsrc, finder, exact = clist.find(bundy.dns.Name("example.org"))
+        self.assertIsNotNone(finder)
+        self.assertTrue(exact)
+        del clist
+
+        # The next run (of the same generation, so it uses the same file)
+        # only has one of the zones.
+        clist = load_zones(['example.com'])
+        dsrc, finder, exact = clist.find(bundy.dns.Name("example.com"))
+        self.assertIsNotNone(finder)
+        self.assertTrue(exact)
+        dsrc, finder, exact = clist.find(bundy.dns.Name("example.org"))
+        self.assertIsNone(finder)
+
+        with self._builder_cv:
+            self._builder_command_queue.append(('shutdown',))
+            self._builder_cv.notify_all()
+        self._builder_thread.join(5)
+        self.assertFalse(self._builder_thread.isAlive())
+
 if __name__ == "__main__":
     bundy.log.init("bundy-test")
     bundy.log.resetUnitTestRootLogger()
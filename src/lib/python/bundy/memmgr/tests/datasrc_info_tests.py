@@ -56,6 +56,23 @@ class TestSegmentInfo(unittest.TestCase):
                          '/zone-IN-0-sqlite3-mapped.' + str(expected_ver),
                          param['mapped-file'])
 
+    def test_memory_options(self):
+        # By default no memory option is passed.
+        param = self.__sgmt_info.get_reset_param(SegmentInfo.WRITER)
+        self.assertNotIn('huge-pages', param)
+        self.assertNotIn('prefault', param)
+
+        # If enabled in the memmgr configuration, they are passed to both
+        # the writer and readers.
+        sgmt_info = SegmentInfo.create('mapped', 0, RRClass.IN, 'sqlite3',
+                                       {'mapped_file_dir':
+                                            self.__mapped_file_dir,
+                                        'mapped_huge_pages': True,
+                                        'mapped_prefault': True})
+        param = sgmt_info.get_reset_param(SegmentInfo.WRITER)
+        self.assertTrue(param['huge-pages'])
+        self.assertTrue(param['prefault'])
+
     def test_initial_params(self):
         self.__check_sgmt_reset_param(SegmentInfo.WRITER, 0)
         self.__check_sgmt_reset_param(SegmentInfo.READER, None)
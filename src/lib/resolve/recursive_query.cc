@@ -305,6 +305,11 @@ private:
     // sent to this object as well as being used to update the NSAS.
     boost::shared_ptr<RttRecorder> rtt_recorder_;
 
+    // If true, the first lookup doesn't use the cache, so the answer in
+    // it is refreshed (see RecursiveQuery::prefetch()).  The lookups of
+    // the CNAME targets, if any, use the cache as usual.
+    bool skip_cache_;
+
     // perform a single lookup; first we check the cache to see
     // if we have a response for our query stored already. if
     // so, call handlerecursiveresponse(), if not, we call send()
@@ -314,16 +319,25 @@ private:
 
         Message cached_message(Message::RENDER);
         bundy::resolve::initResponseMessage(question_, cached_message);
-        if (cache_.lookup(question_.getName(), question_.getType(),
+        const bool skip_cache = skip_cache_;
+        skip_cache_ = false;
+        if (!skip_cache &&
+            cache_.lookup(question_.getName(), question_.getType(),
                           question_.getClass(), cached_message)) {
 
             LOG_DEBUG(bundy::resolve::logger, RESLIB_DBG_CACHE, RESLIB_RUNQ_CACHE_FIND)
                       .arg(questionText(question_));
             // Should these be set by the cache too?
             cached_message.setOpcode(Opcode::QUERY());
-            cached_message.setRcode(Rcode::NOERROR());
             cached_message.setHeaderFlag(Message::HEADERFLAG_QR);
-            if (handleRecursiveAnswer(cached_message)) {
+            if (cached_message.getRcode() == Rcode::NXDOMAIN()) {
+                // The name (or one above it) is known not to exist, and
+                // that's already in the cache.
+                bundy::resolve::copyResponseMessage(cached_message,
+                                                    answer_message_);
+                callCallback(true);
+                stop();
+            } else if (handleRecursiveAnswer(cached_message)) {
                 callCallback(true);
                 stop();
             }
@@ -464,8 +478,17 @@ private:
             break;
 
         case bundy::resolve::ResponseClassifier::NXDOMAIN:
+            // Received NXDOMAIN, copy and return.  The cache answers the
+            // other types of the name and the names below it from this too.
+            LOG_DEBUG(bundy::resolve::logger, RESLIB_DBG_RESULTS, RESLIB_NXDOM_NXRR)
+                      .arg(questionText(question_));
+            bundy::resolve::copyResponseMessage(incoming, answer_message_);
+            cache_.update(incoming);
+            return (true);
+            break;
+
         case bundy::resolve::ResponseClassifier::NXRRSET:
-            // Received NXDOMAIN or NXRRSET, just copy and return
+            // Received NXRRSET, just copy and return
             LOG_DEBUG(bundy::resolve::logger, RESLIB_DBG_RESULTS, RESLIB_NXDOM_NXRR)
                       .arg(questionText(question_));
             bundy::resolve::copyResponseMessage(incoming, answer_message_);
@@ -676,7 +699,8 @@ public:
         unsigned retries,
         bundy::nsas::NameserverAddressStore& nsas,
         bundy::cache::ResolverCache& cache,
-        boost::shared_ptr<RttRecorder>& recorder)
+        boost::shared_ptr<RttRecorder>& recorder,
+        bool skip_cache = false)
         :
         io_(io),
         question_(question),
@@ -699,7 +723,8 @@ public:
         nsas_callback_(),
         nsas_callback_out_(false),
         outstanding_events_(0),
-        rtt_recorder_(recorder)
+        rtt_recorder_(recorder),
+        skip_cache_(skip_cache)
     {
         // Set here to avoid using "this" in initializer list.
         nsas_callback_.reset(new ResolverNSASCallback(this));
@@ -1089,15 +1114,14 @@ RecursiveQuery::resolve(const QuestionPtr& question,
     // First try to see if we have something cached in the messagecache
     LOG_DEBUG(bundy::resolve::logger, RESLIB_DBG_TRACE, RESLIB_RESOLVE)
               .arg(questionText(*question)).arg(1);
+    // The cache sets the rcode of the message; an NXDOMAIN has no answer.
     if (cache_.lookup(question->getName(), question->getType(),
                       question->getClass(), *answer_message) &&
-        answer_message->getRRCount(Message::SECTION_ANSWER) > 0) {
+        (answer_message->getRRCount(Message::SECTION_ANSWER) > 0 ||
+         answer_message->getRcode() == Rcode::NXDOMAIN())) {
         // Message found, return that
         LOG_DEBUG(bundy::resolve::logger, RESLIB_DBG_CACHE, RESLIB_RECQ_CACHE_FIND)
                   .arg(questionText(*question)).arg(1);
-
-        // TODO: err, should cache set rcode as well?
-        answer_message->setRcode(Rcode::NOERROR());
         callback->success(answer_message);
     } else {
         // Perhaps we only have the one RRset?
@@ -1151,15 +1175,15 @@ RecursiveQuery::resolve(const Question& question,
     LOG_DEBUG(bundy::resolve::logger, RESLIB_DBG_TRACE, RESLIB_RESOLVE)
               .arg(questionText(question)).arg(2);
 
+    // The cache sets the rcode of the message; an NXDOMAIN has no answer.
     if (cache_.lookup(question.getName(), question.getType(),
                       question.getClass(), *answer_message) &&
-        answer_message->getRRCount(Message::SECTION_ANSWER) > 0) {
+        (answer_message->getRRCount(Message::SECTION_ANSWER) > 0 ||
+         answer_message->getRcode() == Rcode::NXDOMAIN())) {
 
         // Message found, return that
         LOG_DEBUG(bundy::resolve::logger, RESLIB_DBG_CACHE, RESLIB_RECQ_CACHE_FIND)
                   .arg(questionText(question)).arg(2);
-        // TODO: err, should cache set rcode as well?
-        answer_message->setRcode(Rcode::NOERROR());
         crs->success(answer_message);
     } else {
         // Perhaps we only have the one RRset?
@@ -1190,6 +1214,26 @@ RecursiveQuery::resolve(const Question& question,
     return (NULL);
 }
 
+AbstractRunningQuery*
+RecursiveQuery::prefetch(const Question& question,
+    const bundy::resolve::ResolverInterface::CallbackPtr callback)
+{
+    IOService& io = dns_service_.getIOService();
+
+    MessagePtr answer_message(new Message(Message::RENDER));
+    bundy::resolve::initResponseMessage(question, *answer_message);
+
+    OutputBufferPtr buffer(new OutputBuffer(0));
+
+    LOG_DEBUG(bundy::resolve::logger, RESLIB_DBG_TRACE, RESLIB_PREFETCH)
+              .arg(questionText(question));
+    // Nobody is waiting for the answer, so there's no client timeout.
+    return (new RunningQuery(io, question, answer_message, test_server_,
+                             buffer, callback, query_timeout_, -1,
+                             lookup_timeout_, retries_, nsas_, cache_,
+                             rtt_recorder_, true));
+}
+
 AbstractRunningQuery*
 RecursiveQuery::forward(ConstMessagePtr query_message,
     MessagePtr answer_message,
@@ -174,6 +174,25 @@ public:
                           bundy::util::OutputBufferPtr buffer,
                           DNSServer* server);
 
+    /// \brief Refresh the answer to the given question in the cache.
+    ///
+    /// This is like the first \c resolve(), except that the cache isn't
+    /// looked up for the question, so the resolution is always started,
+    /// and the answer in the cache, which is about to expire, is replaced
+    /// with a fresh one when it completes (see
+    /// \c bundy::cache::ResolverCache::setPrefetchPolicy()).  The callback
+    /// is only called when the resolution completes or the lookup times
+    /// out, as there's no client waiting for it.
+    ///
+    /// \param question The question to resolve <qname/qclass/qtype>
+    /// \param callback Callback object, called with the answer, which is
+    ///        a SERVFAIL one if the resolution failed.
+    /// \return A pointer to the active AbstractRunningQuery object created
+    ///         by this call; like the one returned by \c resolve(), it
+    ///         deletes itself when done.
+    AbstractRunningQuery* prefetch(const bundy::dns::Question& question,
+        const bundy::resolve::ResolverInterface::CallbackPtr callback);
+
     /// \brief Initiates forwarding for the given query.
     ///
     ///  Others parameters are same with the parameters of
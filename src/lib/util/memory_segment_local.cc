@@ -15,15 +15,125 @@
 #include "memory_segment_local.h"
 #include <exceptions/exceptions.h>
 
+#include <cassert>
+#include <new>
+
+#include <stdlib.h>
+#include <sys/mman.h>
+
 namespace bundy {
 namespace util {
 
+namespace {
+// Size of a chunk for small blocks.
+const size_t CHUNK_SIZE = 256 * 1024;
+
+// Size (and alignment) of a chunk when huge pages are used; this is the
+// (most) common huge page size.
+const size_t HUGE_CHUNK_SIZE = 2 * 1024 * 1024;
+
+const size_t N_SIZE_CLASSES =
+    MemorySegmentLocal::MAX_SMALL_SIZE / MemorySegmentLocal::ALIGNMENT;
+
+// Convert the requested size to the index of its size class.  The
+// class of index i holds blocks of (i + 1) * ALIGNMENT bytes.  0-byte
+// requests are handled as the smallest class.
+inline size_t
+getSizeClass(size_t size) {
+    return (size == 0 ? 0 : (size - 1) / MemorySegmentLocal::ALIGNMENT);
+}
+
+inline size_t
+getClassSize(size_t size_class) {
+    return ((size_class + 1) * MemorySegmentLocal::ALIGNMENT);
+}
+}
+
+const size_t MemorySegmentLocal::ALIGNMENT;
+const size_t MemorySegmentLocal::MAX_SMALL_SIZE;
+
+MemorySegmentLocal::MemorySegmentLocal(bool huge_pages) :
+    allocated_size_(0), huge_pages_(huge_pages),
+    chunk_size_(huge_pages ? HUGE_CHUNK_SIZE : CHUNK_SIZE),
+    free_lists_(N_SIZE_CLASSES, static_cast<void*>(NULL)),
+    chunk_ptr_(NULL), chunk_left_(0), reserved_size_(0)
+{
+    // A free block needs to hold the link to the next one.
+    assert(sizeof(void*) <= ALIGNMENT);
+}
+
+MemorySegmentLocal::~MemorySegmentLocal() {
+    for (std::vector<void*>::const_iterator it = chunks_.begin();
+         it != chunks_.end();
+         ++it) {
+        free(*it);
+    }
+}
+
 void*
-MemorySegmentLocal::allocate(size_t size) {
-    void* ptr = malloc(size);
-    if (ptr == NULL) {
+MemorySegmentLocal::allocateChunk() {
+    void* chunk = NULL;
+    if (huge_pages_) {
+        if (posix_memalign(&chunk, HUGE_CHUNK_SIZE, chunk_size_) != 0) {
+            chunk = NULL;
+        }
+#ifdef MADV_HUGEPAGE
+        if (chunk != NULL) {
+            // This is only advice, so a failure is ignored.
+            madvise(chunk, chunk_size_, MADV_HUGEPAGE);
+        }
+#endif
+    } else {
+        chunk = malloc(chunk_size_);
+    }
+    if (chunk == NULL) {
         throw std::bad_alloc();
     }
+    chunks_.push_back(chunk);
+    reserved_size_ += chunk_size_;
+    return (chunk);
+}
+
+void*
+MemorySegmentLocal::allocateSmall(size_t size_class) {
+    void* ptr = free_lists_[size_class];
+    if (ptr != NULL) {
+        free_lists_[size_class] = *static_cast<void**>(ptr);
+        return (ptr);
+    }
+
+    const size_t block_size = getClassSize(size_class);
+    if (chunk_left_ < block_size) {
+        // The rest of the current chunk is too small for the block.
+        // Rather than keeping it, give it to the free list of the class
+        // it fits in (if any) so it won't be completely wasted.
+        if (chunk_left_ >= ALIGNMENT) {
+            void** const rest = reinterpret_cast<void**>(chunk_ptr_);
+            const size_t rest_class = chunk_left_ / ALIGNMENT - 1;
+            *rest = free_lists_[rest_class];
+            free_lists_[rest_class] = rest;
+        }
+        chunk_ptr_ = static_cast<uint8_t*>(allocateChunk());
+        chunk_left_ = chunk_size_;
+    }
+    ptr = chunk_ptr_;
+    chunk_ptr_ += block_size;
+    chunk_left_ -= block_size;
+    return (ptr);
+}
+
+void*
+MemorySegmentLocal::allocate(size_t size) {
+    void* ptr;
+    if (size <= MAX_SMALL_SIZE) {
+        ptr = allocateSmall(getSizeClass(size));
+    } else {
+        ptr = malloc(size);
+        if (ptr == NULL) {
+            throw std::bad_alloc();
+        }
+        reserved_size_ += size;
+    }
 
     allocated_size_ += size;
     return (ptr);
@@ -43,7 +153,14 @@ MemorySegmentLocal::deallocate(void* ptr, size_t size) {
     }
 
     allocated_size_ -= size;
-    free(ptr);
+    if (size <= MAX_SMALL_SIZE) {
+        const size_t size_class = getSizeClass(size);
+        *static_cast<void**>(ptr) = free_lists_[size_class];
+        free_lists_[size_class] = ptr;
+    } else {
+        reserved_size_ -= size;
+        free(ptr);
+    }
 }
 
 bool
@@ -51,6 +168,15 @@ MemorySegmentLocal::allMemoryDeallocated() const {
     return (allocated_size_ == 0 && named_addrs_.empty());
 }
 
+MemorySegmentLocal::Statistics
+MemorySegmentLocal::getStatistics() const {
+    Statistics stats;
+    stats.allocated_bytes = allocated_size_;
+    stats.reserved_bytes = reserved_size_;
+    stats.wasted_bytes = reserved_size_ - allocated_size_;
+    return (stats);
+}
+
 MemorySegment::NamedAddressResult
 MemorySegmentLocal::getNamedAddressImpl(const char* name) const {
     std::map<std::string, void*>::const_iterator found =
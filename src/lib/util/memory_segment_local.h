@@ -17,30 +17,78 @@
 
 #include <util/memory_segment.h>
 
+#include <boost/noncopyable.hpp>
+
 #include <string>
 #include <map>
+#include <vector>
+
+#include <stdint.h>
 
 namespace bundy {
 namespace util {
 
-/// \brief malloc/free based Memory Segment class
+/// \brief Process-local Memory Segment class
+///
+/// This class specifies a concrete implementation for a process-local
+/// MemorySegment. Please see the MemorySegment class documentation for
+/// usage.
+///
+/// Small blocks (up to \c MAX_SMALL_SIZE bytes, which covers the tree
+/// nodes, names and RdataSets of zone data) are not allocated by
+/// malloc() one by one.  They are rounded up to a multiple of
+/// \c ALIGNMENT and carved from large chunks; each such size class has
+/// its own free list, so a deallocated block is simply pushed to the
+/// list and reused by the next allocation of the same class.  This
+/// avoids per-block malloc overhead and keeps the data of a zone close
+/// together.  Larger blocks are directly allocated by malloc().
 ///
-/// This class specifies a concrete implementation for a malloc/free
-/// based MemorySegment. Please see the MemorySegment class
-/// documentation for usage.
-class MemorySegmentLocal : public MemorySegment {
+/// The chunks are only returned to the system when the segment is
+/// destroyed; as long as the segment is alive, memory released by
+/// destroying a zone is reused for the zones loaded later.
+class MemorySegmentLocal : public MemorySegment, boost::noncopyable {
 public:
+    /// \brief Alignment (and granularity) of small blocks.
+    static const size_t ALIGNMENT = 8;
+
+    /// \brief Largest block size handled by the size-classed chunks.
+    static const size_t MAX_SMALL_SIZE = 1024;
+
+    /// \brief Statistics of the memory held by the segment.
+    struct Statistics {
+        /// Total bytes currently allocated by the application (the sum
+        /// of the sizes passed to allocate() not yet deallocated).
+        size_t allocated_bytes;
+        /// Total bytes obtained from the system for the segment.
+        size_t reserved_bytes;
+        /// Bytes obtained from the system but not available to the
+        /// application: the rounding of small blocks, blocks on free
+        /// lists and unused space in chunks.
+        size_t wasted_bytes;
+    };
+
     /// \brief Constructor
     ///
-    /// Creates a local memory segment object
-    MemorySegmentLocal() : allocated_size_(0) {
-    }
+    /// Creates a local memory segment object.
+    ///
+    /// If \c huge_pages is \c true, the chunks of small blocks are
+    /// allocated as aligned regions of a typical huge page size and the
+    /// system is advised to back them with transparent huge pages (if
+    /// the system supports it; otherwise the option is ignored).
+    ///
+    /// \param huge_pages Whether to use huge pages for the chunks.
+    explicit MemorySegmentLocal(bool huge_pages = false);
 
     /// \brief Destructor
-    virtual ~MemorySegmentLocal() {}
+    ///
+    /// Releases all the chunks to the system.
+    virtual ~MemorySegmentLocal();
 
-    /// \brief Allocate/acquire a segment of memory. The source of the
-    /// memory is libc's malloc().
+    /// \brief Allocate/acquire a segment of memory.
+    ///
+    /// Small blocks are taken from the free list of their size class,
+    /// or carved from a chunk; larger blocks are allocated by libc's
+    /// malloc().
     ///
     /// Throws <code>std::bad_alloc</code> if the implementation cannot
     /// allocate the requested storage.
@@ -89,12 +137,31 @@ public:
     /// It should be considered a fatal error.
     virtual bool clearNamedAddressImpl(const char* name);
 
+    /// \brief Return statistics of the memory held by the segment.
+    ///
+    /// This method never throws.
+    Statistics getStatistics() const;
+
 private:
+    void* allocateChunk();
+    void* allocateSmall(size_t size_class);
+
     // allocated_size_ can underflow, wrap around to max size_t (which
     // is unsigned). But because we only do a check against 0 and not a
     // relation comparison, this is okay.
     size_t allocated_size_;
 
+    const bool huge_pages_;
+    const size_t chunk_size_;
+
+    // Heads of the free lists, indexed by size class.  Free blocks are
+    // linked through their first word.
+    std::vector<void*> free_lists_;
+    std::vector<void*> chunks_;
+    uint8_t* chunk_ptr_;        // unused part of the latest chunk
+    size_t chunk_left_;         // size of the unused part
+    size_t reserved_size_;
+
     std::map<std::string, void*> named_addrs_;
 };
 
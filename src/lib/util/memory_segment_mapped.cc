@@ -24,11 +24,13 @@
 #include <boost/interprocess/mapped_region.hpp>
 #include <boost/interprocess/sync/file_lock.hpp>
 
+#include <algorithm>
 #include <cassert>
 #include <string>
 #include <new>
 
 #include <stdint.h>
+#include <sys/mman.h>
 
 // boost::interprocess namespace is big and can cause unexpected import
 // (e.g., it has "read_only"), so it's safer to be specific for shortcuts.
@@ -59,6 +61,11 @@ const char* const RESERVED_NAMED_ADDRESS_STORAGE_NAME =
 // or reference.
 const size_t MemorySegmentMapped::INITIAL_SIZE;
 
+// Note that the multiplication wraps around (to a harmless value) rather
+// than overflows if size_t is 32-bit, which is when we don't use it anyway.
+const size_t MemorySegmentMapped::DEFAULT_RESERVED_SIZE =
+    sizeof(size_t) >= 8 ? static_cast<size_t>(64) * 1024 * 1024 * 1024 : 0;
+
 // We customize managed_mapped_file to make it completely lock free.  In our
 // usage the application (or the system of applications) is expected to ensure
 // there's at most one writer process or concurrent writing the shared memory
@@ -75,8 +82,11 @@ struct MemorySegmentMapped::Impl {
     // tricky because we want to remove any existing file but we also want
     // to detect possible conflict with other readers or writers using
     // file lock.
-    Impl(const std::string& filename, create_only_t, size_t initial_size) :
-        read_only_(false), filename_(filename)
+    Impl(const std::string& filename, create_only_t, size_t initial_size,
+         size_t reserved_size) :
+        read_only_(false), filename_(filename),
+        huge_pages_(false), prefault_(false),
+        reserved_(NULL), reserved_size_(0), mapped_len_(0)
     {
         try {
             // First, try opening it in boost create_only mode; it fails if
@@ -109,23 +119,31 @@ struct MemorySegmentMapped::Impl {
         // confirm there's no other user and there won't either.
         lock_.reset(new boost::interprocess::file_lock(filename.c_str()));
         checkWriter();
+        reserveAddressSpace(reserved_size);
         reserveMemory();
     }
 
     // Constructor for open-or-write (and read-write) mode
-    Impl(const std::string& filename, open_or_create_t, size_t initial_size) :
+    Impl(const std::string& filename, open_or_create_t, size_t initial_size,
+         size_t reserved_size) :
         read_only_(false), filename_(filename),
+        huge_pages_(false), prefault_(false),
+        reserved_(NULL), reserved_size_(0), mapped_len_(0),
         base_sgmt_(new BaseSegment(open_or_create, filename.c_str(),
                                    initial_size)),
         lock_(new boost::interprocess::file_lock(filename.c_str()))
     {
         checkWriter();
+        reserveAddressSpace(reserved_size);
         reserveMemory();
     }
 
     // Constructor for existing segment, either read-only or read-write
-    Impl(const std::string& filename, bool read_only) :
+    Impl(const std::string& filename, bool read_only,
+         size_t reserved_size = 0) :
         read_only_(read_only), filename_(filename),
+        huge_pages_(false), prefault_(false),
+        reserved_(NULL), reserved_size_(0), mapped_len_(0),
         base_sgmt_(read_only_ ?
                    new BaseSegment(open_read_only, filename.c_str()) :
                    new BaseSegment(open_only, filename.c_str())),
@@ -135,10 +153,15 @@ struct MemorySegmentMapped::Impl {
             checkReader();
         } else {
             checkWriter();
+            reserveAddressSpace(reserved_size);
         }
         reserveMemory();
     }
 
+    ~Impl() {
+        releaseAddressSpace();
+    }
+
     void reserveMemory(bool no_grow = false) {
         if (!read_only_) {
             // Reserve a named address for use during
@@ -170,8 +193,109 @@ struct MemorySegmentMapped::Impl {
         }
     }
 
-    // Internal helper to grow the underlying mapped segment.
-    void growSegment() {
+    // Reserve address space of the given size for the segment to grow in
+    // place: the segment is mapped at the beginning of the range, and the
+    // rest of it is kept as an inaccessible, uncommitted mapping so nothing
+    // else will be placed there.  If there isn't enough free space right
+    // after the current mapping, the segment is moved to a newly reserved
+    // range; it's only called while the segment is being opened or when
+    // it's relocated anyway, so this is okay.  This is all best-effort;
+    // on failure we simply don't have a reservation.
+    void reserveAddressSpace(size_t reserved_size) {
+        const size_t cur_len = getMappedLength();
+        if (reserved_size <= cur_len) {
+            return;
+        }
+        char* const base = static_cast<char*>(base_sgmt_->get_address());
+        if (mapInaccessible(base + cur_len, reserved_size - cur_len)) {
+            reserved_ = base;
+            reserved_size_ = reserved_size;
+            mapped_len_ = cur_len;
+            return;
+        }
+
+        char* const range = static_cast<char*>(
+            mapInaccessible(NULL, reserved_size));
+        if (!range) {
+            return;
+        }
+        base_sgmt_->flush();
+        base_sgmt_.reset();
+        munmap(range, cur_len);
+        reserved_ = range;
+        reserved_size_ = reserved_size;
+        mapped_len_ = cur_len;
+        remapSegment();
+    }
+
+    // Release the part of the reserved address space that isn't used for
+    // the segment, and forget the reservation.
+    void releaseAddressSpace() {
+        if (reserved_) {
+            if (mapped_len_ < reserved_size_) {
+                munmap(reserved_ + mapped_len_, reserved_size_ - mapped_len_);
+            }
+            reserved_ = NULL;
+            reserved_size_ = 0;
+            mapped_len_ = 0;
+        }
+    }
+
+    // (Re)open the file as the segment, at the beginning of the reserved
+    // address space if we have it.  The range to map must have been made
+    // available (i.e., [reserved_, reserved_ + mapped_len_) is unmapped).
+    // Returns true if the segment ends up being relocated.
+    bool remapSegment() {
+        if (reserved_) {
+            try {
+                base_sgmt_.reset(new BaseSegment(open_only, filename_.c_str(),
+                                                 reserved_));
+                return (false);
+            } catch (const boost::interprocess::interprocess_exception&) {
+                // The range was taken by someone else or is too small
+                // for the segment.  Give up the reservation and let the
+                // segment be mapped anywhere.
+                releaseAddressSpace();
+            }
+        }
+        base_sgmt_.reset(new BaseSegment(open_only, filename_.c_str()));
+        return (true);
+    }
+
+    // Return the size of the current mapping of the segment, rounded up
+    // to the page boundary.
+    size_t getMappedLength() const {
+        return (roundUpToPage(base_sgmt_->get_size()));
+    }
+
+    static size_t roundUpToPage(size_t size) {
+        const size_t pagesize =
+            boost::interprocess::mapped_region::get_page_size();
+        return ((size + pagesize - 1) / pagesize * pagesize);
+    }
+
+    // Map an inaccessible, uncommitted region of the given length at the
+    // given address (or anywhere if addr is NULL).  Returns the mapped
+    // address, or NULL if it can't be mapped at the specified address.
+    static void* mapInaccessible(void* addr, size_t len) {
+        void* const ptr = mmap(addr, len, PROT_NONE,
+                               MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                               -1, 0);
+        if (ptr == MAP_FAILED) {
+            return (NULL);
+        }
+        if (addr && ptr != addr) {
+            munmap(ptr, len);
+            return (NULL);
+        }
+        return (ptr);
+    }
+
+    // Internal helper to grow the underlying mapped segment.  It returns
+    // true if the segment is relocated as a result of growing it, which
+    // can only happen if we don't have a sufficiently large reserved
+    // address space.
+    bool growSegment() {
         // We first need to unmap it before calling grow().
         const size_t prev_size = base_sgmt_->get_size();
         base_sgmt_->flush();
@@ -188,20 +312,65 @@ struct MemorySegmentMapped::Impl {
         const bool grown = BaseSegment::grow(filename_.c_str(),
                                              new_size - prev_size);
 
+        // If the grown segment still fits in the reserved address space,
+        // carve the additional part out of the reservation so the file can
+        // be remapped at the same address.  Otherwise the remap below will
+        // fail to use the reserved address, and we'll start over with a
+        // larger reservation after relocating the segment.
+        const size_t new_len = roundUpToPage(new_size);
+        const size_t prev_reserved_size = reserved_size_;
+        if (grown && reserved_ && new_len <= reserved_size_ &&
+            new_len > mapped_len_) {
+            munmap(reserved_ + mapped_len_, new_len - mapped_len_);
+            mapped_len_ = new_len;
+        }
+
         // Remap the file, whether or not grow() succeeded.  this should
         // normally succeed(*), but it's not 100% guaranteed.  We abort
         // if it fails (see the method description in the header file).
         // (*) Although it's not formally documented, the implementation
         // of grow() seems to provide strong guarantee, i.e, if it fails
         // the underlying file can be used with the previous size.
+        bool relocated = false;
         try {
-            base_sgmt_.reset(new BaseSegment(open_only, filename_.c_str()));
+            relocated = remapSegment();
+            if (relocated && prev_reserved_size > 0) {
+                reserveAddressSpace(std::max(prev_reserved_size * 2,
+                                             getMappedLength() * 2));
+            }
         } catch (...) {
             abort();
         }
+        applyMemoryOptions();
         if (!grown) {
             throw std::bad_alloc();
         }
+        return (relocated);
+    }
+
+    // Apply the options set by setMemoryOptions() to the current mapping.
+    // These are all optimizations, so any failure is ignored.
+    void applyMemoryOptions() {
+        void* const addr = base_sgmt_->get_address();
+        const size_t size = base_sgmt_->get_size();
+#ifdef MADV_HUGEPAGE
+        if (huge_pages_) {
+            madvise(addr, size, MADV_HUGEPAGE);
+        }
+#endif
+        if (prefault_ && mlock(addr, size) != 0) {
+            // We are not allowed to lock the memory (most likely due to
+            // RLIMIT_MEMLOCK); at least fault all pages in by reading them.
+            const size_t pagesize =
+                boost::interprocess::mapped_region::get_page_size();
+            const volatile uint8_t* const cp_begin =
+                static_cast<const volatile uint8_t*>(addr);
+            for (const volatile uint8_t* cp = cp_begin;
+                 cp < cp_begin + size;
+                 cp += pagesize) {
+                static_cast<void>(*cp);
+            }
+        }
     }
 
     // remember if the segment is opened read-only or not
@@ -210,6 +379,19 @@ struct MemorySegmentMapped::Impl {
     // mapped file; remember it in case we need to grow it.
     const std::string filename_;
 
+    // memory options given by setMemoryOptions(); remembered so they can
+    // be applied again when the file is remapped.
+    bool huge_pages_;
+    bool prefault_;
+
+    // address space reserved for the segment to grow in place (NULL and 0
+    // if there's no reservation).  The segment is mapped at reserved_, and
+    // [reserved_ + mapped_len_, reserved_ + reserved_size_) is the part of
+    // the reservation not yet used by the segment.
+    char* reserved_;
+    size_t reserved_size_;
+    size_t mapped_len_;
+
     // actual Boost implementation of mapped segment.
     boost::scoped_ptr<BaseSegment> base_sgmt_;
 
@@ -251,19 +433,22 @@ MemorySegmentMapped::MemorySegmentMapped(const std::string& filename) :
 }
 
 MemorySegmentMapped::MemorySegmentMapped(const std::string& filename,
-                                         OpenMode mode, size_t initial_size) :
+                                         OpenMode mode, size_t initial_size,
+                                         size_t reserved_size) :
     impl_(NULL)
 {
     try {
         switch (mode) {
         case OPEN_FOR_WRITE:
-            impl_ = new Impl(filename, false);
+            impl_ = new Impl(filename, false, reserved_size);
             break;
         case OPEN_OR_CREATE:
-            impl_ = new Impl(filename, open_or_create, initial_size);
+            impl_ = new Impl(filename, open_or_create, initial_size,
+                             reserved_size);
             break;
         case CREATE_ONLY:
-            impl_ = new Impl(filename, create_only, initial_size);
+            impl_ = new Impl(filename, create_only, initial_size,
+                             reserved_size);
             break;
         default:
             bundy_throw(InvalidParameter,
@@ -278,7 +463,10 @@ MemorySegmentMapped::MemorySegmentMapped(const std::string& filename,
 
 MemorySegmentMapped::~MemorySegmentMapped() {
     if (impl_->base_sgmt_ && !impl_->read_only_) {
-        impl_->freeReservedMemory();
+        // The reserved memory is left in the file, so the content is
+        // exactly the same as the last time the application saw it
+        // (e.g., when it calculated a checksum); the next writer finds
+        // and reuses it.
         impl_->base_sgmt_->flush(); // note: this is exception free
     }
     delete impl_;
@@ -301,10 +489,22 @@ MemorySegmentMapped::allocate(size_t size) {
     }
 
     // Grow the mapped segment doubling the size until we have sufficient
-    // free memory in the revised segment for the requested size.
-    do {
-        impl_->growSegment();
-    } while (impl_->base_sgmt_->get_free_memory() < size);
+    // free memory in the revised segment for the requested size.  As long
+    // as the segment is grown in place, existing addresses are still valid
+    // and we can simply retry the allocation.
+    bool relocated = false;
+    while (true) {
+        relocated = impl_->growSegment() || relocated;
+        if (impl_->base_sgmt_->get_free_memory() >= size) {
+            if (relocated) {
+                break;
+            }
+            void* ptr = impl_->base_sgmt_->allocate(size, std::nothrow);
+            if (ptr) {
+                return (ptr);
+            }
+        }
+    }
     bundy_throw(MemorySegmentGrown, "mapped memory segment grown, size: "
               << impl_->base_sgmt_->get_size() << ", free size: "
               << impl_->base_sgmt_->get_free_memory());
@@ -387,8 +587,7 @@ MemorySegmentMapped::setNamedAddressImpl(const char* name, void* addr) {
             return (grown);
         }
 
-        impl_->growSegment();
-        grown = true;
+        grown = impl_->growSegment() || grown;
     }
 }
 
@@ -424,6 +623,7 @@ MemorySegmentMapped::shrinkToFit() {
     impl_->base_sgmt_.reset();
 
     BaseSegment::shrink_to_fit(impl_->filename_.c_str());
+    const size_t prev_len = impl_->mapped_len_;
     try {
         // Remap the shrunk file; this should succeed, but it's not 100%
         // guaranteed.  If it fails we treat it as if we fail to create
@@ -433,12 +633,27 @@ MemorySegmentMapped::shrinkToFit() {
         // called after shrinkToFit() (and the destructor can still be called
         // safely), so we give the application an opportunity to handle the
         // case as gracefully as possible.
-        impl_->base_sgmt_.reset(
-            new BaseSegment(open_only, impl_->filename_.c_str()));
+        impl_->remapSegment();
     } catch (const boost::interprocess::interprocess_exception& ex) {
         bundy_throw(MemorySegmentError,
                   "remap after shrink failed; segment is now unusable");
     }
+
+    // If it's remapped at the same reserved address, return the released
+    // part of the previous mapping to the reservation.  If it fails we have
+    // to give up the reservation, but the segment itself is still valid.
+    if (impl_->reserved_) {
+        const size_t new_len = impl_->getMappedLength();
+        if (new_len < prev_len) {
+            if (Impl::mapInaccessible(impl_->reserved_ + new_len,
+                                      prev_len - new_len)) {
+                impl_->mapped_len_ = new_len;
+            } else {
+                impl_->releaseAddressSpace();
+            }
+        }
+    }
+    impl_->applyMemoryOptions();
 }
 
 size_t
@@ -446,6 +661,11 @@ MemorySegmentMapped::getSize() const {
     return (impl_->base_sgmt_->get_size());
 }
 
+size_t
+MemorySegmentMapped::getFreeSize() const {
+    return (impl_->base_sgmt_->get_free_memory());
+}
+
 size_t
 MemorySegmentMapped::getCheckSum() const {
     const size_t pagesize =
@@ -462,5 +682,26 @@ MemorySegmentMapped::getCheckSum() const {
     return (sum);
 }
 
+void
+MemorySegmentMapped::setMemoryOptions(bool huge_pages, bool prefault) {
+    if (impl_->prefault_ && !prefault) {
+        munlock(impl_->base_sgmt_->get_address(),
+                impl_->base_sgmt_->get_size());
+    }
+    impl_->huge_pages_ = huge_pages;
+    impl_->prefault_ = prefault;
+    impl_->applyMemoryOptions();
+}
+
+bool
+MemorySegmentMapped::getHugePages() const {
+    return (impl_->huge_pages_);
+}
+
+bool
+MemorySegmentMapped::getPrefault() const {
+    return (impl_->prefault_);
+}
+
 } // namespace util
 } // namespace bundy
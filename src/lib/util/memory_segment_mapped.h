@@ -64,6 +64,14 @@ public:
     /// sufficiently but not too large.
     static const size_t INITIAL_SIZE = 32768;
 
+    /// \brief A suggested size of address space to reserve for growing
+    /// the segment in place.
+    ///
+    /// This is 64GB on systems with 64-bit address space, where reserving
+    /// it costs nothing but page table entries; it's 0 (no reservation)
+    /// otherwise, since the address space is too scarce to waste.
+    static const size_t DEFAULT_RESERVED_SIZE;
+
     /// \brief Open modes of \c MemorySegmentMapped.
     ///
     /// These modes matter only for \c MemorySegmentMapped to be opened
@@ -131,14 +139,26 @@ public:
     /// does not specify how large it should be, but the default
     /// \c INITIAL_SIZE should be sufficiently large in practice.
     ///
+    /// If \c reserved_size is non 0, the constructor reserves (but doesn't
+    /// commit) a contiguous range of virtual address space of that size,
+    /// starting at the beginning of the segment.  The segment will then be
+    /// grown inside the reserved range, keeping its address, so
+    /// \c allocate() and \c setNamedAddress() won't need to report
+    /// relocation as long as the segment doesn't exceed \c reserved_size.
+    /// Reserving the address space is a best-effort operation; if it
+    /// fails, the segment behaves as if \c reserved_size were 0.
+    ///
     /// \throw MemorySegmentOpenError see the description.
     ///
     /// \param filename The file name to be mapped to memory.
     /// \param mode Open mode (see the description).
     /// \param initial_size Specifies the size of the newly created file;
     /// ignored if \c mode is OPEN_FOR_WRITE.
+    /// \param reserved_size The size of address space to reserve for the
+    /// segment to grow in place (see the description).
     MemorySegmentMapped(const std::string& filename, OpenMode mode,
-                        size_t initial_size = INITIAL_SIZE);
+                        size_t initial_size = INITIAL_SIZE,
+                        size_t reserved_size = 0);
 
     /// \brief Destructor.
     ///
@@ -150,7 +170,11 @@ public:
 
     /// \brief Allocate/acquire a segment of memory.
     ///
-    /// This version can throw \c MemorySegmentGrown.  Furthermore, there is
+    /// This version can throw \c MemorySegmentGrown, unless the segment
+    /// could be grown inside the address space reserved at construction
+    /// time; in that case the allocation is retried internally and the
+    /// address of the segment (and so any existing object in it) doesn't
+    /// change.  Furthermore, there is
     /// a very small chance that the object loses its integrity and can't be
     /// usable in the case where \c MemorySegmentGrown would be thrown.
     /// In this case, throwing a different exception wouldn't help, because
@@ -193,7 +217,9 @@ public:
     /// it internally allocates memory in the segment for the name and
     /// address to be stored, which can require segment extension, just like
     /// allocate().  So it's possible to return true unlike
-    /// \c MemorySegmentLocal version of the method.
+    /// \c MemorySegmentLocal version of the method; it still returns false
+    /// if the segment could be grown in place within the reserved address
+    /// space.
     ///
     /// This method cannot be called if the segment object is created in the
     /// read-only mode; in that case MemorySegmentError will be thrown.
@@ -241,6 +267,16 @@ public:
     /// \throw None
     size_t getSize() const;
 
+    /// \brief Return the size of the part of the segment not in use.
+    ///
+    /// Like \c getSize(), it's provided mainly for diagnosis; comparing
+    /// the two shows how much of the segment is wasted.  Note that the
+    /// free part can be fragmented, so allocating this size of memory at
+    /// once may still need the segment to grow.
+    ///
+    /// \throw None
+    size_t getFreeSize() const;
+
     /// \brief Calculate a checksum over the memory segment.
     ///
     /// This method goes over all pages of the underlying mapped memory
@@ -253,6 +289,38 @@ public:
     /// \throw None
     size_t getCheckSum() const;
 
+    /// \brief Set how the kernel should back the mapped memory.
+    ///
+    /// If \c huge_pages is true, the kernel is advised to back the mapped
+    /// memory with (transparent) huge pages, which reduces TLB misses when
+    /// the segment is large.  This only takes effect where the kernel
+    /// supports huge pages for the filesystem of the mapped file (e.g., a
+    /// tmpfs mounted with the "huge=advise" option); otherwise it's
+    /// silently ignored.  Note that the file cannot be placed on hugetlbfs,
+    /// since the segment size is not a multiple of the huge page size.
+    ///
+    /// If \c prefault is true, all pages of the segment are faulted in
+    /// immediately, and they are also locked in memory if the process is
+    /// allowed to do so (see mlock(2)).  This avoids page fault overhead
+    /// at the time of the first access (e.g., when answering queries).
+    ///
+    /// The settings are kept in the object and applied again whenever
+    /// the underlying file is remapped due to growing or shrinking the
+    /// segment.  Both options are disabled by default.
+    ///
+    /// \throw None
+    void setMemoryOptions(bool huge_pages, bool prefault);
+
+    /// \brief Return if huge pages are requested by \c setMemoryOptions().
+    ///
+    /// \throw None
+    bool getHugePages() const;
+
+    /// \brief Return if prefaulting is requested by \c setMemoryOptions().
+    ///
+    /// \throw None
+    bool getPrefault() const;
+
 private:
     struct Impl;
     Impl* impl_;
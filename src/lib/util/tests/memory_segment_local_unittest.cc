@@ -18,7 +18,11 @@
 #include <exceptions/exceptions.h>
 #include <gtest/gtest.h>
 #include <memory>
+#include <utility>
+#include <vector>
+#include <cstring>
 #include <limits.h>
+#include <stdint.h>
 
 using namespace std;
 using namespace bundy::util;
@@ -108,6 +112,100 @@ TEST(MemorySegmentLocal, TestNullDeallocate) {
     EXPECT_TRUE(segment->allMemoryDeallocated());
 }
 
+TEST(MemorySegmentLocal, reuseFreedBlocks) {
+    MemorySegmentLocal segment;
+
+    // A freed small block is reused by the next allocation of the same
+    // size class.
+    void* ptr = segment.allocate(42);
+    segment.deallocate(ptr, 42);
+    EXPECT_EQ(ptr, segment.allocate(41));
+    segment.deallocate(ptr, 41);
+
+    // But not by one of another class.
+    void* ptr2 = segment.allocate(100);
+    EXPECT_NE(ptr, ptr2);
+    segment.deallocate(ptr2, 100);
+
+    // 0-byte allocation is possible and returns a distinct block.
+    void* ptr3 = segment.allocate(0);
+    void* ptr4 = segment.allocate(0);
+    EXPECT_NE(static_cast<void*>(NULL), ptr3);
+    EXPECT_NE(ptr3, ptr4);
+    segment.deallocate(ptr3, 0);
+    segment.deallocate(ptr4, 0);
+
+    EXPECT_TRUE(segment.allMemoryDeallocated());
+}
+
+TEST(MemorySegmentLocal, manyAllocations) {
+    MemorySegmentLocal segment;
+
+    // Allocate blocks of all sizes around the small block limit so more
+    // than one chunk is needed, fill them and check they don't overlap.
+    vector<pair<uint8_t*, size_t> > blocks;
+    for (size_t i = 0; i < 2000; ++i) {
+        const size_t size = (i * 7) % (MemorySegmentLocal::MAX_SMALL_SIZE + 64);
+        uint8_t* ptr = static_cast<uint8_t*>(segment.allocate(size));
+        EXPECT_EQ(0, reinterpret_cast<uintptr_t>(ptr) %
+                  MemorySegmentLocal::ALIGNMENT);
+        memset(ptr, i & 0xff, size);
+        blocks.push_back(make_pair(ptr, size));
+    }
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        for (size_t j = 0; j < blocks[i].second; ++j) {
+            ASSERT_EQ(i & 0xff, blocks[i].first[j]);
+        }
+        segment.deallocate(blocks[i].first, blocks[i].second);
+    }
+    EXPECT_TRUE(segment.allMemoryDeallocated());
+}
+
+TEST(MemorySegmentLocal, statistics) {
+    MemorySegmentLocal segment;
+
+    MemorySegmentLocal::Statistics stats = segment.getStatistics();
+    EXPECT_EQ(0, stats.allocated_bytes);
+    EXPECT_EQ(0, stats.reserved_bytes);
+    EXPECT_EQ(0, stats.wasted_bytes);
+
+    // A small block reserves a whole chunk.
+    void* ptr = segment.allocate(42);
+    stats = segment.getStatistics();
+    EXPECT_EQ(42, stats.allocated_bytes);
+    EXPECT_LT(42, stats.reserved_bytes);
+    EXPECT_EQ(stats.reserved_bytes - 42, stats.wasted_bytes);
+    const size_t chunk_bytes = stats.reserved_bytes;
+
+    // A large block is counted as it is.
+    const size_t large_size = MemorySegmentLocal::MAX_SMALL_SIZE + 1;
+    void* ptr2 = segment.allocate(large_size);
+    stats = segment.getStatistics();
+    EXPECT_EQ(42 + large_size, stats.allocated_bytes);
+    EXPECT_EQ(chunk_bytes + large_size, stats.reserved_bytes);
+
+    // Freed large blocks are returned to the system, while the chunks
+    // are kept.
+    segment.deallocate(ptr2, large_size);
+    segment.deallocate(ptr, 42);
+    stats = segment.getStatistics();
+    EXPECT_EQ(0, stats.allocated_bytes);
+    EXPECT_EQ(chunk_bytes, stats.reserved_bytes);
+    EXPECT_EQ(chunk_bytes, stats.wasted_bytes);
+}
+
+TEST(MemorySegmentLocal, hugePages) {
+    // Whether or not the system supports huge pages, the segment should
+    // work the same way.
+    MemorySegmentLocal segment(true);
+    void* ptr = segment.allocate(42);
+    memset(ptr, 0, 42);
+    const MemorySegmentLocal::Statistics stats = segment.getStatistics();
+    EXPECT_EQ(2 * 1024 * 1024, stats.reserved_bytes);
+    segment.deallocate(ptr, 42);
+    EXPECT_TRUE(segment.allMemoryDeallocated());
+}
+
 TEST(MemorySegmentLocal, namedAddress) {
     MemorySegmentLocal segment;
     bundy::util::test::checkSegmentNamedAddress(segment, true);
@@ -102,6 +102,8 @@ TEST(MemorySegmentMappedConstantTest, staticVariables) {
     // It helps in case we accidentally remove the definition from the main
     // code.
     EXPECT_EQ(DEFAULT_INITIAL_SIZE, *(&MemorySegmentMapped::INITIAL_SIZE));
+    EXPECT_EQ(MemorySegmentMapped::DEFAULT_RESERVED_SIZE,
+              *(&MemorySegmentMapped::DEFAULT_RESERVED_SIZE));
 }
 
 TEST_F(MemorySegmentMappedTest, createAndModify) {
@@ -236,6 +238,44 @@ TEST_F(MemorySegmentMappedTest, allocate) {
     // will be removed at the end of the test)
 }
 
+TEST_F(MemorySegmentMappedTest, allocateInReservedSpace) {
+    // With sufficient address space reserved, growing the segment doesn't
+    // relocate it, so allocate() doesn't have to throw.
+    segment_.reset();
+    boost::interprocess::file_mapping::remove(mapped_file);
+    const size_t reserved_size = DEFAULT_INITIAL_SIZE * 64;
+    segment_.reset(new MemorySegmentMapped(mapped_file, CREATE_ONLY,
+                                           DEFAULT_INITIAL_SIZE,
+                                           reserved_size));
+    void* const mark = segment_->allocate(sizeof(uint32_t));
+    *static_cast<uint32_t*>(mark) = 42;
+    EXPECT_FALSE(segment_->setNamedAddress("mark", mark));
+
+    const size_t prev_size = segment_->getSize();
+    void* ptr = segment_->allocate(prev_size * 10);
+    EXPECT_NE(static_cast<void*>(NULL), ptr);
+    EXPECT_EQ(prev_size * 16, segment_->getSize());
+
+    // Existing objects stay at the same address and are intact.
+    EXPECT_EQ(mark, segment_->getNamedAddress("mark").second);
+    EXPECT_EQ(42, *static_cast<uint32_t*>(mark));
+
+    // This is also the case after shrinking and growing the segment again.
+    segment_->deallocate(ptr, prev_size * 10);
+    segment_->shrinkToFit();
+    EXPECT_GT(prev_size * 16, segment_->getSize());
+    ptr = segment_->allocate(prev_size * 10);
+    EXPECT_NE(static_cast<void*>(NULL), ptr);
+    EXPECT_EQ(mark, segment_->getNamedAddress("mark").second);
+
+    // Exceeding the reservation relocates the segment, which is reported
+    // in the usual way.
+    EXPECT_THROW(segment_->allocate(reserved_size), MemorySegmentGrown);
+    EXPECT_EQ(42, *static_cast<uint32_t*>(
+                  segment_->getNamedAddress("mark").second));
+    EXPECT_TRUE(segment_->clearNamedAddress("mark"));
+}
+
 TEST_F(MemorySegmentMappedTest, badAllocate) {
     // If the test is run as the root user, the following allocate()
     // call will result in a successful MemorySegmentGrown exception,
@@ -549,6 +589,46 @@ TEST_F(MemorySegmentMappedTest, getCheckSum) {
     EXPECT_EQ(old_cksum + 1, segment_->getCheckSum());
 }
 
+TEST_F(MemorySegmentMappedTest, setMemoryOptions) {
+    // The options are all best-effort optimizations; we can only check
+    // they don't break the segment, including after it's remapped on
+    // growing or shrinking.
+    EXPECT_FALSE(segment_->getHugePages());
+    EXPECT_FALSE(segment_->getPrefault());
+    segment_->setMemoryOptions(true, true);
+    EXPECT_TRUE(segment_->getHugePages());
+    EXPECT_TRUE(segment_->getPrefault());
+    const size_t prev_size = segment_->getSize();
+    EXPECT_THROW(segment_->allocate(prev_size + 1), MemorySegmentGrown);
+    void* ptr = segment_->allocate(prev_size + 1);
+    ASSERT_NE(static_cast<void*>(NULL), ptr);
+    memset(ptr, 1, prev_size + 1);
+    // The options are kept across the remapping.
+    EXPECT_TRUE(segment_->getHugePages());
+    EXPECT_TRUE(segment_->getPrefault());
+    segment_->deallocate(ptr, prev_size + 1);
+    segment_->shrinkToFit();
+    EXPECT_TRUE(segment_->getHugePages());
+    EXPECT_TRUE(segment_->getPrefault());
+    segment_->setMemoryOptions(false, false);
+    EXPECT_FALSE(segment_->getHugePages());
+    EXPECT_FALSE(segment_->getPrefault());
+    EXPECT_TRUE(segment_->allMemoryDeallocated());
+
+    // It's also usable for read-only segments, and prefaulting them
+    // doesn't change the content written before the options are applied.
+    const size_t page_sz = boost::interprocess::mapped_region::get_page_size();
+    EXPECT_THROW(segment_->allocate(page_sz * 2), MemorySegmentGrown);
+    uint8_t* cp0 = static_cast<uint8_t*>(segment_->allocate(page_sz * 2));
+    memset(cp0, 0x5a, page_sz * 2);
+    const size_t written_cksum = segment_->getCheckSum();
+    segment_.reset();
+    MemorySegmentMapped segment_ro(mapped_file);
+    segment_ro.setMemoryOptions(true, true);
+    EXPECT_TRUE(segment_ro.getPrefault());
+    EXPECT_EQ(written_cksum, segment_ro.getCheckSum());
+}
+
 // Mode of opening segments in the tests below.
 enum TestOpenMode {
     READER = 0,
@@ -0,0 +1,163 @@
+// Copyright (C) 2013  Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include "numa.h"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+using std::string;
+using std::vector;
+
+namespace bundy {
+namespace util {
+namespace thread {
+
+namespace {
+
+// The CPUs of each node, and the node of each CPU, read from sysfs once.
+// Nodes are assumed to be numbered contiguously from 0, which is the case
+// on all systems we know of; we stop at the first missing one.
+struct NumaTopology {
+    NumaTopology() {
+#ifdef __linux__
+        for (size_t node = 0; ; ++node) {
+            std::ostringstream path;
+            path << "/sys/devices/system/node/node" << node << "/cpulist";
+            std::ifstream ifs(path.str().c_str());
+            string cpulist;
+            if (!ifs || !std::getline(ifs, cpulist)) {
+                break;
+            }
+            node_cpus.push_back(parseCPUList(cpulist));
+            for (vector<int>::const_iterator it = node_cpus.back().begin();
+                 it != node_cpus.back().end(); ++it) {
+                if (cpu_nodes.size() <= static_cast<size_t>(*it)) {
+                    cpu_nodes.resize(*it + 1, 0);
+                }
+                cpu_nodes[*it] = node;
+            }
+        }
+#endif
+        if (node_cpus.empty()) {
+            node_cpus.push_back(vector<int>());
+        }
+    }
+
+    // Parse the "cpulist" format, e.g., "0-3,8-11".  Anything unexpected
+    // ends the list.
+    static vector<int> parseCPUList(const string& cpulist) {
+        vector<int> cpus;
+        std::istringstream iss(cpulist);
+        int first, last;
+        while (iss >> first) {
+            last = first;
+            if (iss.peek() == '-') {
+                iss.ignore();
+                if (!(iss >> last)) {
+                    break;
+                }
+            }
+            for (int cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+            if (iss.peek() != ',') {
+                break;
+            }
+            iss.ignore();
+        }
+        return (cpus);
+    }
+
+    vector<vector<int> > node_cpus;
+    vector<size_t> cpu_nodes;
+};
+
+const NumaTopology&
+getTopology() {
+    static const NumaTopology topology;
+    return (topology);
+}
+
+}
+
+size_t
+getNumaNodeCount() {
+    return (getTopology().node_cpus.size());
+}
+
+size_t
+getCurrentNumaNode() {
+#ifdef __linux__
+    const NumaTopology& topology = getTopology();
+    if (topology.node_cpus.size() > 1) {
+        // sched_getcpu() doesn't need a system call on most architectures.
+        const int cpu = sched_getcpu();
+        if (cpu >= 0 && static_cast<size_t>(cpu) < topology.cpu_nodes.size()) {
+            return (topology.cpu_nodes[cpu]);
+        }
+    }
+#endif
+    return (0);
+}
+
+struct NumaNodeBinder::SavedAffinity {
+#ifdef __linux__
+    cpu_set_t cpus;
+#endif
+};
+
+NumaNodeBinder::NumaNodeBinder(size_t node) :
+    saved_(NULL), bound_(false)
+{
+#ifdef __linux__
+    const NumaTopology& topology = getTopology();
+    if (topology.node_cpus.size() <= 1 || node >= topology.node_cpus.size()) {
+        return;
+    }
+    saved_ = new SavedAffinity;
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    const vector<int>& node_cpus = topology.node_cpus[node];
+    for (vector<int>::const_iterator it = node_cpus.begin();
+         it != node_cpus.end(); ++it) {
+        if (*it < CPU_SETSIZE) {
+            CPU_SET(*it, &cpus);
+        }
+    }
+    if (sched_getaffinity(0, sizeof(saved_->cpus), &saved_->cpus) == 0 &&
+        sched_setaffinity(0, sizeof(cpus), &cpus) == 0) {
+        bound_ = true;
+    }
+#endif
+}
+
+NumaNodeBinder::~NumaNodeBinder() {
+#ifdef __linux__
+    if (bound_) {
+        sched_setaffinity(0, sizeof(saved_->cpus), &saved_->cpus);
+    }
+#endif
+    delete saved_;
+}
+
+}
+}
+}
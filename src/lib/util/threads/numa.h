@@ -0,0 +1,86 @@
+// Copyright (C) 2013  Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifndef BUNDY_NUMA_H
+#define BUNDY_NUMA_H
+
+#include <boost/noncopyable.hpp>
+
+#include <cstddef>
+
+namespace bundy {
+namespace util {
+namespace thread {
+
+/// \brief Return the number of NUMA nodes of the system.
+///
+/// The topology is read from the sysfs of Linux.  On other systems, or if
+/// it can't be read, the whole system is considered a single node, so the
+/// return value is always 1 or larger.  Nodes are identified by an index
+/// from 0 to the return value - 1 in this module.
+///
+/// \throw std::bad_alloc Internal resource allocation fails.
+size_t getNumaNodeCount();
+
+/// \brief Return the NUMA node the calling thread is running on.
+///
+/// Unless the thread is bound to a node (see \c NumaNodeBinder), the
+/// result can become obsolete any time.  It's still useful to choose
+/// data that is likely to be local to the thread.  This is cheap enough
+/// to be called for every query.
+///
+/// \return The node index, which is always smaller than
+///     \c getNumaNodeCount().  0 if it can't be determined.
+/// \throw std::bad_alloc Internal resource allocation fails.
+size_t getCurrentNumaNode();
+
+/// \brief Bind the calling thread to the CPUs of a NUMA node.
+///
+/// While an object of this class exists, the thread that created it only
+/// runs on the CPUs of the given node, and the memory it first touches is
+/// allocated on that node by the default policy of the kernel.  The
+/// previous CPU affinity of the thread is restored on destruction; so the
+/// object must be destroyed in the same thread.
+///
+/// If the system has only one node, or the affinity can't be changed,
+/// nothing happens; \c isBound() tells which is the case.
+class NumaNodeBinder : boost::noncopyable {
+public:
+    /// \brief Constructor.
+    ///
+    /// \throw std::bad_alloc Internal resource allocation fails.
+    /// \param node The index of the node to bind the thread to.
+    explicit NumaNodeBinder(size_t node);
+
+    /// \brief Destructor; restores the previous affinity.
+    ~NumaNodeBinder();
+
+    /// \brief Whether the thread has actually been bound to the node.
+    bool isBound() const { return (bound_); }
+
+private:
+    struct SavedAffinity;
+    SavedAffinity* saved_;
+    bool bound_;
+};
+
+}
+}
+}
+
+#endif
+
+// Local Variables:
+// mode: c++
+// End:
@@ -0,0 +1,49 @@
+// Copyright (C) 2013  Internet Systems Consortium, Inc. ("ISC")
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+// REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+// LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+// OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <util/threads/numa.h>
+
+#include <gtest/gtest.h>
+
+// The results depend on the topology of the machine running the tests, so
+// we only check what should hold on any of them; on a single node system
+// these are effectively no-op.
+
+using namespace bundy::util::thread;
+
+namespace {
+
+TEST(NumaTest, currentNode) {
+    const size_t node_count = getNumaNodeCount();
+    EXPECT_LE(1, node_count);
+    EXPECT_GT(node_count, getCurrentNumaNode());
+}
+
+TEST(NumaTest, bind) {
+    const size_t node_count = getNumaNodeCount();
+    for (size_t node = 0; node < node_count; ++node) {
+        const NumaNodeBinder binder(node);
+        if (node_count == 1) {
+            EXPECT_FALSE(binder.isBound());
+        } else if (binder.isBound()) {
+            EXPECT_EQ(node, getCurrentNumaNode());
+        }
+    }
+
+    // Nonexistent node; nothing happens.
+    const NumaNodeBinder binder(node_count);
+    EXPECT_FALSE(binder.isBound());
+}
+
+}